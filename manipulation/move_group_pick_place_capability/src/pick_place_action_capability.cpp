@@ -185,7 +185,7 @@ bool move_group::MoveGroupPickPlaceAction::planUsingPickPlace_Pickup(const movei
   pick_place::PickPlanPtr pick_plan;
   try
   {
-    pick_plan = pick_place_->planPick(plan.planning_scene_, goal);
+    pick_plan = pick_place_->planPick(ps.getSceneForReading(plan.planning_scene_), goal);
   }
   catch(std::runtime_error &ex)
   {
@@ -230,7 +230,7 @@ bool move_group::MoveGroupPickPlaceAction::planUsingPickPlace_Place(const moveit
   pick_place::PlacePlanPtr place_plan;
   try
   {
-    place_plan = pick_place_->planPlace(plan.planning_scene_, goal);
+    place_plan = pick_place_->planPlace(ps.getSceneForReading(plan.planning_scene_), goal);
   }
   catch(std::runtime_error &ex)
   {
@@ -40,6 +40,7 @@
 #include <moveit/pick_place/manipulation_pipeline.h>
 #include <moveit/pick_place/pick_place_params.h>
 #include <moveit/constraint_sampler_manager_loader/constraint_sampler_manager_loader.h>
+#include <moveit/reachability_map/reachability_map.h>
 #include <moveit/planning_pipeline/planning_pipeline.h>
 #include <moveit_msgs/PickupAction.h>
 #include <moveit_msgs/PlaceAction.h>
@@ -132,6 +133,9 @@ public:
     return constraint_sampler_manager_loader_->getConstraintSamplerManager();
   }
 
+  /** \brief Get the reachability map loaded for \e group (from the reachability_maps/<group> parameter), if any */
+  reachability_map::ReachabilityMapConstPtr getReachabilityMap(const std::string &group) const;
+
   const planning_pipeline::PlanningPipelinePtr& getPlanningPipeline() const
   {
     return planning_pipeline_;
@@ -167,6 +171,7 @@ private:
   ros::Publisher grasps_publisher_;
 
   constraint_sampler_manager_loader::ConstraintSamplerManagerLoaderPtr constraint_sampler_manager_loader_;
+  std::map<std::string, reachability_map::ReachabilityMapConstPtr> reachability_maps_;
 };
 
 }
@@ -40,6 +40,7 @@
 #include <moveit/pick_place/manipulation_stage.h>
 #include <moveit/constraint_samplers/constraint_sampler_manager.h>
 #include <moveit/planning_scene/planning_scene.h>
+#include <moveit/reachability_map/reachability_map.h>
 
 namespace pick_place
 {
@@ -50,7 +51,8 @@ public:
 
   ReachableAndValidPoseFilter(const planning_scene::PlanningSceneConstPtr &scene,
                               const collision_detection::AllowedCollisionMatrixConstPtr &collision_matrix,
-                              const constraint_samplers::ConstraintSamplerManagerPtr &constraints_sampler_manager);
+                              const constraint_samplers::ConstraintSamplerManagerPtr &constraints_sampler_manager,
+                              const reachability_map::ReachabilityMapConstPtr &reachability_map = reachability_map::ReachabilityMapConstPtr());
 
   virtual bool evaluate(const ManipulationPlanPtr &plan) const;
 
@@ -58,9 +60,13 @@ private:
 
   bool isEndEffectorFree(const ManipulationPlanPtr &plan, robot_state::RobotState &token_state) const;
 
+  /** \brief Check the goal pose against the reachability map; true if there is no map for the IK link of the plan */
+  bool isPossiblyReachable(const ManipulationPlanPtr &plan, const robot_state::RobotState &token_state) const;
+
   planning_scene::PlanningSceneConstPtr planning_scene_;
   collision_detection::AllowedCollisionMatrixConstPtr collision_matrix_;
   constraint_samplers::ConstraintSamplerManagerPtr constraints_sampler_manager_;
+  reachability_map::ReachabilityMapConstPtr reachability_map_;
 };
 
 }
@@ -104,6 +104,29 @@ PickPlace::PickPlace(const planning_pipeline::PlanningPipelinePtr &planning_pipe
   display_grasps_(false)
 {
   constraint_sampler_manager_loader_.reset(new constraint_sampler_manager_loader::ConstraintSamplerManagerLoader());
+
+  // precomputed reachability maps let the pose filter skip IK for grasps the arm cannot reach
+  const std::vector<const robot_model::JointModelGroup*> &groups = getRobotModel()->getJointModelGroups();
+  for (std::size_t i = 0 ; i < groups.size() ; ++i)
+  {
+    std::string filename;
+    if (!nh_.getParam("reachability_maps/" + groups[i]->getName(), filename))
+      continue;
+    reachability_map::ReachabilityMapPtr map(new reachability_map::ReachabilityMap());
+    if (map->loadFromFile(filename) && map->getGroupName() == groups[i]->getName())
+    {
+      ROS_INFO_NAMED("manipulation", "Loaded reachability map for group '%s' from '%s'", groups[i]->getName().c_str(), filename.c_str());
+      reachability_maps_[groups[i]->getName()] = map;
+    }
+    else
+      ROS_ERROR_NAMED("manipulation", "Unable to load a reachability map for group '%s' from '%s'", groups[i]->getName().c_str(), filename.c_str());
+  }
+}
+
+reachability_map::ReachabilityMapConstPtr PickPlace::getReachabilityMap(const std::string &group) const
+{
+  std::map<std::string, reachability_map::ReachabilityMapConstPtr>::const_iterator it = reachability_maps_.find(group);
+  return it != reachability_maps_.end() ? it->second : reachability_map::ReachabilityMapConstPtr();
 }
 
 void PickPlace::displayProcessedGrasps(bool flag)
@@ -280,7 +280,8 @@ bool PlacePlan::plan(const planning_scene::PlanningSceneConstPtr &planning_scene
   // configure the manipulation pipeline
   pipeline_.reset();
 
-  ManipulationStagePtr stage1(new ReachableAndValidPoseFilter(planning_scene, approach_place_acm, pick_place_->getConstraintsSamplerManager()));
+  ManipulationStagePtr stage1(new ReachableAndValidPoseFilter(planning_scene, approach_place_acm, pick_place_->getConstraintsSamplerManager(),
+                                                              pick_place_->getReachabilityMap(jmg->getName())));
   ManipulationStagePtr stage2(new ApproachAndTranslateStage(planning_scene, approach_place_acm));
   ManipulationStagePtr stage3(new PlanStage(planning_scene, pick_place_->getPlanningPipeline()));
   pipeline_.addStage(stage1).addStage(stage2).addStage(stage3);
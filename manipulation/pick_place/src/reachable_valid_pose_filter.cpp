@@ -42,11 +42,13 @@
 
 pick_place::ReachableAndValidPoseFilter::ReachableAndValidPoseFilter(const planning_scene::PlanningSceneConstPtr &scene,
                                                                      const collision_detection::AllowedCollisionMatrixConstPtr &collision_matrix,
-                                                                     const constraint_samplers::ConstraintSamplerManagerPtr &constraints_sampler_manager) :
+                                                                     const constraint_samplers::ConstraintSamplerManagerPtr &constraints_sampler_manager,
+                                                                     const reachability_map::ReachabilityMapConstPtr &reachability_map) :
   ManipulationStage("reachable & valid pose filter"),
   planning_scene_(scene),
   collision_matrix_(collision_matrix),
-  constraints_sampler_manager_(constraints_sampler_manager)
+  constraints_sampler_manager_(constraints_sampler_manager),
+  reachability_map_(reachability_map)
 {
 }
 
@@ -102,11 +104,23 @@ bool pick_place::ReachableAndValidPoseFilter::isEndEffectorFree(const Manipulati
   return res.collision == false;
 }
 
+bool pick_place::ReachableAndValidPoseFilter::isPossiblyReachable(const ManipulationPlanPtr &plan, const robot_state::RobotState &token_state) const
+{
+  if (!reachability_map_ || reachability_map_->getIKLinkName() != plan->shared_data_->ik_link_->getName())
+    return true;
+  // the map is expressed in a frame of the group, whose position comes from the scene state
+  if (reachability_map_->isReachable(token_state.getGlobalLinkTransform(reachability_map_->getBaseFrame()).inverse() * plan->transformed_goal_pose_))
+    return true;
+  if (verbose_)
+    ROS_INFO_NAMED("manipulation", "Goal pose is outside the reachability map of group '%s'", reachability_map_->getGroupName().c_str());
+  return false;
+}
+
 bool pick_place::ReachableAndValidPoseFilter::evaluate(const ManipulationPlanPtr &plan) const
 {
   // initialize with scene state
   robot_state::RobotStatePtr token_state(new robot_state::RobotState(planning_scene_->getCurrentState()));
-  if (isEndEffectorFree(plan, *token_state))
+  if (isEndEffectorFree(plan, *token_state) && isPossiblyReachable(plan, *token_state))
   {
     // update the goal pose message if anything has changed; this is because the name of the frame in the input goal pose
     // can be that of objects in the collision world but most components are unaware of those transforms,
@@ -0,0 +1,169 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_MOVE_GROUP_CAPABILITY_EXECUTOR_
+#define MOVEIT_MOVE_GROUP_CAPABILITY_EXECUTOR_
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <map>
+
+namespace move_group
+{
+
+/** \brief Counters describing the traffic through a capability's callback queue */
+struct CallbackQueueStatistics
+{
+  CallbackQueueStatistics() :
+    enqueued(0),
+    processed(0),
+    depth(0),
+    max_depth(0),
+    total_wait_time(0.0),
+    max_wait_time(0.0),
+    total_execution_time(0.0),
+    max_execution_time(0.0)
+  {
+  }
+
+  /** \brief Number of callbacks added to the queue */
+  std::size_t enqueued;
+
+  /** \brief Number of callbacks that finished executing */
+  std::size_t processed;
+
+  /** \brief Number of callbacks currently waiting or executing */
+  std::size_t depth;
+
+  /** \brief Largest depth observed */
+  std::size_t max_depth;
+
+  /** \brief Time (seconds) callbacks spent in the queue before a thread picked them up */
+  double total_wait_time;
+  double max_wait_time;
+
+  /** \brief Time (seconds) spent executing callbacks */
+  double total_execution_time;
+  double max_execution_time;
+};
+
+/** \brief A callback queue that keeps track of its depth and of the latency of the callbacks it serves */
+class MonitoredCallbackQueue : public ros::CallbackQueue
+{
+public:
+
+  MonitoredCallbackQueue();
+
+  virtual void addCallback(const ros::CallbackInterfacePtr &callback, uint64_t owner_id = 0);
+
+  CallbackQueueStatistics getStatistics() const;
+
+  void resetStatistics();
+
+private:
+
+  class TimedCallback;
+  friend class TimedCallback;
+
+  void callbackStarted(const ros::WallTime &enqueued_at, const ros::WallTime &started_at);
+  void callbackFinished(const ros::WallTime &started_at, const ros::WallTime &finished_at);
+
+  mutable boost::mutex stats_lock_;
+  CallbackQueueStatistics stats_;
+};
+
+typedef boost::shared_ptr<MonitoredCallbackQueue> MonitoredCallbackQueuePtr;
+
+/** \brief Serves the ROS callbacks of move_group capabilities.
+
+    Each capability can be given its own callback queue, served by a dedicated pool of threads.
+    The size of the pool bounds the number of requests of that capability that are processed concurrently,
+    and a slow request for one capability (e.g., planning) does not delay the requests of other capabilities.
+    Capabilities configured with zero threads keep using the global callback queue. */
+class CapabilityExecutor
+{
+public:
+
+  /** \brief Configure the executor from the parameters in the namespace of \e node_handle:
+      - default_capability_threads (int, default 0): number of threads serving the queue of each capability; 0 means the global queue is used
+      - capability_threads/<CapabilityName> (int): overrides the default for a particular capability */
+  CapabilityExecutor(const ros::NodeHandle &node_handle = ros::NodeHandle("~"));
+  ~CapabilityExecutor();
+
+  /** \brief Get the number of threads that will serve \e capability_name (0 for the global queue) */
+  unsigned int getThreadCount(const std::string &capability_name) const;
+
+  /** \brief Get the callback queue to use for \e capability_name, or NULL if the global queue should be used.
+      The queue is created on first request but is not served until start() is called. */
+  ros::CallbackQueueInterface* getCallbackQueue(const std::string &capability_name);
+
+  /** \brief Start serving all the queues that were created */
+  void start();
+
+  /** \brief Stop serving the queues */
+  void stop();
+
+  /** \brief Get the statistics for the queue of a capability. Returns false if the capability does not have its own queue */
+  bool getStatistics(const std::string &capability_name, CallbackQueueStatistics &stats) const;
+
+  /** \brief Print the statistics of all queues to the ROS log */
+  void printStatistics() const;
+
+  /** \brief Periodically print the statistics of all queues; a period of 0 disables printing */
+  void setStatisticsPeriod(double period);
+
+private:
+
+  struct QueueData
+  {
+    unsigned int threads_;
+    MonitoredCallbackQueuePtr queue_;
+    boost::shared_ptr<ros::AsyncSpinner> spinner_;
+  };
+
+  void statisticsTimerCallback(const ros::WallTimerEvent &event);
+
+  ros::NodeHandle node_handle_;
+  int default_threads_;
+  std::map<std::string, QueueData> queues_;
+  ros::WallTimer statistics_timer_;
+};
+
+typedef boost::shared_ptr<CapabilityExecutor> CapabilityExecutorPtr;
+
+}
+
+#endif
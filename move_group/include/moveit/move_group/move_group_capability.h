@@ -69,6 +69,10 @@ public:
 
   void setContext(const MoveGroupContextPtr &context);
 
+  /** \brief Set the callback queue the services and actions of this capability are served from.
+      Must be called before initialize(); passing NULL keeps the global callback queue. */
+  void setCallbackQueue(ros::CallbackQueueInterface *queue);
+
   virtual void initialize() = 0;
 
   const std::string& getName() const
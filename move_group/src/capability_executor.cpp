@@ -0,0 +1,233 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/move_group/capability_executor.h>
+#include <sstream>
+
+namespace move_group
+{
+
+class MonitoredCallbackQueue::TimedCallback : public ros::CallbackInterface
+{
+public:
+
+  TimedCallback(MonitoredCallbackQueue *owner, const ros::CallbackInterfacePtr &callback) :
+    owner_(owner),
+    callback_(callback),
+    enqueued_at_(ros::WallTime::now()),
+    started_(false)
+  {
+  }
+
+  virtual CallResult call()
+  {
+    ros::WallTime start = ros::WallTime::now();
+    if (!started_)
+    {
+      owner_->callbackStarted(enqueued_at_, start);
+      started_ = true;
+    }
+    CallResult result = callback_->call();
+    if (result != TryAgain)
+      owner_->callbackFinished(start, ros::WallTime::now());
+    return result;
+  }
+
+  virtual bool ready()
+  {
+    return callback_->ready();
+  }
+
+private:
+
+  MonitoredCallbackQueue *owner_;
+  ros::CallbackInterfacePtr callback_;
+  ros::WallTime enqueued_at_;
+  bool started_;
+};
+
+}
+
+move_group::MonitoredCallbackQueue::MonitoredCallbackQueue() :
+  ros::CallbackQueue(true)
+{
+}
+
+void move_group::MonitoredCallbackQueue::addCallback(const ros::CallbackInterfacePtr &callback, uint64_t owner_id)
+{
+  {
+    boost::mutex::scoped_lock slock(stats_lock_);
+    stats_.enqueued++;
+    stats_.depth++;
+    if (stats_.depth > stats_.max_depth)
+      stats_.max_depth = stats_.depth;
+  }
+  ros::CallbackQueue::addCallback(ros::CallbackInterfacePtr(new TimedCallback(this, callback)), owner_id);
+}
+
+void move_group::MonitoredCallbackQueue::callbackStarted(const ros::WallTime &enqueued_at, const ros::WallTime &started_at)
+{
+  double wait = (started_at - enqueued_at).toSec();
+  boost::mutex::scoped_lock slock(stats_lock_);
+  stats_.total_wait_time += wait;
+  if (wait > stats_.max_wait_time)
+    stats_.max_wait_time = wait;
+}
+
+void move_group::MonitoredCallbackQueue::callbackFinished(const ros::WallTime &started_at, const ros::WallTime &finished_at)
+{
+  double exec = (finished_at - started_at).toSec();
+  boost::mutex::scoped_lock slock(stats_lock_);
+  stats_.processed++;
+  if (stats_.depth > 0)
+    stats_.depth--;
+  stats_.total_execution_time += exec;
+  if (exec > stats_.max_execution_time)
+    stats_.max_execution_time = exec;
+}
+
+move_group::CallbackQueueStatistics move_group::MonitoredCallbackQueue::getStatistics() const
+{
+  boost::mutex::scoped_lock slock(stats_lock_);
+  return stats_;
+}
+
+void move_group::MonitoredCallbackQueue::resetStatistics()
+{
+  boost::mutex::scoped_lock slock(stats_lock_);
+  std::size_t depth = stats_.depth;
+  stats_ = CallbackQueueStatistics();
+  stats_.depth = stats_.max_depth = depth;
+}
+
+move_group::CapabilityExecutor::CapabilityExecutor(const ros::NodeHandle &node_handle) :
+  node_handle_(node_handle)
+{
+  node_handle_.param("default_capability_threads", default_threads_, 0);
+  if (default_threads_ < 0)
+  {
+    ROS_WARN("Negative value for default_capability_threads; using the global callback queue");
+    default_threads_ = 0;
+  }
+}
+
+move_group::CapabilityExecutor::~CapabilityExecutor()
+{
+  stop();
+}
+
+unsigned int move_group::CapabilityExecutor::getThreadCount(const std::string &capability_name) const
+{
+  int threads = default_threads_;
+  node_handle_.getParam("capability_threads/" + capability_name, threads);
+  return threads > 0 ? threads : 0;
+}
+
+ros::CallbackQueueInterface* move_group::CapabilityExecutor::getCallbackQueue(const std::string &capability_name)
+{
+  std::map<std::string, QueueData>::iterator it = queues_.find(capability_name);
+  if (it != queues_.end())
+    return it->second.queue_.get();
+
+  unsigned int threads = getThreadCount(capability_name);
+  if (threads == 0)
+    return NULL;
+
+  QueueData &qd = queues_[capability_name];
+  qd.threads_ = threads;
+  qd.queue_.reset(new MonitoredCallbackQueue());
+  ROS_DEBUG("Capability '%s' will be served by %u thread(s)", capability_name.c_str(), threads);
+  return qd.queue_.get();
+}
+
+void move_group::CapabilityExecutor::start()
+{
+  for (std::map<std::string, QueueData>::iterator it = queues_.begin() ; it != queues_.end() ; ++it)
+    if (!it->second.spinner_)
+    {
+      it->second.spinner_.reset(new ros::AsyncSpinner(it->second.threads_, it->second.queue_.get()));
+      it->second.spinner_->start();
+    }
+}
+
+void move_group::CapabilityExecutor::stop()
+{
+  statistics_timer_.stop();
+  for (std::map<std::string, QueueData>::iterator it = queues_.begin() ; it != queues_.end() ; ++it)
+    if (it->second.spinner_)
+    {
+      it->second.spinner_->stop();
+      it->second.spinner_.reset();
+    }
+}
+
+bool move_group::CapabilityExecutor::getStatistics(const std::string &capability_name, CallbackQueueStatistics &stats) const
+{
+  std::map<std::string, QueueData>::const_iterator it = queues_.find(capability_name);
+  if (it == queues_.end())
+    return false;
+  stats = it->second.queue_->getStatistics();
+  return true;
+}
+
+void move_group::CapabilityExecutor::printStatistics() const
+{
+  if (queues_.empty())
+    return;
+  std::stringstream ss;
+  ss << "Capability callback queues:" << std::endl;
+  for (std::map<std::string, QueueData>::const_iterator it = queues_.begin() ; it != queues_.end() ; ++it)
+  {
+    CallbackQueueStatistics s = it->second.queue_->getStatistics();
+    double avg_wait = s.processed > 0 ? s.total_wait_time / s.processed : 0.0;
+    double avg_exec = s.processed > 0 ? s.total_execution_time / s.processed : 0.0;
+    ss << "  " << it->first << " [" << it->second.threads_ << " thread(s)]: "
+       << s.processed << "/" << s.enqueued << " processed, depth " << s.depth << " (max " << s.max_depth << "), "
+       << "wait " << avg_wait << "s avg / " << s.max_wait_time << "s max, "
+       << "execution " << avg_exec << "s avg / " << s.max_execution_time << "s max" << std::endl;
+  }
+  ROS_INFO_STREAM(ss.str());
+}
+
+void move_group::CapabilityExecutor::setStatisticsPeriod(double period)
+{
+  statistics_timer_.stop();
+  if (period > 0.0)
+    statistics_timer_ = node_handle_.createWallTimer(ros::WallDuration(period), &CapabilityExecutor::statisticsTimerCallback, this);
+}
+
+void move_group::CapabilityExecutor::statisticsTimerCallback(const ros::WallTimerEvent &event)
+{
+  printStatistics();
+}
@@ -39,14 +39,30 @@
 #include <moveit/kinematic_constraints/utils.h>
 #include <eigen_conversions/eigen_msg.h>
 #include <moveit/move_group/capability_names.h>
+#include <algorithm>
 
 move_group::MoveGroupKinematicsService::MoveGroupKinematicsService():
-  MoveGroupCapability("KinematicsService")
+  MoveGroupCapability("KinematicsService"),
+  batch_max_age_(0.0),
+  batch_max_size_(1000),
+  batch_requests_(0),
+  batch_count_(0)
 {
 }
 
 void move_group::MoveGroupKinematicsService::initialize()
 {
+  node_handle_.param("kinematics_service_batch_max_age", batch_max_age_, 0.0);
+  int batch_max_size;
+  node_handle_.param("kinematics_service_batch_max_size", batch_max_size, (int)batch_max_size_);
+  batch_max_size_ = std::max(batch_max_size, 1);
+  if (batch_max_age_ > 0.0)
+  {
+    context_->planning_scene_monitor_->enableSceneSnapshots(true);
+    ROS_INFO("IK and FK requests served concurrently share scene snapshots for up to %.3f seconds and %u requests",
+             batch_max_age_, batch_max_size_);
+  }
+
   fk_service_ = root_node_handle_.advertiseService(FK_SERVICE_NAME, &MoveGroupKinematicsService::computeFKService, this);
   ik_service_ = root_node_handle_.advertiseService(IK_SERVICE_NAME, &MoveGroupKinematicsService::computeIKService, this);
 }
@@ -64,6 +80,26 @@ bool isIKSolutionValid(const planning_scene::PlanningScene *planning_scene,
   return (!planning_scene || !planning_scene->isStateColliding(*state, jmg->getName())) &&
     (!constraint_set || constraint_set->decide(*state).satisfied);
 }
+
+/** Locks the data scene snapshots share with the monitor (the octree) for reading, while a request is served */
+class SnapshotReadLock
+{
+public:
+
+  SnapshotReadLock(planning_scene_monitor::PlanningSceneMonitor *psm) : psm_(psm)
+  {
+    psm_->lockSnapshotRead();
+  }
+
+  ~SnapshotReadLock()
+  {
+    psm_->unlockSnapshotRead();
+  }
+
+private:
+
+  planning_scene_monitor::PlanningSceneMonitor *psm_;
+};
 }
 
 void move_group::MoveGroupKinematicsService::computeIK(moveit_msgs::PositionIKRequest &req,
@@ -139,9 +175,68 @@ void move_group::MoveGroupKinematicsService::computeIK(moveit_msgs::PositionIKRe
     error_code.val = moveit_msgs::MoveItErrorCodes::INVALID_GROUP_NAME;
 }
 
+void move_group::MoveGroupKinematicsService::computeIK(moveit_msgs::GetPositionIK::Request &req, moveit_msgs::GetPositionIK::Response &res,
+                                                       const planning_scene::PlanningSceneConstPtr &scene) const
+{
+  robot_state::RobotState rs = scene->getCurrentState();
+  if (req.ik_request.avoid_collisions || !kinematic_constraints::isEmpty(req.ik_request.constraints))
+  {
+    kinematic_constraints::KinematicConstraintSet kset(scene->getRobotModel());
+    kset.add(req.ik_request.constraints, scene->getTransforms());
+    computeIK(req.ik_request, res.solution, res.error_code, rs, boost::bind(&isIKSolutionValid, req.ik_request.avoid_collisions ? scene.get() : NULL,
+                                                                            kset.empty() ? NULL : &kset, _1, _2, _3));
+  }
+  else
+    computeIK(req.ik_request, res.solution, res.error_code, rs);
+}
+
+move_group::MoveGroupKinematicsService::SceneSnapshotPtr move_group::MoveGroupKinematicsService::joinBatch()
+{
+  {
+    boost::mutex::scoped_lock slock(batch_lock_);
+    SceneSnapshotPtr snapshot = open_batch_.lock();
+    if (snapshot && snapshot->requests_ < batch_max_size_ && (ros::WallTime::now() - snapshot->created_).toSec() <= batch_max_age_)
+    {
+      snapshot->requests_++;
+      batch_requests_++;
+      return snapshot;
+    }
+  }
+
+  // the transforms are updated and the snapshot is taken without holding batch_lock_, so requests joining the open
+  // batch meanwhile do not wait for scene updates
+  context_->planning_scene_monitor_->updateSceneFrameTransforms();
+  planning_scene::PlanningSceneConstPtr scene = context_->planning_scene_monitor_->getPlanningSceneSnapshot();
+  if (!scene)
+    return SceneSnapshotPtr();
+  SceneSnapshotPtr snapshot(new SceneSnapshot(scene));
+  snapshot->requests_++;
+
+  boost::mutex::scoped_lock slock(batch_lock_);
+  open_batch_ = snapshot;
+  batch_requests_++;
+  batch_count_++;
+  if (batch_count_ % 1000 == 0)
+    ROS_DEBUG("Served %u kinematics requests in %u batches", (unsigned int)batch_requests_, (unsigned int)batch_count_);
+  return snapshot;
+}
+
 bool move_group::MoveGroupKinematicsService::computeIKService(moveit_msgs::GetPositionIK::Request &req, moveit_msgs::GetPositionIK::Response &res)
 {
-  context_->planning_scene_monitor_->updateFrameTransforms();
+  // requests served concurrently by the threads of this capability share the transform update and the scene lock;
+  // each one is answered as soon as its own solution is found
+  if (batch_max_age_ > 0.0)
+  {
+    SceneSnapshotPtr snapshot = joinBatch();
+    if (snapshot)
+    {
+      SnapshotReadLock lock(context_->planning_scene_monitor_.get());
+      computeIK(req, res, snapshot->scene_);
+      return true;
+    }
+  }
+
+  context_->planning_scene_monitor_->updateSceneFrameTransforms();
 
   // check if the planning scene needs to be kept locked; if so, call computeIK() in the scope of the lock
   if (req.ik_request.avoid_collisions || !kinematic_constraints::isEmpty(req.ik_request.constraints))
@@ -173,14 +268,31 @@ bool move_group::MoveGroupKinematicsService::computeFKService(moveit_msgs::GetPo
     return true;
   }
 
-  context_->planning_scene_monitor_->updateFrameTransforms();
+  if (batch_max_age_ > 0.0)
+  {
+    SceneSnapshotPtr snapshot = joinBatch();
+    if (snapshot)
+    {
+      robot_state::RobotState rs = snapshot->scene_->getCurrentState();
+      computeFK(req, res, rs);
+      return true;
+    }
+  }
 
+  context_->planning_scene_monitor_->updateSceneFrameTransforms();
+  robot_state::RobotState rs = planning_scene_monitor::LockedPlanningSceneRO(context_->planning_scene_monitor_)->getCurrentState();
+  computeFK(req, res, rs);
+  return true;
+}
+
+void move_group::MoveGroupKinematicsService::computeFK(moveit_msgs::GetPositionFK::Request &req, moveit_msgs::GetPositionFK::Response &res,
+                                                       robot_state::RobotState &rs) const
+{
   const std::string &default_frame = context_->planning_scene_monitor_->getRobotModel()->getModelFrame();
   bool do_transform = !req.header.frame_id.empty() && !robot_state::Transforms::sameFrame(req.header.frame_id, default_frame)
     && context_->planning_scene_monitor_->getTFClient();
   bool tf_problem = false;
 
-  robot_state::RobotState rs = planning_scene_monitor::LockedPlanningSceneRO(context_->planning_scene_monitor_)->getCurrentState();
   robot_state::robotStateMsgToRobotState(req.robot_state, rs);
   for (std::size_t i = 0 ; i < req.fk_link_names.size() ; ++i)
     if (rs.getRobotModel()->hasLinkModel(req.fk_link_names[i]))
@@ -201,7 +313,6 @@ bool move_group::MoveGroupKinematicsService::computeFKService(moveit_msgs::GetPo
       res.error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
     else
       res.error_code.val = moveit_msgs::MoveItErrorCodes::INVALID_LINK_NAME;
-  return true;
 }
 
 #include <class_loader/class_loader.h>
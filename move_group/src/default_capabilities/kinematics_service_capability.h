@@ -40,6 +40,8 @@
 #include <moveit/move_group/move_group_capability.h>
 #include <moveit_msgs/GetPositionIK.h>
 #include <moveit_msgs/GetPositionFK.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/weak_ptr.hpp>
 
 namespace move_group
 {
@@ -54,15 +56,53 @@ public:
 
 private:
 
+  /** \brief An immutable snapshot of the planning scene, shared by the requests of one batch. It holds no lock on the
+      scene; only the octree it shares with the monitor is locked, by each request while it is served. */
+  struct SceneSnapshot
+  {
+    SceneSnapshot(const planning_scene::PlanningSceneConstPtr &scene) :
+      scene_(scene),
+      created_(ros::WallTime::now()),
+      requests_(0)
+    {
+    }
+
+    planning_scene::PlanningSceneConstPtr scene_;
+    ros::WallTime created_;
+    unsigned int requests_;
+  };
+  typedef boost::shared_ptr<SceneSnapshot> SceneSnapshotPtr;
+
   bool computeIKService(moveit_msgs::GetPositionIK::Request &req, moveit_msgs::GetPositionIK::Response &res);
   bool computeFKService(moveit_msgs::GetPositionFK::Request &req, moveit_msgs::GetPositionFK::Response &res);
 
   void computeIK(moveit_msgs::PositionIKRequest &req, moveit_msgs::RobotState &solution, moveit_msgs::MoveItErrorCodes &error_code,
                  robot_state::RobotState &rs, const robot_state::GroupStateValidityCallbackFn &constraint = robot_state::GroupStateValidityCallbackFn()) const;
 
+  /** \brief Answer an IK request from a scene that is already locked, checking collisions and constraints if requested */
+  void computeIK(moveit_msgs::GetPositionIK::Request &req, moveit_msgs::GetPositionIK::Response &res,
+                 const planning_scene::PlanningSceneConstPtr &scene) const;
+
+  void computeFK(moveit_msgs::GetPositionFK::Request &req, moveit_msgs::GetPositionFK::Response &res,
+                 robot_state::RobotState &rs) const;
+
+  /** \brief Get the snapshot of the batch currently being served, or update the transforms and take a snapshot of
+      the scene for a new batch if there is none, it is full or it is too old. Return an empty pointer if the monitor
+      does not maintain snapshots. */
+  SceneSnapshotPtr joinBatch();
+
   ros::ServiceServer fk_service_;
   ros::ServiceServer ik_service_;
 
+  /** \brief Batch mode: requests that arrive while another request is being served share its scene snapshot
+      for up to batch_max_age_ seconds and batch_max_size_ requests; disabled if batch_max_age_ is 0.
+      Batch mode makes the monitor maintain snapshots of the scene. */
+  double batch_max_age_;
+  unsigned int batch_max_size_;
+  boost::mutex batch_lock_;
+  boost::weak_ptr<SceneSnapshot> open_batch_;
+  std::size_t batch_requests_;
+  std::size_t batch_count_;
 };
 
 }
@@ -174,7 +174,7 @@ bool move_group::MoveGroupMoveAction::planUsingPlanningPipeline(const planning_i
   planning_interface::MotionPlanResponse res;
   try
   {
-    solved = context_->planning_pipeline_->generatePlan(plan.planning_scene_, req, res);
+    solved = context_->planning_pipeline_->generatePlan(lscene.getSceneForReading(plan.planning_scene_), req, res);
   }
   catch(std::runtime_error &ex)
   {
@@ -37,6 +37,7 @@
 #include <moveit/planning_scene_monitor/planning_scene_monitor.h>
 #include <tf/transform_listener.h>
 #include <moveit/move_group/move_group_capability.h>
+#include <moveit/move_group/capability_executor.h>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/tokenizer.hpp>
 #include <moveit/macros/console_colors.h>
@@ -60,13 +61,23 @@ public:
 
     context_.reset(new MoveGroupContext(psm, allow_trajectory_execution, debug));
 
+    // capabilities may be served by their own callback queues & threads
+    executor_.reset(new CapabilityExecutor(node_handle_));
+
     // start the capabilities
     configureCapabilities();
+
+    executor_->start();
+    double statistics_period;
+    node_handle_.param("capability_statistics_period", statistics_period, debug ? 10.0 : 0.0);
+    executor_->setStatisticsPeriod(statistics_period);
   }
 
   ~MoveGroupExe()
   {
+    executor_->stop();
     capabilities_.clear();
+    executor_.reset();
     context_.reset();
     capability_plugin_loader_.reset();
   }
@@ -116,6 +127,7 @@ private:
           printf(MOVEIT_CONSOLE_COLOR_CYAN "Loading '%s'...\n" MOVEIT_CONSOLE_COLOR_RESET, plugin.c_str());
           MoveGroupCapability *cap = capability_plugin_loader_->createUnmanagedInstance(plugin);
           cap->setContext(context_);
+          cap->setCallbackQueue(executor_->getCallbackQueue(cap->getName()));
           cap->initialize();
           capabilities_.push_back(boost::shared_ptr<MoveGroupCapability>(cap));
         }
@@ -132,13 +144,20 @@ private:
     ss << "********************************************************" << std::endl;
     ss << "* MoveGroup using: " << std::endl;
     for (std::size_t i = 0 ; i < capabilities_.size() ; ++i)
-      ss << "*     - " << capabilities_[i]->getName() << std::endl;
+    {
+      ss << "*     - " << capabilities_[i]->getName();
+      unsigned int threads = executor_->getThreadCount(capabilities_[i]->getName());
+      if (threads > 0)
+        ss << " (" << threads << " thread" << (threads > 1 ? "s" : "") << ")";
+      ss << std::endl;
+    }
     ss << "********************************************************" << std::endl;
     ROS_INFO_STREAM(ss.str());
   }
 
   ros::NodeHandle node_handle_;
   MoveGroupContextPtr context_;
+  CapabilityExecutorPtr executor_;
   boost::shared_ptr<pluginlib::ClassLoader<MoveGroupCapability> > capability_plugin_loader_;
   std::vector<boost::shared_ptr<MoveGroupCapability> > capabilities_;
 };
@@ -42,6 +42,12 @@ void move_group::MoveGroupCapability::setContext(const MoveGroupContextPtr &cont
   context_ = context;
 }
 
+void move_group::MoveGroupCapability::setCallbackQueue(ros::CallbackQueueInterface *queue)
+{
+  root_node_handle_.setCallbackQueue(queue);
+  node_handle_.setCallbackQueue(queue);
+}
+
 void move_group::MoveGroupCapability::convertToMsg(const std::vector<plan_execution::ExecutableTrajectory> &trajectory,
                                                    moveit_msgs::RobotState &first_state_msg, std::vector<moveit_msgs::RobotTrajectory> &trajectory_msg) const
 {
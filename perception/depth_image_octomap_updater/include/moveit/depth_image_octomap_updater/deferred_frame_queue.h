@@ -0,0 +1,143 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_PERCEPTION_DEPTH_IMAGE_OCTOMAP_UPDATER_DEFERRED_FRAME_QUEUE_
+#define MOVEIT_PERCEPTION_DEPTH_IMAGE_OCTOMAP_UPDATER_DEFERRED_FRAME_QUEUE_
+
+#include <tf/tf.h>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+#include <boost/signals2/connection.hpp>
+#include <deque>
+
+namespace occupancy_map_monitor
+{
+
+/** \brief Holds sensor frames until tf can transform them into the map frame, instead of waiting for the transform
+ *  in the subscriber callback. Frames are kept ordered by time stamp. A thread is woken up whenever tf receives new
+ *  transforms and passes the frames whose transform became available, oldest first, to their callbacks. Frames that
+ *  wait longer than a deadline are dropped. */
+class DeferredFrameQueue
+{
+public:
+
+  /** \brief Process a frame, given the transform from its sensor frame to the target frame */
+  typedef boost::function<void(const tf::StampedTransform&)> FrameCallback;
+
+  /** \brief Constructor. At most \e max_frames frames are held; when the queue is full, the oldest frame is dropped.
+   *  Frames waiting more than \e deadline seconds are dropped as well. */
+  DeferredFrameQueue(const boost::shared_ptr<tf::Transformer> &tf, unsigned int max_frames = 5, double deadline = 0.5);
+  ~DeferredFrameQueue();
+
+  /** \brief Start listening to tf and processing frames in a separate thread */
+  void start();
+
+  /** \brief Stop processing frames and discard the ones still waiting */
+  void stop();
+
+  /** \brief Add a frame taken at \e stamp in \e source_frame; \e callback is called with the transform
+   *  to \e target_frame once tf can provide it. \e received is when the frame was received. */
+  void pushFrame(const std::string &target_frame, const std::string &source_frame, const ros::Time &stamp,
+                 const FrameCallback &callback, const ros::WallTime &received = ros::WallTime::now());
+
+  /** \brief Drop the frames that exceeded the deadline and process the ones whose transform is available, in the order
+   *  of their time stamps. This is called by the processing thread; it can also be called directly if start() was not. */
+  void processFrames();
+
+  /** \brief The number of frames waiting for their transform */
+  std::size_t getPendingFrameCount() const;
+
+  /** \brief The number of frames whose transform was not available when they were received */
+  std::size_t getDeferredFrameCount() const;
+
+  /** \brief The number of frames passed to their callback */
+  std::size_t getProcessedFrameCount() const;
+
+  /** \brief The number of frames dropped because they exceeded the deadline */
+  std::size_t getExpiredFrameCount() const;
+
+  /** \brief The number of frames dropped because the queue was full */
+  std::size_t getDroppedFrameCount() const;
+
+  /** \brief The average time in seconds processed frames waited in the queue */
+  double getAverageLatency() const;
+
+  /** \brief The longest time in seconds a processed frame waited in the queue */
+  double getMaxLatency() const;
+
+private:
+
+  struct Frame
+  {
+    std::string target_frame_;
+    std::string source_frame_;
+    ros::Time stamp_;
+    ros::WallTime received_;
+    FrameCallback callback_;
+  };
+
+  static bool stampLess(const Frame &a, const Frame &b)
+  {
+    return a.stamp_ < b.stamp_;
+  }
+
+  bool lookupTransform(const Frame &frame, tf::StampedTransform &transform) const;
+  void transformsChanged();
+  void processThread();
+
+  boost::shared_ptr<tf::Transformer> tf_;
+  std::size_t max_frames_;
+  double deadline_;
+  bool running_;
+  bool tf_changed_;
+
+  std::deque<Frame> frames_;
+  std::size_t deferred_frames_;
+  std::size_t processed_frames_;
+  std::size_t expired_frames_;
+  std::size_t dropped_frames_;
+  double total_latency_;
+  double max_latency_;
+  mutable boost::mutex frames_lock_;
+  boost::condition_variable process_condition_;
+
+  // only one thread processes frames at a time, so callbacks are called in order
+  boost::mutex process_lock_;
+  boost::signals2::connection tf_connection_;
+  boost::thread process_thread_;
+};
+
+}
+
+#endif
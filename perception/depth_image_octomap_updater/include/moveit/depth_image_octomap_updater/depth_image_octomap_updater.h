@@ -43,6 +43,8 @@
 #include <moveit/mesh_filter/mesh_filter.h>
 #include <moveit/mesh_filter/stereo_camera_model.h>
 #include <moveit/lazy_free_space_updater/lazy_free_space_updater.h>
+#include <moveit/depth_image_octomap_updater/depth_image_projector.h>
+#include <moveit/depth_image_octomap_updater/deferred_frame_queue.h>
 #include <image_transport/image_transport.h>
 #include <boost/scoped_ptr.hpp>
 
@@ -65,6 +67,8 @@ public:
 private:
 
   void depthImageCallback(const sensor_msgs::ImageConstPtr& depth_msg, const sensor_msgs::CameraInfoConstPtr& info_msg);
+  void processDepthImage(const sensor_msgs::ImageConstPtr& depth_msg, const sensor_msgs::CameraInfoConstPtr& info_msg,
+                         const tf::StampedTransform &map_H_sensor);
   bool getShapeTransform(mesh_filter::MeshHandle h, Eigen::Affine3d &transform) const;
   void stopHelper();
 
@@ -83,6 +87,7 @@ private:
   std::string filtered_cloud_topic_;
   std::string sensor_type_;
   std::string image_topic_;
+  std::string render_backend_;
   std::size_t queue_size_;
   double near_clipping_plane_distance_;
   double far_clipping_plane_distance_;
@@ -91,6 +96,8 @@ private:
   double padding_offset_;
   unsigned int skip_vertical_pixels_;
   unsigned int skip_horizontal_pixels_;
+  unsigned int deferred_frames_;
+  double deferred_frame_deadline_;
 
   unsigned int image_callback_count_;
   double average_callback_dt_;
@@ -100,8 +107,16 @@ private:
   boost::scoped_ptr<mesh_filter::MeshFilter<mesh_filter::StereoCameraModel> > mesh_filter_;
   boost::scoped_ptr<LazyFreeSpaceUpdater> free_space_updater_;
 
-  std::vector<float> x_cache_, y_cache_;
-  double inv_fx_, inv_fy_, K0_, K2_, K4_, K5_;
+  /* if set, images whose transform is not yet available wait here instead of in the subscriber callback */
+  boost::scoped_ptr<DeferredFrameQueue> deferred_queue_;
+
+  /* back-projects the pixels in parallel; the cells of the pixels and the filtered depth are kept between
+     images to avoid reallocating them */
+  DepthImageProjector projector_;
+  std::vector<octomap::OcTreeKey> occupied_keys_;
+  std::vector<octomap::OcTreeKey> model_keys_;
+  std::vector<octomap::OcTreeKey> free_keys_;
+  std::vector<float> filtered_data_;
   std::vector<unsigned int> filtered_labels_;
   ros::WallTime last_depth_callback_start_;
 
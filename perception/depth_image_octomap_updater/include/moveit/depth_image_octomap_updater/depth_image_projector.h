@@ -0,0 +1,134 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#ifndef MOVEIT_PERCEPTION_DEPTH_IMAGE_OCTOMAP_UPDATER_DEPTH_IMAGE_PROJECTOR_
+#define MOVEIT_PERCEPTION_DEPTH_IMAGE_OCTOMAP_UPDATER_DEPTH_IMAGE_PROJECTOR_
+
+#include <octomap/octomap.h>
+#include <Eigen/Geometry>
+#include <boost/cstdint.hpp>
+#include <stdint.h>
+#include <vector>
+
+namespace occupancy_map_monitor
+{
+
+/** \brief Back-projects the pixels of a filtered depth image into the map and computes the octree cells they fall in.
+ *  The rows of the image are split among threads. Each thread back-projects one row at a time into a local buffer,
+ *  transforms the row with one matrix product and collects the cells not already seen in the previous row in a local
+ *  array; the arrays are then sorted and merged. The result is the same as back-projecting and inserting each pixel serially. */
+class DepthImageProjector
+{
+public:
+
+  /** \brief Use \e threads threads; 0 means the default number of OpenMP threads */
+  DepthImageProjector(unsigned int threads = 0);
+
+  void setThreadCount(unsigned int threads);
+
+  /** \brief The number of threads actually used */
+  unsigned int getThreadCount() const;
+
+  /** \brief Set the intrinsics of the camera (the focal lengths \e fx, \e fy and the principal point \e px, \e py)
+   *  and the size of the images. The back-projection factors of the pixels are only recomputed if these changed.
+   *  Return false if any of the parameters is NaN. */
+  bool setCameraParameters(double fx, double fy, double px, double py, unsigned int width, unsigned int height);
+
+  /** \brief Compute the cells of the pixels of a 16UC1 image (depth in millimeters), excluding \e skip_vertical rows
+   *  at the top and bottom and \e skip_horizontal columns at the left and right of the image. Pixels labeled
+   *  mesh_filter::MeshFilterBase::Background by the mesh filter go in \e occupied, pixels labeled FarClip or a
+   *  mesh label go in \e model. Both are free of duplicates and sorted by packKey(). The tree needs to be locked
+   *  for reading. */
+  void computeKeys(const octomap::OcTree &tree, const uint16_t *depth, const unsigned int *labels,
+                   unsigned int skip_vertical, unsigned int skip_horizontal, const Eigen::Affine3d &map_H_sensor,
+                   std::vector<octomap::OcTreeKey> &occupied, std::vector<octomap::OcTreeKey> &model);
+
+  /** \brief Same as above, for a 32FC1 image (depth in meters) */
+  void computeKeys(const octomap::OcTree &tree, const float *depth, const unsigned int *labels,
+                   unsigned int skip_vertical, unsigned int skip_horizontal, const Eigen::Affine3d &map_H_sensor,
+                   std::vector<octomap::OcTreeKey> &occupied, std::vector<octomap::OcTreeKey> &model);
+
+  static boost::uint64_t packKey(const octomap::OcTreeKey &key)
+  {
+    return ((boost::uint64_t)key[0] << 32) | ((boost::uint64_t)key[1] << 16) | (boost::uint64_t)key[2];
+  }
+
+  static octomap::OcTreeKey unpackKey(boost::uint64_t packed)
+  {
+    return octomap::OcTreeKey((octomap::key_type)(packed >> 32), (octomap::key_type)(packed >> 16), (octomap::key_type)packed);
+  }
+
+  /** \brief The order of the keys computed by computeKeys() */
+  static bool keyLess(const octomap::OcTreeKey &a, const octomap::OcTreeKey &b)
+  {
+    return packKey(a) < packKey(b);
+  }
+
+private:
+
+  /** \brief The points of one row of the image and the cells they fall in, per thread */
+  struct ThreadData
+  {
+    Eigen::Matrix3Xd occupied_points_;
+    Eigen::Matrix3Xd model_points_;
+    Eigen::Matrix3Xd transformed_;
+    std::vector<boost::uint64_t> row_;
+    std::vector<boost::uint64_t> previous_occupied_;
+    std::vector<boost::uint64_t> previous_model_;
+    std::vector<boost::uint64_t> occupied_;
+    std::vector<boost::uint64_t> model_;
+  };
+
+  template<typename T>
+  void computeKeysImpl(const octomap::OcTree &tree, const T *depth, const unsigned int *labels,
+                       unsigned int skip_vertical, unsigned int skip_horizontal, const Eigen::Affine3d &map_H_sensor,
+                       std::vector<octomap::OcTreeKey> &occupied, std::vector<octomap::OcTreeKey> &model);
+
+  /** \brief Merge the sorted per thread arrays selected by \e member into \e keys */
+  void merge(std::vector<boost::uint64_t> ThreadData::*member, int threads, std::vector<octomap::OcTreeKey> &keys);
+
+  unsigned int threads_;
+  std::vector<ThreadData> thread_data_;
+  std::vector<boost::uint64_t> merged_;
+  std::vector<boost::uint64_t> merge_buffer_;
+
+  double fx_, fy_, px_, py_;
+  unsigned int width_, height_;
+  std::vector<float> x_cache_, y_cache_;
+};
+
+}
+
+#endif
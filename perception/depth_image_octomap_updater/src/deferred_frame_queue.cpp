@@ -0,0 +1,251 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/depth_image_octomap_updater/deferred_frame_queue.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+
+namespace occupancy_map_monitor
+{
+
+DeferredFrameQueue::DeferredFrameQueue(const boost::shared_ptr<tf::Transformer> &tf, unsigned int max_frames, double deadline) :
+  tf_(tf),
+  max_frames_(std::max(1u, max_frames)),
+  deadline_(deadline),
+  running_(false),
+  tf_changed_(false),
+  deferred_frames_(0),
+  processed_frames_(0),
+  expired_frames_(0),
+  dropped_frames_(0),
+  total_latency_(0.0),
+  max_latency_(0.0)
+{
+}
+
+DeferredFrameQueue::~DeferredFrameQueue()
+{
+  stop();
+}
+
+void DeferredFrameQueue::start()
+{
+  boost::mutex::scoped_lock _(frames_lock_);
+  if (running_)
+    return;
+  running_ = true;
+  tf_connection_ = tf_->addTransformsChangedListener(boost::bind(&DeferredFrameQueue::transformsChanged, this));
+  process_thread_ = boost::thread(boost::bind(&DeferredFrameQueue::processThread, this));
+}
+
+void DeferredFrameQueue::stop()
+{
+  {
+    boost::mutex::scoped_lock _(frames_lock_);
+    if (!running_)
+      return;
+    running_ = false;
+    process_condition_.notify_one();
+  }
+  tf_->removeTransformsChangedListener(tf_connection_);
+  process_thread_.join();
+
+  boost::mutex::scoped_lock _(frames_lock_);
+  frames_.clear();
+}
+
+void DeferredFrameQueue::pushFrame(const std::string &target_frame, const std::string &source_frame, const ros::Time &stamp,
+                                   const FrameCallback &callback, const ros::WallTime &received)
+{
+  Frame frame;
+  frame.target_frame_ = target_frame;
+  frame.source_frame_ = source_frame;
+  frame.stamp_ = stamp;
+  frame.received_ = received;
+  frame.callback_ = callback;
+  const bool available = tf_->canTransform(target_frame, source_frame, stamp);
+
+  boost::mutex::scoped_lock _(frames_lock_);
+  if (!available)
+    deferred_frames_++;
+  if (frames_.size() >= max_frames_)
+  {
+    ROS_DEBUG("Dropping frame at time %lf waiting for its transform: too many frames are waiting", frames_.front().stamp_.toSec());
+    frames_.pop_front();
+    dropped_frames_++;
+  }
+  // frames usually arrive in order, so this is almost always an insertion at the end
+  frames_.insert(std::upper_bound(frames_.begin(), frames_.end(), frame, &DeferredFrameQueue::stampLess), frame);
+  tf_changed_ = true;
+  process_condition_.notify_one();
+}
+
+bool DeferredFrameQueue::lookupTransform(const Frame &frame, tf::StampedTransform &transform) const
+{
+  if (!tf_->canTransform(frame.target_frame_, frame.source_frame_, frame.stamp_))
+    return false;
+  try
+  {
+    tf_->lookupTransform(frame.target_frame_, frame.source_frame_, frame.stamp_, transform);
+  }
+  catch (tf::TransformException &)
+  {
+    return false;
+  }
+  return true;
+}
+
+void DeferredFrameQueue::processFrames()
+{
+  boost::mutex::scoped_lock process_lock(process_lock_);
+  while (true)
+  {
+    Frame frame;
+    {
+      boost::mutex::scoped_lock _(frames_lock_);
+
+      // drop the frames that waited too long
+      const ros::WallTime now = ros::WallTime::now();
+      std::size_t expired = 0;
+      for (std::deque<Frame>::iterator it = frames_.begin() ; it != frames_.end() ; )
+        if ((now - it->received_).toSec() > deadline_)
+        {
+          it = frames_.erase(it);
+          expired++;
+        }
+        else
+          ++it;
+      if (expired > 0)
+      {
+        expired_frames_ += expired;
+        ROS_WARN_THROTTLE(1, "Dropped %u frames whose transform was not available within %lf seconds", (unsigned int)expired, deadline_);
+      }
+      if (frames_.empty())
+        return;
+      frame = frames_.front();
+    }
+
+    // tf is not called with the lock held, since tf notifies transformsChanged();
+    // later frames need later transforms, so stop at the first frame that cannot be transformed yet
+    tf::StampedTransform transform;
+    if (!lookupTransform(frame, transform))
+      return;
+
+    {
+      boost::mutex::scoped_lock _(frames_lock_);
+      // an older frame may have been pushed, or the frame dropped, in the meantime
+      if (frames_.empty() || frames_.front().stamp_ != frame.stamp_ || frames_.front().received_ != frame.received_)
+        continue;
+      frames_.pop_front();
+
+      const double latency = (ros::WallTime::now() - frame.received_).toSec();
+      total_latency_ += latency;
+      max_latency_ = std::max(max_latency_, latency);
+      processed_frames_++;
+    }
+    frame.callback_(transform);
+  }
+}
+
+void DeferredFrameQueue::transformsChanged()
+{
+  boost::mutex::scoped_lock _(frames_lock_);
+  if (!frames_.empty())
+  {
+    tf_changed_ = true;
+    process_condition_.notify_one();
+  }
+}
+
+void DeferredFrameQueue::processThread()
+{
+  // wake up periodically as well, to drop expired frames when tf stops
+  const boost::posix_time::milliseconds period(std::max(1, (int)(deadline_ * 250.0)));
+  while (true)
+  {
+    {
+      boost::unique_lock<boost::mutex> ulock(frames_lock_);
+      if (running_ && !tf_changed_)
+        process_condition_.timed_wait(ulock, period);
+      if (!running_)
+        break;
+      tf_changed_ = false;
+    }
+    processFrames();
+  }
+}
+
+std::size_t DeferredFrameQueue::getPendingFrameCount() const
+{
+  boost::mutex::scoped_lock _(frames_lock_);
+  return frames_.size();
+}
+
+std::size_t DeferredFrameQueue::getDeferredFrameCount() const
+{
+  boost::mutex::scoped_lock _(frames_lock_);
+  return deferred_frames_;
+}
+
+std::size_t DeferredFrameQueue::getProcessedFrameCount() const
+{
+  boost::mutex::scoped_lock _(frames_lock_);
+  return processed_frames_;
+}
+
+std::size_t DeferredFrameQueue::getExpiredFrameCount() const
+{
+  boost::mutex::scoped_lock _(frames_lock_);
+  return expired_frames_;
+}
+
+std::size_t DeferredFrameQueue::getDroppedFrameCount() const
+{
+  boost::mutex::scoped_lock _(frames_lock_);
+  return dropped_frames_;
+}
+
+double DeferredFrameQueue::getAverageLatency() const
+{
+  boost::mutex::scoped_lock _(frames_lock_);
+  return processed_frames_ > 0 ? total_latency_ / processed_frames_ : 0.0;
+}
+
+double DeferredFrameQueue::getMaxLatency() const
+{
+  boost::mutex::scoped_lock _(frames_lock_);
+  return max_latency_;
+}
+
+}
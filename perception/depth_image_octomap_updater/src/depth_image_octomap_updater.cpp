@@ -38,8 +38,11 @@
 #include <moveit/occupancy_map_monitor/occupancy_map_monitor.h>
 #include <geometric_shapes/shape_operations.h>
 #include <sensor_msgs/image_encodings.h>
+#include <tf_conversions/tf_eigen.h>
 #include <XmlRpcException.h>
 #include <stdint.h>
+#include <algorithm>
+#include <iterator>
 
 namespace occupancy_map_monitor
 {
@@ -52,6 +55,7 @@ DepthImageOctomapUpdater::DepthImageOctomapUpdater() :
   filtered_depth_transport_(nh_),
   filtered_label_transport_(nh_),
   image_topic_("depth"),
+  render_backend_("opengl"),
   queue_size_(5),
   near_clipping_plane_distance_(0.3),
   far_clipping_plane_distance_(5.0),
@@ -60,11 +64,12 @@ DepthImageOctomapUpdater::DepthImageOctomapUpdater() :
   padding_offset_(0.02),
   skip_vertical_pixels_(4),
   skip_horizontal_pixels_(6),
+  deferred_frames_(0),
+  deferred_frame_deadline_(0.5),
   image_callback_count_(0),
   average_callback_dt_(0.0),
   good_tf_(5), // start optimistically, so we do not output warnings right from the beginning
-  failed_tf_(0),
-  K0_(0.0), K2_(0.0), K4_(0.0), K5_(0.0)
+  failed_tf_(0)
 {
 }
 
@@ -90,8 +95,15 @@ bool DepthImageOctomapUpdater::setParams(XmlRpc::XmlRpcValue &params)
     readXmlParam(params, "padding_offset", &padding_offset_);
     readXmlParam(params, "skip_vertical_pixels", &skip_vertical_pixels_);
     readXmlParam(params, "skip_horizontal_pixels", &skip_horizontal_pixels_);
+    unsigned int projection_threads = 0;
+    readXmlParam(params, "projection_threads", &projection_threads);
+    projector_.setThreadCount(projection_threads);
+    readXmlParam(params, "deferred_frames", &deferred_frames_);
+    readXmlParam(params, "deferred_frame_deadline", &deferred_frame_deadline_);
     if (params.hasMember("filtered_cloud_topic"))
       filtered_cloud_topic_ = static_cast<const std::string&>(params["filtered_cloud_topic"]);
+    if (params.hasMember("render_backend"))
+      render_backend_ = static_cast<const std::string&>(params["render_backend"]);
   }
   catch (XmlRpc::XmlRpcException &ex)
   {
@@ -106,10 +118,23 @@ bool DepthImageOctomapUpdater::initialize()
 {
   tf_ = monitor_->getTFClient();
   free_space_updater_.reset(new LazyFreeSpaceUpdater(tree_));
-
-  // create our mesh filter
+  if (tf_ && deferred_frames_ > 0)
+    deferred_queue_.reset(new DeferredFrameQueue(tf_, deferred_frames_, deferred_frame_deadline_));
+
+  // create our mesh filter; the software backend does not need a display
+  mesh_filter::MeshFilterBase::RenderBackend backend;
+  if (render_backend_ == "opengl")
+    backend = mesh_filter::MeshFilterBase::OpenGLBackend;
+  else if (render_backend_ == "software")
+    backend = mesh_filter::MeshFilterBase::SoftwareBackend;
+  else
+  {
+    ROS_ERROR("Unknown render backend '%s'. Expected 'opengl' or 'software'", render_backend_.c_str());
+    return false;
+  }
   mesh_filter_.reset(new mesh_filter::MeshFilter<mesh_filter::StereoCameraModel>(mesh_filter::MeshFilterBase::TransformCallback(),
-                                                                                 mesh_filter::StereoCameraModel::RegisteredPSDKParams));
+                                                                                 mesh_filter::StereoCameraModel::RegisteredPSDKParams,
+                                                                                 backend));
   mesh_filter_->parameters().setDepthRange(near_clipping_plane_distance_, far_clipping_plane_distance_);
   mesh_filter_->setShadowThreshold(shadow_threshold_);
   mesh_filter_->setPaddingOffset(padding_offset_);
@@ -131,6 +156,8 @@ void DepthImageOctomapUpdater::start()
 
   pub_filtered_label_image_ = filtered_label_transport_.advertiseCamera("filtered_label", 1);
 
+  if (deferred_queue_)
+    deferred_queue_->start();
   sub_depth_image_ = input_depth_transport_.subscribeCamera(image_topic_, queue_size_, &DepthImageOctomapUpdater::depthImageCallback, this, hints);
 }
 
@@ -142,6 +169,14 @@ void DepthImageOctomapUpdater::stop()
 void DepthImageOctomapUpdater::stopHelper()
 {
   sub_depth_image_.shutdown();
+  if (deferred_queue_)
+  {
+    deferred_queue_->stop();
+    ROS_DEBUG("Deferred depth images: %u deferred, %u processed, %u expired, %u dropped; average added latency %lf ms (max %lf ms)",
+              (unsigned int)deferred_queue_->getDeferredFrameCount(), (unsigned int)deferred_queue_->getProcessedFrameCount(),
+              (unsigned int)deferred_queue_->getExpiredFrameCount(), (unsigned int)deferred_queue_->getDroppedFrameCount(),
+              deferred_queue_->getAverageLatency() * 1000.0, deferred_queue_->getMaxLatency() * 1000.0);
+  }
 }
 
 mesh_filter::MeshHandle DepthImageOctomapUpdater::excludeShape(const shapes::ShapeConstPtr &shape)
@@ -171,13 +206,13 @@ void DepthImageOctomapUpdater::forgetShape(mesh_filter::MeshHandle handle)
 
 bool DepthImageOctomapUpdater::getShapeTransform(mesh_filter::MeshHandle h, Eigen::Affine3d &transform) const
 {
-  ShapeTransformCache::const_iterator it = transform_cache_.find(h);
-  if (it == transform_cache_.end())
+  const Eigen::Affine3d *t = transform_cache_.get(h);
+  if (!t)
   {
     ROS_ERROR("Internal error. Mesh filter handle %u not found", h);
     return false;
   }
-  transform = it->second;
+  transform = *t;
   return true;
 }
 
@@ -228,6 +263,13 @@ void DepthImageOctomapUpdater::depthImageCallback(const sensor_msgs::ImageConstP
     map_H_sensor.setIdentity();
   else
   {
+    if (deferred_queue_)
+    {
+      // do not wait for the transform here; the image is processed once tf provides it
+      deferred_queue_->pushFrame(monitor_->getMapFrame(), depth_msg->header.frame_id, depth_msg->header.stamp,
+                                 boost::bind(&DepthImageOctomapUpdater::processDepthImage, this, depth_msg, info_msg, _1));
+      return;
+    }
     if (tf_)
     {
       // wait at most 50ms
@@ -280,6 +322,14 @@ void DepthImageOctomapUpdater::depthImageCallback(const sensor_msgs::ImageConstP
       return;
   }
 
+  processDepthImage(depth_msg, info_msg, map_H_sensor);
+}
+
+void DepthImageOctomapUpdater::processDepthImage(const sensor_msgs::ImageConstPtr& depth_msg, const sensor_msgs::CameraInfoConstPtr& info_msg,
+                                                 const tf::StampedTransform &map_H_sensor)
+{
+  ros::WallTime start = ros::WallTime::now();
+
   if (!updateTransformCache(depth_msg->header.frame_id, depth_msg->header.stamp))
   {
     ROS_ERROR_THROTTLE(1, "Transform cache was not updated. Self-filtering may fail.");
@@ -312,52 +362,18 @@ void DepthImageOctomapUpdater::depthImageCallback(const sensor_msgs::ImageConstP
 
   // the mesh filter runs in background; compute extra things in the meantime
 
-  // Use correct principal point from calibration
-  const double px = info_msg->K[2];
-  const double py = info_msg->K[5];
-
-  // if the camera parameters have changed at all, recompute the cache we had
-  if (w >= x_cache_.size() || h >= y_cache_.size() || K2_ != px || K5_ != py || K0_ != info_msg->K[0] || K4_ != info_msg->K[4])
-  {
-    K2_ = px;
-    K5_ = py;
-    K0_ = info_msg->K[0];
-    K4_ = info_msg->K[4];
-
-    inv_fx_ = 1.0 / K0_;
-    inv_fy_ = 1.0 / K4_;
-
-    // if there are any NaNs, discard data
-    if (!(px == px && py == py && inv_fx_ == inv_fx_ && inv_fy_ == inv_fy_))
-      return;
-
-    // Pre-compute some constants
-    if (x_cache_.size() < w)
-      x_cache_.resize(w);
-    if (y_cache_.size() < h)
-      y_cache_.resize(h);
-
-    for (int x = 0; x < w; ++x)
-      x_cache_[x] = (x - px) * inv_fx_;
-
-    for (int y = 0; y < h; ++y)
-      y_cache_[y] = (y - py) * inv_fy_;
-  }
+  // if the camera parameters have changed at all, the projector recomputes its cache; if there are any NaNs, discard data
+  if (!projector_.setCameraParameters(info_msg->K[0], info_msg->K[4], info_msg->K[2], info_msg->K[5], w, h))
+    return;
 
   const octomap::point3d sensor_origin(map_H_sensor.getOrigin().getX(), map_H_sensor.getOrigin().getY(), map_H_sensor.getOrigin().getZ());
 
-  octomap::KeySet *occupied_cells_ptr = new octomap::KeySet();
-  octomap::KeySet *model_cells_ptr = new octomap::KeySet();
-  octomap::KeySet &occupied_cells = *occupied_cells_ptr;
-  octomap::KeySet &model_cells = *model_cells_ptr;
-
   // allocate memory if needed
   std::size_t img_size = h * w;
   if (filtered_labels_.size() < img_size)
     filtered_labels_.resize(img_size);
 
   // get the labels of the filtered data
-  const unsigned int* labels_row = &filtered_labels_ [0];
   mesh_filter_->getFilteredLabels(&filtered_labels_ [0]);
 
   // publish debug information if needed
@@ -401,7 +417,6 @@ void DepthImageOctomapUpdater::depthImageCallback(const sensor_msgs::ImageConstP
 
   if(!filtered_cloud_topic_.empty())
   {
-    static std::vector<float> filtered_data;
     sensor_msgs::Image filtered_msg;
     filtered_msg.header = depth_msg->header;
     filtered_msg.height = depth_msg->height;
@@ -410,84 +425,30 @@ void DepthImageOctomapUpdater::depthImageCallback(const sensor_msgs::ImageConstP
     filtered_msg.is_bigendian = depth_msg->is_bigendian;
     filtered_msg.step = depth_msg->step;
     filtered_msg.data.resize(img_size * sizeof(unsigned short));
-    if(filtered_data.size() < img_size)
-      filtered_data.resize(img_size);
-    mesh_filter_->getFilteredDepth(reinterpret_cast<float*>(&filtered_data[0]));
+    if(filtered_data_.size() < img_size)
+      filtered_data_.resize(img_size);
+    mesh_filter_->getFilteredDepth(reinterpret_cast<float*>(&filtered_data_[0]));
     unsigned short* tmp_ptr = (unsigned short*) &filtered_msg.data[0];
     for(std::size_t i=0; i < img_size; ++i)
     {
-      tmp_ptr[i] = (unsigned short) (filtered_data[i] * 1000 + 0.5);
+      tmp_ptr[i] = (unsigned short) (filtered_data_[i] * 1000 + 0.5);
     }
     pub_filtered_depth_image_.publish(filtered_msg, *info_msg);
   }
 
   // figure out occupied cells and model cells
+  Eigen::Affine3d map_H_sensor_eigen;
+  tf::transformTFToEigen(map_H_sensor, map_H_sensor_eigen);
   tree_->lockRead();
 
   try
   {
-    const int h_bound = h - skip_vertical_pixels_;
-    const int w_bound = w - skip_horizontal_pixels_;
-
     if (is_u_short)
-    {
-      const uint16_t *input_row = reinterpret_cast<const uint16_t*>(&depth_msg->data[0]);
-
-      for (int y = skip_vertical_pixels_ ; y < h_bound ; ++y, labels_row += w, input_row += w)
-        for (int x = skip_horizontal_pixels_ ; x < w_bound ; ++x)
-        {
-          // not filtered
-          if (labels_row [x] == mesh_filter::MeshFilterBase::Background)
-          {
-            float zz = (float)input_row[x] * 1e-3; // scale from mm to m
-            float yy = y_cache_[y] * zz;
-            float xx = x_cache_[x] * zz;
-            /* transform to map frame */
-            tf::Vector3 point_tf = map_H_sensor * tf::Vector3(xx, yy, zz);
-            occupied_cells.insert(tree_->coordToKey(point_tf.getX(), point_tf.getY(), point_tf.getZ()));
-          }
-          // on far plane or a model point -> remove
-          else if (labels_row [x] >= mesh_filter::MeshFilterBase::FarClip)
-          {
-            float zz = input_row[x] * 1e-3;
-            float yy = y_cache_[y] * zz;
-            float xx = x_cache_[x] * zz;
-            /* transform to map frame */
-            tf::Vector3 point_tf = map_H_sensor * tf::Vector3(xx, yy, zz);
-            // add to the list of model cells
-            model_cells.insert(tree_->coordToKey(point_tf.getX(), point_tf.getY(), point_tf.getZ()));
-          }
-        }
-    }
+      projector_.computeKeys(*tree_, reinterpret_cast<const uint16_t*>(&depth_msg->data[0]), &filtered_labels_[0],
+                             skip_vertical_pixels_, skip_horizontal_pixels_, map_H_sensor_eigen, occupied_keys_, model_keys_);
     else
-    {
-      const float *input_row = reinterpret_cast<const float*>(&depth_msg->data[0]);
-
-      for (int y = skip_vertical_pixels_ ; y < h_bound ; ++y, labels_row += w, input_row += w)
-        for (int x = skip_horizontal_pixels_ ; x < w_bound ; ++x)
-        {
-          if (labels_row [x] == mesh_filter::MeshFilterBase::Background)
-          {
-            float zz = input_row[x];
-            float yy = y_cache_[y] * zz;
-            float xx = x_cache_[x] * zz;
-            /* transform to map frame */
-            tf::Vector3 point_tf = map_H_sensor * tf::Vector3(xx, yy, zz);
-            occupied_cells.insert(tree_->coordToKey(point_tf.getX(), point_tf.getY(), point_tf.getZ()));
-          }
-          else if (labels_row [x] >= mesh_filter::MeshFilterBase::FarClip)
-          {
-            float zz = input_row[x];
-            float yy = y_cache_[y] * zz;
-            float xx = x_cache_[x] * zz;
-            /* transform to map frame */
-            tf::Vector3 point_tf = map_H_sensor * tf::Vector3(xx, yy, zz);
-            // add to the list of model cells
-            model_cells.insert(tree_->coordToKey(point_tf.getX(), point_tf.getY(), point_tf.getZ()));
-          }
-        }
-    }
-
+      projector_.computeKeys(*tree_, reinterpret_cast<const float*>(&depth_msg->data[0]), &filtered_labels_[0],
+                             skip_vertical_pixels_, skip_horizontal_pixels_, map_H_sensor_eigen, occupied_keys_, model_keys_);
   }
   catch (...)
   {
@@ -496,26 +457,26 @@ void DepthImageOctomapUpdater::depthImageCallback(const sensor_msgs::ImageConstP
   }
   tree_->unlockRead();
 
-  /* cells that overlap with the model are not occupied */
-  for (octomap::KeySet::iterator it = model_cells.begin(), end = model_cells.end(); it != end; ++it)
-    occupied_cells.erase(*it);
+  /* cells that overlap with the model are not occupied; both lists are sorted the same way */
+  free_keys_.clear();
+  std::set_difference(occupied_keys_.begin(), occupied_keys_.end(), model_keys_.begin(), model_keys_.end(),
+                      std::back_inserter(free_keys_), &DepthImageProjector::keyLess);
+  occupied_keys_.swap(free_keys_);
 
-  // mark occupied cells
-  tree_->lockWrite();
+  // mark occupied cells; only the parts of the tree they are in are locked
   try
   {
-    /* now mark all occupied cells */
-    for (octomap::KeySet::iterator it = occupied_cells.begin(), end = occupied_cells.end(); it != end; ++it)
-      tree_->updateNode(*it, true);
+    tree_->updateNodes(occupied_keys_, true);
   }
   catch (...)
   {
     ROS_ERROR("Internal error while updating octree");
   }
-  tree_->unlockWrite();
   tree_->triggerUpdateCallback();
 
   // at this point we still have not freed the space
+  octomap::KeySet *occupied_cells_ptr = new octomap::KeySet(occupied_keys_.begin(), occupied_keys_.end());
+  octomap::KeySet *model_cells_ptr = new octomap::KeySet(model_keys_.begin(), model_keys_.end());
   free_space_updater_->pushLazyUpdate(occupied_cells_ptr, model_cells_ptr, sensor_origin);
 
   ROS_DEBUG("Processed depth image in %lf ms", (ros::WallTime::now() - start).toSec() * 1000.0);
@@ -0,0 +1,245 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include <moveit/depth_image_octomap_updater/depth_image_projector.h>
+#include <moveit/mesh_filter/mesh_filter_base.h>
+#include <algorithm>
+#include <iterator>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace occupancy_map_monitor
+{
+
+namespace
+{
+
+// the conversions of the updater before the projector existed, kept so the keys do not change
+inline float depthToMeters(uint16_t depth)
+{
+  return (float)depth * 1e-3; // scale from mm to m
+}
+
+inline float depthToMeters(float depth)
+{
+  return depth;
+}
+
+// the cells of the points in the first count columns of points, after transforming them to the map frame;
+// transformed needs at least as many columns. Neighboring pixels often fall in the same cell, in the same row
+// as well as in the rows above and below, so the cells of the row are sorted and only those that were not already
+// seen in the previous row are appended to keys; previous then holds the cells of this row
+inline void appendKeys(const octomap::OcTree &tree, const Eigen::Affine3d &map_H_sensor, const Eigen::Matrix3Xd &points,
+                       int count, Eigen::Matrix3Xd &transformed, std::vector<boost::uint64_t> &row,
+                       std::vector<boost::uint64_t> &previous, std::vector<boost::uint64_t> &keys)
+{
+  row.clear();
+  if (count > 0)
+  {
+    transformed.leftCols(count).noalias() = map_H_sensor.linear() * points.leftCols(count);
+    transformed.leftCols(count).colwise() += map_H_sensor.translation();
+    for (int i = 0 ; i < count ; ++i)
+    {
+      boost::uint64_t key = DepthImageProjector::packKey(tree.coordToKey(transformed(0, i), transformed(1, i), transformed(2, i)));
+      if (row.empty() || row.back() != key)
+        row.push_back(key);
+    }
+    std::sort(row.begin(), row.end());
+    row.erase(std::unique(row.begin(), row.end()), row.end());
+    std::set_difference(row.begin(), row.end(), previous.begin(), previous.end(), std::back_inserter(keys));
+  }
+  previous.swap(row);
+}
+
+}
+
+DepthImageProjector::DepthImageProjector(unsigned int threads) :
+  fx_(0.0), fy_(0.0), px_(0.0), py_(0.0), width_(0), height_(0)
+{
+  setThreadCount(threads);
+}
+
+void DepthImageProjector::setThreadCount(unsigned int threads)
+{
+#ifdef _OPENMP
+  threads_ = threads > 0 ? threads : std::max(1, omp_get_max_threads());
+#else
+  threads_ = 1;
+#endif
+  thread_data_.resize(threads_);
+}
+
+unsigned int DepthImageProjector::getThreadCount() const
+{
+  return threads_;
+}
+
+bool DepthImageProjector::setCameraParameters(double fx, double fy, double px, double py, unsigned int width, unsigned int height)
+{
+  if (fx == fx_ && fy == fy_ && px == px_ && py == py_ && width == width_ && height == height_)
+    return true;
+
+  const double inv_fx = 1.0 / fx;
+  const double inv_fy = 1.0 / fy;
+
+  // if there are any NaNs, discard data
+  if (!(px == px && py == py && inv_fx == inv_fx && inv_fy == inv_fy))
+    return false;
+
+  fx_ = fx;
+  fy_ = fy;
+  px_ = px;
+  py_ = py;
+  width_ = width;
+  height_ = height;
+
+  x_cache_.resize(width);
+  y_cache_.resize(height);
+  for (unsigned int x = 0 ; x < width ; ++x)
+    x_cache_[x] = ((int)x - px) * inv_fx;
+  for (unsigned int y = 0 ; y < height ; ++y)
+    y_cache_[y] = ((int)y - py) * inv_fy;
+  return true;
+}
+
+template<typename T>
+void DepthImageProjector::computeKeysImpl(const octomap::OcTree &tree, const T *depth, const unsigned int *labels,
+                                          unsigned int skip_vertical, unsigned int skip_horizontal, const Eigen::Affine3d &map_H_sensor,
+                                          std::vector<octomap::OcTreeKey> &occupied, std::vector<octomap::OcTreeKey> &model)
+{
+  const int w = width_;
+  const int y_begin = skip_vertical;
+  const int y_end = (int)height_ - (int)skip_vertical;
+  const int x_begin = skip_horizontal;
+  const int x_end = w - (int)skip_horizontal;
+  const int threads = std::max(1, std::min((int)threads_, y_end - y_begin));
+
+  // OpenMP may provide fewer threads than requested, so clear all the arrays that are merged below
+  for (int t = 0 ; t < threads ; ++t)
+  {
+    thread_data_[t].occupied_.clear();
+    thread_data_[t].model_.clear();
+    thread_data_[t].previous_occupied_.clear();
+    thread_data_[t].previous_model_.clear();
+  }
+
+  // coordToKey() only reads the tree, so the rows can be processed concurrently
+#pragma omp parallel num_threads(threads)
+  {
+#ifdef _OPENMP
+    const int t = omp_get_thread_num();
+#else
+    const int t = 0;
+#endif
+    ThreadData &data = thread_data_[t];
+    if (x_end > x_begin)
+    {
+      data.occupied_points_.resize(3, x_end - x_begin);
+      data.model_points_.resize(3, x_end - x_begin);
+      data.transformed_.resize(3, x_end - x_begin);
+    }
+
+#pragma omp for schedule(static)
+    for (int y = y_begin ; y < y_end ; ++y)
+    {
+      const T *input_row = depth + (std::size_t)y * w;
+      const unsigned int *labels_row = labels + (std::size_t)y * w;
+      int occupied_count = 0;
+      int model_count = 0;
+      for (int x = x_begin ; x < x_end ; ++x)
+      {
+        // not filtered
+        if (labels_row[x] == mesh_filter::MeshFilterBase::Background)
+        {
+          float zz = depthToMeters(input_row[x]);
+          data.occupied_points_.col(occupied_count++) << x_cache_[x] * zz, y_cache_[y] * zz, zz;
+        }
+        // on far plane or a model point -> remove
+        else if (labels_row[x] >= mesh_filter::MeshFilterBase::FarClip)
+        {
+          float zz = depthToMeters(input_row[x]);
+          data.model_points_.col(model_count++) << x_cache_[x] * zz, y_cache_[y] * zz, zz;
+        }
+      }
+      appendKeys(tree, map_H_sensor, data.occupied_points_, occupied_count, data.transformed_, data.row_,
+                 data.previous_occupied_, data.occupied_);
+      appendKeys(tree, map_H_sensor, data.model_points_, model_count, data.transformed_, data.row_,
+                 data.previous_model_, data.model_);
+    }
+
+    std::sort(data.occupied_.begin(), data.occupied_.end());
+    data.occupied_.erase(std::unique(data.occupied_.begin(), data.occupied_.end()), data.occupied_.end());
+    std::sort(data.model_.begin(), data.model_.end());
+    data.model_.erase(std::unique(data.model_.begin(), data.model_.end()), data.model_.end());
+  }
+
+  merge(&ThreadData::occupied_, threads, occupied);
+  merge(&ThreadData::model_, threads, model);
+}
+
+void DepthImageProjector::computeKeys(const octomap::OcTree &tree, const uint16_t *depth, const unsigned int *labels,
+                                      unsigned int skip_vertical, unsigned int skip_horizontal, const Eigen::Affine3d &map_H_sensor,
+                                      std::vector<octomap::OcTreeKey> &occupied, std::vector<octomap::OcTreeKey> &model)
+{
+  computeKeysImpl(tree, depth, labels, skip_vertical, skip_horizontal, map_H_sensor, occupied, model);
+}
+
+void DepthImageProjector::computeKeys(const octomap::OcTree &tree, const float *depth, const unsigned int *labels,
+                                      unsigned int skip_vertical, unsigned int skip_horizontal, const Eigen::Affine3d &map_H_sensor,
+                                      std::vector<octomap::OcTreeKey> &occupied, std::vector<octomap::OcTreeKey> &model)
+{
+  computeKeysImpl(tree, depth, labels, skip_vertical, skip_horizontal, map_H_sensor, occupied, model);
+}
+
+void DepthImageProjector::merge(std::vector<boost::uint64_t> ThreadData::*member, int threads, std::vector<octomap::OcTreeKey> &keys)
+{
+  // the per thread arrays are sorted, so merging them is linear
+  merged_.clear();
+  for (int t = 0 ; t < threads ; ++t)
+  {
+    const std::vector<boost::uint64_t> &local = thread_data_[t].*member;
+    merge_buffer_.resize(merged_.size() + local.size());
+    std::merge(merged_.begin(), merged_.end(), local.begin(), local.end(), merge_buffer_.begin());
+    merged_.swap(merge_buffer_);
+  }
+  merged_.erase(std::unique(merged_.begin(), merged_.end()), merged_.end());
+
+  keys.resize(merged_.size());
+  for (std::size_t i = 0 ; i < merged_.size() ; ++i)
+    keys[i] = unpackKey(merged_[i]);
+}
+
+}
@@ -0,0 +1,228 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <moveit/depth_image_octomap_updater/deferred_frame_queue.h>
+#include <boost/bind.hpp>
+
+using namespace occupancy_map_monitor;
+
+namespace
+{
+
+// the sensor moves along x at 1 m/s, so the x coordinate of its transform equals the time stamp
+tf::StampedTransform sensorTransform(double stamp)
+{
+  return tf::StampedTransform(tf::Transform(tf::Quaternion::getIdentity(), tf::Vector3(stamp, 0.0, 0.0)),
+                              ros::Time(stamp), "map", "sensor");
+}
+
+// records the frames passed to their callback by the queue
+class FrameRecorder
+{
+public:
+
+  void frameCallback(double stamp, const tf::StampedTransform &transform)
+  {
+    boost::mutex::scoped_lock _(lock_);
+    stamps_.push_back(stamp);
+    positions_.push_back(transform.getOrigin().x());
+  }
+
+  DeferredFrameQueue::FrameCallback callback(double stamp)
+  {
+    return boost::bind(&FrameRecorder::frameCallback, this, stamp, _1);
+  }
+
+  std::vector<double> getStamps()
+  {
+    boost::mutex::scoped_lock _(lock_);
+    return stamps_;
+  }
+
+  std::vector<double> getPositions()
+  {
+    boost::mutex::scoped_lock _(lock_);
+    return positions_;
+  }
+
+private:
+
+  boost::mutex lock_;
+  std::vector<double> stamps_;
+  std::vector<double> positions_;
+};
+
+void pushFrame(DeferredFrameQueue &queue, FrameRecorder &recorder, double stamp, const ros::WallTime &received = ros::WallTime::now())
+{
+  queue.pushFrame("map", "sensor", ros::Time(stamp), recorder.callback(stamp), received);
+}
+
+}
+
+TEST(DeferredFrameQueue, WaitsForTransform)
+{
+  boost::shared_ptr<tf::Transformer> tf(new tf::Transformer());
+  tf->setTransform(sensorTransform(1.0));
+  DeferredFrameQueue queue(tf, 5, 10.0);
+  FrameRecorder recorder;
+
+  pushFrame(queue, recorder, 1.5);
+  pushFrame(queue, recorder, 1.2);
+  pushFrame(queue, recorder, 2.5);
+  queue.processFrames();
+  EXPECT_TRUE(recorder.getStamps().empty());
+  EXPECT_EQ(3u, queue.getPendingFrameCount());
+  EXPECT_EQ(3u, queue.getDeferredFrameCount());
+
+  // the frames are processed in the order of their stamps, with the interpolated transform
+  tf->setTransform(sensorTransform(2.0));
+  queue.processFrames();
+  std::vector<double> stamps = recorder.getStamps();
+  std::vector<double> positions = recorder.getPositions();
+  ASSERT_EQ(2u, stamps.size());
+  EXPECT_DOUBLE_EQ(1.2, stamps[0]);
+  EXPECT_DOUBLE_EQ(1.5, stamps[1]);
+  EXPECT_NEAR(1.2, positions[0], 1e-6);
+  EXPECT_NEAR(1.5, positions[1], 1e-6);
+  EXPECT_EQ(1u, queue.getPendingFrameCount());
+  EXPECT_EQ(2u, queue.getProcessedFrameCount());
+  EXPECT_EQ(0u, queue.getExpiredFrameCount());
+
+  // a frame whose transform is already available is not deferred
+  pushFrame(queue, recorder, 1.7);
+  EXPECT_EQ(3u, queue.getDeferredFrameCount());
+  queue.processFrames();
+  EXPECT_EQ(3u, recorder.getStamps().size());
+}
+
+TEST(DeferredFrameQueue, ExpiresFrames)
+{
+  boost::shared_ptr<tf::Transformer> tf(new tf::Transformer());
+  tf->setTransform(sensorTransform(1.0));
+  DeferredFrameQueue queue(tf, 5, 0.5);
+  FrameRecorder recorder;
+
+  pushFrame(queue, recorder, 2.0, ros::WallTime::now() - ros::WallDuration(1.0));
+  pushFrame(queue, recorder, 3.0);
+  queue.processFrames();
+  EXPECT_EQ(1u, queue.getExpiredFrameCount());
+  EXPECT_EQ(1u, queue.getPendingFrameCount());
+  EXPECT_TRUE(recorder.getStamps().empty());
+}
+
+TEST(DeferredFrameQueue, DropsOldestFrame)
+{
+  boost::shared_ptr<tf::Transformer> tf(new tf::Transformer());
+  tf->setTransform(sensorTransform(0.0));
+  DeferredFrameQueue queue(tf, 2, 10.0);
+  FrameRecorder recorder;
+
+  pushFrame(queue, recorder, 1.0);
+  pushFrame(queue, recorder, 2.0);
+  pushFrame(queue, recorder, 3.0);
+  EXPECT_EQ(1u, queue.getDroppedFrameCount());
+  EXPECT_EQ(2u, queue.getPendingFrameCount());
+
+  tf->setTransform(sensorTransform(4.0));
+  queue.processFrames();
+  std::vector<double> stamps = recorder.getStamps();
+  ASSERT_EQ(2u, stamps.size());
+  EXPECT_DOUBLE_EQ(2.0, stamps[0]);
+  EXPECT_DOUBLE_EQ(3.0, stamps[1]);
+}
+
+// frames arrive every 5 ms and tf lags 30 ms behind them; every frame should be processed,
+// in order, as soon as its transform arrives
+TEST(DeferredFrameQueue, SyntheticTFLag)
+{
+  const unsigned int frames = 100;
+  const unsigned int lag = 6;
+  const double dt = 0.005;
+  boost::shared_ptr<tf::Transformer> tf(new tf::Transformer());
+  DeferredFrameQueue queue(tf, 10, 0.5);
+  FrameRecorder recorder;
+  queue.start();
+
+  for (unsigned int i = 0 ; i < frames + lag ; ++i)
+  {
+    if (i < frames)
+      pushFrame(queue, recorder, 1.0 + i * dt);
+    if (i >= lag)
+      tf->setTransform(sensorTransform(1.0 + (i - lag) * dt));
+    ros::WallDuration(dt).sleep();
+  }
+  tf->setTransform(sensorTransform(1.0 + frames * dt));
+  for (int i = 0 ; i < 100 && queue.getProcessedFrameCount() < frames ; ++i)
+    ros::WallDuration(0.01).sleep();
+  queue.stop();
+
+  std::vector<double> stamps = recorder.getStamps();
+  std::vector<double> positions = recorder.getPositions();
+  ASSERT_EQ(frames, stamps.size());
+  for (std::size_t i = 0 ; i < stamps.size() ; ++i)
+  {
+    EXPECT_DOUBLE_EQ(1.0 + i * dt, stamps[i]);
+    EXPECT_NEAR(stamps[i], positions[i], 1e-6);
+  }
+  EXPECT_EQ(frames, queue.getDeferredFrameCount());
+  EXPECT_EQ(0u, queue.getExpiredFrameCount());
+  EXPECT_EQ(0u, queue.getDroppedFrameCount());
+  EXPECT_GT(queue.getAverageLatency(), 0.0);
+  EXPECT_LT(queue.getMaxLatency(), 0.5);
+}
+
+// without tf, the processing thread still drops the frames once they expire
+TEST(DeferredFrameQueue, ExpiresFramesWithoutTF)
+{
+  boost::shared_ptr<tf::Transformer> tf(new tf::Transformer());
+  DeferredFrameQueue queue(tf, 5, 0.05);
+  FrameRecorder recorder;
+  queue.start();
+
+  pushFrame(queue, recorder, 1.0);
+  for (int i = 0 ; i < 100 && queue.getExpiredFrameCount() == 0 ; ++i)
+    ros::WallDuration(0.01).sleep();
+  queue.stop();
+
+  EXPECT_EQ(1u, queue.getExpiredFrameCount());
+  EXPECT_EQ(0u, queue.getPendingFrameCount());
+  EXPECT_TRUE(recorder.getStamps().empty());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,200 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include <gtest/gtest.h>
+#include <moveit/depth_image_octomap_updater/depth_image_projector.h>
+#include <moveit/mesh_filter/mesh_filter_base.h>
+#include <tf/LinearMath/Transform.h>
+#include <cstdlib>
+#include <limits>
+
+using namespace occupancy_map_monitor;
+
+namespace
+{
+
+const unsigned int WIDTH = 160;
+const unsigned int HEIGHT = 120;
+const double FX = 120.0, FY = 121.0, PX = 79.5, PY = 60.5;
+
+// a depth image of a slanted wall with noise and a block of pixels labeled as a mesh, from a fixed seed
+// so the test is deterministic; roughly one pixel in ten is filtered out as shadow or near clipping
+void makeImage(std::vector<float> &depth, std::vector<unsigned int> &labels)
+{
+  srand(42);
+  depth.resize(WIDTH * HEIGHT);
+  labels.resize(WIDTH * HEIGHT);
+  for (unsigned int y = 0 ; y < HEIGHT ; ++y)
+    for (unsigned int x = 0 ; x < WIDTH ; ++x)
+    {
+      const unsigned int i = y * WIDTH + x;
+      depth[i] = 1.0 + 0.01 * x + 0.005 * y + 0.02 * rand() / RAND_MAX;
+      if (x > 40 && x < 80 && y > 30 && y < 70)
+        labels[i] = mesh_filter::MeshFilterBase::FirstLabel + 1;
+      else if (rand() % 10 == 0)
+        labels[i] = rand() % 2 ? mesh_filter::MeshFilterBase::Shadow : mesh_filter::MeshFilterBase::NearClip;
+      else if (rand() % 50 == 0)
+        labels[i] = mesh_filter::MeshFilterBase::FarClip;
+      else
+        labels[i] = mesh_filter::MeshFilterBase::Background;
+    }
+}
+
+// the back-projection DepthImageOctomapUpdater used before the projector existed
+template<typename T>
+void computeKeysSerially(const octomap::OcTree &tree, const T *depth, const unsigned int *labels, unsigned int skip_vertical,
+                         unsigned int skip_horizontal, const tf::Transform &map_H_sensor, double scale,
+                         octomap::KeySet &occupied_cells, octomap::KeySet &model_cells)
+{
+  std::vector<float> x_cache(WIDTH), y_cache(HEIGHT);
+  for (int x = 0; x < (int)WIDTH; ++x)
+    x_cache[x] = (x - PX) * (1.0 / FX);
+  for (int y = 0; y < (int)HEIGHT; ++y)
+    y_cache[y] = (y - PY) * (1.0 / FY);
+
+  const int h_bound = HEIGHT - skip_vertical;
+  const int w_bound = WIDTH - skip_horizontal;
+  const unsigned int *labels_row = labels + skip_vertical * WIDTH;
+  const T *input_row = depth + skip_vertical * WIDTH;
+  for (int y = skip_vertical ; y < h_bound ; ++y, labels_row += WIDTH, input_row += WIDTH)
+    for (int x = skip_horizontal ; x < w_bound ; ++x)
+    {
+      if (labels_row[x] == mesh_filter::MeshFilterBase::Background)
+      {
+        float zz = (float)input_row[x] * scale;
+        tf::Vector3 point_tf = map_H_sensor * tf::Vector3(x_cache[x] * zz, y_cache[y] * zz, zz);
+        occupied_cells.insert(tree.coordToKey(point_tf.getX(), point_tf.getY(), point_tf.getZ()));
+      }
+      else if (labels_row[x] >= mesh_filter::MeshFilterBase::FarClip)
+      {
+        float zz = (float)input_row[x] * scale;
+        tf::Vector3 point_tf = map_H_sensor * tf::Vector3(x_cache[x] * zz, y_cache[y] * zz, zz);
+        model_cells.insert(tree.coordToKey(point_tf.getX(), point_tf.getY(), point_tf.getZ()));
+      }
+    }
+}
+
+Eigen::Affine3d toEigen(const tf::Transform &t)
+{
+  Eigen::Affine3d result = Eigen::Affine3d::Identity();
+  for (int i = 0 ; i < 3 ; ++i)
+  {
+    for (int j = 0 ; j < 3 ; ++j)
+      result.linear()(i, j) = t.getBasis()[i][j];
+    result.translation()(i) = t.getOrigin()[i];
+  }
+  return result;
+}
+
+void expectSameKeys(const octomap::KeySet &expected, const std::vector<octomap::OcTreeKey> &keys)
+{
+  EXPECT_EQ(expected.size(), keys.size());
+  for (std::size_t i = 0 ; i < keys.size() ; ++i)
+  {
+    EXPECT_TRUE(expected.find(keys[i]) != expected.end());
+    if (i > 0)
+    {
+      EXPECT_TRUE(DepthImageProjector::keyLess(keys[i - 1], keys[i]));
+    }
+  }
+}
+
+}
+
+TEST(DepthImageProjector, CameraParameters)
+{
+  DepthImageProjector projector(1);
+  EXPECT_TRUE(projector.setCameraParameters(FX, FY, PX, PY, WIDTH, HEIGHT));
+  EXPECT_FALSE(projector.setCameraParameters(FX, FY, std::numeric_limits<double>::quiet_NaN(), PY, WIDTH, HEIGHT));
+  EXPECT_TRUE(projector.setCameraParameters(FX, FY, PX, PY, WIDTH, HEIGHT));
+}
+
+TEST(DepthImageProjector, MatchesSerialBackProjection)
+{
+  octomap::OcTree tree(0.02);
+  std::vector<float> depth;
+  std::vector<unsigned int> labels;
+  makeImage(depth, labels);
+  std::vector<uint16_t> depth_mm(depth.size());
+  for (std::size_t i = 0 ; i < depth.size() ; ++i)
+    depth_mm[i] = (uint16_t)(depth[i] * 1000.0f);
+
+  const tf::Transform map_H_sensor(tf::Quaternion(tf::Vector3(0.3, -0.2, 1.0).normalized(), 0.7), tf::Vector3(0.4, -1.3, 1.1));
+  const Eigen::Affine3d map_H_sensor_eigen = toEigen(map_H_sensor);
+
+  octomap::KeySet expected_occupied, expected_model, expected_occupied_mm, expected_model_mm;
+  computeKeysSerially(tree, &depth[0], &labels[0], 4, 6, map_H_sensor, 1.0, expected_occupied, expected_model);
+  computeKeysSerially(tree, &depth_mm[0], &labels[0], 4, 6, map_H_sensor, 1e-3, expected_occupied_mm, expected_model_mm);
+  ASSERT_FALSE(expected_occupied.empty());
+  ASSERT_FALSE(expected_model.empty());
+
+  for (unsigned int threads = 1 ; threads <= 5 ; ++threads)
+  {
+    DepthImageProjector projector(threads);
+    ASSERT_TRUE(projector.setCameraParameters(FX, FY, PX, PY, WIDTH, HEIGHT));
+    std::vector<octomap::OcTreeKey> occupied, model;
+    projector.computeKeys(tree, &depth[0], &labels[0], 4, 6, map_H_sensor_eigen, occupied, model);
+    expectSameKeys(expected_occupied, occupied);
+    expectSameKeys(expected_model, model);
+
+    projector.computeKeys(tree, &depth_mm[0], &labels[0], 4, 6, map_H_sensor_eigen, occupied, model);
+    expectSameKeys(expected_occupied_mm, occupied);
+    expectSameKeys(expected_model_mm, model);
+  }
+}
+
+TEST(DepthImageProjector, SkipEverything)
+{
+  octomap::OcTree tree(0.02);
+  std::vector<float> depth;
+  std::vector<unsigned int> labels;
+  makeImage(depth, labels);
+
+  DepthImageProjector projector(2);
+  ASSERT_TRUE(projector.setCameraParameters(FX, FY, PX, PY, WIDTH, HEIGHT));
+  std::vector<octomap::OcTreeKey> occupied(1), model(1);
+  projector.computeKeys(tree, &depth[0], &labels[0], HEIGHT / 2, 0, Eigen::Affine3d::Identity(), occupied, model);
+  EXPECT_TRUE(occupied.empty());
+  EXPECT_TRUE(model.empty());
+  projector.computeKeys(tree, &depth[0], &labels[0], 0, WIDTH / 2, Eigen::Affine3d::Identity(), occupied, model);
+  EXPECT_TRUE(occupied.empty());
+  EXPECT_TRUE(model.empty());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -48,11 +48,23 @@ class LazyFreeSpaceUpdater
 {
 public:
 
-  LazyFreeSpaceUpdater(const OccMapTreePtr &tree, unsigned int max_batch_size = 10);
+  /** \brief Constructor. Up to \e max_batch_size sets of cells are accumulated into one batch for clearing free space.
+   *  At most \e max_pending_batches batches wait for processing; when the queue is full, new batches are merged into a
+   *  pending batch with the same sensor origin, or the oldest pending batch is dropped. */
+  LazyFreeSpaceUpdater(const OccMapTreePtr &tree, unsigned int max_batch_size = 10, unsigned int max_pending_batches = 4);
   ~LazyFreeSpaceUpdater();
 
   void pushLazyUpdate(octomap::KeySet *occupied_cells, octomap::KeySet *model_cells, const octomap::point3d &sensor_origin);
 
+  /** \brief The number of batches that were discarded because the queue of pending batches was full */
+  std::size_t getDroppedBatchCount() const;
+
+  /** \brief The number of batches that were merged into a pending batch with the same sensor origin */
+  std::size_t getMergedBatchCount() const;
+
+  /** \brief The number of batches used to clear free space in the octree */
+  std::size_t getProcessedBatchCount() const;
+
 private:
 
 #ifdef __APPLE__
@@ -61,6 +73,13 @@ private:
   typedef std::tr1::unordered_map<octomap::OcTreeKey, unsigned int, octomap::OcTreeKey::KeyHash> OcTreeKeyCountMap;
 #endif
 
+  struct PendingBatch
+  {
+    OcTreeKeyCountMap *occupied_cells_;
+    octomap::KeySet *model_cells_;
+    octomap::point3d sensor_origin_;
+  };
+
   void pushBatchToProcess(OcTreeKeyCountMap *occupied_cells, octomap::KeySet *model_cells, const octomap::point3d &sensor_origin);
 
   void lazyUpdateThread();
@@ -77,11 +96,13 @@ private:
   boost::condition_variable update_condition_;
   boost::mutex update_cell_sets_lock_;
 
-  OcTreeKeyCountMap *process_occupied_cells_set_;
-  octomap::KeySet *process_model_cells_set_;
-  octomap::point3d process_sensor_origin_;
+  std::deque<PendingBatch> process_queue_;
+  std::size_t max_pending_batches_;
+  std::size_t dropped_batches_;
+  std::size_t merged_batches_;
+  std::size_t processed_batches_;
   boost::condition_variable process_condition_;
-  boost::mutex cell_process_lock_;
+  mutable boost::mutex cell_process_lock_;
 
   boost::thread update_thread_;
   boost::thread process_thread_;
@@ -36,17 +36,20 @@
 
 #include <moveit/lazy_free_space_updater/lazy_free_space_updater.h>
 #include <ros/console.h>
+#include <algorithm>
 
 namespace occupancy_map_monitor
 {
 
-LazyFreeSpaceUpdater::LazyFreeSpaceUpdater(const OccMapTreePtr &tree, unsigned int max_batch_size) :
+LazyFreeSpaceUpdater::LazyFreeSpaceUpdater(const OccMapTreePtr &tree, unsigned int max_batch_size, unsigned int max_pending_batches) :
   tree_(tree),
   running_(true),
   max_batch_size_(max_batch_size),
   max_sensor_delta_(1e-3), // 1mm
-  process_occupied_cells_set_(NULL),
-  process_model_cells_set_(NULL),
+  max_pending_batches_(std::max(1u, max_pending_batches)),
+  dropped_batches_(0),
+  merged_batches_(0),
+  processed_batches_(0),
   update_thread_(boost::bind(&LazyFreeSpaceUpdater::lazyUpdateThread, this)),
   process_thread_(boost::bind(&LazyFreeSpaceUpdater::processThread, this))
 {
@@ -65,6 +68,30 @@ LazyFreeSpaceUpdater::~LazyFreeSpaceUpdater()
   }
   update_thread_.join();
   process_thread_.join();
+
+  for (std::size_t i = 0 ; i < process_queue_.size() ; ++i)
+  {
+    delete process_queue_[i].occupied_cells_;
+    delete process_queue_[i].model_cells_;
+  }
+}
+
+std::size_t LazyFreeSpaceUpdater::getDroppedBatchCount() const
+{
+  boost::mutex::scoped_lock _(cell_process_lock_);
+  return dropped_batches_;
+}
+
+std::size_t LazyFreeSpaceUpdater::getMergedBatchCount() const
+{
+  boost::mutex::scoped_lock _(cell_process_lock_);
+  return merged_batches_;
+}
+
+std::size_t LazyFreeSpaceUpdater::getProcessedBatchCount() const
+{
+  boost::mutex::scoped_lock _(cell_process_lock_);
+  return processed_batches_;
 }
 
 void LazyFreeSpaceUpdater::pushLazyUpdate(octomap::KeySet *occupied_cells, octomap::KeySet *model_cells, const octomap::point3d &sensor_origin)
@@ -79,22 +106,37 @@ void LazyFreeSpaceUpdater::pushLazyUpdate(octomap::KeySet *occupied_cells, octom
 
 void LazyFreeSpaceUpdater::pushBatchToProcess(OcTreeKeyCountMap *occupied_cells, octomap::KeySet *model_cells, const octomap::point3d &sensor_origin)
 {
-  // this is basically a queue of size 1. if this function is called repeatedly without any work being done by processThread(),
-  // data can be lost; this is intentional, to avoid spending too much time clearing the octomap
-  if (cell_process_lock_.try_lock())
-  {
-    process_occupied_cells_set_ = occupied_cells;
-    process_model_cells_set_ = model_cells;
-    process_sensor_origin_ = sensor_origin;
-    process_condition_.notify_one();
-    cell_process_lock_.unlock();
-  }
-  else
+  boost::mutex::scoped_lock _(cell_process_lock_);
+
+  if (process_queue_.size() >= max_pending_batches_)
   {
-    ROS_WARN("Previous batch update did not complete. Ignoring set of cells to be freed.");
-    delete occupied_cells;
-    delete model_cells;
+    // rays from the same origin are cast only once if the batches are merged, so prefer that to discarding data
+    for (std::deque<PendingBatch>::reverse_iterator it = process_queue_.rbegin() ; it != process_queue_.rend() ; ++it)
+      if ((it->sensor_origin_ - sensor_origin).norm() <= max_sensor_delta_)
+      {
+        for (OcTreeKeyCountMap::iterator jt = occupied_cells->begin(), end = occupied_cells->end(); jt != end; ++jt)
+          (*it->occupied_cells_)[jt->first] += jt->second;
+        it->model_cells_->insert(model_cells->begin(), model_cells->end());
+        delete occupied_cells;
+        delete model_cells;
+        merged_batches_++;
+        return;
+      }
+
+    // if processThread() cannot keep up with batches from different origins, the oldest data is discarded
+    ROS_WARN_THROTTLE(1, "Free space clearing cannot keep up. Ignoring the oldest set of cells to be freed.");
+    delete process_queue_.front().occupied_cells_;
+    delete process_queue_.front().model_cells_;
+    process_queue_.pop_front();
+    dropped_batches_++;
   }
+
+  PendingBatch batch;
+  batch.occupied_cells_ = occupied_cells;
+  batch.model_cells_ = model_cells;
+  batch.sensor_origin_ = sensor_origin;
+  process_queue_.push_back(batch);
+  process_condition_.notify_one();
 }
 
 void LazyFreeSpaceUpdater::processThread()
@@ -105,20 +147,28 @@ void LazyFreeSpaceUpdater::processThread()
 
   octomap::KeyRay key_ray1, key_ray2;
   OcTreeKeyCountMap free_cells1, free_cells2;
+  std::vector<OccMapTree::NodeUpdate> node_updates;
 
   while (running_)
   {
     free_cells1.clear();
     free_cells2.clear();
 
-    boost::unique_lock<boost::mutex> ulock(cell_process_lock_);
-    while (!process_occupied_cells_set_ && running_)
-      process_condition_.wait(ulock);
+    PendingBatch batch;
+    {
+      boost::unique_lock<boost::mutex> ulock(cell_process_lock_);
+      while (process_queue_.empty() && running_)
+        process_condition_.wait(ulock);
+
+      if (!running_)
+        break;
 
-    if (!running_)
-      break;
+      // new batches can be queued while this one is processed
+      batch = process_queue_.front();
+      process_queue_.pop_front();
+    }
 
-    ROS_DEBUG("Begin processing batched update: marking free cells due to %lu occupied cells and %lu model cells", (long unsigned int)process_occupied_cells_set_->size(), (long unsigned int)process_model_cells_set_->size());
+    ROS_DEBUG("Begin processing batched update: marking free cells due to %lu occupied cells and %lu model cells", (long unsigned int)batch.occupied_cells_->size(), (long unsigned int)batch.model_cells_->size());
 
     ros::WallTime start = ros::WallTime::now();
     tree_->lockRead();
@@ -129,8 +179,8 @@ void LazyFreeSpaceUpdater::processThread()
 #pragma omp section
       {
         /* compute the free cells along each ray that ends at an occupied cell */
-        for (OcTreeKeyCountMap::iterator it = process_occupied_cells_set_->begin(), end = process_occupied_cells_set_->end(); it != end; ++it)
-          if (tree_->computeRayKeys(process_sensor_origin_, tree_->keyToCoord(it->first), key_ray1))
+        for (OcTreeKeyCountMap::iterator it = batch.occupied_cells_->begin(), end = batch.occupied_cells_->end(); it != end; ++it)
+          if (tree_->computeRayKeys(batch.sensor_origin_, tree_->keyToCoord(it->first), key_ray1))
             for (octomap::KeyRay::iterator jt = key_ray1.begin(), end = key_ray1.end() ; jt != end ; ++jt)
               free_cells1[*jt] += it->second;
       }
@@ -138,8 +188,8 @@ void LazyFreeSpaceUpdater::processThread()
 #pragma omp section
       {
         /* compute the free cells along each ray that ends at a model cell */
-        for (octomap::KeySet::iterator it = process_model_cells_set_->begin(), end = process_model_cells_set_->end(); it != end; ++it)
-          if (tree_->computeRayKeys(process_sensor_origin_, tree_->keyToCoord(*it), key_ray2))
+        for (octomap::KeySet::iterator it = batch.model_cells_->begin(), end = batch.model_cells_->end(); it != end; ++it)
+          if (tree_->computeRayKeys(batch.sensor_origin_, tree_->keyToCoord(*it), key_ray2))
             for (octomap::KeyRay::iterator jt = key_ray2.begin(), end = key_ray2.end() ; jt != end ; ++jt)
               free_cells2[*jt]++;
       }
@@ -147,46 +197,46 @@ void LazyFreeSpaceUpdater::processThread()
 
     tree_->unlockRead();
 
-    for (OcTreeKeyCountMap::iterator it = process_occupied_cells_set_->begin(), end = process_occupied_cells_set_->end(); it != end; ++it)
+    for (OcTreeKeyCountMap::iterator it = batch.occupied_cells_->begin(), end = batch.occupied_cells_->end(); it != end; ++it)
     {
       free_cells1.erase(it->first);
       free_cells2.erase(it->first);
     }
 
-    for (octomap::KeySet::iterator it = process_model_cells_set_->begin(), end = process_model_cells_set_->end(); it != end; ++it)
+    for (octomap::KeySet::iterator it = batch.model_cells_->begin(), end = batch.model_cells_->end(); it != end; ++it)
     {
       free_cells1.erase(*it);
       free_cells2.erase(*it);
     }
     ROS_DEBUG("Marking %lu cells as free...", (long unsigned int)(free_cells1.size() + free_cells2.size()));
 
-    tree_->lockWrite();
+    // set the logodds to the minimum for the cells that are part of the model and mark free cells only if
+    // not seen occupied in this cloud; only the parts of the tree they are in are locked
+    node_updates.clear();
+    for (octomap::KeySet::iterator it = batch.model_cells_->begin(), end = batch.model_cells_->end(); it != end; ++it)
+      node_updates.push_back(OccMapTree::NodeUpdate(*it, lg_0));
+    for (OcTreeKeyCountMap::iterator it = free_cells1.begin(), end = free_cells1.end(); it != end; ++it)
+      node_updates.push_back(OccMapTree::NodeUpdate(it->first, it->second * lg_miss));
+    for (OcTreeKeyCountMap::iterator it = free_cells2.begin(), end = free_cells2.end(); it != end; ++it)
+      node_updates.push_back(OccMapTree::NodeUpdate(it->first, it->second * lg_miss));
 
     try
     {
-      // set the logodds to the minimum for the cells that are part of the model
-      for (octomap::KeySet::iterator it = process_model_cells_set_->begin(), end = process_model_cells_set_->end(); it != end; ++it)
-        tree_->updateNode(*it, lg_0);
-
-      /* mark free cells only if not seen occupied in this cloud */
-      for (OcTreeKeyCountMap::iterator it = free_cells1.begin(), end = free_cells1.end(); it != end; ++it)
-        tree_->updateNode(it->first, it->second * lg_miss);
-      for (OcTreeKeyCountMap::iterator it = free_cells2.begin(), end = free_cells2.end(); it != end; ++it)
-        tree_->updateNode(it->first, it->second * lg_miss);
+      tree_->updateNodes(node_updates);
     }
     catch (...)
     {
       ROS_ERROR("Internal error while updating octree");
     }
-    tree_->unlockWrite();
     tree_->triggerUpdateCallback();
 
     ROS_DEBUG("Marked free cells in %lf ms", (ros::WallTime::now() - start).toSec() * 1000.0);
 
-    delete process_occupied_cells_set_;
-    process_occupied_cells_set_ = NULL;
-    delete process_model_cells_set_;
-    process_model_cells_set_ = NULL;
+    delete batch.occupied_cells_;
+    delete batch.model_cells_;
+
+    boost::mutex::scoped_lock _(cell_process_lock_);
+    processed_batches_++;
   }
 }
 
@@ -197,61 +247,72 @@ void LazyFreeSpaceUpdater::lazyUpdateThread()
   octomap::point3d sensor_origin;
   unsigned int batch_size = 0;
 
+  std::deque<octomap::KeySet*> occupied_cells_sets;
+  std::deque<octomap::KeySet*> model_cells_sets;
+  std::deque<octomap::point3d> sensor_origins;
+
   while (running_)
   {
-    boost::unique_lock<boost::mutex> ulock(update_cell_sets_lock_);
-    while (occupied_cells_sets_.empty() && running_)
-      update_condition_.wait(ulock);
+    {
+      boost::unique_lock<boost::mutex> ulock(update_cell_sets_lock_);
+      while (occupied_cells_sets_.empty() && running_)
+        update_condition_.wait(ulock);
 
-    if (!running_)
-      break;
+      if (!running_)
+        break;
 
-    if (batch_size == 0)
-    {
-      occupied_cells_set = new OcTreeKeyCountMap();
-      octomap::KeySet *s = occupied_cells_sets_.front();
-      occupied_cells_sets_.pop_front();
-      for (octomap::KeySet::iterator it = s->begin(), end = s->end(); it != end; ++it)
-        (*occupied_cells_set)[*it]++;
-      delete s;
-      model_cells_set = model_cells_sets_.front();
-      model_cells_sets_.pop_front();
-      sensor_origin = sensor_origins_.front();
-      sensor_origins_.pop_front();
-      batch_size++;
+      // take all pending sets at once, so pushLazyUpdate() does not wait for them to be merged
+      occupied_cells_sets.swap(occupied_cells_sets_);
+      model_cells_sets.swap(model_cells_sets_);
+      sensor_origins.swap(sensor_origins_);
     }
 
-    while (!occupied_cells_sets_.empty())
+    while (!occupied_cells_sets.empty())
     {
-      if ((sensor_origins_.front() - sensor_origin).norm() > max_sensor_delta_)
+      if (batch_size > 0 && (sensor_origins.front() - sensor_origin).norm() > max_sensor_delta_)
       {
         ROS_DEBUG("Pushing %u sets of occupied/model cells to free cells update thread (origin changed)", batch_size);
         pushBatchToProcess(occupied_cells_set, model_cells_set, sensor_origin);
         batch_size = 0;
-        break;
       }
-      sensor_origins_.pop_front();
 
-      octomap::KeySet *add_occ = occupied_cells_sets_.front();
+      octomap::KeySet *add_occ = occupied_cells_sets.front();
+      occupied_cells_sets.pop_front();
+      octomap::KeySet *mod_occ = model_cells_sets.front();
+      model_cells_sets.pop_front();
+      if (batch_size == 0)
+      {
+        occupied_cells_set = new OcTreeKeyCountMap();
+        model_cells_set = mod_occ;
+        sensor_origin = sensor_origins.front();
+      }
+      else
+      {
+        model_cells_set->insert(mod_occ->begin(), mod_occ->end());
+        delete mod_occ;
+      }
+      sensor_origins.pop_front();
+
       for (octomap::KeySet::iterator it = add_occ->begin(), end = add_occ->end(); it != end; ++it)
         (*occupied_cells_set)[*it]++;
-      occupied_cells_sets_.pop_front();
       delete add_occ;
-      octomap::KeySet *mod_occ = model_cells_sets_.front();
-      model_cells_set->insert(mod_occ->begin(), mod_occ->end());
-      model_cells_sets_.pop_front();
-      delete mod_occ;
       batch_size++;
-    }
 
-    if (batch_size >= max_batch_size_)
-    {
-      ROS_DEBUG("Pushing %u sets of occupied/model cells to free cells update thread", batch_size);
-      pushBatchToProcess(occupied_cells_set, model_cells_set, sensor_origin);
-      occupied_cells_set = NULL;
-      batch_size = 0;
+      if (batch_size >= max_batch_size_)
+      {
+        ROS_DEBUG("Pushing %u sets of occupied/model cells to free cells update thread", batch_size);
+        pushBatchToProcess(occupied_cells_set, model_cells_set, sensor_origin);
+        occupied_cells_set = NULL;
+        batch_size = 0;
+      }
     }
   }
+
+  if (batch_size > 0)
+  {
+    delete occupied_cells_set;
+    delete model_cells_set;
+  }
 }
 
 }
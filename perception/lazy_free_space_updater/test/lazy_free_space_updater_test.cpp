@@ -0,0 +1,154 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <moveit/lazy_free_space_updater/lazy_free_space_updater.h>
+#include <ros/time.h>
+#include <cmath>
+
+using namespace occupancy_map_monitor;
+
+namespace
+{
+
+const double RESOLUTION = 0.02;
+const double RANGE = 4.0;
+const unsigned int RAYS = 500;
+
+// the direction of ray i of set \e seed; different sets use different directions
+octomap::point3d rayDirection(unsigned int seed, unsigned int i)
+{
+  double theta = 2.0 * M_PI * (i + 0.37 * seed) / RAYS;
+  double z = ((i * 7 + seed * 13) % RAYS) / (double)RAYS - 0.5;
+  return octomap::point3d(cos(theta), sin(theta), z).normalized();
+}
+
+// the cells at the end of long rays, so that clearing the free space is slower than producing the sets
+octomap::KeySet* makeOccupiedCells(const OccMapTree &tree, const octomap::point3d &origin, unsigned int seed)
+{
+  octomap::KeySet *cells = new octomap::KeySet();
+  for (unsigned int i = 0 ; i < RAYS ; ++i)
+    cells->insert(tree.coordToKey(origin + rayDirection(seed, i) * RANGE));
+  return cells;
+}
+
+// check that the middle of every ray of the given sets was marked free
+bool raysCleared(OccMapTree &tree, const std::vector<std::pair<octomap::point3d, unsigned int> > &sets)
+{
+  OccMapTree::ReadLock lock = tree.reading();
+  for (std::size_t k = 0 ; k < sets.size() ; ++k)
+    for (unsigned int i = 0 ; i < RAYS ; ++i)
+    {
+      octomap::OcTreeNode *node = tree.search(sets[k].first + rayDirection(sets[k].second, i) * (RANGE / 2.0));
+      if (!node || node->getLogOdds() >= 0.0f)
+        return false;
+    }
+  return true;
+}
+
+}
+
+TEST(LazyFreeSpaceUpdater, BurstFromOneOriginIsMerged)
+{
+  OccMapTreePtr tree(new OccMapTree(RESOLUTION));
+  LazyFreeSpaceUpdater updater(tree, 1, 2);
+
+  // every set is a batch of its own, and they are pushed much faster than they can be processed, so the queue fills up
+  // and always holds a batch from the same origin to merge into
+  std::vector<std::pair<octomap::point3d, unsigned int> > sets;
+  octomap::point3d origin(0.0, 0.0, 0.0);
+  for (unsigned int k = 0 ; k < 100 ; ++k)
+  {
+    sets.push_back(std::make_pair(origin, k));
+    updater.pushLazyUpdate(makeOccupiedCells(*tree, origin, k), new octomap::KeySet(), origin);
+  }
+
+  ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(60.0);
+  while (!raysCleared(*tree, sets) && ros::WallTime::now() < deadline)
+    ros::WallDuration(0.05).sleep();
+
+  EXPECT_TRUE(raysCleared(*tree, sets));
+  EXPECT_EQ(0u, updater.getDroppedBatchCount());
+  EXPECT_GT(updater.getMergedBatchCount(), 0u);
+  EXPECT_GT(updater.getProcessedBatchCount(), 0u);
+}
+
+TEST(LazyFreeSpaceUpdater, BurstFromMovingOriginIsBounded)
+{
+  OccMapTreePtr tree(new OccMapTree(RESOLUTION));
+  LazyFreeSpaceUpdater updater(tree, 1, 2);
+
+  // every set has its own origin, so nothing can be merged and every set is a batch of its own
+  const std::size_t count = 50;
+  for (unsigned int k = 0 ; k < count ; ++k)
+  {
+    octomap::point3d origin(0.01 * k, 0.0, 0.0);
+    updater.pushLazyUpdate(makeOccupiedCells(*tree, origin, k), new octomap::KeySet(), origin);
+  }
+
+  ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(60.0);
+  while (updater.getProcessedBatchCount() + updater.getDroppedBatchCount() < count && ros::WallTime::now() < deadline)
+    ros::WallDuration(0.05).sleep();
+
+  EXPECT_EQ(0u, updater.getMergedBatchCount());
+  EXPECT_EQ(count, updater.getProcessedBatchCount() + updater.getDroppedBatchCount());
+  EXPECT_GT(updater.getProcessedBatchCount(), 0u);
+}
+
+TEST(LazyFreeSpaceUpdater, BatchesAreMergedOnlyWhenTheQueueIsFull)
+{
+  OccMapTreePtr tree(new OccMapTree(RESOLUTION));
+  LazyFreeSpaceUpdater updater(tree, 3, 1000);
+
+  // a burst from one origin is split into batches of at most 3 sets, and none is merged while the queue has room
+  const std::size_t count = 30;
+  octomap::point3d origin(0.0, 0.0, 0.0);
+  for (unsigned int k = 0 ; k < count ; ++k)
+    updater.pushLazyUpdate(makeOccupiedCells(*tree, origin, k), new octomap::KeySet(), origin);
+
+  ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(60.0);
+  while (updater.getProcessedBatchCount() < count / 3 && ros::WallTime::now() < deadline)
+    ros::WallDuration(0.05).sleep();
+
+  EXPECT_EQ(0u, updater.getMergedBatchCount());
+  EXPECT_EQ(0u, updater.getDroppedBatchCount());
+  EXPECT_EQ(count / 3, updater.getProcessedBatchCount());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::Time::init();
+  return RUN_ALL_TESTS();
+}
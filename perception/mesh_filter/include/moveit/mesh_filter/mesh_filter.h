@@ -67,10 +67,12 @@ class MeshFilter : public MeshFilterBase
      * \brief Constructor
      * \author Suat Gedikli (gedikli@willowgarage.com)
      * \param[in] transform_callback Callback function that is called for each mesh to obtain the current transformation.
+     * \param[in] backend render with OpenGL or on the CPU
      * \note the callback expects the mesh handle but no time stamp. Its the users responsibility to return the correct transformation.
      */
     MeshFilter (const TransformCallback& transform_callback = TransformCallback(),
-                const typename SensorType::Parameters& sensor_parameters = typename SensorType::Parameters ());
+                const typename SensorType::Parameters& sensor_parameters = typename SensorType::Parameters (),
+                RenderBackend backend = OpenGLBackend);
 
     /**
      * \brief returns the Sensor Parameters
@@ -89,10 +91,11 @@ class MeshFilter : public MeshFilterBase
 
 template<typename SensorType>
 MeshFilter<SensorType>::MeshFilter (const TransformCallback& transform_callback,
-                                    const typename SensorType::Parameters& sensor_parameters)
+                                    const typename SensorType::Parameters& sensor_parameters,
+                                    RenderBackend backend)
 : MeshFilterBase (transform_callback, sensor_parameters,
                   SensorType::renderVertexShaderSource, SensorType::renderFragmentShaderSource,
-                  SensorType::filterVertexShaderSource, SensorType::filterFragmentShaderSource)
+                  SensorType::filterVertexShaderSource, SensorType::filterFragmentShaderSource, backend)
 {
 }
 
@@ -39,6 +39,7 @@
 
 #include <map>
 #include <moveit/mesh_filter/gl_renderer.h>
+#include <moveit/mesh_filter/software_renderer.h>
 #include <moveit/mesh_filter/sensor_model.h>
 #include <boost/function.hpp>
 #include <boost/thread/mutex.hpp>
@@ -68,17 +69,22 @@ class MeshFilterBase
   // \todo @suat: to avoid a few comparisons, it would be much nicer if background = 14 and shadow = 15 (near/far clip can be anything below that)
   // this would allow me to do a single comparison instead of 3, in the code i write
     enum {Background = 0, Shadow = 1, NearClip = 2, FarClip = 3, FirstLabel = 16};
+
+    /** \brief how the meshes are rendered: with OpenGL, which requires a display, or on the CPU with SoftwareRenderer */
+    enum RenderBackend {OpenGLBackend, SoftwareBackend};
   public:
     /**
      * \brief Constructor
      * \author Suat Gedikli (gedikli@willowgarage.com)
      * \param[in] transform_callback Callback function that is called for each mesh to obtain the current transformation.
+     * \param[in] backend the renderer to use. The shaders are ignored by the software backend.
      * \note the callback expects the mesh handle but no time stamp. Its the users responsibility to return the correct transformation.
      */
     MeshFilterBase (const TransformCallback& transform_callback,
                     const SensorModel::Parameters& sensor_parameters,
                     const std::string& render_vertex_shader = "", const std::string& render_fragment_shader = "",
-                    const std::string& filter_vertex_shader = "", const std::string& filter_fragment_shader = "");
+                    const std::string& filter_vertex_shader = "", const std::string& filter_fragment_shader = "",
+                    RenderBackend backend = OpenGLBackend);
 
     /** \brief Desctructor */
     ~MeshFilterBase ();
@@ -167,6 +173,15 @@ class MeshFilterBase
      */
     void setPaddingOffset (float offset);
 
+    /** \brief returns the backend used for rendering */
+    RenderBackend getRenderBackend () const;
+
+    /**
+     * \brief set the number of threads used by the software backend to rasterize the meshes
+     * \param[in] threads the number of threads; 0 means the default number of OpenMP threads
+     */
+    void setRenderThreadCount (unsigned int threads);
+
   protected:
 
     /**
@@ -193,6 +208,25 @@ class MeshFilterBase
      */
     void doFilter (const void* sensor_data, const int encoding) const;
 
+    /**
+     * \brief doFilter for the software backend
+     * \param[in] sensor_data pointer to the buffer containing the depth readings
+     * \param[in] encoding the representation of the depth readings in the buffer
+     */
+    void doFilterSoftware (const void* sensor_data, const int encoding) const;
+
+    /**
+     * \brief used within a Job to copy the filtered depth values of the software backend
+     * \param[out] depth pointer to buffer to be filled with depth values.
+     */
+    void readFilteredDepth (float* depth) const;
+
+    /**
+     * \brief used within a Job to copy the filtered labels of the software backend
+     * \param[out] labels pointer to buffer to be filled with labels
+     */
+    void readFilteredLabels (LabelType* labels) const;
+
     /**
      * \brief used within a Job to allow the main thread adding meshes
      * \param[in] handle the handle of the mesh that is predetermined and passed
@@ -223,6 +257,9 @@ class MeshFilterBase
     /** \brief storage for meshed to be filtered */
     std::map<MeshHandle, boost::shared_ptr<GLMesh> > meshes_;
 
+    /** \brief storage for meshes to be filtered by the software backend */
+    std::map<MeshHandle, boost::shared_ptr<SoftwareMesh> > software_meshes_;
+
     /** \brief the parameters of the used sensor model*/
     boost::shared_ptr<SensorModel::Parameters> sensor_parameters_;
 
@@ -232,6 +269,9 @@ class MeshFilterBase
     /** \brief Handle values below this are all taken (this variable is used for more efficient computation of next_label_) */
     MeshHandle min_handle_;
 
+    /** \brief the backend used for rendering */
+    RenderBackend backend_;
+
     /** \brief the filtering thread that also holds the OpenGL context*/
     boost::thread filter_thread_;
 
@@ -259,6 +299,21 @@ class MeshFilterBase
     /** \brief second pass renderer for filtering the results of first pass*/
     boost::shared_ptr<GLRenderer> depth_filter_;
 
+    /** \brief renderer of the software backend; it does the first pass, the second pass is done by the sensor model */
+    boost::shared_ptr<SoftwareRenderer> software_renderer_;
+
+    /** \brief number of threads for the software renderer */
+    unsigned int render_threads_;
+
+    /** \brief sensor readings normalized to the clipping range (software backend) */
+    mutable std::vector<float> sensor_depth_;
+
+    /** \brief result of the second pass of the software backend */
+    mutable std::vector<float> filtered_depth_;
+
+    /** \brief result of the second pass of the software backend */
+    mutable std::vector<LabelType> filtered_labels_;
+
     /** \brief canvas element (screen-filling quad) for second pass*/
     GLuint canvas_;
 
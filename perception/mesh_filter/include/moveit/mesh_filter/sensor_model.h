@@ -38,12 +38,14 @@
 #define MOVEIT_MESH_FILTER_SENSOR_MODEL_
 
 #include <Eigen/Eigen>
+#include <stdint.h>
 
 namespace mesh_filter
 {
 
 //forward declarations
 class GLRenderer;
+class SoftwareRenderer;
 
 /**
  * \brief Abstract Interface defining a sensor model for mesh filtering
@@ -86,6 +88,27 @@ public:
      */
     virtual void setFilterParameters (GLRenderer& renderer) const = 0;
 
+    /**
+     * \brief sets the parameters of the software renderer, the counterpart of setRenderParameters (GLRenderer&).
+     * The default implementation throws, for sensors that only support rendering with OpenGL.
+     * \param renderer the renderer that needs to be updated
+     */
+    virtual void setSoftwareRenderParameters (SoftwareRenderer& renderer) const;
+
+    /**
+     * \brief computes the filtered labels and depth values from the rendered model, the counterpart of the filter shaders.
+     * All depth values are normalized to the clipping range, as in the OpenGL depth buffers.
+     * The default implementation throws, for sensors that only support rendering with OpenGL.
+     * \param[in] sensor_depth the sensor readings, clamped to [0, 1]
+     * \param[in] model_depth the depth buffer of the rendered model
+     * \param[in] model_labels the labels of the rendered model
+     * \param[in] shadow_threshold the shadow threshold in meters
+     * \param[out] filtered_depth the filtered depth values
+     * \param[out] filtered_labels the filtered labels
+     */
+    virtual void filterSoftware (const float* sensor_depth, const float* model_depth, const uint32_t* model_labels,
+                                 float shadow_threshold, float* filtered_depth, uint32_t* filtered_labels) const;
+
     /**
      * \brief polymorphic clone method
      * \return clones object as base class
@@ -0,0 +1,219 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_MESH_FILTER_SOFTWARE_RENDERER_
+#define MOVEIT_MESH_FILTER_SOFTWARE_RENDERER_
+
+#include <Eigen/Eigen>
+#include <stdint.h>
+#include <vector>
+
+namespace shapes
+{
+  class Mesh;
+}
+
+namespace mesh_filter
+{
+/**
+ * \brief SoftwareMesh represents a mesh from geometric_shapes for rendering with the SoftwareRenderer
+ */
+class SoftwareMesh
+{
+  public:
+    /**
+     * \brief Constucts a SoftwareMesh object for given mesh and label
+     * \param[in] mesh the mesh; vertex normals need to be computed
+     * \param[in] mesh_label the label written to the color buffer for pixels covered by this mesh
+     */
+    SoftwareMesh (const shapes::Mesh& mesh, unsigned int mesh_label);
+
+    /** \brief label of the mesh */
+    unsigned int getLabel () const { return mesh_label_; }
+
+    /** \brief vertex positions, 3 floats per vertex */
+    const std::vector<float>& getVertices () const { return vertices_; }
+
+    /** \brief vertex normals, 3 floats per vertex */
+    const std::vector<float>& getNormals () const { return normals_; }
+
+    /** \brief vertex indices, 3 per triangle */
+    const std::vector<unsigned int>& getTriangles () const { return triangles_; }
+
+  private:
+    std::vector<float> vertices_;
+    std::vector<float> normals_;
+    std::vector<unsigned int> triangles_;
+
+    /** \brief label of current mesh*/
+    unsigned int mesh_label_;
+};
+
+/**
+ * \brief Renders meshes into a depth and a label buffer on the CPU, without an OpenGL context.
+ * The buffers have the same layout and content as the ones of GLRenderer used by MeshFilterBase:
+ * the depth buffer holds normalized window depth values (0 on the near, 1 on the far clipping plane), the
+ * color buffer holds the label of the closest mesh or 0. Faces pointing away from the camera are culled and
+ * vertices are padded along their normals the same way the vertex shaders of the sensor models do.
+ * Triangles are binned into screen tiles and the tiles are rasterized in parallel.
+ */
+class SoftwareRenderer
+{
+  public:
+    /**
+     * \brief constructs a renderer with a frame buffer of given size and clipping range
+     * \param[in] width width of the frame buffer in pixels
+     * \param[in] height height of the frame buffer in pixels
+     * \param[in] near distance of the near clipping plane in meters
+     * \param[in] far distance of the far clipping plane in meters
+     */
+    SoftwareRenderer (unsigned width, unsigned height, float near = 0.1, float far = 10.0);
+
+    /**
+     * \brief set the size of the frame buffers
+     * \param[in] width width of frame buffers in pixels
+     * \param[in] height height of frame buffers in pixels
+     */
+    void setBufferSize (unsigned width, unsigned height);
+
+    /**
+     * \brief set the near and far clipping plane distances
+     * \param[in] near distance of the near clipping plane in meters
+     * \param[in] far distance of the far clipping plane in meters
+     */
+    void setClippingRange (float near, float far);
+
+    /**
+     * \brief set the camera parameters
+     * \param[in] fx focal length in x-direction
+     * \param[in] fy focal length in y-direction
+     * \param[in] cx x component of principal point
+     * \param[in] cy y component of principal point
+     */
+    void setCameraParameters (float fx, float fy, float cx, float cy);
+
+    /**
+     * \brief set the coefficients of the quadratic in the vertex depth that gives the distance vertices are moved along their normals
+     * \param[in] padding_coefficients quadratic, linear and constant coefficient, as used by the sensor model shaders
+     */
+    void setPaddingCoefficients (const Eigen::Vector3f& padding_coefficients);
+
+    /**
+     * \brief set the number of threads used for rasterization
+     * \param[in] threads the number of threads; 0 means the default number of OpenMP threads
+     */
+    void setThreadCount (unsigned int threads);
+
+    /** \brief the number of threads actually used for rasterization */
+    unsigned int getThreadCount () const;
+
+    /** \brief clears the frame buffers and starts a new frame */
+    void begin ();
+
+    /**
+     * \brief transforms, pads and clips the triangles of a mesh and queues them for rasterization
+     * \param[in] mesh the mesh to be rendered
+     * \param[in] transform the pose of the mesh in the camera frame (z pointing forward, y down)
+     */
+    void render (const SoftwareMesh& mesh, const Eigen::Affine3d& transform);
+
+    /** \brief rasterizes all triangles queued since begin() */
+    void end ();
+
+    /**
+     * \brief copies the labels into a buffer of width x height 32 bit values
+     * \param[out] buffer the buffer to be filled
+     */
+    void getColorBuffer (unsigned char* buffer) const;
+
+    /**
+     * \brief copies the normalized depth values into a buffer of width x height floats
+     * \param[out] buffer the buffer to be filled
+     */
+    void getDepthBuffer (float* buffer) const;
+
+    /** \brief the normalized depth values of the last frame */
+    const float* getDepthData () const { return &depth_[0]; }
+
+    /** \brief the labels of the last frame */
+    const uint32_t* getLabelData () const { return &labels_[0]; }
+
+    const unsigned getWidth () const { return width_; }
+    const unsigned getHeight () const { return height_; }
+    const float getNearClippingDistance () const { return near_; }
+    const float getFarClippingDistance () const { return far_; }
+
+    /** \brief edge length of the square screen tiles that are rasterized in parallel */
+    static const unsigned TILE_SIZE = 32;
+
+  private:
+
+    /** \brief a triangle in window coordinates, oriented counter clockwise */
+    struct Triangle
+    {
+      double x_[3];
+      double y_[3];
+      double depth_[3];
+      uint32_t label_;
+      int min_x_, max_x_, min_y_, max_y_;
+    };
+
+    void addTriangle (const Eigen::Vector3f* vertices, uint32_t label);
+    void addClippedTriangle (const Eigen::Vector3f& a, const Eigen::Vector3f& b, const Eigen::Vector3f& c, uint32_t label);
+    void rasterize (const Triangle& triangle, int min_x, int max_x, int min_y, int max_y);
+
+    unsigned width_;
+    unsigned height_;
+    float near_;
+    float far_;
+    float fx_;
+    float fy_;
+    float cx_;
+    float cy_;
+    Eigen::Vector3f padding_coefficients_;
+    unsigned int threads_;
+
+    std::vector<float> depth_;
+    std::vector<uint32_t> labels_;
+
+    std::vector<Triangle> triangles_;
+    unsigned tiles_x_;
+    unsigned tiles_y_;
+    std::vector<std::vector<unsigned int> > tiles_;
+
+    // transformed vertices of the mesh being rendered, kept between calls to avoid allocations
+    std::vector<Eigen::Vector3f> transformed_;
+};
+} // namespace mesh_filter
+#endif
@@ -93,6 +93,19 @@ public:
        */
       void setFilterParameters (GLRenderer& renderer) const;
 
+      /**
+       * \brief set the camera parameters of the software renderer used for the model rendering
+       * \param[in] renderer the software renderer
+       */
+      void setSoftwareRenderParameters (SoftwareRenderer& renderer) const;
+
+      /**
+       * \brief labels the sensor readings the same way the filter shader does
+       * \see SensorModel::Parameters::filterSoftware
+       */
+      void filterSoftware (const float* sensor_depth, const float* model_depth, const uint32_t* model_labels,
+                           float shadow_threshold, float* filtered_depth, uint32_t* filtered_labels) const;
+
       /**
        * \brief sets the camera parameters of the pinhole camera where the disparities were obtained. Usually the left camera
        * \param[in] fx focal length in x-direction
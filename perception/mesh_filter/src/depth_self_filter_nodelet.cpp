@@ -71,6 +71,8 @@ void mesh_filter::DepthSelfFiltering::onInit()
   private_nh.param("shadow_threshold", shadow_threshold_, 0.3);
   private_nh.param("padding_scale", padding_scale_, 1.0);
   private_nh.param("padding_offset", padding_offset_, 0.005);
+  std::string render_backend;
+  private_nh.param("render_backend", render_backend, std::string("opengl"));
   double tf_update_rate = 30;
   private_nh.param("tf_update_rate", tf_update_rate, 30.0);
   transform_provider_.setUpdateInterval (long(1000000.0 / tf_update_rate));
@@ -90,7 +92,8 @@ void mesh_filter::DepthSelfFiltering::onInit()
   model_label_ptr_.reset (new cv_bridge::CvImage);
 
   mesh_filter_.reset (new MeshFilter<StereoCameraModel>(bind(&TransformProvider::getTransform, &transform_provider_, _1, _2),
-                                                       mesh_filter::StereoCameraModel::RegisteredPSDKParams));
+                                                       mesh_filter::StereoCameraModel::RegisteredPSDKParams,
+                                                       render_backend == "software" ? MeshFilterBase::SoftwareBackend : MeshFilterBase::OpenGLBackend));
   mesh_filter_->parameters ().setDepthRange (near_clipping_plane_distance_, far_clipping_plane_distance_);
   mesh_filter_->setShadowThreshold(shadow_threshold_);
   mesh_filter_->setPaddingOffset (padding_offset_);
@@ -41,6 +41,7 @@
 #include <geometric_shapes/shapes.h>
 #include <geometric_shapes/shape_operations.h>
 #include <Eigen/Eigen>
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 #include <sensor_msgs/image_encodings.h>
@@ -62,11 +63,14 @@ using boost::mutex;
 mesh_filter::MeshFilterBase::MeshFilterBase (const TransformCallback& transform_callback,
               const SensorModel::Parameters& sensor_parameters,
               const string& render_vertex_shader, const string& render_fragment_shader,
-              const string& filter_vertex_shader, const string& filter_fragment_shader)
+              const string& filter_vertex_shader, const string& filter_fragment_shader,
+              RenderBackend backend)
 : sensor_parameters_ (sensor_parameters.clone ())
 , next_handle_ (FirstLabel) // 0 and 1 are reserved!
 , min_handle_ (FirstLabel)
+, backend_ (backend)
 , stop_ (false)
+, render_threads_ (0)
 , transform_callback_ (transform_callback)
 , padding_scale_ (1.0)
 , padding_offset_ (0.01)
@@ -80,6 +84,15 @@ mesh_filter::MeshFilterBase::MeshFilterBase (const TransformCallback& transform_
 void mesh_filter::MeshFilterBase::initialize (const string& render_vertex_shader, const string& render_fragment_shader,
                                               const string& filter_vertex_shader, const string& filter_fragment_shader)
 {
+  if (backend_ == SoftwareBackend)
+  {
+    // no OpenGL context is needed
+    software_renderer_.reset (new SoftwareRenderer (sensor_parameters_->getWidth(), sensor_parameters_->getHeight(),
+                                                    sensor_parameters_->getNearClippingPlaneDistance (),
+                                                    sensor_parameters_->getFarClippingPlaneDistance ()));
+    return;
+  }
+
   mesh_renderer_.reset (new GLRenderer (sensor_parameters_->getWidth(), sensor_parameters_->getHeight(),
                                         sensor_parameters_->getNearClippingPlaneDistance (),
                                         sensor_parameters_->getFarClippingPlaneDistance ()));
@@ -149,16 +162,28 @@ void mesh_filter::MeshFilterBase::addJob (const boost::shared_ptr<Job> &job) con
 
 void mesh_filter::MeshFilterBase::deInitialize ()
 {
-  glDeleteLists (canvas_, 1);
-  glDeleteTextures (1, &sensor_depth_texture_);
+  if (backend_ == OpenGLBackend)
+  {
+    glDeleteLists (canvas_, 1);
+    glDeleteTextures (1, &sensor_depth_texture_);
+  }
 
   meshes_.clear ();
+  software_meshes_.clear ();
   mesh_renderer_.reset();
   depth_filter_.reset();
+  software_renderer_.reset();
 }
 
 void mesh_filter::MeshFilterBase::setSize (unsigned int width, unsigned int height)
 {
+  if (backend_ == SoftwareBackend)
+  {
+    software_renderer_->setBufferSize (width, height);
+    software_renderer_->setCameraParameters (width, width, width >> 1, height >> 1);
+    return;
+  }
+
   mesh_renderer_->setBufferSize (width, height);
   mesh_renderer_->setCameraParameters (width, width, width >> 1, height >> 1);
 
@@ -180,9 +205,9 @@ mesh_filter::MeshHandle mesh_filter::MeshFilterBase::addMesh (const Mesh& mesh)
   addJob(job);
   job->wait ();
   mesh_filter::MeshHandle ret = next_handle_;
-  const std::size_t sz = min_handle_ + meshes_.size() + 1;
+  const std::size_t sz = min_handle_ + meshes_.size() + software_meshes_.size() + 1;
   for (std::size_t i = min_handle_ ; i < sz ; ++i)
-    if (meshes_.find(i) == meshes_.end())
+    if (meshes_.find(i) == meshes_.end() && software_meshes_.find(i) == software_meshes_.end())
     {
       next_handle_ = i;
       break;
@@ -193,7 +218,10 @@ mesh_filter::MeshHandle mesh_filter::MeshFilterBase::addMesh (const Mesh& mesh)
 
 void mesh_filter::MeshFilterBase::addMeshHelper (MeshHandle handle, const Mesh *cmesh)
 {
-  meshes_[handle] = shared_ptr<GLMesh> (new GLMesh (*cmesh, handle));
+  if (backend_ == SoftwareBackend)
+    software_meshes_[handle] = shared_ptr<SoftwareMesh> (new SoftwareMesh (*cmesh, handle));
+  else
+    meshes_[handle] = shared_ptr<GLMesh> (new GLMesh (*cmesh, handle));
 }
 
 void mesh_filter::MeshFilterBase::removeMesh (MeshHandle handle)
@@ -211,7 +239,7 @@ void mesh_filter::MeshFilterBase::removeMesh (MeshHandle handle)
 
 bool mesh_filter::MeshFilterBase::removeMeshHelper (MeshHandle handle)
 {
-  std::size_t erased = meshes_.erase (handle);
+  std::size_t erased = meshes_.erase (handle) + software_meshes_.erase (handle);
   return (erased != 0);
 }
 
@@ -220,16 +248,34 @@ void mesh_filter::MeshFilterBase::setShadowThreshold (float threshold)
   shadow_threshold_ = threshold;
 }
 
+mesh_filter::MeshFilterBase::RenderBackend mesh_filter::MeshFilterBase::getRenderBackend () const
+{
+  return backend_;
+}
+
+void mesh_filter::MeshFilterBase::setRenderThreadCount (unsigned int threads)
+{
+  render_threads_ = threads;
+}
+
 void mesh_filter::MeshFilterBase::getModelLabels (LabelType* labels) const
 {
-  shared_ptr<Job> job (new FilterJob<void> (boost::bind (&GLRenderer::getColorBuffer, mesh_renderer_.get(), (unsigned char*) labels)));
+  shared_ptr<Job> job;
+  if (backend_ == SoftwareBackend)
+    job.reset (new FilterJob<void> (boost::bind (&SoftwareRenderer::getColorBuffer, software_renderer_.get(), (unsigned char*) labels)));
+  else
+    job.reset (new FilterJob<void> (boost::bind (&GLRenderer::getColorBuffer, mesh_renderer_.get(), (unsigned char*) labels)));
   addJob(job);
   job->wait ();
 }
 
 void mesh_filter::MeshFilterBase::getModelDepth (float* depth) const
 {
-  shared_ptr<Job> job1 (new FilterJob<void> (boost::bind (&GLRenderer::getDepthBuffer, mesh_renderer_.get(), depth)));
+  shared_ptr<Job> job1;
+  if (backend_ == SoftwareBackend)
+    job1.reset (new FilterJob<void> (boost::bind (&SoftwareRenderer::getDepthBuffer, software_renderer_.get(), depth)));
+  else
+    job1.reset (new FilterJob<void> (boost::bind (&GLRenderer::getDepthBuffer, mesh_renderer_.get(), depth)));
   shared_ptr<Job> job2 (new FilterJob<void> (boost::bind (&SensorModel::Parameters::transformModelDepthToMetricDepth, sensor_parameters_.get(), depth)));
   {
     unique_lock<mutex> lock (jobs_mutex_);
@@ -243,7 +289,11 @@ void mesh_filter::MeshFilterBase::getModelDepth (float* depth) const
 
 void mesh_filter::MeshFilterBase::getFilteredDepth (float* depth) const
 {
-  shared_ptr<Job> job1 (new FilterJob<void> (boost::bind (&GLRenderer::getDepthBuffer, depth_filter_.get(), depth)));
+  shared_ptr<Job> job1;
+  if (backend_ == SoftwareBackend)
+    job1.reset (new FilterJob<void> (boost::bind (&MeshFilterBase::readFilteredDepth, this, depth)));
+  else
+    job1.reset (new FilterJob<void> (boost::bind (&GLRenderer::getDepthBuffer, depth_filter_.get(), depth)));
   shared_ptr<Job> job2 (new FilterJob<void> (boost::bind (&SensorModel::Parameters::transformFilteredDepthToMetricDepth, sensor_parameters_.get(), depth)));
   {
     unique_lock<mutex> lock (jobs_mutex_);
@@ -257,11 +307,25 @@ void mesh_filter::MeshFilterBase::getFilteredDepth (float* depth) const
 
 void mesh_filter::MeshFilterBase::getFilteredLabels (LabelType* labels) const
 {
-  shared_ptr<Job> job (new FilterJob<void> (boost::bind (&GLRenderer::getColorBuffer, depth_filter_.get(), (unsigned char*) labels)));
+  shared_ptr<Job> job;
+  if (backend_ == SoftwareBackend)
+    job.reset (new FilterJob<void> (boost::bind (&MeshFilterBase::readFilteredLabels, this, labels)));
+  else
+    job.reset (new FilterJob<void> (boost::bind (&GLRenderer::getColorBuffer, depth_filter_.get(), (unsigned char*) labels)));
   addJob(job);
   job->wait ();
 }
 
+void mesh_filter::MeshFilterBase::readFilteredDepth (float* depth) const
+{
+  std::copy (filtered_depth_.begin (), filtered_depth_.end (), depth);
+}
+
+void mesh_filter::MeshFilterBase::readFilteredLabels (LabelType* labels) const
+{
+  std::copy (filtered_labels_.begin (), filtered_labels_.end (), labels);
+}
+
 void mesh_filter::MeshFilterBase::run (const string& render_vertex_shader, const string& render_fragment_shader,
                                        const string& filter_vertex_shader, const string& filter_fragment_shader)
 {
@@ -304,6 +368,12 @@ void mesh_filter::MeshFilterBase::filter (const void* sensor_data, GLushort type
 
 void mesh_filter::MeshFilterBase::doFilter (const void* sensor_data, const int encoding) const
 {
+  if (backend_ == SoftwareBackend)
+  {
+    doFilterSoftware (sensor_data, encoding);
+    return;
+  }
+
   mutex::scoped_lock _(transform_callback_mutex_);
 
   mesh_renderer_->begin ();
@@ -380,6 +450,55 @@ void mesh_filter::MeshFilterBase::doFilter (const void* sensor_data, const int e
   depth_filter_->end ();
 }
 
+namespace
+{
+inline float clampDepth (float depth)
+{
+  // same as the clamping of depth components during pixel transfer; also maps NaN to 0
+  return depth > 0 ? (depth < 1 ? depth : 1) : 0;
+}
+}
+
+void mesh_filter::MeshFilterBase::doFilterSoftware (const void* sensor_data, const int encoding) const
+{
+  mutex::scoped_lock _(transform_callback_mutex_);
+
+  software_renderer_->setThreadCount (render_threads_);
+  sensor_parameters_->setSoftwareRenderParameters (*software_renderer_);
+  software_renderer_->setPaddingCoefficients (sensor_parameters_->getPaddingCoefficients () * padding_scale_ + Eigen::Vector3f (0, 0, padding_offset_));
+  software_renderer_->begin ();
+
+  Affine3d transform;
+  for (std::map<MeshHandle, shared_ptr<SoftwareMesh> >::const_iterator meshIt = software_meshes_.begin (); meshIt != software_meshes_.end (); ++meshIt)
+    if (transform_callback_ (meshIt->first, transform))
+      software_renderer_->render (*meshIt->second, transform);
+
+  software_renderer_->end ();
+
+  // map the sensor readings between near and far clipping plane to 0 - 1, as the pixel transfer into the sensor texture does
+  const unsigned size = sensor_parameters_->getWidth () * sensor_parameters_->getHeight ();
+  const float near = sensor_parameters_->getNearClippingPlaneDistance ();
+  const float scale = 1.0 / (sensor_parameters_->getFarClippingPlaneDistance () - near);
+  sensor_depth_.resize (size);
+  filtered_depth_.resize (size);
+  filtered_labels_.resize (size);
+  if (encoding == GL_UNSIGNED_SHORT)
+  {
+    const unsigned short* data = static_cast<const unsigned short*> (sensor_data);
+    for (unsigned idx = 0; idx < size; ++idx)
+      sensor_depth_ [idx] = clampDepth ((data [idx] * 0.001f - near) * scale);
+  }
+  else
+  {
+    const float* data = static_cast<const float*> (sensor_data);
+    for (unsigned idx = 0; idx < size; ++idx)
+      sensor_depth_ [idx] = clampDepth ((data [idx] - near) * scale);
+  }
+
+  sensor_parameters_->filterSoftware (&sensor_depth_ [0], software_renderer_->getDepthData (), software_renderer_->getLabelData (),
+                                      shadow_threshold_, &filtered_depth_ [0], &filtered_labels_ [0]);
+}
+
 void mesh_filter::MeshFilterBase::setPaddingOffset (float offset)
 {
   padding_offset_ = offset;
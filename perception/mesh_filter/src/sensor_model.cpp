@@ -72,6 +72,17 @@ void mesh_filter::SensorModel::Parameters::setDepthRange (float near, float far)
   far_clipping_plane_distance_ = far;
 }
 
+void mesh_filter::SensorModel::Parameters::setSoftwareRenderParameters (SoftwareRenderer& renderer) const
+{
+  throw std::runtime_error ("This sensor model does not support the software renderer");
+}
+
+void mesh_filter::SensorModel::Parameters::filterSoftware (const float* sensor_depth, const float* model_depth, const uint32_t* model_labels,
+                                                           float shadow_threshold, float* filtered_depth, uint32_t* filtered_labels) const
+{
+  throw std::runtime_error ("This sensor model does not support the software renderer");
+}
+
 unsigned mesh_filter::SensorModel::Parameters::getWidth () const
 {
   return width_;
@@ -0,0 +1,344 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/mesh_filter/software_renderer.h>
+#include <geometric_shapes/shapes.h>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <cstring>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+using namespace Eigen;
+
+mesh_filter::SoftwareMesh::SoftwareMesh (const shapes::Mesh& mesh, unsigned int mesh_label)
+: mesh_label_ (mesh_label)
+{
+  if (!mesh.vertex_normals)
+    throw runtime_error("Vertex normals are not computed for input mesh. Call computeVertexNormals() before passing as input to mesh_filter.");
+
+  vertices_.assign (mesh.vertices, mesh.vertices + 3 * mesh.vertex_count);
+  normals_.assign (mesh.vertex_normals, mesh.vertex_normals + 3 * mesh.vertex_count);
+  triangles_.assign (mesh.triangles, mesh.triangles + 3 * mesh.triangle_count);
+}
+
+mesh_filter::SoftwareRenderer::SoftwareRenderer (unsigned width, unsigned height, float near, float far)
+: width_ (0)
+, height_ (0)
+, near_ (near)
+, far_ (far)
+, fx_ (width >> 1) // 90 degree wide angle
+, fy_ (fx_)
+, cx_ (width >> 1)
+, cy_ (height >> 1)
+, padding_coefficients_ (Vector3f::Zero ())
+, threads_ (1)
+, tiles_x_ (0)
+, tiles_y_ (0)
+{
+  setClippingRange (near, far);
+  setBufferSize (width, height);
+  setThreadCount (0);
+}
+
+void mesh_filter::SoftwareRenderer::setBufferSize (unsigned width, unsigned height)
+{
+  if (width_ != width || height_ != height || depth_.empty ())
+  {
+    width_ = width;
+    height_ = height;
+    depth_.assign (width_ * height_, 1.0f);
+    labels_.assign (width_ * height_, 0);
+    tiles_x_ = (width_ + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_y_ = (height_ + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_.resize (tiles_x_ * tiles_y_);
+  }
+}
+
+void mesh_filter::SoftwareRenderer::setClippingRange (float near, float far)
+{
+  if (near <= 0)
+    throw runtime_error ("near clipping plane distance needs to be larger than 0");
+  if (far <= near)
+    throw runtime_error ("far clipping plane needs to be larger than near clipping plane distance");
+  near_ = near;
+  far_ = far;
+}
+
+void mesh_filter::SoftwareRenderer::setCameraParameters (float fx, float fy, float cx, float cy)
+{
+  fx_ = fx;
+  fy_ = fy;
+  cx_ = cx;
+  cy_ = cy;
+}
+
+void mesh_filter::SoftwareRenderer::setPaddingCoefficients (const Vector3f& padding_coefficients)
+{
+  padding_coefficients_ = padding_coefficients;
+}
+
+void mesh_filter::SoftwareRenderer::setThreadCount (unsigned int threads)
+{
+#ifdef _OPENMP
+  threads_ = threads > 0 ? threads : std::max (1, omp_get_max_threads ());
+#else
+  threads_ = 1;
+#endif
+}
+
+unsigned int mesh_filter::SoftwareRenderer::getThreadCount () const
+{
+  return threads_;
+}
+
+void mesh_filter::SoftwareRenderer::begin ()
+{
+  std::fill (depth_.begin (), depth_.end (), 1.0f);
+  std::fill (labels_.begin (), labels_.end (), 0);
+  triangles_.clear ();
+}
+
+void mesh_filter::SoftwareRenderer::render (const SoftwareMesh& mesh, const Affine3d& transform)
+{
+  const Affine3f pose = transform.cast<float> ();
+  const Matrix3f rotation = pose.linear ();
+  const vector<float>& vertices = mesh.getVertices ();
+  const vector<float>& normals = mesh.getNormals ();
+  const std::size_t vertex_count = vertices.size () / 3;
+
+  transformed_.resize (vertex_count);
+  for (std::size_t i = 0 ; i < vertex_count ; ++i)
+  {
+    Vector3f vertex = pose * Map<const Vector3f> (&vertices [3 * i]);
+    Vector3f normal = rotation * Map<const Vector3f> (&normals [3 * i]);
+    if (normal.squaredNorm () > 0)
+      normal.normalize ();
+    // same as the vertex shaders of the sensor models, which see the depth in OpenGL eye coordinates (looking along -z)
+    const float z = -vertex.z ();
+    const float lambda = padding_coefficients_ [0] * z * z + padding_coefficients_ [1] * z + padding_coefficients_ [2];
+    transformed_ [i] = vertex + lambda * normal;
+  }
+
+  const vector<unsigned int>& triangles = mesh.getTriangles ();
+  Vector3f corners [3];
+  for (std::size_t t = 0 ; t + 2 < triangles.size () ; t += 3)
+  {
+    corners [0] = transformed_ [triangles [t]];
+    corners [1] = transformed_ [triangles [t + 1]];
+    corners [2] = transformed_ [triangles [t + 2]];
+    addTriangle (corners, mesh.getLabel ());
+  }
+}
+
+void mesh_filter::SoftwareRenderer::addTriangle (const Vector3f* vertices, uint32_t label)
+{
+  unsigned inside = 0;
+  unsigned beyond = 0;
+  for (unsigned i = 0 ; i < 3 ; ++i)
+  {
+    if (vertices [i].z () >= near_)
+      ++inside;
+    if (vertices [i].z () > far_)
+      ++beyond;
+  }
+
+  if (inside == 0 || beyond == 3)
+    return;
+
+  if (inside == 3)
+  {
+    addClippedTriangle (vertices [0], vertices [1], vertices [2], label);
+    return;
+  }
+
+  // clip at the near plane; this leaves a triangle or a quad
+  Vector3f polygon [4];
+  unsigned count = 0;
+  for (unsigned i = 0 ; i < 3 ; ++i)
+  {
+    const Vector3f& current = vertices [i];
+    const Vector3f& next = vertices [(i + 1) % 3];
+    const bool current_inside = current.z () >= near_;
+    if (current_inside)
+      polygon [count++] = current;
+    if (current_inside != (next.z () >= near_))
+    {
+      const float t = (near_ - current.z ()) / (next.z () - current.z ());
+      polygon [count] = current + t * (next - current);
+      polygon [count++].z () = near_;
+    }
+  }
+
+  addClippedTriangle (polygon [0], polygon [1], polygon [2], label);
+  if (count == 4)
+    addClippedTriangle (polygon [0], polygon [2], polygon [3], label);
+}
+
+void mesh_filter::SoftwareRenderer::addClippedTriangle (const Vector3f& a, const Vector3f& b, const Vector3f& c, uint32_t label)
+{
+  const Vector3f* corners [3] = {&a, &b, &c};
+  Triangle triangle;
+  const double depth_scale = double (far_) / (double (far_) - double (near_));
+  for (unsigned i = 0 ; i < 3 ; ++i)
+  {
+    // window coordinates as produced by GLRenderer: the y axis of the image points up in the window, so rows stay in order
+    const double z = corners [i]->z ();
+    triangle.x_ [i] = fx_ * corners [i]->x () / z + cx_;
+    triangle.y_ [i] = fy_ * corners [i]->y () / z + cy_;
+    triangle.depth_ [i] = depth_scale * (z - near_) / z;
+  }
+
+  // OpenGL considers counter clockwise triangles in window coordinates as front facing, and
+  // MeshFilterBase culls those. Due to the flipped y axis these are the faces pointing away from the camera.
+  const double area = (triangle.x_ [1] - triangle.x_ [0]) * (triangle.y_ [2] - triangle.y_ [0]) -
+                      (triangle.x_ [2] - triangle.x_ [0]) * (triangle.y_ [1] - triangle.y_ [0]);
+  if (!(area < 0))
+    return;
+
+  // make it counter clockwise for rasterization
+  std::swap (triangle.x_ [1], triangle.x_ [2]);
+  std::swap (triangle.y_ [1], triangle.y_ [2]);
+  std::swap (triangle.depth_ [1], triangle.depth_ [2]);
+
+  // pixels whose centers lie within the bounding box
+  const double min_x = std::max (0.0, ceil (std::min (triangle.x_ [0], std::min (triangle.x_ [1], triangle.x_ [2])) - 0.5));
+  const double max_x = std::min (double (width_) - 1.0, floor (std::max (triangle.x_ [0], std::max (triangle.x_ [1], triangle.x_ [2])) - 0.5));
+  const double min_y = std::max (0.0, ceil (std::min (triangle.y_ [0], std::min (triangle.y_ [1], triangle.y_ [2])) - 0.5));
+  const double max_y = std::min (double (height_) - 1.0, floor (std::max (triangle.y_ [0], std::max (triangle.y_ [1], triangle.y_ [2])) - 0.5));
+  if (min_x > max_x || min_y > max_y)
+    return;
+
+  triangle.min_x_ = int (min_x);
+  triangle.max_x_ = int (max_x);
+  triangle.min_y_ = int (min_y);
+  triangle.max_y_ = int (max_y);
+  triangle.label_ = label;
+  triangles_.push_back (triangle);
+}
+
+void mesh_filter::SoftwareRenderer::end ()
+{
+  for (std::size_t t = 0 ; t < tiles_.size () ; ++t)
+    tiles_ [t].clear ();
+
+  // bin the triangles in the order they were rendered, so the result of the depth test does not depend on the threads
+  for (std::size_t i = 0 ; i < triangles_.size () ; ++i)
+  {
+    const Triangle& triangle = triangles_ [i];
+    for (unsigned ty = triangle.min_y_ / TILE_SIZE ; ty <= triangle.max_y_ / TILE_SIZE ; ++ty)
+      for (unsigned tx = triangle.min_x_ / TILE_SIZE ; tx <= triangle.max_x_ / TILE_SIZE ; ++tx)
+        tiles_ [ty * tiles_x_ + tx].push_back (i);
+  }
+
+  const int tile_count = tiles_.size ();
+#pragma omp parallel for schedule(dynamic) num_threads(threads_)
+  for (int t = 0 ; t < tile_count ; ++t)
+  {
+    const vector<unsigned int>& tile = tiles_ [t];
+    if (tile.empty ())
+      continue;
+    const int tile_min_x = (t % tiles_x_) * TILE_SIZE;
+    const int tile_min_y = (t / tiles_x_) * TILE_SIZE;
+    const int tile_max_x = std::min (tile_min_x + int (TILE_SIZE), int (width_)) - 1;
+    const int tile_max_y = std::min (tile_min_y + int (TILE_SIZE), int (height_)) - 1;
+    for (std::size_t i = 0 ; i < tile.size () ; ++i)
+    {
+      const Triangle& triangle = triangles_ [tile [i]];
+      rasterize (triangle, std::max (tile_min_x, triangle.min_x_), std::min (tile_max_x, triangle.max_x_),
+                 std::max (tile_min_y, triangle.min_y_), std::min (tile_max_y, triangle.max_y_));
+    }
+  }
+}
+
+void mesh_filter::SoftwareRenderer::rasterize (const Triangle& triangle, int min_x, int max_x, int min_y, int max_y)
+{
+  // w[i] is the edge function of the edge opposite to vertex i, positive inside the triangle and equal to
+  // the area at vertex i. Pixel centers on an edge are only drawn for left and top edges, so pixels on an
+  // edge shared by two triangles are drawn once.
+  double dx [3], dy [3], ox [3], oy [3];
+  bool owns_edge [3];
+  for (unsigned i = 0 ; i < 3 ; ++i)
+  {
+    const unsigned j = (i + 1) % 3;
+    const unsigned k = (i + 2) % 3;
+    dx [i] = triangle.x_ [k] - triangle.x_ [j];
+    dy [i] = triangle.y_ [k] - triangle.y_ [j];
+    ox [i] = triangle.x_ [j];
+    oy [i] = triangle.y_ [j];
+    owns_edge [i] = dy [i] < 0 || (dy [i] == 0 && dx [i] < 0);
+  }
+  const double inv_area = 1.0 / (dx [2] * (triangle.y_ [2] - oy [2]) - dy [2] * (triangle.x_ [2] - ox [2]));
+
+  double w [3];
+  for (int y = min_y ; y <= max_y ; ++y)
+  {
+    const double py = y + 0.5;
+    float* depth = &depth_ [y * width_];
+    uint32_t* labels = &labels_ [y * width_];
+    for (int x = min_x ; x <= max_x ; ++x)
+    {
+      const double px = x + 0.5;
+      bool inside = true;
+      for (unsigned i = 0 ; i < 3 && inside ; ++i)
+      {
+        w [i] = dx [i] * (py - oy [i]) - dy [i] * (px - ox [i]);
+        inside = w [i] > 0 || (w [i] == 0 && owns_edge [i]);
+      }
+      if (!inside)
+        continue;
+
+      // window depth is linear in window coordinates
+      const float d = std::max (0.0, (w [0] * triangle.depth_ [0] + w [1] * triangle.depth_ [1] + w [2] * triangle.depth_ [2]) * inv_area);
+      if (d < depth [x])
+      {
+        depth [x] = d;
+        labels [x] = triangle.label_;
+      }
+    }
+  }
+}
+
+void mesh_filter::SoftwareRenderer::getColorBuffer (unsigned char* buffer) const
+{
+  memcpy (buffer, &labels_ [0], labels_.size () * sizeof (uint32_t));
+}
+
+void mesh_filter::SoftwareRenderer::getDepthBuffer (float* buffer) const
+{
+  memcpy (buffer, &depth_ [0], depth_.size () * sizeof (float));
+}
@@ -36,6 +36,7 @@
 
 #include <moveit/mesh_filter/stereo_camera_model.h>
 #include <moveit/mesh_filter/gl_renderer.h>
+#include <moveit/mesh_filter/software_renderer.h>
 
 using namespace std;
 
@@ -110,6 +111,62 @@ void mesh_filter::StereoCameraModel::Parameters::setFilterParameters (GLRenderer
   renderer.setCameraParameters (fx_, fy_, cx_, cy_);
 }
 
+void mesh_filter::StereoCameraModel::Parameters::setSoftwareRenderParameters (SoftwareRenderer& renderer) const
+{
+  renderer.setClippingRange (near_clipping_plane_distance_, far_clipping_plane_distance_);
+  renderer.setBufferSize (width_, height_);
+  renderer.setCameraParameters (fx_, fy_, cx_, cy_);
+}
+
+void mesh_filter::StereoCameraModel::Parameters::filterSoftware (const float* sensor_depth, const float* model_depth, const uint32_t* model_labels,
+                                                                 float shadow_threshold, float* filtered_depth, uint32_t* filtered_labels) const
+{
+  // same as filterFragmentShaderSource
+  const uint32_t shadow_label = 1;
+  const uint32_t near_label = 2;
+  const uint32_t far_label = 3;
+  const float near = near_clipping_plane_distance_;
+  const float far = far_clipping_plane_distance_;
+  const float f_n = far - near;
+  const float threshold = shadow_threshold / f_n;
+  const unsigned size = width_ * height_;
+  for (unsigned idx = 0; idx < size; ++idx)
+  {
+    const float s_value = sensor_depth [idx];
+    if (s_value <= 0)
+    {
+      filtered_labels [idx] = near_label;
+      filtered_depth [idx] = 0;
+    }
+    else
+    {
+      const float d_value = model_depth [idx];
+      const float z_value = d_value * near / (far - d_value * f_n);
+      const float diff = s_value - z_value;
+      if (diff < 0 && s_value < 1)
+      {
+        filtered_labels [idx] = 0;
+        filtered_depth [idx] = s_value;
+      }
+      else if (diff > threshold)
+      {
+        filtered_labels [idx] = shadow_label;
+        filtered_depth [idx] = s_value;
+      }
+      else if (s_value == 1)
+      {
+        filtered_labels [idx] = far_label;
+        filtered_depth [idx] = s_value;
+      }
+      else
+      {
+        filtered_labels [idx] = model_labels [idx];
+        filtered_depth [idx] = 0;
+      }
+    }
+  }
+}
+
 const mesh_filter::StereoCameraModel::Parameters& mesh_filter::StereoCameraModel::RegisteredPSDKParams =
       mesh_filter::StereoCameraModel::Parameters (640, 480, 0.4, 10.0, 525, 525, 319.5, 239.5, 0.075, 0.125);
 
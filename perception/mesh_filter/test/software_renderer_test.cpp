@@ -0,0 +1,402 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <moveit/mesh_filter/mesh_filter.h>
+#include <moveit/mesh_filter/stereo_camera_model.h>
+#include <geometric_shapes/shapes.h>
+#include <geometric_shapes/shape_operations.h>
+#include <boost/scoped_ptr.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+using namespace mesh_filter;
+
+namespace
+{
+
+const unsigned WIDTH = 160;
+const unsigned HEIGHT = 120;
+const float NEAR = 0.4;
+const float FAR = 5.0;
+const float FX = 150;
+const float FY = 150;
+const float CX = 79.5;
+const float CY = 59.5;
+
+/* A few boxes and a cylinder in front of the camera, some of them crossing the near clipping plane or the image border */
+class SoftwareRendererTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp ()
+  {
+    addShape (new shapes::Box (0.4, 0.3, 0.2), Eigen::Vector3d (0.0, 0.0, 2.0), Eigen::AngleAxisd (0.3, Eigen::Vector3d (1, 1, 0).normalized ()));
+    addShape (new shapes::Box (0.3, 0.3, 0.3), Eigen::Vector3d (0.25, 0.1, 1.7), Eigen::AngleAxisd (0.7, Eigen::Vector3d::UnitY ()));
+    addShape (new shapes::Cylinder (0.1, 0.8), Eigen::Vector3d (-0.35, -0.1, 2.4), Eigen::AngleAxisd (1.2, Eigen::Vector3d::UnitX ()));
+    addShape (new shapes::Box (1.0, 0.2, 1.0), Eigen::Vector3d (0.8, 0.5, 0.6), Eigen::AngleAxisd (0.2, Eigen::Vector3d::UnitZ ()));
+    addShape (new shapes::Box (0.5, 0.5, 0.5), Eigen::Vector3d (0.0, 0.3, 5.1), Eigen::AngleAxisd (0.0, Eigen::Vector3d::UnitZ ()));
+  }
+
+  virtual void TearDown ()
+  {
+    for (std::size_t i = 0 ; i < meshes_.size () ; ++i)
+      delete meshes_ [i];
+  }
+
+  void addShape (shapes::Shape *shape, const Eigen::Vector3d& position, const Eigen::AngleAxisd& orientation)
+  {
+    shapes::Mesh *mesh = shapes::createMeshFromShape (shape);
+    delete shape;
+    mesh->computeVertexNormals ();
+    meshes_.push_back (mesh);
+    poses_.push_back (Eigen::Translation3d (position) * orientation);
+  }
+
+  bool getTransform (MeshHandle handle, Eigen::Affine3d& transform) const
+  {
+    for (std::size_t i = 0 ; i < handles_.size () ; ++i)
+      if (handles_ [i] == handle)
+      {
+        transform = poses_ [i];
+        return true;
+      }
+    return false;
+  }
+
+  MeshFilter<StereoCameraModel>* createFilter (MeshFilterBase::RenderBackend backend)
+  {
+    StereoCameraModel::Parameters parameters (WIDTH, HEIGHT, NEAR, FAR, FX, FY, CX, CY, 0.075, 0.125);
+    MeshFilter<StereoCameraModel> *filter = new MeshFilter<StereoCameraModel> (boost::bind (&SoftwareRendererTest::getTransform, this, _1, _2),
+                                                                               parameters, backend);
+    filter->setPaddingScale (0.0);
+    filter->setPaddingOffset (0.0);
+    filter->setShadowThreshold (0.5);
+    handles_.clear ();
+    for (std::size_t i = 0 ; i < meshes_.size () ; ++i)
+      handles_.push_back (filter->addMesh (*meshes_ [i]));
+    return filter;
+  }
+
+  /* The golden depth map: the first intersection of the ray through each pixel center with a face pointing
+     towards the camera, as OpenGL renders it with the front faces (in window coordinates) culled */
+  void rayTrace (std::vector<float>& depth, std::vector<unsigned int>& labels) const
+  {
+    depth.assign (WIDTH * HEIGHT, 0);
+    labels.assign (WIDTH * HEIGHT, MeshFilterBase::Background);
+    for (unsigned v = 0, idx = 0 ; v < HEIGHT ; ++v)
+      for (unsigned u = 0 ; u < WIDTH ; ++u, ++idx)
+      {
+        const Eigen::Vector3d dir ((u + 0.5 - CX) / FX, (v + 0.5 - CY) / FY, 1.0);
+        double best = std::numeric_limits<double>::infinity ();
+        for (std::size_t m = 0 ; m < meshes_.size () ; ++m)
+          for (unsigned t = 0 ; t < meshes_ [m]->triangle_count ; ++t)
+          {
+            Eigen::Vector3d corners [3];
+            for (unsigned k = 0 ; k < 3 ; ++k)
+              corners [k] = poses_ [m] * Eigen::Map<const Eigen::Vector3d> (&meshes_ [m]->vertices [3 * meshes_ [m]->triangles [3 * t + k]]);
+            const Eigen::Vector3d e1 = corners [1] - corners [0];
+            const Eigen::Vector3d e2 = corners [2] - corners [0];
+            if (e1.cross (e2).dot (corners [0]) >= 0)
+              continue;
+            // Moeller-Trumbore
+            const Eigen::Vector3d p = dir.cross (e2);
+            const double det = e1.dot (p);
+            if (det == 0)
+              continue;
+            const Eigen::Vector3d s = -corners [0];
+            const double a = s.dot (p) / det;
+            if (a < 0 || a > 1)
+              continue;
+            const Eigen::Vector3d q = s.cross (e1);
+            const double b = dir.dot (q) / det;
+            if (b < 0 || a + b > 1)
+              continue;
+            const double z = e2.dot (q) / det;
+            if (z >= NEAR && z < FAR && z < best)
+            {
+              best = z;
+              depth [idx] = z;
+              labels [idx] = handles_ [m];
+            }
+          }
+      }
+  }
+
+  std::vector<shapes::Mesh*> meshes_;
+  std::vector<Eigen::Affine3d> poses_;
+  std::vector<MeshHandle> handles_;
+};
+
+}
+
+TEST_F (SoftwareRendererTest, GoldenModelDepth)
+{
+  boost::scoped_ptr<MeshFilter<StereoCameraModel> > filter (createFilter (MeshFilterBase::SoftwareBackend));
+  std::vector<float> sensor (WIDTH * HEIGHT, 4.0f);
+  filter->filter (&sensor [0], GL_FLOAT, true);
+
+  std::vector<float> depth (WIDTH * HEIGHT);
+  std::vector<unsigned int> labels (WIDTH * HEIGHT);
+  filter->getModelDepth (&depth [0]);
+  filter->getModelLabels (&labels [0]);
+
+  std::vector<float> golden_depth;
+  std::vector<unsigned int> golden_labels;
+  rayTrace (golden_depth, golden_labels);
+
+  unsigned covered = 0;
+  unsigned silhouette = 0;
+  for (unsigned idx = 0 ; idx < WIDTH * HEIGHT ; ++idx)
+  {
+    if (golden_labels [idx] != MeshFilterBase::Background)
+      ++covered;
+    if ((golden_labels [idx] == MeshFilterBase::Background) != (labels [idx] == MeshFilterBase::Background))
+    {
+      // pixel centers on the silhouette may be decided differently by the ray tracer
+      ++silhouette;
+      continue;
+    }
+    if (golden_labels [idx] == MeshFilterBase::Background)
+    {
+      EXPECT_EQ (0.0f, depth [idx]);
+      continue;
+    }
+    EXPECT_NEAR (golden_depth [idx], depth [idx], 1e-4) << "pixel " << idx % WIDTH << ", " << idx / WIDTH;
+    // where two meshes intersect, either label is right
+    if (golden_labels [idx] != labels [idx])
+      ++silhouette;
+  }
+  EXPECT_GT (covered, WIDTH * HEIGHT / 10);
+  EXPECT_LE (silhouette, covered / 100);
+}
+
+TEST_F (SoftwareRendererTest, FilteredLabels)
+{
+  boost::scoped_ptr<MeshFilter<StereoCameraModel> > filter (createFilter (MeshFilterBase::SoftwareBackend));
+  std::vector<float> golden_depth;
+  std::vector<unsigned int> golden_labels;
+  rayTrace (golden_depth, golden_labels);
+
+  // sensor readings on, in front of, behind and far behind the model, invalid and beyond the far clipping plane
+  const float offsets [5] = {0.01, -0.2, 1.0, -std::numeric_limits<float>::infinity (), std::numeric_limits<float>::infinity ()};
+  std::vector<float> sensor (WIDTH * HEIGHT);
+  std::vector<unsigned int> expected_labels (WIDTH * HEIGHT);
+  std::vector<float> expected_depth (WIDTH * HEIGHT);
+  std::vector<bool> ambiguous (WIDTH * HEIGHT, false);
+  for (unsigned idx = 0 ; idx < WIDTH * HEIGHT ; ++idx)
+  {
+    const float model = golden_depth [idx] > 0 ? golden_depth [idx] : FAR;
+    const float offset = offsets [idx % 5];
+    float reading;
+    if (offset == -std::numeric_limits<float>::infinity ())
+      reading = idx % 2 ? 0.0 : std::numeric_limits<float>::quiet_NaN ();
+    else if (offset == std::numeric_limits<float>::infinity ())
+      reading = FAR + 1.0;
+    else
+      reading = golden_depth [idx] > 0 ? model + offset : 2.0 + offset;
+    sensor [idx] = reading;
+
+    // same rules as in mesh_filter_test
+    const float clamped = std::min (reading, FAR);
+    if (!(reading > NEAR))
+    {
+      expected_labels [idx] = MeshFilterBase::NearClip;
+      expected_depth [idx] = 0;
+    }
+    else if (reading < model && reading < FAR)
+    {
+      expected_labels [idx] = MeshFilterBase::Background;
+      expected_depth [idx] = reading;
+    }
+    else if (clamped - model > 0.5)
+    {
+      expected_labels [idx] = MeshFilterBase::Shadow;
+      expected_depth [idx] = reading < FAR ? reading : 0;
+    }
+    else if (reading >= FAR)
+    {
+      expected_labels [idx] = MeshFilterBase::FarClip;
+      expected_depth [idx] = 0;
+    }
+    else
+    {
+      expected_labels [idx] = golden_labels [idx];
+      expected_depth [idx] = 0;
+    }
+    ambiguous [idx] = std::abs (clamped - model - 0.5) < 1e-3 || std::abs (reading - FAR) < 1e-3;
+  }
+
+  filter->filter (&sensor [0], GL_FLOAT, true);
+  std::vector<float> depth (WIDTH * HEIGHT);
+  std::vector<unsigned int> labels (WIDTH * HEIGHT);
+  std::vector<unsigned int> model_labels (WIDTH * HEIGHT);
+  filter->getFilteredDepth (&depth [0]);
+  filter->getFilteredLabels (&labels [0]);
+  filter->getModelLabels (&model_labels [0]);
+
+  for (unsigned idx = 0 ; idx < WIDTH * HEIGHT ; ++idx)
+  {
+    // skip the silhouette
+    if (golden_labels [idx] != model_labels [idx] || ambiguous [idx])
+      continue;
+    EXPECT_EQ (expected_labels [idx], labels [idx]) << "pixel " << idx % WIDTH << ", " << idx / WIDTH;
+    EXPECT_NEAR (expected_depth [idx], depth [idx], 1e-5);
+  }
+}
+
+TEST_F (SoftwareRendererTest, UnsignedShortReadings)
+{
+  boost::scoped_ptr<MeshFilter<StereoCameraModel> > filter (createFilter (MeshFilterBase::SoftwareBackend));
+  std::vector<float> golden_depth;
+  std::vector<unsigned int> golden_labels;
+  rayTrace (golden_depth, golden_labels);
+
+  // readings in millimeters; everything that is not in front of the model is within the shadow threshold of it
+  std::vector<unsigned short> sensor (WIDTH * HEIGHT);
+  for (unsigned idx = 0 ; idx < WIDTH * HEIGHT ; ++idx)
+    sensor [idx] = golden_depth [idx] > 0 ? (unsigned short) (golden_depth [idx] * 1000.0 + 20.5) : 3000;
+
+  filter->filter (&sensor [0], GL_UNSIGNED_SHORT, true);
+  std::vector<float> depth (WIDTH * HEIGHT);
+  std::vector<unsigned int> labels (WIDTH * HEIGHT);
+  std::vector<unsigned int> model_labels (WIDTH * HEIGHT);
+  filter->getFilteredDepth (&depth [0]);
+  filter->getFilteredLabels (&labels [0]);
+  filter->getModelLabels (&model_labels [0]);
+
+  for (unsigned idx = 0 ; idx < WIDTH * HEIGHT ; ++idx)
+  {
+    if (golden_labels [idx] != model_labels [idx] || golden_depth [idx] > FAR - 0.05)
+      continue;
+    EXPECT_EQ (golden_labels [idx], labels [idx]);
+    EXPECT_NEAR (golden_depth [idx] > 0 ? 0.0 : 3.0, depth [idx], 1e-5);
+  }
+}
+
+TEST_F (SoftwareRendererTest, ThreadCountDoesNotChangeResult)
+{
+  boost::scoped_ptr<MeshFilter<StereoCameraModel> > filter (createFilter (MeshFilterBase::SoftwareBackend));
+  std::vector<float> sensor (WIDTH * HEIGHT, 4.0f);
+  std::vector<float> depth1 (WIDTH * HEIGHT), depth4 (WIDTH * HEIGHT);
+  std::vector<unsigned int> labels1 (WIDTH * HEIGHT), labels4 (WIDTH * HEIGHT);
+
+  filter->setRenderThreadCount (1);
+  filter->filter (&sensor [0], GL_FLOAT, true);
+  filter->getModelDepth (&depth1 [0]);
+  filter->getModelLabels (&labels1 [0]);
+
+  filter->setRenderThreadCount (4);
+  filter->filter (&sensor [0], GL_FLOAT, true);
+  filter->getModelDepth (&depth4 [0]);
+  filter->getModelLabels (&labels4 [0]);
+
+  EXPECT_TRUE (depth1 == depth4);
+  EXPECT_TRUE (labels1 == labels4);
+}
+
+TEST (SoftwareRenderer, Padding)
+{
+  // a square facing the camera, moved towards the camera by the padding
+  shapes::Mesh mesh (4, 2);
+  const double vertices [12] = {-0.5, -0.5, 0, -0.5, 0.5, 0, 0.5, 0.5, 0, 0.5, -0.5, 0};
+  const unsigned int triangles [6] = {0, 1, 2, 0, 2, 3};
+  std::copy (vertices, vertices + 12, mesh.vertices);
+  std::copy (triangles, triangles + 6, mesh.triangles);
+  mesh.computeVertexNormals ();
+
+  SoftwareRenderer renderer (WIDTH, HEIGHT, NEAR, FAR);
+  renderer.setCameraParameters (FX, FY, CX, CY);
+  renderer.setPaddingCoefficients (Eigen::Vector3f (0, 0, 0.05));
+  renderer.begin ();
+  renderer.render (SoftwareMesh (mesh, MeshFilterBase::FirstLabel), Eigen::Affine3d (Eigen::Translation3d (0, 0, 2)));
+  renderer.end ();
+
+  const unsigned idx = HEIGHT / 2 * WIDTH + WIDTH / 2;
+  EXPECT_EQ ((uint32_t) MeshFilterBase::FirstLabel, renderer.getLabelData () [idx]);
+  const float d = renderer.getDepthData () [idx];
+  EXPECT_NEAR (1.95, NEAR * FAR / (FAR - d * (FAR - NEAR)), 1e-5);
+
+  // the vertices moved along the normals, so the square is as large as it would be at 1.95m
+  unsigned covered = 0;
+  for (unsigned u = 0 ; u < WIDTH ; ++u)
+    if (renderer.getLabelData () [HEIGHT / 2 * WIDTH + u] == MeshFilterBase::FirstLabel)
+      ++covered;
+  EXPECT_NEAR (1.0 / 1.95 * FX, covered, 1.0);
+}
+
+TEST_F (SoftwareRendererTest, EquivalentToOpenGL)
+{
+  const char *display = getenv ("DISPLAY");
+  if (!display || !*display)
+  {
+    std::cout << "No display, skipping the comparison with the OpenGL backend" << std::endl;
+    return;
+  }
+
+  std::vector<float> sensor (WIDTH * HEIGHT, 4.0f);
+  std::vector<float> gl_depth (WIDTH * HEIGHT), sw_depth (WIDTH * HEIGHT);
+  std::vector<unsigned int> gl_labels (WIDTH * HEIGHT), sw_labels (WIDTH * HEIGHT);
+  {
+    boost::scoped_ptr<MeshFilter<StereoCameraModel> > filter (createFilter (MeshFilterBase::OpenGLBackend));
+    filter->filter (&sensor [0], GL_FLOAT, true);
+    filter->getModelDepth (&gl_depth [0]);
+    filter->getFilteredLabels (&gl_labels [0]);
+  }
+  {
+    boost::scoped_ptr<MeshFilter<StereoCameraModel> > filter (createFilter (MeshFilterBase::SoftwareBackend));
+    filter->filter (&sensor [0], GL_FLOAT, true);
+    filter->getModelDepth (&sw_depth [0]);
+    filter->getFilteredLabels (&sw_labels [0]);
+  }
+
+  unsigned different = 0;
+  for (unsigned idx = 0 ; idx < WIDTH * HEIGHT ; ++idx)
+  {
+    if (gl_labels [idx] != sw_labels [idx])
+      ++different;
+    else if (gl_depth [idx] > 0)
+      EXPECT_NEAR (gl_depth [idx], sw_depth [idx], 1e-3);
+  }
+  EXPECT_LE (different, WIDTH * HEIGHT / 100);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -39,65 +39,141 @@
 
 #include <octomap/octomap.h>
 #include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
+#include <boost/cstdint.hpp>
 #include <memory>
+#include <vector>
+#include <set>
 
 namespace occupancy_map_monitor
 {
 
 typedef octomap::OcTreeNode OccMapNode;
 
+/** \brief An octree shared by the updaters of the occupancy map monitor and its readers.
+ *
+ *  Besides the lock on the whole tree, each of the eight top-level octants of the tree (shards) has its own lock, so updaters
+ *  that change different parts of the map with updateNodes() do not wait for each other. lockRead() locks all the shards,
+ *  so readers always see the merged tree, while lockWrite() is needed for anything that changes the tree as a whole. */
 class OccMapTree : public octomap::OcTree
 {
 public:
 
-  OccMapTree(double resolution) : octomap::OcTree(resolution)
+  /** \brief The number of independently locked parts of the tree */
+  static const unsigned int SHARD_COUNT = 8;
+
+  /** \brief The depth of the subtrees whose changes are recorded, so snapshots of the tree can be updated incrementally */
+  static const unsigned int SUBTREE_DEPTH = 10;
+
+  /** \brief A cell and the log-odds to add to its occupancy */
+  struct NodeUpdate
+  {
+    NodeUpdate()
+    {
+    }
+
+    NodeUpdate(const octomap::OcTreeKey &key, float log_odds_update) : key_(key), log_odds_update_(log_odds_update)
+    {
+    }
+
+    octomap::OcTreeKey key_;
+    float log_odds_update_;
+  };
+
+  OccMapTree(double resolution) : octomap::OcTree(resolution), root_changed_(false), snapshot_id_(0), record_changed_cells_(false)
   {
+    clearChanges(true);
+    clearChangedCells();
   }
 
-  OccMapTree(const std::string &filename) : octomap::OcTree(filename)
+  OccMapTree(const std::string &filename) : octomap::OcTree(filename), root_changed_(false), snapshot_id_(0), record_changed_cells_(false)
   {
+    clearChanges(true);
+    clearChangedCells();
   }
 
   /** @brief lock the underlying octree. it will not be read or written by the
    *  monitor until unlockTree() is called */
-  void lockRead()
-  {
-    tree_mutex_.lock_shared();
-  }
+  void lockRead();
 
   /** @brief unlock the underlying octree. */
-  void unlockRead()
-  {
-    tree_mutex_.unlock_shared();
-  }
+  void unlockRead();
 
   /** @brief lock the underlying octree. it will not be read or written by the
    *  monitor until unlockTree() is called */
-  void lockWrite()
-  {
-    tree_mutex_.lock();
-  }
+  void lockWrite();
 
   /** @brief unlock the underlying octree. */
-  void unlockWrite()
+  void unlockWrite();
+
+  /** @brief Count the whole tree as changed for the next snapshot and the next delta. Whoever changes the tree
+   *  other than through updateNodes() calls this while holding the write lock. */
+  void markAllChanged();
+
+  /** @brief A read lock on the tree, released when the last copy of it is destroyed */
+  class ReadLock
   {
-    tree_mutex_.unlock();
-  }
+  public:
+    ReadLock()
+    {
+    }
+
+    explicit ReadLock(OccMapTree &tree);
+
+  private:
+    boost::shared_ptr<OccMapTree> locked_;
+  };
+
+  /** @brief A write lock on the tree, released when the last copy of it is destroyed */
+  class WriteLock
+  {
+  public:
+    WriteLock()
+    {
+    }
+
+    explicit WriteLock(OccMapTree &tree);
 
-  typedef boost::shared_lock<boost::shared_mutex> ReadLock;
-  typedef boost::unique_lock<boost::shared_mutex> WriteLock;
+  private:
+    boost::shared_ptr<OccMapTree> locked_;
+  };
 
   ReadLock reading()
   {
-    return ReadLock(tree_mutex_);
+    return ReadLock(*this);
   }
 
   WriteLock writing()
   {
-    return WriteLock(tree_mutex_);
+    return WriteLock(*this);
+  }
+
+  /** @brief The shard (top-level octant) a cell is in */
+  unsigned int getShard(const octomap::OcTreeKey &key) const
+  {
+    return octomap::computeChildIdx(key, tree_depth - 1);
+  }
+
+  /** @brief An identifier of the subtree at SUBTREE_DEPTH a cell is in: the top bits of the three coordinates of its key */
+  boost::uint64_t getSubtreeId(const octomap::OcTreeKey &key) const
+  {
+    const unsigned int shift = tree_depth - SUBTREE_DEPTH;
+    return ((boost::uint64_t)(key[0] >> shift) << (2 * SUBTREE_DEPTH)) | ((boost::uint64_t)(key[1] >> shift) << SUBTREE_DEPTH) | (key[2] >> shift);
   }
 
+  /** @brief Apply \e updates as calls to updateNode() in the same order would. The updates are sorted by shard,
+   *  and each shard is locked only while its updates are applied, in whichever order the shards become available.
+   *  The tree must not be locked by the caller. */
+  void updateNodes(const std::vector<NodeUpdate> &updates);
+
+  /** @brief Add \e log_odds_update to the occupancy of each of the cells in \e keys, like updateNodes() */
+  void updateNodes(const std::vector<octomap::OcTreeKey> &keys, float log_odds_update);
+
+  /** @brief Mark each of the cells in \e keys as occupied or free, like updateNodes() */
+  void updateNodes(const std::vector<octomap::OcTreeKey> &keys, bool occupied);
+
   void triggerUpdateCallback(void)
   {
     if (update_callback_)
@@ -111,7 +187,79 @@ public:
   }
 
 private:
+
+  friend class OccMapSnapshot;
+  friend class OccMapDeltaEncoder;
+
+  /** @brief The most cells recorded per shard for the next delta; a keyframe is cheaper than a delta this large */
+  static const std::size_t MAX_CHANGED_CELLS = 1 << 17;
+
+  /** @brief The state of a cell as seen by readers of binary octomap messages */
+  enum CellState
+  {
+    CELL_UNKNOWN,
+    CELL_FREE,
+    CELL_OCCUPIED
+  };
+
+  /** @brief A cell updated by updateNodes() and its state before the update */
+  struct ChangedCell
+  {
+    ChangedCell()
+    {
+    }
+
+    ChangedCell(const octomap::OcTreeKey &key, unsigned char state) : key_(key), state_(state)
+    {
+    }
+
+    octomap::OcTreeKey key_;
+    unsigned char state_;
+  };
+
+  /** @brief Forget the changes recorded since the last snapshot; if \e all is set, count the whole tree as changed instead */
+  void clearChanges(bool all);
+
+  /** @brief Forget the cells recorded since the last delta */
+  void clearChangedCells();
+
+  /** @brief Get the node of a shard, creating it if needed; the shard must be locked */
+  OccMapNode* getShardNode(unsigned int shard, bool &created);
+
+  /** @brief Apply the updates of a shard; the shard must be locked */
+  void updateShard(unsigned int shard, std::vector<NodeUpdate>::const_iterator begin, std::vector<NodeUpdate>::const_iterator end);
+
+  /** @brief The recursion of OccupancyOcTreeBase::updateNodeRecurs() below the node of a shard, counting the nodes
+   *  created or deleted in \e size_change instead of changing the size of the tree */
+  void updateShardRecurs(OccMapNode *node, bool node_just_created, const octomap::OcTreeKey &key, unsigned int depth,
+                         float log_odds_update, long &size_change);
+
+  /** @brief Update the occupancy of the root from the shards, if they changed since the last time */
+  void updateRootOccupancy();
+
   boost::shared_mutex tree_mutex_;
+  boost::shared_mutex shard_mutex_[SHARD_COUNT];
+
+  /* protects the root node and the size of the tree while shards are updated concurrently */
+  boost::mutex root_mutex_;
+  bool root_changed_;
+
+  /* the changes since the last snapshot: the subtrees updated in each shard, the shards in which nodes above
+     SUBTREE_DEPTH were expanded or pruned, and whether the whole tree was marked as changed */
+  std::set<boost::uint64_t> changed_subtrees_[SHARD_COUNT];
+  bool shard_changed_[SHARD_COUNT];
+  bool all_changed_;
+
+  /* the identifier of the last snapshot written of this tree; zero if there is none */
+  boost::uint64_t snapshot_id_;
+
+  /* the cells updated in each shard since the last delta, if an encoder asked for them; whether a shard recorded too many
+     of them, and whether the whole tree was marked as changed since then */
+  bool record_changed_cells_;
+  std::vector<ChangedCell> changed_cells_[SHARD_COUNT];
+  bool changed_cells_overflow_[SHARD_COUNT];
+  bool all_cells_changed_;
+
   boost::function<void()> update_callback_;
 };
 
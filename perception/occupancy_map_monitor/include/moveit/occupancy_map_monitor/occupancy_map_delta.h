@@ -0,0 +1,145 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_OCCUPANCY_MAP_MONITOR_OCCUPANCY_MAP_DELTA_
+#define MOVEIT_OCCUPANCY_MAP_MONITOR_OCCUPANCY_MAP_DELTA_
+
+#include <moveit/occupancy_map_monitor/occupancy_map.h>
+#include <octomap_msgs/Octomap.h>
+#include <string>
+
+namespace occupancy_map_monitor
+{
+
+/** \brief Encodes an occupancy map for publishing as a stream of keyframes and deltas.
+ *
+ *  A keyframe is the whole tree, as octomap_msgs::binaryMapToMsg() makes it. A delta holds the cells whose state
+ *  (free or occupied, as a binary octomap message tells them apart) changed since the previous map was published, as
+ *  recorded by OccMapTree::updateNodes(); so its size follows the changes to the map, not the size of the map. Deltas have
+ *  DELTA_ID as the id of the message and name the sequence number of the map they apply to; the sequence number of each
+ *  map is in the header of the message. A keyframe is sent after a number of deltas, so receivers that missed a message
+ *  catch up, and whenever a delta would not be smaller than a keyframe or the tree was changed other than by
+ *  OccMapTree::updateNodes(). Only one encoder may be used per tree. */
+class OccMapDeltaEncoder
+{
+public:
+
+  /** \brief The id of octomap messages that hold deltas */
+  static const std::string DELTA_ID;
+
+  OccMapDeltaEncoder(unsigned int keyframe_interval = 20);
+
+  /** @brief Send a keyframe after every \e keyframe_interval deltas; 0 sends only keyframes */
+  void setKeyframeInterval(unsigned int keyframe_interval)
+  {
+    keyframe_interval_ = keyframe_interval;
+  }
+
+  unsigned int getKeyframeInterval() const
+  {
+    return keyframe_interval_;
+  }
+
+  /** @brief Make the next map a keyframe */
+  void forceKeyframe()
+  {
+    keyframe_due_ = true;
+  }
+
+  /** @brief Fill \e msg with the next map of \e tree to publish. Returns true if it is a keyframe.
+   *  The caller must hold a read lock on the tree. */
+  bool encode(OccMapTree &tree, octomap_msgs::Octomap &msg);
+
+  /** @brief \e msg holds the whole of \e tree, as from octomap_msgs::binaryMapToMsg(); replace it by a delta if one is due,
+   *  otherwise keep it as the next keyframe. Returns true if \e msg now holds a delta. The caller must hold a read lock on
+   *  the tree. */
+  bool encodeDelta(OccMapTree &tree, octomap_msgs::Octomap &msg);
+
+private:
+
+  bool isDeltaDue(const OccMapTree &tree) const;
+
+  /** @brief Write the delta into \e msg, unless it would not be smaller than a keyframe */
+  bool writeDelta(OccMapTree &tree, octomap_msgs::Octomap &msg);
+
+  /** @brief Number \e msg as a keyframe and start recording the changes from it */
+  void startKeyframe(OccMapTree &tree, octomap_msgs::Octomap &msg);
+
+  unsigned int keyframe_interval_;
+  unsigned int delta_count_;
+  bool keyframe_due_;
+  boost::uint32_t seq_;
+
+  /* the changed cells by their Morton code and their state before the change, and the encoded delta; kept between maps to
+     avoid reallocating them */
+  std::vector<std::pair<boost::uint64_t, unsigned char> > cells_;
+  std::vector<boost::int8_t> data_;
+};
+
+/** \brief Rebuilds an occupancy map from the keyframes and deltas made by OccMapDeltaEncoder. Octomap messages of other
+ *  publishers are taken as keyframes. */
+class OccMapDeltaDecoder
+{
+public:
+
+  OccMapDeltaDecoder();
+
+  /** @brief Check whether \e msg holds a delta */
+  static bool isDelta(const octomap_msgs::Octomap &msg);
+
+  /** @brief Apply \e msg to the map. A keyframe replaces the tree by a new one. A delta changes the tree in place only if
+   *  the decoder holds the sole reference to it; otherwise the delta is applied to a copy of the tree, which replaces
+   *  it, so trees handed out by getOcTree() never change. Returns false if \e msg is invalid, or is a delta that does
+   *  not follow the last map decoded; deltas are then ignored until the next keyframe. */
+  bool decode(const octomap_msgs::Octomap &msg);
+
+  /** @brief The tree decoded so far; empty until a keyframe is decoded */
+  const std::shared_ptr<octomap::OcTree>& getOcTree() const
+  {
+    return tree_;
+  }
+
+  /** @brief Forget the tree */
+  void reset();
+
+private:
+
+  std::shared_ptr<octomap::OcTree> tree_;
+  boost::uint32_t seq_;
+  std::vector<std::pair<octomap::OcTreeKey, bool> > cells_;
+};
+
+}
+
+#endif
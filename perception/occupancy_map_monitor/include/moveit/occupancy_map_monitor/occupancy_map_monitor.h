@@ -117,6 +117,9 @@ public:
 
   void setTransformCacheCallback(const TransformCacheProvider &transform_cache_callback);
 
+  /** @brief Same as setTransformCacheCallback(), for a provider that fills the array used by the updaters directly */
+  void setTransformArrayCallback(const TransformArrayProvider &transform_array_callback);
+
   void publishDebugInformation(bool flag);
 
   bool isActive() const
@@ -128,13 +131,13 @@ private:
 
   void initialize();
 
-  /** @brief Save the current octree to a binary file */
+  /** @brief Save the current octree to a binary file, or to a snapshot if the file has the snapshot extension */
   bool saveMapCallback(moveit_msgs::SaveMap::Request& request, moveit_msgs::SaveMap::Response& response);
 
-  /** @brief Load octree from a binary file (gets rid of current octree data) */
+  /** @brief Load octree from a binary file or a snapshot (gets rid of current octree data) */
   bool loadMapCallback(moveit_msgs::LoadMap::Request& request, moveit_msgs::LoadMap::Response& response);
 
-  bool getShapeTransformCache(std::size_t index, const std::string &target_frame, const ros::Time &target_time, ShapeTransformCache &cache) const;
+  bool getShapeTransformArray(std::size_t index, const std::string &target_frame, const ros::Time &target_time, ShapeTransformArray &transforms) const;
 
   boost::shared_ptr<tf::Transformer> tf_;
   std::string map_frame_;
@@ -146,8 +149,9 @@ private:
 
   boost::scoped_ptr<pluginlib::ClassLoader<OccupancyMapUpdater> > updater_plugin_loader_;
   std::vector<OccupancyMapUpdaterPtr> map_updaters_;
-  std::vector<std::map<ShapeHandle, ShapeHandle> > mesh_handles_;
-  TransformCacheProvider transform_cache_callback_;
+  std::vector<std::vector<ShapeHandle> > mesh_handles_; // for each updater, the updater handle of every handle we return (0 if none)
+  mutable boost::mutex mesh_handles_lock_;
+  TransformArrayProvider transform_cache_callback_;
   bool debug_info_;
 
   std::size_t mesh_handle_count_;
@@ -157,6 +161,10 @@ private:
   ros::ServiceServer save_map_srv_;
   ros::ServiceServer load_map_srv_;
 
+  /* serializes saving and loading snapshots, and remembers the file of the last snapshot, which saving again updates */
+  boost::mutex snapshot_lock_;
+  std::string snapshot_filename_;
+
   bool active_;
 
 };
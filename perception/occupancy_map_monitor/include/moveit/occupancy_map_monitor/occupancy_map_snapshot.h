@@ -0,0 +1,125 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_OCCUPANCY_MAP_MONITOR_OCCUPANCY_MAP_SNAPSHOT_
+#define MOVEIT_OCCUPANCY_MAP_MONITOR_OCCUPANCY_MAP_SNAPSHOT_
+
+#include <moveit/occupancy_map_monitor/occupancy_map.h>
+#include <boost/interprocess/mapped_region.hpp>
+#include <string>
+
+namespace occupancy_map_monitor
+{
+
+/** \brief A snapshot of an occupancy map on disk, loaded by memory-mapping the file.
+ *
+ *  A snapshot holds the pruned tree with the exact log-odds of its leaves. The tree below OccMapTree::SUBTREE_DEPTH is
+ *  stored as one block per subtree, in Morton order: the shape of the subtree, a bit per child of each inner node, and the
+ *  log-odds of its leaves, usually as a byte each, indexing a table of the distinct values. An index gives the offset of
+ *  each subtree in the file, so single subtrees can be materialized on demand. The leaves above that depth are kept apart.
+ *  When a snapshot is written again to the same file, only the subtrees changed since then are appended, followed by
+ *  a new index; the file is rewritten from scratch once the blocks no longer referenced outgrow the ones still in use.
+ *  Each snapshot written gets a random identifier, which the tree remembers, so changes are only appended to a file
+ *  that still holds the last snapshot of the same tree.
+ *  The values are stored in the byte order of the host. */
+class OccMapSnapshot
+{
+public:
+
+  static const unsigned int FORMAT_VERSION = 2;
+
+  /** \brief The extension of the files the monitor saves as snapshots */
+  static const std::string FILE_EXTENSION;
+
+  OccMapSnapshot();
+  ~OccMapSnapshot();
+
+  /** @brief Check whether \e filename has the extension of snapshot files */
+  static bool hasSnapshotExtension(const std::string &filename);
+
+  /** @brief Check whether \e filename is a snapshot, by its header */
+  static bool isSnapshot(const std::string &filename);
+
+  /** @brief Write a snapshot of \e tree to \e filename. If \e incremental is set and the file holds the last snapshot
+   *  written of this tree, only the subtrees changed since then are added to it; any other file is rewritten. The caller must hold a read lock on
+   *  the tree, and only one snapshot of a tree may be written at a time. */
+  static bool write(OccMapTree &tree, const std::string &filename, bool incremental = false);
+
+  /** @brief Map the snapshot in \e filename to memory; nothing is read until the tree is materialized */
+  bool open(const std::string &filename);
+
+  void close();
+
+  bool isOpen() const
+  {
+    return data_ != NULL;
+  }
+
+  double getResolution() const;
+
+  /** @brief The number of leaves in the snapshot */
+  std::size_t getLeafCount() const;
+
+  /** @brief The number of subtrees at OccMapTree::SUBTREE_DEPTH in the snapshot */
+  std::size_t getSubtreeCount() const;
+
+  /** @brief The number of leaves of subtree \e index */
+  std::size_t getSubtreeLeafCount(std::size_t index) const;
+
+  /** @brief Add the leaves above OccMapTree::SUBTREE_DEPTH to \e tree. They go first, into an empty tree.
+   *  The caller must hold a write lock on the tree. */
+  bool materializeCoarseLeaves(OccMapTree &tree) const;
+
+  /** @brief Add subtree \e index to \e tree, unless the tree already has nodes in its place.
+   *  The caller must hold a write lock on the tree. */
+  bool materializeSubtree(OccMapTree &tree, std::size_t index) const;
+
+  /** @brief Add the subtrees overlapping the box from \e min to \e max that \e tree does not have yet; returns their number.
+   *  The caller must hold a write lock on the tree. */
+  std::size_t materializeRegion(OccMapTree &tree, const octomap::point3d &min, const octomap::point3d &max) const;
+
+  /** @brief Clear \e tree and fill it with the whole snapshot. The resolution of the tree is set to the one of the
+   *  snapshot. The caller must hold a write lock on the tree. */
+  bool materialize(OccMapTree &tree) const;
+
+private:
+
+  std::string filename_;
+  boost::interprocess::mapped_region region_;
+  const char *data_;
+};
+
+}
+
+#endif
@@ -42,6 +42,10 @@
 #include <boost/shared_ptr.hpp>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <eigen_stl_containers/eigen_stl_vector_container.h>
+#include <algorithm>
+#include <map>
+#include <vector>
 
 namespace occupancy_map_monitor
 {
@@ -49,7 +53,98 @@ namespace occupancy_map_monitor
 typedef unsigned int ShapeHandle;
 typedef std::map<ShapeHandle, Eigen::Affine3d, std::less<ShapeHandle>,
                  Eigen::aligned_allocator<std::pair<const ShapeHandle, Eigen::Affine3d> > > ShapeTransformCache;
+
+/** \brief The transforms of the shapes excluded from the octomap, stored in a flat array indexed by shape handle.
+ *  This is what the updaters use in place of a ShapeTransformCache: handles are small consecutive integers, so lookups
+ *  are a bounds check and an index, and clearing the array keeps its storage, so refilling it for every sensor message
+ *  does not allocate. */
+class ShapeTransformArray
+{
+public:
+
+  ShapeTransformArray() : count_(0)
+  {
+  }
+
+  /** \brief Forget all transforms (the storage is kept) */
+  void clear()
+  {
+    std::fill(valid_.begin(), valid_.end(), 0);
+    count_ = 0;
+  }
+
+  /** \brief Make room for handles up to (excluding) \e end */
+  void reserve(std::size_t end)
+  {
+    if (end > valid_.size())
+    {
+      transforms_.resize(end, Eigen::Affine3d::Identity());
+      valid_.resize(end, 0);
+    }
+  }
+
+  /** \brief Set the transform of shape \e h */
+  void set(ShapeHandle h, const Eigen::Affine3d &transform)
+  {
+    reserve(h + 1);
+    transforms_[h] = transform;
+    if (!valid_[h])
+    {
+      valid_[h] = 1;
+      ++count_;
+    }
+  }
+
+  /** \brief Get the transform of shape \e h; returns NULL if the transform of \e h is not known */
+  const Eigen::Affine3d* get(ShapeHandle h) const
+  {
+    return h < valid_.size() && valid_[h] ? &transforms_[h] : NULL;
+  }
+
+  /** \brief All handles for which a transform can be known are smaller than this value */
+  std::size_t getHandleEnd() const
+  {
+    return valid_.size();
+  }
+
+  /** \brief The number of shapes with a known transform */
+  std::size_t size() const
+  {
+    return count_;
+  }
+
+  bool empty() const
+  {
+    return count_ == 0;
+  }
+
+  /** \brief Add the known transforms to \e cache */
+  void copyTo(ShapeTransformCache &cache) const
+  {
+    for (std::size_t h = 0 ; h < valid_.size() ; ++h)
+      if (valid_[h])
+        cache[h] = transforms_[h];
+  }
+
+  /** \brief Set the transforms of \e cache, in addition to the ones already known */
+  void copyFrom(const ShapeTransformCache &cache)
+  {
+    for (ShapeTransformCache::const_iterator it = cache.begin() ; it != cache.end() ; ++it)
+      set(it->first, it->second);
+  }
+
+private:
+
+  EigenSTL::vector_Affine3d transforms_;
+  std::vector<char> valid_;
+  std::size_t count_;
+};
+
 typedef boost::function<bool(const std::string &target_frame, const ros::Time &target_time, ShapeTransformCache &cache)> TransformCacheProvider;
+typedef boost::function<bool(const std::string &target_frame, const ros::Time &target_time, ShapeTransformArray &transforms)> TransformArrayProvider;
+
+/** \brief A provider of ShapeTransformArray that calls \e provider and copies the ShapeTransformCache it fills; empty if \e provider is */
+TransformArrayProvider makeTransformArrayProvider(const TransformCacheProvider &provider);
 
 class OccupancyMapMonitor;
 
@@ -85,6 +180,12 @@ public:
   }
 
   void setTransformCacheCallback(const TransformCacheProvider &transform_callback)
+  {
+    transform_provider_callback_ = makeTransformArrayProvider(transform_callback);
+  }
+
+  /** \brief Same as setTransformCacheCallback(), for a provider that fills the array used by the updater directly */
+  void setTransformArrayCallback(const TransformArrayProvider &transform_callback)
   {
     transform_provider_callback_ = transform_callback;
   }
@@ -99,8 +200,8 @@ protected:
   OccupancyMapMonitor *monitor_;
   std::string type_;
   OccMapTreePtr tree_;
-  TransformCacheProvider transform_provider_callback_;
-  ShapeTransformCache transform_cache_;
+  TransformArrayProvider transform_provider_callback_;
+  ShapeTransformArray transform_cache_;
   bool debug_info_;
 
   bool updateTransformCache(const std::string &target_frame, const ros::Time &target_time);
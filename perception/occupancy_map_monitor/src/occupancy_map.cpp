@@ -0,0 +1,312 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2011, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/occupancy_map_monitor/occupancy_map.h>
+#include <boost/mem_fn.hpp>
+
+namespace occupancy_map_monitor
+{
+
+void OccMapTree::lockRead()
+{
+  tree_mutex_.lock_shared();
+  for (unsigned int i = 0 ; i < SHARD_COUNT ; ++i)
+    shard_mutex_[i].lock_shared();
+
+  // readers see the merged tree, so the root needs to reflect the changes made to the shards
+  boost::mutex::scoped_lock _(root_mutex_);
+  updateRootOccupancy();
+}
+
+void OccMapTree::unlockRead()
+{
+  for (unsigned int i = SHARD_COUNT ; i > 0 ; --i)
+    shard_mutex_[i - 1].unlock_shared();
+  tree_mutex_.unlock_shared();
+}
+
+void OccMapTree::lockWrite()
+{
+  tree_mutex_.lock();
+  updateRootOccupancy();
+}
+
+void OccMapTree::unlockWrite()
+{
+  tree_mutex_.unlock();
+}
+
+void OccMapTree::markAllChanged()
+{
+  all_changed_ = true;
+  all_cells_changed_ = true;
+}
+
+void OccMapTree::clearChanges(bool all)
+{
+  for (unsigned int i = 0 ; i < SHARD_COUNT ; ++i)
+  {
+    changed_subtrees_[i].clear();
+    shard_changed_[i] = false;
+  }
+  all_changed_ = all;
+}
+
+void OccMapTree::clearChangedCells()
+{
+  for (unsigned int i = 0 ; i < SHARD_COUNT ; ++i)
+  {
+    changed_cells_[i].clear();
+    changed_cells_overflow_[i] = false;
+  }
+  all_cells_changed_ = false;
+}
+
+OccMapTree::ReadLock::ReadLock(OccMapTree &tree)
+{
+  tree.lockRead();
+  locked_.reset(&tree, boost::mem_fn(&OccMapTree::unlockRead));
+}
+
+OccMapTree::WriteLock::WriteLock(OccMapTree &tree)
+{
+  tree.lockWrite();
+  locked_.reset(&tree, boost::mem_fn(&OccMapTree::unlockWrite));
+}
+
+void OccMapTree::updateNodes(const std::vector<octomap::OcTreeKey> &keys, float log_odds_update)
+{
+  std::vector<NodeUpdate> updates;
+  updates.reserve(keys.size());
+  for (std::size_t i = 0 ; i < keys.size() ; ++i)
+    updates.push_back(NodeUpdate(keys[i], log_odds_update));
+  updateNodes(updates);
+}
+
+void OccMapTree::updateNodes(const std::vector<octomap::OcTreeKey> &keys, bool occupied)
+{
+  updateNodes(keys, occupied ? getProbHitLog() : getProbMissLog());
+}
+
+void OccMapTree::updateNodes(const std::vector<NodeUpdate> &updates)
+{
+  if (updates.empty())
+    return;
+
+  // sort the updates by shard; the sort is stable, so the updates of each cell keep their order
+  std::size_t offset[SHARD_COUNT + 1] = { 0 };
+  for (std::size_t i = 0 ; i < updates.size() ; ++i)
+    offset[getShard(updates[i].key_) + 1]++;
+  for (unsigned int i = 0 ; i < SHARD_COUNT ; ++i)
+    offset[i + 1] += offset[i];
+  std::vector<NodeUpdate> sorted(updates.size());
+  std::size_t next[SHARD_COUNT];
+  std::copy(offset, offset + SHARD_COUNT, next);
+  for (std::size_t i = 0 ; i < updates.size() ; ++i)
+    sorted[next[getShard(updates[i].key_)]++] = updates[i];
+
+  boost::shared_lock<boost::shared_mutex> tree_lock(tree_mutex_);
+
+  bool pending[SHARD_COUNT];
+  unsigned int pending_count = 0;
+  for (unsigned int i = 0 ; i < SHARD_COUNT ; ++i)
+  {
+    pending[i] = offset[i] < offset[i + 1];
+    if (pending[i])
+      pending_count++;
+  }
+
+  // update the shards that are not in use by other threads first, and only wait when all the remaining ones are busy
+  while (pending_count > 0)
+  {
+    unsigned int shard = SHARD_COUNT;
+    for (unsigned int i = 0 ; i < SHARD_COUNT && shard == SHARD_COUNT ; ++i)
+      if (pending[i] && shard_mutex_[i].try_lock())
+        shard = i;
+    if (shard == SHARD_COUNT)
+    {
+      for (unsigned int i = 0 ; i < SHARD_COUNT && shard == SHARD_COUNT ; ++i)
+        if (pending[i])
+          shard = i;
+      shard_mutex_[shard].lock();
+    }
+
+    try
+    {
+      updateShard(shard, sorted.begin() + offset[shard], sorted.begin() + offset[shard + 1]);
+    }
+    catch (...)
+    {
+      shard_mutex_[shard].unlock();
+      throw;
+    }
+    shard_mutex_[shard].unlock();
+    pending[shard] = false;
+    pending_count--;
+  }
+}
+
+OccMapNode* OccMapTree::getShardNode(unsigned int shard, bool &created)
+{
+  boost::mutex::scoped_lock _(root_mutex_);
+  created = false;
+  if (root == NULL)
+  {
+    root = new OccMapNode();
+    tree_size++;
+    size_changed = true;
+  }
+  if (!root->childExists(shard))
+  {
+    // like updateNode(), a root without children is not expanded
+    root->createChild(shard);
+    tree_size++;
+    size_changed = true;
+    created = true;
+  }
+  return root->getChild(shard);
+}
+
+void OccMapTree::updateShard(unsigned int shard, std::vector<NodeUpdate>::const_iterator begin, std::vector<NodeUpdate>::const_iterator end)
+{
+  const float clamping_thres_max = getClampingThresMaxLog();
+  const float clamping_thres_min = getClampingThresMinLog();
+  long size_change = 0;
+  std::set<boost::uint64_t> &changed_subtrees = changed_subtrees_[shard];
+  std::vector<ChangedCell> &changed_cells = changed_cells_[shard];
+  boost::uint64_t last_subtree = ~(boost::uint64_t)0;
+
+  // updates of the shard do not change the root, so the node of the shard stays valid
+  bool created;
+  OccMapNode *shard_node = getShardNode(shard, created);
+  for (std::vector<NodeUpdate>::const_iterator it = begin ; it != end ; ++it)
+  {
+    // like updateNode(), skip the update if the cell is already at the clamping threshold
+    OccMapNode *leaf = NULL;
+    if (!created)
+    {
+      leaf = shard_node;
+      for (unsigned int depth = 1 ; depth < tree_depth ; ++depth)
+      {
+        const unsigned int pos = octomap::computeChildIdx(it->key_, tree_depth - 1 - depth);
+        if (!leaf->childExists(pos))
+        {
+          // a pruned node holds the occupancy of the cell; otherwise the cell is not in the tree yet
+          if (leaf->hasChildren())
+            leaf = NULL;
+          break;
+        }
+        leaf = leaf->getChild(pos);
+      }
+      if (leaf && ((it->log_odds_update_ >= 0 && leaf->getLogOdds() >= clamping_thres_max) ||
+                   (it->log_odds_update_ <= 0 && leaf->getLogOdds() <= clamping_thres_min)))
+        continue;
+    }
+
+    if (record_changed_cells_ && !changed_cells_overflow_[shard])
+    {
+      if (changed_cells.size() < MAX_CHANGED_CELLS)
+        changed_cells.push_back(ChangedCell(it->key_, leaf == NULL ? CELL_UNKNOWN : isNodeOccupied(leaf) ? CELL_OCCUPIED : CELL_FREE));
+      else
+        changed_cells_overflow_[shard] = true;
+    }
+    updateShardRecurs(shard_node, created, it->key_, 1, it->log_odds_update_, size_change);
+    created = false;
+
+    // consecutive updates are mostly in the same subtree
+    const boost::uint64_t subtree = getSubtreeId(it->key_);
+    if (subtree != last_subtree)
+    {
+      changed_subtrees.insert(subtree);
+      last_subtree = subtree;
+    }
+  }
+
+  boost::mutex::scoped_lock _(root_mutex_);
+  tree_size += size_change;
+  size_changed = true;
+  root_changed_ = true;
+}
+
+void OccMapTree::updateShardRecurs(OccMapNode *node, bool node_just_created, const octomap::OcTreeKey &key, unsigned int depth,
+                                   float log_odds_update, long &size_change)
+{
+  if (depth < tree_depth)
+  {
+    bool created_node = false;
+    const unsigned int pos = octomap::computeChildIdx(key, tree_depth - 1 - depth);
+    if (!node->childExists(pos))
+    {
+      // the child does not exist, but maybe the node was pruned
+      if (!node->hasChildren() && !node_just_created)
+      {
+        node->expandNode();
+        size_change += 8;
+        if (depth < SUBTREE_DEPTH)
+          shard_changed_[getShard(key)] = true;
+      }
+      else
+      {
+        node->createChild(pos);
+        size_change++;
+        created_node = true;
+      }
+    }
+    updateShardRecurs(node->getChild(pos), created_node, key, depth + 1, log_odds_update, size_change);
+
+    // prune the node if possible, otherwise set its own occupancy
+    if (node->pruneNode())
+    {
+      size_change -= 8;
+      if (depth < SUBTREE_DEPTH)
+        shard_changed_[getShard(key)] = true;
+    }
+    else
+      node->updateOccupancyChildren();
+  }
+  else
+    updateNodeLogOdds(node, log_odds_update);
+}
+
+void OccMapTree::updateRootOccupancy()
+{
+  if (root_changed_)
+  {
+    if (root && root->hasChildren())
+      root->updateOccupancyChildren();
+    root_changed_ = false;
+  }
+}
+
+}
@@ -0,0 +1,290 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/occupancy_map_monitor/occupancy_map_delta.h>
+#include <octomap_msgs/conversions.h>
+#include <ros/console.h>
+#include <algorithm>
+
+namespace occupancy_map_monitor
+{
+
+const std::string OccMapDeltaEncoder::DELTA_ID = "OcTreeDelta";
+
+namespace
+{
+
+/* a delta is the sequence number of the map it applies to and the number of cells, as 32 bit little endian integers,
+   followed by the cells in Morton order: the difference between the Morton code of a cell and the one of the previous cell,
+   shifted left by one bit and holding whether the cell is occupied in the lowest bit, as a base-128 varint */
+const std::size_t DELTA_HEADER_SIZE = 8;
+
+boost::uint64_t spreadBits(boost::uint64_t x)
+{
+  x = (x | (x << 32)) & 0x001f00000000ffffULL;
+  x = (x | (x << 16)) & 0x001f0000ff0000ffULL;
+  x = (x | (x << 8)) & 0x100f00f00f00f00fULL;
+  x = (x | (x << 4)) & 0x10c30c30c30c30c3ULL;
+  x = (x | (x << 2)) & 0x1249249249249249ULL;
+  return x;
+}
+
+boost::uint64_t compactBits(boost::uint64_t x)
+{
+  x &= 0x1249249249249249ULL;
+  x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3ULL;
+  x = (x ^ (x >> 4)) & 0x100f00f00f00f00fULL;
+  x = (x ^ (x >> 8)) & 0x001f0000ff0000ffULL;
+  x = (x ^ (x >> 16)) & 0x001f00000000ffffULL;
+  x = (x ^ (x >> 32)) & 0x00000000001fffffULL;
+  return x;
+}
+
+boost::uint64_t mortonCode(const octomap::OcTreeKey &key)
+{
+  return spreadBits(key[0]) | (spreadBits(key[1]) << 1) | (spreadBits(key[2]) << 2);
+}
+
+octomap::OcTreeKey mortonKey(boost::uint64_t code)
+{
+  return octomap::OcTreeKey(compactBits(code), compactBits(code >> 1), compactBits(code >> 2));
+}
+
+bool compareCodes(const std::pair<boost::uint64_t, unsigned char> &a, const std::pair<boost::uint64_t, unsigned char> &b)
+{
+  return a.first < b.first;
+}
+
+void putUint32(boost::uint32_t value, std::vector<boost::int8_t> &data)
+{
+  for (unsigned int i = 0 ; i < 4 ; ++i)
+    data.push_back((boost::int8_t)(value >> (8 * i)));
+}
+
+boost::uint32_t getUint32(const std::vector<boost::int8_t> &data, std::size_t offset)
+{
+  boost::uint32_t value = 0;
+  for (unsigned int i = 0 ; i < 4 ; ++i)
+    value |= (boost::uint32_t)(boost::uint8_t)data[offset + i] << (8 * i);
+  return value;
+}
+
+void putVarint(boost::uint64_t value, std::vector<boost::int8_t> &data)
+{
+  while (value >= 0x80)
+  {
+    data.push_back((boost::int8_t)(value | 0x80));
+    value >>= 7;
+  }
+  data.push_back((boost::int8_t)value);
+}
+
+bool getVarint(const std::vector<boost::int8_t> &data, std::size_t &offset, boost::uint64_t &value)
+{
+  value = 0;
+  for (unsigned int shift = 0 ; shift < 64 && offset < data.size() ; shift += 7)
+  {
+    const boost::uint8_t byte = data[offset++];
+    value |= (boost::uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+}
+
+OccMapDeltaEncoder::OccMapDeltaEncoder(unsigned int keyframe_interval) :
+  keyframe_interval_(keyframe_interval), delta_count_(0), keyframe_due_(true), seq_(0)
+{
+}
+
+bool OccMapDeltaEncoder::encode(OccMapTree &tree, octomap_msgs::Octomap &msg)
+{
+  if (isDeltaDue(tree) && writeDelta(tree, msg))
+    return false;
+  msg.data.clear();
+  if (!octomap_msgs::binaryMapToMsg(tree, msg))
+    ROS_ERROR("Could not generate OctoMap message");
+  startKeyframe(tree, msg);
+  return true;
+}
+
+bool OccMapDeltaEncoder::encodeDelta(OccMapTree &tree, octomap_msgs::Octomap &msg)
+{
+  if (isDeltaDue(tree) && writeDelta(tree, msg))
+    return true;
+  startKeyframe(tree, msg);
+  return false;
+}
+
+bool OccMapDeltaEncoder::isDeltaDue(const OccMapTree &tree) const
+{
+  if (keyframe_due_ || delta_count_ >= keyframe_interval_ || !tree.record_changed_cells_ || tree.all_cells_changed_)
+    return false;
+  for (unsigned int i = 0 ; i < OccMapTree::SHARD_COUNT ; ++i)
+    if (tree.changed_cells_overflow_[i])
+      return false;
+  return true;
+}
+
+bool OccMapDeltaEncoder::writeDelta(OccMapTree &tree, octomap_msgs::Octomap &msg)
+{
+  // the first record of a cell holds its state when the previous map was published
+  cells_.clear();
+  for (unsigned int i = 0 ; i < OccMapTree::SHARD_COUNT ; ++i)
+    for (std::size_t j = 0 ; j < tree.changed_cells_[i].size() ; ++j)
+      cells_.push_back(std::make_pair(mortonCode(tree.changed_cells_[i][j].key_), tree.changed_cells_[i][j].state_));
+  std::stable_sort(cells_.begin(), cells_.end(), compareCodes);
+
+  // a binary keyframe takes two bits for each child of an inner node
+  const std::size_t keyframe_size = tree.size() / 4;
+
+  data_.clear();
+  putUint32(seq_, data_);
+  putUint32(0, data_);
+  boost::uint32_t count = 0;
+  boost::uint64_t previous = 0;
+  for (std::size_t i = 0 ; i < cells_.size() ; ++i)
+  {
+    if (i > 0 && cells_[i].first == cells_[i - 1].first)
+      continue;
+    const OccMapNode *node = tree.search(mortonKey(cells_[i].first));
+    if (node == NULL)
+      continue;
+    const unsigned char state = tree.isNodeOccupied(node) ? OccMapTree::CELL_OCCUPIED : OccMapTree::CELL_FREE;
+    if (state == cells_[i].second)
+      continue;
+    putVarint(((cells_[i].first - previous) << 1) | (state == OccMapTree::CELL_OCCUPIED ? 1 : 0), data_);
+    previous = cells_[i].first;
+    count++;
+    if (data_.size() >= keyframe_size)
+      return false;
+  }
+  for (unsigned int i = 0 ; i < 4 ; ++i)
+    data_[4 + i] = (boost::int8_t)(count >> (8 * i));
+
+  msg.binary = true;
+  msg.id = DELTA_ID;
+  msg.resolution = tree.getResolution();
+  msg.data.assign(data_.begin(), data_.end());
+  msg.header.seq = ++seq_;
+  delta_count_++;
+  tree.clearChangedCells();
+  return true;
+}
+
+void OccMapDeltaEncoder::startKeyframe(OccMapTree &tree, octomap_msgs::Octomap &msg)
+{
+  msg.header.seq = ++seq_;
+  delta_count_ = 0;
+  keyframe_due_ = false;
+  // nothing updates the tree while the caller holds a read lock on it
+  tree.clearChangedCells();
+  tree.record_changed_cells_ = keyframe_interval_ > 0;
+}
+
+OccMapDeltaDecoder::OccMapDeltaDecoder() : seq_(0)
+{
+}
+
+bool OccMapDeltaDecoder::isDelta(const octomap_msgs::Octomap &msg)
+{
+  return msg.id == OccMapDeltaEncoder::DELTA_ID;
+}
+
+void OccMapDeltaDecoder::reset()
+{
+  tree_.reset();
+  seq_ = 0;
+}
+
+bool OccMapDeltaDecoder::decode(const octomap_msgs::Octomap &msg)
+{
+  if (!isDelta(msg))
+  {
+    octomap::AbstractOcTree *tree = octomap_msgs::msgToMap(msg);
+    octomap::OcTree *octree = dynamic_cast<octomap::OcTree*>(tree);
+    if (!octree)
+    {
+      delete tree;
+      ROS_ERROR("Unable to decode octomap of type '%s'", msg.id.c_str());
+      reset();
+      return false;
+    }
+    tree_.reset(octree);
+    seq_ = msg.header.seq;
+    return true;
+  }
+
+  if (!tree_ || msg.data.size() < DELTA_HEADER_SIZE || getUint32(msg.data, 0) != seq_ ||
+      msg.resolution != tree_->getResolution())
+  {
+    ROS_DEBUG("Ignoring octomap delta %u until the next keyframe", msg.header.seq);
+    return false;
+  }
+
+  // check the whole delta before changing the tree
+  const boost::uint32_t count = getUint32(msg.data, 4);
+  cells_.clear();
+  std::size_t offset = DELTA_HEADER_SIZE;
+  boost::uint64_t code = 0;
+  for (boost::uint32_t i = 0 ; i < count ; ++i)
+  {
+    boost::uint64_t value;
+    if (!getVarint(msg.data, offset, value))
+      break;
+    code += value >> 1;
+    cells_.push_back(std::make_pair(mortonKey(code), (value & 1) != 0));
+  }
+  if (cells_.size() != count || offset != msg.data.size())
+  {
+    ROS_ERROR("Octomap delta %u is corrupt", msg.header.seq);
+    return false;
+  }
+
+  // the tree may be shared, e.g. by planning scenes and their copies; those must keep seeing the map they were given
+  if (tree_.use_count() > 1)
+    tree_.reset(new octomap::OcTree(*tree_));
+
+  // set the cells the way reading a binary octomap does
+  const float occupied = tree_->getClampingThresMaxLog();
+  const float free = tree_->getClampingThresMinLog();
+  for (std::size_t i = 0 ; i < cells_.size() ; ++i)
+    tree_->setNodeValue(cells_[i].first, cells_[i].second ? occupied : free);
+  seq_ = msg.header.seq;
+  return true;
+}
+
+}
@@ -39,6 +39,7 @@
 #include <moveit_msgs/LoadMap.h>
 #include <moveit/occupancy_map_monitor/occupancy_map.h>
 #include <moveit/occupancy_map_monitor/occupancy_map_monitor.h>
+#include <moveit/occupancy_map_monitor/occupancy_map_snapshot.h>
 #include <XmlRpcException.h>
 
 namespace occupancy_map_monitor
@@ -190,14 +191,14 @@ void OccupancyMapMonitor::addUpdater(const OccupancyMapUpdaterPtr &updater)
       mesh_handles_.resize(map_updaters_.size());
       if (map_updaters_.size() == 2) // when we had one updater only, we passed direcly the transform cache callback to that updater
       {
-        map_updaters_[0]->setTransformCacheCallback(boost::bind(&OccupancyMapMonitor::getShapeTransformCache, this, 0, _1, _2, _3));
-        map_updaters_[1]->setTransformCacheCallback(boost::bind(&OccupancyMapMonitor::getShapeTransformCache, this, 1, _1, _2, _3));
+        map_updaters_[0]->setTransformArrayCallback(boost::bind(&OccupancyMapMonitor::getShapeTransformArray, this, 0, _1, _2, _3));
+        map_updaters_[1]->setTransformArrayCallback(boost::bind(&OccupancyMapMonitor::getShapeTransformArray, this, 1, _1, _2, _3));
       }
       else
-        map_updaters_.back()->setTransformCacheCallback(boost::bind(&OccupancyMapMonitor::getShapeTransformCache, this, map_updaters_.size() - 1, _1, _2, _3));
+        map_updaters_.back()->setTransformArrayCallback(boost::bind(&OccupancyMapMonitor::getShapeTransformArray, this, map_updaters_.size() - 1, _1, _2, _3));
     }
     else
-      updater->setTransformCacheCallback(transform_cache_callback_);
+      updater->setTransformArrayCallback(transform_cache_callback_);
   }
   else
     ROS_ERROR("NULL updater was specified");
@@ -222,6 +223,7 @@ ShapeHandle OccupancyMapMonitor::excludeShape(const shapes::ShapeConstPtr &shape
   if (map_updaters_.size() == 1)
     return map_updaters_[0]->excludeShape(shape);
 
+  boost::mutex::scoped_lock _(mesh_handles_lock_);
   ShapeHandle h = 0;
   for (std::size_t i = 0 ; i < map_updaters_.size() ; ++i)
   {
@@ -230,6 +232,8 @@ ShapeHandle OccupancyMapMonitor::excludeShape(const shapes::ShapeConstPtr &shape
     {
       if (h == 0)
         h = ++mesh_handle_count_;
+      if (mesh_handles_[i].size() <= h)
+        mesh_handles_[i].resize(h + 1, 0);
       mesh_handles_[i][h] = mh;
     }
   }
@@ -245,41 +249,51 @@ void OccupancyMapMonitor::forgetShape(ShapeHandle handle)
     return;
   }
 
+  boost::mutex::scoped_lock _(mesh_handles_lock_);
   for (std::size_t i = 0 ; i < map_updaters_.size() ; ++i)
   {
-    std::map<ShapeHandle, ShapeHandle>::const_iterator it = mesh_handles_[i].find(handle);
-    if (it == mesh_handles_[i].end())
+    if (handle >= mesh_handles_[i].size() || mesh_handles_[i][handle] == 0)
       continue;
-    map_updaters_[i]->forgetShape(it->second);
+    map_updaters_[i]->forgetShape(mesh_handles_[i][handle]);
+    mesh_handles_[i][handle] = 0;
   }
 }
 
 void OccupancyMapMonitor::setTransformCacheCallback(const TransformCacheProvider& transform_callback)
+{
+  setTransformArrayCallback(makeTransformArrayProvider(transform_callback));
+}
+
+void OccupancyMapMonitor::setTransformArrayCallback(const TransformArrayProvider& transform_callback)
 {
   // if we have just one updater, we connect it directly to the transform provider
   if (map_updaters_.size() == 1)
-    map_updaters_[0]->setTransformCacheCallback(transform_callback);
+    map_updaters_[0]->setTransformArrayCallback(transform_callback);
   else
     transform_cache_callback_ = transform_callback;
 }
 
-bool OccupancyMapMonitor::getShapeTransformCache(std::size_t index, const std::string &target_frame, const ros::Time &target_time, ShapeTransformCache &cache) const
+bool OccupancyMapMonitor::getShapeTransformArray(std::size_t index, const std::string &target_frame, const ros::Time &target_time, ShapeTransformArray &cache) const
 {
   if (transform_cache_callback_)
   {
-    ShapeTransformCache tempCache;
+    ShapeTransformArray tempCache;
     if (transform_cache_callback_(target_frame, target_time, tempCache))
     {
-      for (ShapeTransformCache::iterator it = tempCache.begin() ; it != tempCache.end() ; ++it)
+      boost::mutex::scoped_lock _(mesh_handles_lock_);
+      const std::vector<ShapeHandle> &handles = mesh_handles_[index];
+      for (std::size_t h = 0 ; h < tempCache.getHandleEnd() ; ++h)
       {
-        std::map<ShapeHandle, ShapeHandle>::const_iterator jt = mesh_handles_[index].find(it->first);
-        if (jt == mesh_handles_[index].end())
+        const Eigen::Affine3d *t = tempCache.get(h);
+        if (!t)
+          continue;
+        if (h >= handles.size() || handles[h] == 0)
         {
           ROS_ERROR_THROTTLE(1, "Incorrect mapping of mesh handles");
           return false;
         }
         else
-          cache[jt->second] = it->second;
+          cache.set(handles[h], *t);
       }
       return true;
     }
@@ -293,10 +307,19 @@ bool OccupancyMapMonitor::getShapeTransformCache(std::size_t index, const std::s
 bool OccupancyMapMonitor::saveMapCallback(moveit_msgs::SaveMap::Request& request, moveit_msgs::SaveMap::Response& response)
 {
   ROS_INFO("Writing map to %s", request.filename.c_str());
+  const bool snapshot = OccMapSnapshot::hasSnapshotExtension(request.filename);
+  boost::mutex::scoped_lock _(snapshot_lock_);
   tree_->lockRead();
   try
   {
-    response.success = tree_->writeBinary(request.filename);
+    if (snapshot)
+    {
+      // saving to the file of the last snapshot only adds the parts of the map that changed since
+      response.success = OccMapSnapshot::write(*tree_, request.filename, request.filename == snapshot_filename_);
+      snapshot_filename_ = response.success ? request.filename : std::string();
+    }
+    else
+      response.success = tree_->writeBinary(request.filename);
   }
   catch (...)
   {
@@ -310,11 +333,25 @@ bool OccupancyMapMonitor::loadMapCallback(moveit_msgs::LoadMap::Request& request
 {
   ROS_INFO("Reading map from %s", request.filename.c_str());
 
+  /* snapshots are mapped to memory before the tree is locked, so only building the tree happens under the lock */
+  OccMapSnapshot snapshot;
+  if (OccMapSnapshot::isSnapshot(request.filename) && !snapshot.open(request.filename))
+  {
+    response.success = false;
+    return true;
+  }
+
   /* load the octree from disk */
+  boost::mutex::scoped_lock _(snapshot_lock_);
+  snapshot_filename_.clear();
   tree_->lockWrite();
   try
   {
-    response.success = tree_->readBinary(request.filename);
+    if (snapshot.isOpen())
+      response.success = snapshot.materialize(*tree_);
+    else
+      response.success = tree_->readBinary(request.filename);
+    tree_->markAllChanged();
   }
   catch (...)
   {
@@ -0,0 +1,826 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2011, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include <moveit/occupancy_map_monitor/occupancy_map_snapshot.h>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/filesystem.hpp>
+#include <ros/console.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <unistd.h>
+
+namespace occupancy_map_monitor
+{
+
+namespace
+{
+
+/* the file starts with the header; the blocks of the subtrees, the coarse block and the index follow in any order */
+struct FileHeader
+{
+  char magic_[8];
+  boost::uint32_t version_;
+  boost::uint32_t tree_depth_;
+  boost::uint32_t subtree_depth_;
+  boost::uint32_t reserved_;
+  double resolution_;
+
+  /* a random identifier of the snapshot, which the tree it was written from remembers */
+  boost::uint64_t snapshot_id_;
+
+  /* the leaves above the subtree depth: the code of each leaf, followed by their log-odds. The code of a leaf holds the
+     child indices on the path from the root to it, 3 bits per level, followed by its depth. */
+  boost::uint64_t coarse_offset_;
+  boost::uint64_t coarse_count_;
+
+  /* the index of the subtrees, in Morton order */
+  boost::uint64_t index_offset_;
+  boost::uint64_t subtree_count_;
+
+  boost::uint64_t leaf_count_;
+
+  /* where the blocks of the next incremental snapshot go, and how many bytes before that are not referenced anymore */
+  boost::uint64_t end_offset_;
+  boost::uint64_t garbage_;
+};
+
+/* a subtree, by the child indices on the path from the root to it, and its block */
+struct IndexEntry
+{
+  boost::uint64_t code_;
+  boost::uint64_t offset_;
+  boost::uint64_t size_;
+  boost::uint64_t leaf_count_;
+};
+
+/* the block of a subtree starts with this header, followed by the table of the distinct log-odds of its leaves, the log-odds
+   of the leaves if there is no table, a 16 bit mask for each inner node, and the index in the table of the log-odds of each
+   leaf if there is a table. The inner nodes are in depth-first order; the low byte of the mask of a node tells which children
+   exist and the high byte which of them are inner nodes, so the leaves follow in the same order, which is Morton order. */
+struct BlockHeader
+{
+  boost::uint32_t leaf_count_;
+  boost::uint32_t inner_count_;
+  boost::uint32_t value_count_;
+  boost::uint32_t reserved_;
+};
+
+const char FILE_MAGIC[8] = { 'O', 'C', 'C', 'M', 'A', 'P', 'S', 'N' };
+const unsigned int DEPTH_BITS = 5;
+const boost::uint64_t DEPTH_MASK = (1 << DEPTH_BITS) - 1;
+const unsigned int MAX_TREE_DEPTH = 16;
+const std::size_t MAX_TABLE_SIZE = 256;
+
+boost::uint64_t padded(boost::uint64_t size)
+{
+  return (size + 7) & ~(boost::uint64_t)7;
+}
+
+boost::uint64_t coarseBlockSize(boost::uint64_t count)
+{
+  return count * sizeof(boost::uint64_t) + padded(count * sizeof(float));
+}
+
+// the size of a block of a subtree, not counting the padding
+boost::uint64_t blockSize(const BlockHeader &header)
+{
+  return sizeof(BlockHeader) + header.value_count_ * sizeof(float) + (header.value_count_ > 0 ? 0 : header.leaf_count_ * sizeof(float)) +
+    header.inner_count_ * sizeof(boost::uint16_t) + (header.value_count_ > 0 ? header.leaf_count_ : 0);
+}
+
+unsigned int childIndex(boost::uint64_t path, unsigned int depth, unsigned int tree_depth)
+{
+  return (path >> (3 * (tree_depth - 1 - depth))) & 7;
+}
+
+// the identifier OccMapTree::getSubtreeId() gives the cells of the subtree with path \e code
+boost::uint64_t getSubtreeId(boost::uint64_t code)
+{
+  const unsigned int depth = OccMapTree::SUBTREE_DEPTH;
+  boost::uint64_t x = 0, y = 0, z = 0;
+  for (unsigned int d = 0 ; d < depth ; ++d)
+  {
+    const unsigned int pos = childIndex(code, d, depth);
+    x = (x << 1) | (pos & 1);
+    y = (y << 1) | ((pos >> 1) & 1);
+    z = (z << 1) | (pos >> 2);
+  }
+  return (x << (2 * depth)) | (y << depth) | z;
+}
+
+bool compareCodes(const IndexEntry &a, const IndexEntry &b)
+{
+  return a.code_ < b.code_;
+}
+
+const FileHeader& getHeader(const char *data)
+{
+  return *reinterpret_cast<const FileHeader*>(data);
+}
+
+const IndexEntry* getIndex(const char *data)
+{
+  return reinterpret_cast<const IndexEntry*>(data + getHeader(data).index_offset_);
+}
+
+// the leaves above the subtree depth and the nodes at it, in Morton order
+void collectTop(const OccMapNode *node, boost::uint64_t path, unsigned int depth, unsigned int tree_depth,
+                std::vector<boost::uint64_t> &codes, std::vector<float> &values,
+                std::vector<std::pair<boost::uint64_t, const OccMapNode*> > &subtrees)
+{
+  if (depth == OccMapTree::SUBTREE_DEPTH)
+    subtrees.push_back(std::make_pair(path >> (3 * (tree_depth - depth)), node));
+  else if (!node->hasChildren())
+  {
+    codes.push_back((path << DEPTH_BITS) | depth);
+    values.push_back(node->getLogOdds());
+  }
+  else
+    for (unsigned int i = 0 ; i < 8 ; ++i)
+      if (node->childExists(i))
+        collectTop(node->getChild(i), path | ((boost::uint64_t)i << (3 * (tree_depth - 1 - depth))), depth + 1, tree_depth, codes, values, subtrees);
+}
+
+void encodeStructure(const OccMapNode *node, std::vector<boost::uint16_t> &masks, std::vector<boost::uint32_t> &values)
+{
+  const std::size_t index = masks.size();
+  masks.push_back(0);
+  boost::uint16_t mask = 0;
+  for (unsigned int i = 0 ; i < 8 ; ++i)
+    if (node->childExists(i))
+    {
+      const OccMapNode *child = node->getChild(i);
+      mask |= 1 << i;
+      if (child->hasChildren())
+      {
+        mask |= 1 << (i + 8);
+        encodeStructure(child, masks, values);
+      }
+      else
+      {
+        // the bits of the log-odds, so they are restored exactly
+        const float value = child->getLogOdds();
+        boost::uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        values.push_back(bits);
+      }
+    }
+  masks[index] = mask;
+}
+
+template<typename T>
+void appendData(std::vector<char> &block, const T *data, std::size_t count)
+{
+  block.insert(block.end(), reinterpret_cast<const char*>(data), reinterpret_cast<const char*>(data + count));
+}
+
+// the distinct \e values in the order they first appear, and the index of each value in them; false if there are too many
+bool makeTable(const std::vector<boost::uint32_t> &values, std::vector<boost::uint32_t> &table, std::vector<boost::uint8_t> &indices)
+{
+  // a hash table with open addressing, at most a quarter full
+  static const unsigned int SLOT_BITS = 10;
+  boost::int16_t slots[1 << SLOT_BITS];
+  boost::uint32_t keys[1 << SLOT_BITS];
+  std::fill(slots, slots + (1 << SLOT_BITS), -1);
+  table.clear();
+  indices.resize(values.size());
+  for (std::size_t i = 0 ; i < values.size() ; ++i)
+  {
+    unsigned int slot = (values[i] * 2654435761u) >> (32 - SLOT_BITS);
+    while (slots[slot] >= 0 && keys[slot] != values[i])
+      slot = (slot + 1) & ((1 << SLOT_BITS) - 1);
+    if (slots[slot] < 0)
+    {
+      if (table.size() == MAX_TABLE_SIZE)
+        return false;
+      slots[slot] = table.size();
+      keys[slot] = values[i];
+      table.push_back(values[i]);
+    }
+    indices[i] = slots[slot];
+  }
+  return true;
+}
+
+// the block of the subtree below \e node; the vectors are only kept to avoid reallocating them
+void encodeSubtree(const OccMapNode *node, std::vector<boost::uint16_t> &masks, std::vector<boost::uint32_t> &values,
+                   std::vector<boost::uint32_t> &table, std::vector<boost::uint8_t> &indices, std::vector<char> &block)
+{
+  masks.clear();
+  values.clear();
+  if (node->hasChildren())
+    encodeStructure(node, masks, values);
+  else
+  {
+    const float value = node->getLogOdds();
+    boost::uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    values.push_back(bits);
+  }
+
+  // the leaves of a map mostly have a few distinct log-odds, so they are usually stored as a byte each
+  if (!makeTable(values, table, indices))
+    table.clear();
+
+  BlockHeader header;
+  header.leaf_count_ = values.size();
+  header.inner_count_ = masks.size();
+  header.value_count_ = table.size();
+  header.reserved_ = 0;
+  block.clear();
+  appendData(block, &header, 1);
+  if (table.empty())
+    appendData(block, &values[0], values.size());
+  else
+    appendData(block, &table[0], table.size());
+  if (!masks.empty())
+    appendData(block, &masks[0], masks.size());
+  if (!table.empty())
+    appendData(block, &indices[0], indices.size());
+  block.resize(padded(block.size()), 0);
+}
+
+// check the structure below the inner node with mask \e index at \e depth, counting its leaves
+bool checkStructure(const boost::uint16_t *masks, boost::uint64_t count, boost::uint64_t &index, unsigned int depth,
+                    unsigned int tree_depth, boost::uint64_t &leaves)
+{
+  if (index >= count || depth >= tree_depth)
+    return false;
+  const unsigned int children = masks[index] & 0xff;
+  const unsigned int inner = masks[index] >> 8;
+  index++;
+  if (children == 0 || (inner & ~children) != 0)
+    return false;
+  for (unsigned int i = 0 ; i < 8 ; ++i)
+    if (inner & (1 << i))
+    {
+      if (!checkStructure(masks, count, index, depth + 1, tree_depth, leaves))
+        return false;
+    }
+    else if (children & (1 << i))
+      leaves++;
+  return true;
+}
+
+// the nodes below \e node, which has no children yet, from a checked block; the occupancy of the inner nodes is set on the way back
+void decodeStructure(OccMapNode *node, const boost::uint16_t *masks, std::size_t &index, const float *values, const boost::uint8_t *indices,
+                     std::size_t &leaf, std::size_t &created)
+{
+  const unsigned int children = masks[index] & 0xff;
+  const unsigned int inner = masks[index] >> 8;
+  index++;
+  for (unsigned int i = 0 ; i < 8 ; ++i)
+    if (children & (1 << i))
+    {
+      node->createChild(i);
+      created++;
+      OccMapNode *child = node->getChild(i);
+      if (inner & (1 << i))
+        decodeStructure(child, masks, index, values, indices, leaf, created);
+      else
+      {
+        child->setLogOdds(indices ? values[indices[leaf]] : values[leaf]);
+        leaf++;
+      }
+    }
+  node->updateOccupancyChildren();
+}
+
+// the parts of the block of a subtree, if it is well formed
+bool parseBlock(const char *data, const IndexEntry &entry, unsigned int tree_depth, const float *&values,
+                const boost::uint16_t *&masks, const boost::uint8_t *&indices)
+{
+  if (entry.size_ < sizeof(BlockHeader))
+    return false;
+  const BlockHeader &header = *reinterpret_cast<const BlockHeader*>(data + entry.offset_);
+  if (header.leaf_count_ != entry.leaf_count_ || header.leaf_count_ == 0 || header.value_count_ > MAX_TABLE_SIZE || blockSize(header) > entry.size_)
+    return false;
+  const char *next = data + entry.offset_ + sizeof(BlockHeader);
+  values = reinterpret_cast<const float*>(next);
+  next += (header.value_count_ > 0 ? header.value_count_ : header.leaf_count_) * sizeof(float);
+  masks = reinterpret_cast<const boost::uint16_t*>(next);
+  next += header.inner_count_ * sizeof(boost::uint16_t);
+  indices = header.value_count_ > 0 ? reinterpret_cast<const boost::uint8_t*>(next) : NULL;
+
+  if (header.inner_count_ == 0)
+    return header.leaf_count_ == 1 && (!indices || indices[0] < header.value_count_);
+  boost::uint64_t index = 0, leaves = 0;
+  if (!checkStructure(masks, header.inner_count_, index, OccMapTree::SUBTREE_DEPTH, tree_depth, leaves) ||
+      index != header.inner_count_ || leaves != header.leaf_count_)
+    return false;
+  if (indices)
+    for (boost::uint32_t i = 0 ; i < header.leaf_count_ ; ++i)
+      if (indices[i] >= header.value_count_)
+        return false;
+  return true;
+}
+
+// check that the coarse leaves are above the subtree depth and in Morton order, without overlapping
+bool checkCoarseLeaves(const char *data)
+{
+  const FileHeader &header = getHeader(data);
+  const boost::uint64_t *codes = reinterpret_cast<const boost::uint64_t*>(data + header.coarse_offset_);
+  boost::uint64_t next = 0;
+  for (boost::uint64_t i = 0 ; i < header.coarse_count_ ; ++i)
+  {
+    const unsigned int depth = codes[i] & DEPTH_MASK;
+    const boost::uint64_t path = codes[i] >> DEPTH_BITS;
+    const boost::uint64_t span = (boost::uint64_t)1 << (3 * (header.tree_depth_ - depth));
+    if (depth >= OccMapTree::SUBTREE_DEPTH || path < next || path % span != 0)
+      return false;
+    next = path + span;
+  }
+  return true;
+}
+
+// check the header of a file of \e size bytes
+bool checkHeader(const FileHeader &header, std::size_t size)
+{
+  if (!std::equal(header.magic_, header.magic_ + sizeof(FILE_MAGIC), FILE_MAGIC) || header.version_ != OccMapSnapshot::FORMAT_VERSION ||
+      header.subtree_depth_ != OccMapTree::SUBTREE_DEPTH || header.tree_depth_ <= header.subtree_depth_ || header.tree_depth_ > MAX_TREE_DEPTH)
+    return false;
+  if (header.end_offset_ > size || header.garbage_ > header.end_offset_)
+    return false;
+  if (header.coarse_offset_ % 8 != 0 || header.coarse_offset_ < sizeof(FileHeader) || header.coarse_count_ > size ||
+      header.coarse_offset_ + coarseBlockSize(header.coarse_count_) > header.end_offset_)
+    return false;
+  if (header.index_offset_ % 8 != 0 || header.index_offset_ < sizeof(FileHeader) || header.subtree_count_ > size / sizeof(IndexEntry) ||
+      header.index_offset_ + header.subtree_count_ * sizeof(IndexEntry) > header.end_offset_)
+    return false;
+  return true;
+}
+
+// read the header and the index of the last snapshot written of \e tree, if \e filename still holds it
+bool readIndex(const std::string &filename, const OccMapTree &tree, boost::uint64_t snapshot_id, FileHeader &header,
+               std::vector<IndexEntry> &index)
+{
+  std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+  in.seekg(0, std::ios::end);
+  const std::streamoff size = in.tellg();
+  in.seekg(0, std::ios::beg);
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!in.good() || !checkHeader(header, size) || header.tree_depth_ != tree.getTreeDepth() || header.resolution_ != tree.getResolution())
+    return false;
+  // the file holds a snapshot of another map, or one written since by someone else
+  if (header.snapshot_id_ != snapshot_id)
+  {
+    ROS_DEBUG("'%s' does not hold the last snapshot of the occupancy map; it is rewritten", filename.c_str());
+    return false;
+  }
+  index.resize(header.subtree_count_);
+  in.seekg(header.index_offset_);
+  if (!index.empty())
+    in.read(reinterpret_cast<char*>(&index[0]), index.size() * sizeof(IndexEntry));
+  return in.good();
+}
+
+// recompute the occupancy of the inner nodes below \e node, down to \e max_depth
+void updateInnerOccupancy(OccMapNode *node, unsigned int depth, unsigned int max_depth)
+{
+  if (depth >= max_depth || !node->hasChildren())
+    return;
+  for (unsigned int i = 0 ; i < 8 ; ++i)
+    if (node->childExists(i))
+      updateInnerOccupancy(node->getChild(i), depth + 1, max_depth);
+  node->updateOccupancyChildren();
+}
+
+// a new identifier for a snapshot; zero is left for trees no snapshot was written of
+boost::uint64_t makeSnapshotId()
+{
+  std::random_device random;
+  boost::uint64_t id = 0;
+  while (id == 0)
+    id = ((boost::uint64_t)random() << 32) ^ random();
+  return id;
+}
+
+// write \e block at the current position of \e out, which is \e offset
+void writeBlock(std::ostream &out, const std::vector<char> &block, boost::uint64_t &offset)
+{
+  if (!block.empty())
+    out.write(&block[0], block.size());
+  offset += block.size();
+}
+
+}
+
+const std::string OccMapSnapshot::FILE_EXTENSION = ".snapshot";
+
+bool OccMapSnapshot::hasSnapshotExtension(const std::string &filename)
+{
+  return boost::filesystem::path(filename).extension() == FILE_EXTENSION;
+}
+
+bool OccMapSnapshot::isSnapshot(const std::string &filename)
+{
+  std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+  char magic[sizeof(FILE_MAGIC)];
+  in.read(magic, sizeof(magic));
+  return in.good() && std::equal(magic, magic + sizeof(magic), FILE_MAGIC);
+}
+
+OccMapSnapshot::OccMapSnapshot() : data_(NULL)
+{
+}
+
+OccMapSnapshot::~OccMapSnapshot()
+{
+  close();
+}
+
+void OccMapSnapshot::close()
+{
+  boost::interprocess::mapped_region().swap(region_);
+  data_ = NULL;
+  filename_.clear();
+}
+
+bool OccMapSnapshot::open(const std::string &filename)
+{
+  close();
+  try
+  {
+    boost::interprocess::file_mapping mapping(filename.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region(mapping, boost::interprocess::read_only).swap(region_);
+  }
+  catch (boost::interprocess::interprocess_exception &ex)
+  {
+    ROS_ERROR("Unable to map occupancy map snapshot '%s': %s", filename.c_str(), ex.what());
+    return false;
+  }
+
+  // the blocks are only checked when they are materialized, so pages of the file are not read before they are needed
+  const char *data = static_cast<const char*>(region_.get_address());
+  const std::size_t size = region_.get_size();
+  bool valid = size >= sizeof(FileHeader) && checkHeader(getHeader(data), size);
+  if (valid)
+  {
+    const FileHeader &header = getHeader(data);
+    const IndexEntry *index = getIndex(data);
+    for (std::size_t i = 0 ; i < header.subtree_count_ && valid ; ++i)
+      valid = index[i].code_ < ((boost::uint64_t)1 << (3 * OccMapTree::SUBTREE_DEPTH)) && (i == 0 || index[i - 1].code_ < index[i].code_) &&
+        index[i].offset_ % 8 == 0 && index[i].offset_ >= sizeof(FileHeader) && index[i].size_ <= size &&
+        index[i].offset_ + index[i].size_ <= header.end_offset_;
+  }
+  if (!valid)
+  {
+    ROS_ERROR("'%s' is not an occupancy map snapshot of format version %u", filename.c_str(), FORMAT_VERSION);
+    boost::interprocess::mapped_region().swap(region_);
+    return false;
+  }
+
+  data_ = data;
+  filename_ = filename;
+  return true;
+}
+
+double OccMapSnapshot::getResolution() const
+{
+  return data_ ? getHeader(data_).resolution_ : 0.0;
+}
+
+std::size_t OccMapSnapshot::getLeafCount() const
+{
+  return data_ ? getHeader(data_).leaf_count_ : 0;
+}
+
+std::size_t OccMapSnapshot::getSubtreeCount() const
+{
+  return data_ ? getHeader(data_).subtree_count_ : 0;
+}
+
+std::size_t OccMapSnapshot::getSubtreeLeafCount(std::size_t index) const
+{
+  return index < getSubtreeCount() ? getIndex(data_)[index].leaf_count_ : 0;
+}
+
+bool OccMapSnapshot::materializeCoarseLeaves(OccMapTree &tree) const
+{
+  if (!data_)
+    return false;
+  const FileHeader &header = getHeader(data_);
+  if (header.tree_depth_ != tree.getTreeDepth() || tree.getRoot() != NULL)
+    return false;
+  if (header.coarse_count_ == 0)
+    return true;
+  if (!checkCoarseLeaves(data_))
+  {
+    ROS_ERROR("Occupancy map snapshot '%s' is corrupt", filename_.c_str());
+    return false;
+  }
+
+  const unsigned int tree_depth = header.tree_depth_;
+  const boost::uint64_t *codes = reinterpret_cast<const boost::uint64_t*>(data_ + header.coarse_offset_);
+  const float *values = reinterpret_cast<const float*>(data_ + header.coarse_offset_ + header.coarse_count_ * sizeof(boost::uint64_t));
+  tree.root = new OccMapNode();
+  tree.tree_size++;
+  for (boost::uint64_t i = 0 ; i < header.coarse_count_ ; ++i)
+  {
+    const unsigned int depth = codes[i] & DEPTH_MASK;
+    const boost::uint64_t path = codes[i] >> DEPTH_BITS;
+    OccMapNode *node = tree.root;
+    for (unsigned int d = 0 ; d < depth ; ++d)
+    {
+      const unsigned int pos = childIndex(path, d, tree_depth);
+      if (!node->childExists(pos))
+      {
+        node->createChild(pos);
+        tree.tree_size++;
+      }
+      node = node->getChild(pos);
+    }
+    node->setLogOdds(values[i]);
+  }
+  updateInnerOccupancy(tree.root, 0, OccMapTree::SUBTREE_DEPTH);
+  tree.size_changed = true;
+  tree.markAllChanged();
+  return true;
+}
+
+bool OccMapSnapshot::materializeSubtree(OccMapTree &tree, std::size_t index) const
+{
+  if (index >= getSubtreeCount())
+    return false;
+  const FileHeader &header = getHeader(data_);
+  if (header.tree_depth_ != tree.getTreeDepth())
+    return false;
+  const unsigned int depth = OccMapTree::SUBTREE_DEPTH;
+  const unsigned int tree_depth = header.tree_depth_;
+  const IndexEntry &entry = getIndex(data_)[index];
+  const boost::uint64_t path = entry.code_ << (3 * (tree_depth - depth));
+
+  // the existing part of the path to the subtree; the subtree is skipped if it is in the tree already, or if a leaf above it covers it
+  std::vector<OccMapNode*> nodes(depth + 1, NULL);
+  nodes[0] = tree.root;
+  unsigned int d = 0;
+  while (d < depth && nodes[d] && nodes[d]->childExists(childIndex(path, d, tree_depth)))
+  {
+    nodes[d + 1] = nodes[d]->getChild(childIndex(path, d, tree_depth));
+    ++d;
+  }
+  if (d == depth || (nodes[d] && !nodes[d]->hasChildren()))
+    return false;
+
+  const float *values;
+  const boost::uint16_t *masks;
+  const boost::uint8_t *indices;
+  if (!parseBlock(data_, entry, tree_depth, values, masks, indices))
+  {
+    ROS_ERROR("Occupancy map snapshot '%s' is corrupt", filename_.c_str());
+    return false;
+  }
+
+  std::size_t created = 0;
+  if (!nodes[0])
+  {
+    tree.root = new OccMapNode();
+    nodes[0] = tree.root;
+    created++;
+  }
+  for ( ; d < depth ; ++d)
+  {
+    const unsigned int pos = childIndex(path, d, tree_depth);
+    nodes[d]->createChild(pos);
+    nodes[d + 1] = nodes[d]->getChild(pos);
+    created++;
+  }
+
+  std::size_t mask_index = 0, leaf = 0;
+  if (reinterpret_cast<const BlockHeader*>(data_ + entry.offset_)->inner_count_ == 0)
+    nodes[depth]->setLogOdds(indices ? values[indices[0]] : values[0]);
+  else
+    decodeStructure(nodes[depth], masks, mask_index, values, indices, leaf, created);
+  for (d = depth ; d > 0 ; --d)
+    nodes[d - 1]->updateOccupancyChildren();
+
+  tree.tree_size += created;
+  tree.size_changed = true;
+  tree.markAllChanged();
+  return true;
+}
+
+std::size_t OccMapSnapshot::materializeRegion(OccMapTree &tree, const octomap::point3d &min, const octomap::point3d &max) const
+{
+  octomap::OcTreeKey min_key, max_key;
+  if (!data_ || !tree.coordToKeyChecked(min, min_key) || !tree.coordToKeyChecked(max, max_key))
+    return 0;
+
+  const unsigned int depth = OccMapTree::SUBTREE_DEPTH;
+  const unsigned int shift = tree.getTreeDepth() - depth;
+  const boost::uint64_t mask = (1 << depth) - 1;
+  const IndexEntry *index = getIndex(data_);
+  std::size_t count = 0;
+  for (std::size_t i = 0 ; i < getSubtreeCount() ; ++i)
+  {
+    const boost::uint64_t id = getSubtreeId(index[i].code_);
+    const boost::uint64_t x = id >> (2 * depth), y = (id >> depth) & mask, z = id & mask;
+    if (x >= (boost::uint64_t)(min_key[0] >> shift) && x <= (boost::uint64_t)(max_key[0] >> shift) &&
+        y >= (boost::uint64_t)(min_key[1] >> shift) && y <= (boost::uint64_t)(max_key[1] >> shift) &&
+        z >= (boost::uint64_t)(min_key[2] >> shift) && z <= (boost::uint64_t)(max_key[2] >> shift) &&
+        materializeSubtree(tree, i))
+      count++;
+  }
+  return count;
+}
+
+bool OccMapSnapshot::materialize(OccMapTree &tree) const
+{
+  if (!data_)
+    return false;
+  tree.clear();
+  if (tree.getResolution() != getResolution())
+    tree.setResolution(getResolution());
+  if (!materializeCoarseLeaves(tree))
+    return false;
+  for (std::size_t i = 0 ; i < getSubtreeCount() ; ++i)
+    if (!materializeSubtree(tree, i))
+    {
+      ROS_ERROR("Unable to materialize subtree %u of occupancy map snapshot '%s'", (unsigned int)i, filename_.c_str());
+      tree.clear();
+      return false;
+    }
+  return true;
+}
+
+bool OccMapSnapshot::write(OccMapTree &tree, const std::string &filename, bool incremental)
+{
+  const unsigned int depth = OccMapTree::SUBTREE_DEPTH;
+  const unsigned int tree_depth = tree.getTreeDepth();
+  std::vector<boost::uint64_t> coarse_codes;
+  std::vector<float> coarse_values;
+  std::vector<std::pair<boost::uint64_t, const OccMapNode*> > subtrees;
+  if (tree.getRoot())
+    collectTop(tree.getRoot(), 0, 0, tree_depth, coarse_codes, coarse_values, subtrees);
+
+  std::vector<IndexEntry> index(subtrees.size());
+  std::vector<bool> changed(subtrees.size(), true);
+  for (std::size_t i = 0 ; i < subtrees.size() ; ++i)
+    index[i].code_ = subtrees[i].first;
+
+  // keep the blocks of the subtrees that did not change since the last snapshot, unless the blocks that would not be
+  // referenced anymore outgrow them
+  FileHeader header = FileHeader();
+  std::vector<IndexEntry> previous;
+  bool append = false;
+  if (incremental && !tree.all_changed_ && tree.snapshot_id_ != 0 && readIndex(filename, tree, tree.snapshot_id_, header, previous))
+  {
+    boost::uint64_t kept = 0, previous_size = 0;
+    for (std::size_t i = 0 ; i < previous.size() ; ++i)
+      previous_size += previous[i].size_;
+    for (std::size_t i = 0 ; i < subtrees.size() ; ++i)
+    {
+      const unsigned int shard = index[i].code_ >> (3 * (depth - 1));
+      if (tree.shard_changed_[shard] || tree.changed_subtrees_[shard].count(getSubtreeId(index[i].code_)) > 0)
+        continue;
+      std::vector<IndexEntry>::const_iterator it = std::lower_bound(previous.begin(), previous.end(), index[i], compareCodes);
+      if (it != previous.end() && it->code_ == index[i].code_)
+      {
+        index[i] = *it;
+        changed[i] = false;
+        kept += it->size_;
+      }
+    }
+    header.garbage_ += coarseBlockSize(header.coarse_count_) + previous.size() * sizeof(IndexEntry) + previous_size - kept;
+    append = header.garbage_ <= kept;
+    if (!append)
+      changed.assign(subtrees.size(), true);
+  }
+
+  std::stringstream tmp_name;
+  tmp_name << filename << "." << getpid() << ".tmp";
+  const std::string out_filename = append ? filename : tmp_name.str();
+  std::fstream out;
+  boost::uint64_t offset;
+  if (append)
+  {
+    out.open(out_filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    offset = header.end_offset_;
+    out.seekp(offset);
+  }
+  else
+  {
+    out.open(out_filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    std::copy(FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC), header.magic_);
+    header.version_ = FORMAT_VERSION;
+    header.tree_depth_ = tree_depth;
+    header.subtree_depth_ = depth;
+    header.reserved_ = 0;
+    header.resolution_ = tree.getResolution();
+    header.garbage_ = 0;
+    header.snapshot_id_ = 0;
+    offset = sizeof(header);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+  if (!out.good())
+  {
+    ROS_ERROR("Unable to open '%s' for writing", out_filename.c_str());
+    return false;
+  }
+
+  std::vector<boost::uint16_t> masks;
+  std::vector<boost::uint32_t> values, table;
+  std::vector<boost::uint8_t> indices;
+  std::vector<char> block;
+  std::size_t written = 0;
+  header.leaf_count_ = coarse_codes.size();
+  for (std::size_t i = 0 ; i < subtrees.size() ; ++i)
+  {
+    if (changed[i])
+    {
+      encodeSubtree(subtrees[i].second, masks, values, table, indices, block);
+      index[i].offset_ = offset;
+      index[i].size_ = block.size();
+      index[i].leaf_count_ = values.size();
+      writeBlock(out, block, offset);
+      written++;
+    }
+    header.leaf_count_ += index[i].leaf_count_;
+  }
+
+  header.coarse_offset_ = offset;
+  header.coarse_count_ = coarse_codes.size();
+  block.clear();
+  if (!coarse_codes.empty())
+  {
+    appendData(block, &coarse_codes[0], coarse_codes.size());
+    appendData(block, &coarse_values[0], coarse_values.size());
+  }
+  block.resize(coarseBlockSize(coarse_codes.size()), 0);
+  writeBlock(out, block, offset);
+
+  header.index_offset_ = offset;
+  header.subtree_count_ = index.size();
+  if (!index.empty())
+    out.write(reinterpret_cast<const char*>(&index[0]), index.size() * sizeof(IndexEntry));
+  offset += index.size() * sizeof(IndexEntry);
+  header.end_offset_ = offset;
+  header.snapshot_id_ = makeSnapshotId();
+
+  // the header goes last, so the file holds the previous snapshot until the new one is complete
+  out.flush();
+  out.seekp(0);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.close();
+  boost::system::error_code ec;
+  if (out.fail())
+  {
+    ROS_ERROR("Error writing '%s'", out_filename.c_str());
+    if (!append)
+      boost::filesystem::remove(out_filename, ec);
+    return false;
+  }
+  if (!append)
+  {
+    boost::filesystem::rename(out_filename, filename, ec);
+    if (ec)
+    {
+      ROS_ERROR("Unable to rename '%s' to '%s': %s", out_filename.c_str(), filename.c_str(), ec.message().c_str());
+      boost::filesystem::remove(out_filename, ec);
+      return false;
+    }
+  }
+
+  tree.clearChanges(false);
+  tree.snapshot_id_ = header.snapshot_id_;
+  ROS_DEBUG("Wrote %u of %u subtrees of the occupancy map to snapshot '%s' (%s)", (unsigned int)written,
+            (unsigned int)subtrees.size(), filename.c_str(), append ? "incremental" : "full");
+  return true;
+}
+
+}
@@ -36,10 +36,33 @@
 
 #include <moveit/occupancy_map_monitor/occupancy_map_monitor.h>
 #include <moveit/occupancy_map_monitor/occupancy_map_updater.h>
+#include <boost/bind.hpp>
 
 namespace occupancy_map_monitor
 {
 
+namespace
+{
+
+bool fillFromCacheProvider(const TransformCacheProvider &provider, const std::string &target_frame, const ros::Time &target_time,
+                           ShapeTransformArray &transforms)
+{
+  ShapeTransformCache cache;
+  if (!provider(target_frame, target_time, cache))
+    return false;
+  transforms.copyFrom(cache);
+  return true;
+}
+
+}
+
+TransformArrayProvider makeTransformArrayProvider(const TransformCacheProvider &provider)
+{
+  if (!provider)
+    return TransformArrayProvider();
+  return boost::bind(&fillFromCacheProvider, provider, _1, _2, _3);
+}
+
 OccupancyMapUpdater::OccupancyMapUpdater(const std::string &type) : type_(type)
 {
 }
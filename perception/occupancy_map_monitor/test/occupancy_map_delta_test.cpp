@@ -0,0 +1,272 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <moveit/occupancy_map_monitor/occupancy_map_delta.h>
+#include <octomap_msgs/conversions.h>
+#include <cstdlib>
+
+using namespace occupancy_map_monitor;
+
+namespace
+{
+
+const double RESOLUTION = 0.05;
+
+// updates of random cells of a 4 m cube and of a few walls that get observed over and over, so most of them are clamped
+void makeUpdates(const OccMapTree &tree, unsigned int count, std::vector<OccMapTree::NodeUpdate> &updates)
+{
+  for (unsigned int i = 0 ; i < count ; ++i)
+  {
+    const octomap::OcTreeKey key = tree.coordToKey(4.0 * rand() / RAND_MAX - 2.0, 4.0 * rand() / RAND_MAX - 2.0, 4.0 * rand() / RAND_MAX - 2.0);
+    updates.push_back(OccMapTree::NodeUpdate(key, rand() % 2 == 0 ? tree.getProbHitLog() : tree.getProbMissLog()));
+  }
+  for (double x = -2.0 ; x < 2.0 ; x += RESOLUTION)
+    for (double z = -2.0 ; z < 2.0 ; z += RESOLUTION)
+    {
+      updates.push_back(OccMapTree::NodeUpdate(tree.coordToKey(x, 2.0, z), tree.getProbHitLog()));
+      updates.push_back(OccMapTree::NodeUpdate(tree.coordToKey(x, 1.0, z), tree.getProbMissLog()));
+    }
+}
+
+int cellState(const octomap::OcTree &tree, const octomap::OcTreeKey &key)
+{
+  const octomap::OcTreeNode *node = tree.search(key);
+  return node == NULL ? 0 : tree.isNodeOccupied(node) ? 2 : 1;
+}
+
+// the decoded tree tells the same cells apart as a keyframe of the tree would
+void expectSameCells(OccMapTree &tree, const octomap::OcTree &decoded, const std::vector<OccMapTree::NodeUpdate> &updates)
+{
+  OccMapTree::ReadLock lock = tree.reading();
+  octomap_msgs::Octomap msg;
+  ASSERT_TRUE(octomap_msgs::binaryMapToMsg(tree, msg));
+  OccMapDeltaDecoder keyframe;
+  ASSERT_TRUE(keyframe.decode(msg));
+  unsigned int different = 0;
+  for (std::size_t i = 0 ; i < updates.size() ; ++i)
+  {
+    const int state = cellState(tree, updates[i].key_);
+    if (state != cellState(decoded, updates[i].key_) || state != cellState(*keyframe.getOcTree(), updates[i].key_))
+      different++;
+  }
+  EXPECT_EQ(0u, different);
+}
+
+bool encode(OccMapDeltaEncoder &encoder, OccMapTree &tree, octomap_msgs::Octomap &msg)
+{
+  OccMapTree::ReadLock lock = tree.reading();
+  return encoder.encode(tree, msg);
+}
+
+}
+
+TEST(OccMapDelta, MatchesKeyframes)
+{
+  srand(1);
+  OccMapTree tree(RESOLUTION);
+  std::vector<OccMapTree::NodeUpdate> all_updates;
+  makeUpdates(tree, 20000, all_updates);
+  tree.updateNodes(all_updates);
+
+  OccMapDeltaEncoder encoder(1000);
+  OccMapDeltaDecoder decoder;
+  octomap_msgs::Octomap msg;
+  EXPECT_TRUE(encode(encoder, tree, msg));
+  EXPECT_FALSE(OccMapDeltaDecoder::isDelta(msg));
+  const std::size_t keyframe_size = msg.data.size();
+  ASSERT_TRUE(decoder.decode(msg));
+  expectSameCells(tree, *decoder.getOcTree(), all_updates);
+
+  for (unsigned int i = 0 ; i < 20 ; ++i)
+  {
+    std::vector<OccMapTree::NodeUpdate> updates;
+    makeUpdates(tree, 2000, updates);
+    tree.updateNodes(updates);
+    all_updates.insert(all_updates.end(), updates.begin(), updates.end());
+
+    EXPECT_FALSE(encode(encoder, tree, msg));
+    EXPECT_TRUE(OccMapDeltaDecoder::isDelta(msg));
+    EXPECT_LT(msg.data.size(), keyframe_size / 4);
+    const octomap::OcTree *decoded = decoder.getOcTree().get();
+    ASSERT_TRUE(decoder.decode(msg));
+    EXPECT_EQ(decoded, decoder.getOcTree().get());
+    expectSameCells(tree, *decoder.getOcTree(), all_updates);
+  }
+
+  // observing the same walls again changes nothing
+  std::vector<OccMapTree::NodeUpdate> updates;
+  makeUpdates(tree, 0, updates);
+  tree.updateNodes(updates);
+  EXPECT_FALSE(encode(encoder, tree, msg));
+  EXPECT_EQ(8u, msg.data.size());
+  ASSERT_TRUE(decoder.decode(msg));
+
+  // a tree that is still referenced elsewhere is not changed by the deltas that follow
+  std::shared_ptr<octomap::OcTree> held = decoder.getOcTree();
+  const std::size_t held_size = held->size();
+  updates.clear();
+  makeUpdates(tree, 2000, updates);
+  tree.updateNodes(updates);
+  all_updates.insert(all_updates.end(), updates.begin(), updates.end());
+  EXPECT_FALSE(encode(encoder, tree, msg));
+  ASSERT_TRUE(decoder.decode(msg));
+  EXPECT_NE(held.get(), decoder.getOcTree().get());
+  EXPECT_EQ(held_size, held->size());
+  expectSameCells(tree, *decoder.getOcTree(), all_updates);
+}
+
+TEST(OccMapDelta, Keyframes)
+{
+  srand(2);
+  OccMapTree tree(RESOLUTION);
+  std::vector<OccMapTree::NodeUpdate> updates;
+  makeUpdates(tree, 20000, updates);
+  tree.updateNodes(updates);
+
+  OccMapDeltaEncoder encoder(3);
+  octomap_msgs::Octomap msg;
+  EXPECT_TRUE(encode(encoder, tree, msg));
+  const boost::uint32_t seq = msg.header.seq;
+  for (unsigned int i = 0 ; i < 3 ; ++i)
+  {
+    tree.updateNodes(updates);
+    EXPECT_FALSE(encode(encoder, tree, msg));
+    EXPECT_EQ(seq + i + 1, msg.header.seq);
+  }
+  EXPECT_TRUE(encode(encoder, tree, msg));
+  EXPECT_FALSE(encode(encoder, tree, msg));
+
+  encoder.forceKeyframe();
+  EXPECT_TRUE(encode(encoder, tree, msg));
+
+  // locking the tree for writing alone does not force a keyframe
+  {
+    OccMapTree::WriteLock lock = tree.writing();
+  }
+  EXPECT_FALSE(encode(encoder, tree, msg));
+
+  // changes made under the write lock and marked as such do
+  {
+    OccMapTree::WriteLock lock = tree.writing();
+    tree.updateNode(tree.coordToKey(1.0, 1.0, 1.0), true);
+    tree.markAllChanged();
+  }
+  EXPECT_TRUE(encode(encoder, tree, msg));
+
+  // a full map given by the caller is kept as the keyframe
+  encoder.forceKeyframe();
+  {
+    OccMapTree::ReadLock lock = tree.reading();
+    octomap_msgs::Octomap full;
+    ASSERT_TRUE(octomap_msgs::binaryMapToMsg(tree, full));
+    msg = full;
+    EXPECT_FALSE(encoder.encodeDelta(tree, msg));
+    EXPECT_EQ(full.data, msg.data);
+    EXPECT_EQ("OcTree", msg.id);
+  }
+  tree.updateNodes(updates);
+  {
+    OccMapTree::ReadLock lock = tree.reading();
+    EXPECT_TRUE(encoder.encodeDelta(tree, msg));
+    EXPECT_EQ(OccMapDeltaEncoder::DELTA_ID, msg.id);
+  }
+
+  // without deltas, every map is a keyframe
+  encoder.setKeyframeInterval(0);
+  EXPECT_TRUE(encode(encoder, tree, msg));
+  tree.updateNodes(updates);
+  EXPECT_TRUE(encode(encoder, tree, msg));
+}
+
+TEST(OccMapDelta, MissedDeltas)
+{
+  srand(3);
+  OccMapTree tree(RESOLUTION);
+  std::vector<OccMapTree::NodeUpdate> updates;
+  makeUpdates(tree, 20000, updates);
+  tree.updateNodes(updates);
+
+  OccMapDeltaEncoder encoder(5);
+  OccMapDeltaDecoder decoder;
+  octomap_msgs::Octomap msg;
+
+  // deltas before the first keyframe are ignored
+  encode(encoder, tree, msg);
+  tree.updateNodes(updates);
+  ASSERT_FALSE(encode(encoder, tree, msg));
+  EXPECT_FALSE(decoder.decode(msg));
+  EXPECT_FALSE(decoder.getOcTree());
+
+  // once a delta is missed, the following ones are ignored until the next keyframe
+  bool keyframe;
+  do
+    keyframe = encode(encoder, tree, msg);
+  while (!keyframe);
+  ASSERT_TRUE(decoder.decode(msg));
+  std::vector<OccMapTree::NodeUpdate> changes;
+  makeUpdates(tree, 2000, changes);
+  tree.updateNodes(changes);
+  ASSERT_FALSE(encode(encoder, tree, msg));
+  makeUpdates(tree, 2000, changes);
+  tree.updateNodes(changes);
+  ASSERT_FALSE(encode(encoder, tree, msg));
+  EXPECT_FALSE(decoder.decode(msg));
+  do
+  {
+    keyframe = encode(encoder, tree, msg);
+    EXPECT_EQ(keyframe, decoder.decode(msg));
+  }
+  while (!keyframe);
+  tree.updateNodes(changes);
+  ASSERT_FALSE(encode(encoder, tree, msg));
+  EXPECT_TRUE(decoder.decode(msg));
+  updates.insert(updates.end(), changes.begin(), changes.end());
+  expectSameCells(tree, *decoder.getOcTree(), updates);
+
+  // a delta cut short is rejected without changing the tree
+  tree.updateNodes(changes);
+  makeUpdates(tree, 2000, changes);
+  tree.updateNodes(changes);
+  ASSERT_FALSE(encode(encoder, tree, msg));
+  ASSERT_LT(8u, msg.data.size());
+  msg.data.resize(msg.data.size() - 1);
+  EXPECT_FALSE(decoder.decode(msg));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
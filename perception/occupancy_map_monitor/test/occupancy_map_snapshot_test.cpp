@@ -0,0 +1,360 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2011, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include <gtest/gtest.h>
+#include <moveit/occupancy_map_monitor/occupancy_map_snapshot.h>
+#include <boost/filesystem.hpp>
+#include <cstdlib>
+#include <fstream>
+
+using namespace occupancy_map_monitor;
+
+namespace
+{
+
+const double RESOLUTION = 0.02;
+
+// random updates of the cells of a 12 m cube around the origin, so the tree has a few dozen subtrees, and a block
+// of cells updated until they are clamped, so part of the tree is pruned
+void makeUpdates(const OccMapTree &tree, unsigned int count, double offset, std::vector<OccMapTree::NodeUpdate> &updates)
+{
+  for (unsigned int i = 0 ; i < count ; ++i)
+  {
+    const octomap::OcTreeKey key = tree.coordToKey(12.0 * rand() / RAND_MAX - 6.0, 12.0 * rand() / RAND_MAX - 6.0, 3.0 * rand() / RAND_MAX - 1.5);
+    updates.push_back(OccMapTree::NodeUpdate(key, rand() % 3 == 0 ? tree.getProbHitLog() : tree.getProbMissLog()));
+  }
+  const octomap::OcTreeKey corner = tree.coordToKey(offset, offset, offset);
+  for (unsigned int k = 0 ; k < 10 ; ++k)
+    for (unsigned int x = 0 ; x < 16 ; ++x)
+      for (unsigned int y = 0 ; y < 16 ; ++y)
+        for (unsigned int z = 0 ; z < 16 ; ++z)
+          updates.push_back(OccMapTree::NodeUpdate(octomap::OcTreeKey((corner[0] & ~15) + x, (corner[1] & ~15) + y, (corner[2] & ~15) + z),
+                                                   tree.getProbMissLog()));
+}
+
+bool sameNodes(const OccMapNode *expected, const OccMapNode *node)
+{
+  if (expected->getLogOdds() != node->getLogOdds() || expected->hasChildren() != node->hasChildren())
+    return false;
+  for (unsigned int i = 0 ; i < 8 ; ++i)
+    if (expected->childExists(i) != node->childExists(i) ||
+        (expected->childExists(i) && !sameNodes(expected->getChild(i), node->getChild(i))))
+      return false;
+  return true;
+}
+
+void expectSameTree(OccMapTree &expected, OccMapTree &tree)
+{
+  OccMapTree::ReadLock expected_lock = expected.reading();
+  OccMapTree::ReadLock lock = tree.reading();
+  EXPECT_EQ(expected.getResolution(), tree.getResolution());
+  EXPECT_EQ(expected.calcNumNodes(), tree.size());
+  EXPECT_EQ(tree.calcNumNodes(), tree.size());
+  ASSERT_EQ(expected.getRoot() == NULL, tree.getRoot() == NULL);
+  if (expected.getRoot())
+  {
+    EXPECT_TRUE(sameNodes(expected.getRoot(), tree.getRoot()));
+  }
+}
+
+void loadSnapshot(const std::string &filename, OccMapTree &tree)
+{
+  OccMapSnapshot snapshot;
+  ASSERT_TRUE(snapshot.open(filename));
+  OccMapTree::WriteLock lock = tree.writing();
+  EXPECT_TRUE(snapshot.materialize(tree));
+}
+
+bool writeSnapshot(OccMapTree &tree, const std::string &filename, bool incremental)
+{
+  OccMapTree::ReadLock lock = tree.reading();
+  return OccMapSnapshot::write(tree, filename, incremental);
+}
+
+class OccMapSnapshotTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    filename_ = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("occupancy_map_%%%%-%%%%.snapshot")).string();
+  }
+
+  virtual void TearDown()
+  {
+    boost::filesystem::remove(filename_);
+  }
+
+  std::string filename_;
+};
+
+}
+
+TEST_F(OccMapSnapshotTest, RoundTrip)
+{
+  srand(1);
+  OccMapTree tree(RESOLUTION), loaded(0.1);
+  std::vector<OccMapTree::NodeUpdate> updates;
+  makeUpdates(tree, 50000, 1.0, updates);
+  tree.updateNodes(updates);
+
+  EXPECT_TRUE(OccMapSnapshot::hasSnapshotExtension(filename_));
+  ASSERT_TRUE(writeSnapshot(tree, filename_, false));
+  EXPECT_TRUE(OccMapSnapshot::isSnapshot(filename_));
+
+  OccMapSnapshot snapshot;
+  ASSERT_TRUE(snapshot.open(filename_));
+  EXPECT_EQ(RESOLUTION, snapshot.getResolution());
+  EXPECT_LT(1u, snapshot.getSubtreeCount());
+  std::size_t leaves = 0;
+  for (std::size_t i = 0 ; i < snapshot.getSubtreeCount() ; ++i)
+    leaves += snapshot.getSubtreeLeafCount(i);
+  EXPECT_EQ(leaves, snapshot.getLeafCount());
+  EXPECT_LT(snapshot.getLeafCount(), tree.size());
+
+  // the resolution of the tree is replaced by the one of the snapshot
+  loadSnapshot(filename_, loaded);
+  expectSameTree(tree, loaded);
+
+  // an empty tree
+  OccMapTree empty(RESOLUTION);
+  ASSERT_TRUE(writeSnapshot(empty, filename_, false));
+  loadSnapshot(filename_, loaded);
+  expectSameTree(empty, loaded);
+}
+
+TEST_F(OccMapSnapshotTest, CoarseLeaves)
+{
+  srand(2);
+  OccMapTree tree(RESOLUTION), loaded(RESOLUTION);
+  std::vector<OccMapTree::NodeUpdate> updates;
+  makeUpdates(tree, 10000, -2.0, updates);
+  tree.updateNodes(updates);
+
+  // a leaf well above the depth of the subtrees, as left by pruning a large uniform region, far from the other cells
+  {
+    OccMapTree::WriteLock lock = tree.writing();
+    OccMapNode *path[6] = { tree.getRoot() };
+    for (unsigned int d = 0 ; d < 5 ; ++d)
+    {
+      if (!path[d]->childExists(0))
+        path[d]->createChild(0);
+      path[d + 1] = path[d]->getChild(0);
+    }
+    path[5]->setLogOdds(tree.getClampingThresMinLog());
+    for (unsigned int d = 5 ; d > 0 ; --d)
+      path[d - 1]->updateOccupancyChildren();
+  }
+
+  ASSERT_TRUE(writeSnapshot(tree, filename_, false));
+  loadSnapshot(filename_, loaded);
+  expectSameTree(tree, loaded);
+}
+
+TEST_F(OccMapSnapshotTest, Incremental)
+{
+  srand(3);
+  OccMapTree tree(RESOLUTION), loaded(RESOLUTION);
+  std::vector<OccMapTree::NodeUpdate> updates;
+  makeUpdates(tree, 50000, 1.0, updates);
+  tree.updateNodes(updates);
+  ASSERT_TRUE(writeSnapshot(tree, filename_, true));
+  const boost::uintmax_t full_size = boost::filesystem::file_size(filename_);
+
+  // changes in a small part of the map only add the subtrees they are in
+  for (unsigned int i = 0 ; i < 5 ; ++i)
+  {
+    std::vector<OccMapTree::NodeUpdate> changes;
+    for (unsigned int j = 0 ; j < 1000 ; ++j)
+      changes.push_back(OccMapTree::NodeUpdate(tree.coordToKey(0.5 * rand() / RAND_MAX, 0.5 * rand() / RAND_MAX, 0.5 * rand() / RAND_MAX),
+                                               tree.getProbHitLog()));
+    tree.updateNodes(changes);
+    const boost::uintmax_t size = boost::filesystem::file_size(filename_);
+    ASSERT_TRUE(writeSnapshot(tree, filename_, true));
+    EXPECT_LT(boost::filesystem::file_size(filename_) - size, full_size / 2);
+    loadSnapshot(filename_, loaded);
+    expectSameTree(tree, loaded);
+  }
+
+  // changes all over the map make the file rewritten, rather than growing without bounds
+  for (unsigned int i = 0 ; i < 5 ; ++i)
+  {
+    std::vector<OccMapTree::NodeUpdate> changes;
+    makeUpdates(tree, 5000, -1.0, changes);
+    tree.updateNodes(changes);
+    ASSERT_TRUE(writeSnapshot(tree, filename_, true));
+    EXPECT_GT(3 * full_size, boost::filesystem::file_size(filename_));
+    loadSnapshot(filename_, loaded);
+    expectSameTree(tree, loaded);
+  }
+
+  // locking the tree for writing alone does not make the file rewritten, which would drop the replaced subtree
+  ASSERT_TRUE(writeSnapshot(tree, filename_, false));
+  tree.updateNodes(std::vector<OccMapTree::NodeUpdate>(1, OccMapTree::NodeUpdate(tree.coordToKey(0.25, 0.25, 0.25), tree.getProbHitLog())));
+  ASSERT_TRUE(writeSnapshot(tree, filename_, true));
+  {
+    OccMapTree::WriteLock lock = tree.writing();
+  }
+  const boost::uintmax_t size = boost::filesystem::file_size(filename_);
+  ASSERT_TRUE(writeSnapshot(tree, filename_, true));
+  EXPECT_LE(size, boost::filesystem::file_size(filename_));
+
+  // changes made under the write lock and marked as such make the whole tree written again
+  {
+    OccMapTree::WriteLock lock = tree.writing();
+    tree.updateNode(tree.coordToKey(-3.0, 3.0, 0.0), true);
+    tree.markAllChanged();
+  }
+  ASSERT_TRUE(writeSnapshot(tree, filename_, true));
+  loadSnapshot(filename_, loaded);
+  expectSameTree(tree, loaded);
+}
+
+TEST_F(OccMapSnapshotTest, IncrementalOtherMap)
+{
+  srand(5);
+  OccMapTree tree(RESOLUTION), other(RESOLUTION), loaded(RESOLUTION);
+  std::vector<OccMapTree::NodeUpdate> updates, other_updates;
+  makeUpdates(tree, 20000, 1.0, updates);
+  tree.updateNodes(updates);
+  makeUpdates(other, 20000, -1.0, other_updates);
+  other.updateNodes(other_updates);
+
+  // a map of the same resolution replaced the last snapshot of the tree, so the changes of the tree are not appended to it
+  ASSERT_TRUE(writeSnapshot(tree, filename_, true));
+  ASSERT_TRUE(writeSnapshot(other, filename_, false));
+  tree.updateNodes(std::vector<OccMapTree::NodeUpdate>(1, OccMapTree::NodeUpdate(tree.coordToKey(0.25, 0.25, 0.25), tree.getProbHitLog())));
+  ASSERT_TRUE(writeSnapshot(tree, filename_, true));
+  loadSnapshot(filename_, loaded);
+  expectSameTree(tree, loaded);
+
+  // nor are those of the other map, once the tree has written the file
+  other.updateNodes(std::vector<OccMapTree::NodeUpdate>(1, OccMapTree::NodeUpdate(other.coordToKey(0.25, 0.25, 0.25), other.getProbMissLog())));
+  ASSERT_TRUE(writeSnapshot(other, filename_, true));
+  loadSnapshot(filename_, loaded);
+  expectSameTree(other, loaded);
+}
+
+TEST_F(OccMapSnapshotTest, LazyMaterialization)
+{
+  srand(4);
+  OccMapTree tree(RESOLUTION), loaded(RESOLUTION);
+  std::vector<OccMapTree::NodeUpdate> updates;
+  makeUpdates(tree, 50000, 1.0, updates);
+  tree.updateNodes(updates);
+  ASSERT_TRUE(writeSnapshot(tree, filename_, false));
+
+  OccMapSnapshot snapshot;
+  ASSERT_TRUE(snapshot.open(filename_));
+  OccMapTree::WriteLock lock = loaded.writing();
+  ASSERT_TRUE(snapshot.materializeCoarseLeaves(loaded));
+
+  // only the subtrees around the box are there
+  const std::size_t count = snapshot.materializeRegion(loaded, octomap::point3d(0.5, 0.5, 0.5), octomap::point3d(1.5, 1.5, 1.0));
+  EXPECT_LT(0u, count);
+  EXPECT_GT(snapshot.getSubtreeCount(), count);
+  EXPECT_EQ(loaded.calcNumNodes(), loaded.size());
+  for (std::size_t i = 0 ; i < updates.size() ; ++i)
+  {
+    const octomap::OcTreeKey &key = updates[i].key_;
+    const OccMapNode *node = loaded.search(key);
+    const double x = loaded.keyToCoord(key[0]), y = loaded.keyToCoord(key[1]), z = loaded.keyToCoord(key[2]);
+    if (x > 0.5 && x < 1.5 && y > 0.5 && y < 1.5 && z > 0.5 && z < 1.0)
+    {
+      ASSERT_TRUE(node != NULL);
+      EXPECT_EQ(tree.search(key)->getLogOdds(), node->getLogOdds());
+    }
+  }
+  EXPECT_EQ(0u, snapshot.materializeRegion(loaded, octomap::point3d(0.5, 0.5, 0.5), octomap::point3d(1.5, 1.5, 1.0)));
+
+  // the rest of the subtrees, in any order
+  std::size_t added = 0;
+  for (std::size_t i = snapshot.getSubtreeCount() ; i > 0 ; --i)
+    if (snapshot.materializeSubtree(loaded, i - 1))
+      added++;
+  EXPECT_EQ(snapshot.getSubtreeCount(), count + added);
+  lock = OccMapTree::WriteLock();
+  expectSameTree(tree, loaded);
+}
+
+TEST_F(OccMapSnapshotTest, InvalidFiles)
+{
+  OccMapSnapshot snapshot;
+  EXPECT_FALSE(snapshot.open(filename_));
+  EXPECT_FALSE(OccMapSnapshot::isSnapshot(filename_));
+
+  {
+    std::ofstream out(filename_.c_str());
+    out << "not a snapshot";
+  }
+  EXPECT_FALSE(OccMapSnapshot::isSnapshot(filename_));
+  EXPECT_FALSE(snapshot.open(filename_));
+
+  // a snapshot missing its end
+  srand(5);
+  OccMapTree tree(RESOLUTION);
+  std::vector<OccMapTree::NodeUpdate> updates;
+  makeUpdates(tree, 1000, 1.0, updates);
+  tree.updateNodes(updates);
+  ASSERT_TRUE(writeSnapshot(tree, filename_, false));
+
+  // the number of leaves of the first subtree, right after the 96 byte header of the file, does not match the index;
+  // the blocks of the subtrees are only checked when they are materialized
+  {
+    std::fstream out(filename_.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    out.seekp(96);
+    out.write("\xff\xff\xff\xff", 4);
+  }
+  ASSERT_TRUE(snapshot.open(filename_));
+  OccMapTree loaded(RESOLUTION);
+  {
+    OccMapTree::WriteLock lock = loaded.writing();
+    EXPECT_FALSE(snapshot.materialize(loaded));
+    EXPECT_TRUE(loaded.getRoot() == NULL);
+  }
+  snapshot.close();
+
+  ASSERT_TRUE(writeSnapshot(tree, filename_, false));
+  boost::filesystem::resize_file(filename_, boost::filesystem::file_size(filename_) - 8);
+  EXPECT_TRUE(OccMapSnapshot::isSnapshot(filename_));
+  EXPECT_FALSE(snapshot.open(filename_));
+  EXPECT_FALSE(snapshot.isOpen());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
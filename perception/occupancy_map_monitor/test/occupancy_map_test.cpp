@@ -0,0 +1,183 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2011, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <moveit/occupancy_map_monitor/occupancy_map.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <cstdlib>
+
+using namespace occupancy_map_monitor;
+
+namespace
+{
+
+// random updates of the cells of a 4 m cube around the origin, so all the shards are used, with some repeated cells
+void makeUpdates(const OccMapTree &tree, unsigned int count, std::vector<OccMapTree::NodeUpdate> &updates)
+{
+  const float lg = tree.getClampingThresMinLog() - tree.getClampingThresMaxLog();
+  for (unsigned int i = 0 ; i < count ; ++i)
+  {
+    const octomap::OcTreeKey key = tree.coordToKey(4.0 * rand() / RAND_MAX - 2.0, 4.0 * rand() / RAND_MAX - 2.0, 4.0 * rand() / RAND_MAX - 2.0);
+    const int kind = rand() % 10;
+    const float update = kind < 6 ? tree.getProbHitLog() : (kind < 9 ? tree.getProbMissLog() : lg);
+    updates.push_back(OccMapTree::NodeUpdate(key, update));
+    if (rand() % 4 == 0)
+      updates.push_back(OccMapTree::NodeUpdate(key, tree.getProbHitLog()));
+  }
+}
+
+void expectSameTree(OccMapTree &expected, OccMapTree &tree, const std::vector<OccMapTree::NodeUpdate> &updates)
+{
+  OccMapTree::ReadLock expected_lock = expected.reading();
+  OccMapTree::ReadLock lock = tree.reading();
+  EXPECT_EQ(expected.size(), tree.size());
+  ASSERT_TRUE(tree.getRoot() != NULL);
+  EXPECT_FLOAT_EQ(expected.getRoot()->getLogOdds(), tree.getRoot()->getLogOdds());
+  for (std::size_t i = 0 ; i < updates.size() ; ++i)
+  {
+    const OccMapNode *expected_node = expected.search(updates[i].key_);
+    const OccMapNode *node = tree.search(updates[i].key_);
+    ASSERT_TRUE(expected_node != NULL);
+    ASSERT_TRUE(node != NULL);
+    EXPECT_FLOAT_EQ(expected_node->getLogOdds(), node->getLogOdds());
+  }
+}
+
+void applyUpdates(OccMapTree *tree, const std::vector<OccMapTree::NodeUpdate> *updates, std::size_t batch_size)
+{
+  for (std::size_t i = 0 ; i < updates->size() ; i += batch_size)
+    tree->updateNodes(std::vector<OccMapTree::NodeUpdate>(updates->begin() + i, updates->begin() + std::min(updates->size(), i + batch_size)));
+}
+
+void readTree(OccMapTree *tree, const std::vector<OccMapTree::NodeUpdate> *updates, bool *done)
+{
+  while (true)
+  {
+    OccMapTree::ReadLock lock = tree->reading();
+    if (*done)
+      break;
+    for (std::size_t i = 0 ; i < updates->size() ; i += 97)
+      tree->search((*updates)[i].key_);
+  }
+}
+
+}
+
+TEST(OccMapTree, Shards)
+{
+  OccMapTree tree(0.05);
+  EXPECT_EQ(0u, tree.getShard(tree.coordToKey(-0.1, -0.1, -0.1)));
+  EXPECT_EQ(1u, tree.getShard(tree.coordToKey(0.1, -0.1, -0.1)));
+  EXPECT_EQ(2u, tree.getShard(tree.coordToKey(-0.1, 0.1, -0.1)));
+  EXPECT_EQ(4u, tree.getShard(tree.coordToKey(-0.1, -0.1, 0.1)));
+  EXPECT_EQ(7u, tree.getShard(tree.coordToKey(0.1, 0.1, 0.1)));
+}
+
+TEST(OccMapTree, UpdateNodesMatchesUpdateNode)
+{
+  srand(1);
+  OccMapTree expected(0.05), tree(0.05);
+  std::vector<OccMapTree::NodeUpdate> updates;
+  makeUpdates(tree, 20000, updates);
+
+  for (std::size_t i = 0 ; i < updates.size() ; ++i)
+    expected.updateNode(updates[i].key_, updates[i].log_odds_update_);
+  applyUpdates(&tree, &updates, 1000);
+  expectSameTree(expected, tree, updates);
+
+  // the same keys again, so cells are pruned and clamped
+  for (std::size_t i = 0 ; i < updates.size() ; ++i)
+    expected.updateNode(updates[i].key_, updates[i].log_odds_update_);
+  applyUpdates(&tree, &updates, updates.size());
+  expectSameTree(expected, tree, updates);
+
+  std::vector<octomap::OcTreeKey> keys(1, updates[0].key_);
+  expected.updateNode(keys[0], false);
+  tree.updateNodes(keys, false);
+  expectSameTree(expected, tree, updates);
+}
+
+TEST(OccMapTree, ConcurrentUpdaters)
+{
+  srand(2);
+  OccMapTree expected(0.05), tree(0.05);
+
+  // each updater changes its own cells, so the result does not depend on the order the updaters run in
+  const unsigned int updaters = 4;
+  std::vector<OccMapTree::NodeUpdate> all_updates;
+  makeUpdates(tree, 40000, all_updates);
+  std::vector<std::vector<OccMapTree::NodeUpdate> > updates(updaters);
+  for (std::size_t i = 0 ; i < all_updates.size() ; ++i)
+    updates[(all_updates[i].key_[0] + all_updates[i].key_[1]) % updaters].push_back(all_updates[i]);
+  for (unsigned int j = 0 ; j < updaters ; ++j)
+    for (std::size_t i = 0 ; i < updates[j].size() ; ++i)
+      expected.updateNode(updates[j][i].key_, updates[j][i].log_odds_update_);
+
+  bool done = false;
+  boost::thread reader(boost::bind(&readTree, &tree, &all_updates, &done));
+  boost::thread_group threads;
+  for (unsigned int j = 0 ; j < updaters ; ++j)
+    threads.create_thread(boost::bind(&applyUpdates, &tree, &updates[j], 500));
+  threads.join_all();
+  {
+    OccMapTree::WriteLock lock = tree.writing();
+    done = true;
+  }
+  reader.join();
+
+  expectSameTree(expected, tree, all_updates);
+}
+
+TEST(OccMapTree, LockCopies)
+{
+  OccMapTree tree(0.05);
+  {
+    OccMapTree::ReadLock lock;
+    {
+      OccMapTree::ReadLock first = tree.reading();
+      lock = first;
+    }
+    OccMapTree::ReadLock second = tree.reading();
+  }
+  // all the read locks were released
+  OccMapTree::WriteLock lock = tree.writing();
+  tree.clear();
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,108 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_POINT_CONTAINMENT_FILTER_CONTAINMENT_GRID_
+#define MOVEIT_POINT_CONTAINMENT_FILTER_CONTAINMENT_GRID_
+
+#include <geometric_shapes/bodies.h>
+#include <vector>
+
+namespace point_containment_filter
+{
+
+/** \brief Decides which points are contained in a set of bodies, giving the same result as calling
+ *  bodies::Body::containsPoint() for every body, but much faster for large point sets.
+ *
+ *  The bounding spheres of the bodies are binned in a coarse voxel grid, which selects the bodies worth testing for
+ *  a batch of points. Spheres, boxes and cylinders are then tested with simple loops over arrays of coordinates
+ *  that the compiler can vectorize, and other bodies with their bounding spheres. These tests decide points that are
+ *  clearly inside or clearly outside a body; only the few points that are within a small margin of a surface (or,
+ *  for meshes, inside the bounding sphere) are passed to bodies::Body::containsPoint(). */
+class ContainmentGrid
+{
+public:
+
+  /** \brief The number of points processed at once by containsPoints() */
+  static const std::size_t BATCH_SIZE = 256;
+
+  ContainmentGrid();
+
+  /** \brief Set the bodies to test against. This needs to be called again whenever the pose of a body changes;
+   *  the bodies must remain valid until then. */
+  void setBodies(const std::vector<const bodies::Body*> &bodies);
+
+  /** \brief For each of the \e n points (at most BATCH_SIZE), set \e inside to true if the point is contained in
+   *  one of the bodies, and to false otherwise */
+  void containsPoints(const double *x, const double *y, const double *z, std::size_t n, bool *inside);
+
+private:
+
+  /** \brief The parameters of a body, in the form the batch tests use */
+  struct Kernel
+  {
+    int type_;
+    const bodies::Body *body_;
+    double center_[3];
+    double axis_[3][3];   // the axes of the body frame
+    double half_[3];      // half extents of boxes; the half length of cylinders is half_[2]
+    double radius_;       // radius of spheres and cylinders; bounding radius of other bodies
+  };
+
+  enum Classification
+    {
+      OUTSIDE = 0,
+      INSIDE = 1,
+      UNSURE = 2
+    };
+
+  void classify(const Kernel &kernel, const double *x, const double *y, const double *z, std::size_t n, char *result) const;
+
+  std::vector<Kernel> kernels_;
+
+  // the voxel grid: for every cell, the indices of the kernels whose bounding sphere overlaps the cell
+  double grid_origin_[3];
+  double cell_size_;
+  int grid_size_[3];
+  std::vector<std::vector<unsigned int> > cells_;
+
+  // storage for containsPoints(), kept to avoid allocations
+  std::vector<unsigned int> kernel_stamp_;
+  unsigned int stamp_;
+  std::vector<unsigned int> batch_kernels_;
+  char classification_[BATCH_SIZE];
+};
+
+}
+
+#endif
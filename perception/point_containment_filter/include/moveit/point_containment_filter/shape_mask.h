@@ -39,6 +39,7 @@
 
 #include <sensor_msgs/PointCloud2.h>
 #include <geometric_shapes/bodies.h>
+#include <moveit/point_containment_filter/containment_grid.h>
 #include <boost/function.hpp>
 #include <string>
 #include <vector>
@@ -131,6 +132,10 @@ private:
   std::set<SeeShape, SortBodies> bodies_;
   std::map<ShapeHandle, std::set<SeeShape, SortBodies>::iterator> used_handles_;
   std::vector<bodies::BoundingSphere> bspheres_;
+
+  /// tests batches of points against all bodies at once
+  ContainmentGrid grid_;
+  std::vector<const bodies::Body*> grid_bodies_;
 };
 
 }
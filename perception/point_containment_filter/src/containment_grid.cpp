@@ -0,0 +1,252 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/point_containment_filter/containment_grid.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// much larger than the rounding errors of the batch tests, much smaller than any body
+const double MARGIN = 1e-7;
+
+// number of cells along the longest side of the grid
+const int GRID_RESOLUTION = 16;
+}
+
+const std::size_t point_containment_filter::ContainmentGrid::BATCH_SIZE;
+
+point_containment_filter::ContainmentGrid::ContainmentGrid() :
+  cell_size_(1.0),
+  stamp_(0)
+{
+  for (int j = 0 ; j < 3 ; ++j)
+  {
+    grid_origin_[j] = 0.0;
+    grid_size_[j] = 0;
+  }
+}
+
+void point_containment_filter::ContainmentGrid::setBodies(const std::vector<const bodies::Body*> &bodies)
+{
+  kernels_.resize(bodies.size());
+  double lo[3], hi[3];
+  for (int j = 0 ; j < 3 ; ++j)
+  {
+    lo[j] = std::numeric_limits<double>::infinity();
+    hi[j] = -std::numeric_limits<double>::infinity();
+  }
+
+  std::vector<bodies::BoundingSphere> spheres(bodies.size());
+  for (std::size_t i = 0 ; i < bodies.size() ; ++i)
+  {
+    const bodies::Body *body = bodies[i];
+    Kernel &k = kernels_[i];
+    k.body_ = body;
+    k.type_ = body->getType();
+    body->computeBoundingSphere(spheres[i]);
+
+    const Eigen::Affine3d &pose = body->getPose();
+    for (int a = 0 ; a < 3 ; ++a)
+    {
+      Eigen::Vector3d axis = pose.linear().col(a).normalized();
+      for (int j = 0 ; j < 3 ; ++j)
+        k.axis_[a][j] = axis[j];
+      k.center_[a] = pose.translation()[a];
+      k.half_[a] = 0.0;
+    }
+
+    // the same dimensions the bodies use internally
+    const std::vector<double> dims = body->getDimensions();
+    const double scale = body->getScale();
+    const double padding = body->getPadding();
+    switch (k.type_)
+    {
+    case shapes::SPHERE:
+      k.radius_ = dims[0] * scale + padding;
+      break;
+    case shapes::BOX:
+      for (int j = 0 ; j < 3 ; ++j)
+        k.half_[j] = dims[j] * scale / 2.0 + padding;
+      k.radius_ = 0.0;
+      break;
+    case shapes::CYLINDER:
+      k.radius_ = dims[0] * scale + padding;
+      k.half_[2] = dims[1] * scale / 2.0 + padding;
+      break;
+    default:
+      // everything else is only tested against its bounding sphere before the exact test
+      for (int j = 0 ; j < 3 ; ++j)
+        k.center_[j] = spheres[i].center[j];
+      k.radius_ = spheres[i].radius;
+      break;
+    }
+
+    for (int j = 0 ; j < 3 ; ++j)
+    {
+      lo[j] = std::min(lo[j], spheres[i].center[j] - spheres[i].radius - MARGIN);
+      hi[j] = std::max(hi[j], spheres[i].center[j] + spheres[i].radius + MARGIN);
+    }
+  }
+
+  cells_.clear();
+  kernel_stamp_.assign(kernels_.size(), 0);
+  stamp_ = 0;
+  if (kernels_.empty())
+    return;
+
+  double longest = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+  cell_size_ = std::max(longest / GRID_RESOLUTION, 1e-3);
+  for (int j = 0 ; j < 3 ; ++j)
+  {
+    grid_origin_[j] = lo[j];
+    grid_size_[j] = (int)((hi[j] - lo[j]) / cell_size_) + 1;
+  }
+  cells_.resize(grid_size_[0] * grid_size_[1] * grid_size_[2]);
+
+  for (std::size_t i = 0 ; i < kernels_.size() ; ++i)
+  {
+    int from[3], to[3];
+    for (int j = 0 ; j < 3 ; ++j)
+    {
+      double r = spheres[i].radius + MARGIN;
+      from[j] = std::max(0, (int)floor((spheres[i].center[j] - r - grid_origin_[j]) / cell_size_));
+      to[j] = std::min(grid_size_[j] - 1, (int)floor((spheres[i].center[j] + r - grid_origin_[j]) / cell_size_));
+    }
+    for (int ix = from[0] ; ix <= to[0] ; ++ix)
+      for (int iy = from[1] ; iy <= to[1] ; ++iy)
+        for (int iz = from[2] ; iz <= to[2] ; ++iz)
+          cells_[(ix * grid_size_[1] + iy) * grid_size_[2] + iz].push_back(i);
+  }
+}
+
+void point_containment_filter::ContainmentGrid::classify(const Kernel &k, const double *x, const double *y, const double *z,
+                                                         std::size_t n, char *result) const
+{
+  const double inner = k.radius_ > MARGIN ? (k.radius_ - MARGIN) * (k.radius_ - MARGIN) : -1.0;
+  const double outer = (k.radius_ + MARGIN) * (k.radius_ + MARGIN);
+  const double cx = k.center_[0], cy = k.center_[1], cz = k.center_[2];
+
+  switch (k.type_)
+  {
+  case shapes::SPHERE:
+    for (std::size_t i = 0 ; i < n ; ++i)
+    {
+      const double dx = x[i] - cx, dy = y[i] - cy, dz = z[i] - cz;
+      const double d2 = dx * dx + dy * dy + dz * dz;
+      result[i] = d2 < inner ? INSIDE : (d2 > outer ? OUTSIDE : UNSURE);
+    }
+    break;
+
+  case shapes::BOX:
+    for (std::size_t i = 0 ; i < n ; ++i)
+    {
+      const double dx = x[i] - cx, dy = y[i] - cy, dz = z[i] - cz;
+      const double pa = fabs(dx * k.axis_[0][0] + dy * k.axis_[0][1] + dz * k.axis_[0][2]) - k.half_[0];
+      const double pb = fabs(dx * k.axis_[1][0] + dy * k.axis_[1][1] + dz * k.axis_[1][2]) - k.half_[1];
+      const double pc = fabs(dx * k.axis_[2][0] + dy * k.axis_[2][1] + dz * k.axis_[2][2]) - k.half_[2];
+      const double d = std::max(pa, std::max(pb, pc));
+      result[i] = d < -MARGIN ? INSIDE : (d > MARGIN ? OUTSIDE : UNSURE);
+    }
+    break;
+
+  case shapes::CYLINDER:
+    for (std::size_t i = 0 ; i < n ; ++i)
+    {
+      const double dx = x[i] - cx, dy = y[i] - cy, dz = z[i] - cz;
+      const double p1 = dx * k.axis_[0][0] + dy * k.axis_[0][1] + dz * k.axis_[0][2];
+      const double p2 = dx * k.axis_[1][0] + dy * k.axis_[1][1] + dz * k.axis_[1][2];
+      const double ph = fabs(dx * k.axis_[2][0] + dy * k.axis_[2][1] + dz * k.axis_[2][2]) - k.half_[2];
+      const double r2 = p1 * p1 + p2 * p2;
+      result[i] = (ph < -MARGIN && r2 < inner) ? INSIDE : ((ph > MARGIN || r2 > outer) ? OUTSIDE : UNSURE);
+    }
+    break;
+
+  default:
+    for (std::size_t i = 0 ; i < n ; ++i)
+    {
+      const double dx = x[i] - cx, dy = y[i] - cy, dz = z[i] - cz;
+      const double d2 = dx * dx + dy * dy + dz * dz;
+      result[i] = d2 > outer ? OUTSIDE : UNSURE;
+    }
+    break;
+  }
+}
+
+void point_containment_filter::ContainmentGrid::containsPoints(const double *x, const double *y, const double *z, std::size_t n, bool *inside)
+{
+  std::fill(inside, inside + n, false);
+  if (cells_.empty() || n == 0)
+    return;
+
+  // collect the bodies that are close to any of the points
+  if (++stamp_ == 0)
+  {
+    std::fill(kernel_stamp_.begin(), kernel_stamp_.end(), 0);
+    stamp_ = 1;
+  }
+  batch_kernels_.clear();
+  for (std::size_t i = 0 ; i < n ; ++i)
+  {
+    const double fx = floor((x[i] - grid_origin_[0]) / cell_size_);
+    const double fy = floor((y[i] - grid_origin_[1]) / cell_size_);
+    const double fz = floor((z[i] - grid_origin_[2]) / cell_size_);
+    if (fx < 0.0 || fy < 0.0 || fz < 0.0 || fx >= grid_size_[0] || fy >= grid_size_[1] || fz >= grid_size_[2])
+      continue;
+    const std::vector<unsigned int> &cell = cells_[((int)fx * grid_size_[1] + (int)fy) * grid_size_[2] + (int)fz];
+    for (std::size_t j = 0 ; j < cell.size() ; ++j)
+      if (kernel_stamp_[cell[j]] != stamp_)
+      {
+        kernel_stamp_[cell[j]] = stamp_;
+        batch_kernels_.push_back(cell[j]);
+      }
+  }
+
+  // test the points against each of these bodies; only points close to a surface need the exact test
+  for (std::size_t j = 0 ; j < batch_kernels_.size() ; ++j)
+  {
+    const Kernel &k = kernels_[batch_kernels_[j]];
+    classify(k, x, y, z, n, classification_);
+    for (std::size_t i = 0 ; i < n ; ++i)
+      if (!inside[i])
+      {
+        if (classification_[i] == INSIDE)
+          inside[i] = true;
+        else
+          if (classification_[i] == UNSURE)
+            inside[i] = k.body_->containsPoint(Eigen::Vector3d(x[i], y[i], z[i]));
+      }
+  }
+}
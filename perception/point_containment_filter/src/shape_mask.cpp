@@ -142,27 +142,47 @@ void point_containment_filter::ShapeMask::maskContainment(const sensor_msgs::Poi
     bodies::mergeBoundingSpheres(bspheres_, bound);
     const double radiusSquared = bound.radius * bound.radius;
 
+    // the bodies are tested in batches of points that are within the bounds of the robot
+    grid_bodies_.clear();
+    for (std::set<SeeShape>::const_iterator it = bodies_.begin() ; it != bodies_.end() ; ++it)
+      grid_bodies_.push_back(it->body);
+    grid_.setBodies(grid_bodies_);
+
     // we now decide which points we keep
     sensor_msgs::PointCloud2ConstIterator<float> iter_x(data_in, "x");
     sensor_msgs::PointCloud2ConstIterator<float> iter_y(data_in, "y");
     sensor_msgs::PointCloud2ConstIterator<float> iter_z(data_in, "z");
 
-    // Cloud iterators are not incremented in the for loop, because of the pragma
-// Comment out below parallelization as it can result in very high CPU consumption    
-//#pragma omp parallel for schedule(dynamic)
-    for (int i = 0 ; i < (int)np ; ++i)
+    double x[ContainmentGrid::BATCH_SIZE], y[ContainmentGrid::BATCH_SIZE], z[ContainmentGrid::BATCH_SIZE];
+    bool inside[ContainmentGrid::BATCH_SIZE];
+    unsigned int index[ContainmentGrid::BATCH_SIZE];
+    std::size_t count = 0;
+    for (unsigned int i = 0 ; i < np ; ++i, ++iter_x, ++iter_y, ++iter_z)
     {
-      Eigen::Vector3d pt = Eigen::Vector3d(*(iter_x+i), *(iter_y+i), *(iter_z+i));
+      Eigen::Vector3d pt = Eigen::Vector3d(*iter_x, *iter_y, *iter_z);
       double d = pt.norm();
-      int out = OUTSIDE;
       if (d < min_sensor_dist || d > max_sensor_dist)
-        out = CLIP;
+        mask[i] = CLIP;
       else
+      {
+        mask[i] = OUTSIDE;
         if ((bound.center - pt).squaredNorm() < radiusSquared)
-          for (std::set<SeeShape>::const_iterator it = bodies_.begin() ; it != bodies_.end() && out == OUTSIDE ; ++it)
-            if (it->body->containsPoint(pt))
-              out = INSIDE;
-      mask[i] = out;
+        {
+          x[count] = pt.x();
+          y[count] = pt.y();
+          z[count] = pt.z();
+          index[count++] = i;
+        }
+      }
+
+      if (count == ContainmentGrid::BATCH_SIZE || (i + 1 == np && count > 0))
+      {
+        grid_.containsPoints(x, y, z, count, inside);
+        for (std::size_t k = 0 ; k < count ; ++k)
+          if (inside[k])
+            mask[index[k]] = INSIDE;
+        count = 0;
+      }
     }
   }
 }
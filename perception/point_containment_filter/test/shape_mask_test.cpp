@@ -0,0 +1,205 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <moveit/point_containment_filter/shape_mask.h>
+#include <geometric_shapes/shape_operations.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include <boost/bind.hpp>
+#include <cstdlib>
+
+using namespace point_containment_filter;
+
+namespace
+{
+
+double randomReal(double min, double max)
+{
+  return min + (max - min) * rand() / RAND_MAX;
+}
+
+struct TestBody
+{
+  shapes::ShapeConstPtr shape_;
+  Eigen::Affine3d pose_;
+  double scale_;
+  double padding_;
+  ShapeHandle handle_;
+  boost::shared_ptr<bodies::Body> body_;
+};
+
+bool getTransform(ShapeHandle h, Eigen::Affine3d &transform, const std::vector<TestBody> *bodies)
+{
+  for (std::size_t i = 0 ; i < bodies->size() ; ++i)
+    if ((*bodies)[i].handle_ == h)
+    {
+      transform = (*bodies)[i].pose_;
+      return true;
+    }
+  return false;
+}
+
+// spheres, boxes, cylinders and meshes with random poses, scales and paddings
+std::vector<TestBody> makeBodies(unsigned int count)
+{
+  std::vector<TestBody> result(count);
+  for (unsigned int i = 0 ; i < count ; ++i)
+  {
+    TestBody &b = result[i];
+    switch (i % 4)
+    {
+    case 0:
+      b.shape_.reset(new shapes::Sphere(randomReal(0.02, 0.2)));
+      break;
+    case 1:
+      b.shape_.reset(new shapes::Box(randomReal(0.02, 0.3), randomReal(0.02, 0.3), randomReal(0.02, 0.3)));
+      break;
+    case 2:
+      b.shape_.reset(new shapes::Cylinder(randomReal(0.02, 0.15), randomReal(0.05, 0.4)));
+      break;
+    default:
+      {
+        shapes::Box box(randomReal(0.02, 0.3), randomReal(0.02, 0.3), randomReal(0.02, 0.3));
+        b.shape_.reset(shapes::createMeshFromShape(&box));
+      }
+      break;
+    }
+    b.pose_ = Eigen::Translation3d(randomReal(-0.5, 0.5), randomReal(-0.5, 0.5), randomReal(1.0, 2.0)) *
+      Eigen::Quaterniond(randomReal(-1, 1), randomReal(-1, 1), randomReal(-1, 1), randomReal(-1, 1)).normalized();
+    b.scale_ = (i % 3 == 0) ? 1.0 : randomReal(0.9, 1.2);
+    b.padding_ = (i % 5 == 0) ? 0.0 : randomReal(0.0, 0.03);
+  }
+  return result;
+}
+
+// points in the region of the bodies, many of them on or extremely close to the surfaces
+sensor_msgs::PointCloud2 makeCloud(const std::vector<TestBody> &bodies, unsigned int width, unsigned int height)
+{
+  sensor_msgs::PointCloud2 cloud;
+  cloud.width = width;
+  cloud.height = height;
+  sensor_msgs::PointCloud2Modifier modifier(cloud);
+  modifier.setPointCloud2FieldsByString(1, "xyz");
+  modifier.resize(width * height);
+
+  sensor_msgs::PointCloud2Iterator<float> x(cloud, "x"), y(cloud, "y"), z(cloud, "z");
+  for (unsigned int i = 0 ; i < width * height ; ++i, ++x, ++y, ++z)
+  {
+    Eigen::Vector3d p(randomReal(-0.8, 0.8), randomReal(-0.8, 0.8), randomReal(0.7, 2.3));
+    if (i % 2 == 0)
+    {
+      // move the point to the surface of a body, along the ray from the body center, then perturb it slightly
+      const TestBody &b = bodies[i % bodies.size()];
+      Eigen::Vector3d center = b.pose_.translation();
+      Eigen::Vector3d dir = (p - center).normalized();
+      EigenSTL::vector_Vector3d intersections;
+      if (b.body_->intersectsRay(center + dir * 10.0, -dir, &intersections, 1) && !intersections.empty())
+        p = intersections[0] + dir * randomReal(-1e-6, 1e-6) * (i % 3);
+    }
+    *x = p.x();
+    *y = p.y();
+    *z = p.z();
+  }
+  return cloud;
+}
+
+}
+
+TEST(ShapeMask, MatchesExactContainment)
+{
+  srand(1);
+  for (unsigned int trial = 0 ; trial < 5 ; ++trial)
+  {
+    std::vector<TestBody> bodies = makeBodies(40);
+    ShapeMask mask(boost::bind(&getTransform, _1, _2, &bodies));
+    for (std::size_t i = 0 ; i < bodies.size() ; ++i)
+    {
+      bodies[i].handle_ = mask.addShape(bodies[i].shape_, bodies[i].scale_, bodies[i].padding_);
+      ASSERT_NE(0u, bodies[i].handle_);
+      bodies[i].body_.reset(bodies::createBodyFromShape(bodies[i].shape_.get()));
+      bodies[i].body_->setScale(bodies[i].scale_);
+      bodies[i].body_->setPadding(bodies[i].padding_);
+      bodies[i].body_->setPose(bodies[i].pose_);
+    }
+
+    sensor_msgs::PointCloud2 cloud = makeCloud(bodies, 64, 48);
+    std::vector<int> result;
+    const double min_dist = 0.9, max_dist = 2.2;
+    mask.maskContainment(cloud, Eigen::Vector3d::Zero(), min_dist, max_dist, result);
+    ASSERT_EQ(cloud.width * cloud.height, result.size());
+
+    // the mask is exactly what testing every body gives
+    std::size_t inside = 0;
+    sensor_msgs::PointCloud2ConstIterator<float> x(cloud, "x"), y(cloud, "y"), z(cloud, "z");
+    for (std::size_t i = 0 ; i < result.size() ; ++i, ++x, ++y, ++z)
+    {
+      Eigen::Vector3d p(*x, *y, *z);
+      int expected = ShapeMask::OUTSIDE;
+      double d = p.norm();
+      if (d < min_dist || d > max_dist)
+        expected = ShapeMask::CLIP;
+      else
+        for (std::size_t j = 0 ; j < bodies.size() && expected == ShapeMask::OUTSIDE ; ++j)
+          if (bodies[j].body_->containsPoint(p))
+            expected = ShapeMask::INSIDE;
+      EXPECT_EQ(expected, result[i]) << "point " << i;
+      if (expected == ShapeMask::INSIDE)
+        inside++;
+    }
+    EXPECT_GT(inside, 0u);
+  }
+}
+
+TEST(ShapeMask, NoShapes)
+{
+  ShapeMask mask;
+  std::vector<TestBody> bodies;
+  sensor_msgs::PointCloud2 cloud;
+  cloud.width = 4;
+  cloud.height = 1;
+  sensor_msgs::PointCloud2Modifier modifier(cloud);
+  modifier.setPointCloud2FieldsByString(1, "xyz");
+  modifier.resize(4);
+  std::vector<int> result;
+  mask.maskContainment(cloud, Eigen::Vector3d::Zero(), 0.0, 10.0, result);
+  ASSERT_EQ(4u, result.size());
+  for (std::size_t i = 0 ; i < result.size() ; ++i)
+    EXPECT_EQ(ShapeMask::OUTSIDE, result[i]);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
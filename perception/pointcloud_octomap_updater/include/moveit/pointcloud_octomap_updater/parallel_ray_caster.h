@@ -0,0 +1,89 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_PERCEPTION_POINTCLOUD_OCTOMAP_UPDATER_PARALLEL_RAY_CASTER_
+#define MOVEIT_PERCEPTION_POINTCLOUD_OCTOMAP_UPDATER_PARALLEL_RAY_CASTER_
+
+#include <octomap/octomap.h>
+#include <boost/cstdint.hpp>
+#include <vector>
+
+namespace occupancy_map_monitor
+{
+
+/** \brief Computes the cells traversed by a set of rays that share an origin, splitting the rays among threads.
+ *  Each thread collects the cells of its rays in a local array; the arrays are then sorted and merged,
+ *  which is considerably cheaper than inserting every cell of every ray in a hash set. */
+class ParallelRayCaster
+{
+public:
+
+  /** \brief Use \e threads threads; 0 means the default number of OpenMP threads */
+  ParallelRayCaster(unsigned int threads = 0);
+
+  void setThreadCount(unsigned int threads);
+
+  /** \brief The number of threads actually used */
+  unsigned int getThreadCount() const;
+
+  /** \brief Compute the keys of the cells traversed by the rays from \e origin to the centers of the \e endpoints cells
+   *  (the end cells are not included, as for octomap::OcTree::computeRayKeys()). The result is free of duplicates and
+   *  sorted by packKey(), so it does not depend on the number of threads. The tree needs to be locked for reading. */
+  void computeRayKeys(const octomap::OcTree &tree, const octomap::point3d &origin,
+                      const std::vector<octomap::OcTreeKey> &endpoints, std::vector<octomap::OcTreeKey> &keys);
+
+  static boost::uint64_t packKey(const octomap::OcTreeKey &key)
+  {
+    return ((boost::uint64_t)key[0] << 32) | ((boost::uint64_t)key[1] << 16) | (boost::uint64_t)key[2];
+  }
+
+  static octomap::OcTreeKey unpackKey(boost::uint64_t packed)
+  {
+    return octomap::OcTreeKey((octomap::key_type)(packed >> 32), (octomap::key_type)(packed >> 16), (octomap::key_type)packed);
+  }
+
+private:
+
+  unsigned int threads_;
+
+  // per thread storage, kept between calls to avoid allocations
+  std::vector<std::vector<boost::uint64_t> > thread_keys_;
+  std::vector<octomap::KeyRay> thread_rays_;
+  std::vector<boost::uint64_t> merged_;
+  std::vector<boost::uint64_t> merge_buffer_;
+};
+
+}
+
+#endif
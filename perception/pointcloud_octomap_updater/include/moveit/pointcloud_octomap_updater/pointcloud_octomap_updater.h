@@ -44,6 +44,7 @@
 #include <sensor_msgs/PointCloud2.h>
 #include <moveit/occupancy_map_monitor/occupancy_map_updater.h>
 #include <moveit/point_containment_filter/shape_mask.h>
+#include <moveit/pointcloud_octomap_updater/parallel_ray_caster.h>
 
 namespace occupancy_map_monitor
 {
@@ -89,9 +90,12 @@ private:
   message_filters::Subscriber<sensor_msgs::PointCloud2> *point_cloud_subscriber_;
   tf::MessageFilter<sensor_msgs::PointCloud2> *point_cloud_filter_;
 
-  /* used to store all cells in the map which a given ray passes through during raycasting.
-     we cache this here because it dynamically pre-allocates a lot of memory in its contsructor */
-  octomap::KeyRay key_ray_;
+  /* casts the rays of a cloud in parallel; the endpoints of the rays and the cells they pass through are
+     kept between clouds to avoid reallocating them */
+  ParallelRayCaster ray_caster_;
+  std::vector<octomap::OcTreeKey> ray_endpoints_;
+  std::vector<octomap::OcTreeKey> free_cells_;
+  std::vector<OccMapTree::NodeUpdate> node_updates_;
 
   boost::scoped_ptr<point_containment_filter::ShapeMask> shape_mask_;
   std::vector<int> mask_;
@@ -0,0 +1,111 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/pointcloud_octomap_updater/parallel_ray_caster.h>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace occupancy_map_monitor
+{
+
+ParallelRayCaster::ParallelRayCaster(unsigned int threads)
+{
+  setThreadCount(threads);
+}
+
+void ParallelRayCaster::setThreadCount(unsigned int threads)
+{
+#ifdef _OPENMP
+  threads_ = threads > 0 ? threads : std::max(1, omp_get_max_threads());
+#else
+  threads_ = 1;
+#endif
+  thread_keys_.resize(threads_);
+  thread_rays_.resize(threads_);
+}
+
+unsigned int ParallelRayCaster::getThreadCount() const
+{
+  return threads_;
+}
+
+void ParallelRayCaster::computeRayKeys(const octomap::OcTree &tree, const octomap::point3d &origin,
+                                       const std::vector<octomap::OcTreeKey> &endpoints, std::vector<octomap::OcTreeKey> &keys)
+{
+  const long n = endpoints.size();
+  const int threads = std::max(1, (int)std::min((long)threads_, n));
+
+  // OpenMP may provide fewer threads than requested, so clear all the arrays that are merged below
+  for (int t = 0 ; t < threads ; ++t)
+    thread_keys_[t].clear();
+
+  // computeRayKeys() only reads the tree, so the rays can be cast concurrently
+#pragma omp parallel num_threads(threads)
+  {
+#ifdef _OPENMP
+    const int t = omp_get_thread_num();
+#else
+    const int t = 0;
+#endif
+    std::vector<boost::uint64_t> &local = thread_keys_[t];
+    octomap::KeyRay &ray = thread_rays_[t];
+
+#pragma omp for schedule(dynamic, 256)
+    for (long i = 0 ; i < n ; ++i)
+      if (tree.computeRayKeys(origin, tree.keyToCoord(endpoints[i]), ray))
+        for (octomap::KeyRay::iterator it = ray.begin(), end = ray.end() ; it != end ; ++it)
+          local.push_back(packKey(*it));
+
+    std::sort(local.begin(), local.end());
+    local.erase(std::unique(local.begin(), local.end()), local.end());
+  }
+
+  // the per thread arrays are sorted, so merging them is linear
+  merged_.clear();
+  for (int t = 0 ; t < threads ; ++t)
+  {
+    merge_buffer_.resize(merged_.size() + thread_keys_[t].size());
+    std::merge(merged_.begin(), merged_.end(), thread_keys_[t].begin(), thread_keys_[t].end(), merge_buffer_.begin());
+    merged_.swap(merge_buffer_);
+  }
+  merged_.erase(std::unique(merged_.begin(), merged_.end()), merged_.end());
+
+  keys.resize(merged_.size());
+  for (std::size_t i = 0 ; i < merged_.size() ; ++i)
+    keys[i] = unpackKey(merged_[i]);
+}
+
+}
@@ -72,6 +72,9 @@ bool PointCloudOctomapUpdater::setParams(XmlRpc::XmlRpcValue &params)
     readXmlParam(params, "padding_offset", &padding_);
     readXmlParam(params, "padding_scale", &scale_);
     readXmlParam(params, "point_subsample", &point_subsample_);
+    unsigned int ray_casting_threads = 0;
+    readXmlParam(params, "ray_casting_threads", &ray_casting_threads);
+    ray_caster_.setThreadCount(ray_casting_threads);
     if (params.hasMember("filtered_cloud_topic"))
       filtered_cloud_topic_ = static_cast<const std::string&>(params["filtered_cloud_topic"]);
   }
@@ -144,13 +147,13 @@ void PointCloudOctomapUpdater::forgetShape(ShapeHandle handle)
 
 bool PointCloudOctomapUpdater::getShapeTransform(ShapeHandle h, Eigen::Affine3d &transform) const
 {
-  ShapeTransformCache::const_iterator it = transform_cache_.find(h);
-  if (it == transform_cache_.end())
+  const Eigen::Affine3d *t = transform_cache_.get(h);
+  if (!t)
   {
     ROS_ERROR("Internal error. Shape filter handle %u not found", h);
     return false;
   }
-  transform = it->second;
+  transform = *t;
   return true;
 }
 
@@ -203,7 +206,7 @@ void PointCloudOctomapUpdater::cloudMsgCallback(const sensor_msgs::PointCloud2::
   shape_mask_->maskContainment(*cloud_msg, sensor_origin_eigen, 0.0, max_range_, mask_);
   updateMask(*cloud_msg, sensor_origin_eigen, mask_);
 
-  octomap::KeySet free_cells, occupied_cells, model_cells, clip_cells;
+  octomap::KeySet occupied_cells, model_cells, clip_cells;
   boost::scoped_ptr<sensor_msgs::PointCloud2> filtered_cloud;
 
   //We only use these iterators if we are creating a filtered_cloud for
@@ -278,20 +281,12 @@ void PointCloudOctomapUpdater::cloudMsgCallback(const sensor_msgs::PointCloud2::
       }
     }
 
-    /* compute the free cells along each ray that ends at an occupied cell */
-    for (octomap::KeySet::iterator it = occupied_cells.begin(), end = occupied_cells.end(); it != end; ++it)
-      if (tree_->computeRayKeys(sensor_origin, tree_->keyToCoord(*it), key_ray_))
-        free_cells.insert(key_ray_.begin(), key_ray_.end());
-
-    /* compute the free cells along each ray that ends at a model cell */
-    for (octomap::KeySet::iterator it = model_cells.begin(), end = model_cells.end(); it != end; ++it)
-      if (tree_->computeRayKeys(sensor_origin, tree_->keyToCoord(*it), key_ray_))
-        free_cells.insert(key_ray_.begin(), key_ray_.end());
-
-    /* compute the free cells along each ray that ends at a clipped cell */
-    for (octomap::KeySet::iterator it = clip_cells.begin(), end = clip_cells.end(); it != end; ++it)
-      if (tree_->computeRayKeys(sensor_origin, tree_->keyToCoord(*it), key_ray_))
-        free_cells.insert(key_ray_.begin(), key_ray_.end());
+    /* compute the free cells along each ray that ends at an occupied, model or clipped cell */
+    ray_endpoints_.clear();
+    ray_endpoints_.insert(ray_endpoints_.end(), occupied_cells.begin(), occupied_cells.end());
+    ray_endpoints_.insert(ray_endpoints_.end(), model_cells.begin(), model_cells.end());
+    ray_endpoints_.insert(ray_endpoints_.end(), clip_cells.begin(), clip_cells.end());
+    ray_caster_.computeRayKeys(*tree_, sensor_origin, ray_endpoints_, free_cells_);
   }
   catch (...)
   {
@@ -306,31 +301,31 @@ void PointCloudOctomapUpdater::cloudMsgCallback(const sensor_msgs::PointCloud2::
     occupied_cells.erase(*it);
 
   /* occupied cells are not free */
+  std::size_t free_count = 0;
+  for (std::size_t i = 0 ; i < free_cells_.size() ; ++i)
+    if (occupied_cells.find(free_cells_[i]) == occupied_cells.end())
+      free_cells_[free_count++] = free_cells_[i];
+  free_cells_.resize(free_count);
+
+  /* mark free cells only if not seen occupied in this cloud, then all occupied cells, and set the logodds
+     to the minimum for the cells that are part of the model; only the parts of the tree they are in are locked */
+  const float lg = tree_->getClampingThresMinLog() - tree_->getClampingThresMaxLog();
+  node_updates_.clear();
+  for (std::vector<octomap::OcTreeKey>::const_iterator it = free_cells_.begin(), end = free_cells_.end(); it != end; ++it)
+    node_updates_.push_back(OccMapTree::NodeUpdate(*it, tree_->getProbMissLog()));
   for (octomap::KeySet::iterator it = occupied_cells.begin(), end = occupied_cells.end(); it != end; ++it)
-    free_cells.erase(*it);
-
-  tree_->lockWrite();
+    node_updates_.push_back(OccMapTree::NodeUpdate(*it, tree_->getProbHitLog()));
+  for (octomap::KeySet::iterator it = model_cells.begin(), end = model_cells.end(); it != end; ++it)
+    node_updates_.push_back(OccMapTree::NodeUpdate(*it, lg));
 
   try
   {
-    /* mark free cells only if not seen occupied in this cloud */
-    for (octomap::KeySet::iterator it = free_cells.begin(), end = free_cells.end(); it != end; ++it)
-      tree_->updateNode(*it, false);
-
-    /* now mark all occupied cells */
-    for (octomap::KeySet::iterator it = occupied_cells.begin(), end = occupied_cells.end(); it != end; ++it)
-      tree_->updateNode(*it, true);
-
-    // set the logodds to the minimum for the cells that are part of the model
-    const float lg = tree_->getClampingThresMinLog() - tree_->getClampingThresMaxLog();
-    for (octomap::KeySet::iterator it = model_cells.begin(), end = model_cells.end(); it != end; ++it)
-      tree_->updateNode(*it, lg);
+    tree_->updateNodes(node_updates_);
   }
   catch (...)
   {
     ROS_ERROR("Internal error while updating octree");
   }
-  tree_->unlockWrite();
   ROS_DEBUG("Processed point cloud in %lf ms", (ros::WallTime::now() - start).toSec() * 1000.0);
   tree_->triggerUpdateCallback();
 
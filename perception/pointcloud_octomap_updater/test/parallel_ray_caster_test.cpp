@@ -0,0 +1,123 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <moveit/pointcloud_octomap_updater/parallel_ray_caster.h>
+#include <cstdlib>
+
+using namespace occupancy_map_monitor;
+
+namespace
+{
+
+// endpoints spread in a box around the origin, from a fixed seed so the test is deterministic
+std::vector<octomap::OcTreeKey> makeEndpoints(const octomap::OcTree &tree, unsigned int count)
+{
+  srand(42);
+  std::vector<octomap::OcTreeKey> endpoints;
+  for (unsigned int i = 0 ; i < count ; ++i)
+  {
+    octomap::point3d p(6.0 * rand() / RAND_MAX - 3.0, 6.0 * rand() / RAND_MAX - 3.0, 3.0 * rand() / RAND_MAX);
+    endpoints.push_back(tree.coordToKey(p));
+  }
+  return endpoints;
+}
+
+}
+
+TEST(ParallelRayCaster, PackKey)
+{
+  octomap::OcTreeKey key(1, 65535, 32768);
+  octomap::OcTreeKey unpacked = ParallelRayCaster::unpackKey(ParallelRayCaster::packKey(key));
+  EXPECT_TRUE(key == unpacked);
+}
+
+TEST(ParallelRayCaster, MatchesSerialRayCasting)
+{
+  octomap::OcTree tree(0.02);
+  const octomap::point3d origin(0.1, 0.2, 0.3);
+  std::vector<octomap::OcTreeKey> endpoints = makeEndpoints(tree, 5000);
+
+  // the cells found by casting each ray serially, as the updater used to do
+  octomap::KeySet expected;
+  octomap::KeyRay ray;
+  for (std::size_t i = 0 ; i < endpoints.size() ; ++i)
+    if (tree.computeRayKeys(origin, tree.keyToCoord(endpoints[i]), ray))
+      expected.insert(ray.begin(), ray.end());
+  ASSERT_FALSE(expected.empty());
+
+  std::vector<octomap::OcTreeKey> first;
+  unsigned int thread_counts[] = { 1, 2, 3, 8 };
+  for (std::size_t k = 0 ; k < sizeof(thread_counts) / sizeof(thread_counts[0]) ; ++k)
+  {
+    ParallelRayCaster caster(thread_counts[k]);
+    std::vector<octomap::OcTreeKey> keys;
+    caster.computeRayKeys(tree, origin, endpoints, keys);
+
+    // same set of cells, no duplicates, sorted
+    ASSERT_EQ(expected.size(), keys.size());
+    for (std::size_t i = 0 ; i < keys.size() ; ++i)
+    {
+      EXPECT_TRUE(expected.find(keys[i]) != expected.end());
+      if (i > 0)
+        EXPECT_LT(ParallelRayCaster::packKey(keys[i - 1]), ParallelRayCaster::packKey(keys[i]));
+    }
+
+    // the result does not depend on the number of threads
+    if (k == 0)
+      first = keys;
+    else
+      EXPECT_TRUE(first == keys);
+
+    // nor on data left from a previous call
+    std::vector<octomap::OcTreeKey> again;
+    caster.computeRayKeys(tree, origin, endpoints, again);
+    EXPECT_TRUE(keys == again);
+  }
+}
+
+TEST(ParallelRayCaster, NoEndpoints)
+{
+  octomap::OcTree tree(0.02);
+  ParallelRayCaster caster(4);
+  std::vector<octomap::OcTreeKey> keys(3);
+  caster.computeRayKeys(tree, octomap::point3d(0, 0, 0), std::vector<octomap::OcTreeKey>(), keys);
+  EXPECT_TRUE(keys.empty());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,203 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2011, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#ifndef MOVEIT_IK_RESTART_SEARCH_RESTART_SEARCH_
+#define MOVEIT_IK_RESTART_SEARCH_RESTART_SEARCH_
+
+#include <kdl/jntarray.hpp>
+#include <random_numbers/random_numbers.h>
+#include <ros/time.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/asio/io_service.hpp>
+#include <vector>
+#include <string>
+
+namespace ik_restart_search
+{
+
+/** \brief How the configurations an IK search restarts from are chosen */
+enum SeedingStrategy
+{
+  /** \brief Uniformly at random within the joint limits */
+  UNIFORM,
+  /** \brief Normally distributed around the seed state, clamped to the joint limits */
+  GAUSSIAN,
+  /** \brief Points of a Halton sequence, which cover the joint space more evenly than random samples */
+  HALTON
+};
+
+/** \brief Parse the name of a seeding strategy ("uniform", "gaussian" or "halton"). Return false if the name is not known. */
+bool parseSeedingStrategy(const std::string &name, SeedingStrategy &strategy);
+
+/** \brief The region restart configurations are taken from */
+struct RestartBounds
+{
+  /** \brief The joint limits */
+  KDL::JntArray min_, max_;
+
+  /** \brief If not empty, restart configurations are also within these distances of the seed state */
+  std::vector<double> consistency_limits_;
+
+  /** \brief Joints that keep the value of the seed state in every restart configuration */
+  std::vector<bool> locked_;
+};
+
+/** \brief Generates the restart configurations of one search.
+    Seeders of the concurrent searches of a parallel search take interleaved points of the Halton sequence. */
+class RestartSeeder
+{
+public:
+
+  RestartSeeder(SeedingStrategy strategy, double gaussian_stddev, const RestartBounds &bounds, const KDL::JntArray &seed,
+                unsigned int index = 0, unsigned int stride = 1);
+
+  /** \brief Fill \e configuration with the next restart configuration */
+  void next(random_numbers::RandomNumberGenerator &rng, KDL::JntArray &configuration);
+
+private:
+
+  SeedingStrategy strategy_;
+  double gaussian_stddev_;
+  const RestartBounds &bounds_;
+  const KDL::JntArray &seed_;
+
+  /** \brief The box configurations are taken from: the joint limits, intersected with the consistency limits if there are any */
+  std::vector<double> low_, high_;
+
+  unsigned int halton_index_;
+  unsigned int halton_stride_;
+};
+
+/** \brief The part of a restart search that depends on the IK solver */
+class RestartProblem
+{
+public:
+
+  virtual ~RestartProblem()
+  {
+  }
+
+  /** \brief Run the solver once from \e start. The attempts of one search (\e worker) are never made concurrently,
+      and searches with different indices run concurrently. Return true if \e result is a candidate solution. */
+  virtual bool attempt(unsigned int worker, const KDL::JntArray &start, KDL::JntArray &result) = 0;
+
+  /** \brief Decide whether a candidate is a solution, e.g. by calling the solution callback. Calls are serialized,
+      and there are none after a candidate was accepted. */
+  virtual bool accept(const KDL::JntArray &candidate) = 0;
+
+  /** \brief Get the random number generator of a search */
+  virtual random_numbers::RandomNumberGenerator& getRandomNumberGenerator(unsigned int worker) = 0;
+};
+
+/** \brief Counters of one call to RestartSearch::search() */
+struct RestartStatistics
+{
+  RestartStatistics() : attempts(0), solutions(0)
+  {
+  }
+
+  unsigned int attempts;
+  unsigned int solutions;
+};
+
+/** \brief A random-restart IK search: the solver is run from the seed state first, then from restart configurations,
+    until a solution is accepted or time runs out. Several searches can run concurrently, each restarting on its own;
+    the first one starts at the seed state, the others at restart configurations. */
+class RestartSearch
+{
+public:
+
+  RestartSearch();
+
+  ~RestartSearch();
+
+  /** \brief Set the number of concurrent searches; the calling thread runs one of them. Must not be called while a search is running.
+      \param return_best If false, the first accepted solution is returned and the other searches stop.
+      If true, the other searches finish their current attempt once a candidate is found, and the candidates are then
+      accepted in the order of their distance to the seed until one is. */
+  void setThreads(unsigned int threads, bool return_best = false);
+
+  unsigned int getThreads() const
+  {
+    return threads_;
+  }
+
+  bool getReturnBest() const
+  {
+    return return_best_;
+  }
+
+  /** \brief Set how restart configurations are chosen; \e gaussian_stddev is the standard deviation of the GAUSSIAN strategy */
+  void setSeeding(SeedingStrategy strategy, double gaussian_stddev = 0.3);
+
+  SeedingStrategy getSeedingStrategy() const
+  {
+    return strategy_;
+  }
+
+  /** \brief Run a search from \e seed. Return true and fill \e solution if a solution was accepted before \e timeout
+      seconds passed since \e start_time. This can be called concurrently: the concurrent searches of one call use
+      the threads of this object, so while they are in use other calls do not wait for them and search in the calling
+      thread only. */
+  bool search(RestartProblem &problem, const KDL::JntArray &seed, const RestartBounds &bounds,
+              const ros::WallTime &start_time, double timeout, KDL::JntArray &solution,
+              RestartStatistics *statistics = NULL) const;
+
+private:
+
+  struct Search;
+
+  void run(Search *search, unsigned int worker) const;
+
+  void stopThreads();
+
+  unsigned int threads_;
+  bool return_best_;
+  SeedingStrategy strategy_;
+  double gaussian_stddev_;
+
+  /** The threads running the additional searches of a parallel search, and the lock held by the call using them */
+  mutable boost::mutex service_lock_;
+  boost::scoped_ptr<boost::asio::io_service> service_;
+  boost::scoped_ptr<boost::asio::io_service::work> work_;
+  boost::thread_group thread_group_;
+};
+
+}
+
+#endif
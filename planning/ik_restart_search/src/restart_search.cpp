@@ -0,0 +1,350 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2011, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include <moveit/ik_restart_search/restart_search.h>
+#include <ros/console.h>
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <algorithm>
+
+namespace ik_restart_search
+{
+
+namespace
+{
+
+// the i-th prime, used as the base of the Halton sequence of the i-th joint
+unsigned int getPrime(std::size_t i)
+{
+  static const unsigned int PRIMES[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97,
+                                         101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191,
+                                         193, 197, 199, 211, 223, 227, 229 };
+  static const std::size_t COUNT = sizeof(PRIMES) / sizeof(PRIMES[0]);
+  if (i < COUNT)
+    return PRIMES[i];
+  unsigned int candidate = PRIMES[COUNT - 1];
+  for (std::size_t found = COUNT - 1 ; found < i ; )
+  {
+    candidate += 2;
+    bool prime = true;
+    for (unsigned int d = 3 ; d * d <= candidate && prime ; d += 2)
+      prime = candidate % d != 0;
+    if (prime)
+      ++found;
+  }
+  return candidate;
+}
+
+// the radical inverse of index in the given base: its digits mirrored around the decimal point, in [0, 1)
+double radicalInverse(unsigned int index, unsigned int base)
+{
+  double result = 0.0;
+  double digit_value = 1.0 / base;
+  while (index > 0)
+  {
+    result += (index % base) * digit_value;
+    index /= base;
+    digit_value /= base;
+  }
+  return result;
+}
+
+}
+
+bool parseSeedingStrategy(const std::string &name, SeedingStrategy &strategy)
+{
+  if (name == "uniform")
+    strategy = UNIFORM;
+  else if (name == "gaussian")
+    strategy = GAUSSIAN;
+  else if (name == "halton")
+    strategy = HALTON;
+  else
+    return false;
+  return true;
+}
+
+RestartSeeder::RestartSeeder(SeedingStrategy strategy, double gaussian_stddev, const RestartBounds &bounds, const KDL::JntArray &seed,
+                             unsigned int index, unsigned int stride) :
+  strategy_(strategy),
+  gaussian_stddev_(gaussian_stddev),
+  bounds_(bounds),
+  seed_(seed),
+  low_(seed.rows()),
+  high_(seed.rows()),
+  // index 0 of the sequence is the origin of the unit cube, i.e. all joints at their lower limit
+  halton_index_(index + 1),
+  halton_stride_(std::max(stride, 1u))
+{
+  for (unsigned int i = 0 ; i < seed.rows() ; ++i)
+  {
+    low_[i] = bounds.min_(i);
+    high_[i] = bounds.max_(i);
+    if (!bounds.consistency_limits_.empty())
+    {
+      low_[i] = std::max(low_[i], seed(i) - bounds.consistency_limits_[i]);
+      high_[i] = std::min(high_[i], seed(i) + bounds.consistency_limits_[i]);
+    }
+    // a seed outside of the limits still gets restarts near it
+    if (low_[i] > high_[i])
+      low_[i] = high_[i] = std::min(std::max(seed(i), bounds.min_(i)), bounds.max_(i));
+  }
+}
+
+void RestartSeeder::next(random_numbers::RandomNumberGenerator &rng, KDL::JntArray &configuration)
+{
+  for (unsigned int i = 0 ; i < seed_.rows() ; ++i)
+  {
+    if (i < bounds_.locked_.size() && bounds_.locked_[i])
+    {
+      configuration(i) = seed_(i);
+      continue;
+    }
+    switch (strategy_)
+    {
+      case UNIFORM:
+        configuration(i) = rng.uniformReal(low_[i], high_[i]);
+        break;
+      case GAUSSIAN:
+        configuration(i) = std::min(std::max(seed_(i) + gaussian_stddev_ * rng.gaussian01(), low_[i]), high_[i]);
+        break;
+      case HALTON:
+        configuration(i) = low_[i] + radicalInverse(halton_index_, getPrime(i)) * (high_[i] - low_[i]);
+        break;
+    }
+  }
+  halton_index_ += halton_stride_;
+}
+
+// a candidate solution of a search that returns the best one, and its squared distance to the seed
+typedef std::pair<double, KDL::JntArray> Candidate;
+
+struct RestartSearch::Search
+{
+  RestartProblem *problem_;
+  const KDL::JntArray *seed_;
+  const RestartBounds *bounds_;
+  ros::WallTime start_time_;
+  double timeout_;
+  unsigned int workers_;
+
+  // the state of each concurrent search, kept from one round of a search returning the best solution to the next
+  std::vector<boost::shared_ptr<RestartSeeder> > seeders_;
+  std::vector<KDL::JntArray> starts_;
+
+  boost::mutex lock_;
+  boost::condition_variable pending_done_;
+  unsigned int pending_;
+  bool stop_;
+  bool found_;
+  KDL::JntArray best_solution_;
+  std::vector<Candidate> candidates_;
+  RestartStatistics statistics_;
+};
+
+namespace
+{
+
+bool closerToSeed(const Candidate &a, const Candidate &b)
+{
+  return a.first < b.first;
+}
+
+double squaredDistance(const KDL::JntArray &a, const KDL::JntArray &b)
+{
+  double distance = 0.0;
+  for (unsigned int j = 0 ; j < a.rows() ; ++j)
+    distance += (a(j) - b(j)) * (a(j) - b(j));
+  return distance;
+}
+
+}
+
+RestartSearch::RestartSearch() : threads_(1), return_best_(false), strategy_(UNIFORM), gaussian_stddev_(0.3)
+{
+}
+
+RestartSearch::~RestartSearch()
+{
+  stopThreads();
+}
+
+void RestartSearch::setThreads(unsigned int threads, bool return_best)
+{
+  stopThreads();
+  threads_ = std::max(threads, 1u);
+  return_best_ = return_best;
+
+  // the calling thread runs one of the searches itself
+  if (threads_ > 1)
+  {
+    service_.reset(new boost::asio::io_service());
+    work_.reset(new boost::asio::io_service::work(*service_));
+    for (unsigned int i = 1 ; i < threads_ ; ++i)
+      thread_group_.create_thread(boost::bind(&boost::asio::io_service::run, service_.get()));
+  }
+}
+
+void RestartSearch::setSeeding(SeedingStrategy strategy, double gaussian_stddev)
+{
+  strategy_ = strategy;
+  gaussian_stddev_ = gaussian_stddev;
+}
+
+void RestartSearch::stopThreads()
+{
+  work_.reset();
+  thread_group_.join_all();
+  service_.reset();
+}
+
+bool RestartSearch::search(RestartProblem &problem, const KDL::JntArray &seed, const RestartBounds &bounds,
+                           const ros::WallTime &start_time, double timeout, KDL::JntArray &solution,
+                           RestartStatistics *statistics) const
+{
+  // queueing behind another call would leave this one without time to search, so it runs in the calling thread instead
+  boost::unique_lock<boost::mutex> service_lock(service_lock_, boost::try_to_lock);
+
+  Search search;
+  search.problem_ = &problem;
+  search.seed_ = &seed;
+  search.bounds_ = &bounds;
+  search.start_time_ = start_time;
+  search.timeout_ = timeout;
+  search.workers_ = service_lock.owns_lock() ? threads_ : 1;
+  search.found_ = false;
+
+  // the searches other than the first one skip the seed state and take interleaved points of the Halton sequence
+  for (unsigned int i = 0 ; i < search.workers_ ; ++i)
+  {
+    search.seeders_.push_back(boost::shared_ptr<RestartSeeder>(new RestartSeeder(strategy_, gaussian_stddev_, bounds, seed, i > 0 ? i - 1 : 0,
+                                                                                 std::max(search.workers_ - 1, 1u))));
+    search.starts_.push_back(seed);
+    if (i > 0)
+      search.seeders_[i]->next(problem.getRandomNumberGenerator(i), search.starts_[i]);
+  }
+
+  do
+  {
+    search.pending_ = search.workers_ - 1;
+    search.stop_ = false;
+    for (unsigned int i = 1 ; i < search.workers_ ; ++i)
+      service_->post(boost::bind(&RestartSearch::run, this, &search, i));
+    run(&search, 0);
+
+    // the other searches refer to this stack frame, so wait for all of them
+    {
+      boost::mutex::scoped_lock slock(search.lock_);
+      while (search.pending_ > 0)
+        search.pending_done_.wait(slock);
+    }
+
+    // the candidates found by the searches of this round, closest to the seed first, until one is accepted
+    std::sort(search.candidates_.begin(), search.candidates_.end(), closerToSeed);
+    for (std::size_t i = 0 ; i < search.candidates_.size() && !search.found_ ; ++i)
+      if (problem.accept(search.candidates_[i].second))
+      {
+        search.best_solution_ = search.candidates_[i].second;
+        search.found_ = true;
+      }
+    search.candidates_.clear();
+  }
+  while (return_best_ && !search.found_ && (ros::WallTime::now() - start_time).toSec() < timeout);
+
+  if (statistics)
+    *statistics = search.statistics_;
+  if (!search.found_)
+    return false;
+  solution = search.best_solution_;
+  return true;
+}
+
+void RestartSearch::run(Search *search, unsigned int worker) const
+{
+  const KDL::JntArray &seed = *search->seed_;
+  random_numbers::RandomNumberGenerator &rng = search->problem_->getRandomNumberGenerator(worker);
+  RestartSeeder &seeder = *search->seeders_[worker];
+  KDL::JntArray &start = search->starts_[worker];
+  KDL::JntArray result(seed.rows());
+
+  unsigned int attempts = 0;
+  while ((ros::WallTime::now() - search->start_time_).toSec() < search->timeout_)
+  {
+    if (search->workers_ > 1)
+    {
+      boost::mutex::scoped_lock slock(search->lock_);
+      if (search->stop_)
+        break;
+    }
+
+    ++attempts;
+    bool valid = search->problem_->attempt(worker, start, result);
+    seeder.next(rng, start);
+    if (!valid)
+      continue;
+
+    boost::mutex::scoped_lock slock(search->lock_);
+    if (return_best_)
+    {
+      // the other searches finish their current attempt, and the candidates are accepted by the calling thread
+      search->statistics_.solutions++;
+      search->candidates_.push_back(Candidate(squaredDistance(result, seed), result));
+      search->stop_ = true;
+      ROS_DEBUG_NAMED("ik_restart_search", "Search %u found a candidate after %u attempts", worker, attempts);
+      break;
+    }
+
+    // the problem is called under the lock, so solution callbacks are never called concurrently
+    if (search->stop_)
+      break;
+    search->statistics_.solutions++;
+    if (!search->problem_->accept(result))
+      continue;
+
+    search->best_solution_ = result;
+    search->found_ = true;
+    search->stop_ = true;
+    ROS_DEBUG_NAMED("ik_restart_search", "Search %u found a solution after %u attempts", worker, attempts);
+    break;
+  }
+
+  boost::mutex::scoped_lock slock(search->lock_);
+  search->statistics_.attempts += attempts;
+  if (worker > 0 && --search->pending_ == 0)
+    search->pending_done_.notify_all();
+}
+
+}
@@ -0,0 +1,294 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2011, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include <gtest/gtest.h>
+#include <moveit/ik_restart_search/restart_search.h>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <cmath>
+
+using namespace ik_restart_search;
+
+namespace
+{
+
+RestartBounds makeBounds(unsigned int dimension)
+{
+  RestartBounds bounds;
+  bounds.min_.resize(dimension);
+  bounds.max_.resize(dimension);
+  for (unsigned int i = 0 ; i < dimension ; ++i)
+  {
+    bounds.min_(i) = -1.0;
+    bounds.max_(i) = 2.0;
+  }
+  return bounds;
+}
+
+/** An "IK solver" that only converges from starts whose first joint is above a threshold */
+class ThresholdProblem : public RestartProblem
+{
+public:
+
+  ThresholdProblem(unsigned int workers, double threshold, unsigned int reject = 0) :
+    rngs_(new random_numbers::RandomNumberGenerator[workers]),
+    attempts_(workers, 0),
+    threshold_(threshold),
+    reject_(reject),
+    accepted_(0)
+  {
+  }
+
+  virtual bool attempt(unsigned int worker, const KDL::JntArray &start, KDL::JntArray &result)
+  {
+    attempts_[worker]++;
+    result = start;
+    return start(0) > threshold_;
+  }
+
+  virtual bool accept(const KDL::JntArray &)
+  {
+    // the first candidates are rejected, as a collision checking callback would
+    if (reject_ > 0)
+    {
+      reject_--;
+      return false;
+    }
+    accepted_++;
+    return true;
+  }
+
+  virtual random_numbers::RandomNumberGenerator& getRandomNumberGenerator(unsigned int worker)
+  {
+    return rngs_[worker];
+  }
+
+  boost::scoped_array<random_numbers::RandomNumberGenerator> rngs_;
+  std::vector<unsigned int> attempts_;
+  double threshold_;
+  unsigned int reject_;
+  unsigned int accepted_;
+};
+
+void runSearch(const RestartSearch *search, bool *found, unsigned int *attempts)
+{
+  RestartBounds bounds = makeBounds(2);
+  KDL::JntArray seed(2);
+  KDL::JntArray solution(2);
+  ThresholdProblem problem(search->getThreads(), 1.9, 1);
+  RestartStatistics statistics;
+  *found = search->search(problem, seed, bounds, ros::WallTime::now(), 5.0, solution, &statistics) && solution(0) > 1.9 &&
+    problem.accepted_ == 1;
+  *attempts = statistics.attempts;
+}
+
+}
+
+TEST(RestartSearch, ParseSeedingStrategy)
+{
+  SeedingStrategy strategy = UNIFORM;
+  EXPECT_TRUE(parseSeedingStrategy("halton", strategy));
+  EXPECT_EQ(HALTON, strategy);
+  EXPECT_TRUE(parseSeedingStrategy("gaussian", strategy));
+  EXPECT_EQ(GAUSSIAN, strategy);
+  EXPECT_TRUE(parseSeedingStrategy("uniform", strategy));
+  EXPECT_EQ(UNIFORM, strategy);
+  EXPECT_FALSE(parseSeedingStrategy("sobol", strategy));
+  EXPECT_EQ(UNIFORM, strategy);
+}
+
+TEST(RestartSearch, SeederBounds)
+{
+  RestartBounds bounds = makeBounds(3);
+  bounds.consistency_limits_.resize(3, 0.5);
+  bounds.locked_.resize(3, false);
+  bounds.locked_[2] = true;
+  KDL::JntArray seed(3);
+  seed(0) = 1.8;
+  seed(1) = 0.0;
+  seed(2) = 5.0;
+
+  random_numbers::RandomNumberGenerator rng;
+  const SeedingStrategy strategies[] = { UNIFORM, GAUSSIAN, HALTON };
+  for (std::size_t s = 0 ; s < 3 ; ++s)
+  {
+    RestartSeeder seeder(strategies[s], 1.0, bounds, seed);
+    KDL::JntArray configuration(3);
+    for (int i = 0 ; i < 200 ; ++i)
+    {
+      seeder.next(rng, configuration);
+      // joint limits intersected with the consistency limits
+      EXPECT_GE(configuration(0), 1.3);
+      EXPECT_LE(configuration(0), 2.0);
+      EXPECT_GE(configuration(1), -0.5);
+      EXPECT_LE(configuration(1), 0.5);
+      // locked joints keep the seed value, even outside of the limits
+      EXPECT_EQ(5.0, configuration(2));
+    }
+  }
+}
+
+TEST(RestartSearch, HaltonCoverage)
+{
+  RestartBounds bounds = makeBounds(2);
+  KDL::JntArray seed(2);
+  random_numbers::RandomNumberGenerator rng;
+
+  // the first 16 points of the Halton sequence leave at most two cells of a 4x4 grid empty,
+  // 16 uniform samples typically leave five or more
+  RestartSeeder seeder(HALTON, 0.0, bounds, seed);
+  std::vector<int> cells(16, 0);
+  KDL::JntArray configuration(2);
+  for (int i = 0 ; i < 16 ; ++i)
+  {
+    seeder.next(rng, configuration);
+    int x = std::min(3, static_cast<int>((configuration(0) + 1.0) / 3.0 * 4.0));
+    int y = std::min(3, static_cast<int>((configuration(1) + 1.0) / 3.0 * 4.0));
+    cells[x * 4 + y]++;
+  }
+  int empty = 0;
+  for (std::size_t i = 0 ; i < cells.size() ; ++i)
+    if (cells[i] == 0)
+      empty++;
+  EXPECT_LE(empty, 2);
+
+  // interleaved seeders take the points of one sequence between them
+  RestartSeeder single(HALTON, 0.0, bounds, seed);
+  RestartSeeder first(HALTON, 0.0, bounds, seed, 0, 2);
+  RestartSeeder second(HALTON, 0.0, bounds, seed, 1, 2);
+  KDL::JntArray expected(2);
+  for (int i = 0 ; i < 10 ; ++i)
+  {
+    single.next(rng, expected);
+    (i % 2 == 0 ? first : second).next(rng, configuration);
+    EXPECT_DOUBLE_EQ(expected(0), configuration(0));
+    EXPECT_DOUBLE_EQ(expected(1), configuration(1));
+  }
+}
+
+TEST(RestartSearch, Sequential)
+{
+  RestartBounds bounds = makeBounds(2);
+  KDL::JntArray seed(2);
+  KDL::JntArray solution(2);
+  const SeedingStrategy strategies[] = { UNIFORM, GAUSSIAN, HALTON };
+  for (std::size_t s = 0 ; s < 3 ; ++s)
+  {
+    RestartSearch search;
+    search.setSeeding(strategies[s], 1.0);
+    ThresholdProblem problem(1, 1.0, 2);
+    RestartStatistics statistics;
+    ASSERT_TRUE(search.search(problem, seed, bounds, ros::WallTime::now(), 5.0, solution, &statistics));
+    EXPECT_GT(solution(0), 1.0);
+    EXPECT_EQ(1u, problem.accepted_);
+    EXPECT_EQ(3u, statistics.solutions);
+    EXPECT_EQ(problem.attempts_[0], statistics.attempts);
+    // the seed itself is tried first
+    EXPECT_GT(statistics.attempts, 1u);
+  }
+
+  // the seed is a solution
+  RestartSearch search;
+  seed(0) = 1.5;
+  ThresholdProblem problem(1, 1.0);
+  ASSERT_TRUE(search.search(problem, seed, bounds, ros::WallTime::now(), 5.0, solution));
+  EXPECT_EQ(1u, problem.attempts_[0]);
+  EXPECT_DOUBLE_EQ(1.5, solution(0));
+
+  // no solution in the limits
+  ThresholdProblem unsolvable(1, 3.0);
+  EXPECT_FALSE(search.search(unsolvable, seed, bounds, ros::WallTime::now(), 0.05, solution));
+  EXPECT_EQ(0u, unsolvable.accepted_);
+}
+
+TEST(RestartSearch, Parallel)
+{
+  RestartBounds bounds = makeBounds(2);
+  KDL::JntArray seed(2);
+  KDL::JntArray solution(2);
+  for (int return_best = 0 ; return_best < 2 ; ++return_best)
+  {
+    RestartSearch search;
+    search.setThreads(4, return_best);
+    search.setSeeding(HALTON);
+    EXPECT_EQ(4u, search.getThreads());
+    for (int i = 0 ; i < 10 ; ++i)
+    {
+      ThresholdProblem problem(4, 1.0, 1);
+      RestartStatistics statistics;
+      ASSERT_TRUE(search.search(problem, seed, bounds, ros::WallTime::now(), 5.0, solution, &statistics));
+      EXPECT_GT(solution(0), 1.0);
+      // nothing is accepted after the first accepted solution
+      EXPECT_EQ(1u, problem.accepted_);
+      unsigned int attempts = 0;
+      for (std::size_t j = 0 ; j < problem.attempts_.size() ; ++j)
+        attempts += problem.attempts_[j];
+      EXPECT_EQ(attempts, statistics.attempts);
+    }
+
+    ThresholdProblem unsolvable(4, 3.0);
+    EXPECT_FALSE(search.search(unsolvable, seed, bounds, ros::WallTime::now(), 0.05, solution));
+  }
+}
+
+TEST(RestartSearch, Concurrent)
+{
+  for (int return_best = 0 ; return_best < 2 ; ++return_best)
+  {
+    RestartSearch search;
+    search.setThreads(4, return_best);
+
+    // calls made while another one uses the threads of the search do not wait for them
+    const unsigned int calls = 8;
+    bool found[calls];
+    unsigned int attempts[calls];
+    boost::thread_group threads;
+    for (unsigned int i = 0 ; i < calls ; ++i)
+      threads.create_thread(boost::bind(&runSearch, &search, &found[i], &attempts[i]));
+    threads.join_all();
+    for (unsigned int i = 0 ; i < calls ; ++i)
+    {
+      EXPECT_TRUE(found[i]);
+      EXPECT_LT(0u, attempts[i]);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
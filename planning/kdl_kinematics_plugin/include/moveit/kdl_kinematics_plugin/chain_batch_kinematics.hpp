@@ -0,0 +1,111 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_KDL_KINEMATICS_PLUGIN_CHAIN_BATCH_KINEMATICS_
+#define MOVEIT_KDL_KINEMATICS_PLUGIN_CHAIN_BATCH_KINEMATICS_
+
+#include <kdl/chain.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace kdl_kinematics_plugin
+{
+
+/**
+ * @brief Frames and Jacobians of several links for many configurations, stored as a structure of arrays.
+ * The entry for link l and configuration c is at index(l, c) in each of the arrays.
+ */
+struct BatchKinematicsResult
+{
+  std::size_t index(std::size_t link, std::size_t configuration) const
+  {
+    return link * configurations + configuration;
+  }
+
+  std::size_t configurations;
+  std::size_t links;
+  std::size_t joints;
+
+  /** Origins of the link frames */
+  std::vector<double> x, y, z;
+
+  /** Orientations of the link frames */
+  std::vector<double> qx, qy, qz, qw;
+
+  /** The 6 x joints Jacobian of each link frame, column-major, starting at index(l, c) * 6 * joints.
+      Empty if Jacobians were not requested. */
+  std::vector<double> jacobians;
+};
+
+/**
+ * @brief Forward kinematics and Jacobians for many configurations of a chain. All requested frames of a configuration
+ * are computed in a single pass over the chain, and link names are resolved once per batch.
+ * The results are the same as those of KDL::ChainFkSolverPos_recursive and KDL::ChainJntToJacSolver: frames are
+ * expressed in the base of the chain, Jacobians have the link origin as reference point and the base orientation.
+ */
+class ChainBatchKinematics
+{
+public:
+
+  ChainBatchKinematics(const KDL::Chain &chain);
+
+  /** @brief The number of segments up to and including the segment called \e name (0 is the base of the chain), -1 if there is none */
+  int getSegmentIndex(const std::string &name) const;
+
+  /** @brief Resolve link names with getSegmentIndex(); returns false if one of them is not a segment of the chain */
+  bool getSegmentIndices(const std::vector<std::string> &link_names, std::vector<int> &segments) const;
+
+  /**
+   * @brief Compute the frames (and optionally the Jacobians) of \e segments for \e count configurations
+   * @param segments Segment indices as returned by getSegmentIndex()
+   * @param configurations count * getNrOfJoints() joint values, one configuration after the other
+   */
+  void compute(const std::vector<int> &segments, const double *configurations, std::size_t count,
+               BatchKinematicsResult &result, bool jacobians) const;
+
+  unsigned int getNrOfJoints() const
+  {
+    return chain_.getNrOfJoints();
+  }
+
+private:
+
+  KDL::Chain chain_;
+  std::map<std::string, int> segment_index_;
+};
+
+}
+
+#endif
@@ -74,6 +74,14 @@ public:
 
   bool setMimicJoints(const std::vector<kdl_kinematics_plugin::JointMimic>& mimic_joints);
 
+  /**
+   * @return the number of Newton-Raphson iterations of the last call to CartToJnt()
+   */
+  unsigned int getLastNrOfIterations() const
+  {
+    return last_nr_of_iterations;
+  }
+
 private:
   const Chain chain;
   JntArray q_min;//These are the limits for the "reduced" state consisting of only active DOFs
@@ -92,6 +100,7 @@ private:
   void qToqMimic(const JntArray& q, JntArray& q_result); //Convert from the "reduced" state (only active DOFs) to the "full" state
   void qMimicToq(const JntArray& q, JntArray& q_result); //Convert from the "full" state to the "reduced" state
   bool position_ik;
+  unsigned int last_nr_of_iterations;
 
 };
 
@@ -106,10 +106,23 @@ public:
     redundant_joints_locked = false;
   }
 
+  /**
+   * @brief Use damped least squares instead of the truncated SVD pseudo inverse:
+   * qdot_out = jac^T (jac jac^T + lambda^2 I)^-1 v_in. The decomposition uses fixed-size Eigen
+   * matrices, so this is only available for at most DLS_MAX_JOINTS active (non-mimic) joints.
+   * @param lambda The damping factor; 0 switches back to the pseudo inverse
+   * @return false if the chain has too many joints
+   */
+  bool setDampedLeastSquares(double lambda);
+
+  /** The largest number of active joints supported by the damped least squares mode */
+  static const unsigned int DLS_MAX_JOINTS = 7;
+
 private:
 
   bool jacToJacReduced(const Jacobian &jac, Jacobian &jac_mimic);
   bool jacToJacLocked(const Jacobian &jac, Jacobian &jac_locked);
+  void dampedLeastSquares(const Jacobian &jac, const Twist &v_in, JntArray &qdot_out) const;
 
   const Chain chain;
   ChainJntToJacSolver jnt2jac;
@@ -132,6 +145,7 @@ private:
   Eigen::VectorXd S_translate;
   Eigen::MatrixXd V_translate;
   Eigen::VectorXd tmp_translate;
+  Eigen::MatrixXd jac_translate;
 
   // This is the jacobian when the redundant joint is "locked" and plays no part
   Jacobian jac_locked;
@@ -153,6 +167,7 @@ private:
   Eigen::VectorXd S_locked;
   Eigen::MatrixXd V_locked;
   Eigen::VectorXd tmp_locked;
+  Eigen::MatrixXd jac_svd_locked;
 
   // This is the set of variable used when solving for position only inverse kinematics
   // for the case where the redundant joint is "locked" and plays no part
@@ -160,12 +175,16 @@ private:
   Eigen::VectorXd S_translate_locked;
   Eigen::MatrixXd V_translate_locked;
   Eigen::VectorXd tmp_translate_locked;
+  Eigen::MatrixXd jac_translate_locked;
 
   // Internal storage for a map from the "locked" state to the full active state
   std::vector<unsigned int> locked_joints_map_index;
   unsigned int num_redundant_joints;
   bool redundant_joints_locked;
 
+  // Damping factor of the damped least squares mode, 0 if the pseudo inverse is used
+  double dls_lambda;
+
 
 };
 }
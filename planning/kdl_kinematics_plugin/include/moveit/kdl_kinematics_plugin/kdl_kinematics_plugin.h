@@ -43,6 +43,8 @@
 
 // System
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 // ROS msgs
 #include <geometry_msgs/PoseStamped.h>
@@ -59,8 +61,10 @@
 #include <moveit/kdl_kinematics_plugin/chainiksolver_pos_nr_jl_mimic.hpp>
 #include <moveit/kdl_kinematics_plugin/chainiksolver_vel_pinv_mimic.hpp>
 #include <moveit/kdl_kinematics_plugin/joint_mimic.hpp>
+#include <moveit/kdl_kinematics_plugin/chain_batch_kinematics.hpp>
 
 // MoveIt!
+#include <moveit/ik_restart_search/restart_search.h>
 #include <moveit/kinematics_base/kinematics_base.h>
 #include <moveit/robot_model/robot_model.h>
 #include <moveit/robot_state/robot_state.h>
@@ -79,6 +83,8 @@ namespace kdl_kinematics_plugin
      */
     KDLKinematicsPlugin();
 
+    virtual ~KDLKinematicsPlugin();
+
     virtual bool getPositionIK(const geometry_msgs::Pose &ik_pose,
                                const std::vector<double> &ik_seed_state,
                                std::vector<double> &solution,
@@ -121,6 +127,21 @@ namespace kdl_kinematics_plugin
                                const std::vector<double> &joint_angles,
                                std::vector<geometry_msgs::Pose> &poses) const;
 
+    /**
+     * @brief Forward kinematics for many configurations at once. The link names are resolved once and all
+     * frames of a configuration are computed in one pass over the chain.
+     * @param link_names The links to compute the frames of; all of them must be part of the chain
+     * @param joint_angles The configurations one after the other, each in the order of getJointNames()
+     * @param result The frames in the base frame of the solver, see BatchKinematicsResult for the layout
+     * @param compute_jacobians Also compute the Jacobian of each link frame, with respect to all joints of the chain
+     * (including mimic joints)
+     * @return False if a link is not part of the chain or the number of joint values is not a multiple of the chain size
+     */
+    bool getPositionFKBatch(const std::vector<std::string> &link_names,
+                            const std::vector<double> &joint_angles,
+                            BatchKinematicsResult &result,
+                            bool compute_jacobians = false) const;
+
     virtual bool initialize(const std::string &robot_description,
                             const std::string &group_name,
                             const std::string &base_name,
@@ -137,6 +158,28 @@ namespace kdl_kinematics_plugin
      */
     const std::vector<std::string>& getLinkNames() const;
 
+    /**
+     * @brief Search from several seeds concurrently. The first search starts at the seed state,
+     * the others at restart configurations; each one keeps restarting as before.
+     * This is also configured by the private parameters parallel_search_threads and parallel_search_return_best.
+     * Must not be called while a search is running.
+     * @param threads The number of concurrent searches; 1 disables the parallel search
+     * @param return_best If false, the first valid solution is returned and the other searches are cancelled.
+     * If true, the other searches finish their current attempt, and the solution callback is called for the solutions
+     * found, closest to the seed first, until one is valid.
+     * @note Solution callbacks are called one at a time, but possibly from different threads, and not after a solution is valid.
+     * Concurrent calls to searchPositionIK() do not wait for each other: while one uses the threads of the parallel search,
+     * the others search in the calling thread only.
+     */
+    void setParallelSearch(unsigned int threads, bool return_best = false);
+
+    /**
+     * @brief Set how the configurations a search restarts from are chosen.
+     * This is also configured by the private parameters restart_seeding ("uniform", "gaussian" or "halton")
+     * and restart_gaussian_stddev. Must not be called while a search is running.
+     */
+    void setRestartSeeding(ik_restart_search::SeedingStrategy strategy, double gaussian_stddev = 0.3);
+
   protected:
 
   /**
@@ -167,6 +210,35 @@ namespace kdl_kinematics_plugin
 
   private:
 
+    /** @brief The solvers used by a search. They keep intermediate results, so concurrent searches need separate instances. */
+    struct IKSolvers
+    {
+      IKSolvers(const KDLKinematicsPlugin &plugin, const std::vector<unsigned int> &redundant_joint_indices,
+                const std::vector<unsigned int> &redundant_joints_map_index, unsigned int generation);
+
+      KDL::ChainFkSolverPos_recursive fk_solver_;
+      KDL::ChainIkSolverVel_pinv_mimic ik_solver_vel_;
+      KDL::ChainIkSolverPos_NR_JL_Mimic ik_solver_pos_;
+      random_numbers::RandomNumberGenerator rng_;
+
+      /** The value of solver_generation_ when the solvers were created */
+      unsigned int generation_;
+
+      /** The redundant joints the solvers were created for */
+      std::vector<unsigned int> redundant_joint_indices_;
+
+      /** False if the redundant joints could not be set on the velocity solver */
+      bool redundancy_valid_;
+    };
+    typedef boost::shared_ptr<IKSolvers> IKSolversPtr;
+
+    /** @brief Runs the solvers of one call to searchPositionIK() for the restart search */
+    class IKRestartProblem;
+
+    IKSolversPtr acquireSolvers() const;
+
+    void releaseSolvers(const IKSolversPtr &solvers) const;
+
     bool timedOut(const ros::WallTime &start_time, double duration) const;
 
 
@@ -185,21 +257,6 @@ namespace kdl_kinematics_plugin
 
     int getKDLSegmentIndex(const std::string &name) const;
 
-    void getRandomConfiguration(KDL::JntArray &jnt_array, bool lock_redundancy) const;
-
-    /** @brief Get a random configuration within joint limits close to the seed state
-     *  @param seed_state Seed state
-     *  @param redundancy Index of the redundant joint within the chain
-     *  @param consistency_limit The returned state will contain a value for the redundant joint in the range [seed_state(redundancy_limit)-consistency_limit,seed_state(redundancy_limit)+consistency_limit]
-     *  @param jnt_array Returned random configuration
-     */
-    void getRandomConfiguration(const KDL::JntArray& seed_state,
-                                const std::vector<double> &consistency_limits,
-                                KDL::JntArray &jnt_array,
-                                bool lock_redundancy) const;
-
-    bool isRedundantJoint(unsigned int index) const;
-
     bool active_; /** Internal variable that indicates whether solvers are configured and ready */
 
     moveit_msgs::KinematicSolverInfo ik_chain_info_; /** Stores information for the inverse kinematics solver */
@@ -207,18 +264,19 @@ namespace kdl_kinematics_plugin
     moveit_msgs::KinematicSolverInfo fk_chain_info_; /** Store information for the forward kinematics solver */
 
     KDL::Chain kdl_chain_;
+    boost::scoped_ptr<ChainBatchKinematics> batch_kinematics_;
 
     unsigned int dimension_; /** Dimension of the group */
 
     KDL::JntArray joint_min_, joint_max_; /** Joint limits */
 
-    mutable random_numbers::RandomNumberGenerator random_number_generator_;
-
     robot_model::RobotModelPtr robot_model_;
 
     robot_state::RobotStatePtr state_, state_2_;
 
     int num_possible_redundant_joints_;
+
+    /** The redundant joints and their map index are protected by solver_pool_lock_ and copied into the solvers */
     std::vector<unsigned int> redundant_joints_map_index_;
 
     // Storage required for when the set of redundant joints is reset
@@ -228,6 +286,18 @@ namespace kdl_kinematics_plugin
     double epsilon_;
     std::vector<JointMimic> mimic_joints_;
 
+    /** Solvers that are not in use by a search */
+    mutable std::vector<IKSolversPtr> solver_pool_;
+    mutable boost::mutex solver_pool_lock_;
+
+    /** Incremented when the solvers need to be created again, e.g. after the redundant joints changed */
+    unsigned int solver_generation_;
+
+    /** Damping of the damped least squares velocity solver, 0 if the pseudo inverse is used */
+    double damping_;
+
+    /** Restarts the solvers from new configurations, possibly from several threads */
+    ik_restart_search::RestartSearch restart_search_;
   };
 }
 
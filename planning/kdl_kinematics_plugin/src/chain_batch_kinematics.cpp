@@ -0,0 +1,143 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/kdl_kinematics_plugin/chain_batch_kinematics.hpp>
+#include <algorithm>
+
+namespace kdl_kinematics_plugin
+{
+
+ChainBatchKinematics::ChainBatchKinematics(const KDL::Chain &chain) : chain_(chain)
+{
+  // the first segment with a given name wins, as in a linear search
+  for (unsigned int i = chain_.getNrOfSegments() ; i > 0 ; --i)
+    segment_index_[chain_.getSegment(i - 1).getName()] = i;
+}
+
+int ChainBatchKinematics::getSegmentIndex(const std::string &name) const
+{
+  std::map<std::string, int>::const_iterator it = segment_index_.find(name);
+  return it == segment_index_.end() ? -1 : it->second;
+}
+
+bool ChainBatchKinematics::getSegmentIndices(const std::vector<std::string> &link_names, std::vector<int> &segments) const
+{
+  segments.resize(link_names.size());
+  for (std::size_t i = 0 ; i < link_names.size() ; ++i)
+    if ((segments[i] = getSegmentIndex(link_names[i])) < 0)
+      return false;
+  return true;
+}
+
+void ChainBatchKinematics::compute(const std::vector<int> &segments, const double *configurations, std::size_t count,
+                                   BatchKinematicsResult &result, bool jacobians) const
+{
+  const unsigned int joints = chain_.getNrOfJoints();
+  const std::size_t entries = segments.size() * count;
+  result.configurations = count;
+  result.links = segments.size();
+  result.joints = joints;
+  result.x.resize(entries);
+  result.y.resize(entries);
+  result.z.resize(entries);
+  result.qx.resize(entries);
+  result.qy.resize(entries);
+  result.qz.resize(entries);
+  result.qw.resize(entries);
+  if (jacobians)
+    result.jacobians.resize(entries * 6 * joints);
+  else
+    result.jacobians.clear();
+
+  // the requested links in the order they are reached along the chain
+  std::vector<std::pair<int, std::size_t> > order(segments.size());
+  for (std::size_t l = 0 ; l < segments.size() ; ++l)
+    order[l] = std::make_pair(segments[l], l);
+  std::sort(order.begin(), order.end());
+
+  // unit twist of each joint in the base frame, with the tip of the joint's segment as reference point
+  std::vector<KDL::Twist> joint_twists(joints);
+  std::vector<KDL::Vector> joint_ref_points(joints);
+
+  for (std::size_t c = 0 ; c < count ; ++c)
+  {
+    const double *q = configurations + c * joints;
+    KDL::Frame frame = KDL::Frame::Identity();
+    unsigned int j = 0;
+    std::size_t next = 0;
+    for (unsigned int s = 0 ; s <= chain_.getNrOfSegments() && next < order.size() ; ++s)
+    {
+      if (s > 0)
+      {
+        const KDL::Segment &segment = chain_.getSegment(s - 1);
+        if (segment.getJoint().getType() != KDL::Joint::None)
+        {
+          KDL::Frame next_frame = frame * segment.pose(q[j]);
+          if (jacobians)
+          {
+            joint_twists[j] = frame.M * segment.twist(q[j], 1.0);
+            joint_ref_points[j] = next_frame.p;
+          }
+          frame = next_frame;
+          ++j;
+        }
+        else
+          frame = frame * segment.pose(0.0);
+      }
+
+      for ( ; next < order.size() && order[next].first == (int)s ; ++next)
+      {
+        const std::size_t idx = result.index(order[next].second, c);
+        result.x[idx] = frame.p.x();
+        result.y[idx] = frame.p.y();
+        result.z[idx] = frame.p.z();
+        frame.M.GetQuaternion(result.qx[idx], result.qy[idx], result.qz[idx], result.qw[idx]);
+        if (!jacobians)
+          continue;
+
+        double *jac = &result.jacobians[idx * 6 * joints];
+        for (unsigned int k = 0 ; k < j ; ++k)
+        {
+          const KDL::Twist t = joint_twists[k].RefPoint(frame.p - joint_ref_points[k]);
+          for (unsigned int r = 0 ; r < 6 ; ++r)
+            jac[k * 6 + r] = t(r);
+        }
+        // joints after the link do not move it
+        std::fill(jac + j * 6, jac + joints * 6, 0.0);
+      }
+    }
+  }
+}
+
+}
@@ -27,6 +27,21 @@
 
 #include "moveit/kdl_kinematics_plugin/chainiksolver_pos_nr_jl_mimic.hpp"
 #include <ros/console.h>
+#include <algorithm>
+
+// Logging the iterations is too slow to be left in the solver loop, even when the debug level is disabled.
+// Compile with -DMOVEIT_KDL_IK_TRACE to get the trace back.
+#ifdef MOVEIT_KDL_IK_TRACE
+#define KDL_IK_TRACE(name, array, size)                                 \
+  do                                                                    \
+  {                                                                     \
+    ROS_DEBUG_STREAM_NAMED("kdl", name);                                \
+    for(std::size_t _i = 0; _i < (std::size_t)(size); ++_i)             \
+      ROS_DEBUG_NAMED("kdl","%d: %f", (int) _i, (array)(_i));           \
+  } while (0)
+#else
+#define KDL_IK_TRACE(name, array, size)
+#endif
 
 namespace KDL
 {
@@ -50,7 +65,8 @@ ChainIkSolverPos_NR_JL_Mimic::ChainIkSolverPos_NR_JL_Mimic(const Chain& _chain,
     delta_q(_chain.getNrOfJoints()),
     maxiter(_maxiter),
     eps(_eps),
-    position_ik(_position_ik)
+    position_ik(_position_ik),
+    last_nr_of_iterations(0)
 {
   mimic_joints.resize(chain.getNrOfJoints());
   for(std::size_t i=0; i < mimic_joints.size(); ++i)
@@ -121,9 +137,11 @@ int ChainIkSolverPos_NR_JL_Mimic::CartToJntAdvanced(const JntArray& q_init, cons
   //  qToqMimic(q_init,q_temp);
 
   q_temp = q_init;
-  ROS_DEBUG_STREAM_NAMED("kdl","Input:");
-  for(std::size_t i=0; i < q_out.rows(); ++i)
-    ROS_DEBUG_NAMED("kdl","%d: %f",(int) i,q_out(i));
+  KDL_IK_TRACE("Input:", q_out, q_out.rows());
+
+  // joints past the limit vectors are not clamped
+  const std::size_t n_min = std::min(q_min.rows(), q_temp.rows());
+  const std::size_t n_max = std::min(q_max.rows(), q_temp.rows());
 
   unsigned int i;
   for(i=0;i<maxiter;++i)
@@ -142,34 +160,17 @@ int ChainIkSolverPos_NR_JL_Mimic::CartToJntAdvanced(const JntArray& q_init, cons
         break;
     }
 
-    ROS_DEBUG_STREAM_NAMED("kdl","delta_twist");
-    for(std::size_t i=0; i < 6; ++i)
-      ROS_DEBUG_NAMED("kdl","%d: %f",(int) i, delta_twist(i));
+    KDL_IK_TRACE("delta_twist", delta_twist, 6);
 
     iksolver.CartToJnt(q_temp,delta_twist,delta_q);
 
     Add(q_temp,delta_q,q_temp);
 
-    ROS_DEBUG_STREAM_NAMED("kdl","delta_q");
-    for(std::size_t i=0; i < delta_q.rows(); ++i)
-      ROS_DEBUG_NAMED("kdl","%d: %f",(int) i, delta_q(i));
+    KDL_IK_TRACE("delta_q", delta_q, delta_q.rows());
+    KDL_IK_TRACE("q_temp", q_temp, q_temp.rows());
 
-    ROS_DEBUG_STREAM_NAMED("kdl","q_temp");
-    for(std::size_t i=0; i < q_temp.rows(); ++i)
-      ROS_DEBUG_NAMED("kdl","%d: %f",(int) i, q_temp(i));
-
-    for(std::size_t j=0; j<q_min.rows(); ++j)
-    {
-      //      if(mimic_joints[j].active)
-        if(q_temp(j) < q_min(j))
-          q_temp(j) = q_min(j);
-    }
-    for(std::size_t j=0; j<q_max.rows(); ++j)
-    {
-      //      if(mimic_joints[j].active)
-        if(q_temp(j) > q_max(j))
-          q_temp(j) = q_max(j);
-    }
+    q_temp.data.head(n_min) = q_temp.data.head(n_min).cwiseMax(q_min.data.head(n_min));
+    q_temp.data.head(n_max) = q_temp.data.head(n_max).cwiseMin(q_max.data.head(n_max));
 
     //    q_out = q_temp;
     //Make sure limits are applied on the mimic joints to
@@ -180,14 +181,10 @@ int ChainIkSolverPos_NR_JL_Mimic::CartToJntAdvanced(const JntArray& q_init, cons
 
   //  qMimicToq(q_temp, q_out);
   q_out = q_temp;
-  ROS_DEBUG_STREAM_NAMED("kdl","Full Solution:");
-  for(std::size_t i=0; i < q_temp.rows(); ++i)
-    ROS_DEBUG_NAMED("kdl","%d: %f",(int) i,q_temp(i));
-
-  ROS_DEBUG_STREAM_NAMED("kdl","Actual Solution:");
-  for(std::size_t i=0; i < q_out.rows(); ++i)
-    ROS_DEBUG_NAMED("kdl","%d: %f",(int) i,q_out(i));
+  KDL_IK_TRACE("Full Solution:", q_temp, q_temp.rows());
+  KDL_IK_TRACE("Actual Solution:", q_out, q_out.rows());
 
+  last_nr_of_iterations = i;
   if(i!=maxiter)
     return 0;
   else
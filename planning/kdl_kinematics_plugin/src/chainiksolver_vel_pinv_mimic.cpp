@@ -25,9 +25,12 @@
 
 #include <moveit/kdl_kinematics_plugin/chainiksolver_vel_pinv_mimic.hpp>
 #include <ros/console.h>
+#include <Eigen/Cholesky>
 
 namespace KDL
 {
+const unsigned int ChainIkSolverVel_pinv_mimic::DLS_MAX_JOINTS;
+
 ChainIkSolverVel_pinv_mimic::ChainIkSolverVel_pinv_mimic(const Chain& _chain, int _num_mimic_joints, int _num_redundant_joints, bool _position_ik, double _eps, int _maxiter):
   chain(_chain),
   jnt2jac(chain),
@@ -42,6 +45,7 @@ ChainIkSolverVel_pinv_mimic::ChainIkSolverVel_pinv_mimic(const Chain& _chain, in
   S_translate(VectorXd::Zero(chain.getNrOfJoints()-_num_mimic_joints)),
   V_translate(MatrixXd::Zero(chain.getNrOfJoints()-_num_mimic_joints,chain.getNrOfJoints()-_num_mimic_joints)),
   tmp_translate(VectorXd::Zero(chain.getNrOfJoints()-_num_mimic_joints)),
+  jac_translate(MatrixXd::Zero(3,chain.getNrOfJoints()-_num_mimic_joints)),
   jac_locked(chain.getNrOfJoints()-_num_redundant_joints-_num_mimic_joints),
   qdot_out_reduced_locked(chain.getNrOfJoints()-_num_mimic_joints-_num_redundant_joints),
   qdot_out_locked(chain.getNrOfJoints()-_num_redundant_joints),
@@ -54,12 +58,15 @@ ChainIkSolverVel_pinv_mimic::ChainIkSolverVel_pinv_mimic(const Chain& _chain, in
   S_locked(VectorXd::Zero(chain.getNrOfJoints()-_num_mimic_joints-_num_redundant_joints)),
   V_locked(MatrixXd::Zero(chain.getNrOfJoints()-_num_mimic_joints-_num_redundant_joints,chain.getNrOfJoints()-_num_mimic_joints-_num_redundant_joints)),
   tmp_locked(VectorXd::Zero(chain.getNrOfJoints()-_num_mimic_joints-_num_redundant_joints)),
+  jac_svd_locked(MatrixXd::Zero(6,chain.getNrOfJoints()-_num_mimic_joints-_num_redundant_joints)),
   U_translate_locked(MatrixXd::Zero(3,chain.getNrOfJoints()-_num_mimic_joints-_num_redundant_joints)),
   S_translate_locked(VectorXd::Zero(chain.getNrOfJoints()-_num_mimic_joints-_num_redundant_joints)),
   V_translate_locked(MatrixXd::Zero(chain.getNrOfJoints()-_num_mimic_joints-_num_redundant_joints,chain.getNrOfJoints()-_num_mimic_joints-_num_redundant_joints)),
   tmp_translate_locked(VectorXd::Zero(chain.getNrOfJoints()-_num_mimic_joints-_num_redundant_joints)),
+  jac_translate_locked(MatrixXd::Zero(3,chain.getNrOfJoints()-_num_mimic_joints-_num_redundant_joints)),
   num_redundant_joints(_num_redundant_joints),
-  redundant_joints_locked(false)
+  redundant_joints_locked(false),
+  dls_lambda(0.0)
 {
   mimic_joints_.resize(chain.getNrOfJoints());
   for(std::size_t i=0; i < mimic_joints_.size(); ++i)
@@ -105,6 +112,48 @@ bool ChainIkSolverVel_pinv_mimic::setRedundantJointsMapIndex(const std::vector<u
   return true;
 }
 
+bool ChainIkSolverVel_pinv_mimic::setDampedLeastSquares(double lambda)
+{
+  if(lambda > 0.0 && chain.getNrOfJoints()-num_mimic_joints > DLS_MAX_JOINTS)
+    return false;
+  dls_lambda = std::max(lambda, 0.0);
+  return true;
+}
+
+void ChainIkSolverVel_pinv_mimic::dampedLeastSquares(const Jacobian &jac_in, const Twist &v_in, JntArray &qdot_out) const
+{
+  // the sizes are bounded, so none of these matrices is allocated on the heap
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, 6, DLS_MAX_JOINTS> JacobianMatrix;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, DLS_MAX_JOINTS, DLS_MAX_JOINTS> JointMatrix;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, 6, 6> TaskMatrix;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, 1, 0, 6, 1> TaskVector;
+  typedef Eigen::Matrix<double, Eigen::Dynamic, 1, 0, DLS_MAX_JOINTS, 1> JointVector;
+
+  const unsigned int rows = position_ik ? 3 : 6;
+  const JacobianMatrix j = jac_in.data.topRows(rows);
+  TaskVector v(rows);
+  for(unsigned int i=0; i < rows; ++i)
+    v(i) = v_in(i);
+  const double lambda2 = dls_lambda * dls_lambda;
+
+  // invert whichever of j^T j and j j^T is smaller; both give the same solution
+  JointVector qdot;
+  if(j.cols() <= j.rows())
+  {
+    JointMatrix a = j.transpose() * j;
+    a.diagonal().array() += lambda2;
+    qdot = a.ldlt().solve(j.transpose() * v);
+  }
+  else
+  {
+    TaskMatrix a = j * j.transpose();
+    a.diagonal().array() += lambda2;
+    TaskVector y = a.ldlt().solve(v);
+    qdot = j.transpose() * y;
+  }
+  qdot_out.data.head(qdot.size()) = qdot;
+}
+
 bool ChainIkSolverVel_pinv_mimic::jacToJacReduced(const Jacobian &jac, Jacobian &jac_reduced_l)
 {
   jac_reduced_l.data.setZero();
@@ -145,62 +194,78 @@ int ChainIkSolverVel_pinv_mimic::CartToJntRedundant(const JntArray& q_in, const
   //Now compute the jacobian with redundant joints locked
   jacToJacLocked(jac_reduced,jac_locked);
 
-  //Do a singular value decomposition of "jac" with maximum
-  //iterations "maxiter", put the results in "U", "S" and "V"
-  //jac = U*S*Vt
-
-  int ret;
-  if(!position_ik)
-    ret = svd_eigen_HH(jac_locked.data,U_locked,S_locked,V_locked,tmp_locked,maxiter);
+  int ret = 0;
+  unsigned int i;
+  if(dls_lambda > 0.0)
+  {
+    if(num_mimic_joints > 0)
+      dampedLeastSquares(jac_locked, v_in, qdot_out_reduced_locked);
+    else
+      dampedLeastSquares(jac_locked, v_in, qdot_out_locked);
+  }
   else
-    ret = svd_eigen_HH(jac_locked.data.topLeftCorner(3,chain.getNrOfJoints()-num_mimic_joints-num_redundant_joints),U_translate_locked,S_translate_locked,V_translate_locked,tmp_translate_locked,maxiter);
+  {
+    //Do a singular value decomposition of "jac" with maximum
+    //iterations "maxiter", put the results in "U", "S" and "V"
+    //jac = U*S*Vt
 
-  double sum;
-  unsigned int i,j;
+    if(!position_ik)
+    {
+      jac_svd_locked = jac_locked.data;
+      ret = svd_eigen_HH(jac_svd_locked,U_locked,S_locked,V_locked,tmp_locked,maxiter);
+    }
+    else
+    {
+      jac_translate_locked = jac_locked.data.topRows(3);
+      ret = svd_eigen_HH(jac_translate_locked,U_translate_locked,S_translate_locked,V_translate_locked,tmp_translate_locked,maxiter);
+    }
 
-  // We have to calculate qdot_out = jac_pinv*v_in
-  // Using the svd decomposition this becomes(jac_pinv=V*S_pinv*Ut):
-  // qdot_out = V*S_pinv*Ut*v_in
+    double sum;
+    unsigned int j;
 
-  unsigned int rows;
-  if(!position_ik)
-    rows = jac_locked.rows();
-  else
-    rows = 3;
+    // We have to calculate qdot_out = jac_pinv*v_in
+    // Using the svd decomposition this becomes(jac_pinv=V*S_pinv*Ut):
+    // qdot_out = V*S_pinv*Ut*v_in
 
-  //first we calculate Ut*v_in
-  for (i=0;i<jac_locked.columns();i++) {
-    sum = 0.0;
-    for (j=0;j<rows;j++) {
-      if(!position_ik)
-        sum+= U_locked(j,i)*v_in(j);
-      else
-        sum+= U_translate_locked(j,i)*v_in(j);
-    }
-    //If the singular value is too small (<eps), don't invert it but
-    //set the inverted singular value to zero (truncated svd)
+    unsigned int rows;
     if(!position_ik)
-      tmp(i) = sum*(fabs(S_locked(i))<eps?0.0:1.0/S_locked(i));
+      rows = jac_locked.rows();
     else
-      tmp(i) = sum*(fabs(S_translate_locked(i))<eps?0.0:1.0/S_translate_locked(i));
-  }
-  //tmp is now: tmp=S_pinv*Ut*v_in, we still have to premultiply
-  //it with V to get qdot_out
-  for (i=0;i<jac_locked.columns();i++) {
-    sum = 0.0;
-    for (j=0;j<jac_locked.columns();j++) {
+      rows = 3;
+
+    //first we calculate Ut*v_in
+    for (i=0;i<jac_locked.columns();i++) {
+      sum = 0.0;
+      for (j=0;j<rows;j++) {
+        if(!position_ik)
+          sum+= U_locked(j,i)*v_in(j);
+        else
+          sum+= U_translate_locked(j,i)*v_in(j);
+      }
+      //If the singular value is too small (<eps), don't invert it but
+      //set the inverted singular value to zero (truncated svd)
       if(!position_ik)
-        sum+=V_locked(i,j)*tmp(j);
+        tmp(i) = sum*(fabs(S_locked(i))<eps?0.0:1.0/S_locked(i));
       else
-        sum+=V_translate_locked(i,j)*tmp(j);
+        tmp(i) = sum*(fabs(S_translate_locked(i))<eps?0.0:1.0/S_translate_locked(i));
+    }
+    //tmp is now: tmp=S_pinv*Ut*v_in, we still have to premultiply
+    //it with V to get qdot_out
+    for (i=0;i<jac_locked.columns();i++) {
+      sum = 0.0;
+      for (j=0;j<jac_locked.columns();j++) {
+        if(!position_ik)
+          sum+=V_locked(i,j)*tmp(j);
+        else
+          sum+=V_translate_locked(i,j)*tmp(j);
+      }
+      //Put the result in qdot_out_reduced if mimic joints exist, otherwise in qdot_out
+      if(num_mimic_joints > 0)
+        qdot_out_reduced_locked(i)=sum;
+      else
+        qdot_out_locked(i) = sum;
     }
-    //Put the result in qdot_out_reduced if mimic joints exist, otherwise in qdot_out
-    if(num_mimic_joints > 0)
-      qdot_out_reduced_locked(i)=sum;
-    else
-      qdot_out_locked(i) = sum;
   }
-  ROS_DEBUG_STREAM_NAMED("kdl","Solution:");
 
   if(num_mimic_joints > 0)
   {
@@ -242,62 +307,76 @@ int ChainIkSolverVel_pinv_mimic::CartToJnt(const JntArray& q_in, const Twist& v_
   else
     jnt2jac.JntToJac(q_in,jac_reduced);
 
-  //Do a singular value decomposition of "jac" with maximum
-  //iterations "maxiter", put the results in "U", "S" and "V"
-  //jac = U*S*Vt
-
-  int ret;
-  if(!position_ik)
-    ret = svd.calculate(jac_reduced,U,S,V,maxiter);
+  int ret = 0;
+  unsigned int i;
+  if(dls_lambda > 0.0)
+  {
+    if(num_mimic_joints > 0)
+      dampedLeastSquares(jac_reduced, v_in, qdot_out_reduced);
+    else
+      dampedLeastSquares(jac_reduced, v_in, qdot_out);
+  }
   else
-    ret = svd_eigen_HH(jac_reduced.data.topLeftCorner(3,chain.getNrOfJoints()-num_mimic_joints),U_translate,S_translate,V_translate,tmp_translate,maxiter);
+  {
+    //Do a singular value decomposition of "jac" with maximum
+    //iterations "maxiter", put the results in "U", "S" and "V"
+    //jac = U*S*Vt
 
-  double sum;
-  unsigned int i,j;
+    if(!position_ik)
+      ret = svd.calculate(jac_reduced,U,S,V,maxiter);
+    else
+    {
+      jac_translate = jac_reduced.data.topRows(3);
+      ret = svd_eigen_HH(jac_translate,U_translate,S_translate,V_translate,tmp_translate,maxiter);
+    }
 
-  // We have to calculate qdot_out = jac_pinv*v_in
-  // Using the svd decomposition this becomes(jac_pinv=V*S_pinv*Ut):
-  // qdot_out = V*S_pinv*Ut*v_in
+    double sum;
+    unsigned int j;
 
-  unsigned int rows;
-  if(!position_ik)
-    rows = jac_reduced.rows();
-  else
-    rows = 3;
+    // We have to calculate qdot_out = jac_pinv*v_in
+    // Using the svd decomposition this becomes(jac_pinv=V*S_pinv*Ut):
+    // qdot_out = V*S_pinv*Ut*v_in
 
-  //first we calculate Ut*v_in
-  for (i=0;i<jac_reduced.columns();i++) {
-    sum = 0.0;
-    for (j=0;j<rows;j++) {
-      if(!position_ik)
-        sum+= U[j](i)*v_in(j);
-      else
-        sum+= U_translate(j,i)*v_in(j);
-    }
-    //If the singular value is too small (<eps), don't invert it but
-    //set the inverted singular value to zero (truncated svd)
+    unsigned int rows;
     if(!position_ik)
-      tmp(i) = sum*(fabs(S(i))<eps?0.0:1.0/S(i));
+      rows = jac_reduced.rows();
     else
-      tmp(i) = sum*(fabs(S_translate(i))<eps?0.0:1.0/S_translate(i));
-  }
-  //tmp is now: tmp=S_pinv*Ut*v_in, we still have to premultiply
-  //it with V to get qdot_out
-  for (i=0;i<jac_reduced.columns();i++) {
-    sum = 0.0;
-    for (j=0;j<jac_reduced.columns();j++) {
+      rows = 3;
+
+    //first we calculate Ut*v_in
+    for (i=0;i<jac_reduced.columns();i++) {
+      sum = 0.0;
+      for (j=0;j<rows;j++) {
+        if(!position_ik)
+          sum+= U[j](i)*v_in(j);
+        else
+          sum+= U_translate(j,i)*v_in(j);
+      }
+      //If the singular value is too small (<eps), don't invert it but
+      //set the inverted singular value to zero (truncated svd)
       if(!position_ik)
-        sum+=V[i](j)*tmp(j);
+        tmp(i) = sum*(fabs(S(i))<eps?0.0:1.0/S(i));
       else
-        sum+=V_translate(i,j)*tmp(j);
+        tmp(i) = sum*(fabs(S_translate(i))<eps?0.0:1.0/S_translate(i));
+    }
+    //tmp is now: tmp=S_pinv*Ut*v_in, we still have to premultiply
+    //it with V to get qdot_out
+    for (i=0;i<jac_reduced.columns();i++) {
+      sum = 0.0;
+      for (j=0;j<jac_reduced.columns();j++) {
+        if(!position_ik)
+          sum+=V[i](j)*tmp(j);
+        else
+          sum+=V_translate(i,j)*tmp(j);
+      }
+      //Put the result in qdot_out_reduced if mimic joints exist, otherwise in qdot_out
+      if(num_mimic_joints > 0)
+        qdot_out_reduced(i)=sum;
+      else
+        qdot_out(i) = sum;
     }
-    //Put the result in qdot_out_reduced if mimic joints exist, otherwise in qdot_out
-    if(num_mimic_joints > 0)
-      qdot_out_reduced(i)=sum;
-    else
-      qdot_out(i) = sum;
   }
-  ROS_DEBUG_STREAM_NAMED("kdl","Solution:");
+
   if(num_mimic_joints > 0)
   {
     for(i=0; i < chain.getNrOfJoints(); ++i)
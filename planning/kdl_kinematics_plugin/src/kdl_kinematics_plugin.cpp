@@ -47,71 +47,253 @@
 
 #include <moveit/rdf_loader/rdf_loader.h>
 
+#include <map>
+#include <algorithm>
+
 //register KDLKinematics as a KinematicsBase implementation
 CLASS_LOADER_REGISTER_CLASS(kdl_kinematics_plugin::KDLKinematicsPlugin, kinematics::KinematicsBase)
 
 namespace kdl_kinematics_plugin
 {
 
-  KDLKinematicsPlugin::KDLKinematicsPlugin():active_(false) {}
+namespace
+{
 
-void KDLKinematicsPlugin::getRandomConfiguration(KDL::JntArray &jnt_array, bool lock_redundancy) const
+/** \brief The robot model and KDL tree parsed from one robot description. Plugin instances for the
+    groups of a robot share these, so the URDF is parsed once per process rather than once per group. */
+struct SharedModelData
 {
-  std::vector<double> jnt_array_vector(dimension_, 0.0);
-  state_->setToRandomPositions(joint_model_group_);
-  state_->copyJointGroupPositions(joint_model_group_, &jnt_array_vector[0]);
-  for (std::size_t i = 0; i < dimension_; ++i)
+  std::string urdf_string_;
+  std::string srdf_string_;
+  robot_model::RobotModelPtr robot_model_;
+  KDL::Tree kdl_tree_;
+
+  boost::mutex chains_lock_;
+  std::map<std::pair<std::string, std::string>, KDL::Chain> chains_;
+};
+
+typedef boost::shared_ptr<SharedModelData> SharedModelDataPtr;
+
+boost::mutex shared_model_data_lock;
+std::map<std::string, SharedModelDataPtr> shared_model_data;
+
+/** \brief Get the parsed model for \e robot_description, reusing the one parsed by a previous plugin
+    instance if the URDF and SRDF on the parameter server have not changed. Return NULL on failure. */
+SharedModelDataPtr getSharedModelData(const std::string &robot_description)
+{
+  std::string param_name, urdf_string, srdf_string;
+  bool has_srdf;
+  if (!rdf_loader::RDFLoader::readDescriptionParams(robot_description, param_name, urdf_string, srdf_string, has_srdf) ||
+      !has_srdf)
+    return SharedModelDataPtr();
+
+  // parsing happens under the lock so that instances initialized in parallel parse the robot only once
+  boost::mutex::scoped_lock slock(shared_model_data_lock);
+  SharedModelDataPtr &data = shared_model_data[param_name];
+  if (data && data->urdf_string_ == urdf_string && data->srdf_string_ == srdf_string)
   {
-    if (lock_redundancy)
-      if (isRedundantJoint(i))
-        continue;
-    jnt_array(i) = jnt_array_vector[i];
+    ROS_DEBUG_NAMED("kdl","Reusing the robot model parsed from '%s'", param_name.c_str());
+    return data;
+  }
+
+  ros::WallTime start = ros::WallTime::now();
+  rdf_loader::RDFLoader rdf_loader(urdf_string, srdf_string);
+  const boost::shared_ptr<srdf::Model> &srdf = rdf_loader.getSRDF();
+  const boost::shared_ptr<urdf::ModelInterface>& urdf_model = rdf_loader.getURDF();
+  if (!urdf_model || !srdf)
+  {
+    data.reset();
+    return data;
   }
+
+  SharedModelDataPtr result(new SharedModelData());
+  if (!kdl_parser::treeFromUrdfModel(*urdf_model, result->kdl_tree_))
+  {
+    ROS_ERROR_NAMED("kdl","Could not initialize tree object");
+    data.reset();
+    return data;
+  }
+  result->robot_model_.reset(new robot_model::RobotModel(urdf_model, srdf));
+  result->urdf_string_.swap(urdf_string);
+  result->srdf_string_.swap(srdf_string);
+  data = result;
+  ROS_DEBUG_STREAM_NAMED("kdl","Parsed the robot model from '" << param_name << "' in "
+                         << (ros::WallTime::now() - start).toSec() << " seconds");
+  return data;
 }
 
-bool KDLKinematicsPlugin::isRedundantJoint(unsigned int index) const
+/** \brief Extract the chain from \e base to \e tip of the shared tree, once per pair of frames */
+bool getSharedChain(SharedModelData &data, const std::string &base, const std::string &tip, KDL::Chain &chain)
 {
-  for (std::size_t j=0; j < redundant_joint_indices_.size(); ++j)
-    if (redundant_joint_indices_[j] == index)
-      return true;
-  return false;
+  boost::mutex::scoped_lock slock(data.chains_lock_);
+  std::pair<std::string, std::string> key(base, tip);
+  std::map<std::pair<std::string, std::string>, KDL::Chain>::const_iterator it = data.chains_.find(key);
+  if (it == data.chains_.end())
+  {
+    KDL::Chain new_chain;
+    if (!data.kdl_tree_.getChain(base, tip, new_chain))
+      return false;
+    it = data.chains_.insert(std::make_pair(key, new_chain)).first;
+  }
+  chain = it->second;
+  return true;
+}
+
 }
 
-void KDLKinematicsPlugin::getRandomConfiguration(const KDL::JntArray &seed_state,
-                                                 const std::vector<double> &consistency_limits,
-                                                 KDL::JntArray &jnt_array,
-                                                 bool lock_redundancy) const
+KDLKinematicsPlugin::IKSolvers::IKSolvers(const KDLKinematicsPlugin &plugin, const std::vector<unsigned int> &redundant_joint_indices,
+                                          const std::vector<unsigned int> &redundant_joints_map_index, unsigned int generation) :
+  fk_solver_(plugin.kdl_chain_),
+  ik_solver_vel_(plugin.kdl_chain_, plugin.joint_model_group_->getMimicJointModels().size(),
+                 redundant_joint_indices.size(), plugin.position_ik_),
+  ik_solver_pos_(plugin.kdl_chain_, plugin.joint_min_, plugin.joint_max_, fk_solver_, ik_solver_vel_,
+                 plugin.max_solver_iterations_, plugin.epsilon_, plugin.position_ik_),
+  generation_(generation),
+  redundant_joint_indices_(redundant_joint_indices)
 {
-  std::vector<double> values(dimension_, 0.0);
-  std::vector<double> near(dimension_, 0.0);
-  for (std::size_t i = 0 ; i < dimension_; ++i)
-    near[i] = seed_state(i);
+  ik_solver_vel_.setMimicJoints(plugin.mimic_joints_);
+  ik_solver_pos_.setMimicJoints(plugin.mimic_joints_);
+  if (plugin.damping_ > 0.0)
+    ik_solver_vel_.setDampedLeastSquares(plugin.damping_);
+  redundancy_valid_ = redundant_joint_indices.empty() ||
+    ik_solver_vel_.setRedundantJointsMapIndex(redundant_joints_map_index);
+}
 
-  // Need to resize the consistency limits to remove mimic joints
-  std::vector<double> consistency_limits_mimic;
-  for(std::size_t i = 0; i < dimension_; ++i)
+class KDLKinematicsPlugin::IKRestartProblem : public ik_restart_search::RestartProblem
+{
+public:
+
+  IKRestartProblem(const KDLKinematicsPlugin &plugin,
+                   const geometry_msgs::Pose &ik_pose,
+                   const KDL::Frame &pose_desired,
+                   const KDL::JntArray &jnt_seed_state,
+                   const std::vector<double> &consistency_limits,
+                   const IKCallbackFn &solution_callback,
+                   const kinematics::KinematicsQueryOptions &options,
+                   moveit_msgs::MoveItErrorCodes &error_code) :
+    plugin_(plugin),
+    ik_pose_(ik_pose),
+    pose_desired_(pose_desired),
+    jnt_seed_state_(jnt_seed_state),
+    consistency_limits_(consistency_limits),
+    solution_callback_(solution_callback),
+    options_(options),
+    error_code_(error_code),
+    solvers_(plugin.restart_search_.getThreads()),
+    candidate_(plugin.dimension_)
   {
-    if(!mimic_joints_[i].active)
-      continue;
-    consistency_limits_mimic.push_back(consistency_limits[i]);
   }
 
-  joint_model_group_->getVariableRandomPositionsNearBy(state_->getRandomNumberGenerator(), values, near, consistency_limits_mimic);
+  virtual ~IKRestartProblem()
+  {
+    for (std::size_t i = 0 ; i < solvers_.size() ; ++i)
+      if (solvers_[i])
+        plugin_.releaseSolvers(solvers_[i]);
+  }
 
-  for (std::size_t i = 0; i < dimension_; ++i)
+  /** @brief The solvers of a search, taken from the pool on first use. Each search only accesses its own entry. */
+  IKSolvers& getSolvers(unsigned int worker)
   {
-    bool skip = false;
-    if (lock_redundancy)
-      for (std::size_t j = 0; j < redundant_joint_indices_.size(); ++j)
-        if (redundant_joint_indices_[j] == i)
-        {
-          skip = true;
-          break;
-        }
-    if (skip)
-      continue;
-    jnt_array(i) = values[i];
+    if (!solvers_[worker])
+    {
+      solvers_[worker] = plugin_.acquireSolvers();
+      if (options_.lock_redundant_joints)
+        solvers_[worker]->ik_solver_vel_.lockRedundantJoints();
+      else
+        solvers_[worker]->ik_solver_vel_.unlockRedundantJoints();
+    }
+    return *solvers_[worker];
   }
+
+  virtual bool attempt(unsigned int worker, const KDL::JntArray &start, KDL::JntArray &result)
+  {
+    IKSolvers &solvers = getSolvers(worker);
+    if (!solvers.redundancy_valid_)
+      return false;
+    int ik_valid = solvers.ik_solver_pos_.CartToJnt(start, pose_desired_, result);
+    ROS_DEBUG_NAMED("kdl","IK valid: %d", ik_valid);
+    if (ik_valid < 0 && !options_.return_approximate_solution)
+      return false;
+    if (!consistency_limits_.empty() && !plugin_.checkConsistency(jnt_seed_state_, consistency_limits_, result))
+    {
+      ROS_DEBUG_NAMED("kdl","Could not find IK solution: does not match consistency limits");
+      return false;
+    }
+    return true;
+  }
+
+  virtual bool accept(const KDL::JntArray &candidate)
+  {
+    for (unsigned int j = 0 ; j < plugin_.dimension_ ; ++j)
+      candidate_[j] = candidate(j);
+    if (!solution_callback_.empty())
+      solution_callback_(ik_pose_, candidate_, error_code_);
+    else
+      error_code_.val = error_code_.SUCCESS;
+    return error_code_.val == error_code_.SUCCESS;
+  }
+
+  virtual random_numbers::RandomNumberGenerator& getRandomNumberGenerator(unsigned int worker)
+  {
+    return getSolvers(worker).rng_;
+  }
+
+private:
+
+  const KDLKinematicsPlugin &plugin_;
+  const geometry_msgs::Pose &ik_pose_;
+  const KDL::Frame &pose_desired_;
+  const KDL::JntArray &jnt_seed_state_;
+  const std::vector<double> &consistency_limits_;
+  const IKCallbackFn &solution_callback_;
+  const kinematics::KinematicsQueryOptions &options_;
+  moveit_msgs::MoveItErrorCodes &error_code_;
+  std::vector<IKSolversPtr> solvers_;
+  std::vector<double> candidate_;
+};
+
+KDLKinematicsPlugin::KDLKinematicsPlugin():active_(false), solver_generation_(0), damping_(0.0) {}
+
+KDLKinematicsPlugin::~KDLKinematicsPlugin()
+{
+}
+
+KDLKinematicsPlugin::IKSolversPtr KDLKinematicsPlugin::acquireSolvers() const
+{
+  std::vector<unsigned int> redundant_joint_indices, redundant_joints_map_index;
+  unsigned int generation;
+  {
+    boost::mutex::scoped_lock slock(solver_pool_lock_);
+    if (!solver_pool_.empty())
+    {
+      IKSolversPtr solvers = solver_pool_.back();
+      solver_pool_.pop_back();
+      return solvers;
+    }
+    // setRedundantJoints() may change the redundant joints while the new solvers are created
+    redundant_joint_indices = redundant_joint_indices_;
+    redundant_joints_map_index = redundant_joints_map_index_;
+    generation = solver_generation_;
+  }
+  return IKSolversPtr(new IKSolvers(*this, redundant_joint_indices, redundant_joints_map_index, generation));
+}
+
+void KDLKinematicsPlugin::releaseSolvers(const IKSolversPtr &solvers) const
+{
+  boost::mutex::scoped_lock slock(solver_pool_lock_);
+  // solvers created before the configuration changed are dropped
+  if (solvers->generation_ == solver_generation_)
+    solver_pool_.push_back(solvers);
+}
+
+void KDLKinematicsPlugin::setParallelSearch(unsigned int threads, bool return_best)
+{
+  restart_search_.setThreads(threads, return_best);
+}
+
+void KDLKinematicsPlugin::setRestartSeeding(ik_restart_search::SeedingStrategy strategy, double gaussian_stddev)
+{
+  restart_search_.setSeeding(strategy, gaussian_stddev);
 }
 
 bool KDLKinematicsPlugin::checkConsistency(const KDL::JntArray& seed_state,
@@ -133,17 +315,14 @@ bool KDLKinematicsPlugin::initialize(const std::string &robot_description,
   setValues(robot_description, group_name, base_frame, tip_frame, search_discretization);
 
   ros::NodeHandle private_handle("~");
-  rdf_loader::RDFLoader rdf_loader(robot_description_);
-  const boost::shared_ptr<srdf::Model> &srdf = rdf_loader.getSRDF();
-  const boost::shared_ptr<urdf::ModelInterface>& urdf_model = rdf_loader.getURDF();
-
-  if (!urdf_model || !srdf)
+  SharedModelDataPtr model_data = getSharedModelData(robot_description_);
+  if (!model_data)
   {
     ROS_ERROR_NAMED("kdl","URDF and SRDF must be loaded for KDL kinematics solver to work.");
     return false;
   }
 
-  robot_model_.reset(new robot_model::RobotModel(urdf_model, srdf));
+  robot_model_ = model_data->robot_model_;
 
   robot_model::JointModelGroup* joint_model_group = robot_model_->getJointModelGroup(group_name);
   if (!joint_model_group)
@@ -160,18 +339,12 @@ bool KDLKinematicsPlugin::initialize(const std::string &robot_description,
     return false;
   }
 
-  KDL::Tree kdl_tree;
-
-  if (!kdl_parser::treeFromUrdfModel(*urdf_model, kdl_tree))
-  {
-    ROS_ERROR_NAMED("kdl","Could not initialize tree object");
-    return false;
-  }
-  if (!kdl_tree.getChain(base_frame_, getTipFrame(), kdl_chain_))
+  if (!getSharedChain(*model_data, base_frame_, getTipFrame(), kdl_chain_))
   {
     ROS_ERROR_NAMED("kdl","Could not initialize chain object");
     return false;
   }
+  batch_kinematics_.reset(new ChainBatchKinematics(kdl_chain_));
 
   dimension_ = joint_model_group->getActiveJointModels().size() + joint_model_group->getMimicJointModels().size();
   for (std::size_t i=0; i < joint_model_group->getJointModels().size(); ++i)
@@ -212,6 +385,25 @@ bool KDLKinematicsPlugin::initialize(const std::string &robot_description,
   private_handle.param("max_solver_iterations", max_solver_iterations, 500);
   private_handle.param("epsilon", epsilon, 1e-5);
   private_handle.param(group_name+"/position_only_ik", position_ik, false);
+
+  double damping;
+  private_handle.param("damping", damping, 0.0);
+
+  int parallel_search_threads;
+  bool parallel_search_return_best;
+  private_handle.param("parallel_search_threads", parallel_search_threads, 1);
+  private_handle.param("parallel_search_return_best", parallel_search_return_best, false);
+
+  std::string restart_seeding;
+  double restart_gaussian_stddev;
+  private_handle.param("restart_seeding", restart_seeding, std::string("uniform"));
+  private_handle.param("restart_gaussian_stddev", restart_gaussian_stddev, 0.3);
+  ik_restart_search::SeedingStrategy seeding_strategy;
+  if (!ik_restart_search::parseSeedingStrategy(restart_seeding, seeding_strategy))
+  {
+    ROS_WARN_NAMED("kdl","Unknown restart seeding strategy '%s', using uniform restarts", restart_seeding.c_str());
+    seeding_strategy = ik_restart_search::UNIFORM;
+  }
   ROS_DEBUG_NAMED("kdl","Looking in private handle: %s for param name: %s",
             private_handle.getNamespace().c_str(),
             (group_name+"/position_only_ik").c_str());
@@ -219,6 +411,18 @@ bool KDLKinematicsPlugin::initialize(const std::string &robot_description,
   if(position_ik)
     ROS_INFO_NAMED("kdl","Using position only ik");
 
+  if(damping > 0.0)
+  {
+    if(joint_model_group->getActiveJointModels().size() > KDL::ChainIkSolverVel_pinv_mimic::DLS_MAX_JOINTS)
+    {
+      ROS_WARN_NAMED("kdl","Damped least squares is only available for up to %u joints, using the pseudo inverse",
+                     KDL::ChainIkSolverVel_pinv_mimic::DLS_MAX_JOINTS);
+      damping = 0.0;
+    }
+    else
+      ROS_INFO_NAMED("kdl","Using damped least squares with damping %f", damping);
+  }
+
   num_possible_redundant_joints_ = kdl_chain_.getNrOfJoints() - joint_model_group->getMimicJointModels().size() - (position_ik? 3:6);
 
   // Check for mimic joints
@@ -280,6 +484,17 @@ bool KDLKinematicsPlugin::initialize(const std::string &robot_description,
   joint_model_group_ = joint_model_group;
   max_solver_iterations_ = max_solver_iterations;
   epsilon_ = epsilon;
+  damping_ = damping;
+
+  {
+    boost::mutex::scoped_lock slock(solver_pool_lock_);
+    solver_pool_.clear();
+    ++solver_generation_;
+  }
+  setParallelSearch(std::max(parallel_search_threads, 1), parallel_search_return_best);
+  setRestartSeeding(seeding_strategy, restart_gaussian_stddev);
+  if (restart_search_.getThreads() > 1)
+    ROS_INFO_NAMED("kdl","Using %u parallel IK searches", restart_search_.getThreads());
 
   active_ = true;
   ROS_DEBUG_NAMED("kdl","KDL solver initialized");
@@ -339,8 +554,12 @@ bool KDLKinematicsPlugin::setRedundantJoints(const std::vector<unsigned int> &re
   for(std::size_t i=0; i < redundant_joints_map_index.size(); ++i)
     ROS_DEBUG_NAMED("kdl","Redundant joint map index: %d %d", (int) i, (int) redundant_joints_map_index[i]);
 
+  // the velocity solver is sized for the number of redundant joints
+  boost::mutex::scoped_lock slock(solver_pool_lock_);
   redundant_joints_map_index_ = redundant_joints_map_index;
   redundant_joint_indices_ = redundant_joints;
+  solver_pool_.clear();
+  ++solver_generation_;
   return true;
 }
 
@@ -355,14 +574,7 @@ int KDLKinematicsPlugin::getJointIndex(const std::string &name) const
 
 int KDLKinematicsPlugin::getKDLSegmentIndex(const std::string &name) const
 {
-  int i=0;
-  while (i < (int)kdl_chain_.getNrOfSegments()) {
-    if (kdl_chain_.getSegment(i).getName() == name) {
-      return i+1;
-    }
-    i++;
-  }
-  return -1;
+  return batch_kinematics_->getSegmentIndex(name);
 }
 
 bool KDLKinematicsPlugin::timedOut(const ros::WallTime &start_time, double duration) const
@@ -498,26 +710,8 @@ bool KDLKinematicsPlugin::searchPositionIK(const geometry_msgs::Pose &ik_pose,
   }
 
   KDL::JntArray jnt_seed_state(dimension_);
-  KDL::JntArray jnt_pos_in(dimension_);
   KDL::JntArray jnt_pos_out(dimension_);
 
-  KDL::ChainFkSolverPos_recursive fk_solver(kdl_chain_);
-  KDL::ChainIkSolverVel_pinv_mimic ik_solver_vel(kdl_chain_, joint_model_group_->getMimicJointModels().size(), redundant_joint_indices_.size(), position_ik_);
-  KDL::ChainIkSolverPos_NR_JL_Mimic ik_solver_pos(kdl_chain_, joint_min_, joint_max_, fk_solver, ik_solver_vel, max_solver_iterations_, epsilon_, position_ik_);
-  ik_solver_vel.setMimicJoints(mimic_joints_);
-  ik_solver_pos.setMimicJoints(mimic_joints_);
-
-  if ((redundant_joint_indices_.size() > 0) && !ik_solver_vel.setRedundantJointsMapIndex(redundant_joints_map_index_))
-  {
-    ROS_ERROR_NAMED("kdl","Could not set redundant joints");
-    return false;
-  }
-
-  if(options.lock_redundant_joints)
-  {
-    ik_solver_vel.lockRedundantJoints();
-  }
-
   solution.resize(dimension_);
 
   KDL::Frame pose_desired;
@@ -534,63 +728,41 @@ bool KDLKinematicsPlugin::searchPositionIK(const geometry_msgs::Pose &ik_pose,
   //Do the IK
   for(unsigned int i=0; i < dimension_; i++)
     jnt_seed_state(i) = ik_seed_state[i];
-  jnt_pos_in = jnt_seed_state;
 
-  unsigned int counter(0);
-  while(1)
+  IKRestartProblem problem(*this, ik_pose, pose_desired, jnt_seed_state, consistency_limits, solution_callback,
+                           options, error_code);
+  if (!problem.getSolvers(0).redundancy_valid_)
   {
-    //    ROS_DEBUG_NAMED("kdl","Iteration: %d, time: %f, Timeout: %f",counter,(ros::WallTime::now()-n1).toSec(),timeout);
-    counter++;
-    if(timedOut(n1,timeout))
-    {
-      ROS_DEBUG_NAMED("kdl","IK timed out");
-      error_code.val = error_code.TIMED_OUT;
-      ik_solver_vel.unlockRedundantJoints();
-      return false;
-    }
-    int ik_valid = ik_solver_pos.CartToJnt(jnt_pos_in, pose_desired, jnt_pos_out);
-    ROS_DEBUG_NAMED("kdl","IK valid: %d", ik_valid);
-    if(!consistency_limits.empty())
-    {
-      getRandomConfiguration(jnt_seed_state, consistency_limits, jnt_pos_in, options.lock_redundant_joints);
-      if( (ik_valid < 0 && !options.return_approximate_solution) || !checkConsistency(jnt_seed_state, consistency_limits, jnt_pos_out))
-      {
-        ROS_DEBUG_NAMED("kdl","Could not find IK solution: does not match consistency limits");
-        continue;
-      }
-    }
-    else
-    {
-      getRandomConfiguration(jnt_pos_in, options.lock_redundant_joints);
-      ROS_DEBUG_NAMED("kdl","New random configuration");
-      for(unsigned int j=0; j < dimension_; j++)
-        ROS_DEBUG_NAMED("kdl","%d %f", j, jnt_pos_in(j));
+    ROS_ERROR_NAMED("kdl","Could not set redundant joints");
+    return false;
+  }
 
-      if(ik_valid < 0 && !options.return_approximate_solution)
-      {
-        ROS_DEBUG_NAMED("kdl","Could not find IK solution");
-        continue;
-      }
-    }
-    ROS_DEBUG_NAMED("kdl","Found IK solution");
-    for(unsigned int j=0; j < dimension_; j++)
-      solution[j] = jnt_pos_out(j);
-    if(!solution_callback.empty())
-      solution_callback(ik_pose,solution,error_code);
-    else
-      error_code.val = error_code.SUCCESS;
+  ik_restart_search::RestartBounds bounds;
+  bounds.min_ = joint_min_;
+  bounds.max_ = joint_max_;
+  bounds.consistency_limits_ = consistency_limits;
+  if (options.lock_redundant_joints)
+  {
+    // the redundant joints the solvers of this search were created for
+    const std::vector<unsigned int> &redundant_joints = problem.getSolvers(0).redundant_joint_indices_;
+    bounds.locked_.resize(dimension_);
+    for (unsigned int i = 0 ; i < dimension_ ; ++i)
+      bounds.locked_[i] = std::find(redundant_joints.begin(), redundant_joints.end(), i) != redundant_joints.end();
+  }
 
-    if(error_code.val == error_code.SUCCESS)
-    {
-      ROS_DEBUG_STREAM_NAMED("kdl","Solved after " << counter << " iterations");
-      ik_solver_vel.unlockRedundantJoints();
-      return true;
-    }
+  ik_restart_search::RestartStatistics statistics;
+  if (!restart_search_.search(problem, jnt_seed_state, bounds, n1, timeout, jnt_pos_out, &statistics))
+  {
+    ROS_DEBUG_NAMED("kdl","IK timed out after %u attempts", statistics.attempts);
+    error_code.val = error_code.TIMED_OUT;
+    return false;
   }
-  ROS_DEBUG_NAMED("kdl","An IK that satisifes the constraints and is collision free could not be found");
-  error_code.val = error_code.NO_IK_SOLUTION;
-  ik_solver_vel.unlockRedundantJoints();
-  return false;
+
+  ROS_DEBUG_STREAM_NAMED("kdl","Solved after " << statistics.attempts << " iterations");
+  for(unsigned int j=0; j < dimension_; j++)
+    solution[j] = jnt_pos_out(j);
+  error_code.val = error_code.SUCCESS;
+  return true;
 }
 
 bool KDLKinematicsPlugin::getPositionFK(const std::vector<std::string> &link_names,
@@ -610,33 +782,56 @@ bool KDLKinematicsPlugin::getPositionFK(const std::vector<std::string> &link_nam
     return false;
   }
 
-  KDL::Frame p_out;
-  geometry_msgs::PoseStamped pose;
-  tf::Stamped<tf::Pose> tf_pose;
+  // names that are not segments of the chain give the tip frame, as KDL::ChainFkSolverPos_recursive does for index -1
+  std::vector<int> segments(link_names.size());
+  for(unsigned int i=0; i < link_names.size(); i++)
+  {
+    segments[i] = getKDLSegmentIndex(link_names[i]);
+    ROS_DEBUG_NAMED("kdl","End effector index: %d",segments[i]);
+    if(segments[i] < 0)
+      segments[i] = kdl_chain_.getNrOfSegments();
+  }
 
-  KDL::JntArray jnt_pos_in(dimension_);
-  for(unsigned int i=0; i < dimension_; i++)
+  BatchKinematicsResult result;
+  batch_kinematics_->compute(segments, &joint_angles[0], 1, result, false);
+  for(unsigned int i=0; i < poses.size(); i++)
   {
-    jnt_pos_in(i) = joint_angles[i];
+    poses[i].position.x = result.x[i];
+    poses[i].position.y = result.y[i];
+    poses[i].position.z = result.z[i];
+    poses[i].orientation.x = result.qx[i];
+    poses[i].orientation.y = result.qy[i];
+    poses[i].orientation.z = result.qz[i];
+    poses[i].orientation.w = result.qw[i];
   }
+  return true;
+}
 
-  KDL::ChainFkSolverPos_recursive fk_solver(kdl_chain_);
+bool KDLKinematicsPlugin::getPositionFKBatch(const std::vector<std::string> &link_names,
+                                             const std::vector<double> &joint_angles,
+                                             BatchKinematicsResult &result,
+                                             bool compute_jacobians) const
+{
+  if(!active_)
+  {
+    ROS_ERROR_NAMED("kdl","kinematics not active");
+    return false;
+  }
+  if(joint_angles.size() % dimension_ != 0)
+  {
+    ROS_ERROR_NAMED("kdl","Joint angles vector must have a multiple of %d values",dimension_);
+    return false;
+  }
 
-  bool valid = true;
-  for(unsigned int i=0; i < poses.size(); i++)
+  std::vector<int> segments;
+  if(!batch_kinematics_->getSegmentIndices(link_names, segments))
   {
-    ROS_DEBUG_NAMED("kdl","End effector index: %d",getKDLSegmentIndex(link_names[i]));
-    if(fk_solver.JntToCart(jnt_pos_in,p_out,getKDLSegmentIndex(link_names[i])) >=0)
-    {
-      tf::poseKDLToMsg(p_out,poses[i]);
-    }
-    else
-    {
-      ROS_ERROR_NAMED("kdl","Could not compute FK for %s",link_names[i].c_str());
-      valid = false;
-    }
+    ROS_ERROR_NAMED("kdl","Could not compute FK: not all links are part of the chain");
+    return false;
   }
-  return valid;
+  const std::size_t count = joint_angles.size() / dimension_;
+  batch_kinematics_->compute(segments, count ? &joint_angles[0] : NULL, count, result, compute_jacobians);
+  return true;
 }
 
 const std::vector<std::string>& KDLKinematicsPlugin::getJointNames() const
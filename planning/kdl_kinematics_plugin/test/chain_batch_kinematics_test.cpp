@@ -0,0 +1,166 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <moveit/kdl_kinematics_plugin/chain_batch_kinematics.hpp>
+#include <kdl/chainfksolverpos_recursive.hpp>
+#include <kdl/chainjnttojacsolver.hpp>
+#include <cstdlib>
+
+using namespace kdl_kinematics_plugin;
+
+namespace
+{
+
+// a 7 DOF arm with a fixed segment in the middle, a prismatic joint and a tool frame
+KDL::Chain makeChain()
+{
+  KDL::Chain chain;
+  chain.addSegment(KDL::Segment("link1", KDL::Joint(KDL::Joint::RotZ), KDL::Frame(KDL::Vector(0.0, 0.0, 0.3))));
+  chain.addSegment(KDL::Segment("link2", KDL::Joint(KDL::Joint::RotY), KDL::Frame(KDL::Vector(0.0, 0.1, 0.2))));
+  chain.addSegment(KDL::Segment("link3", KDL::Joint(KDL::Joint::RotZ), KDL::Frame(KDL::Rotation::RPY(0.1, 0.2, 0.3), KDL::Vector(0.0, 0.0, 0.4))));
+  chain.addSegment(KDL::Segment("fixed", KDL::Joint(KDL::Joint::None), KDL::Frame(KDL::Vector(0.05, 0.0, 0.0))));
+  chain.addSegment(KDL::Segment("link4", KDL::Joint(KDL::Joint::RotY), KDL::Frame(KDL::Vector(0.0, 0.0, 0.4))));
+  chain.addSegment(KDL::Segment("link5", KDL::Joint(KDL::Joint::TransZ), KDL::Frame(KDL::Vector(0.0, 0.0, 0.1))));
+  chain.addSegment(KDL::Segment("link6", KDL::Joint(KDL::Joint::RotX), KDL::Frame(KDL::Vector(0.0, 0.0, 0.1))));
+  chain.addSegment(KDL::Segment("link7", KDL::Joint(KDL::Joint::RotZ), KDL::Frame(KDL::Vector(0.0, 0.0, 0.05))));
+  chain.addSegment(KDL::Segment("tool", KDL::Joint(KDL::Joint::None), KDL::Frame(KDL::Vector(0.0, 0.0, 0.1))));
+  return chain;
+}
+
+std::vector<double> randomConfigurations(unsigned int joints, std::size_t count)
+{
+  srand(42);
+  std::vector<double> q(joints * count);
+  for (std::size_t i = 0 ; i < q.size() ; ++i)
+    q[i] = 6.0 * rand() / RAND_MAX - 3.0;
+  return q;
+}
+
+}
+
+TEST(ChainBatchKinematics, SegmentIndices)
+{
+  ChainBatchKinematics kin(makeChain());
+  EXPECT_EQ(7u, kin.getNrOfJoints());
+  EXPECT_EQ(1, kin.getSegmentIndex("link1"));
+  EXPECT_EQ(4, kin.getSegmentIndex("fixed"));
+  EXPECT_EQ(9, kin.getSegmentIndex("tool"));
+  EXPECT_EQ(-1, kin.getSegmentIndex("missing"));
+
+  std::vector<std::string> names;
+  names.push_back("tool");
+  names.push_back("link2");
+  std::vector<int> segments;
+  EXPECT_TRUE(kin.getSegmentIndices(names, segments));
+  ASSERT_EQ(2u, segments.size());
+  EXPECT_EQ(9, segments[0]);
+  EXPECT_EQ(2, segments[1]);
+  names.push_back("missing");
+  EXPECT_FALSE(kin.getSegmentIndices(names, segments));
+}
+
+TEST(ChainBatchKinematics, MatchesKDLSolvers)
+{
+  const KDL::Chain chain = makeChain();
+  ChainBatchKinematics kin(chain);
+  const unsigned int joints = chain.getNrOfJoints();
+  const std::size_t count = 50;
+  std::vector<double> q = randomConfigurations(joints, count);
+
+  // unsorted, with the base, a fixed segment and a duplicate
+  std::vector<int> segments;
+  segments.push_back(9);
+  segments.push_back(0);
+  segments.push_back(2);
+  segments.push_back(4);
+  segments.push_back(6);
+  segments.push_back(2);
+
+  BatchKinematicsResult result;
+  kin.compute(segments, &q[0], count, result, true);
+  ASSERT_EQ(count, result.configurations);
+  ASSERT_EQ(segments.size(), result.links);
+  ASSERT_EQ(joints, result.joints);
+  ASSERT_EQ(segments.size() * count * 6 * joints, result.jacobians.size());
+
+  KDL::ChainFkSolverPos_recursive fk(chain);
+  KDL::ChainJntToJacSolver jac_solver(chain);
+  KDL::JntArray jnt(joints);
+  KDL::Jacobian jac(joints);
+  for (std::size_t c = 0 ; c < count ; ++c)
+  {
+    for (unsigned int j = 0 ; j < joints ; ++j)
+      jnt(j) = q[c * joints + j];
+    for (std::size_t l = 0 ; l < segments.size() ; ++l)
+    {
+      const std::size_t idx = result.index(l, c);
+      KDL::Frame expected;
+      if (segments[l] > 0)
+        ASSERT_GE(fk.JntToCart(jnt, expected, segments[l]), 0);
+      else
+        expected = KDL::Frame::Identity();
+      KDL::Frame actual(KDL::Rotation::Quaternion(result.qx[idx], result.qy[idx], result.qz[idx], result.qw[idx]),
+                        KDL::Vector(result.x[idx], result.y[idx], result.z[idx]));
+      EXPECT_TRUE(KDL::Equal(expected, actual, 1e-9));
+
+      jac.data.setZero();
+      if (segments[l] > 0)
+        ASSERT_GE(jac_solver.JntToJac(jnt, jac, segments[l]), 0);
+      for (unsigned int j = 0 ; j < joints ; ++j)
+        for (unsigned int r = 0 ; r < 6 ; ++r)
+          EXPECT_NEAR(jac(r, j), result.jacobians[idx * 6 * joints + j * 6 + r], 1e-9);
+    }
+  }
+}
+
+TEST(ChainBatchKinematics, WithoutJacobians)
+{
+  ChainBatchKinematics kin(makeChain());
+  std::vector<double> q = randomConfigurations(kin.getNrOfJoints(), 3);
+  std::vector<int> segments(1, 9);
+  BatchKinematicsResult result;
+  kin.compute(segments, &q[0], 3, result, true);
+  EXPECT_FALSE(result.jacobians.empty());
+  kin.compute(segments, &q[0], 3, result, false);
+  EXPECT_TRUE(result.jacobians.empty());
+  EXPECT_EQ(3u, result.x.size());
+  EXPECT_EQ(3u, result.qw.size());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
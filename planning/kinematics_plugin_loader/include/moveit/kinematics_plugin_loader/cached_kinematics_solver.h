@@ -0,0 +1,245 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_KINEMATICS_PLUGIN_LOADER_CACHED_KINEMATICS_SOLVER_
+#define MOVEIT_KINEMATICS_PLUGIN_LOADER_CACHED_KINEMATICS_SOLVER_
+
+#include <moveit/kinematics_base/kinematics_base.h>
+#include <moveit/robot_model/joint_model_group.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/array.hpp>
+#include <list>
+
+namespace kinematics_plugin_loader
+{
+
+/** \brief Counters of an IK solution cache */
+struct IKCacheStatistics
+{
+  IKCacheStatistics() : hits(0), misses(0), seed_assists(0), size(0)
+  {
+  }
+
+  /** \brief Queries answered from the cache, without calling the solver */
+  std::size_t hits;
+
+  /** \brief Queries solved from the seed of the caller */
+  std::size_t misses;
+
+  /** \brief Queries solved from the seed of a cached solution for a nearby pose */
+  std::size_t seed_assists;
+
+  /** \brief Number of cells with cached solutions */
+  std::size_t size;
+};
+
+/** \brief A thread safe LRU table of IK solutions, keyed by the pose quantized to a grid. Each cell keeps the most recent
+    solutions that are far apart in joint space (e.g. elbow up and elbow down), so the one closest to the seed of a
+    query can be returned. */
+class IKSolutionCache
+{
+public:
+
+  /** \brief Keep at most \e capacity cells. Poses are quantized to \e position_resolution (meters) and
+      \e orientation_resolution (quaternion components). Solutions that differ from the seed of a query by more than
+      \e max_seed_distance in any joint are not returned. */
+  IKSolutionCache(std::size_t capacity, double position_resolution, double orientation_resolution, double max_seed_distance);
+
+  /** \brief Find the cached solution for \e pose that is closest to \e seed. If its cell holds none within the maximum
+      seed distance, the neighboring position cells are searched as well. \e exact is set if the solution was computed
+      for this very pose. */
+  bool lookup(const geometry_msgs::Pose &pose, const std::vector<double> &seed, std::vector<double> &solution, bool &exact);
+
+  void insert(const geometry_msgs::Pose &pose, const std::vector<double> &solution);
+
+  void clear();
+
+  void countHit();
+  void countMiss();
+  void countSeedAssist();
+
+  IKCacheStatistics getStatistics() const;
+
+private:
+
+  typedef boost::array<long, 7> Key;
+
+  struct Solution
+  {
+    boost::array<double, 7> pose_;
+    std::vector<double> joints_;
+  };
+
+  struct Entry
+  {
+    std::vector<Solution> solutions_;  // oldest first
+    std::list<Key>::iterator lru_;
+  };
+
+  struct KeyHash
+  {
+    std::size_t operator()(const Key &key) const;
+  };
+
+  typedef boost::unordered_map<Key, Entry, KeyHash> Table;
+
+  /** \brief Position and quaternion with w >= 0, so q and -q map to the same key */
+  static boost::array<double, 7> canonicalPose(const geometry_msgs::Pose &pose);
+
+  Key computeKey(const boost::array<double, 7> &pose) const;
+
+  /** \brief The largest difference of a joint between \e a and \e b; infinite if their sizes differ */
+  static double jointDistance(const std::vector<double> &a, const std::vector<double> &b);
+
+  /** \brief The solution of \e entry closest to \e seed, if it is within the maximum seed distance */
+  const Solution* findNearest(const Entry &entry, const std::vector<double> &seed) const;
+
+  /** \brief Mark \e it as the most recently used entry */
+  void touch(Table::iterator it);
+
+  std::size_t capacity_;
+  double position_resolution_;
+  double orientation_resolution_;
+  double max_seed_distance_;
+
+  Table table_;
+  std::list<Key> lru_;  // most recently used first
+  IKCacheStatistics stats_;
+  mutable boost::mutex lock_;
+};
+
+typedef boost::shared_ptr<IKSolutionCache> IKSolutionCachePtr;
+
+/** \brief A kinematics solver that answers repeated queries from an IKSolutionCache and otherwise forwards them to another solver.
+    On a miss, a cached solution for a nearby pose is used as seed. Solutions found in the cache are still checked
+    against the consistency limits, the locked redundant joints and the solution callback of the query. Solutions
+    of queries that accept approximate results are not cached. Only solvers with a single tip are supported. */
+class CachedKinematicsSolver : public kinematics::KinematicsBase
+{
+public:
+
+  CachedKinematicsSolver(const kinematics::KinematicsBasePtr &solver, const IKSolutionCachePtr &cache,
+                         const std::string &robot_description);
+
+  const kinematics::KinematicsBasePtr& getSolver() const
+  {
+    return solver_;
+  }
+
+  const IKSolutionCachePtr& getCache() const
+  {
+    return cache_;
+  }
+
+  virtual bool getPositionIK(const geometry_msgs::Pose &ik_pose,
+                             const std::vector<double> &ik_seed_state,
+                             std::vector<double> &solution,
+                             moveit_msgs::MoveItErrorCodes &error_code,
+                             const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const;
+
+  virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                const std::vector<double> &ik_seed_state,
+                                double timeout,
+                                std::vector<double> &solution,
+                                moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const;
+
+  virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                const std::vector<double> &ik_seed_state,
+                                double timeout,
+                                const std::vector<double> &consistency_limits,
+                                std::vector<double> &solution,
+                                moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const;
+
+  virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                const std::vector<double> &ik_seed_state,
+                                double timeout,
+                                std::vector<double> &solution,
+                                const IKCallbackFn &solution_callback,
+                                moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const;
+
+  virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                const std::vector<double> &ik_seed_state,
+                                double timeout,
+                                const std::vector<double> &consistency_limits,
+                                std::vector<double> &solution,
+                                const IKCallbackFn &solution_callback,
+                                moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const;
+
+  virtual bool getPositionFK(const std::vector<std::string> &link_names,
+                             const std::vector<double> &joint_angles,
+                             std::vector<geometry_msgs::Pose> &poses) const;
+
+  virtual bool initialize(const std::string &robot_description,
+                          const std::string &group_name,
+                          const std::string &base_frame,
+                          const std::string &tip_frame,
+                          double search_discretization);
+
+  virtual bool supportsGroup(const robot_model::JointModelGroup *jmg, std::string *error_text_out = NULL) const;
+
+  using kinematics::KinematicsBase::setRedundantJoints;
+
+  virtual bool setRedundantJoints(const std::vector<unsigned int> &redundant_joint_indices);
+
+  virtual const std::vector<std::string>& getJointNames() const;
+
+  virtual const std::vector<std::string>& getLinkNames() const;
+
+private:
+
+  /** \brief Copy the settings of the wrapped solver */
+  void copySolverValues(const std::string &robot_description);
+
+  /** \brief Check a cached solution against the constraints of the query */
+  bool acceptCachedSolution(const geometry_msgs::Pose &ik_pose, const std::vector<double> &ik_seed_state,
+                            const std::vector<double> &cached, const std::vector<double> &consistency_limits,
+                            const IKCallbackFn &solution_callback, moveit_msgs::MoveItErrorCodes &error_code,
+                            const kinematics::KinematicsQueryOptions &options) const;
+
+  /** \brief Remember the solution the solver found for \e ik_pose, unless it may only approximate the pose */
+  void cacheSolution(const geometry_msgs::Pose &ik_pose, const std::vector<double> &solution,
+                     const kinematics::KinematicsQueryOptions &options) const;
+
+  kinematics::KinematicsBasePtr solver_;
+  IKSolutionCachePtr cache_;
+};
+
+}
+
+#endif
@@ -41,6 +41,7 @@
 #include <boost/shared_ptr.hpp>
 #include <moveit/robot_model/robot_model.h>
 #include <moveit/kinematics_base/kinematics_base.h>
+#include <moveit/kinematics_plugin_loader/cached_kinematics_solver.h>
 
 namespace kinematics_plugin_loader
 {
@@ -104,6 +105,10 @@ public:
     return ik_attempts_;
   }
 
+  /** \brief Get the counters of the IK solution cache of a group. Return false if caching is not enabled for the group
+      (see the kinematics_solver_cache_size parameter). */
+  bool getIKCacheStatistics(const std::string &group, IKCacheStatistics &stats) const;
+
   void status() const;
 
 private:
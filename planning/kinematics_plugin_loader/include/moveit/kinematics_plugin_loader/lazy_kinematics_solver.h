@@ -0,0 +1,148 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_KINEMATICS_PLUGIN_LOADER_LAZY_KINEMATICS_SOLVER_
+#define MOVEIT_KINEMATICS_PLUGIN_LOADER_LAZY_KINEMATICS_SOLVER_
+
+#include <moveit/kinematics_base/kinematics_base.h>
+#include <moveit/robot_model/joint_model_group.h>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace kinematics_plugin_loader
+{
+
+/** \brief A kinematics solver that allocates the solver it forwards to on first use.
+    The joint names are derived from the group (its revolute and prismatic joints, in order), since they are needed
+    when the solver is registered with the robot model. When the solver is loaded, its joint names must match these,
+    and the check of supportsGroup() is done then as well. */
+class LazyKinematicsSolver : public kinematics::KinematicsBase
+{
+public:
+
+  typedef boost::function<kinematics::KinematicsBasePtr()> AllocatorFn;
+
+  LazyKinematicsSolver(const AllocatorFn &allocator, const robot_model::JointModelGroup *jmg,
+                       const std::string &robot_description, const std::string &base_frame,
+                       const std::vector<std::string> &tip_frames, double search_discretization);
+
+  /** \brief Return true if the wrapped solver has been allocated */
+  bool isLoaded() const;
+
+  /** \brief Get the wrapped solver, allocating it if needed with the default timeout of this instance. Return NULL if
+      allocation failed. */
+  kinematics::KinematicsBasePtr getSolver() const;
+
+  virtual bool getPositionIK(const geometry_msgs::Pose &ik_pose,
+                             const std::vector<double> &ik_seed_state,
+                             std::vector<double> &solution,
+                             moveit_msgs::MoveItErrorCodes &error_code,
+                             const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const;
+
+  virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                const std::vector<double> &ik_seed_state,
+                                double timeout,
+                                std::vector<double> &solution,
+                                moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const;
+
+  virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                const std::vector<double> &ik_seed_state,
+                                double timeout,
+                                const std::vector<double> &consistency_limits,
+                                std::vector<double> &solution,
+                                moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const;
+
+  virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                const std::vector<double> &ik_seed_state,
+                                double timeout,
+                                std::vector<double> &solution,
+                                const IKCallbackFn &solution_callback,
+                                moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const;
+
+  virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                const std::vector<double> &ik_seed_state,
+                                double timeout,
+                                const std::vector<double> &consistency_limits,
+                                std::vector<double> &solution,
+                                const IKCallbackFn &solution_callback,
+                                moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const;
+
+  virtual bool searchPositionIK(const std::vector<geometry_msgs::Pose> &ik_poses,
+                                const std::vector<double> &ik_seed_state,
+                                double timeout,
+                                const std::vector<double> &consistency_limits,
+                                std::vector<double> &solution,
+                                const IKCallbackFn &solution_callback,
+                                moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const;
+
+  virtual bool getPositionFK(const std::vector<std::string> &link_names,
+                             const std::vector<double> &joint_angles,
+                             std::vector<geometry_msgs::Pose> &poses) const;
+
+  virtual bool initialize(const std::string &robot_description,
+                          const std::string &group_name,
+                          const std::string &base_frame,
+                          const std::string &tip_frame,
+                          double search_discretization);
+
+  /** \brief Until the solver is loaded, the group is assumed to be supported */
+  virtual bool supportsGroup(const robot_model::JointModelGroup *jmg, std::string *error_text_out = NULL) const;
+
+  using kinematics::KinematicsBase::setRedundantJoints;
+
+  virtual bool setRedundantJoints(const std::vector<unsigned int> &redundant_joint_indices);
+
+  virtual const std::vector<std::string>& getJointNames() const;
+
+  virtual const std::vector<std::string>& getLinkNames() const;
+
+private:
+
+  AllocatorFn allocator_;
+  const robot_model::JointModelGroup *jmg_;
+  std::vector<std::string> joint_names_;
+
+  mutable kinematics::KinematicsBasePtr solver_;
+  mutable bool load_failed_;
+  mutable boost::mutex lock_;
+};
+
+}
+
+#endif
@@ -0,0 +1,430 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/kinematics_plugin_loader/cached_kinematics_solver.h>
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace kinematics_plugin_loader
+{
+
+static const double EXACT_POSE_TOLERANCE = 1e-9;
+
+// how far a cached value of a locked redundant joint may be from the seed
+static const double LOCKED_JOINT_TOLERANCE = 1e-9;
+
+// the number of distinct solutions kept for one cell
+static const std::size_t SOLUTIONS_PER_CELL = 4;
+
+std::size_t IKSolutionCache::KeyHash::operator()(const Key &key) const
+{
+  return boost::hash_range(key.begin(), key.end());
+}
+
+IKSolutionCache::IKSolutionCache(std::size_t capacity, double position_resolution, double orientation_resolution,
+                                 double max_seed_distance) :
+  capacity_(std::max<std::size_t>(capacity, 1)),
+  position_resolution_(position_resolution),
+  orientation_resolution_(orientation_resolution),
+  max_seed_distance_(max_seed_distance)
+{
+}
+
+boost::array<double, 7> IKSolutionCache::canonicalPose(const geometry_msgs::Pose &pose)
+{
+  const geometry_msgs::Quaternion &q = pose.orientation;
+  double norm = sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+  if (norm < std::numeric_limits<double>::epsilon())
+    norm = 1.0;
+  if (q.w < 0.0)
+    norm = -norm;
+  boost::array<double, 7> p = {{ pose.position.x, pose.position.y, pose.position.z,
+                                 q.x / norm, q.y / norm, q.z / norm, q.w / norm }};
+  return p;
+}
+
+IKSolutionCache::Key IKSolutionCache::computeKey(const boost::array<double, 7> &pose) const
+{
+  Key key;
+  for (std::size_t i = 0 ; i < 3 ; ++i)
+    key[i] = (long)floor(pose[i] / position_resolution_);
+  for (std::size_t i = 3 ; i < 7 ; ++i)
+    key[i] = (long)floor(pose[i] / orientation_resolution_);
+  return key;
+}
+
+void IKSolutionCache::touch(Table::iterator it)
+{
+  lru_.splice(lru_.begin(), lru_, it->second.lru_);
+}
+
+double IKSolutionCache::jointDistance(const std::vector<double> &a, const std::vector<double> &b)
+{
+  if (a.size() != b.size())
+    return std::numeric_limits<double>::infinity();
+  double d = 0.0;
+  for (std::size_t i = 0 ; i < a.size() ; ++i)
+    d = std::max(d, fabs(a[i] - b[i]));
+  return d;
+}
+
+const IKSolutionCache::Solution* IKSolutionCache::findNearest(const Entry &entry, const std::vector<double> &seed) const
+{
+  const Solution *nearest = NULL;
+  double nearest_distance = max_seed_distance_;
+  for (std::size_t i = 0 ; i < entry.solutions_.size() ; ++i)
+  {
+    double d = jointDistance(entry.solutions_[i].joints_, seed);
+    if (d <= nearest_distance)
+    {
+      nearest = &entry.solutions_[i];
+      nearest_distance = d;
+    }
+  }
+  return nearest;
+}
+
+bool IKSolutionCache::lookup(const geometry_msgs::Pose &pose, const std::vector<double> &seed,
+                             std::vector<double> &solution, bool &exact)
+{
+  const boost::array<double, 7> p = canonicalPose(pose);
+  const Key key = computeKey(p);
+
+  boost::mutex::scoped_lock slock(lock_);
+  Table::iterator it = table_.find(key);
+  if (it != table_.end())
+    if (const Solution *s = findNearest(it->second, seed))
+    {
+      exact = true;
+      for (std::size_t i = 0 ; i < 7 && exact ; ++i)
+        exact = fabs(s->pose_[i] - p[i]) <= EXACT_POSE_TOLERANCE;
+      solution = s->joints_;
+      touch(it);
+      return true;
+    }
+
+  // the pose may be close to the border of its cell
+  exact = false;
+  Key neighbor = key;
+  for (long dx = -1 ; dx <= 1 ; ++dx)
+    for (long dy = -1 ; dy <= 1 ; ++dy)
+      for (long dz = -1 ; dz <= 1 ; ++dz)
+      {
+        if (dx == 0 && dy == 0 && dz == 0)
+          continue;
+        neighbor[0] = key[0] + dx;
+        neighbor[1] = key[1] + dy;
+        neighbor[2] = key[2] + dz;
+        it = table_.find(neighbor);
+        if (it != table_.end())
+          if (const Solution *s = findNearest(it->second, seed))
+          {
+            solution = s->joints_;
+            touch(it);
+            return true;
+          }
+      }
+  return false;
+}
+
+void IKSolutionCache::insert(const geometry_msgs::Pose &pose, const std::vector<double> &solution)
+{
+  const boost::array<double, 7> p = canonicalPose(pose);
+  const Key key = computeKey(p);
+
+  boost::mutex::scoped_lock slock(lock_);
+  Table::iterator it = table_.find(key);
+  if (it == table_.end())
+  {
+    if (table_.size() >= capacity_)
+    {
+      table_.erase(lru_.back());
+      lru_.pop_back();
+    }
+    lru_.push_front(key);
+    it = table_.insert(std::make_pair(key, Entry())).first;
+    it->second.lru_ = lru_.begin();
+  }
+  else
+    touch(it);
+
+  // a solution close to the new one is replaced by it; otherwise the oldest one makes room if the cell is full
+  std::vector<Solution> &solutions = it->second.solutions_;
+  std::size_t i = 0;
+  while (i < solutions.size() && jointDistance(solutions[i].joints_, solution) > max_seed_distance_)
+    ++i;
+  if (i < solutions.size())
+    solutions.erase(solutions.begin() + i);
+  else
+    if (solutions.size() >= SOLUTIONS_PER_CELL)
+      solutions.erase(solutions.begin());
+  Solution s;
+  s.pose_ = p;
+  s.joints_ = solution;
+  solutions.push_back(s);
+}
+
+void IKSolutionCache::clear()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  table_.clear();
+  lru_.clear();
+}
+
+void IKSolutionCache::countHit()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  stats_.hits++;
+}
+
+void IKSolutionCache::countMiss()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  stats_.misses++;
+}
+
+void IKSolutionCache::countSeedAssist()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  stats_.seed_assists++;
+}
+
+IKCacheStatistics IKSolutionCache::getStatistics() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  IKCacheStatistics stats = stats_;
+  stats.size = table_.size();
+  return stats;
+}
+
+CachedKinematicsSolver::CachedKinematicsSolver(const kinematics::KinematicsBasePtr &solver, const IKSolutionCachePtr &cache,
+                                               const std::string &robot_description) :
+  solver_(solver),
+  cache_(cache)
+{
+  copySolverValues(robot_description);
+}
+
+void CachedKinematicsSolver::copySolverValues(const std::string &robot_description)
+{
+  setValues(robot_description, solver_->getGroupName(), solver_->getBaseFrame(), solver_->getTipFrames(),
+            solver_->getSearchDiscretization());
+  setDefaultTimeout(solver_->getDefaultTimeout());
+  std::vector<unsigned int> redundant_joints;
+  solver_->getRedundantJoints(redundant_joints);
+  kinematics::KinematicsBase::setRedundantJoints(redundant_joints);
+}
+
+bool CachedKinematicsSolver::acceptCachedSolution(const geometry_msgs::Pose &ik_pose, const std::vector<double> &ik_seed_state,
+                                                  const std::vector<double> &cached, const std::vector<double> &consistency_limits,
+                                                  const IKCallbackFn &solution_callback, moveit_msgs::MoveItErrorCodes &error_code,
+                                                  const kinematics::KinematicsQueryOptions &options) const
+{
+  if (cached.size() != ik_seed_state.size())
+    return false;
+  // the solver would have kept the redundant joints at the values of the seed
+  if (options.lock_redundant_joints)
+    for (std::size_t i = 0 ; i < redundant_joint_indices_.size() ; ++i)
+    {
+      unsigned int j = redundant_joint_indices_[i];
+      if (j >= cached.size() || fabs(cached[j] - ik_seed_state[j]) > LOCKED_JOINT_TOLERANCE)
+        return false;
+    }
+  if (!consistency_limits.empty())
+  {
+    if (consistency_limits.size() != cached.size())
+      return false;
+    for (std::size_t i = 0 ; i < cached.size() ; ++i)
+      if (fabs(cached[i] - ik_seed_state[i]) > consistency_limits[i])
+        return false;
+  }
+  if (solution_callback.empty())
+  {
+    error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+    return true;
+  }
+  solution_callback(ik_pose, cached, error_code);
+  return error_code.val == moveit_msgs::MoveItErrorCodes::SUCCESS;
+}
+
+void CachedKinematicsSolver::cacheSolution(const geometry_msgs::Pose &ik_pose, const std::vector<double> &solution,
+                                           const kinematics::KinematicsQueryOptions &options) const
+{
+  // an approximate solution would later be returned as an exact hit for this pose
+  if (!options.return_approximate_solution)
+    cache_->insert(ik_pose, solution);
+}
+
+bool CachedKinematicsSolver::getPositionIK(const geometry_msgs::Pose &ik_pose,
+                                           const std::vector<double> &ik_seed_state,
+                                           std::vector<double> &solution,
+                                           moveit_msgs::MoveItErrorCodes &error_code,
+                                           const kinematics::KinematicsQueryOptions &options) const
+{
+  std::vector<double> cached;
+  bool exact = false;
+  if (cache_->lookup(ik_pose, ik_seed_state, cached, exact) && exact &&
+      acceptCachedSolution(ik_pose, ik_seed_state, cached, std::vector<double>(), IKCallbackFn(), error_code, options))
+  {
+    cache_->countHit();
+    solution.swap(cached);
+    return true;
+  }
+  cache_->countMiss();
+  if (!solver_->getPositionIK(ik_pose, ik_seed_state, solution, error_code, options))
+    return false;
+  cacheSolution(ik_pose, solution, options);
+  return true;
+}
+
+bool CachedKinematicsSolver::searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                              const std::vector<double> &ik_seed_state,
+                                              double timeout,
+                                              std::vector<double> &solution,
+                                              moveit_msgs::MoveItErrorCodes &error_code,
+                                              const kinematics::KinematicsQueryOptions &options) const
+{
+  return searchPositionIK(ik_pose, ik_seed_state, timeout, std::vector<double>(), solution, IKCallbackFn(), error_code, options);
+}
+
+bool CachedKinematicsSolver::searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                              const std::vector<double> &ik_seed_state,
+                                              double timeout,
+                                              const std::vector<double> &consistency_limits,
+                                              std::vector<double> &solution,
+                                              moveit_msgs::MoveItErrorCodes &error_code,
+                                              const kinematics::KinematicsQueryOptions &options) const
+{
+  return searchPositionIK(ik_pose, ik_seed_state, timeout, consistency_limits, solution, IKCallbackFn(), error_code, options);
+}
+
+bool CachedKinematicsSolver::searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                              const std::vector<double> &ik_seed_state,
+                                              double timeout,
+                                              std::vector<double> &solution,
+                                              const IKCallbackFn &solution_callback,
+                                              moveit_msgs::MoveItErrorCodes &error_code,
+                                              const kinematics::KinematicsQueryOptions &options) const
+{
+  return searchPositionIK(ik_pose, ik_seed_state, timeout, std::vector<double>(), solution, solution_callback, error_code, options);
+}
+
+bool CachedKinematicsSolver::searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                              const std::vector<double> &ik_seed_state,
+                                              double timeout,
+                                              const std::vector<double> &consistency_limits,
+                                              std::vector<double> &solution,
+                                              const IKCallbackFn &solution_callback,
+                                              moveit_msgs::MoveItErrorCodes &error_code,
+                                              const kinematics::KinematicsQueryOptions &options) const
+{
+  std::vector<double> cached;
+  bool exact = false;
+  if (cache_->lookup(ik_pose, ik_seed_state, cached, exact))
+  {
+    if (exact)
+    {
+      if (acceptCachedSolution(ik_pose, ik_seed_state, cached, consistency_limits, solution_callback, error_code, options))
+      {
+        cache_->countHit();
+        solution.swap(cached);
+        return true;
+      }
+    }
+    // consistency limits and locked redundant joints are relative to the seed of the caller, so the seed cannot be replaced
+    else if (consistency_limits.empty() && !options.lock_redundant_joints)
+    {
+      cache_->countSeedAssist();
+      if (!solver_->searchPositionIK(ik_pose, cached, timeout, solution, solution_callback, error_code, options))
+        return false;
+      cacheSolution(ik_pose, solution, options);
+      return true;
+    }
+  }
+
+  cache_->countMiss();
+  if (!solver_->searchPositionIK(ik_pose, ik_seed_state, timeout, consistency_limits, solution, solution_callback, error_code, options))
+    return false;
+  cacheSolution(ik_pose, solution, options);
+  return true;
+}
+
+bool CachedKinematicsSolver::getPositionFK(const std::vector<std::string> &link_names,
+                                           const std::vector<double> &joint_angles,
+                                           std::vector<geometry_msgs::Pose> &poses) const
+{
+  return solver_->getPositionFK(link_names, joint_angles, poses);
+}
+
+bool CachedKinematicsSolver::initialize(const std::string &robot_description,
+                                        const std::string &group_name,
+                                        const std::string &base_frame,
+                                        const std::string &tip_frame,
+                                        double search_discretization)
+{
+  if (!solver_->initialize(robot_description, group_name, base_frame, tip_frame, search_discretization))
+    return false;
+  copySolverValues(robot_description);
+  cache_->clear();
+  return true;
+}
+
+bool CachedKinematicsSolver::setRedundantJoints(const std::vector<unsigned int> &redundant_joint_indices)
+{
+  if (!solver_->setRedundantJoints(redundant_joint_indices))
+    return false;
+  kinematics::KinematicsBase::setRedundantJoints(redundant_joint_indices);
+  // solutions found with other redundant joints may not be what the solver would return now
+  cache_->clear();
+  return true;
+}
+
+bool CachedKinematicsSolver::supportsGroup(const robot_model::JointModelGroup *jmg, std::string *error_text_out) const
+{
+  return solver_->supportsGroup(jmg, error_text_out);
+}
+
+const std::vector<std::string>& CachedKinematicsSolver::getJointNames() const
+{
+  return solver_->getJointNames();
+}
+
+const std::vector<std::string>& CachedKinematicsSolver::getLinkNames() const
+{
+  return solver_->getLinkNames();
+}
+
+}
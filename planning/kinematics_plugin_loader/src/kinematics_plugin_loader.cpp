@@ -35,18 +35,45 @@
 /* Author: Ioan Sucan, Dave Coleman */
 
 #include <moveit/kinematics_plugin_loader/kinematics_plugin_loader.h>
+#include <moveit/kinematics_plugin_loader/lazy_kinematics_solver.h>
 #include <moveit/rdf_loader/rdf_loader.h>
 #include <pluginlib/class_loader.h>
 #include <boost/thread/mutex.hpp>
 #include <sstream>
 #include <vector>
 #include <map>
+#include <set>
 #include <ros/ros.h>
 #include <moveit/profiler/profiler.h>
 
 namespace kinematics_plugin_loader
 {
 
+/** \brief Settings of the IK solution cache of a group */
+struct IKCacheSettings
+{
+  IKCacheSettings() : size(0), position_resolution(0.001), orientation_resolution(0.01), max_seed_distance(0.5)
+  {
+  }
+
+  std::size_t size;
+  double position_resolution;
+  double orientation_resolution;
+  double max_seed_distance;
+};
+
+/** \brief Time spent allocating and initializing the solvers of a group */
+struct SolverLoadTime
+{
+  SolverLoadTime() : count(0), total(0.0), max(0.0)
+  {
+  }
+
+  unsigned int count;
+  double total;
+  double max;
+};
+
 class KinematicsPluginLoader::KinematicsLoaderImpl
 {
 public:
@@ -56,16 +83,26 @@ public:
    * \param possible_kinematics_solvers
    * \param search_res
    * \param iksolver_to_tip_links - a map between each ik solver and a vector of custom-specified tip link(s)
+   * \param ik_cache_settings - the groups whose solvers are wrapped in a CachedKinematicsSolver
+   * \param lazy_groups - the groups whose solvers are wrapped in a LazyKinematicsSolver
    */
   KinematicsLoaderImpl(const std::string &robot_description,
                        const std::map<std::string, std::vector<std::string> > &possible_kinematics_solvers,
                        const std::map<std::string, std::vector<double> > &search_res,
-                       const std::map<std::string, std::vector<std::string> > &iksolver_to_tip_links) :
+                       const std::map<std::string, std::vector<std::string> > &iksolver_to_tip_links,
+                       const std::map<std::string, IKCacheSettings> &ik_cache_settings,
+                       const std::set<std::string> &lazy_groups) :
     robot_description_(robot_description),
     possible_kinematics_solvers_(possible_kinematics_solvers),
     search_res_(search_res),
-    iksolver_to_tip_links_(iksolver_to_tip_links)
+    iksolver_to_tip_links_(iksolver_to_tip_links),
+    lazy_groups_(lazy_groups)
   {
+    // all solver instances of a group share one cache
+    for (std::map<std::string, IKCacheSettings>::const_iterator it = ik_cache_settings.begin() ; it != ik_cache_settings.end() ; ++it)
+      ik_caches_[it->first].reset(new IKSolutionCache(it->second.size, it->second.position_resolution, it->second.orientation_resolution,
+                                                      it->second.max_seed_distance));
+
     try
     {
       kinematics_loader_.reset(new pluginlib::ClassLoader<kinematics::KinematicsBase>("moveit_core", "kinematics::KinematicsBase"));
@@ -119,6 +156,18 @@ public:
     return tips;
   }
 
+  /**
+   * \brief Get the frame the kinematics solver of a group is relative to: the parent link of the group
+   * \param jmg - joint model group pointer, with at least one link
+   */
+  std::string chooseBaseFrame(const robot_model::JointModelGroup *jmg) const
+  {
+    const std::vector<const robot_model::LinkModel*> &links = jmg->getLinkModels();
+    const std::string &base = links.front()->getParentJointModel()->getParentLinkModel() ?
+      links.front()->getParentJointModel()->getParentLinkModel()->getName() : jmg->getParentModel().getModelFrame();
+    return (base.empty() || base[0] != '/') ? base : base.substr(1);
+  }
+
   boost::shared_ptr<kinematics::KinematicsBase> allocKinematicsSolver(const robot_model::JointModelGroup *jmg)
   {
     boost::shared_ptr<kinematics::KinematicsBase> result;
@@ -129,6 +178,7 @@ public:
     }
 
     ROS_DEBUG("Received request to allocate kinematics solver for group '%s'", jmg->getName().c_str());
+    ros::WallTime start = ros::WallTime::now();
 
     if (kinematics_loader_ && jmg)
     {
@@ -145,20 +195,15 @@ public:
             result = kinematics_loader_->createInstance(it->second[i]);
             if (result)
             {
-              const std::vector<const robot_model::LinkModel*> &links = jmg->getLinkModels();
-              if (!links.empty())
+              if (!jmg->getLinkModels().empty())
               {
-                const std::string &base = links.front()->getParentJointModel()->getParentLinkModel() ?
-                  links.front()->getParentJointModel()->getParentLinkModel()->getName() : jmg->getParentModel().getModelFrame();
-
                 // choose the tip of the IK solver
                 const std::vector<std::string> tips = chooseTipFrames(jmg);
 
                 // choose search resolution
                 double search_res = search_res_.find(jmg->getName())->second[i]; // we know this exists, by construction
 
-                if (!result->initialize(robot_description_, jmg->getName(),
-                                        (base.empty() || base[0] != '/') ? base : base.substr(1) , tips, search_res))
+                if (!result->initialize(robot_description_, jmg->getName(), chooseBaseFrame(jmg), tips, search_res))
                 {
                   ROS_ERROR("Kinematics solver of type '%s' could not be initialized for group '%s'", it->second[i].c_str(), jmg->getName().c_str());
                   result.reset();
@@ -168,6 +213,15 @@ public:
                   result->setDefaultTimeout(jmg->getDefaultIKTimeout());
                   ROS_DEBUG("Successfully allocated and initialized a kinematics solver of type '%s' with search resolution %lf for group '%s' at address %p",
                             it->second[i].c_str(), search_res, jmg->getName().c_str(), result.get());
+
+                  std::map<std::string, IKSolutionCachePtr>::const_iterator cache = ik_caches_.find(jmg->getName());
+                  if (cache != ik_caches_.end())
+                  {
+                    if (tips.size() == 1)
+                      result.reset(new CachedKinematicsSolver(result, cache->second, robot_description_));
+                    else
+                      ROS_WARN("IK solution cache is not supported for group '%s', which has more than one tip", jmg->getName().c_str());
+                  }
                 }
               }
               else
@@ -189,9 +243,35 @@ public:
       ROS_DEBUG("No usable kinematics solver was found for this group.");
       ROS_DEBUG("Did you load kinematics.yaml into your node's namespace?");
     }
+    else
+    {
+      double duration = (ros::WallTime::now() - start).toSec();
+      ROS_DEBUG_NAMED("kinematics_plugin_loader", "Loaded kinematics solver for group '%s' in %lf seconds", jmg->getName().c_str(), duration);
+      boost::mutex::scoped_lock slock(lock_);
+      SolverLoadTime &load_time = load_times_[jmg->getName()];
+      load_time.count++;
+      load_time.total += duration;
+      load_time.max = std::max(load_time.max, duration);
+    }
     return result;
   }
 
+  /** \brief Allocate a solver for \e jmg, deferring the allocation to the first use of the solver if lazy loading is enabled for the group */
+  boost::shared_ptr<kinematics::KinematicsBase> allocKinematicsSolverOrDefer(const robot_model::JointModelGroup *jmg)
+  {
+    if (!jmg || lazy_groups_.find(jmg->getName()) == lazy_groups_.end() || jmg->getLinkModels().empty())
+      return allocKinematicsSolver(jmg);
+
+    std::map<std::string, std::vector<std::string> >::const_iterator it = possible_kinematics_solvers_.find(jmg->getName());
+    if (!kinematics_loader_ || it == possible_kinematics_solvers_.end())
+      return allocKinematicsSolver(jmg);
+
+    ROS_DEBUG("Deferring the allocation of the kinematics solver for group '%s' to its first use", jmg->getName().c_str());
+    return boost::shared_ptr<kinematics::KinematicsBase>(
+      new LazyKinematicsSolver(boost::bind(&KinematicsLoaderImpl::allocKinematicsSolver, this, jmg), jmg, robot_description_,
+                               chooseBaseFrame(jmg), chooseTipFrames(jmg), search_res_.find(jmg->getName())->second.front()));
+  }
+
   boost::shared_ptr<kinematics::KinematicsBase> allocKinematicsSolverWithCache(const robot_model::JointModelGroup *jmg)
   {
     {
@@ -205,7 +285,7 @@ public:
         }
     }
 
-    boost::shared_ptr<kinematics::KinematicsBase> res = allocKinematicsSolver(jmg);
+    boost::shared_ptr<kinematics::KinematicsBase> res = allocKinematicsSolverOrDefer(jmg);
 
     {
       boost::mutex::scoped_lock slock(lock_);
@@ -214,11 +294,31 @@ public:
     }
   }
 
+  bool getIKCacheStatistics(const std::string &group, IKCacheStatistics &stats) const
+  {
+    std::map<std::string, IKSolutionCachePtr>::const_iterator it = ik_caches_.find(group);
+    if (it == ik_caches_.end())
+      return false;
+    stats = it->second->getStatistics();
+    return true;
+  }
+
   void status() const
   {
     for (std::map<std::string, std::vector<std::string> >::const_iterator it = possible_kinematics_solvers_.begin() ; it != possible_kinematics_solvers_.end() ; ++it)
       for (std::size_t i = 0 ; i < it->second.size() ; ++i)
-        ROS_INFO("Solver for group '%s': '%s' (search resolution = %lf)", it->first.c_str(), it->second[i].c_str(), search_res_.at(it->first)[i]);
+        ROS_INFO("Solver for group '%s': '%s' (search resolution = %lf)%s", it->first.c_str(), it->second[i].c_str(), search_res_.at(it->first)[i],
+                 lazy_groups_.find(it->first) != lazy_groups_.end() ? ", loaded on first use" : "");
+    for (std::map<std::string, IKSolutionCachePtr>::const_iterator it = ik_caches_.begin() ; it != ik_caches_.end() ; ++it)
+    {
+      IKCacheStatistics stats = it->second->getStatistics();
+      ROS_INFO("IK cache for group '%s': %u solutions, %u hits, %u misses, %u seed assists", it->first.c_str(), (unsigned int)stats.size,
+               (unsigned int)stats.hits, (unsigned int)stats.misses, (unsigned int)stats.seed_assists);
+    }
+    boost::mutex::scoped_lock slock(lock_);
+    for (std::map<std::string, SolverLoadTime>::const_iterator it = load_times_.begin() ; it != load_times_.end() ; ++it)
+      ROS_INFO("Loaded %u solver(s) for group '%s' in %lf seconds (max %lf seconds)", it->second.count, it->first.c_str(),
+               it->second.total, it->second.max);
   }
 
 private:
@@ -227,14 +327,22 @@ private:
   std::map<std::string, std::vector<std::string> >                       possible_kinematics_solvers_;
   std::map<std::string, std::vector<double> >                            search_res_;
   std::map<std::string, std::vector<std::string> >                       iksolver_to_tip_links_;  // a map between each ik solver and a vector of custom-specified tip link(s)
+  std::map<std::string, IKSolutionCachePtr>                              ik_caches_;
+  std::set<std::string>                                                  lazy_groups_;
+  std::map<std::string, SolverLoadTime>                                  load_times_;
   boost::shared_ptr<pluginlib::ClassLoader<kinematics::KinematicsBase> > kinematics_loader_;
   std::map<const robot_model::JointModelGroup*,
            std::vector<boost::shared_ptr<kinematics::KinematicsBase> > > instances_;
-  boost::mutex                                                           lock_;
+  mutable boost::mutex                                                   lock_;
 };
 
 }
 
+bool kinematics_plugin_loader::KinematicsPluginLoader::getIKCacheStatistics(const std::string &group, IKCacheStatistics &stats) const
+{
+  return loader_ && loader_->getIKCacheStatistics(group, stats);
+}
+
 void kinematics_plugin_loader::KinematicsPluginLoader::status() const
 {
   if (loader_)
@@ -269,6 +377,8 @@ robot_model::SolverAllocatorFn kinematics_plugin_loader::KinematicsPluginLoader:
     std::map<std::string, std::vector<std::string> > possible_kinematics_solvers;
     std::map<std::string, std::vector<double> > search_res;
     std::map<std::string, std::vector<std::string> > iksolver_to_tip_links;
+    std::map<std::string, IKCacheSettings> ik_cache_settings;
+    std::set<std::string> lazy_groups;
 
     if (srdf_model)
     {
@@ -340,6 +450,44 @@ robot_model::SolverAllocatorFn kinematics_plugin_loader::KinematicsPluginLoader:
               ik_attempts_[known_groups[i].name_] = ksolver_attempts;
           }
 
+          // optional cache of IK solutions for repeated and nearby poses
+          std::string ksolver_cache_size_param_name;
+          if (nh.searchParam(base_param_name + "/kinematics_solver_cache_size", ksolver_cache_size_param_name))
+          {
+            int cache_size;
+            if (nh.getParam(ksolver_cache_size_param_name, cache_size) && cache_size > 0)
+            {
+              IKCacheSettings &settings = ik_cache_settings[known_groups[i].name_];
+              settings.size = cache_size;
+              std::string param_name;
+              if (nh.searchParam(base_param_name + "/kinematics_solver_cache_position_resolution", param_name))
+                nh.getParam(param_name, settings.position_resolution);
+              if (nh.searchParam(base_param_name + "/kinematics_solver_cache_orientation_resolution", param_name))
+                nh.getParam(param_name, settings.orientation_resolution);
+              if (nh.searchParam(base_param_name + "/kinematics_solver_cache_max_seed_distance", param_name))
+                nh.getParam(param_name, settings.max_seed_distance);
+              if (settings.position_resolution <= 0.0 || settings.orientation_resolution <= 0.0 || settings.max_seed_distance < 0.0)
+              {
+                ROS_ERROR("IK cache resolutions for group '%s' must be positive and its maximum seed distance not negative; cache disabled", known_groups[i].name_.c_str());
+                ik_cache_settings.erase(known_groups[i].name_);
+              }
+              else
+                ROS_DEBUG_NAMED("kinematics_plugin_loader","Caching up to %d IK solutions for group '%s'", cache_size, known_groups[i].name_.c_str());
+            }
+          }
+
+          // optionally allocate the solver when it is first used instead of at start-up
+          std::string ksolver_lazy_param_name;
+          if (nh.searchParam(base_param_name + "/kinematics_solver_lazy_loading", ksolver_lazy_param_name))
+          {
+            bool lazy;
+            if (nh.getParam(ksolver_lazy_param_name, lazy) && lazy)
+            {
+              lazy_groups.insert(known_groups[i].name_);
+              ROS_DEBUG_NAMED("kinematics_plugin_loader","Loading the kinematics solver for group '%s' on first use", known_groups[i].name_.c_str());
+            }
+          }
+
           std::string ksolver_res_param_name;
           if (nh.searchParam(base_param_name + "/kinematics_solver_search_resolution", ksolver_res_param_name))
           {
@@ -422,7 +570,7 @@ robot_model::SolverAllocatorFn kinematics_plugin_loader::KinematicsPluginLoader:
       }
     }
 
-    loader_.reset(new KinematicsLoaderImpl(robot_description_, possible_kinematics_solvers, search_res, iksolver_to_tip_links));
+    loader_.reset(new KinematicsLoaderImpl(robot_description_, possible_kinematics_solvers, search_res, iksolver_to_tip_links, ik_cache_settings, lazy_groups));
   }
 
   return boost::bind(&KinematicsPluginLoader::KinematicsLoaderImpl::allocKinematicsSolverWithCache, loader_.get(), _1);
@@ -0,0 +1,248 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/kinematics_plugin_loader/lazy_kinematics_solver.h>
+#include <ros/console.h>
+
+kinematics_plugin_loader::LazyKinematicsSolver::LazyKinematicsSolver(const AllocatorFn &allocator, const robot_model::JointModelGroup *jmg,
+                                                                     const std::string &robot_description, const std::string &base_frame,
+                                                                     const std::vector<std::string> &tip_frames, double search_discretization) :
+  allocator_(allocator),
+  jmg_(jmg),
+  load_failed_(false)
+{
+  setValues(robot_description, jmg->getName(), base_frame, tip_frames, search_discretization);
+  setDefaultTimeout(jmg->getDefaultIKTimeout());
+
+  const std::vector<const robot_model::JointModel*> &joints = jmg->getJointModels();
+  for (std::size_t i = 0 ; i < joints.size() ; ++i)
+    if (joints[i]->getType() == robot_model::JointModel::REVOLUTE || joints[i]->getType() == robot_model::JointModel::PRISMATIC)
+      joint_names_.push_back(joints[i]->getName());
+}
+
+bool kinematics_plugin_loader::LazyKinematicsSolver::isLoaded() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return solver_.get() != NULL;
+}
+
+kinematics::KinematicsBasePtr kinematics_plugin_loader::LazyKinematicsSolver::getSolver() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  if (solver_ || load_failed_)
+    return solver_;
+
+  ROS_DEBUG_NAMED("kinematics_plugin_loader", "Loading kinematics solver for group '%s' on first use", group_name_.c_str());
+  kinematics::KinematicsBasePtr solver = allocator_();
+  load_failed_ = true;
+  if (!solver)
+  {
+    ROS_ERROR_NAMED("kinematics_plugin_loader", "Kinematics solver could not be instantiated for joint group %s.", group_name_.c_str());
+    return solver_;
+  }
+
+  std::string error_msg;
+  if (!solver->supportsGroup(jmg_, &error_msg))
+  {
+    ROS_ERROR_NAMED("kinematics_plugin_loader", "Kinematics solver does not support joint group %s.  Error: %s",
+                    group_name_.c_str(), error_msg.c_str());
+    return solver_;
+  }
+
+  // the robot model mapped its variables to the joint names reported before loading
+  if (solver->getJointNames() != joint_names_)
+  {
+    ROS_ERROR_NAMED("kinematics_plugin_loader", "Kinematics solver for group '%s' does not use the joints of the group in order. "
+                    "Disable lazy loading for this group (kinematics_solver_lazy_loading).", group_name_.c_str());
+    return solver_;
+  }
+
+  if (!redundant_joint_indices_.empty() && !solver->setRedundantJoints(redundant_joint_indices_))
+    ROS_WARN_NAMED("kinematics_plugin_loader", "Unable to set the redundant joints of the kinematics solver for group '%s'", group_name_.c_str());
+
+  // the robot model sets the default timeout on this instance; the solver gets it before it is shared
+  solver->setDefaultTimeout(default_timeout_);
+
+  load_failed_ = false;
+  solver_ = solver;
+  return solver_;
+}
+
+bool kinematics_plugin_loader::LazyKinematicsSolver::getPositionIK(const geometry_msgs::Pose &ik_pose,
+                                                                   const std::vector<double> &ik_seed_state,
+                                                                   std::vector<double> &solution,
+                                                                   moveit_msgs::MoveItErrorCodes &error_code,
+                                                                   const kinematics::KinematicsQueryOptions &options) const
+{
+  kinematics::KinematicsBasePtr solver = getSolver();
+  if (!solver)
+  {
+    error_code.val = moveit_msgs::MoveItErrorCodes::NO_IK_SOLUTION;
+    return false;
+  }
+  return solver->getPositionIK(ik_pose, ik_seed_state, solution, error_code, options);
+}
+
+bool kinematics_plugin_loader::LazyKinematicsSolver::searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                                                      const std::vector<double> &ik_seed_state,
+                                                                      double timeout,
+                                                                      std::vector<double> &solution,
+                                                                      moveit_msgs::MoveItErrorCodes &error_code,
+                                                                      const kinematics::KinematicsQueryOptions &options) const
+{
+  kinematics::KinematicsBasePtr solver = getSolver();
+  if (!solver)
+  {
+    error_code.val = moveit_msgs::MoveItErrorCodes::NO_IK_SOLUTION;
+    return false;
+  }
+  return solver->searchPositionIK(ik_pose, ik_seed_state, timeout, solution, error_code, options);
+}
+
+bool kinematics_plugin_loader::LazyKinematicsSolver::searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                                                      const std::vector<double> &ik_seed_state,
+                                                                      double timeout,
+                                                                      const std::vector<double> &consistency_limits,
+                                                                      std::vector<double> &solution,
+                                                                      moveit_msgs::MoveItErrorCodes &error_code,
+                                                                      const kinematics::KinematicsQueryOptions &options) const
+{
+  kinematics::KinematicsBasePtr solver = getSolver();
+  if (!solver)
+  {
+    error_code.val = moveit_msgs::MoveItErrorCodes::NO_IK_SOLUTION;
+    return false;
+  }
+  return solver->searchPositionIK(ik_pose, ik_seed_state, timeout, consistency_limits, solution, error_code, options);
+}
+
+bool kinematics_plugin_loader::LazyKinematicsSolver::searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                                                      const std::vector<double> &ik_seed_state,
+                                                                      double timeout,
+                                                                      std::vector<double> &solution,
+                                                                      const IKCallbackFn &solution_callback,
+                                                                      moveit_msgs::MoveItErrorCodes &error_code,
+                                                                      const kinematics::KinematicsQueryOptions &options) const
+{
+  kinematics::KinematicsBasePtr solver = getSolver();
+  if (!solver)
+  {
+    error_code.val = moveit_msgs::MoveItErrorCodes::NO_IK_SOLUTION;
+    return false;
+  }
+  return solver->searchPositionIK(ik_pose, ik_seed_state, timeout, solution, solution_callback, error_code, options);
+}
+
+bool kinematics_plugin_loader::LazyKinematicsSolver::searchPositionIK(const geometry_msgs::Pose &ik_pose,
+                                                                      const std::vector<double> &ik_seed_state,
+                                                                      double timeout,
+                                                                      const std::vector<double> &consistency_limits,
+                                                                      std::vector<double> &solution,
+                                                                      const IKCallbackFn &solution_callback,
+                                                                      moveit_msgs::MoveItErrorCodes &error_code,
+                                                                      const kinematics::KinematicsQueryOptions &options) const
+{
+  kinematics::KinematicsBasePtr solver = getSolver();
+  if (!solver)
+  {
+    error_code.val = moveit_msgs::MoveItErrorCodes::NO_IK_SOLUTION;
+    return false;
+  }
+  return solver->searchPositionIK(ik_pose, ik_seed_state, timeout, consistency_limits, solution, solution_callback, error_code, options);
+}
+
+bool kinematics_plugin_loader::LazyKinematicsSolver::searchPositionIK(const std::vector<geometry_msgs::Pose> &ik_poses,
+                                                                      const std::vector<double> &ik_seed_state,
+                                                                      double timeout,
+                                                                      const std::vector<double> &consistency_limits,
+                                                                      std::vector<double> &solution,
+                                                                      const IKCallbackFn &solution_callback,
+                                                                      moveit_msgs::MoveItErrorCodes &error_code,
+                                                                      const kinematics::KinematicsQueryOptions &options) const
+{
+  kinematics::KinematicsBasePtr solver = getSolver();
+  if (!solver)
+  {
+    error_code.val = moveit_msgs::MoveItErrorCodes::NO_IK_SOLUTION;
+    return false;
+  }
+  return solver->searchPositionIK(ik_poses, ik_seed_state, timeout, consistency_limits, solution, solution_callback, error_code, options);
+}
+
+bool kinematics_plugin_loader::LazyKinematicsSolver::getPositionFK(const std::vector<std::string> &link_names,
+                                                                   const std::vector<double> &joint_angles,
+                                                                   std::vector<geometry_msgs::Pose> &poses) const
+{
+  kinematics::KinematicsBasePtr solver = getSolver();
+  return solver && solver->getPositionFK(link_names, joint_angles, poses);
+}
+
+bool kinematics_plugin_loader::LazyKinematicsSolver::initialize(const std::string &robot_description,
+                                                                const std::string &group_name,
+                                                                const std::string &base_frame,
+                                                                const std::string &tip_frame,
+                                                                double search_discretization)
+{
+  // the wrapped solver is initialized by the allocator
+  return group_name == group_name_;
+}
+
+bool kinematics_plugin_loader::LazyKinematicsSolver::supportsGroup(const robot_model::JointModelGroup *jmg, std::string *error_text_out) const
+{
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    if (!solver_)
+      return true;
+  }
+  return solver_->supportsGroup(jmg, error_text_out);
+}
+
+bool kinematics_plugin_loader::LazyKinematicsSolver::setRedundantJoints(const std::vector<unsigned int> &redundant_joint_indices)
+{
+  boost::mutex::scoped_lock slock(lock_);
+  if (solver_ && !solver_->setRedundantJoints(redundant_joint_indices))
+    return false;
+  return kinematics::KinematicsBase::setRedundantJoints(redundant_joint_indices);
+}
+
+const std::vector<std::string>& kinematics_plugin_loader::LazyKinematicsSolver::getJointNames() const
+{
+  return joint_names_;
+}
+
+const std::vector<std::string>& kinematics_plugin_loader::LazyKinematicsSolver::getLinkNames() const
+{
+  kinematics::KinematicsBasePtr solver = getSolver();
+  return solver ? solver->getLinkNames() : getTipFrames();
+}
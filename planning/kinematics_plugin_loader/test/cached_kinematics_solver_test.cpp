@@ -0,0 +1,339 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <moveit/kinematics_plugin_loader/cached_kinematics_solver.h>
+#include <boost/bind.hpp>
+
+using namespace kinematics_plugin_loader;
+
+namespace
+{
+
+// a solver for two joints whose solution is (x, y) of the pose; it records the seeds it was called with
+class FakeSolver : public kinematics::KinematicsBase
+{
+public:
+  FakeSolver()
+  {
+    setValues("robot_description", "arm", "base", "tip", 0.1);
+    joint_names_.push_back("j1");
+    joint_names_.push_back("j2");
+    link_names_.push_back("tip");
+  }
+
+  virtual bool getPositionIK(const geometry_msgs::Pose &ik_pose, const std::vector<double> &ik_seed_state,
+                             std::vector<double> &solution, moveit_msgs::MoveItErrorCodes &error_code,
+                             const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const
+  {
+    return searchPositionIK(ik_pose, ik_seed_state, 1.0, std::vector<double>(), solution, IKCallbackFn(), error_code, options);
+  }
+
+  virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose, const std::vector<double> &ik_seed_state, double timeout,
+                                std::vector<double> &solution, moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const
+  {
+    return searchPositionIK(ik_pose, ik_seed_state, timeout, std::vector<double>(), solution, IKCallbackFn(), error_code, options);
+  }
+
+  virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose, const std::vector<double> &ik_seed_state, double timeout,
+                                const std::vector<double> &consistency_limits, std::vector<double> &solution,
+                                moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const
+  {
+    return searchPositionIK(ik_pose, ik_seed_state, timeout, consistency_limits, solution, IKCallbackFn(), error_code, options);
+  }
+
+  virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose, const std::vector<double> &ik_seed_state, double timeout,
+                                std::vector<double> &solution, const IKCallbackFn &solution_callback,
+                                moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const
+  {
+    return searchPositionIK(ik_pose, ik_seed_state, timeout, std::vector<double>(), solution, solution_callback, error_code, options);
+  }
+
+  virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose, const std::vector<double> &ik_seed_state, double timeout,
+                                const std::vector<double> &consistency_limits, std::vector<double> &solution,
+                                const IKCallbackFn &solution_callback, moveit_msgs::MoveItErrorCodes &error_code,
+                                const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const
+  {
+    seeds_.push_back(ik_seed_state);
+    solution.resize(2);
+    solution[0] = ik_pose.position.x;
+    solution[1] = ik_pose.position.y;
+    if (!solution_callback.empty())
+      solution_callback(ik_pose, solution, error_code);
+    else
+      error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+    return error_code.val == moveit_msgs::MoveItErrorCodes::SUCCESS;
+  }
+
+  virtual bool getPositionFK(const std::vector<std::string> &link_names, const std::vector<double> &joint_angles,
+                             std::vector<geometry_msgs::Pose> &poses) const
+  {
+    return false;
+  }
+
+  virtual bool initialize(const std::string &robot_description, const std::string &group_name,
+                          const std::string &base_frame, const std::string &tip_frame, double search_discretization)
+  {
+    setValues(robot_description, group_name, base_frame, tip_frame, search_discretization);
+    return true;
+  }
+
+  virtual const std::vector<std::string>& getJointNames() const
+  {
+    return joint_names_;
+  }
+
+  virtual const std::vector<std::string>& getLinkNames() const
+  {
+    return link_names_;
+  }
+
+  mutable std::vector<std::vector<double> > seeds_;
+
+private:
+  std::vector<std::string> joint_names_;
+  std::vector<std::string> link_names_;
+};
+
+geometry_msgs::Pose makePose(double x, double y, double z)
+{
+  geometry_msgs::Pose pose;
+  pose.position.x = x;
+  pose.position.y = y;
+  pose.position.z = z;
+  pose.orientation.w = 1.0;
+  return pose;
+}
+
+void rejectAll(const geometry_msgs::Pose &pose, const std::vector<double> &solution, moveit_msgs::MoveItErrorCodes &error_code)
+{
+  error_code.val = moveit_msgs::MoveItErrorCodes::NO_IK_SOLUTION;
+}
+
+}
+
+TEST(IKSolutionCache, LookupAndEviction)
+{
+  IKSolutionCache cache(2, 0.01, 0.01, 1.0);
+  const std::vector<double> seed(1, 1.0);
+  std::vector<double> solution;
+  bool exact;
+  EXPECT_FALSE(cache.lookup(makePose(0.0, 0.0, 0.0), seed, solution, exact));
+
+  cache.insert(makePose(0.0, 0.0, 0.0), std::vector<double>(1, 1.0));
+  ASSERT_TRUE(cache.lookup(makePose(0.0, 0.0, 0.0), seed, solution, exact));
+  EXPECT_TRUE(exact);
+  EXPECT_EQ(1.0, solution[0]);
+
+  // same cell and neighboring cell
+  ASSERT_TRUE(cache.lookup(makePose(0.005, 0.0, 0.0), seed, solution, exact));
+  EXPECT_FALSE(exact);
+  ASSERT_TRUE(cache.lookup(makePose(-0.005, 0.0, 0.0), seed, solution, exact));
+  EXPECT_FALSE(exact);
+  EXPECT_FALSE(cache.lookup(makePose(0.05, 0.0, 0.0), seed, solution, exact));
+
+  // q and -q are the same orientation
+  geometry_msgs::Pose flipped = makePose(0.0, 0.0, 0.0);
+  flipped.orientation.w = -1.0;
+  ASSERT_TRUE(cache.lookup(flipped, seed, solution, exact));
+  EXPECT_TRUE(exact);
+
+  // the least recently used entry is evicted
+  cache.insert(makePose(1.0, 0.0, 0.0), std::vector<double>(1, 2.0));
+  EXPECT_TRUE(cache.lookup(makePose(0.0, 0.0, 0.0), seed, solution, exact));
+  cache.insert(makePose(2.0, 0.0, 0.0), std::vector<double>(1, 3.0));
+  EXPECT_EQ(2u, cache.getStatistics().size);
+  EXPECT_TRUE(cache.lookup(makePose(0.0, 0.0, 0.0), seed, solution, exact));
+  EXPECT_FALSE(cache.lookup(makePose(1.0, 0.0, 0.0), std::vector<double>(1, 2.0), solution, exact));
+  EXPECT_TRUE(cache.lookup(makePose(2.0, 0.0, 0.0), std::vector<double>(1, 3.0), solution, exact));
+
+  cache.clear();
+  EXPECT_EQ(0u, cache.getStatistics().size);
+}
+
+TEST(IKSolutionCache, NearestToSeed)
+{
+  IKSolutionCache cache(10, 0.01, 0.01, 0.5);
+  std::vector<double> solution;
+  bool exact;
+
+  // two branches of the same pose are kept apart; a close solution replaces the previous one of its branch
+  cache.insert(makePose(0.0, 0.0, 0.0), std::vector<double>(1, 1.0));
+  cache.insert(makePose(0.0, 0.0, 0.0), std::vector<double>(1, -1.0));
+  cache.insert(makePose(0.0, 0.0, 0.0), std::vector<double>(1, 1.1));
+  EXPECT_EQ(1u, cache.getStatistics().size);
+
+  ASSERT_TRUE(cache.lookup(makePose(0.0, 0.0, 0.0), std::vector<double>(1, 0.8), solution, exact));
+  EXPECT_TRUE(exact);
+  EXPECT_DOUBLE_EQ(1.1, solution[0]);
+  ASSERT_TRUE(cache.lookup(makePose(0.0, 0.0, 0.0), std::vector<double>(1, -0.7), solution, exact));
+  EXPECT_DOUBLE_EQ(-1.0, solution[0]);
+
+  // solutions too far from the seed are not returned, from this cell or a neighbor
+  EXPECT_FALSE(cache.lookup(makePose(0.0, 0.0, 0.0), std::vector<double>(1, 0.0), solution, exact));
+  EXPECT_FALSE(cache.lookup(makePose(0.005, 0.0, 0.0), std::vector<double>(1, 3.0), solution, exact));
+  EXPECT_FALSE(cache.lookup(makePose(0.0, 0.0, 0.0), std::vector<double>(2, 1.0), solution, exact));
+}
+
+TEST(CachedKinematicsSolver, HitMissAndSeedAssist)
+{
+  boost::shared_ptr<FakeSolver> fake(new FakeSolver());
+  IKSolutionCachePtr cache(new IKSolutionCache(100, 0.01, 0.01, 1.0));
+  CachedKinematicsSolver solver(fake, cache, "robot_description");
+  EXPECT_EQ("arm", solver.getGroupName());
+  EXPECT_EQ("tip", solver.getTipFrame());
+  EXPECT_EQ(2u, solver.getJointNames().size());
+
+  std::vector<double> seed(2, 0.5);
+  std::vector<double> solution;
+  moveit_msgs::MoveItErrorCodes error_code;
+
+  // first query goes to the solver
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.3, 0.2, 0.1), seed, 1.0, solution, error_code));
+  ASSERT_EQ(1u, fake->seeds_.size());
+  EXPECT_EQ(seed, fake->seeds_.back());
+
+  // the same pose is answered from the cache
+  solution.clear();
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.3, 0.2, 0.1), seed, 1.0, solution, error_code));
+  EXPECT_EQ(1u, fake->seeds_.size());
+  ASSERT_EQ(2u, solution.size());
+  EXPECT_DOUBLE_EQ(0.3, solution[0]);
+  EXPECT_DOUBLE_EQ(0.2, solution[1]);
+
+  // a nearby pose is solved from the cached solution
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.302, 0.2, 0.1), seed, 1.0, solution, error_code));
+  ASSERT_EQ(2u, fake->seeds_.size());
+  EXPECT_DOUBLE_EQ(0.3, fake->seeds_.back()[0]);
+  EXPECT_DOUBLE_EQ(0.302, solution[0]);
+
+  // consistency limits are relative to the seed of the caller
+  std::vector<double> limits(2, 10.0);
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.298, 0.2, 0.1), seed, 1.0, limits, solution, error_code));
+  ASSERT_EQ(3u, fake->seeds_.size());
+  EXPECT_EQ(seed, fake->seeds_.back());
+
+  IKCacheStatistics stats = cache->getStatistics();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(2u, stats.misses);
+  EXPECT_EQ(1u, stats.seed_assists);
+
+  // a cached solution far from the seed of the caller is not used
+  std::vector<double> far_seed(2, 5.0);
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.3, 0.2, 0.1), far_seed, 1.0, solution, error_code));
+  ASSERT_EQ(4u, fake->seeds_.size());
+  EXPECT_EQ(far_seed, fake->seeds_.back());
+}
+
+TEST(CachedKinematicsSolver, CachedSolutionsAreChecked)
+{
+  boost::shared_ptr<FakeSolver> fake(new FakeSolver());
+  IKSolutionCachePtr cache(new IKSolutionCache(100, 0.01, 0.01, 1.0));
+  CachedKinematicsSolver solver(fake, cache, "robot_description");
+
+  std::vector<double> seed(2, 0.0);
+  std::vector<double> solution;
+  moveit_msgs::MoveItErrorCodes error_code;
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.3, 0.2, 0.1), seed, 1.0, solution, error_code));
+  EXPECT_EQ(1u, fake->seeds_.size());
+
+  // the cached solution violates the consistency limits
+  std::vector<double> limits(2, 0.1);
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.3, 0.2, 0.1), seed, 1.0, limits, solution, error_code));
+  EXPECT_EQ(2u, fake->seeds_.size());
+
+  // the callback rejects the cached solution, and the solver result as well
+  EXPECT_FALSE(solver.searchPositionIK(makePose(0.3, 0.2, 0.1), seed, 1.0, solution, boost::bind(&rejectAll, _1, _2, _3), error_code));
+  EXPECT_EQ(3u, fake->seeds_.size());
+  EXPECT_EQ(0u, cache->getStatistics().hits);
+
+  // changing the redundant joints invalidates the cache
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.3, 0.2, 0.1), seed, 1.0, solution, error_code));
+  EXPECT_EQ(1u, cache->getStatistics().hits);
+  EXPECT_TRUE(solver.setRedundantJoints(std::vector<unsigned int>()));
+  EXPECT_EQ(0u, cache->getStatistics().size);
+}
+
+TEST(CachedKinematicsSolver, QueryOptions)
+{
+  boost::shared_ptr<FakeSolver> fake(new FakeSolver());
+  IKSolutionCachePtr cache(new IKSolutionCache(100, 0.01, 0.01, 1.0));
+  CachedKinematicsSolver solver(fake, cache, "robot_description");
+
+  std::vector<double> seed(2, 0.0);
+  std::vector<double> solution;
+  moveit_msgs::MoveItErrorCodes error_code;
+
+  // solutions that may be approximate are not cached
+  kinematics::KinematicsQueryOptions approximate;
+  approximate.return_approximate_solution = true;
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.3, 0.2, 0.1), seed, 1.0, solution, error_code, approximate));
+  EXPECT_TRUE(solver.getPositionIK(makePose(0.3, 0.2, 0.1), seed, solution, error_code, approximate));
+  EXPECT_EQ(2u, fake->seeds_.size());
+  EXPECT_EQ(0u, cache->getStatistics().size);
+
+  // but exact solutions are returned to such queries
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.3, 0.2, 0.1), seed, 1.0, solution, error_code));
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.3, 0.2, 0.1), seed, 1.0, solution, error_code, approximate));
+  EXPECT_EQ(3u, fake->seeds_.size());
+  EXPECT_EQ(1u, cache->getStatistics().hits);
+
+  // a cached solution is only returned if its locked redundant joints have the values of the seed
+  EXPECT_TRUE(solver.setRedundantJoints(std::vector<unsigned int>(1, 1)));
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.3, 0.2, 0.1), seed, 1.0, solution, error_code));
+  EXPECT_EQ(4u, fake->seeds_.size());
+  kinematics::KinematicsQueryOptions locked;
+  locked.lock_redundant_joints = true;
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.3, 0.2, 0.1), seed, 1.0, solution, error_code, locked));
+  EXPECT_EQ(5u, fake->seeds_.size());
+  EXPECT_EQ(seed, fake->seeds_.back());
+  std::vector<double> matching_seed(2, 0.0);
+  matching_seed[1] = 0.2;
+  EXPECT_TRUE(solver.getPositionIK(makePose(0.3, 0.2, 0.1), matching_seed, solution, error_code, locked));
+  EXPECT_EQ(5u, fake->seeds_.size());
+
+  // nor is the seed of a nearby pose used in its place
+  EXPECT_TRUE(solver.searchPositionIK(makePose(0.302, 0.2, 0.1), seed, 1.0, solution, error_code, locked));
+  ASSERT_EQ(6u, fake->seeds_.size());
+  EXPECT_EQ(seed, fake->seeds_.back());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -43,6 +43,7 @@
 
 // System
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 // ROS msgs
 #include <geometry_msgs/PoseStamped.h>
@@ -61,6 +62,7 @@
 #include <moveit/lma_kinematics_plugin/joint_mimic.h>
 
 // MoveIt!
+#include <moveit/ik_restart_search/restart_search.h>
 #include <moveit/kinematics_base/kinematics_base.h>
 #include <moveit/robot_model/robot_model.h>
 #include <moveit/robot_state/robot_state.h>
@@ -80,6 +82,8 @@ namespace lma_kinematics_plugin
      */
     LMAKinematicsPlugin();
 
+    virtual ~LMAKinematicsPlugin();
+
     virtual bool getPositionIK(const geometry_msgs::Pose &ik_pose,
                                const std::vector<double> &ik_seed_state,
                                std::vector<double> &solution,
@@ -138,6 +142,28 @@ namespace lma_kinematics_plugin
      */
     const std::vector<std::string>& getLinkNames() const;
 
+    /**
+     * @brief Search from several seeds concurrently. The first search starts at the seed state,
+     * the others at restart configurations; each one keeps restarting as before.
+     * This is also configured by the private parameters parallel_search_threads and parallel_search_return_best.
+     * Must not be called while a search is running.
+     * @param threads The number of concurrent searches; 1 disables the parallel search
+     * @param return_best If false, the first valid solution is returned and the other searches are cancelled.
+     * If true, the other searches finish their current attempt, and the solution callback is called for the solutions
+     * found, closest to the seed first, until one is valid.
+     * @note Solution callbacks are called one at a time, but possibly from different threads, and not after a solution is valid.
+     * Concurrent calls to searchPositionIK() do not wait for each other: while one uses the threads of the parallel search,
+     * the others search in the calling thread only.
+     */
+    void setParallelSearch(unsigned int threads, bool return_best = false);
+
+    /**
+     * @brief Set how the configurations a search restarts from are chosen.
+     * This is also configured by the private parameters restart_seeding ("uniform", "gaussian" or "halton")
+     * and restart_gaussian_stddev. Must not be called while a search is running.
+     */
+    void setRestartSeeding(ik_restart_search::SeedingStrategy strategy, double gaussian_stddev = 0.3);
+
   protected:
 
   /**
@@ -168,6 +194,32 @@ namespace lma_kinematics_plugin
 
   private:
 
+    /** @brief The solvers used by a search. They keep intermediate results, so concurrent searches need separate instances. */
+    struct IKSolvers
+    {
+      IKSolvers(const LMAKinematicsPlugin &plugin);
+
+      KDL::ChainFkSolverPos_recursive fk_solver_;
+      KDL::ChainIkSolverPos_LMA ik_solver_;
+      KDL::ChainIkSolverVel_pinv_mimic ik_solver_vel_;
+      KDL::ChainIkSolverPos_LMA_JL_Mimic ik_solver_pos_;
+      random_numbers::RandomNumberGenerator rng_;
+
+      /** The value of solver_generation_ when the solvers were created */
+      unsigned int generation_;
+
+      /** False if the redundant joints could not be set on the velocity solver */
+      bool redundancy_valid_;
+    };
+    typedef boost::shared_ptr<IKSolvers> IKSolversPtr;
+
+    /** @brief Runs the solvers of one call to searchPositionIK() for the restart search */
+    class IKRestartProblem;
+
+    IKSolversPtr acquireSolvers() const;
+
+    void releaseSolvers(const IKSolversPtr &solvers) const;
+
     bool timedOut(const ros::WallTime &start_time, double duration) const;
 
 
@@ -186,19 +238,6 @@ namespace lma_kinematics_plugin
 
     int getKDLSegmentIndex(const std::string &name) const;
 
-    void getRandomConfiguration(KDL::JntArray &jnt_array, bool lock_redundancy) const;
-
-    /** @brief Get a random configuration within joint limits close to the seed state
-     *  @param seed_state Seed state
-     *  @param redundancy Index of the redundant joint within the chain
-     *  @param consistency_limit The returned state will contain a value for the redundant joint in the range [seed_state(redundancy_limit)-consistency_limit,seed_state(redundancy_limit)+consistency_limit]
-     *  @param jnt_array Returned random configuration
-     */
-    void getRandomConfiguration(const KDL::JntArray& seed_state,
-                                const std::vector<double> &consistency_limits,
-                                KDL::JntArray &jnt_array,
-                                bool lock_redundancy) const;
-
     bool isRedundantJoint(unsigned int index) const;
 
     bool active_; /** Internal variable that indicates whether solvers are configured and ready */
@@ -213,8 +252,6 @@ namespace lma_kinematics_plugin
 
     KDL::JntArray joint_min_, joint_max_; /** Joint limits */
 
-    mutable random_numbers::RandomNumberGenerator random_number_generator_;
-
     robot_model::RobotModelPtr robot_model_;
 
     robot_state::RobotStatePtr state_, state_2_;
@@ -229,6 +266,15 @@ namespace lma_kinematics_plugin
     double epsilon_;
     std::vector<JointMimic> mimic_joints_;
 
+    /** Solvers that are not in use by a search */
+    mutable std::vector<IKSolversPtr> solver_pool_;
+    mutable boost::mutex solver_pool_lock_;
+
+    /** Incremented when the solvers need to be created again, e.g. after the redundant joints changed */
+    unsigned int solver_generation_;
+
+    /** Restarts the solvers from new configurations, possibly from several threads */
+    ik_restart_search::RestartSearch restart_search_;
   };
 }
 
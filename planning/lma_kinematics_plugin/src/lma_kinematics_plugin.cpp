@@ -46,71 +46,184 @@
 
 #include <moveit/rdf_loader/rdf_loader.h>
 
+#include <algorithm>
+
 //register KDLKinematics as a KinematicsBase implementation
 CLASS_LOADER_REGISTER_CLASS(lma_kinematics_plugin::LMAKinematicsPlugin, kinematics::KinematicsBase)
 
 namespace lma_kinematics_plugin
 {
 
-  LMAKinematicsPlugin::LMAKinematicsPlugin():active_(false) {}
+namespace
+{
 
-void LMAKinematicsPlugin::getRandomConfiguration(KDL::JntArray &jnt_array, bool lock_redundancy) const
+/** \brief The weights of the position and orientation errors used by the Levenberg-Marquardt solver */
+Eigen::Matrix<double, 6, 1> getLMAWeights()
 {
-  std::vector<double> jnt_array_vector(dimension_, 0.0);
-  state_->setToRandomPositions(joint_model_group_);
-  state_->copyJointGroupPositions(joint_model_group_, &jnt_array_vector[0]);
-  for (std::size_t i = 0; i < dimension_; ++i)
-  {
-    if (lock_redundancy)
-      if (isRedundantJoint(i))
-        continue;
-    jnt_array(i) = jnt_array_vector[i];
-  }
+  Eigen::Matrix<double, 6, 1> L;
+  L(0) = 1;
+  L(1) = 1;
+  L(2) = 1;
+  L(3) = 0.01;
+  L(4) = 0.01;
+  L(5) = 0.01;
+  return L;
 }
 
-bool LMAKinematicsPlugin::isRedundantJoint(unsigned int index) const
-{
-  for (std::size_t j=0; j < redundant_joint_indices_.size(); ++j)
-    if (redundant_joint_indices_[j] == index)
-      return true;
-  return false;
 }
 
-void LMAKinematicsPlugin::getRandomConfiguration(const KDL::JntArray &seed_state,
-                                                 const std::vector<double> &consistency_limits,
-                                                 KDL::JntArray &jnt_array,
-                                                 bool lock_redundancy) const
+class LMAKinematicsPlugin::IKRestartProblem : public ik_restart_search::RestartProblem
 {
-  std::vector<double> values(dimension_, 0.0);
-  std::vector<double> near(dimension_, 0.0);
-  for (std::size_t i = 0 ; i < dimension_; ++i)
-    near[i] = seed_state(i);
+public:
+
+  IKRestartProblem(const LMAKinematicsPlugin &plugin,
+                   const geometry_msgs::Pose &ik_pose,
+                   const KDL::Frame &pose_desired,
+                   const KDL::JntArray &jnt_seed_state,
+                   const std::vector<double> &consistency_limits,
+                   const IKCallbackFn &solution_callback,
+                   const kinematics::KinematicsQueryOptions &options,
+                   moveit_msgs::MoveItErrorCodes &error_code) :
+    plugin_(plugin),
+    ik_pose_(ik_pose),
+    pose_desired_(pose_desired),
+    jnt_seed_state_(jnt_seed_state),
+    consistency_limits_(consistency_limits),
+    solution_callback_(solution_callback),
+    options_(options),
+    error_code_(error_code),
+    solvers_(plugin.restart_search_.getThreads()),
+    candidate_(plugin.dimension_)
+  {
+  }
 
-  // Need to resize the consistency limits to remove mimic joints
-  std::vector<double> consistency_limits_mimic;
-  for(std::size_t i = 0; i < dimension_; ++i)
+  virtual ~IKRestartProblem()
   {
-    if(!mimic_joints_[i].active)
-      continue;
-    consistency_limits_mimic.push_back(consistency_limits[i]);
+    for (std::size_t i = 0 ; i < solvers_.size() ; ++i)
+      if (solvers_[i])
+        plugin_.releaseSolvers(solvers_[i]);
   }
 
-  joint_model_group_->getVariableRandomPositionsNearBy(state_->getRandomNumberGenerator(), values, near, consistency_limits_mimic);
-  
-  for (std::size_t i = 0; i < dimension_; ++i)
+  /** @brief The solvers of a search, taken from the pool on first use. Each search only accesses its own entry. */
+  IKSolvers& getSolvers(unsigned int worker)
   {
-    bool skip = false;
-    if (lock_redundancy)
-      for (std::size_t j = 0; j < redundant_joint_indices_.size(); ++j)
-        if (redundant_joint_indices_[j] == i)
-        {
-          skip = true;
-          break;
-        }
-    if (skip)
-      continue;
-    jnt_array(i) = values[i];
+    if (!solvers_[worker])
+    {
+      solvers_[worker] = plugin_.acquireSolvers();
+      if (options_.lock_redundant_joints)
+        solvers_[worker]->ik_solver_vel_.lockRedundantJoints();
+      else
+        solvers_[worker]->ik_solver_vel_.unlockRedundantJoints();
+    }
+    return *solvers_[worker];
+  }
+
+  virtual bool attempt(unsigned int worker, const KDL::JntArray &start, KDL::JntArray &result)
+  {
+    IKSolvers &solvers = getSolvers(worker);
+    if (!solvers.redundancy_valid_)
+      return false;
+    int ik_valid = solvers.ik_solver_pos_.CartToJnt(start, pose_desired_, result);
+    ROS_DEBUG_NAMED("lma","IK valid: %d", ik_valid);
+    if (ik_valid < 0 && !options_.return_approximate_solution)
+      return false;
+    if (!consistency_limits_.empty() && !plugin_.checkConsistency(jnt_seed_state_, consistency_limits_, result))
+    {
+      ROS_DEBUG_NAMED("lma","Could not find IK solution: does not match consistency limits");
+      return false;
+    }
+    return true;
+  }
+
+  virtual bool accept(const KDL::JntArray &candidate)
+  {
+    for (unsigned int j = 0 ; j < plugin_.dimension_ ; ++j)
+      candidate_[j] = candidate(j);
+    if (!solution_callback_.empty())
+      solution_callback_(ik_pose_, candidate_, error_code_);
+    else
+      error_code_.val = error_code_.SUCCESS;
+    return error_code_.val == error_code_.SUCCESS;
   }
+
+  virtual random_numbers::RandomNumberGenerator& getRandomNumberGenerator(unsigned int worker)
+  {
+    return getSolvers(worker).rng_;
+  }
+
+private:
+
+  const LMAKinematicsPlugin &plugin_;
+  const geometry_msgs::Pose &ik_pose_;
+  const KDL::Frame &pose_desired_;
+  const KDL::JntArray &jnt_seed_state_;
+  const std::vector<double> &consistency_limits_;
+  const IKCallbackFn &solution_callback_;
+  const kinematics::KinematicsQueryOptions &options_;
+  moveit_msgs::MoveItErrorCodes &error_code_;
+  std::vector<IKSolversPtr> solvers_;
+  std::vector<double> candidate_;
+};
+
+LMAKinematicsPlugin::IKSolvers::IKSolvers(const LMAKinematicsPlugin &plugin) :
+  fk_solver_(plugin.kdl_chain_),
+  ik_solver_(plugin.kdl_chain_, getLMAWeights(), plugin.epsilon_, plugin.max_solver_iterations_),
+  ik_solver_vel_(plugin.kdl_chain_, plugin.joint_model_group_->getMimicJointModels().size(),
+                 plugin.redundant_joint_indices_.size(), plugin.position_ik_),
+  ik_solver_pos_(plugin.kdl_chain_, plugin.joint_min_, plugin.joint_max_, fk_solver_, ik_solver_,
+                 plugin.max_solver_iterations_, plugin.epsilon_, plugin.position_ik_),
+  generation_(plugin.solver_generation_)
+{
+  ik_solver_vel_.setMimicJoints(plugin.mimic_joints_);
+  ik_solver_pos_.setMimicJoints(plugin.mimic_joints_);
+  redundancy_valid_ = plugin.redundant_joint_indices_.empty() ||
+    ik_solver_vel_.setRedundantJointsMapIndex(plugin.redundant_joints_map_index_);
+}
+
+LMAKinematicsPlugin::LMAKinematicsPlugin():active_(false), solver_generation_(0) {}
+
+LMAKinematicsPlugin::~LMAKinematicsPlugin()
+{
+}
+
+LMAKinematicsPlugin::IKSolversPtr LMAKinematicsPlugin::acquireSolvers() const
+{
+  {
+    boost::mutex::scoped_lock slock(solver_pool_lock_);
+    if (!solver_pool_.empty())
+    {
+      IKSolversPtr solvers = solver_pool_.back();
+      solver_pool_.pop_back();
+      return solvers;
+    }
+  }
+  return IKSolversPtr(new IKSolvers(*this));
+}
+
+void LMAKinematicsPlugin::releaseSolvers(const IKSolversPtr &solvers) const
+{
+  boost::mutex::scoped_lock slock(solver_pool_lock_);
+  // solvers created before the configuration changed are dropped
+  if (solvers->generation_ == solver_generation_)
+    solver_pool_.push_back(solvers);
+}
+
+void LMAKinematicsPlugin::setParallelSearch(unsigned int threads, bool return_best)
+{
+  restart_search_.setThreads(threads, return_best);
+}
+
+void LMAKinematicsPlugin::setRestartSeeding(ik_restart_search::SeedingStrategy strategy, double gaussian_stddev)
+{
+  restart_search_.setSeeding(strategy, gaussian_stddev);
+}
+
+bool LMAKinematicsPlugin::isRedundantJoint(unsigned int index) const
+{
+  for (std::size_t j=0; j < redundant_joint_indices_.size(); ++j)
+    if (redundant_joint_indices_[j] == index)
+      return true;
+  return false;
 }
 
 bool LMAKinematicsPlugin::checkConsistency(const KDL::JntArray& seed_state,
@@ -211,6 +324,22 @@ bool LMAKinematicsPlugin::initialize(const std::string &robot_description,
   private_handle.param("max_solver_iterations", max_solver_iterations, 500);
   private_handle.param("epsilon", epsilon, 1e-5);
   private_handle.param(group_name+"/position_only_ik", position_ik, false);
+
+  int parallel_search_threads;
+  bool parallel_search_return_best;
+  private_handle.param("parallel_search_threads", parallel_search_threads, 1);
+  private_handle.param("parallel_search_return_best", parallel_search_return_best, false);
+
+  std::string restart_seeding;
+  double restart_gaussian_stddev;
+  private_handle.param("restart_seeding", restart_seeding, std::string("uniform"));
+  private_handle.param("restart_gaussian_stddev", restart_gaussian_stddev, 0.3);
+  ik_restart_search::SeedingStrategy seeding_strategy;
+  if (!ik_restart_search::parseSeedingStrategy(restart_seeding, seeding_strategy))
+  {
+    ROS_WARN_NAMED("lma","Unknown restart seeding strategy '%s', using uniform restarts", restart_seeding.c_str());
+    seeding_strategy = ik_restart_search::UNIFORM;
+  }
   ROS_DEBUG_NAMED("lma","Looking in private handle: %s for param name: %s",
             private_handle.getNamespace().c_str(),
             (group_name+"/position_only_ik").c_str());
@@ -281,6 +410,16 @@ bool LMAKinematicsPlugin::initialize(const std::string &robot_description,
   max_solver_iterations_ = max_solver_iterations;
   epsilon_ = epsilon;
 
+  {
+    boost::mutex::scoped_lock slock(solver_pool_lock_);
+    solver_pool_.clear();
+    ++solver_generation_;
+  }
+  setParallelSearch(std::max(parallel_search_threads, 1), parallel_search_return_best);
+  setRestartSeeding(seeding_strategy, restart_gaussian_stddev);
+  if (restart_search_.getThreads() > 1)
+    ROS_INFO_NAMED("lma","Using %u parallel IK searches", restart_search_.getThreads());
+
   active_ = true;
   ROS_DEBUG_NAMED("lma","KDL solver initialized");
   return true;
@@ -341,6 +480,11 @@ bool LMAKinematicsPlugin::setRedundantJoints(const std::vector<unsigned int> &re
 
   redundant_joints_map_index_ = redundant_joints_map_index;
   redundant_joint_indices_ = redundant_joints;
+
+  // the velocity solver is sized for the number of redundant joints
+  boost::mutex::scoped_lock slock(solver_pool_lock_);
+  solver_pool_.clear();
+  ++solver_generation_;
   return true;
 }
 
@@ -498,35 +642,7 @@ bool LMAKinematicsPlugin::searchPositionIK(const geometry_msgs::Pose &ik_pose,
   }
 
   KDL::JntArray jnt_seed_state(dimension_);
-  KDL::JntArray jnt_pos_in(dimension_);
   KDL::JntArray jnt_pos_out(dimension_);
-  
-  // Build Solvers
-	Eigen::Matrix<double, 6, 1> L;
-	L(0) = 1;
-	L(1) = 1;
-	L(2) = 1;
-	L(3) = 0.01;
-	L(4) = 0.01;
-	L(5) = 0.01;
-
-  KDL::ChainFkSolverPos_recursive fk_solver(kdl_chain_);
-  KDL::ChainIkSolverPos_LMA ik_solver(kdl_chain_, L, epsilon_, max_solver_iterations_); 
-  KDL::ChainIkSolverVel_pinv_mimic ik_solver_vel(kdl_chain_, joint_model_group_->getMimicJointModels().size(), redundant_joint_indices_.size(), position_ik_);
-  KDL::ChainIkSolverPos_LMA_JL_Mimic ik_solver_pos(kdl_chain_, joint_min_, joint_max_, fk_solver, ik_solver, max_solver_iterations_, epsilon_, position_ik_);
-  ik_solver_vel.setMimicJoints(mimic_joints_);
-  ik_solver_pos.setMimicJoints(mimic_joints_);
-
-  if ((redundant_joint_indices_.size() > 0) && !ik_solver_vel.setRedundantJointsMapIndex(redundant_joints_map_index_))
-  {
-    ROS_ERROR_NAMED("lma","Could not set redundant joints");
-    return false;
-  }
-
-  if(options.lock_redundant_joints)
-  {
-    ik_solver_vel.lockRedundantJoints();
-  }
 
   solution.resize(dimension_);
 
@@ -544,63 +660,39 @@ bool LMAKinematicsPlugin::searchPositionIK(const geometry_msgs::Pose &ik_pose,
   //Do the IK
   for(unsigned int i=0; i < dimension_; i++)
     jnt_seed_state(i) = ik_seed_state[i];
-  jnt_pos_in = jnt_seed_state;
 
-  unsigned int counter(0);
-  while(1)
+  ik_restart_search::RestartBounds bounds;
+  bounds.min_ = joint_min_;
+  bounds.max_ = joint_max_;
+  bounds.consistency_limits_ = consistency_limits;
+  if (options.lock_redundant_joints)
   {
-    //    ROS_DEBUG_NAMED("lma","Iteration: %d, time: %f, Timeout: %f",counter,(ros::WallTime::now()-n1).toSec(),timeout);
-    counter++;
-    if(timedOut(n1,timeout))
-    {
-      ROS_DEBUG_NAMED("lma","IK timed out");
-      error_code.val = error_code.TIMED_OUT;
-      ik_solver_vel.unlockRedundantJoints();
-      return false;
-    }
-    int ik_valid = ik_solver_pos.CartToJnt(jnt_pos_in, pose_desired, jnt_pos_out);
-    ROS_DEBUG_NAMED("lma","IK valid: %d", ik_valid);
-    if(!consistency_limits.empty())
-    {
-      getRandomConfiguration(jnt_seed_state, consistency_limits, jnt_pos_in, options.lock_redundant_joints);
-      if( (ik_valid < 0 && !options.return_approximate_solution) || !checkConsistency(jnt_seed_state, consistency_limits, jnt_pos_out))
-      {
-        ROS_DEBUG_NAMED("lma","Could not find IK solution: does not match consistency limits");
-        continue;
-      }
-    }
-    else
-    {
-      getRandomConfiguration(jnt_pos_in, options.lock_redundant_joints);
-      ROS_DEBUG_NAMED("lma","New random configuration");
-      for(unsigned int j=0; j < dimension_; j++)
-        ROS_DEBUG_NAMED("lma","%d %f", j, jnt_pos_in(j));
+    bounds.locked_.resize(dimension_);
+    for (unsigned int i = 0 ; i < dimension_ ; ++i)
+      bounds.locked_[i] = isRedundantJoint(i);
+  }
 
-      if(ik_valid < 0 && !options.return_approximate_solution)
-      {
-        ROS_DEBUG_NAMED("lma","Could not find IK solution");
-        continue;
-      }
-    }
-    ROS_DEBUG_NAMED("lma","Found IK solution");
-    for(unsigned int j=0; j < dimension_; j++)
-      solution[j] = jnt_pos_out(j);
-    if(!solution_callback.empty())
-      solution_callback(ik_pose,solution,error_code);
-    else
-      error_code.val = error_code.SUCCESS;
+  IKRestartProblem problem(*this, ik_pose, pose_desired, jnt_seed_state, consistency_limits, solution_callback,
+                           options, error_code);
+  if (!problem.getSolvers(0).redundancy_valid_)
+  {
+    ROS_ERROR_NAMED("lma","Could not set redundant joints");
+    return false;
+  }
 
-    if(error_code.val == error_code.SUCCESS)
-    {
-      ROS_DEBUG_STREAM_NAMED("lma","Solved after " << counter << " iterations");
-      ik_solver_vel.unlockRedundantJoints();
-      return true;
-    }
+  ik_restart_search::RestartStatistics statistics;
+  if (!restart_search_.search(problem, jnt_seed_state, bounds, n1, timeout, jnt_pos_out, &statistics))
+  {
+    ROS_DEBUG_NAMED("lma","IK timed out after %u attempts", statistics.attempts);
+    error_code.val = error_code.TIMED_OUT;
+    return false;
   }
-  ROS_DEBUG_NAMED("lma","An IK that satisifes the constraints and is collision free could not be found");
-  error_code.val = error_code.NO_IK_SOLUTION;
-  ik_solver_vel.unlockRedundantJoints();
-  return false;
+
+  ROS_DEBUG_STREAM_NAMED("lma","Solved after " << statistics.attempts << " iterations");
+  for(unsigned int j=0; j < dimension_; j++)
+    solution[j] = jnt_pos_out(j);
+  error_code.val = error_code.SUCCESS;
+  return true;
 }
 
 bool LMAKinematicsPlugin::getPositionFK(const std::vector<std::string> &link_names,
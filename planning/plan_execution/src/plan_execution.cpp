@@ -273,6 +273,7 @@ bool plan_execution::PlanExecution::isRemainingPathValid(const ExecutableMotionP
   if (path_segment.first >= 0 && path_segment.second >= 0 && plan.plan_components_[path_segment.first].trajectory_monitoring_)
   {
     planning_scene_monitor::LockedPlanningSceneRO lscene(plan.planning_scene_monitor_); // lock the scene so that it does not modify the world representation while isStateValid() is called
+    const planning_scene::PlanningSceneConstPtr &scene = lscene.getSceneForReading(plan.planning_scene_);
     const robot_trajectory::RobotTrajectory &t = *plan.plan_components_[path_segment.first].trajectory_;
     const collision_detection::AllowedCollisionMatrix *acm = plan.plan_components_[path_segment.first].allowed_collision_matrix_.get();
     std::size_t wpc = t.getWayPointCount();
@@ -282,23 +283,23 @@ bool plan_execution::PlanExecution::isRemainingPathValid(const ExecutableMotionP
     {
       collision_detection::CollisionResult res;
       if (acm)
-        plan.planning_scene_->checkCollisionUnpadded(req, res, t.getWayPoint(i), *acm);
+        scene->checkCollisionUnpadded(req, res, t.getWayPoint(i), *acm);
       else
-        plan.planning_scene_->checkCollisionUnpadded(req, res, t.getWayPoint(i));
+        scene->checkCollisionUnpadded(req, res, t.getWayPoint(i));
 
-      if (res.collision || !plan.planning_scene_->isStateFeasible(t.getWayPoint(i), false))
+      if (res.collision || !scene->isStateFeasible(t.getWayPoint(i), false))
       {
         // Dave's debacle
         ROS_INFO("Trajectory component '%s' is invalid", plan.plan_components_[path_segment.first].description_.c_str());
 
         // call the same functions again, in verbose mode, to show what issues have been detected
-        plan.planning_scene_->isStateFeasible(t.getWayPoint(i), true);
+        scene->isStateFeasible(t.getWayPoint(i), true);
         req.verbose = true;
         res.clear();
         if (acm)
-          plan.planning_scene_->checkCollisionUnpadded(req, res, t.getWayPoint(i), *acm);
+          scene->checkCollisionUnpadded(req, res, t.getWayPoint(i), *acm);
         else
-          plan.planning_scene_->checkCollisionUnpadded(req, res, t.getWayPoint(i));
+          scene->checkCollisionUnpadded(req, res, t.getWayPoint(i));
         return false;
       }
     }
@@ -0,0 +1,150 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/kdl_kinematics_plugin/chain_batch_kinematics.hpp>
+#include <kdl/chainfksolverpos_recursive.hpp>
+#include <kdl/chainjnttojacsolver.hpp>
+#include <random_numbers/random_numbers.h>
+#include <ros/time.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <iostream>
+#include <cstdio>
+
+// a 7 DOF arm with a tool frame, so the benchmark does not depend on a particular robot
+KDL::Chain buildArm()
+{
+  KDL::Chain chain;
+  chain.addSegment(KDL::Segment("link1", KDL::Joint(KDL::Joint::RotZ), KDL::Frame(KDL::Vector(0.0, 0.0, 0.31))));
+  chain.addSegment(KDL::Segment("link2", KDL::Joint(KDL::Joint::RotY), KDL::Frame(KDL::Vector(0.0, 0.0, 0.2))));
+  chain.addSegment(KDL::Segment("link3", KDL::Joint(KDL::Joint::RotZ), KDL::Frame(KDL::Vector(0.0, 0.0, 0.2))));
+  chain.addSegment(KDL::Segment("link4", KDL::Joint(KDL::Joint::RotY), KDL::Frame(KDL::Vector(0.0, 0.0, 0.2))));
+  chain.addSegment(KDL::Segment("link5", KDL::Joint(KDL::Joint::RotZ), KDL::Frame(KDL::Vector(0.0, 0.0, 0.19))));
+  chain.addSegment(KDL::Segment("link6", KDL::Joint(KDL::Joint::RotY), KDL::Frame(KDL::Vector(0.0, 0.0, 0.078))));
+  chain.addSegment(KDL::Segment("link7", KDL::Joint(KDL::Joint::RotZ), KDL::Frame(KDL::Vector(0.0, 0.0, 0.0))));
+  chain.addSegment(KDL::Segment("tool", KDL::Joint(KDL::Joint::None), KDL::Frame(KDL::Vector(0.0, 0.0, 0.1))));
+  return chain;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned int configurations = 100000;
+  unsigned int links = 1;
+  bool jacobians = false;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("configurations", boost::program_options::value<unsigned int>(&configurations)->default_value(configurations), "Number of joint configurations")
+    ("links", boost::program_options::value<unsigned int>(&links)->default_value(links), "Number of requested links, counted back from the tool frame (1 to 8)")
+    ("jacobians", "Also compute the Jacobian of every requested link")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+  jacobians = vm.count("jacobians");
+
+  const KDL::Chain chain = buildArm();
+  const unsigned int joints = chain.getNrOfJoints();
+  if (vm.count("help") || configurations == 0 || links == 0 || links > chain.getNrOfSegments())
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  ros::Time::init();
+
+  random_numbers::RandomNumberGenerator rng;
+  std::vector<double> q(configurations * joints);
+  for (std::size_t i = 0 ; i < q.size() ; ++i)
+    q[i] = rng.uniformReal(-M_PI, M_PI);
+
+  std::vector<std::string> names;
+  for (unsigned int i = chain.getNrOfSegments() - links ; i < chain.getNrOfSegments() ; ++i)
+    names.push_back(chain.getSegment(i).getName());
+
+  // what getPositionFK used to do: look up each link by name, then compute it from the base
+  double checksum_loop = 0.0;
+  ros::WallTime start = ros::WallTime::now();
+  {
+    KDL::ChainFkSolverPos_recursive fk_solver(chain);
+    KDL::ChainJntToJacSolver jac_solver(chain);
+    KDL::JntArray jnt(joints);
+    KDL::Jacobian jac(joints);
+    KDL::Frame frame;
+    for (unsigned int c = 0 ; c < configurations ; ++c)
+    {
+      for (unsigned int j = 0 ; j < joints ; ++j)
+        jnt(j) = q[c * joints + j];
+      for (std::size_t l = 0 ; l < names.size() ; ++l)
+      {
+        int segment = -1;
+        for (unsigned int s = 0 ; s < chain.getNrOfSegments() ; ++s)
+          if (chain.getSegment(s).getName() == names[l])
+          {
+            segment = s + 1;
+            break;
+          }
+        fk_solver.JntToCart(jnt, frame, segment);
+        checksum_loop += frame.p.x();
+        if (jacobians)
+        {
+          jac_solver.JntToJac(jnt, jac, segment);
+          checksum_loop += jac(0, 0);
+        }
+      }
+    }
+  }
+  double loop_time = (ros::WallTime::now() - start).toSec();
+
+  double checksum_batch = 0.0;
+  start = ros::WallTime::now();
+  kdl_kinematics_plugin::ChainBatchKinematics batch(chain);
+  kdl_kinematics_plugin::BatchKinematicsResult result;
+  std::vector<int> segments;
+  batch.getSegmentIndices(names, segments);
+  batch.compute(segments, &q[0], configurations, result, jacobians);
+  double batch_time = (ros::WallTime::now() - start).toSec();
+  for (std::size_t l = 0 ; l < names.size() ; ++l)
+    for (unsigned int c = 0 ; c < configurations ; ++c)
+    {
+      checksum_batch += result.x[result.index(l, c)];
+      if (jacobians)
+        checksum_batch += result.jacobians[result.index(l, c) * 6 * joints];
+    }
+
+  printf("%u configurations of a %u DOF chain, %u link(s)%s\n", configurations, joints, links, jacobians ? " with Jacobians" : "");
+  printf("per link solver calls: %8.3f s, %12.0f configurations/s\n", loop_time, configurations / loop_time);
+  printf("batch:                 %8.3f s, %12.0f configurations/s (%.2fx)\n", batch_time, configurations / batch_time, loop_time / batch_time);
+  printf("checksum difference: %g\n", fabs(checksum_loop - checksum_batch));
+  return 0;
+}
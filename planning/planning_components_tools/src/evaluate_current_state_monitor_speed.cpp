@@ -0,0 +1,194 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_scene_monitor/current_state_monitor.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/profiler/profiler.h>
+#include <urdf/model.h>
+#include <srdfdom/model.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <ctime>
+
+static const std::string ROBOT_DESCRIPTION = "robot_description";
+
+// build a serial chain of revolute joints, so the benchmark does not depend on a particular robot
+robot_model::RobotModelPtr buildChainModel(unsigned int joints)
+{
+  std::stringstream urdf;
+  urdf << "<?xml version=\"1.0\" ?><robot name=\"chain\"><link name=\"link0\"/>";
+  for (unsigned int i = 1 ; i <= joints ; ++i)
+  {
+    urdf << "<link name=\"link" << i << "\"/>"
+         << "<joint name=\"joint" << i << "\" type=\"revolute\">"
+         << "<parent link=\"link" << i - 1 << "\"/><child link=\"link" << i << "\"/>"
+         << "<origin xyz=\"0 0 0.1\" rpy=\"0 0 0\"/><axis xyz=\"0 0 1\"/>"
+         << "<limit lower=\"-3.14\" upper=\"3.14\" effort=\"10\" velocity=\"1\"/></joint>";
+  }
+  urdf << "</robot>";
+  boost::shared_ptr<urdf::Model> urdf_model(new urdf::Model());
+  urdf_model->initString(urdf.str());
+  boost::shared_ptr<srdf::Model> srdf_model(new srdf::Model());
+  srdf_model->initString(*urdf_model, "<?xml version=\"1.0\" ?><robot name=\"chain\"></robot>");
+  return robot_model::RobotModelPtr(new robot_model::RobotModel(urdf_model, srdf_model));
+}
+
+// publish joint states with a fixed, publisher specific, ordering of the joint names
+void publishJointStates(unsigned int id, const std::string &topic, const robot_model::RobotModelConstPtr &model,
+                        double rate, const volatile bool *done)
+{
+  ros::NodeHandle nh;
+  ros::Publisher pub = nh.advertise<sensor_msgs::JointState>(topic, 100);
+  sensor_msgs::JointState js;
+  const std::vector<const robot_model::JointModel*> &joints = model->getSingleDOFJointModels();
+  for (std::size_t i = 0 ; i < joints.size() ; ++i)
+    js.name.push_back(joints[i]->getName());
+  srand(id + 1);
+  std::random_shuffle(js.name.begin(), js.name.end());
+  js.position.resize(js.name.size());
+
+  robot_state::RobotState state(model);
+  ros::WallRate r(rate);
+  while (!*done)
+  {
+    state.setToRandomPositions();
+    for (std::size_t i = 0 ; i < js.name.size() ; ++i)
+      js.position[i] = state.getVariablePosition(js.name[i]);
+    js.header.stamp = ros::Time::now();
+    pub.publish(js);
+    r.sleep();
+  }
+}
+
+void countUpdates(const sensor_msgs::JointStateConstPtr &, std::size_t *count)
+{
+  (*count)++;
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "evaluate_current_state_monitor_speed");
+
+  unsigned int joints = 60;
+  unsigned int publishers = 3;
+  double rate = 1000.0;
+  double duration = 10.0;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("joints", boost::program_options::value<unsigned int>(&joints)->default_value(joints), "Number of joints of the synthetic chain used as robot model")
+    ("robot_description", "Use the robot model from the robot_description parameter instead of a synthetic chain")
+    ("publishers", boost::program_options::value<unsigned int>(&publishers)->default_value(publishers), "Number of joint state publishers (each uses a different ordering of names)")
+    ("rate", boost::program_options::value<double>(&rate)->default_value(rate), "Publishing rate of each publisher (Hz)")
+    ("duration", boost::program_options::value<double>(&duration)->default_value(duration), "Duration of the test (seconds)")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help"))
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  robot_model::RobotModelConstPtr model;
+  robot_model_loader::RobotModelLoaderPtr rml;
+  if (vm.count("robot_description"))
+  {
+    rml.reset(new robot_model_loader::RobotModelLoader(ROBOT_DESCRIPTION));
+    model = rml->getModel();
+  }
+  else
+    model = buildChainModel(joints);
+  if (!model)
+  {
+    ROS_ERROR("Unable to construct robot model");
+    return 1;
+  }
+
+  const std::string topic = ros::this_node::getName() + "/joint_states";
+  planning_scene_monitor::CurrentStateMonitor csm(model, boost::shared_ptr<tf::Transformer>());
+  std::size_t updates = 0;
+  csm.addUpdateCallback(boost::bind(&countUpdates, _1, &updates));
+  csm.startStateMonitor(topic);
+
+  printf("Evaluating model '%s' (%u variables) with %u publishers at %lf Hz for %lf seconds\n",
+         model->getName().c_str(), (unsigned int)model->getVariableCount(), publishers, rate, duration);
+
+  volatile bool done = false;
+  std::vector<boost::thread*> threads;
+  for (unsigned int i = 0 ; i < publishers ; ++i)
+    threads.push_back(new boost::thread(boost::bind(&publishJointStates, i, topic, model, rate, &done)));
+
+  moveit::tools::Profiler::Clear();
+  moveit::tools::Profiler::Start();
+
+  std::clock_t cpu_start = std::clock();
+  ros::WallTime end = ros::WallTime::now() + ros::WallDuration(duration);
+  while (ros::WallTime::now() < end)
+  {
+    moveit::tools::Profiler::Begin("haveCompleteState");
+    csm.haveCompleteState();
+    moveit::tools::Profiler::End("haveCompleteState");
+
+    moveit::tools::Profiler::Begin("haveCompleteState(age)");
+    csm.haveCompleteState(ros::Duration(1.0));
+    moveit::tools::Profiler::End("haveCompleteState(age)");
+
+    ros::WallDuration(0.001).sleep();
+  }
+  double cpu_time = (double)(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+
+  done = true;
+  for (std::size_t i = 0 ; i < threads.size() ; ++i)
+  {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  moveit::tools::Profiler::Stop();
+  moveit::tools::Profiler::Status();
+
+  printf("Processed %lf joint state messages per second; process CPU time per message (including publishing): %lf us\n",
+         (double)updates / duration, updates > 0 ? 1e6 * cpu_time / updates : 0.0);
+
+  return 0;
+}
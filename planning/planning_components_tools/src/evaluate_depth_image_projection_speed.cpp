@@ -0,0 +1,204 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/depth_image_octomap_updater/depth_image_projector.h>
+#include <moveit/mesh_filter/mesh_filter_base.h>
+#include <ros/ros.h>
+#include <tf/LinearMath/Transform.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <random_numbers/random_numbers.h>
+#include <algorithm>
+#include <iostream>
+
+// a depth camera looking at a wall with a mesh filtered block in front of it, as the updater receives it
+struct SyntheticFrame
+{
+  unsigned int width_, height_;
+  double fx_, fy_, px_, py_;
+  std::vector<float> depth_;
+  std::vector<uint16_t> depth_mm_;
+  std::vector<unsigned int> labels_;
+};
+
+SyntheticFrame makeFrame(unsigned int width, unsigned int height, random_numbers::RandomNumberGenerator &rng)
+{
+  SyntheticFrame frame;
+  frame.width_ = width;
+  frame.height_ = height;
+  frame.fx_ = frame.fy_ = 0.8 * width;
+  frame.px_ = width / 2.0 - 0.5;
+  frame.py_ = height / 2.0 - 0.5;
+  frame.depth_.resize(width * height);
+  frame.depth_mm_.resize(width * height);
+  frame.labels_.resize(width * height);
+  for (unsigned int y = 0 ; y < height ; ++y)
+    for (unsigned int x = 0 ; x < width ; ++x)
+    {
+      const std::size_t i = (std::size_t)y * width + x;
+      // a slanted wall 2-4 m away with sensor noise
+      frame.depth_[i] = 2.0 + 2.0 * x / width + rng.gaussian(0.0, 0.005);
+      frame.depth_mm_[i] = (uint16_t)(frame.depth_[i] * 1000.0 + 0.5);
+      if (x > width / 3 && x < width / 2 && y > height / 3)
+        frame.labels_[i] = mesh_filter::MeshFilterBase::FirstLabel; // a robot arm in view
+      else if (rng.uniform01() < 0.05)
+        frame.labels_[i] = mesh_filter::MeshFilterBase::Shadow;
+      else
+        frame.labels_[i] = mesh_filter::MeshFilterBase::Background;
+    }
+  return frame;
+}
+
+// the serial key set back-projection DepthImageOctomapUpdater used
+template<typename T>
+std::size_t computeKeysSerially(const octomap::OcTree &tree, const SyntheticFrame &frame, const T *depth, double scale,
+                                unsigned int skip_vertical, unsigned int skip_horizontal, const tf::Transform &map_H_sensor)
+{
+  std::vector<float> x_cache(frame.width_), y_cache(frame.height_);
+  for (int x = 0; x < (int)frame.width_; ++x)
+    x_cache[x] = (x - frame.px_) / frame.fx_;
+  for (int y = 0; y < (int)frame.height_; ++y)
+    y_cache[y] = (y - frame.py_) / frame.fy_;
+
+  octomap::KeySet occupied_cells, model_cells;
+  const int w = frame.width_;
+  const int h_bound = frame.height_ - skip_vertical;
+  const int w_bound = w - skip_horizontal;
+  for (int y = skip_vertical ; y < h_bound ; ++y)
+  {
+    const T *input_row = depth + (std::size_t)y * w;
+    const unsigned int *labels_row = &frame.labels_[(std::size_t)y * w];
+    for (int x = skip_horizontal ; x < w_bound ; ++x)
+    {
+      if (labels_row[x] == mesh_filter::MeshFilterBase::Background)
+      {
+        float zz = (float)input_row[x] * scale;
+        tf::Vector3 point_tf = map_H_sensor * tf::Vector3(x_cache[x] * zz, y_cache[y] * zz, zz);
+        occupied_cells.insert(tree.coordToKey(point_tf.getX(), point_tf.getY(), point_tf.getZ()));
+      }
+      else if (labels_row[x] >= mesh_filter::MeshFilterBase::FarClip)
+      {
+        float zz = (float)input_row[x] * scale;
+        tf::Vector3 point_tf = map_H_sensor * tf::Vector3(x_cache[x] * zz, y_cache[y] * zz, zz);
+        model_cells.insert(tree.coordToKey(point_tf.getX(), point_tf.getY(), point_tf.getZ()));
+      }
+    }
+  }
+  for (octomap::KeySet::iterator it = model_cells.begin(), end = model_cells.end(); it != end; ++it)
+    occupied_cells.erase(*it);
+  return occupied_cells.size();
+}
+
+template<typename T>
+void evaluate(const octomap::OcTree &tree, const SyntheticFrame &frame, const T *depth, double scale, const char *encoding,
+              unsigned int frames, unsigned int max_threads, unsigned int skip_vertical, unsigned int skip_horizontal)
+{
+  const tf::Transform map_H_sensor(tf::Quaternion(tf::Vector3(0.0, 1.0, 0.0), 0.3), tf::Vector3(0.2, -0.1, 1.4));
+  Eigen::Affine3d map_H_sensor_eigen = Eigen::Affine3d::Identity();
+  for (int i = 0 ; i < 3 ; ++i)
+  {
+    for (int j = 0 ; j < 3 ; ++j)
+      map_H_sensor_eigen.linear()(i, j) = map_H_sensor.getBasis()[i][j];
+    map_H_sensor_eigen.translation()(i) = map_H_sensor.getOrigin()[i];
+  }
+  const double pixels = (double)frame.width_ * frame.height_ * frames;
+
+  std::size_t expected = 0;
+  ros::WallTime start = ros::WallTime::now();
+  for (unsigned int i = 0 ; i < frames ; ++i)
+    expected = computeKeysSerially(tree, frame, depth, scale, skip_vertical, skip_horizontal, map_H_sensor);
+  double duration = (ros::WallTime::now() - start).toSec();
+  printf("%4u x %-4u %s serial key set:        %8.2lf ms per frame, %7.2lf Mpixels/s (%u occupied cells)\n",
+         frame.width_, frame.height_, encoding, 1000.0 * duration / frames, pixels / duration / 1e6, (unsigned int)expected);
+
+  for (unsigned int threads = 1 ; threads <= std::max(max_threads, 1u) ; threads *= 2)
+  {
+    occupancy_map_monitor::DepthImageProjector projector(threads);
+    projector.setCameraParameters(frame.fx_, frame.fy_, frame.px_, frame.py_, frame.width_, frame.height_);
+    std::vector<octomap::OcTreeKey> occupied, model, difference;
+    start = ros::WallTime::now();
+    for (unsigned int i = 0 ; i < frames ; ++i)
+    {
+      projector.computeKeys(tree, depth, &frame.labels_[0], skip_vertical, skip_horizontal, map_H_sensor_eigen, occupied, model);
+      difference.clear();
+      std::set_difference(occupied.begin(), occupied.end(), model.begin(), model.end(), std::back_inserter(difference),
+                          &occupancy_map_monitor::DepthImageProjector::keyLess);
+    }
+    duration = (ros::WallTime::now() - start).toSec();
+    printf("%4u x %-4u %s parallel, %2u threads: %8.2lf ms per frame, %7.2lf Mpixels/s (%u occupied cells%s)\n",
+           frame.width_, frame.height_, encoding, projector.getThreadCount(), 1000.0 * duration / frames, pixels / duration / 1e6,
+           (unsigned int)difference.size(), difference.size() == expected ? "" : ", MISMATCH");
+  }
+}
+
+int main(int argc, char **argv)
+{
+  ros::Time::init();
+
+  unsigned int frames = 20;
+  unsigned int max_threads = 8;
+  unsigned int skip_vertical = 4;
+  unsigned int skip_horizontal = 6;
+  double resolution = 0.02;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("frames", boost::program_options::value<unsigned int>(&frames)->default_value(frames), "Number of times each frame is processed")
+    ("resolution", boost::program_options::value<double>(&resolution)->default_value(resolution), "Resolution of the octree")
+    ("threads", boost::program_options::value<unsigned int>(&max_threads)->default_value(max_threads), "Largest number of threads to evaluate")
+    ("skip-vertical", boost::program_options::value<unsigned int>(&skip_vertical)->default_value(skip_vertical), "Rows skipped at the top and bottom of the image")
+    ("skip-horizontal", boost::program_options::value<unsigned int>(&skip_horizontal)->default_value(skip_horizontal), "Columns skipped at the left and right of the image")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || frames == 0)
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  octomap::OcTree tree(resolution);
+  random_numbers::RandomNumberGenerator rng(1);
+  const unsigned int sizes[][2] = { { 640, 480 }, { 1280, 720 } };
+  for (int i = 0 ; i < 2 ; ++i)
+  {
+    SyntheticFrame frame = makeFrame(sizes[i][0], sizes[i][1], rng);
+    evaluate(tree, frame, &frame.depth_mm_[0], 1e-3, "16UC1", frames, max_threads, skip_vertical, skip_horizontal);
+    evaluate(tree, frame, &frame.depth_[0], 1.0, "32FC1", frames, max_threads, skip_vertical, skip_horizontal);
+  }
+
+  return 0;
+}
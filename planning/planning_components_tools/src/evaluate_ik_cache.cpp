@@ -0,0 +1,193 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/kinematics_plugin_loader/kinematics_plugin_loader.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+#include <tf_conversions/tf_eigen.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/math/constants/constants.hpp>
+#include <algorithm>
+
+static const std::string ROBOT_DESCRIPTION = "robot_description";
+
+// replay a sequence of poses the way an interactive marker drag does: each query is seeded with the previous solution
+void replay(const std::string &name, const kinematics::KinematicsBasePtr &solver, const std::vector<geometry_msgs::Pose> &poses,
+            const std::vector<double> &start, double timeout)
+{
+  std::vector<double> seed = start;
+  std::vector<double> solution;
+  moveit_msgs::MoveItErrorCodes error_code;
+  std::vector<double> latencies;
+  latencies.reserve(poses.size());
+  std::size_t solved = 0;
+  for (std::size_t i = 0 ; i < poses.size() ; ++i)
+  {
+    ros::WallTime start_time = ros::WallTime::now();
+    bool ok = solver->searchPositionIK(poses[i], seed, timeout, solution, error_code);
+    latencies.push_back((ros::WallTime::now() - start_time).toSec() * 1000.0);
+    if (ok)
+    {
+      solved++;
+      seed = solution;
+    }
+  }
+
+  double mean = 0.0;
+  for (std::size_t i = 0 ; i < latencies.size() ; ++i)
+    mean += latencies[i];
+  mean /= latencies.size();
+  std::sort(latencies.begin(), latencies.end());
+  printf("  %-10s: success %6.2f%%, latency mean %8.4f ms, median %8.4f ms, 95%% %8.4f ms\n", name.c_str(),
+         100.0 * solved / poses.size(), mean, latencies[latencies.size() / 2],
+         latencies[std::min(latencies.size() - 1, latencies.size() * 95 / 100)]);
+}
+
+void evaluate(const std::string &label, kinematics_plugin_loader::KinematicsPluginLoader &loader, const robot_model_loader::RobotModelLoader &rml,
+              const robot_model::JointModelGroup *jmg, unsigned int waypoints, double jitter, double timeout)
+{
+  kinematics::KinematicsBasePtr solver = loader.getLoaderFunction(rml.getSRDF())(jmg);
+  if (!solver)
+  {
+    ROS_ERROR("Unable to allocate a kinematics solver for group '%s'", jmg->getName().c_str());
+    return;
+  }
+  printf("%s (%s)\n", label.c_str(), solver->getTipFrame().c_str());
+
+  // a smooth joint space sweep between two random states; the tip poses along it are the marker poses
+  robot_state::RobotState state(rml.getModel());
+  state.setToDefaultValues();
+  random_numbers::RandomNumberGenerator rng(42);
+  std::vector<double> from, to, values;
+  state.setToRandomPositions(jmg, rng);
+  state.copyJointGroupPositions(jmg, from);
+  state.setToRandomPositions(jmg, rng);
+  state.copyJointGroupPositions(jmg, to);
+
+  std::vector<geometry_msgs::Pose> forward(waypoints);
+  values.resize(from.size());
+  for (std::size_t i = 0 ; i < waypoints ; ++i)
+  {
+    // ease in and out, like a hand dragging the marker
+    double t = 0.5 - 0.5 * cos(boost::math::constants::pi<double>() * i / std::max(1u, waypoints - 1));
+    for (std::size_t j = 0 ; j < values.size() ; ++j)
+      values[j] = from[j] + t * (to[j] - from[j]);
+    state.setJointGroupPositions(jmg, values);
+    state.update();
+    tf::Pose pose;
+    tf::poseEigenToTF(state.getGlobalLinkTransform(solver->getBaseFrame()).inverse() * state.getGlobalLinkTransform(solver->getTipFrame()), pose);
+    tf::poseTFToMsg(pose, forward[i]);
+  }
+
+  // dragging back visits the same poses; the jittered pass visits nearby ones
+  std::vector<geometry_msgs::Pose> backward(forward.rbegin(), forward.rend());
+  std::vector<geometry_msgs::Pose> jittered = forward;
+  for (std::size_t i = 0 ; i < jittered.size() ; ++i)
+  {
+    jittered[i].position.x += rng.uniformReal(-jitter, jitter);
+    jittered[i].position.y += rng.uniformReal(-jitter, jitter);
+    jittered[i].position.z += rng.uniformReal(-jitter, jitter);
+  }
+
+  replay("forward", solver, forward, from, timeout);
+  replay("backward", solver, backward, to, timeout);
+  replay("jittered", solver, jittered, from, timeout);
+
+  kinematics_plugin_loader::IKCacheStatistics stats;
+  if (loader.getIKCacheStatistics(jmg->getName(), stats))
+    printf("  cache: %u solutions, %u hits, %u misses, %u seed assists\n", (unsigned int)stats.size,
+           (unsigned int)stats.hits, (unsigned int)stats.misses, (unsigned int)stats.seed_assists);
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "evaluate_ik_cache");
+
+  std::string group;
+  unsigned int waypoints = 500;
+  int cache_size = 10000;
+  double jitter = 0.0005;
+  double timeout = 0.05;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("group", boost::program_options::value<std::string>(&group), "Name of the group to evaluate")
+    ("waypoints", boost::program_options::value<unsigned int>(&waypoints)->default_value(waypoints), "Number of poses along the drag")
+    ("cache_size", boost::program_options::value<int>(&cache_size)->default_value(cache_size), "Capacity of the IK cache")
+    ("jitter", boost::program_options::value<double>(&jitter)->default_value(jitter), "Largest position offset of the jittered pass (m)")
+    ("timeout", boost::program_options::value<double>(&timeout)->default_value(timeout), "Timeout of each query (seconds)")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || group.empty() || waypoints == 0 || cache_size <= 0)
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  robot_model_loader::RobotModelLoader rml(ROBOT_DESCRIPTION, false);
+  const robot_model::JointModelGroup *jmg = rml.getModel() ? rml.getModel()->getJointModelGroup(group) : NULL;
+  if (!jmg)
+  {
+    ROS_ERROR("Group '%s' does not exist", group.c_str());
+    return 1;
+  }
+
+  // the kinematics settings of the group are expected in the private namespace, as for move_group;
+  // the cache size is overridden for each configuration
+  ros::NodeHandle nh("~");
+  printf("Group %s, %u waypoints, jitter %.4f m, timeout %.3f s\n", group.c_str(), waypoints, jitter, timeout);
+
+  nh.setParam(group + "/kinematics_solver_cache_size", 0);
+  {
+    kinematics_plugin_loader::KinematicsPluginLoader loader(ROBOT_DESCRIPTION);
+    evaluate("Without cache", loader, rml, jmg, waypoints, jitter, timeout);
+  }
+
+  nh.setParam(group + "/kinematics_solver_cache_size", cache_size);
+  {
+    kinematics_plugin_loader::KinematicsPluginLoader loader(ROBOT_DESCRIPTION);
+    evaluate("With cache", loader, rml, jmg, waypoints, jitter, timeout);
+  }
+
+  nh.deleteParam(group + "/kinematics_solver_cache_size");
+  ros::shutdown();
+  return 0;
+}
@@ -0,0 +1,203 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include <moveit/kdl_kinematics_plugin/kdl_kinematics_plugin.h>
+#include <moveit/lma_kinematics_plugin/lma_kinematics_plugin.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+#include <tf_conversions/tf_eigen.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <algorithm>
+
+static const std::string ROBOT_DESCRIPTION = "robot_description";
+
+struct Query
+{
+  geometry_msgs::Pose pose_;
+  std::vector<double> seed_;
+};
+
+// run all queries with one configuration of a solver and print the success rate and the time to the first solution
+template<typename Solver>
+void evaluate(Solver &solver, const char *name, const std::vector<Query> &queries, double timeout,
+              ik_restart_search::SeedingStrategy strategy, double gaussian_stddev, unsigned int threads)
+{
+  static const char *STRATEGY_NAMES[] = { "uniform", "gaussian", "halton" };
+  solver.setParallelSearch(threads, false);
+  solver.setRestartSeeding(strategy, gaussian_stddev);
+
+  std::vector<double> times;
+  times.reserve(queries.size());
+  std::vector<double> solution;
+  moveit_msgs::MoveItErrorCodes error_code;
+  for (std::size_t i = 0 ; i < queries.size() ; ++i)
+  {
+    ros::WallTime start = ros::WallTime::now();
+    if (solver.searchPositionIK(queries[i].pose_, queries[i].seed_, timeout, solution, error_code))
+      times.push_back((ros::WallTime::now() - start).toSec() * 1000.0);
+  }
+
+  if (times.empty())
+  {
+    printf("%-4s %-8s %2u thread(s): success   0.00%%\n", name, STRATEGY_NAMES[strategy], threads);
+    return;
+  }
+  double mean = 0.0;
+  for (std::size_t i = 0 ; i < times.size() ; ++i)
+    mean += times[i];
+  mean /= times.size();
+  std::sort(times.begin(), times.end());
+  printf("%-4s %-8s %2u thread(s): success %6.2f%%, time to first solution mean %8.3f ms, median %8.3f ms, 95%% %8.3f ms\n",
+         name, STRATEGY_NAMES[strategy], threads, 100.0 * times.size() / queries.size(), mean,
+         times[times.size() / 2], times[std::min(times.size() - 1, times.size() * 95 / 100)]);
+}
+
+template<typename Solver>
+void evaluateAll(Solver &solver, const char *name, const std::vector<Query> &queries, double timeout,
+                 double gaussian_stddev, unsigned int max_threads)
+{
+  const ik_restart_search::SeedingStrategy strategies[] = { ik_restart_search::UNIFORM, ik_restart_search::GAUSSIAN,
+                                                            ik_restart_search::HALTON };
+  for (std::size_t s = 0 ; s < 3 ; ++s)
+    for (unsigned int threads = 1 ; threads <= std::max(max_threads, 1u) ; threads *= 2)
+      evaluate(solver, name, queries, timeout, strategies[s], gaussian_stddev, threads);
+}
+
+// a random state of the group in which each joint is close to one of its limits with probability near_limit
+void setToNearLimitPositions(robot_state::RobotState &state, const robot_model::JointModelGroup *jmg,
+                             random_numbers::RandomNumberGenerator &rng, double near_limit, double margin)
+{
+  state.setToRandomPositions(jmg, rng);
+  const std::vector<const robot_model::JointModel*> &joints = jmg->getActiveJointModels();
+  for (std::size_t i = 0 ; i < joints.size() ; ++i)
+  {
+    const robot_model::VariableBounds &b = joints[i]->getVariableBounds()[0];
+    if (!b.position_bounded_ || rng.uniform01() >= near_limit)
+      continue;
+    double range = (b.max_position_ - b.min_position_) * margin;
+    double value = rng.uniform01() < 0.5 ? b.min_position_ + rng.uniformReal(0.0, range) :
+      b.max_position_ - rng.uniformReal(0.0, range);
+    state.setJointPositions(joints[i], &value);
+  }
+  state.update();
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "evaluate_ik_restart_strategies");
+
+  std::string group;
+  std::string base_frame;
+  std::string tip_frame;
+  unsigned int queries = 500;
+  unsigned int max_threads = 4;
+  double timeout = 0.05;
+  double near_limit = 0.5;
+  double margin = 0.05;
+  double gaussian_stddev = 0.3;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("group", boost::program_options::value<std::string>(&group), "Name of the group to evaluate (must be a chain)")
+    ("base", boost::program_options::value<std::string>(&base_frame), "Base frame of the solvers (default: parent of the first link of the group)")
+    ("tip", boost::program_options::value<std::string>(&tip_frame), "Tip frame of the solvers (default: last link of the group)")
+    ("queries", boost::program_options::value<unsigned int>(&queries)->default_value(queries), "Number of IK queries")
+    ("threads", boost::program_options::value<unsigned int>(&max_threads)->default_value(max_threads), "Largest number of parallel searches; powers of two up to this value are evaluated")
+    ("timeout", boost::program_options::value<double>(&timeout)->default_value(timeout), "Timeout of each query (seconds)")
+    ("near-limit", boost::program_options::value<double>(&near_limit)->default_value(near_limit), "Probability of each joint of a target state to be close to a joint limit")
+    ("margin", boost::program_options::value<double>(&margin)->default_value(margin), "Distance to the limit of joints close to a limit, as a fraction of the joint range")
+    ("stddev", boost::program_options::value<double>(&gaussian_stddev)->default_value(gaussian_stddev), "Standard deviation of the gaussian seeding strategy (radians or meters)")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || group.empty() || queries == 0)
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  robot_model_loader::RobotModelLoader rml(ROBOT_DESCRIPTION, false);
+  const robot_model::JointModelGroup *jmg = rml.getModel() ? rml.getModel()->getJointModelGroup(group) : NULL;
+  if (!jmg || !jmg->isChain())
+  {
+    ROS_ERROR("Group '%s' does not exist or is not a chain", group.c_str());
+    return 1;
+  }
+  if (base_frame.empty())
+  {
+    const robot_model::LinkModel *parent = jmg->getJointModels().front()->getParentLinkModel();
+    base_frame = parent ? parent->getName() : rml.getModel()->getModelFrame();
+  }
+  if (tip_frame.empty())
+    tip_frame = jmg->getLinkModelNames().back();
+
+  kdl_kinematics_plugin::KDLKinematicsPlugin kdl_solver;
+  lma_kinematics_plugin::LMAKinematicsPlugin lma_solver;
+  if (!kdl_solver.initialize(ROBOT_DESCRIPTION, group, base_frame, tip_frame, 0.1) ||
+      !lma_solver.initialize(ROBOT_DESCRIPTION, group, base_frame, tip_frame, 0.1))
+  {
+    ROS_ERROR("Unable to initialize the solvers for group '%s'", group.c_str());
+    return 1;
+  }
+  printf("Group %s, %s -> %s, %u queries, timeout %.3f s, %.0f%% of the joints within %.0f%% of a limit\n",
+         group.c_str(), base_frame.c_str(), tip_frame.c_str(), queries, timeout, near_limit * 100.0, margin * 100.0);
+
+  // reachable poses with joints close to their limits and random seeds, the same for every configuration
+  random_numbers::RandomNumberGenerator rng;
+  robot_state::RobotState state(rml.getModel());
+  state.setToDefaultValues();
+  std::vector<Query> q(queries);
+  for (std::size_t i = 0 ; i < q.size() ; ++i)
+  {
+    setToNearLimitPositions(state, jmg, rng, near_limit, margin);
+    tf::Pose pose;
+    tf::poseEigenToTF(state.getGlobalLinkTransform(base_frame).inverse() * state.getGlobalLinkTransform(tip_frame), pose);
+    tf::poseTFToMsg(pose, q[i].pose_);
+    state.setToRandomPositions(jmg, rng);
+    state.copyJointGroupPositions(jmg, q[i].seed_);
+  }
+
+  evaluateAll(kdl_solver, "KDL", q, timeout, gaussian_stddev, max_threads);
+  evaluateAll(lma_solver, "LMA", q, timeout, gaussian_stddev, max_threads);
+
+  ros::shutdown();
+  return 0;
+}
@@ -0,0 +1,211 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/kdl_kinematics_plugin/chainiksolver_pos_nr_jl_mimic.hpp>
+#include <moveit/kdl_kinematics_plugin/chainiksolver_vel_pinv_mimic.hpp>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <kdl/chainfksolverpos_recursive.hpp>
+#include <kdl/chainiksolverpos_lma.hpp>
+#include <kdl_parser/kdl_parser.hpp>
+#include <random_numbers/random_numbers.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+
+static const std::string ROBOT_DESCRIPTION = "robot_description";
+
+struct Query
+{
+  KDL::Frame pose_;
+  KDL::JntArray seed_;
+};
+
+// a single solver call from the seed, without restarts; returns the number of iterations or -1 on failure
+typedef boost::function<int(const KDL::JntArray&, const KDL::Frame&, KDL::JntArray&)> SolveFn;
+
+int solveNR(KDL::ChainIkSolverPos_NR_JL_Mimic *solver, const KDL::JntArray &seed, const KDL::Frame &pose, KDL::JntArray &result)
+{
+  int ret = solver->CartToJnt(seed, pose, result);
+  return ret >= 0 ? (int)solver->getLastNrOfIterations() : -1;
+}
+
+int solveLMA(KDL::ChainIkSolverPos_LMA *solver, const KDL::JntArray *q_min, const KDL::JntArray *q_max,
+             const KDL::JntArray &seed, const KDL::Frame &pose, KDL::JntArray &result)
+{
+  int ret = solver->CartToJnt(seed, pose, result);
+  if (ret < 0)
+    return -1;
+  // the LMA plugin brings the solution into [-2pi, 2pi] and checks the limits afterwards
+  for (unsigned int i = 0 ; i < result.rows() ; ++i)
+  {
+    while (result(i) > 2 * M_PI)
+      result(i) -= 2 * M_PI;
+    while (result(i) < -2 * M_PI)
+      result(i) += 2 * M_PI;
+    if (result(i) < (*q_min)(i) - 0.0001 || result(i) > (*q_max)(i) + 0.0001)
+      return -1;
+  }
+  return solver->lastNrOfIter;
+}
+
+void evaluate(const std::string &name, const SolveFn &solve, const std::vector<Query> &queries, unsigned int joints)
+{
+  KDL::JntArray result(joints);
+  std::size_t solved = 0;
+  double iterations = 0.0;
+  ros::WallTime start = ros::WallTime::now();
+  for (std::size_t i = 0 ; i < queries.size() ; ++i)
+  {
+    int it = solve(queries[i].seed_, queries[i].pose_, result);
+    if (it >= 0)
+    {
+      solved++;
+      iterations += it;
+    }
+  }
+  double duration = (ros::WallTime::now() - start).toSec();
+  printf("%-24s: success %6.2f%%, %7.2f iterations per solution, %8.2f us per solve\n", name.c_str(),
+         100.0 * solved / queries.size(), solved ? iterations / solved : 0.0, duration * 1e6 / queries.size());
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "evaluate_kdl_ik_solvers");
+
+  std::string group;
+  std::string base_frame;
+  std::string tip_frame;
+  unsigned int queries = 10000;
+  unsigned int max_iterations = 500;
+  double epsilon = 1e-5;
+  double damping = 0.01;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("group", boost::program_options::value<std::string>(&group), "Name of the group to evaluate (must be a chain without mimic joints)")
+    ("base", boost::program_options::value<std::string>(&base_frame), "Base frame of the chain (default: parent of the first link of the group)")
+    ("tip", boost::program_options::value<std::string>(&tip_frame), "Tip frame of the chain (default: last link of the group)")
+    ("queries", boost::program_options::value<unsigned int>(&queries)->default_value(queries), "Number of solver calls")
+    ("iterations", boost::program_options::value<unsigned int>(&max_iterations)->default_value(max_iterations), "Maximum number of iterations per solver call")
+    ("epsilon", boost::program_options::value<double>(&epsilon)->default_value(epsilon), "Convergence threshold")
+    ("damping", boost::program_options::value<double>(&damping)->default_value(damping), "Damping of the damped least squares solver")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || group.empty() || queries == 0)
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  robot_model_loader::RobotModelLoader rml(ROBOT_DESCRIPTION, false);
+  const robot_model::JointModelGroup *jmg = rml.getModel() ? rml.getModel()->getJointModelGroup(group) : NULL;
+  if (!jmg || !jmg->isChain() || !jmg->getMimicJointModels().empty())
+  {
+    ROS_ERROR("Group '%s' does not exist, is not a chain or has mimic joints", group.c_str());
+    return 1;
+  }
+  if (base_frame.empty())
+  {
+    const robot_model::LinkModel *parent = jmg->getJointModels().front()->getParentLinkModel();
+    base_frame = parent ? parent->getName() : rml.getModel()->getModelFrame();
+  }
+  if (tip_frame.empty())
+    tip_frame = jmg->getLinkModelNames().back();
+
+  KDL::Tree tree;
+  KDL::Chain chain;
+  if (!kdl_parser::treeFromUrdfModel(*rml.getURDF(), tree) || !tree.getChain(base_frame, tip_frame, chain))
+  {
+    ROS_ERROR("Unable to build the KDL chain %s -> %s", base_frame.c_str(), tip_frame.c_str());
+    return 1;
+  }
+
+  // limits in the order of the chain
+  const unsigned int joints = chain.getNrOfJoints();
+  KDL::JntArray q_min(joints), q_max(joints);
+  unsigned int j = 0;
+  for (unsigned int i = 0 ; i < chain.getNrOfSegments() ; ++i)
+  {
+    const KDL::Joint &joint = chain.getSegment(i).getJoint();
+    if (joint.getType() == KDL::Joint::None)
+      continue;
+    const robot_model::JointModel *jm = rml.getModel()->getJointModel(joint.getName());
+    const robot_model::VariableBounds &b = jm->getVariableBounds()[0];
+    q_min(j) = b.position_bounded_ ? b.min_position_ : -M_PI;
+    q_max(j) = b.position_bounded_ ? b.max_position_ : M_PI;
+    ++j;
+  }
+
+  // reachable poses and random seeds, the same for every solver
+  KDL::ChainFkSolverPos_recursive fk_solver(chain);
+  random_numbers::RandomNumberGenerator rng;
+  std::vector<Query> q(queries);
+  KDL::JntArray target(joints);
+  for (std::size_t i = 0 ; i < q.size() ; ++i)
+  {
+    q[i].seed_.resize(joints);
+    for (unsigned int k = 0 ; k < joints ; ++k)
+    {
+      target(k) = rng.uniformReal(q_min(k), q_max(k));
+      q[i].seed_(k) = rng.uniformReal(q_min(k), q_max(k));
+    }
+    fk_solver.JntToCart(target, q[i].pose_);
+  }
+  printf("Chain %s -> %s, %u joints, %u queries\n", base_frame.c_str(), tip_frame.c_str(), joints, queries);
+
+  KDL::ChainIkSolverVel_pinv_mimic vel_pinv(chain);
+  KDL::ChainIkSolverPos_NR_JL_Mimic nr_pinv(chain, q_min, q_max, fk_solver, vel_pinv, max_iterations, epsilon);
+  evaluate("NR, pseudo inverse", boost::bind(&solveNR, &nr_pinv, _1, _2, _3), q, joints);
+
+  KDL::ChainIkSolverVel_pinv_mimic vel_dls(chain);
+  if (vel_dls.setDampedLeastSquares(damping))
+  {
+    KDL::ChainIkSolverPos_NR_JL_Mimic nr_dls(chain, q_min, q_max, fk_solver, vel_dls, max_iterations, epsilon);
+    evaluate("NR, damped least squares", boost::bind(&solveNR, &nr_dls, _1, _2, _3), q, joints);
+  }
+  else
+    printf("NR, damped least squares: not available for more than %u joints\n", KDL::ChainIkSolverVel_pinv_mimic::DLS_MAX_JOINTS);
+
+  // the same weights as the LMA plugin
+  Eigen::Matrix<double, 6, 1> L;
+  L << 1.0, 1.0, 1.0, 0.01, 0.01, 0.01;
+  KDL::ChainIkSolverPos_LMA lma(chain, L, epsilon, max_iterations);
+  evaluate("LMA", boost::bind(&solveLMA, &lma, &q_min, &q_max, _1, _2, _3), q, joints);
+
+  return 0;
+}
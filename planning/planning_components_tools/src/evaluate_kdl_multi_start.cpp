@@ -0,0 +1,168 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/kdl_kinematics_plugin/kdl_kinematics_plugin.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+#include <tf_conversions/tf_eigen.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <algorithm>
+
+static const std::string ROBOT_DESCRIPTION = "robot_description";
+
+struct Query
+{
+  geometry_msgs::Pose pose_;
+  std::vector<double> seed_;
+};
+
+// run all queries with one configuration of the solver and print success rate, latency and distance to the seed
+void evaluate(kdl_kinematics_plugin::KDLKinematicsPlugin &solver, const std::vector<Query> &queries, double timeout,
+              unsigned int threads, bool return_best)
+{
+  solver.setParallelSearch(threads, return_best);
+
+  std::vector<double> latencies;
+  latencies.reserve(queries.size());
+  std::size_t solved = 0;
+  double distance = 0.0;
+  std::vector<double> solution;
+  moveit_msgs::MoveItErrorCodes error_code;
+  for (std::size_t i = 0 ; i < queries.size() ; ++i)
+  {
+    ros::WallTime start = ros::WallTime::now();
+    bool ok = solver.searchPositionIK(queries[i].pose_, queries[i].seed_, timeout, solution, error_code);
+    latencies.push_back((ros::WallTime::now() - start).toSec() * 1000.0);
+    if (!ok)
+      continue;
+    solved++;
+    double d = 0.0;
+    for (std::size_t j = 0 ; j < solution.size() ; ++j)
+      d += (solution[j] - queries[i].seed_[j]) * (solution[j] - queries[i].seed_[j]);
+    distance += sqrt(d);
+  }
+
+  double mean = 0.0;
+  for (std::size_t i = 0 ; i < latencies.size() ; ++i)
+    mean += latencies[i];
+  mean /= latencies.size();
+  std::sort(latencies.begin(), latencies.end());
+  printf("%2u thread(s), %-5s: success %6.2f%%, latency mean %8.3f ms, median %8.3f ms, 95%% %8.3f ms, distance to seed %.3f\n",
+         threads, return_best ? "best" : "first", 100.0 * solved / queries.size(), mean,
+         latencies[latencies.size() / 2], latencies[std::min(latencies.size() - 1, latencies.size() * 95 / 100)],
+         solved ? distance / solved : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "evaluate_kdl_multi_start");
+
+  std::string group;
+  std::string base_frame;
+  std::string tip_frame;
+  unsigned int queries = 1000;
+  unsigned int max_threads = 4;
+  double timeout = 0.05;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("group", boost::program_options::value<std::string>(&group), "Name of the group to evaluate (must be a chain)")
+    ("base", boost::program_options::value<std::string>(&base_frame), "Base frame of the solver (default: parent of the first link of the group)")
+    ("tip", boost::program_options::value<std::string>(&tip_frame), "Tip frame of the solver (default: last link of the group)")
+    ("queries", boost::program_options::value<unsigned int>(&queries)->default_value(queries), "Number of IK queries")
+    ("threads", boost::program_options::value<unsigned int>(&max_threads)->default_value(max_threads), "Largest number of parallel searches; powers of two up to this value are evaluated")
+    ("timeout", boost::program_options::value<double>(&timeout)->default_value(timeout), "Timeout of each query (seconds)")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || group.empty() || queries == 0)
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  robot_model_loader::RobotModelLoader rml(ROBOT_DESCRIPTION, false);
+  const robot_model::JointModelGroup *jmg = rml.getModel() ? rml.getModel()->getJointModelGroup(group) : NULL;
+  if (!jmg || !jmg->isChain())
+  {
+    ROS_ERROR("Group '%s' does not exist or is not a chain", group.c_str());
+    return 1;
+  }
+  if (base_frame.empty())
+  {
+    const robot_model::LinkModel *parent = jmg->getJointModels().front()->getParentLinkModel();
+    base_frame = parent ? parent->getName() : rml.getModel()->getModelFrame();
+  }
+  if (tip_frame.empty())
+    tip_frame = jmg->getLinkModelNames().back();
+
+  kdl_kinematics_plugin::KDLKinematicsPlugin solver;
+  if (!solver.initialize(ROBOT_DESCRIPTION, group, base_frame, tip_frame, 0.1))
+  {
+    ROS_ERROR("Unable to initialize the KDL solver for group '%s'", group.c_str());
+    return 1;
+  }
+  printf("Group %s, %s -> %s, %u queries, timeout %.3f s\n", group.c_str(), base_frame.c_str(), tip_frame.c_str(), queries, timeout);
+
+  // reachable poses and random seeds, the same for every configuration
+  robot_state::RobotState state(rml.getModel());
+  state.setToDefaultValues();
+  std::vector<Query> q(queries);
+  for (std::size_t i = 0 ; i < q.size() ; ++i)
+  {
+    state.setToRandomPositions(jmg);
+    state.update();
+    tf::Pose pose;
+    tf::poseEigenToTF(state.getGlobalLinkTransform(base_frame).inverse() * state.getGlobalLinkTransform(tip_frame), pose);
+    tf::poseTFToMsg(pose, q[i].pose_);
+    state.setToRandomPositions(jmg);
+    state.copyJointGroupPositions(jmg, q[i].seed_);
+  }
+
+  for (unsigned int threads = 1 ; threads <= std::max(max_threads, 1u) ; threads *= 2)
+  {
+    evaluate(solver, q, timeout, threads, false);
+    if (threads > 1)
+      evaluate(solver, q, timeout, threads, true);
+  }
+
+  ros::shutdown();
+  return 0;
+}
@@ -0,0 +1,209 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+#include <moveit/robot_state/conversions.h>
+#include <moveit_msgs/GetPositionIK.h>
+#include <moveit_msgs/GetPositionFK.h>
+#include <tf_conversions/tf_eigen.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/thread.hpp>
+
+static const std::string ROBOT_DESCRIPTION = "robot_description";
+
+// The requests of a batch are sent concurrently, each client thread keeping one persistent connection.
+// move_group serves them as one batch when KinematicsService has several threads (capability_threads/KinematicsService)
+// and kinematics_service_batch_max_age is set.
+class BatchClient
+{
+public:
+
+  BatchClient(const std::vector<moveit_msgs::GetPositionIK> &ik, const std::vector<moveit_msgs::GetPositionFK> &fk,
+              const std::string &ik_service, const std::string &fk_service) :
+    ik_(ik), fk_(fk), ik_service_(ik_service), fk_service_(fk_service)
+  {
+  }
+
+  // send requests [0, count) and return the number of successful ones
+  std::size_t run(std::size_t count, unsigned int clients, bool do_fk)
+  {
+    next_ = 0;
+    count_ = count;
+    succeeded_ = 0;
+    do_fk_ = do_fk;
+    boost::thread_group threads;
+    for (unsigned int i = 0 ; i < std::min<std::size_t>(clients, count) ; ++i)
+      threads.create_thread(boost::bind(&BatchClient::client, this));
+    threads.join_all();
+    return succeeded_;
+  }
+
+private:
+
+  void client()
+  {
+    ros::NodeHandle nh;
+    ros::ServiceClient ik_client = nh.serviceClient<moveit_msgs::GetPositionIK>(ik_service_, true);
+    ros::ServiceClient fk_client = nh.serviceClient<moveit_msgs::GetPositionFK>(fk_service_, true);
+    std::size_t succeeded = 0;
+    while (true)
+    {
+      std::size_t i;
+      {
+        boost::mutex::scoped_lock slock(lock_);
+        if (next_ >= count_)
+          break;
+        i = next_++;
+      }
+      if (do_fk_)
+      {
+        moveit_msgs::GetPositionFK srv = fk_[i % fk_.size()];
+        if (fk_client.call(srv) && srv.response.error_code.val == moveit_msgs::MoveItErrorCodes::SUCCESS)
+          succeeded++;
+      }
+      else
+      {
+        moveit_msgs::GetPositionIK srv = ik_[i % ik_.size()];
+        if (ik_client.call(srv) && srv.response.error_code.val == moveit_msgs::MoveItErrorCodes::SUCCESS)
+          succeeded++;
+      }
+    }
+    boost::mutex::scoped_lock slock(lock_);
+    succeeded_ += succeeded;
+  }
+
+  const std::vector<moveit_msgs::GetPositionIK> &ik_;
+  const std::vector<moveit_msgs::GetPositionFK> &fk_;
+  std::string ik_service_;
+  std::string fk_service_;
+
+  boost::mutex lock_;
+  std::size_t next_;
+  std::size_t count_;
+  std::size_t succeeded_;
+  bool do_fk_;
+};
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "evaluate_kinematics_service_batch");
+
+  std::string group;
+  unsigned int poses = 1000;
+  unsigned int clients = 8;
+  bool avoid_collisions = false;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("group", boost::program_options::value<std::string>(&group), "Name of the group to evaluate")
+    ("poses", boost::program_options::value<unsigned int>(&poses)->default_value(poses), "Number of poses evaluated for every batch size")
+    ("clients", boost::program_options::value<unsigned int>(&clients)->default_value(clients), "Largest number of requests in flight")
+    ("avoid_collisions", boost::program_options::bool_switch(&avoid_collisions), "Ask for collision free IK solutions")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || group.empty() || poses == 0 || clients == 0)
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  robot_model_loader::RobotModelLoader rml(ROBOT_DESCRIPTION, false);
+  const robot_model::JointModelGroup *jmg = rml.getModel() ? rml.getModel()->getJointModelGroup(group) : NULL;
+  if (!jmg)
+  {
+    ROS_ERROR("Group '%s' does not exist", group.c_str());
+    return 1;
+  }
+  const std::string &tip = jmg->getLinkModelNames().back();
+
+  if (!ros::service::waitForService("compute_ik", ros::Duration(10.0)) || !ros::service::waitForService("compute_fk", ros::Duration(10.0)))
+  {
+    ROS_ERROR("move_group does not offer compute_ik and compute_fk");
+    return 1;
+  }
+
+  // requests for reachable poses, seeded from random states
+  robot_state::RobotState state(rml.getModel());
+  state.setToDefaultValues();
+  std::vector<moveit_msgs::GetPositionIK> ik(poses);
+  std::vector<moveit_msgs::GetPositionFK> fk(poses);
+  for (std::size_t i = 0 ; i < poses ; ++i)
+  {
+    state.setToRandomPositions(jmg);
+    state.update();
+    robot_state::robotStateToRobotStateMsg(state, fk[i].request.robot_state);
+    fk[i].request.header.frame_id = rml.getModel()->getModelFrame();
+    fk[i].request.fk_link_names.push_back(tip);
+
+    tf::Pose pose;
+    tf::poseEigenToTF(state.getGlobalLinkTransform(tip), pose);
+    moveit_msgs::PositionIKRequest &req = ik[i].request.ik_request;
+    req.group_name = group;
+    req.ik_link_name = tip;
+    req.avoid_collisions = avoid_collisions;
+    req.pose_stamped.header.frame_id = rml.getModel()->getModelFrame();
+    tf::poseTFToMsg(pose, req.pose_stamped.pose);
+    req.timeout = ros::Duration(0.1);
+    state.setToRandomPositions(jmg);
+    robot_state::robotStateToRobotStateMsg(state, req.robot_state);
+  }
+
+  BatchClient client(ik, fk, "compute_ik", "compute_fk");
+  printf("Group %s, %u poses per batch size, up to %u requests in flight\n", group.c_str(), poses, clients);
+  static const unsigned int BATCH_SIZES[] = { 1, 10, 100, 1000 };
+  for (int do_fk = 0 ; do_fk < 2 ; ++do_fk)
+    for (std::size_t b = 0 ; b < sizeof(BATCH_SIZES) / sizeof(BATCH_SIZES[0]) ; ++b)
+    {
+      unsigned int batch = BATCH_SIZES[b];
+      unsigned int batches = std::max(1u, poses / batch);
+      std::size_t succeeded = 0;
+      ros::WallTime start = ros::WallTime::now();
+      for (unsigned int i = 0 ; i < batches ; ++i)
+        succeeded += client.run(batch, clients, do_fk);
+      double elapsed = (ros::WallTime::now() - start).toSec();
+      printf("%s, batch of %4u: %6.2f%% succeeded, %9.3f ms per batch, %8.3f ms per pose\n", do_fk ? "FK" : "IK", batch,
+             100.0 * succeeded / (batches * batch), elapsed * 1000.0 / batches, elapsed * 1000.0 / (batches * batch));
+    }
+
+  ros::shutdown();
+  return 0;
+}
@@ -0,0 +1,194 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include <moveit/occupancy_map_monitor/occupancy_map_snapshot.h>
+#include <ros/ros.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/filesystem.hpp>
+#include <random_numbers/random_numbers.h>
+#include <cmath>
+#include <iostream>
+
+using namespace occupancy_map_monitor;
+
+// a cube of cells with random occupancy, which does not prune, and a floor, which does. The cells are given the log-odds
+// a few hits and misses would give them, as in a real map.
+void makeMap(OccMapTree &tree, double size, random_numbers::RandomNumberGenerator &rng)
+{
+  const double step = tree.getResolution();
+  for (double x = 0.0 ; x < size ; x += step)
+  {
+    std::vector<OccMapTree::NodeUpdate> updates;
+    for (double y = 0.0 ; y < size ; y += step)
+    {
+      for (double z = 0.0 ; z < size ; z += step)
+        updates.push_back(OccMapTree::NodeUpdate(tree.coordToKey(x, y, z), rng.uniformInteger(0, 4) * tree.getProbHitLog() +
+                                                 rng.uniformInteger(0, 4) * tree.getProbMissLog()));
+      for (unsigned int i = 0 ; i < 10 ; ++i)
+        updates.push_back(OccMapTree::NodeUpdate(tree.coordToKey(x, y, -step), tree.getProbHitLog()));
+    }
+    tree.updateNodes(updates);
+  }
+}
+
+double fileSize(const std::string &filename)
+{
+  return boost::filesystem::file_size(filename) / (1024.0 * 1024.0);
+}
+
+int main(int argc, char **argv)
+{
+  ros::Time::init();
+
+  double size = 4.2;
+  double resolution = 0.02;
+  double changed = 0.01;
+  unsigned int runs = 3;
+  std::string directory = boost::filesystem::temp_directory_path().string();
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("size", boost::program_options::value<double>(&size)->default_value(size), "Side of the cube of random cells in the map (m); the default gives about 10M nodes")
+    ("resolution", boost::program_options::value<double>(&resolution)->default_value(resolution), "Resolution of the octree")
+    ("changed", boost::program_options::value<double>(&changed)->default_value(changed), "Fraction of the map changed before each incremental snapshot")
+    ("runs", boost::program_options::value<unsigned int>(&runs)->default_value(runs), "Number of times each operation is timed")
+    ("directory", boost::program_options::value<std::string>(&directory)->default_value(directory), "Directory for the map files")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || runs == 0)
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  random_numbers::RandomNumberGenerator rng(1);
+  OccMapTree tree(resolution);
+  makeMap(tree, size, rng);
+  const std::string binary_file = (boost::filesystem::path(directory) / "evaluate_map_snapshot_speed.bt").string();
+  const std::string snapshot_file = (boost::filesystem::path(directory) / ("evaluate_map_snapshot_speed" + OccMapSnapshot::FILE_EXTENSION)).string();
+  printf("Map of %u nodes at resolution %lf; times are averages over %u runs, with the files in the page cache\n",
+         (unsigned int)tree.size(), resolution, runs);
+
+  // the format the monitor saved maps in so far; it keeps only whether cells are free or occupied
+  double write_time = 0.0, read_time = 0.0;
+  for (unsigned int r = 0 ; r < runs ; ++r)
+  {
+    ros::WallTime start = ros::WallTime::now();
+    tree.lockRead();
+    tree.writeBinary(binary_file);
+    tree.unlockRead();
+    write_time += (ros::WallTime::now() - start).toSec();
+
+    OccMapTree loaded(resolution);
+    start = ros::WallTime::now();
+    loaded.lockWrite();
+    loaded.readBinary(binary_file);
+    loaded.unlockWrite();
+    read_time += (ros::WallTime::now() - start).toSec();
+  }
+  printf("octomap binary:       %8.3lf s to save, %8.3lf s to load, %8.2lf MB\n", write_time / runs, read_time / runs, fileSize(binary_file));
+
+  double map_time = 0.0, region_time = 0.0;
+  write_time = read_time = 0.0;
+  std::size_t region_subtrees = 0, subtrees = 0;
+  for (unsigned int r = 0 ; r < runs ; ++r)
+  {
+    ros::WallTime start = ros::WallTime::now();
+    tree.lockRead();
+    OccMapSnapshot::write(tree, snapshot_file);
+    tree.unlockRead();
+    write_time += (ros::WallTime::now() - start).toSec();
+
+    OccMapTree loaded(resolution);
+    start = ros::WallTime::now();
+    OccMapSnapshot snapshot;
+    snapshot.open(snapshot_file);
+    map_time += (ros::WallTime::now() - start).toSec();
+    loaded.lockWrite();
+    snapshot.materialize(loaded);
+    loaded.unlockWrite();
+    read_time += (ros::WallTime::now() - start).toSec();
+    subtrees = snapshot.getSubtreeCount();
+
+    // only the part of the map around a robot standing in a corner of it
+    OccMapTree partial(resolution);
+    start = ros::WallTime::now();
+    snapshot.open(snapshot_file);
+    partial.lockWrite();
+    snapshot.materializeCoarseLeaves(partial);
+    region_subtrees = snapshot.materializeRegion(partial, octomap::point3d(0.0, 0.0, 0.0), octomap::point3d(1.0, 1.0, 1.0));
+    partial.unlockWrite();
+    region_time += (ros::WallTime::now() - start).toSec();
+  }
+  printf("snapshot:             %8.3lf s to save, %8.3lf s to load (%.6lf s to map), %8.2lf MB\n", write_time / runs, read_time / runs,
+         map_time / runs, fileSize(snapshot_file));
+  printf("snapshot, 1 m region: %8.3lf s to load %u of %u subtrees\n", region_time / runs, (unsigned int)region_subtrees, (unsigned int)subtrees);
+
+  // change a part of the map between snapshots, as a robot moving through it would
+  double full_time = 0.0, incremental_time = 0.0;
+  const double band = std::max(resolution, changed * size);
+  for (unsigned int r = 0 ; r < runs ; ++r)
+  {
+    const double x0 = rng.uniformReal(0.0, size - band);
+    std::vector<OccMapTree::NodeUpdate> updates;
+    for (double x = x0 ; x < x0 + band ; x += resolution)
+      for (double y = 0.0 ; y < size ; y += resolution)
+        for (double z = 0.0 ; z < size ; z += resolution)
+          updates.push_back(OccMapTree::NodeUpdate(tree.coordToKey(x, y, z), tree.getProbMissLog()));
+    tree.updateNodes(updates);
+
+    ros::WallTime start = ros::WallTime::now();
+    tree.lockRead();
+    OccMapSnapshot::write(tree, snapshot_file, true);
+    tree.unlockRead();
+    incremental_time += (ros::WallTime::now() - start).toSec();
+
+    start = ros::WallTime::now();
+    tree.lockRead();
+    tree.writeBinary(binary_file);
+    tree.unlockRead();
+    full_time += (ros::WallTime::now() - start).toSec();
+  }
+  printf("after changing %.1lf%% of the map: %8.3lf s to save a snapshot incrementally, %8.3lf s to save in octomap binary, %8.2lf MB snapshot\n",
+         100.0 * band / size, incremental_time / runs, full_time / runs, fileSize(snapshot_file));
+
+  boost::filesystem::remove(binary_file);
+  boost::filesystem::remove(snapshot_file);
+  return 0;
+}
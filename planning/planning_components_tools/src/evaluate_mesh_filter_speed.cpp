@@ -0,0 +1,228 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/mesh_filter/mesh_filter.h>
+#include <moveit/mesh_filter/stereo_camera_model.h>
+#include <geometric_shapes/shapes.h>
+#include <geometric_shapes/shape_operations.h>
+#include <ros/time.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/bind.hpp>
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+using namespace mesh_filter;
+
+/* An arm moving in front of the camera, with a link mesh per joint. Without meshes on the
+   command line, the links are tessellated primitives of the sizes of a typical 7 DOF arm. */
+class ArmScene
+{
+public:
+
+  ArmScene(const std::vector<std::string> &resources)
+  {
+    if (resources.empty())
+    {
+      addShape(new shapes::Box(0.3, 0.3, 0.2));
+      for (unsigned int i = 0 ; i < 7 ; ++i)
+      {
+        addShape(new shapes::Cylinder(0.06 - 0.005 * i, 0.25));
+        addShape(new shapes::Sphere(0.07 - 0.005 * i));
+      }
+      addShape(new shapes::Box(0.08, 0.15, 0.05));
+      addShape(new shapes::Box(0.02, 0.02, 0.08));
+      addShape(new shapes::Box(0.02, 0.02, 0.08));
+    }
+    else
+      for (std::size_t i = 0 ; i < resources.size() ; ++i)
+      {
+        shapes::Mesh *mesh = shapes::createMeshFromResource(resources[i]);
+        if (mesh)
+        {
+          mesh->computeVertexNormals();
+          meshes_.push_back(mesh);
+        }
+        else
+          std::cerr << "Unable to load mesh '" << resources[i] << "'" << std::endl;
+      }
+    poses_.resize(meshes_.size(), Eigen::Affine3d::Identity());
+    setTime(0.0);
+  }
+
+  ~ArmScene()
+  {
+    for (std::size_t i = 0 ; i < meshes_.size() ; ++i)
+      delete meshes_[i];
+  }
+
+  /* chain the links in front of the camera, each link rotated by a joint angle that changes with time */
+  void setTime(double t)
+  {
+    Eigen::Affine3d pose = Eigen::Translation3d(0.0, 0.4, 1.2) * Eigen::AngleAxisd(-M_PI / 2.0, Eigen::Vector3d::UnitX());
+    for (std::size_t i = 0 ; i < poses_.size() ; ++i)
+    {
+      poses_[i] = pose;
+      pose = pose * Eigen::AngleAxisd(0.4 * sin(t + i), i % 2 ? Eigen::Vector3d::UnitX() : Eigen::Vector3d::UnitZ()) *
+        Eigen::Translation3d(0.0, 0.0, 0.12);
+    }
+  }
+
+  bool getTransform(MeshHandle handle, Eigen::Affine3d &transform) const
+  {
+    for (std::size_t i = 0 ; i < handles_.size() ; ++i)
+      if (handles_[i] == handle)
+      {
+        transform = poses_[i];
+        return true;
+      }
+    return false;
+  }
+
+  void addMeshes(MeshFilterBase &filter)
+  {
+    handles_.clear();
+    for (std::size_t i = 0 ; i < meshes_.size() ; ++i)
+      handles_.push_back(filter.addMesh(*meshes_[i]));
+  }
+
+  std::size_t getTriangleCount() const
+  {
+    std::size_t count = 0;
+    for (std::size_t i = 0 ; i < meshes_.size() ; ++i)
+      count += meshes_[i]->triangle_count;
+    return count;
+  }
+
+  std::size_t getMeshCount() const
+  {
+    return meshes_.size();
+  }
+
+private:
+
+  void addShape(shapes::Shape *shape)
+  {
+    shapes::Mesh *mesh = shapes::createMeshFromShape(shape);
+    delete shape;
+    mesh->computeVertexNormals();
+    meshes_.push_back(mesh);
+  }
+
+  std::vector<shapes::Mesh*> meshes_;
+  std::vector<Eigen::Affine3d> poses_;
+  std::vector<MeshHandle> handles_;
+};
+
+/* Time a frame as DepthImageOctomapUpdater processes it: filter the readings and retrieve the labels */
+double timeFrames(ArmScene &scene, MeshFilterBase::RenderBackend backend, unsigned int threads,
+                  unsigned int width, unsigned int height, unsigned int frames)
+{
+  StereoCameraModel::Parameters parameters(width, height, 0.4, 5.0, 525.0 * width / 640.0, 525.0 * width / 640.0,
+                                           (width - 1) / 2.0, (height - 1) / 2.0, 0.075, 0.125);
+  boost::scoped_ptr<MeshFilter<StereoCameraModel> > filter(new MeshFilter<StereoCameraModel>(boost::bind(&ArmScene::getTransform, &scene, _1, _2),
+                                                                                             parameters, backend));
+  filter->setPaddingScale(1.0);
+  filter->setPaddingOffset(0.02);
+  filter->setShadowThreshold(0.04);
+  filter->setRenderThreadCount(threads);
+  scene.addMeshes(*filter);
+
+  std::vector<unsigned short> readings(width * height, 2000);
+  std::vector<LabelType> labels(width * height);
+
+  // the first frame allocates buffers
+  filter->filter(&readings[0], GL_UNSIGNED_SHORT);
+  filter->getFilteredLabels(&labels[0]);
+
+  ros::WallTime start = ros::WallTime::now();
+  for (unsigned int i = 0 ; i < frames ; ++i)
+  {
+    scene.setTime(i * 0.05);
+    filter->filter(&readings[0], GL_UNSIGNED_SHORT);
+    filter->getFilteredLabels(&labels[0]);
+  }
+  return frames > 0 ? 1000.0 * (ros::WallTime::now() - start).toSec() / frames : 0.0;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned int width = 640;
+  unsigned int height = 480;
+  unsigned int frames = 100;
+  unsigned int threads = 0;
+  std::vector<std::string> resources;
+
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("help", "Show help message")
+    ("width", boost::program_options::value<unsigned int>(&width)->default_value(width), "Width of the depth image")
+    ("height", boost::program_options::value<unsigned int>(&height)->default_value(height), "Height of the depth image")
+    ("frames", boost::program_options::value<unsigned int>(&frames)->default_value(frames), "Number of frames to filter")
+    ("threads", boost::program_options::value<unsigned int>(&threads)->default_value(threads), "Threads of the software renderer (0 for the OpenMP default)")
+    ("mesh", boost::program_options::value<std::vector<std::string> >(&resources), "Link mesh resources (e.g. package://...) to use instead of primitives")
+    ("opengl", "Also time the OpenGL backend (requires a display)");
+
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help"))
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  ArmScene scene(resources);
+  printf("%u x %u depth images, %u meshes with %u triangles\n", width, height,
+         (unsigned int)scene.getMeshCount(), (unsigned int)scene.getTriangleCount());
+
+  double single = timeFrames(scene, MeshFilterBase::SoftwareBackend, 1, width, height, frames);
+  printf("software, 1 thread:     %8.3lf ms per frame\n", single);
+  if (threads != 1)
+  {
+    double multi = timeFrames(scene, MeshFilterBase::SoftwareBackend, threads, width, height, frames);
+    if (threads == 0)
+      printf("software, all threads:  %8.3lf ms per frame (%.1fx)\n", multi, multi > 0.0 ? single / multi : 0.0);
+    else
+      printf("software, %2u threads:   %8.3lf ms per frame (%.1fx)\n", threads, multi, multi > 0.0 ? single / multi : 0.0);
+  }
+  if (vm.count("opengl"))
+    printf("opengl:                 %8.3lf ms per frame\n", timeFrames(scene, MeshFilterBase::OpenGLBackend, 0, width, height, frames));
+
+  return 0;
+}
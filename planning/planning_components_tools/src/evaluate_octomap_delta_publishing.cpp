@@ -0,0 +1,210 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/occupancy_map_monitor/occupancy_map_delta.h>
+#include <octomap_msgs/conversions.h>
+#include <ros/ros.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <random_numbers/random_numbers.h>
+#include <iostream>
+
+using namespace occupancy_map_monitor;
+
+static const double HEIGHT = 3.0;
+
+// the walls, floor and ceiling of a room as seen after a few observations, and the free space inside it
+void makeRoom(OccMapTree &tree, double size)
+{
+  const double step = tree.getResolution();
+  for (double x = 0.0 ; x < size ; x += step)
+  {
+    std::vector<OccMapTree::NodeUpdate> updates;
+    for (double y = 0.0 ; y < size ; y += step)
+      for (double z = 0.0 ; z < HEIGHT ; z += step)
+      {
+        const bool surface = x < step || y < step || z < step || x + step >= size || y + step >= size || z + step >= HEIGHT;
+        for (unsigned int i = 0 ; i < 3 ; ++i)
+          updates.push_back(OccMapTree::NodeUpdate(tree.coordToKey(x, y, z), surface ? tree.getProbHitLog() : tree.getProbMissLog()));
+      }
+    tree.updateNodes(updates);
+  }
+}
+
+// what a sensor looking at a patch of a wall would add to the map: hits on the wall, misses in front of it, and a box
+// standing in front of the wall that was not there before
+void observe(const OccMapTree &tree, double size, double patch, random_numbers::RandomNumberGenerator &rng,
+             std::vector<OccMapTree::NodeUpdate> &updates)
+{
+  const double step = tree.getResolution();
+  const double x0 = rng.uniformReal(0.0, size - patch);
+  const double z0 = rng.uniformReal(0.0, HEIGHT - patch);
+  const bool box = rng.uniformInteger(0, 4) == 0;
+  updates.clear();
+  for (double x = x0 ; x < x0 + patch ; x += step)
+    for (double z = z0 ; z < z0 + patch ; z += step)
+    {
+      updates.push_back(OccMapTree::NodeUpdate(tree.coordToKey(x, 0.0, z), tree.getProbHitLog()));
+      for (double y = step ; y < 1.0 ; y += step)
+      {
+        // the cells of the box are free in the map, so they take two hits to become occupied
+        if (box && y > 0.5 && y < 0.7 && x < x0 + 0.2 && z < z0 + 0.2)
+          updates.insert(updates.end(), 2, OccMapTree::NodeUpdate(tree.coordToKey(x, y, z), tree.getProbHitLog()));
+        else
+          updates.push_back(OccMapTree::NodeUpdate(tree.coordToKey(x, y, z), tree.getProbMissLog()));
+      }
+    }
+}
+
+int main(int argc, char **argv)
+{
+  ros::Time::init();
+
+  double size = 20.0;
+  double resolution = 0.05;
+  double patch = 1.0;
+  unsigned int publishes = 100;
+  unsigned int keyframe_interval = 20;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("size", boost::program_options::value<double>(&size)->default_value(size), "Side of the room (m); the room is 3 m high")
+    ("resolution", boost::program_options::value<double>(&resolution)->default_value(resolution), "Resolution of the octree")
+    ("patch", boost::program_options::value<double>(&patch)->default_value(patch), "Side of the patch of wall observed between publishes (m)")
+    ("publishes", boost::program_options::value<unsigned int>(&publishes)->default_value(publishes), "Number of maps published")
+    ("keyframe-interval", boost::program_options::value<unsigned int>(&keyframe_interval)->default_value(keyframe_interval), "Number of deltas between keyframes")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || publishes == 0)
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  OccMapTree tree(resolution);
+  makeRoom(tree, size);
+  printf("Room of %.1lf x %.1lf x %.1lf m at resolution %lf: %u nodes; %u publishes, each after observing %.1lf x %.1lf m of a wall\n",
+         size, size, HEIGHT, resolution, (unsigned int)tree.size(), publishes, patch, patch);
+
+  // the same observations are made in both runs
+  random_numbers::RandomNumberGenerator rng(1);
+  std::vector<std::vector<OccMapTree::NodeUpdate> > observations(publishes);
+  for (unsigned int i = 0 ; i < publishes ; ++i)
+    observe(tree, size, patch, rng, observations[i]);
+
+  // the full map on every publish, as the monitor sends it
+  {
+    OccMapTree copy(resolution);
+    makeRoom(copy, size);
+    double update_time = 0.0, encode_time = 0.0, decode_time = 0.0;
+    double bytes = 0.0;
+    for (unsigned int i = 0 ; i < publishes ; ++i)
+    {
+      ros::WallTime start = ros::WallTime::now();
+      copy.updateNodes(observations[i]);
+      update_time += (ros::WallTime::now() - start).toSec();
+
+      octomap_msgs::Octomap msg;
+      start = ros::WallTime::now();
+      copy.lockRead();
+      octomap_msgs::binaryMapToMsg(copy, msg);
+      copy.unlockRead();
+      encode_time += (ros::WallTime::now() - start).toSec();
+      bytes += msg.data.size();
+
+      start = ros::WallTime::now();
+      delete octomap_msgs::msgToMap(msg);
+      decode_time += (ros::WallTime::now() - start).toSec();
+    }
+    printf("full maps:  %10.0lf bytes, %8.5lf s to encode, %8.5lf s to decode per publish; %8.5lf s to update the map\n",
+           bytes / publishes, encode_time / publishes, decode_time / publishes, update_time / publishes);
+  }
+
+  // keyframes and deltas
+  {
+    OccMapDeltaEncoder encoder(keyframe_interval);
+    OccMapDeltaDecoder decoder;
+    double update_time = 0.0, encode_time = 0.0, decode_time = 0.0;
+    double bytes = 0.0, delta_bytes = 0.0;
+    unsigned int keyframes = 0;
+    octomap_msgs::Octomap msg;
+    tree.lockRead();
+    encoder.encode(tree, msg);
+    tree.unlockRead();
+    decoder.decode(msg);
+    for (unsigned int i = 0 ; i < publishes ; ++i)
+    {
+      ros::WallTime start = ros::WallTime::now();
+      tree.updateNodes(observations[i]);
+      update_time += (ros::WallTime::now() - start).toSec();
+
+      start = ros::WallTime::now();
+      tree.lockRead();
+      const bool keyframe = encoder.encode(tree, msg);
+      tree.unlockRead();
+      encode_time += (ros::WallTime::now() - start).toSec();
+      bytes += msg.data.size();
+      if (keyframe)
+        keyframes++;
+      else
+        delta_bytes += msg.data.size();
+
+      start = ros::WallTime::now();
+      if (!decoder.decode(msg))
+        ROS_ERROR("Unable to decode map %u", i);
+      decode_time += (ros::WallTime::now() - start).toSec();
+    }
+    printf("deltas:     %10.0lf bytes, %8.5lf s to encode, %8.5lf s to decode per publish; %8.5lf s to update the map\n",
+           bytes / publishes, encode_time / publishes, decode_time / publishes, update_time / publishes);
+    printf("            %u keyframes, %.0lf bytes per delta\n", keyframes, keyframes < publishes ? delta_bytes / (publishes - keyframes) : 0.0);
+
+    // the decoded map tells apart the same cells as the map
+    unsigned int different = 0;
+    for (unsigned int i = 0 ; i < publishes ; ++i)
+      for (std::size_t j = 0 ; j < observations[i].size() ; ++j)
+      {
+        const octomap::OcTreeNode *node = tree.search(observations[i][j].key_);
+        const octomap::OcTreeNode *decoded = decoder.getOcTree()->search(observations[i][j].key_);
+        if ((node == NULL) != (decoded == NULL) || (node && tree.isNodeOccupied(node) != decoder.getOcTree()->isNodeOccupied(decoded)))
+          different++;
+      }
+    if (different > 0)
+      ROS_ERROR("%u cells differ in the decoded map", different);
+  }
+
+  return 0;
+}
@@ -0,0 +1,175 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/occupancy_map_monitor/occupancy_map.h>
+#include <ros/ros.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/math/constants/constants.hpp>
+#include <boost/thread.hpp>
+#include <random_numbers/random_numbers.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace occupancy_map_monitor;
+
+// the cell updates of one sensor frame: free cells along the rays and occupied cells at their ends, for a sensor
+// mounted at the center of the room, 1.2 m high, looking in the direction yaw
+void makeBatch(const OccMapTree &tree, double yaw, unsigned int rays, random_numbers::RandomNumberGenerator &rng,
+               std::vector<OccMapTree::NodeUpdate> &batch)
+{
+  const double step = tree.getResolution();
+  for (unsigned int i = 0 ; i < rays ; ++i)
+  {
+    const double a = yaw + rng.uniformReal(-0.5, 0.5);
+    const double b = rng.uniformReal(-0.4, 0.4);
+    const double range = rng.uniformReal(1.5, 3.0);
+    const double dx = cos(a) * cos(b), dy = sin(a) * cos(b), dz = sin(b);
+    for (double r = 0.0 ; r < range ; r += 4.0 * step) // sparse free cells, to keep the batches small
+      batch.push_back(OccMapTree::NodeUpdate(tree.coordToKey(r * dx, r * dy, 1.2 + r * dz), tree.getProbMissLog()));
+    batch.push_back(OccMapTree::NodeUpdate(tree.coordToKey(range * dx, range * dy, 1.2 + range * dz), tree.getProbHitLog()));
+  }
+}
+
+// what the updaters did before the tree was sharded: lock the whole tree and update the cells one by one
+void updateWithTreeLock(OccMapTree &tree, const std::vector<OccMapTree::NodeUpdate> &batch)
+{
+  tree.lockWrite();
+  for (std::size_t i = 0 ; i < batch.size() ; ++i)
+    tree.updateNode(batch[i].key_, batch[i].log_odds_update_);
+  tree.unlockWrite();
+}
+
+void runSensor(OccMapTree *tree, const std::vector<std::vector<OccMapTree::NodeUpdate> > *batches, bool sharded)
+{
+  for (std::size_t i = 0 ; i < batches->size() ; ++i)
+    if (sharded)
+      tree->updateNodes((*batches)[i]);
+    else
+      updateWithTreeLock(*tree, (*batches)[i]);
+}
+
+// a reader like the planning scene monitor: lock the tree, look up a few cells, let go
+void runReader(OccMapTree *tree, const std::vector<OccMapTree::NodeUpdate> *cells, bool *done, double *total_wait, double *max_wait, unsigned int *reads)
+{
+  while (true)
+  {
+    ros::WallTime start = ros::WallTime::now();
+    tree->lockRead();
+    const double wait = (ros::WallTime::now() - start).toSec();
+    const bool finished = *done;
+    for (std::size_t i = 0 ; i < cells->size() ; i += 50)
+      tree->search((*cells)[i].key_);
+    tree->unlockRead();
+    if (finished)
+      break;
+    *total_wait += wait;
+    *max_wait = std::max(*max_wait, wait);
+    (*reads)++;
+    ros::WallDuration(0.001).sleep();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  ros::Time::init();
+
+  unsigned int max_sensors = 4;
+  unsigned int frames = 50;
+  unsigned int rays = 5000;
+  double resolution = 0.02;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("sensors", boost::program_options::value<unsigned int>(&max_sensors)->default_value(max_sensors), "Largest number of concurrent sensors to evaluate")
+    ("frames", boost::program_options::value<unsigned int>(&frames)->default_value(frames), "Number of frames each sensor integrates")
+    ("rays", boost::program_options::value<unsigned int>(&rays)->default_value(rays), "Number of rays in each frame")
+    ("resolution", boost::program_options::value<double>(&resolution)->default_value(resolution), "Resolution of the octree")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || max_sensors == 0)
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  printf("%u frames of %u rays per sensor at resolution %lf\n", frames, rays, resolution);
+  for (unsigned int sensors = 1 ; sensors <= max_sensors ; sensors *= 2)
+  {
+    // the sensors look in different directions, so they mostly update different octants of the map
+    random_numbers::RandomNumberGenerator rng(sensors);
+    OccMapTree generator(resolution);
+    std::vector<std::vector<std::vector<OccMapTree::NodeUpdate> > > batches(sensors);
+    std::vector<OccMapTree::NodeUpdate> all_cells;
+    for (unsigned int s = 0 ; s < sensors ; ++s)
+    {
+      const double yaw = boost::math::constants::pi<double>() * (0.25 + 2.0 * s / sensors);
+      batches[s].resize(frames);
+      for (unsigned int f = 0 ; f < frames ; ++f)
+        makeBatch(generator, yaw, rays, rng, batches[s][f]);
+      all_cells.insert(all_cells.end(), batches[s][0].begin(), batches[s][0].end());
+    }
+
+    for (int sharded = 0 ; sharded < 2 ; ++sharded)
+    {
+      OccMapTree tree(resolution);
+      bool done = false;
+      double total_wait = 0.0, max_wait = 0.0;
+      unsigned int reads = 0;
+      boost::thread reader(boost::bind(&runReader, &tree, &all_cells, &done, &total_wait, &max_wait, &reads));
+
+      ros::WallTime start = ros::WallTime::now();
+      boost::thread_group threads;
+      for (unsigned int s = 0 ; s < sensors ; ++s)
+        threads.create_thread(boost::bind(&runSensor, &tree, &batches[s], sharded != 0));
+      threads.join_all();
+      const double duration = (ros::WallTime::now() - start).toSec();
+
+      tree.lockWrite();
+      done = true;
+      tree.unlockWrite();
+      reader.join();
+
+      printf("%u sensors, %s: %8.2lf frames/s, %8.3lf s in total; reader waited %6.3lf ms on average, %6.3lf ms at most (%u reads)\n",
+             sensors, sharded ? "sharded updates" : "tree lock      ", sensors * frames / duration, duration,
+             reads > 0 ? 1000.0 * total_wait / reads : 0.0, 1000.0 * max_wait, reads);
+    }
+  }
+
+  return 0;
+}
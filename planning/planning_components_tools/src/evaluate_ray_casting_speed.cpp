@@ -0,0 +1,158 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/pointcloud_octomap_updater/parallel_ray_caster.h>
+#include <ros/ros.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/math/constants/constants.hpp>
+#include <random_numbers/random_numbers.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// the endpoints of a depth camera looking into a box shaped room, after conversion to octree cells
+struct SyntheticCloud
+{
+  octomap::point3d origin_;
+  std::vector<octomap::OcTreeKey> endpoints_;
+  std::size_t points_;
+};
+
+SyntheticCloud makeCloud(const octomap::OcTree &tree, unsigned int width, unsigned int height, double yaw,
+                         random_numbers::RandomNumberGenerator &rng)
+{
+  const double room[3] = { 3.0, 3.0, 2.5 };
+  const double focal = 0.75 * width; // roughly a 67 degrees horizontal field of view
+  SyntheticCloud cloud;
+  cloud.origin_ = octomap::point3d(0.0, 0.0, 1.2);
+  cloud.points_ = (std::size_t)width * height;
+  octomap::KeySet cells;
+  for (unsigned int v = 0 ; v < height ; ++v)
+    for (unsigned int u = 0 ; u < width ; ++u)
+    {
+      // optical axis along x, rotated by yaw
+      double x = 1.0, y = (width / 2.0 - u) / focal, z = (height / 2.0 - v) / focal;
+      double d[3] = { cos(yaw) * x - sin(yaw) * y, sin(yaw) * x + cos(yaw) * y, z };
+      double o[3] = { cloud.origin_.x(), cloud.origin_.y(), cloud.origin_.z() };
+      double t = std::numeric_limits<double>::infinity();
+      for (int k = 0 ; k < 3 ; ++k)
+        if (d[k] > 1e-9)
+          t = std::min(t, (room[k] - o[k]) / d[k]);
+        else
+          if (d[k] < -1e-9)
+            t = std::min(t, ((k == 2 ? 0.0 : -room[k]) - o[k]) / d[k]);
+      t *= 1.0 + rng.gaussian(0.0, 0.005); // sensor noise
+      cells.insert(tree.coordToKey(octomap::point3d(o[0] + t * d[0], o[1] + t * d[1], o[2] + t * d[2])));
+    }
+  cloud.endpoints_.assign(cells.begin(), cells.end());
+  return cloud;
+}
+
+int main(int argc, char **argv)
+{
+  ros::Time::init();
+
+  unsigned int clouds = 10;
+  unsigned int width = 640;
+  unsigned int height = 480;
+  unsigned int max_threads = 8;
+  double resolution = 0.02;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("clouds", boost::program_options::value<unsigned int>(&clouds)->default_value(clouds), "Number of synthetic clouds to generate and replay")
+    ("width", boost::program_options::value<unsigned int>(&width)->default_value(width), "Width of the synthetic depth camera")
+    ("height", boost::program_options::value<unsigned int>(&height)->default_value(height), "Height of the synthetic depth camera")
+    ("resolution", boost::program_options::value<double>(&resolution)->default_value(resolution), "Resolution of the octree")
+    ("threads", boost::program_options::value<unsigned int>(&max_threads)->default_value(max_threads), "Largest number of threads to evaluate")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help"))
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  // record the clouds first, so only ray casting is measured
+  octomap::OcTree tree(resolution);
+  random_numbers::RandomNumberGenerator rng(1);
+  std::vector<SyntheticCloud> recorded;
+  std::size_t points = 0;
+  for (unsigned int i = 0 ; i < clouds ; ++i)
+  {
+    recorded.push_back(makeCloud(tree, width, height, 2.0 * boost::math::constants::pi<double>() * i / clouds, rng));
+    points += recorded.back().points_;
+  }
+  printf("Replaying %u clouds of %u x %u points at resolution %lf\n", clouds, width, height, resolution);
+
+  // the serial hash set based ray casting the point cloud updater used
+  {
+    octomap::KeyRay ray;
+    std::size_t cells = 0;
+    ros::WallTime start = ros::WallTime::now();
+    for (std::size_t i = 0 ; i < recorded.size() ; ++i)
+    {
+      octomap::KeySet free_cells;
+      for (std::size_t j = 0 ; j < recorded[i].endpoints_.size() ; ++j)
+        if (tree.computeRayKeys(recorded[i].origin_, tree.keyToCoord(recorded[i].endpoints_[j]), ray))
+          free_cells.insert(ray.begin(), ray.end());
+      cells += free_cells.size();
+    }
+    double duration = (ros::WallTime::now() - start).toSec();
+    printf("serial key set:         %8.2lf ms per cloud, %6.2lf Mpoints/s (%u free cells per cloud)\n",
+           1000.0 * duration / clouds, points / duration / 1e6, (unsigned int)(cells / std::max(1u, clouds)));
+  }
+
+  for (unsigned int threads = 1 ; threads <= max_threads ; threads *= 2)
+  {
+    occupancy_map_monitor::ParallelRayCaster caster(threads);
+    std::vector<octomap::OcTreeKey> free_cells;
+    std::size_t cells = 0;
+    ros::WallTime start = ros::WallTime::now();
+    for (std::size_t i = 0 ; i < recorded.size() ; ++i)
+    {
+      caster.computeRayKeys(tree, recorded[i].origin_, recorded[i].endpoints_, free_cells);
+      cells += free_cells.size();
+    }
+    double duration = (ros::WallTime::now() - start).toSec();
+    printf("parallel, %2u threads:   %8.2lf ms per cloud, %6.2lf Mpoints/s (%u free cells per cloud)\n",
+           caster.getThreadCount(), 1000.0 * duration / clouds, points / duration / 1e6, (unsigned int)(cells / std::max(1u, clouds)));
+  }
+
+  return 0;
+}
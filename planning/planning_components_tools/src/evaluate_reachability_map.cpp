@@ -0,0 +1,166 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/reachability_map/reachability_map.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+static const std::string ROBOT_DESCRIPTION = "robot_description";
+
+// Replays the reachability check of pick planning (one IK query per candidate grasp pose) with and
+// without rejecting candidates through a reachability map first.
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "evaluate_reachability_map");
+
+  std::string filename;
+  unsigned int candidates = 1000;
+  double reachable_fraction = 0.3;
+  double radius = 1.5;
+  unsigned int attempts = 3;
+  double timeout = 0.05;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("map", boost::program_options::value<std::string>(&filename), "Reachability map built by moveit_generate_reachability_map")
+    ("candidates", boost::program_options::value<unsigned int>(&candidates)->default_value(candidates), "Number of candidate grasp poses")
+    ("reachable", boost::program_options::value<double>(&reachable_fraction)->default_value(reachable_fraction), "Fraction of candidates taken from reachable poses; the others are random")
+    ("radius", boost::program_options::value<double>(&radius)->default_value(radius), "Random candidates are placed within this distance of the base frame (m)")
+    ("attempts", boost::program_options::value<unsigned int>(&attempts)->default_value(attempts), "IK attempts per candidate")
+    ("timeout", boost::program_options::value<double>(&timeout)->default_value(timeout), "IK timeout per attempt (seconds)")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || filename.empty() || candidates == 0)
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  reachability_map::ReachabilityMap map;
+  if (!map.loadFromFile(filename))
+    return 1;
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  robot_model_loader::RobotModelLoader rml(ROBOT_DESCRIPTION);
+  const robot_model::JointModelGroup *jmg = rml.getModel() ? rml.getModel()->getJointModelGroup(map.getGroupName()) : NULL;
+  if (!jmg || !jmg->getSolverInstance())
+  {
+    ROS_ERROR("Group '%s' does not exist or has no kinematics solver", map.getGroupName().c_str());
+    return 1;
+  }
+
+  // candidate poses of the map's link, in the base frame of the map
+  robot_state::RobotState state(rml.getModel());
+  state.setToDefaultValues();
+  state.update();
+  const Eigen::Affine3d base = state.getGlobalLinkTransform(map.getBaseFrame());
+  random_numbers::RandomNumberGenerator rng(7);
+  EigenSTL::vector_Affine3d poses(candidates);
+  for (std::size_t i = 0 ; i < candidates ; ++i)
+    if (rng.uniform01() < reachable_fraction)
+    {
+      robot_state::RobotState sample(state);
+      sample.setToRandomPositions(jmg, rng);
+      sample.update();
+      poses[i] = base.inverse() * sample.getGlobalLinkTransform(map.getIKLinkName());
+    }
+    else
+    {
+      Eigen::Vector3d p;
+      do
+        p = Eigen::Vector3d(rng.uniformReal(-radius, radius), rng.uniformReal(-radius, radius), rng.uniformReal(-radius, radius));
+      while (p.norm() > radius);
+      double q[4];
+      rng.quaternion(q);
+      poses[i] = Eigen::Translation3d(p) * Eigen::Quaterniond(q[3], q[0], q[1], q[2]);
+    }
+
+  // IK for every candidate
+  std::vector<bool> solved(candidates);
+  std::size_t solved_count = 0;
+  ros::WallTime start = ros::WallTime::now();
+  for (std::size_t i = 0 ; i < candidates ; ++i)
+  {
+    robot_state::RobotState ik_state(state);
+    solved[i] = ik_state.setFromIK(jmg, base * poses[i], map.getIKLinkName(), attempts, timeout);
+    if (solved[i])
+      solved_count++;
+  }
+  double ik_time = (ros::WallTime::now() - start).toSec();
+
+  // reject candidates through the map first
+  std::size_t ik_calls = 0, filtered_solved = 0, false_rejections = 0;
+  start = ros::WallTime::now();
+  for (std::size_t i = 0 ; i < candidates ; ++i)
+  {
+    if (!map.isReachable(poses[i]))
+    {
+      if (solved[i])
+        false_rejections++;
+      continue;
+    }
+    ik_calls++;
+    robot_state::RobotState ik_state(state);
+    if (ik_state.setFromIK(jmg, base * poses[i], map.getIKLinkName(), attempts, timeout))
+      filtered_solved++;
+  }
+  double filtered_time = (ros::WallTime::now() - start).toSec();
+
+  // the cost of the query alone
+  start = ros::WallTime::now();
+  std::size_t accepted = 0;
+  for (std::size_t i = 0 ; i < candidates ; ++i)
+    if (map.isReachable(poses[i]))
+      accepted++;
+  double query_time = (ros::WallTime::now() - start).toSec();
+
+  printf("Group %s, link %s, %u candidates, map of %u reachable voxels at %.3f m\n", map.getGroupName().c_str(),
+         map.getIKLinkName().c_str(), candidates, (unsigned int)map.getReachableVoxelCount(), map.getResolution());
+  printf("IK only:      %5u IK calls, %5u solved, %9.3f s\n", candidates, (unsigned int)solved_count, ik_time);
+  printf("Map, then IK: %5u IK calls, %5u solved, %9.3f s (%.3f us per map query)\n", (unsigned int)ik_calls,
+         (unsigned int)filtered_solved, filtered_time, query_time * 1e6 / candidates);
+  printf("IK calls avoided: %u (%.1f%%), time saved: %.3f s (%.1f%%), solvable candidates rejected by the map: %u\n",
+         (unsigned int)(candidates - ik_calls), 100.0 * (candidates - ik_calls) / candidates, ik_time - filtered_time,
+         100.0 * (ik_time - filtered_time) / ik_time, (unsigned int)false_rejections);
+
+  ros::shutdown();
+  return 0;
+}
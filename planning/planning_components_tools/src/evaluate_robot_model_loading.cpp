@@ -0,0 +1,157 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2011, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <ros/ros.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/filesystem.hpp>
+#include <sstream>
+
+static const unsigned int JOINTS_PER_ARM = 30;
+
+// a torso carrying two serial arms of JOINTS_PER_ARM revolute joints each
+void makeDualArmRobot(std::string &urdf, std::string &srdf)
+{
+  std::stringstream u, s;
+  u << "<robot name=\"dual_arm\">";
+  u << "<material name=\"grey\"><color rgba=\"0.6 0.6 0.6 1\"/></material>";
+  u << "<link name=\"torso\"><visual><geometry><box size=\"0.4 0.6 1.0\"/></geometry><material name=\"grey\"/></visual>"
+    << "<collision><geometry><box size=\"0.4 0.6 1.0\"/></geometry></collision></link>";
+  s << "<robot name=\"dual_arm\">";
+
+  const char *sides[2] = { "left", "right" };
+  for (int side = 0 ; side < 2 ; ++side)
+  {
+    std::string parent = "torso";
+    for (unsigned int i = 0 ; i < JOINTS_PER_ARM ; ++i)
+    {
+      std::stringstream link, joint;
+      link << sides[side] << "_link_" << i;
+      joint << sides[side] << "_joint_" << i;
+      u << "<link name=\"" << link.str() << "\">"
+        << "<inertial><mass value=\"0.5\"/><inertia ixx=\"0.01\" ixy=\"0\" ixz=\"0\" iyy=\"0.01\" iyz=\"0\" izz=\"0.01\"/></inertial>"
+        << "<visual><origin xyz=\"0 0 0.05\"/><geometry><cylinder radius=\"0.04\" length=\"0.1\"/></geometry><material name=\"grey\"/></visual>"
+        << "<collision><origin xyz=\"0 0 0.05\"/><geometry><cylinder radius=\"0.045\" length=\"0.1\"/></geometry></collision></link>";
+      u << "<joint name=\"" << joint.str() << "\" type=\"revolute\"><parent link=\"" << parent << "\"/><child link=\"" << link.str() << "\"/>"
+        << "<origin xyz=\"0 " << (i == 0 ? (side == 0 ? 0.35 : -0.35) : 0.0) << " " << (i == 0 ? 0.4 : 0.1) << "\" rpy=\"0 0 0.1\"/>"
+        << "<axis xyz=\"" << (i % 2) << " " << ((i + 1) % 2) << " 0\"/>"
+        << "<limit lower=\"-2.5\" upper=\"2.5\" effort=\"50\" velocity=\"1.5\"/><dynamics damping=\"0.1\"/></joint>";
+      s << "<disable_collisions link1=\"" << parent << "\" link2=\"" << link.str() << "\" reason=\"Adjacent\"/>";
+      parent = link.str();
+    }
+    s << "<group name=\"" << sides[side] << "_arm\"><chain base_link=\"torso\" tip_link=\"" << parent << "\"/></group>";
+  }
+  u << "</robot>";
+  s << "<group name=\"both_arms\"><group name=\"left_arm\"/><group name=\"right_arm\"/></group>";
+  s << "</robot>";
+  urdf = u.str();
+  srdf = s.str();
+}
+
+double load(unsigned int runs, const boost::filesystem::path &clear_directory)
+{
+  double total = 0.0;
+  robot_model_loader::RobotModelLoader::Options opt("robot_description");
+  opt.load_kinematics_solvers_ = false;
+  for (unsigned int i = 0 ; i < runs ; ++i)
+  {
+    if (!clear_directory.empty())
+      boost::filesystem::remove_all(clear_directory);
+    ros::WallTime start = ros::WallTime::now();
+    robot_model_loader::RobotModelLoader rml(opt);
+    total += (ros::WallTime::now() - start).toSec();
+    if (!rml.getModel() || rml.getModel()->getVariableCount() != 2 * JOINTS_PER_ARM)
+    {
+      ROS_ERROR("Loading the robot model failed");
+      return -1.0;
+    }
+  }
+  return total * 1000.0 / runs;
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "evaluate_robot_model_loading");
+
+  unsigned int runs = 20;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("runs", boost::program_options::value<unsigned int>(&runs)->default_value(runs), "Number of loads of each kind")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || runs == 0)
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  // the robot, its joint limits and the cache directory all live in the private namespace of this node
+  std::string urdf, srdf;
+  makeDualArmRobot(urdf, srdf);
+  ros::NodeHandle nh("~");
+  nh.setParam("robot_description", urdf);
+  nh.setParam("robot_description_semantic", srdf);
+  for (int side = 0 ; side < 2 ; ++side)
+    for (unsigned int i = 0 ; i < JOINTS_PER_ARM ; ++i)
+    {
+      std::stringstream prefix;
+      prefix << "robot_description_planning/joint_limits/" << (side == 0 ? "left" : "right") << "_joint_" << i << "/";
+      nh.setParam(prefix.str() + "has_velocity_limits", true);
+      nh.setParam(prefix.str() + "max_velocity", 1.0);
+      nh.setParam(prefix.str() + "has_acceleration_limits", true);
+      nh.setParam(prefix.str() + "max_acceleration", 2.0);
+    }
+
+  boost::filesystem::path directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  printf("Dual arm robot with %u joints, URDF of %u bytes, %u runs\n", 2 * JOINTS_PER_ARM, (unsigned int)urdf.size(), runs);
+
+  printf("  %-28s: %8.3f ms\n", "no cache", load(runs, boost::filesystem::path()));
+  nh.setParam("robot_description_cache_directory", directory.string());
+  printf("  %-28s: %8.3f ms\n", "cold cache (parse and save)", load(runs, directory));
+  printf("  %-28s: %8.3f ms\n", "warm cache", load(runs, boost::filesystem::path()));
+
+  boost::filesystem::remove_all(directory);
+  nh.deleteParam("robot_description_cache_directory");
+  nh.deleteParam("robot_description_planning");
+  nh.deleteParam("robot_description_semantic");
+  nh.deleteParam("robot_description");
+  ros::shutdown();
+  return 0;
+}
@@ -0,0 +1,182 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/thread.hpp>
+#include <sensor_msgs/JointState.h>
+
+static const std::string ROBOT_DESCRIPTION="robot_description";
+
+struct ReaderStats
+{
+  ReaderStats() : checks(0), total_wait(0.0), max_wait(0.0)
+  {
+  }
+  std::size_t checks;
+  double total_wait;
+  double max_wait;
+};
+
+void publishJointStates(const ros::Publisher &pub, const robot_model::RobotModelConstPtr &model, double rate, const volatile bool *done)
+{
+  robot_state::RobotState state(model);
+  sensor_msgs::JointState js;
+  const std::vector<const robot_model::JointModel*> &joints = model->getSingleDOFJointModels();
+  for (std::size_t i = 0 ; i < joints.size() ; ++i)
+    js.name.push_back(joints[i]->getName());
+  js.position.resize(js.name.size());
+
+  ros::WallRate r(rate);
+  while (!*done)
+  {
+    state.setToRandomPositions();
+    for (std::size_t i = 0 ; i < joints.size() ; ++i)
+      js.position[i] = state.getVariablePosition(joints[i]->getFirstVariableIndex());
+    js.header.stamp = ros::Time::now();
+    pub.publish(js);
+    r.sleep();
+  }
+}
+
+void readScene(const planning_scene_monitor::PlanningSceneMonitorPtr &psm, double duration, ReaderStats *stats)
+{
+  collision_detection::CollisionRequest req;
+  ros::WallTime end = ros::WallTime::now() + ros::WallDuration(duration);
+  while (ros::WallTime::now() < end)
+  {
+    ros::WallTime start = ros::WallTime::now();
+    planning_scene_monitor::LockedPlanningSceneRO ls(psm);
+    double wait = (ros::WallTime::now() - start).toSec();
+    stats->total_wait += wait;
+    if (wait > stats->max_wait)
+      stats->max_wait = wait;
+    collision_detection::CollisionResult res;
+    ls->checkCollision(req, res);
+    stats->checks++;
+  }
+}
+
+void countUpdates(planning_scene_monitor::PlanningSceneMonitor::SceneUpdateType type, std::size_t *count)
+{
+  if (type & planning_scene_monitor::PlanningSceneMonitor::UPDATE_STATE)
+    (*count)++;
+}
+
+void runTrial(const planning_scene_monitor::PlanningSceneMonitorPtr &psm, bool snapshots, unsigned int nthreads, double duration)
+{
+  psm->enableSceneSnapshots(snapshots);
+
+  std::size_t updates = 0;
+  psm->clearUpdateCallbacks();
+  psm->addUpdateCallback(boost::bind(&countUpdates, _1, &updates));
+
+  std::vector<ReaderStats> stats(nthreads);
+  std::vector<boost::thread*> threads;
+  for (unsigned int i = 0 ; i < nthreads ; ++i)
+    threads.push_back(new boost::thread(boost::bind(&readScene, psm, duration, &stats[i])));
+  for (unsigned int i = 0 ; i < nthreads ; ++i)
+  {
+    threads[i]->join();
+    delete threads[i];
+  }
+  psm->clearUpdateCallbacks();
+
+  ReaderStats total;
+  for (unsigned int i = 0 ; i < nthreads ; ++i)
+  {
+    total.checks += stats[i].checks;
+    total.total_wait += stats[i].total_wait;
+    total.max_wait = std::max(total.max_wait, stats[i].max_wait);
+  }
+  ROS_INFO("%s: %lf collision checks per second with %u readers, lock acquisition %lf ms avg / %lf ms max, %lf state updates per second",
+           snapshots ? "snapshots" : "lock-based",
+           (double)total.checks / duration, nthreads,
+           total.checks > 0 ? 1000.0 * total.total_wait / total.checks : 0.0, 1000.0 * total.max_wait,
+           (double)updates / duration);
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "evaluate_scene_monitor_contention");
+
+  unsigned int nthreads = 4;
+  double duration = 10.0;
+  double rate = 1000.0;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("nthreads", boost::program_options::value<unsigned int>(&nthreads)->default_value(nthreads), "Number of reading threads to use")
+    ("duration", boost::program_options::value<double>(&duration)->default_value(duration), "Duration of each trial (seconds)")
+    ("rate", boost::program_options::value<double>(&rate)->default_value(rate), "Rate at which joint states are published (Hz)")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help"))
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  ros::AsyncSpinner spinner(2);
+  spinner.start();
+
+  planning_scene_monitor::PlanningSceneMonitorPtr psm(new planning_scene_monitor::PlanningSceneMonitor(ROBOT_DESCRIPTION));
+  if (psm->getPlanningScene())
+  {
+    // use a private topic so the benchmark does not interfere with a running system
+    ros::NodeHandle nh("~");
+    ros::Publisher pub = nh.advertise<sensor_msgs::JointState>("joint_states", 100);
+    psm->startStateMonitor(nh.resolveName("joint_states"), "");
+    // apply every received joint state to the scene
+    psm->setStateUpdateFrequency(0.0);
+
+    volatile bool done = false;
+    boost::thread publisher(boost::bind(&publishJointStates, pub, psm->getRobotModel(), rate, &done));
+    ros::WallDuration(1.0).sleep();
+
+    runTrial(psm, false, nthreads, duration);
+    runTrial(psm, true, nthreads, duration);
+
+    done = true;
+    publisher.join();
+  }
+  else
+    ROS_ERROR("Planning scene not configured");
+
+  return 0;
+}
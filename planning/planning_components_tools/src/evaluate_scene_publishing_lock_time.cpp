@@ -0,0 +1,186 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/thread.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string.hpp>
+#include <random_numbers/random_numbers.h>
+
+static const std::string ROBOT_DESCRIPTION="robot_description";
+
+struct WaitStats
+{
+  WaitStats() : count(0), total(0.0), max(0.0)
+  {
+  }
+
+  void add(double t)
+  {
+    count++;
+    total += t;
+    if (t > max)
+      max = t;
+  }
+
+  double average() const
+  {
+    return count > 0 ? total / count : 0.0;
+  }
+
+  std::size_t count;
+  double total;
+  double max;
+};
+
+moveit_msgs::CollisionObject makeBox(const std::string &id, const std::string &frame, double x, double y, double z)
+{
+  moveit_msgs::CollisionObject co;
+  co.id = id;
+  co.header.frame_id = frame;
+  co.operation = moveit_msgs::CollisionObject::ADD;
+  co.primitives.resize(1);
+  co.primitives[0].type = shape_msgs::SolidPrimitive::BOX;
+  co.primitives[0].dimensions.resize(3, 0.05);
+  co.primitive_poses.resize(1);
+  co.primitive_poses[0].position.x = x;
+  co.primitive_poses[0].position.y = y;
+  co.primitive_poses[0].position.z = z;
+  co.primitive_poses[0].orientation.w = 1.0;
+  return co;
+}
+
+// measure how long a reader has to wait for the scene lock
+void probeLock(const planning_scene_monitor::PlanningSceneMonitorPtr &psm, const volatile bool *done, WaitStats *stats)
+{
+  while (!*done)
+  {
+    ros::WallTime start = ros::WallTime::now();
+    psm->lockSceneRead();
+    stats->add((ros::WallTime::now() - start).toSec());
+    psm->unlockSceneRead();
+    ros::WallDuration(0.0005).sleep();
+  }
+}
+
+void runTrial(const planning_scene_monitor::PlanningSceneMonitorPtr &psm, unsigned int objects, unsigned int changes, double duration)
+{
+  random_numbers::RandomNumberGenerator rng;
+  const std::string &frame = psm->getRobotModel()->getModelFrame();
+  {
+    planning_scene_monitor::LockedPlanningSceneRW ps(psm);
+    ps->removeAllCollisionObjects();
+    for (unsigned int i = 0 ; i < objects ; ++i)
+      ps->processCollisionObjectMsg(makeBox("box" + boost::lexical_cast<std::string>(i), frame,
+                                            rng.uniformReal(2.0, 10.0), rng.uniformReal(-5.0, 5.0), rng.uniformReal(0.0, 2.0)));
+  }
+  psm->triggerSceneUpdateEvent(planning_scene_monitor::PlanningSceneMonitor::UPDATE_SCENE);
+  ros::WallDuration(1.0).sleep();
+
+  volatile bool done = false;
+  WaitStats reader_wait, writer_wait;
+  boost::thread prober(boost::bind(&probeLock, psm, &done, &reader_wait));
+
+  ros::WallTime end = ros::WallTime::now() + ros::WallDuration(duration);
+  while (ros::WallTime::now() < end)
+  {
+    {
+      ros::WallTime start = ros::WallTime::now();
+      planning_scene_monitor::LockedPlanningSceneRW ps(psm);
+      writer_wait.add((ros::WallTime::now() - start).toSec());
+      for (unsigned int i = 0 ; i < changes && objects > 0 ; ++i)
+        ps->processCollisionObjectMsg(makeBox("box" + boost::lexical_cast<std::string>(rng.uniformInteger(0, objects - 1)), frame,
+                                              rng.uniformReal(2.0, 10.0), rng.uniformReal(-5.0, 5.0), rng.uniformReal(0.0, 2.0)));
+    }
+    psm->triggerSceneUpdateEvent(planning_scene_monitor::PlanningSceneMonitor::UPDATE_GEOMETRY);
+    ros::WallDuration(0.01).sleep();
+  }
+  done = true;
+  prober.join();
+
+  ROS_INFO("%u objects, %u changed per update: reader wait %lf ms avg / %lf ms max, writer wait %lf ms avg / %lf ms max",
+           objects, changes, 1000.0 * reader_wait.average(), 1000.0 * reader_wait.max,
+           1000.0 * writer_wait.average(), 1000.0 * writer_wait.max);
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "evaluate_scene_publishing_lock_time");
+
+  std::string sizes = "10 100 1000 5000";
+  unsigned int changes = 1;
+  double duration = 5.0;
+  double frequency = 50.0;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("sizes", boost::program_options::value<std::string>(&sizes)->default_value(sizes), "Space separated list of scene sizes (number of collision objects)")
+    ("changes", boost::program_options::value<unsigned int>(&changes)->default_value(changes), "Number of objects modified between publishes")
+    ("duration", boost::program_options::value<double>(&duration)->default_value(duration), "Duration of each trial (seconds)")
+    ("frequency", boost::program_options::value<double>(&frequency)->default_value(frequency), "Maximum planning scene publishing frequency (Hz)")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help"))
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  planning_scene_monitor::PlanningSceneMonitorPtr psm(new planning_scene_monitor::PlanningSceneMonitor(ROBOT_DESCRIPTION));
+  if (psm->getPlanningScene())
+  {
+    psm->setPlanningScenePublishingFrequency(frequency);
+    psm->startPublishingPlanningScene(planning_scene_monitor::PlanningSceneMonitor::UPDATE_GEOMETRY, "scene_publishing_benchmark");
+
+    std::vector<std::string> size_str;
+    boost::split(size_str, sizes, boost::is_any_of(" "), boost::token_compress_on);
+    for (std::size_t i = 0 ; i < size_str.size() ; ++i)
+      if (!size_str[i].empty())
+        runTrial(psm, boost::lexical_cast<unsigned int>(size_str[i]), changes, duration);
+
+    psm->stopPublishingPlanningScene();
+  }
+  else
+    ROS_ERROR("Planning scene not configured");
+
+  return 0;
+}
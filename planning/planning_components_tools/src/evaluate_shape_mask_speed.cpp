@@ -0,0 +1,234 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/point_containment_filter/shape_mask.h>
+#include <geometric_shapes/shape_operations.h>
+#include <geometric_shapes/body_operations.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include <random_numbers/random_numbers.h>
+#include <ros/ros.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/bind.hpp>
+
+struct BenchmarkBody
+{
+  shapes::ShapeConstPtr shape_;
+  Eigen::Affine3d pose_;
+  point_containment_filter::ShapeHandle handle_;
+  boost::shared_ptr<bodies::Body> body_;
+};
+
+bool getTransform(point_containment_filter::ShapeHandle h, Eigen::Affine3d &transform, const std::vector<BenchmarkBody> *bodies)
+{
+  for (std::size_t i = 0 ; i < bodies->size() ; ++i)
+    if ((*bodies)[i].handle_ == h)
+    {
+      transform = (*bodies)[i].pose_;
+      return true;
+    }
+  return false;
+}
+
+// links of an arm in front of the camera: boxes, cylinders, spheres and meshes along a random walk
+std::vector<BenchmarkBody> makeBodies(unsigned int count, random_numbers::RandomNumberGenerator &rng)
+{
+  std::vector<BenchmarkBody> result(count);
+  Eigen::Vector3d position(0.0, 0.3, 1.0);
+  for (unsigned int i = 0 ; i < count ; ++i)
+  {
+    switch (i % 4)
+    {
+    case 0:
+      result[i].shape_.reset(new shapes::Cylinder(rng.uniformReal(0.03, 0.06), rng.uniformReal(0.1, 0.3)));
+      break;
+    case 1:
+      result[i].shape_.reset(new shapes::Box(rng.uniformReal(0.05, 0.15), rng.uniformReal(0.05, 0.15), rng.uniformReal(0.1, 0.2)));
+      break;
+    case 2:
+      result[i].shape_.reset(new shapes::Sphere(rng.uniformReal(0.03, 0.08)));
+      break;
+    default:
+      {
+        shapes::Cylinder c(rng.uniformReal(0.03, 0.06), rng.uniformReal(0.1, 0.2));
+        result[i].shape_.reset(shapes::createMeshFromShape(&c));
+      }
+      break;
+    }
+    double q[4];
+    rng.quaternion(q);
+    position += Eigen::Vector3d(rng.uniformReal(-0.08, 0.08), rng.uniformReal(-0.08, 0.02), rng.uniformReal(-0.05, 0.05));
+    result[i].pose_ = Eigen::Translation3d(position) * Eigen::Quaterniond(q[3], q[0], q[1], q[2]);
+    result[i].body_.reset(bodies::createBodyFromShape(result[i].shape_.get()));
+    result[i].body_->setPose(result[i].pose_);
+  }
+  return result;
+}
+
+// an organized cloud from a pinhole camera at the origin looking along z, seeing the bodies in front of a wall
+sensor_msgs::PointCloud2 makeCloud(const std::vector<BenchmarkBody> &bodies, unsigned int width, unsigned int height)
+{
+  sensor_msgs::PointCloud2 cloud;
+  cloud.width = width;
+  cloud.height = height;
+  sensor_msgs::PointCloud2Modifier modifier(cloud);
+  modifier.setPointCloud2FieldsByString(1, "xyz");
+  modifier.resize(width * height);
+
+  const double focal = 0.75 * width;
+  sensor_msgs::PointCloud2Iterator<float> x(cloud, "x"), y(cloud, "y"), z(cloud, "z");
+  for (unsigned int v = 0 ; v < height ; ++v)
+    for (unsigned int u = 0 ; u < width ; ++u, ++x, ++y, ++z)
+    {
+      Eigen::Vector3d dir((u - width / 2.0) / focal, (v - height / 2.0) / focal, 1.0);
+      Eigen::Vector3d p = dir * 3.0; // the wall
+      double best = p.norm();
+      dir.normalize();
+      for (std::size_t i = 0 ; i < bodies.size() ; ++i)
+      {
+        EigenSTL::vector_Vector3d intersections;
+        if (bodies[i].body_->intersectsRay(Eigen::Vector3d::Zero(), dir, &intersections, 1) && !intersections.empty() &&
+            intersections[0].norm() < best)
+        {
+          p = intersections[0];
+          best = p.norm();
+        }
+      }
+      *x = p.x();
+      *y = p.y();
+      *z = p.z();
+    }
+  return cloud;
+}
+
+// the mask as computed before bodies were binned in a grid: every point in the bounding sphere is tested against every body
+void maskContainmentReference(const std::vector<BenchmarkBody> &bodies, const sensor_msgs::PointCloud2 &cloud,
+                              double min_sensor_dist, double max_sensor_dist, std::vector<int> &mask)
+{
+  const unsigned int np = cloud.data.size() / cloud.point_step;
+  mask.resize(np);
+  std::vector<bodies::BoundingSphere> spheres(bodies.size());
+  for (std::size_t j = 0 ; j < bodies.size() ; ++j)
+  {
+    bodies[j].body_->setPose(bodies[j].pose_);
+    bodies[j].body_->computeBoundingSphere(spheres[j]);
+  }
+  bodies::BoundingSphere bound;
+  bodies::mergeBoundingSpheres(spheres, bound);
+  const double radiusSquared = bound.radius * bound.radius;
+
+  sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_y(cloud, "y");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_z(cloud, "z");
+  for (int i = 0 ; i < (int)np ; ++i)
+  {
+    Eigen::Vector3d pt = Eigen::Vector3d(*(iter_x+i), *(iter_y+i), *(iter_z+i));
+    double d = pt.norm();
+    int out = point_containment_filter::ShapeMask::OUTSIDE;
+    if (d < min_sensor_dist || d > max_sensor_dist)
+      out = point_containment_filter::ShapeMask::CLIP;
+    else
+      if ((bound.center - pt).squaredNorm() < radiusSquared)
+        for (std::size_t j = 0 ; j < bodies.size() && out == point_containment_filter::ShapeMask::OUTSIDE ; ++j)
+          if (bodies[j].body_->containsPoint(pt))
+            out = point_containment_filter::ShapeMask::INSIDE;
+    mask[i] = out;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  ros::Time::init();
+
+  unsigned int count = 40;
+  unsigned int clouds = 10;
+  unsigned int width = 640;
+  unsigned int height = 480;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("bodies", boost::program_options::value<unsigned int>(&count)->default_value(count), "Number of bodies to filter")
+    ("clouds", boost::program_options::value<unsigned int>(&clouds)->default_value(clouds), "Number of clouds (each with different body poses)")
+    ("width", boost::program_options::value<unsigned int>(&width)->default_value(width), "Width of the organized cloud")
+    ("height", boost::program_options::value<unsigned int>(&height)->default_value(height), "Height of the organized cloud")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help"))
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  random_numbers::RandomNumberGenerator rng(1);
+  double reference_time = 0.0, mask_time = 0.0;
+  std::size_t mismatches = 0, inside = 0, points = 0;
+  for (unsigned int c = 0 ; c < clouds ; ++c)
+  {
+    std::vector<BenchmarkBody> bodies = makeBodies(count, rng);
+    point_containment_filter::ShapeMask mask(boost::bind(&getTransform, _1, _2, &bodies));
+    for (std::size_t i = 0 ; i < bodies.size() ; ++i)
+      bodies[i].handle_ = mask.addShape(bodies[i].shape_);
+    sensor_msgs::PointCloud2 cloud = makeCloud(bodies, width, height);
+
+    std::vector<int> expected, result;
+    ros::WallTime start = ros::WallTime::now();
+    maskContainmentReference(bodies, cloud, 0.0, 2.5, expected);
+    reference_time += (ros::WallTime::now() - start).toSec();
+
+    start = ros::WallTime::now();
+    mask.maskContainment(cloud, Eigen::Vector3d::Zero(), 0.0, 2.5, result);
+    mask_time += (ros::WallTime::now() - start).toSec();
+
+    for (std::size_t i = 0 ; i < expected.size() ; ++i)
+    {
+      if (expected[i] != result[i])
+        mismatches++;
+      if (expected[i] == point_containment_filter::ShapeMask::INSIDE)
+        inside++;
+    }
+    points += expected.size();
+  }
+
+  printf("%u clouds of %u x %u points, %u bodies, %.1f%% of the points inside the bodies\n",
+         clouds, width, height, count, points > 0 ? 100.0 * inside / points : 0.0);
+  printf("testing every body:     %8.2lf ms per cloud\n", 1000.0 * reference_time / clouds);
+  printf("ShapeMask:              %8.2lf ms per cloud (%.1fx)\n", 1000.0 * mask_time / clouds,
+         mask_time > 0.0 ? reference_time / mask_time : 0.0);
+  printf("Points with a different mask value: %u\n", (unsigned int)mismatches);
+
+  return mismatches == 0 ? 0 : 1;
+}
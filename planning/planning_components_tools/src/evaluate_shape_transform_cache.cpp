@@ -0,0 +1,230 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
+#include <moveit/profiler/profiler.h>
+#include <tf_conversions/tf_eigen.h>
+#include <random_numbers/random_numbers.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <algorithm>
+#include <cmath>
+
+static const std::string ROBOT_DESCRIPTION = "shape_transform_benchmark_description";
+static const std::string SENSOR_FRAME = "sensor";
+
+// a serial chain of revolute joints with a box on every link, so the benchmark does not depend on a particular robot
+std::string buildChainURDF(unsigned int links)
+{
+  std::stringstream urdf;
+  urdf << "<?xml version=\"1.0\" ?><robot name=\"chain\">";
+  for (unsigned int i = 0 ; i < links ; ++i)
+  {
+    urdf << "<link name=\"link" << i << "\"><collision><origin xyz=\"0 0 0.05\" rpy=\"0 0 0\"/>"
+         << "<geometry><box size=\"0.05 0.05 0.1\"/></geometry></collision></link>";
+    if (i > 0)
+      urdf << "<joint name=\"joint" << i << "\" type=\"revolute\">"
+           << "<parent link=\"link" << i - 1 << "\"/><child link=\"link" << i << "\"/>"
+           << "<origin xyz=\"0 0 0.1\" rpy=\"0 0 0\"/><axis xyz=\"0 1 0\"/>"
+           << "<limit lower=\"-1.57\" upper=\"1.57\" effort=\"10\" velocity=\"1\"/></joint>";
+  }
+  urdf << "</robot>";
+  return urdf.str();
+}
+
+// feed tf with the same motion the joint states describe, the way robot_state_publisher would
+void setLinkTransforms(tf::Transformer &tf, const robot_state::RobotState &state, const ros::Time &stamp)
+{
+  const std::vector<const robot_model::LinkModel*> &links = state.getRobotModel()->getLinkModels();
+  for (std::size_t i = 0 ; i < links.size() ; ++i)
+  {
+    const robot_model::LinkModel *parent = links[i]->getParentLinkModel();
+    if (!parent)
+      continue;
+    Eigen::Affine3d t = state.getGlobalLinkTransform(parent).inverse() * state.getGlobalLinkTransform(links[i]);
+    tf::Transform tr;
+    tf::transformEigenToTF(t, tr);
+    tf.setTransform(tf::StampedTransform(tr, stamp, parent->getName(), links[i]->getName()));
+  }
+  tf::Transform sensor(tf::Quaternion(0, 0, 0, 1), tf::Vector3(1.0, 0.0, 0.5));
+  tf.setTransform(tf::StampedTransform(sensor, stamp, SENSOR_FRAME, state.getRobotModel()->getRootLinkName()));
+}
+
+double evaluate(const planning_scene_monitor::PlanningSceneMonitor &psm, const std::vector<ros::Time> &times,
+                const std::string &name, std::vector<occupancy_map_monitor::ShapeTransformArray> &results)
+{
+  results.resize(times.size());
+  std::size_t failed = 0;
+  ros::WallTime start = ros::WallTime::now();
+  for (std::size_t i = 0 ; i < times.size() ; ++i)
+  {
+    results[i].clear();
+    moveit::tools::Profiler::ScopedBlock _(name);
+    if (!psm.getShapeTransformArray(SENSOR_FRAME, times[i], results[i]))
+      failed++;
+  }
+  double duration = (ros::WallTime::now() - start).toSec();
+  if (failed)
+    ROS_WARN("%s: %u of %u queries failed", name.c_str(), (unsigned int)failed, (unsigned int)times.size());
+  return duration;
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "evaluate_shape_transform_cache");
+
+  unsigned int links = 40;
+  unsigned int queries = 1000;
+  double rate = 100.0;
+  double window = 2.0;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("links", boost::program_options::value<unsigned int>(&links)->default_value(links), "Number of links of the synthetic chain used as robot model")
+    ("queries", boost::program_options::value<unsigned int>(&queries)->default_value(queries), "Number of transform cache computations (one per simulated point cloud)")
+    ("rate", boost::program_options::value<double>(&rate)->default_value(rate), "Rate of the simulated joint states and tf data (Hz)")
+    ("window", boost::program_options::value<double>(&window)->default_value(window), "Length of the simulated motion (seconds)")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || links < 2)
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  // the robot model, a point cloud updater (its shape mask receives the excluded links) and a state history long enough
+  ros::NodeHandle pnh("~");
+  pnh.setParam(ROBOT_DESCRIPTION, buildChainURDF(links));
+  pnh.setParam(ROBOT_DESCRIPTION + "_semantic", std::string("<?xml version=\"1.0\" ?><robot name=\"chain\"></robot>"));
+  pnh.setParam(ROBOT_DESCRIPTION + "_planning/shape_transform_cache_state_history", window + 1.0);
+  pnh.setParam("octomap_resolution", 0.05);
+  XmlRpc::XmlRpcValue sensors;
+  sensors[0]["sensor_plugin"] = std::string("occupancy_map_monitor/PointCloudOctomapUpdater");
+  sensors[0]["point_cloud_topic"] = ros::this_node::getName() + "/points";
+  pnh.setParam("sensors", sensors);
+
+  boost::shared_ptr<tf::Transformer> tf(new tf::Transformer(true, ros::Duration(window + 10.0)));
+  planning_scene_monitor::PlanningSceneMonitor psm(ROBOT_DESCRIPTION, tf);
+  if (!psm.getPlanningScene())
+  {
+    ROS_ERROR("Unable to configure planning scene");
+    return 1;
+  }
+  psm.startWorldGeometryMonitor("", "", true);
+
+  // simulate a motion of the robot: joint states and tf at the same rate
+  robot_model::RobotModelConstPtr model = psm.getRobotModel();
+  const std::string topic = ros::this_node::getName() + "/joint_states";
+  ros::Publisher pub = pnh.advertise<sensor_msgs::JointState>("joint_states", 1000);
+  sensor_msgs::JointState js;
+  js.name = model->getVariableNames();
+  js.position.resize(js.name.size());
+
+  std::size_t samples = (std::size_t)(window * rate) + 1;
+  ros::Time t0 = ros::Time::now();
+  robot_state::RobotState state(model);
+  std::vector<sensor_msgs::JointState> messages;
+  for (std::size_t k = 0 ; k < samples ; ++k)
+  {
+    ros::Time stamp = t0 + ros::Duration((double)k / rate);
+    for (std::size_t i = 0 ; i < js.name.size() ; ++i)
+      js.position[i] = sin(2.0 * stamp.toSec() + i);
+    state.setVariablePositions(js.position);
+    state.update();
+    setLinkTransforms(*tf, state, stamp);
+    js.header.stamp = stamp;
+    messages.push_back(js);
+  }
+  ros::Time t1 = t0 + ros::Duration((double)(samples - 1) / rate);
+
+  // sensor data arrives at arbitrary times between the samples
+  random_numbers::RandomNumberGenerator rng;
+  std::vector<ros::Time> times(queries);
+  for (std::size_t i = 0 ; i < times.size() ; ++i)
+    times[i] = t0 + ros::Duration(rng.uniformReal(0.0, (t1 - t0).toSec()));
+
+  moveit::tools::Profiler::Clear();
+  moveit::tools::Profiler::Start();
+
+  // without a state monitor, every link is looked up in tf
+  std::vector<occupancy_map_monitor::ShapeTransformArray> tf_results;
+  double tf_time = evaluate(psm, times, "per-link tf lookups", tf_results);
+
+  psm.startStateMonitor(topic, "");
+  while (pub.getNumSubscribers() == 0 && ros::ok())
+    ros::WallDuration(0.01).sleep();
+  for (std::size_t k = 0 ; k < messages.size() ; ++k)
+  {
+    pub.publish(messages[k]);
+    ros::WallDuration(0.002).sleep(); // do not overflow the queue of the state monitor
+  }
+  ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(5.0);
+  while (psm.getStateMonitor()->getCurrentStateTime() != t1 && ros::WallTime::now() < deadline)
+    ros::WallDuration(0.01).sleep();
+  if (psm.getStateMonitor()->getCurrentStateTime() != t1)
+    ROS_WARN("Not all joint states were received; some queries will fall back to tf lookups");
+
+  std::vector<occupancy_map_monitor::ShapeTransformArray> fk_results;
+  double fk_time = evaluate(psm, times, "batched forward kinematics", fk_results);
+
+  moveit::tools::Profiler::Stop();
+  moveit::tools::Profiler::Status();
+
+  // the two methods interpolate differently between samples (tf per link, the state per joint); report how much that matters
+  double max_error = 0.0;
+  std::size_t shapes = 0;
+  for (std::size_t i = 0 ; i < times.size() ; ++i)
+    for (std::size_t h = 0 ; h < tf_results[i].getHandleEnd() ; ++h)
+    {
+      const Eigen::Affine3d *a = tf_results[i].get(h);
+      const Eigen::Affine3d *b = fk_results[i].get(h);
+      if (a && b)
+        max_error = std::max(max_error, (a->translation() - b->translation()).norm());
+      if (i == 0 && a)
+        shapes++;
+    }
+
+  printf("%u links, %u shapes: per-link tf lookups %lf us per cloud, batched forward kinematics %lf us per cloud (%.1fx)\n",
+         (unsigned int)model->getLinkModelsWithCollisionGeometry().size(), (unsigned int)shapes,
+         1e6 * tf_time / queries, 1e6 * fk_time / queries, fk_time > 0.0 ? tf_time / fk_time : 0.0);
+  printf("Largest difference in shape position between the two methods: %lf m\n", max_error);
+
+  return 0;
+}
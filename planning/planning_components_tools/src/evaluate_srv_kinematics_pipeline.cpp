@@ -0,0 +1,143 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/srv_kinematics_plugin/srv_kinematics_plugin.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+#include <tf_conversions/tf_eigen.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+static const std::string ROBOT_DESCRIPTION = "robot_description";
+
+void report(const std::string &name, std::size_t queries, std::size_t solved, double elapsed)
+{
+  printf("%-24s: %6.2f%% solved, %9.2f queries/s, %8.3f ms per query\n", name.c_str(), 100.0 * solved / queries,
+         queries / elapsed, elapsed * 1000.0 / queries);
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "evaluate_srv_kinematics_pipeline");
+
+  std::string group;
+  unsigned int queries = 1000;
+  unsigned int max_depth = 8;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("group", boost::program_options::value<std::string>(&group), "Name of the group to evaluate")
+    ("queries", boost::program_options::value<unsigned int>(&queries)->default_value(queries), "Number of IK queries")
+    ("depth", boost::program_options::value<unsigned int>(&max_depth)->default_value(max_depth), "Largest pipeline depth; powers of two up to this value are evaluated")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help") || group.empty() || queries == 0)
+  {
+    std::cout << desc << std::endl;
+    std::cout << "The service is found as for move_group (~<group>/kinematics_solver_service_name); "
+              << "moveit_fake_ik_service can stand in for a real solver." << std::endl;
+    return 0;
+  }
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  robot_model_loader::RobotModelLoader rml(ROBOT_DESCRIPTION, false);
+  const robot_model::JointModelGroup *jmg = rml.getModel() ? rml.getModel()->getJointModelGroup(group) : NULL;
+  if (!jmg)
+  {
+    ROS_ERROR("Group '%s' does not exist", group.c_str());
+    return 1;
+  }
+
+  const robot_model::LinkModel *parent = jmg->getJointModels().front()->getParentLinkModel();
+  const std::string base_frame = parent ? parent->getName() : rml.getModel()->getModelFrame();
+  const std::string tip_frame = jmg->getLinkModelNames().back();
+  srv_kinematics_plugin::SrvKinematicsPlugin solver;
+  if (!solver.initialize(ROBOT_DESCRIPTION, group, base_frame, tip_frame, 0.1))
+  {
+    ROS_ERROR("Unable to initialize the service kinematics solver for group '%s'", group.c_str());
+    return 1;
+  }
+
+  // reachable poses and random seeds, the same for every configuration
+  robot_state::RobotState state(rml.getModel());
+  state.setToDefaultValues();
+  std::vector<std::vector<geometry_msgs::Pose> > poses(queries, std::vector<geometry_msgs::Pose>(1));
+  std::vector<std::vector<double> > seeds(queries);
+  for (std::size_t i = 0 ; i < queries ; ++i)
+  {
+    state.setToRandomPositions(jmg);
+    state.update();
+    tf::Pose pose;
+    tf::poseEigenToTF(state.getGlobalLinkTransform(base_frame).inverse() * state.getGlobalLinkTransform(tip_frame), pose);
+    tf::poseTFToMsg(pose, poses[i][0]);
+    state.setToRandomPositions(jmg);
+    state.copyJointGroupPositions(jmg, seeds[i]);
+  }
+  printf("Group %s, %s -> %s, %u queries\n", group.c_str(), base_frame.c_str(), tip_frame.c_str(), queries);
+
+  // one blocking service call per pose, as used by RobotState::setFromIK()
+  std::vector<double> solution;
+  moveit_msgs::MoveItErrorCodes error_code;
+  std::size_t solved = 0;
+  ros::WallTime start = ros::WallTime::now();
+  for (std::size_t i = 0 ; i < queries ; ++i)
+    if (solver.searchPositionIK(poses[i][0], seeds[i], 1.0, solution, error_code))
+      solved++;
+  report("one call per pose", queries, solved, (ros::WallTime::now() - start).toSec());
+
+  std::vector<std::vector<double> > solutions;
+  std::vector<moveit_msgs::MoveItErrorCodes> error_codes;
+  for (unsigned int depth = 1 ; depth <= std::max(max_depth, 1u) ; depth *= 2)
+  {
+    solver.setPipelineDepth(depth);
+    start = ros::WallTime::now();
+    solver.searchPositionIKBatch(poses, seeds, solutions, error_codes);
+    double elapsed = (ros::WallTime::now() - start).toSec();
+    solved = 0;
+    for (std::size_t i = 0 ; i < error_codes.size() ; ++i)
+      if (error_codes[i].val == moveit_msgs::MoveItErrorCodes::SUCCESS)
+        solved++;
+    char name[64];
+    snprintf(name, sizeof(name), "batch, pipeline depth %u", depth);
+    report(name, queries, solved, elapsed);
+  }
+
+  ros::shutdown();
+  return 0;
+}
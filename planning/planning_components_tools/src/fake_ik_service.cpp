@@ -0,0 +1,105 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <ros/ros.h>
+#include <moveit_msgs/GetPositionIK.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+
+// A stand-in for an external IK service, for testing and benchmarking the srv kinematics plugin without
+// a real solver: every request is answered with its own seed state after a fixed solve time.
+
+static double solve_time = 0.001;
+static unsigned int fail_every = 0;
+static boost::mutex count_lock;
+static unsigned int request_count = 0;
+
+bool solveIK(moveit_msgs::GetPositionIK::Request &req, moveit_msgs::GetPositionIK::Response &res)
+{
+  if (solve_time > 0.0)
+    ros::WallDuration(solve_time).sleep();
+
+  unsigned int n;
+  {
+    boost::mutex::scoped_lock slock(count_lock);
+    n = ++request_count;
+  }
+
+  if (fail_every > 0 && n % fail_every == 0)
+    res.error_code.val = moveit_msgs::MoveItErrorCodes::NO_IK_SOLUTION;
+  else
+  {
+    res.solution = req.ik_request.robot_state;
+    res.error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+  }
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "fake_ik_service");
+
+  std::string service = "solve_ik";
+  unsigned int threads = 1;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("service", boost::program_options::value<std::string>(&service)->default_value(service), "Name of the advertised service")
+    ("solve_time", boost::program_options::value<double>(&solve_time)->default_value(solve_time), "Time spent on every request (seconds)")
+    ("threads", boost::program_options::value<unsigned int>(&threads)->default_value(threads), "Number of requests served concurrently")
+    ("fail_every", boost::program_options::value<unsigned int>(&fail_every)->default_value(fail_every), "Report NO_IK_SOLUTION for every n-th request (0 to never fail)")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  if (vm.count("help"))
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  ros::NodeHandle nh;
+  ros::ServiceServer server = nh.advertiseService(service, &solveIK);
+  ROS_INFO("Answering IK requests on '%s' with %u thread(s), %.4f s per request", server.getService().c_str(), threads, solve_time);
+
+  ros::AsyncSpinner spinner(std::max(threads, 1u));
+  spinner.start();
+  ros::waitForShutdown();
+
+  ROS_INFO("Answered %u requests", request_count);
+  return 0;
+}
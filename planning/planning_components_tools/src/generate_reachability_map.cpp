@@ -0,0 +1,221 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/reachability_map/reachability_map.h>
+#include <moveit/kdl_kinematics_plugin/kdl_kinematics_plugin.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <Eigen/SVD>
+
+static const std::string ROBOT_DESCRIPTION = "robot_description";
+
+// Yoshikawa's measure, generalized to fewer than 6 joints: the product of the singular values of the Jacobian
+double manipulability(const Eigen::MatrixXd &jacobian)
+{
+  Eigen::JacobiSVD<Eigen::MatrixXd> svd(jacobian);
+  const Eigen::VectorXd &sv = svd.singularValues();
+  double m = 1.0;
+  for (int i = 0 ; i < sv.size() ; ++i)
+    m *= sv[i];
+  return m;
+}
+
+// Poses of the tip (in the base frame) and their manipulability for a batch of random configurations.
+// Chains use the batched forward kinematics of the KDL solver; other groups go through RobotState.
+class PoseSampler
+{
+public:
+
+  PoseSampler(const robot_model::RobotModelConstPtr &model, const robot_model::JointModelGroup *jmg,
+              const std::string &base_frame, const std::string &tip_frame) :
+    jmg_(jmg), base_frame_(base_frame), tip_frame_(tip_frame), state_(model), rng_(1)
+  {
+    state_.setToDefaultValues();
+    if (jmg->isChain())
+    {
+      kdl_.reset(new kdl_kinematics_plugin::KDLKinematicsPlugin());
+      if (!kdl_->initialize(ROBOT_DESCRIPTION, jmg->getName(), base_frame, tip_frame, 0.1))
+        kdl_.reset();
+    }
+    if (!kdl_)
+      ROS_INFO("Group '%s' is not handled by the KDL solver; using RobotState for forward kinematics", jmg->getName().c_str());
+  }
+
+  void sample(std::size_t count, EigenSTL::vector_Affine3d &poses, std::vector<double> &manip)
+  {
+    poses.resize(count);
+    manip.resize(count);
+    if (kdl_)
+    {
+      const std::vector<std::string> &names = kdl_->getJointNames();
+      joints_.resize(count * names.size());
+      for (std::size_t c = 0 ; c < count ; ++c)
+      {
+        state_.setToRandomPositions(jmg_, rng_);
+        for (std::size_t j = 0 ; j < names.size() ; ++j)
+          joints_[c * names.size() + j] = state_.getVariablePosition(names[j]);
+      }
+      kdl_->getPositionFKBatch(std::vector<std::string>(1, tip_frame_), joints_, result_, true);
+      for (std::size_t c = 0 ; c < count ; ++c)
+      {
+        std::size_t k = result_.index(0, c);
+        poses[c] = Eigen::Translation3d(result_.x[k], result_.y[k], result_.z[k]) *
+          Eigen::Quaterniond(result_.qw[k], result_.qx[k], result_.qy[k], result_.qz[k]);
+        manip[c] = manipulability(Eigen::Map<const Eigen::MatrixXd>(&result_.jacobians[k * 6 * result_.joints], 6, result_.joints));
+      }
+    }
+    else
+    {
+      const robot_model::LinkModel *tip = state_.getRobotModel()->getLinkModel(tip_frame_);
+      Eigen::MatrixXd jacobian;
+      for (std::size_t c = 0 ; c < count ; ++c)
+      {
+        state_.setToRandomPositions(jmg_, rng_);
+        state_.update();
+        poses[c] = state_.getGlobalLinkTransform(base_frame_).inverse() * state_.getGlobalLinkTransform(tip);
+        state_.getJacobian(jmg_, tip, Eigen::Vector3d::Zero(), jacobian);
+        manip[c] = manipulability(jacobian);
+      }
+    }
+  }
+
+private:
+
+  const robot_model::JointModelGroup *jmg_;
+  std::string base_frame_;
+  std::string tip_frame_;
+  robot_state::RobotState state_;
+  random_numbers::RandomNumberGenerator rng_;
+  boost::scoped_ptr<kdl_kinematics_plugin::KDLKinematicsPlugin> kdl_;
+  std::vector<double> joints_;
+  kdl_kinematics_plugin::BatchKinematicsResult result_;
+};
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "generate_reachability_map");
+
+  std::string group;
+  std::string tip_frame;
+  std::string output;
+  std::string axis = "x";
+  unsigned int samples = 1000000;
+  unsigned int batch = 1000;
+  double resolution = 0.05;
+  bool no_dilate = false;
+  boost::program_options::options_description desc;
+  desc.add_options()
+    ("group", boost::program_options::value<std::string>(&group), "Name of the group to build the map for")
+    ("tip", boost::program_options::value<std::string>(&tip_frame), "Link whose poses are recorded (default: last link of the group)")
+    ("output", boost::program_options::value<std::string>(&output), "File to write the map to (default: <group>.reachability)")
+    ("samples", boost::program_options::value<unsigned int>(&samples)->default_value(samples), "Number of joint space samples")
+    ("batch", boost::program_options::value<unsigned int>(&batch)->default_value(batch), "Number of configurations per forward kinematics batch")
+    ("resolution", boost::program_options::value<double>(&resolution)->default_value(resolution), "Size of the voxels (m)")
+    ("axis", boost::program_options::value<std::string>(&axis)->default_value(axis), "Approach axis of the tip: x, y or z")
+    ("no_dilate", boost::program_options::bool_switch(&no_dilate), "Do not grow the reachable voxels by one voxel")
+    ("help", "this screen");
+  boost::program_options::variables_map vm;
+  boost::program_options::parsed_options po = boost::program_options::parse_command_line(argc, argv, desc);
+  boost::program_options::store(po, vm);
+  boost::program_options::notify(vm);
+
+  Eigen::Vector3d approach_axis = axis == "x" ? Eigen::Vector3d::UnitX() : axis == "y" ? Eigen::Vector3d::UnitY() : Eigen::Vector3d::UnitZ();
+  if (vm.count("help") || group.empty() || samples == 0 || batch == 0 || resolution <= 0.0 || (axis != "x" && axis != "y" && axis != "z"))
+  {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+  if (output.empty())
+    output = group + ".reachability";
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  robot_model_loader::RobotModelLoader rml(ROBOT_DESCRIPTION, false);
+  const robot_model::JointModelGroup *jmg = rml.getModel() ? rml.getModel()->getJointModelGroup(group) : NULL;
+  if (!jmg)
+  {
+    ROS_ERROR("Group '%s' does not exist", group.c_str());
+    return 1;
+  }
+  std::string base_frame = rml.getModel()->getModelFrame();
+  if (jmg->isChain())
+  {
+    const robot_model::LinkModel *parent = jmg->getJointModels().front()->getParentLinkModel();
+    if (parent)
+      base_frame = parent->getName();
+  }
+  if (tip_frame.empty())
+    tip_frame = jmg->getLinkModelNames().back();
+
+  PoseSampler sampler(rml.getModel(), jmg, base_frame, tip_frame);
+  EigenSTL::vector_Affine3d poses;
+  std::vector<double> manip;
+  ros::WallTime start = ros::WallTime::now();
+
+  // the bounds of the map come from a smaller set of samples, with a margin
+  sampler.sample(std::min(samples, 20000u), poses, manip);
+  Eigen::Vector3d min_corner = poses[0].translation(), max_corner = poses[0].translation();
+  for (std::size_t i = 1 ; i < poses.size() ; ++i)
+  {
+    min_corner = min_corner.cwiseMin(poses[i].translation());
+    max_corner = max_corner.cwiseMax(poses[i].translation());
+  }
+  min_corner -= Eigen::Vector3d::Constant(2.0 * resolution);
+  max_corner += Eigen::Vector3d::Constant(2.0 * resolution);
+
+  reachability_map::ReachabilityMap map(group, base_frame, tip_frame, min_corner, max_corner, resolution, approach_axis);
+  for (unsigned int done = 0 ; done < samples ; done += batch)
+  {
+    sampler.sample(std::min(batch, samples - done), poses, manip);
+    for (std::size_t i = 0 ; i < poses.size() ; ++i)
+      map.addSample(poses[i], manip[i]);
+  }
+  double sampling_time = (ros::WallTime::now() - start).toSec();
+  std::size_t sampled_voxels = map.getReachableVoxelCount();
+  if (!no_dilate)
+    map.dilate();
+
+  if (!map.saveToFile(output))
+    return 1;
+  printf("Group %s, %s -> %s: %u samples in %.2f s, %u of %u voxels reached (%u after dilation), written to %s\n",
+         group.c_str(), base_frame.c_str(), tip_frame.c_str(), samples, sampling_time, (unsigned int)sampled_voxels,
+         (unsigned int)map.getVoxelCount(), (unsigned int)map.getReachableVoxelCount(), output.c_str());
+
+  ros::shutdown();
+  return 0;
+}
@@ -44,6 +44,8 @@
 #include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <deque>
 
 namespace planning_scene_monitor
 {
@@ -136,6 +138,19 @@ public:
    *  @return Returns the map from joint names to joint state values*/
   std::map<std::string, double> getCurrentStateValues() const;
 
+  /** @brief Keep the states received over the last \e length seconds, so that the state at a past time can be queried with getStateAtTime().
+   *  A zero length (the default) disables the history. */
+  void setStateHistoryLength(const ros::Duration &length);
+
+  /** @brief Get the length of the retained state history */
+  ros::Duration getStateHistoryLength() const;
+
+  /** @brief Set the variable positions of \e state to the monitored state at time \e time, interpolating between the received joint states.
+   *  If \e time is more recent than the last received joint state, wait for at most \e timeout for a joint state at or after \e time;
+   *  if none arrives, the last received state is used. ros::Time(0) maps to the last received state without waiting.
+   *  @return False if the history is disabled, empty, or does not go back as far as \e time */
+  bool getStateAtTime(const ros::Time &time, robot_state::RobotState &state, const ros::Duration &timeout = ros::Duration(0)) const;
+
   /** @brief Wait for at most \e wait_time seconds until the complete current state is known. Return true if the full state is known */
   bool waitForCurrentState(double wait_time) const;
 
@@ -182,14 +197,39 @@ public:
 
 private:
 
+  /** @brief The mapping from the entries of a joint state message to the variables of the robot model.
+   *  Publishers keep the order of joint names fixed, so this is computed once per distinct list of names. */
+  struct JointStateLayout
+  {
+    std::vector<std::string> names_;
+
+    /// the joint each entry of the message refers to; NULL for entries that are ignored
+    std::vector<const robot_model::JointModel*> joints_;
+
+    /// the index of the variable each entry of the message refers to
+    std::vector<int> variable_index_;
+  };
+
+  /** @brief The full set of variable positions after a joint state message was applied */
+  struct StateHistorySample
+  {
+    ros::Time stamp_;
+    std::vector<double> positions_;
+  };
+
   void jointStateCallback(const sensor_msgs::JointStateConstPtr &joint_state);
+  void recordStateHistory(const ros::Time &stamp);
   bool isPassiveOrMimicDOF(const std::string &dof) const;
+  const JointStateLayout& getJointStateLayout(const std::vector<std::string> &names);
 
   ros::NodeHandle                              nh_;
   boost::shared_ptr<tf::Transformer>           tf_;
   robot_model::RobotModelConstPtr              robot_model_;
   robot_state::RobotState                      robot_state_;
-  std::map<std::string, ros::Time>             joint_time_;
+  std::vector<ros::Time>                       joint_time_;       // indexed by variable
+  std::vector<char>                            joint_received_;   // indexed by variable
+  std::vector<char>                            passive_or_mimic_; // indexed by variable
+  std::map<std::size_t, JointStateLayout>      joint_state_layouts_; // keyed by the hash of the list of names
   bool                                         state_monitor_started_;
   bool                                         copy_dynamics_;  // Copy velocity and effort from joint_state
   ros::Time                                    monitor_start_time_;
@@ -197,8 +237,11 @@ private:
   ros::Subscriber                              joint_state_subscriber_;
   ros::Time                                    current_state_time_;
   ros::Time                                    last_tf_update_;
+  ros::Duration                                state_history_length_;
+  std::deque<StateHistorySample>               state_history_;   // ordered by time stamp
 
   mutable boost::mutex                         state_update_lock_;
+  mutable boost::condition_variable            state_update_condition_; // notified when a joint state was received
   std::vector< JointStateUpdateCallback >      update_callbacks_;
 };
 
@@ -44,11 +44,13 @@
 #include <moveit/planning_scene/planning_scene.h>
 #include <moveit/robot_model_loader/robot_model_loader.h>
 #include <moveit/occupancy_map_monitor/occupancy_map_monitor.h>
+#include <moveit/occupancy_map_monitor/occupancy_map_delta.h>
 #include <moveit/planning_scene_monitor/current_state_monitor.h>
 #include <moveit/collision_plugin_loader/collision_plugin_loader.h>
 #include <boost/noncopyable.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
+#include <atomic>
 
 namespace planning_scene_monitor
 {
@@ -240,7 +242,10 @@ public:
   void monitorDiffs(bool flag);
 
   /** \brief Start publishing the maintained planning scene. The first message set out is a complete planning scene.
-      Diffs are sent afterwards on updates specified by the \e event bitmask. For UPDATE_SCENE, the full scene is always sent. */
+      Diffs are sent afterwards on updates specified by the \e event bitmask. For UPDATE_SCENE, the full scene is always sent.
+      If the parameter <robot_description>_planning/octomap_delta_keyframe_interval is positive, the octomap in the diffs
+      only holds the cells changed since the previous one, with the full octomap sent after that many diffs; planning scene
+      monitors receiving the scene decode them, other receivers only see the full octomaps. */
   void startPublishingPlanningScene(SceneUpdateType event, const std::string &planning_scene_topic = MONITORED_PLANNING_SCENE_TOPIC);
 
   /** \brief Stop publishing the maintained planning scene. */
@@ -273,6 +278,23 @@ public:
    */
   void updateFrameTransforms();
 
+  /** @brief Update only the transforms for the frames that are already known to the planning scene (the fixed transforms
+   *  it maintains). This avoids walking all the frames known to tf and is sufficient for users that do not expect new frames,
+   *  such as the kinematics services. */
+  void updateSceneFrameTransforms();
+
+  /** @brief Get the number of tf lookups performed when updating frame transforms, and the number of lookups that were
+   *  avoided because the cached transform was still the most recent one available */
+  void getFrameTransformLookupCounts(std::size_t &performed, std::size_t &avoided) const;
+
+  /** @brief Compute the poses, in \e target_frame at time \e target_time, of all the shapes excluded from the octomap.
+   *  This is called by the octomap updaters for every sensor message. When the current state monitor keeps a state history,
+   *  all poses follow from a single transform lookup and one forward kinematics pass; otherwise each link is looked up in tf. */
+  bool getShapeTransformArray(const std::string &target_frame, const ros::Time &target_time, occupancy_map_monitor::ShapeTransformArray &transforms) const;
+
+  /** @brief Same as getShapeTransformArray(), filling a map from shape handles to poses */
+  bool getShapeTransformCache(const std::string &target_frame, const ros::Time &target_time, occupancy_map_monitor::ShapeTransformCache &cache) const;
+
   /** @brief Start the current state monitor
       @param joint_states_topic the topic to listen to for joint states
       @param attached_objects_topic the topic to listen to for attached collision objects */
@@ -341,6 +363,31 @@ public:
   /** @brief This function is called every time there is a change to the planning scene */
   void triggerSceneUpdateEvent(SceneUpdateType update_type);
 
+  /** \brief Enable or disable read-copy-update snapshots of the maintained scene. When enabled, every update to
+      the scene publishes a new immutable snapshot of it, built as a diff of the previous snapshot that holds the
+      changes of the maintained scene (this turns on monitorDiffs()). Read-only users (LockedPlanningSceneRO) then
+      get a reference counted snapshot and do not hold the scene lock, so they are not blocked by incoming
+      updates. Only the octree, which is shared by all snapshots, remains locked for reading. Since the maintained
+      scene itself is not locked, a scene obtained earlier from getPlanningScene() must be read through
+      LockedPlanningSceneRO::getSceneForReading(). */
+  void enableSceneSnapshots(bool flag);
+
+  /** \brief Return true if read-copy-update snapshots of the scene are maintained */
+  bool sceneSnapshotsEnabled() const
+  {
+    return use_snapshots_;
+  }
+
+  /** \brief Get the most recent snapshot of the maintained scene. The returned scene is never modified by the monitor.
+      If snapshots are not enabled, an empty pointer is returned. */
+  planning_scene::PlanningSceneConstPtr getPlanningSceneSnapshot() const;
+
+  /** \brief Lock the data shared by all snapshots (the octree) for reading */
+  void lockSnapshotRead();
+
+  /** \brief Unlock the data shared by all snapshots (the octree) */
+  void unlockSnapshotRead();
+
   /** \brief Lock the scene for reading (multiple threads can lock for reading at the same time) */
   void lockSceneRead();
 
@@ -382,6 +429,13 @@ protected:
   /** @brief Callback for octomap updates */
   void octomapUpdateCallback();
 
+  /** @brief Replace the octomap in \e msg, serialized from \e scene, by the changes since the last published octomap, when
+   *  octomap deltas are published. The octree must be locked for reading. */
+  void encodeOctomapDelta(const planning_scene::PlanningScene &scene, moveit_msgs::PlanningScene &msg, bool keyframe);
+
+  /** @brief Decode a received octomap, full or delta, and put it in the scene. The scene must be locked for writing. */
+  bool processOctomapMsg(const moveit_msgs::OctomapWithPose &map);
+
   /** @brief Callback for a new attached object msg*/
   void attachObjectCallback(const moveit_msgs::AttachedCollisionObjectConstPtr &obj);
 
@@ -404,7 +458,9 @@ protected:
   void excludeAttachedBodyFromOctree(const robot_state::AttachedBody *attached_body);
   void includeAttachedBodyInOctree(const robot_state::AttachedBody *attached_body);
 
-  bool getShapeTransformCache(const std::string &target_frame, const ros::Time &target_time, occupancy_map_monitor::ShapeTransformCache &cache) const;
+  bool getShapeTransformArrayFromState(const std::string &target_frame, const ros::Time &target_time, occupancy_map_monitor::ShapeTransformArray &cache) const;
+  bool getShapeTransformArrayFromTF(const std::string &target_frame, const ros::Time &target_time, occupancy_map_monitor::ShapeTransformArray &cache) const;
+  void configureStateHistory();
 
   /// The name of this scene monitor
   std::string                           monitor_name_;
@@ -440,6 +496,12 @@ protected:
   SceneUpdateType                       new_scene_update_;
   boost::condition_variable_any         new_scene_update_condition_;
 
+  /// publishes the monitored octomap as keyframes and deltas, if enabled
+  boost::scoped_ptr<occupancy_map_monitor::OccMapDeltaEncoder> octomap_delta_encoder_;
+
+  /// rebuilds the octomap of received scenes from keyframes and deltas, when there is no octomap monitor
+  occupancy_map_monitor::OccMapDeltaDecoder octomap_delta_decoder_;
+
   // subscribe to various sources of data
   ros::Subscriber                       planning_scene_subscriber_;
   ros::Subscriber                       planning_scene_world_subscriber_;
@@ -472,7 +534,47 @@ protected:
 
 private:
 
-  void getUpdatedFrameTransforms(std::vector<geometry_msgs::TransformStamped> &transforms);
+  /** \brief Compute the transforms from the frames in \e frames to the planning frame. Transforms are looked up in tf only when
+      tf has more recent data than what was previously cached; static transforms (with a zero stamp) are looked up once.
+      Returns true if any of the transforms changed. */
+  bool getUpdatedFrameTransforms(const std::vector<std::string> &frames, std::vector<geometry_msgs::TransformStamped> &transforms);
+
+  // set the transforms in the scene and notify listeners
+  void setFrameTransforms(const std::vector<geometry_msgs::TransformStamped> &transforms);
+
+  struct CachedFrameTransform
+  {
+    CachedFrameTransform() : ignored_(false), valid_(false)
+    {
+    }
+
+    /// true if the frame is the planning frame or a link of the robot
+    bool ignored_;
+
+    /// true once a transform was looked up for the frame
+    bool valid_;
+
+    /// the time stamp the cached transform was computed for
+    ros::Time stamp_;
+
+    geometry_msgs::TransformStamped transform_;
+  };
+
+  /// transforms of frames outside the robot model, keyed by tf frame name without a leading '/'
+  std::map<std::string, CachedFrameTransform> frame_transform_cache_;
+  std::size_t frame_transform_count_;
+  std::size_t frame_transform_lookups_;
+  std::size_t frame_transform_lookups_avoided_;
+  mutable boost::mutex frame_transform_cache_lock_;
+
+  // publish a new snapshot of the scene, reflecting the updates made to it so far
+  void updateSceneSnapshot();
+
+  // same as updateSceneSnapshot(), but the caller holds scene_update_mutex_ (shared or unique)
+  void buildSceneSnapshot();
+
+  // move the diffs of the maintained scene into its parent; the caller holds scene_update_mutex_ for writing
+  void foldSceneDiffs();
 
   // publish planning scene update diffs (runs in its own thread)
   void scenePublishingThread();
@@ -503,6 +605,10 @@ private:
   // arriving so fast that it is preceding the transform state.
   ros::Duration shape_transform_cache_lookup_wait_time_;
 
+  /// the length of the state history kept by the current state monitor for computing the poses of excluded shapes
+  // A zero value disables the history, and every link is then looked up in tf.
+  ros::Duration shape_transform_state_history_;
+
   /// timer for state updates.
   // Check if last_state_update_ is true and if so call updateSceneWithCurrentState()
   // Not safe to access from callback functions.
@@ -517,6 +623,30 @@ private:
 
   collision_detection::CollisionPluginLoader collision_loader_;
 
+  /// true if read-copy-update snapshots of the scene are maintained
+  std::atomic<bool> use_snapshots_;
+
+  /// true while the publishing thread moves the diffs of the maintained scene into its parent
+  // This field is protected by scene_update_mutex_
+  bool publishing_diffs_;
+
+  /// the most recent snapshot; only the pointer is protected by snapshot_lock_, the scene itself is immutable
+  planning_scene::PlanningSceneConstPtr snapshot_;
+  mutable boost::mutex snapshot_lock_;
+
+  /// serializes the construction of snapshots
+  boost::mutex snapshot_update_lock_;
+
+  /// number of diffs chained between the current snapshot and the last one that has no parent
+  unsigned int snapshot_diff_depth_;
+
+  /// once this many diffs are chained, the next snapshot is decoupled from the previous ones
+  unsigned int max_snapshot_diff_depth_;
+
+  /// true if the maintained scene was replaced, so its diffs no longer describe the changes since the last snapshot
+  // This field is set while scene_update_mutex_ is locked for writing and cleared while a snapshot is built
+  bool snapshot_rebuild_;
+
   class DynamicReconfigureImpl;
   DynamicReconfigureImpl *reconfigure_impl_;
 };
@@ -562,17 +692,27 @@ public:
 
   operator bool() const
   {
-    return planning_scene_monitor_ && planning_scene_monitor_->getPlanningScene();
+    return planning_scene_monitor_ && (snapshot_ || planning_scene_monitor_->getPlanningScene());
   }
 
   operator const planning_scene::PlanningSceneConstPtr&() const
   {
-    return const_cast<const PlanningSceneMonitor*>(planning_scene_monitor_.get())->getPlanningScene();
+    return snapshot_ ? snapshot_ : const_cast<const PlanningSceneMonitor*>(planning_scene_monitor_.get())->getPlanningScene();
   }
 
   const planning_scene::PlanningSceneConstPtr& operator->() const
   {
-    return const_cast<const PlanningSceneMonitor*>(planning_scene_monitor_.get())->getPlanningScene();
+    return snapshot_ ? snapshot_ : const_cast<const PlanningSceneMonitor*>(planning_scene_monitor_.get())->getPlanningScene();
+  }
+
+  /** \brief Get the scene to read in place of \e scene while this lock is held. When the lock holds a snapshot, the
+      scene maintained by the monitor is not locked, so if \e scene is that scene, the snapshot is returned instead.
+      Any other scene is returned as is. */
+  const planning_scene::PlanningSceneConstPtr& getSceneForReading(const planning_scene::PlanningSceneConstPtr &scene) const
+  {
+    if (snapshot_ && scene == const_cast<const PlanningSceneMonitor*>(planning_scene_monitor_.get())->getPlanningScene())
+      return snapshot_;
+    return scene;
   }
 
 protected:
@@ -586,33 +726,46 @@ protected:
   void initialize(bool read_only)
   {
     if (planning_scene_monitor_)
-      lock_.reset(new SingleUnlock(planning_scene_monitor_.get(), read_only));
+    {
+      // when snapshots are maintained, readers do not need to lock the scene itself
+      if (read_only && planning_scene_monitor_->sceneSnapshotsEnabled())
+        snapshot_ = planning_scene_monitor_->getPlanningSceneSnapshot();
+      lock_.reset(new SingleUnlock(planning_scene_monitor_.get(), read_only, snapshot_.get() != NULL));
+    }
   }
 
   // we use this struct so that lock/unlock are called only once
   // even if the LockedPlanningScene instance is copied around
   struct SingleUnlock
   {
-    SingleUnlock(PlanningSceneMonitor *planning_scene_monitor, bool read_only) :
-      planning_scene_monitor_(planning_scene_monitor), read_only_(read_only)
+    SingleUnlock(PlanningSceneMonitor *planning_scene_monitor, bool read_only, bool snapshot = false) :
+      planning_scene_monitor_(planning_scene_monitor), read_only_(read_only), snapshot_(snapshot)
     {
-      if (read_only)
-        planning_scene_monitor_->lockSceneRead();
+      if (snapshot)
+        planning_scene_monitor_->lockSnapshotRead();
       else
-        planning_scene_monitor_->lockSceneWrite();
+        if (read_only)
+          planning_scene_monitor_->lockSceneRead();
+        else
+          planning_scene_monitor_->lockSceneWrite();
     }
     ~SingleUnlock()
     {
-      if (read_only_)
-        planning_scene_monitor_->unlockSceneRead();
+      if (snapshot_)
+        planning_scene_monitor_->unlockSnapshotRead();
       else
-        planning_scene_monitor_->unlockSceneWrite();
+        if (read_only_)
+          planning_scene_monitor_->unlockSceneRead();
+        else
+          planning_scene_monitor_->unlockSceneWrite();
     }
     PlanningSceneMonitor *planning_scene_monitor_;
     bool read_only_;
+    bool snapshot_;
   };
 
   PlanningSceneMonitorPtr planning_scene_monitor_;
+  planning_scene::PlanningSceneConstPtr snapshot_;
   boost::shared_ptr<SingleUnlock> lock_;
 };
 
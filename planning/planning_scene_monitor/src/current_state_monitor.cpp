@@ -36,6 +36,7 @@
 
 #include <moveit/planning_scene_monitor/current_state_monitor.h>
 #include <tf_conversions/tf_eigen.h>
+#include <boost/functional/hash.hpp>
 #include <limits>
 
 planning_scene_monitor::CurrentStateMonitor::CurrentStateMonitor(const robot_model::RobotModelConstPtr &robot_model, const boost::shared_ptr<tf::Transformer> &tf )
@@ -54,6 +55,12 @@ planning_scene_monitor::CurrentStateMonitor::CurrentStateMonitor(const robot_mod
   , error_(std::numeric_limits<double>::epsilon())
 {
   robot_state_.setToDefaultValues();
+  const std::vector<std::string> &dof = robot_model_->getVariableNames();
+  joint_time_.resize(dof.size());
+  joint_received_.resize(dof.size(), 0);
+  passive_or_mimic_.resize(dof.size(), 0);
+  for (std::size_t i = 0 ; i < dof.size() ; ++i)
+    passive_or_mimic_[i] = isPassiveOrMimicDOF(dof[i]) ? 1 : 0;
 }
 
 planning_scene_monitor::CurrentStateMonitor::~CurrentStateMonitor()
@@ -114,7 +121,12 @@ void planning_scene_monitor::CurrentStateMonitor::startStateMonitor(const std::s
 {
   if (!state_monitor_started_ && robot_model_)
   {
-    joint_time_.clear();
+    {
+      boost::mutex::scoped_lock slock(state_update_lock_);
+      std::fill(joint_time_.begin(), joint_time_.end(), ros::Time());
+      std::fill(joint_received_.begin(), joint_received_.end(), 0);
+      state_history_.clear();
+    }
     if (joint_states_topic.empty())
       ROS_ERROR("The joint states topic cannot be an empty string");
     else
@@ -175,16 +187,12 @@ bool planning_scene_monitor::CurrentStateMonitor::isPassiveOrMimicDOF(const std:
 bool planning_scene_monitor::CurrentStateMonitor::haveCompleteState() const
 {
   bool result = true;
-  const std::vector<std::string> &dof = robot_model_->getVariableNames();
   boost::mutex::scoped_lock slock(state_update_lock_);
-  for (std::size_t i = 0 ; i < dof.size() ; ++i)
-    if (joint_time_.find(dof[i]) == joint_time_.end())
+  for (std::size_t i = 0 ; i < joint_received_.size() ; ++i)
+    if (!joint_received_[i] && !passive_or_mimic_[i])
     {
-      if (!isPassiveOrMimicDOF(dof[i]))
-      {
-        ROS_DEBUG("Joint variable '%s' has never been updated", dof[i].c_str());
-        result = false;
-      }
+      ROS_DEBUG("Joint variable '%s' has never been updated", robot_model_->getVariableNames()[i].c_str());
+      result = false;
     }
   return result;
 }
@@ -192,40 +200,36 @@ bool planning_scene_monitor::CurrentStateMonitor::haveCompleteState() const
 bool planning_scene_monitor::CurrentStateMonitor::haveCompleteState(std::vector<std::string> &missing_states) const
 {
   bool result = true;
-  const std::vector<std::string> &dof = robot_model_->getVariableNames();
   boost::mutex::scoped_lock slock(state_update_lock_);
-  for (std::size_t i = 0 ; i < dof.size() ; ++i)
-    if (joint_time_.find(dof[i]) == joint_time_.end())
-      if (!isPassiveOrMimicDOF(dof[i]))
-      {
-        missing_states.push_back(dof[i]);
-        result = false;
-      }
+  for (std::size_t i = 0 ; i < joint_received_.size() ; ++i)
+    if (!joint_received_[i] && !passive_or_mimic_[i])
+    {
+      missing_states.push_back(robot_model_->getVariableNames()[i]);
+      result = false;
+    }
   return result;
 }
 
 bool planning_scene_monitor::CurrentStateMonitor::haveCompleteState(const ros::Duration &age) const
 {
   bool result = true;
-  const std::vector<std::string> &dof = robot_model_->getVariableNames();
   ros::Time now = ros::Time::now();
   ros::Time old = now - age;
   boost::mutex::scoped_lock slock(state_update_lock_);
-  for (std::size_t i = 0 ; i < dof.size() ; ++i)
+  for (std::size_t i = 0 ; i < joint_received_.size() ; ++i)
   {
-    if (isPassiveOrMimicDOF(dof[i]))
+    if (passive_or_mimic_[i])
       continue;
-    std::map<std::string, ros::Time>::const_iterator it = joint_time_.find(dof[i]);
-    if (it == joint_time_.end())
+    if (!joint_received_[i])
     {
-      ROS_DEBUG("Joint variable '%s' has never been updated", dof[i].c_str());
+      ROS_DEBUG("Joint variable '%s' has never been updated", robot_model_->getVariableNames()[i].c_str());
       result = false;
     }
     else
-      if (it->second < old)
+      if (joint_time_[i] < old)
       {
         ROS_DEBUG("Joint variable '%s' was last updated %0.3lf seconds ago (older than the allowed %0.3lf seconds)",
-                  dof[i].c_str(), (now - it->second).toSec(), age.toSec());
+                  robot_model_->getVariableNames()[i].c_str(), (now - joint_time_[i]).toSec(), age.toSec());
         result = false;
       }
   }
@@ -236,27 +240,25 @@ bool planning_scene_monitor::CurrentStateMonitor::haveCompleteState(const ros::D
                                                                     std::vector<std::string> &missing_states) const
 {
   bool result = true;
-  const std::vector<std::string> &dof = robot_model_->getVariableNames();
   ros::Time now = ros::Time::now();
   ros::Time old = now - age;
   boost::mutex::scoped_lock slock(state_update_lock_);
-  for (std::size_t i = 0 ; i < dof.size() ; ++i)
+  for (std::size_t i = 0 ; i < joint_received_.size() ; ++i)
   {
-    if (isPassiveOrMimicDOF(dof[i]))
+    if (passive_or_mimic_[i])
       continue;
-    std::map<std::string, ros::Time>::const_iterator it = joint_time_.find(dof[i]);
-    if (it == joint_time_.end())
+    if (!joint_received_[i])
     {
-      ROS_DEBUG("Joint variable '%s' has never been updated", dof[i].c_str());
-      missing_states.push_back(dof[i]);
+      ROS_DEBUG("Joint variable '%s' has never been updated", robot_model_->getVariableNames()[i].c_str());
+      missing_states.push_back(robot_model_->getVariableNames()[i]);
       result = false;
     }
     else
-      if (it->second < old)
+      if (joint_time_[i] < old)
       {
         ROS_DEBUG("Joint variable '%s' was last updated %0.3lf seconds ago (older than the allowed %0.3lf seconds)",
-                  dof[i].c_str(), (now - it->second).toSec(), age.toSec());
-        missing_states.push_back(dof[i]);
+                  robot_model_->getVariableNames()[i].c_str(), (now - joint_time_[i]).toSec(), age.toSec());
+        missing_states.push_back(robot_model_->getVariableNames()[i]);
         result = false;
       }
   }
@@ -303,6 +305,117 @@ bool planning_scene_monitor::CurrentStateMonitor::waitForCurrentState(const std:
   return ok;
 }
 
+void planning_scene_monitor::CurrentStateMonitor::setStateHistoryLength(const ros::Duration &length)
+{
+  boost::mutex::scoped_lock slock(state_update_lock_);
+  state_history_length_ = length;
+  if (state_history_length_.isZero())
+    state_history_.clear();
+}
+
+ros::Duration planning_scene_monitor::CurrentStateMonitor::getStateHistoryLength() const
+{
+  boost::mutex::scoped_lock slock(state_update_lock_);
+  return state_history_length_;
+}
+
+bool planning_scene_monitor::CurrentStateMonitor::getStateAtTime(const ros::Time &time, robot_state::RobotState &state,
+                                                                 const ros::Duration &timeout) const
+{
+  boost::mutex::scoped_lock slock(state_update_lock_);
+  if (!time.isZero() && timeout > ros::Duration(0))
+  {
+    // the joint state for this time may still be on its way
+    const boost::system_time deadline = boost::get_system_time() + boost::posix_time::microseconds(timeout.toNSec() / 1000);
+    while (!state_history_length_.isZero() && (state_history_.empty() || state_history_.back().stamp_ < time))
+      if (!state_update_condition_.timed_wait(slock, deadline))
+        break;
+  }
+  if (state_history_.empty())
+    return false;
+  if (time.isZero() || time >= state_history_.back().stamp_)
+  {
+    state.setVariablePositions(state_history_.back().positions_);
+    return true;
+  }
+  if (time < state_history_.front().stamp_)
+    return false;
+
+  // queries are usually for recent times, so search from the back
+  std::size_t to = state_history_.size() - 1;
+  while (state_history_[to - 1].stamp_ > time)
+    --to;
+  const StateHistorySample &a = state_history_[to - 1];
+  const StateHistorySample &b = state_history_[to];
+  double t = (time - a.stamp_).toSec() / (b.stamp_ - a.stamp_).toSec();
+
+  std::vector<double> positions(a.positions_.size());
+  const std::vector<const robot_model::JointModel*> &joints = robot_model_->getJointModels();
+  for (std::size_t i = 0 ; i < joints.size() ; ++i)
+    if (joints[i]->getVariableCount() > 0)
+    {
+      int index = joints[i]->getFirstVariableIndex();
+      joints[i]->interpolate(&a.positions_[index], &b.positions_[index], t, &positions[index]);
+    }
+  state.setVariablePositions(positions);
+  return true;
+}
+
+void planning_scene_monitor::CurrentStateMonitor::recordStateHistory(const ros::Time &stamp)
+{
+  if (state_history_length_.isZero() || stamp.isZero())
+    return;
+  const double *pos = robot_state_.getVariablePositions();
+  std::size_t n = robot_model_->getVariableCount();
+
+  // messages from different publishers may carry equal or slightly out of order stamps; fold them into the last sample
+  if (!state_history_.empty() && stamp <= state_history_.back().stamp_)
+  {
+    std::copy(pos, pos + n, state_history_.back().positions_.begin());
+    return;
+  }
+
+  // drop samples that are no longer needed to cover the history length, and reuse their storage
+  std::vector<double> positions;
+  while (state_history_.size() > 1 && state_history_[1].stamp_ + state_history_length_ < stamp)
+  {
+    positions.swap(state_history_.front().positions_);
+    state_history_.pop_front();
+  }
+  positions.assign(pos, pos + n);
+  state_history_.push_back(StateHistorySample());
+  state_history_.back().stamp_ = stamp;
+  state_history_.back().positions_.swap(positions);
+}
+
+const planning_scene_monitor::CurrentStateMonitor::JointStateLayout&
+planning_scene_monitor::CurrentStateMonitor::getJointStateLayout(const std::vector<std::string> &names)
+{
+  std::size_t key = boost::hash_range(names.begin(), names.end());
+  std::map<std::size_t, JointStateLayout>::iterator it = joint_state_layouts_.find(key);
+  if (it != joint_state_layouts_.end() && it->second.names_ == names)
+    return it->second;
+
+  // only a handful of publishers are expected; do not let the cache grow if the names keep changing
+  if (joint_state_layouts_.size() >= 16)
+    joint_state_layouts_.clear();
+
+  JointStateLayout &layout = joint_state_layouts_[key];
+  layout.names_ = names;
+  layout.joints_.resize(names.size());
+  layout.variable_index_.resize(names.size());
+  for (std::size_t i = 0 ; i < names.size() ; ++i)
+  {
+    const robot_model::JointModel* jm = robot_model_->hasJointModel(names[i]) ? robot_model_->getJointModel(names[i]) : NULL;
+    // ignore fixed joints, multi-dof joints (they should not even be in the message)
+    if (jm && jm->getVariableCount() != 1)
+      jm = NULL;
+    layout.joints_[i] = jm;
+    layout.variable_index_[i] = jm ? jm->getFirstVariableIndex() : -1;
+  }
+  return layout;
+}
+
 void planning_scene_monitor::CurrentStateMonitor::jointStateCallback(const sensor_msgs::JointStateConstPtr &joint_state)
 {
   if (joint_state->name.size() != joint_state->position.size())
@@ -317,18 +430,18 @@ void planning_scene_monitor::CurrentStateMonitor::jointStateCallback(const senso
     // read the received values, and update their time stamps
     std::size_t n = joint_state->name.size();
     current_state_time_ = joint_state->header.stamp;
+    const JointStateLayout &layout = getJointStateLayout(joint_state->name);
     for (std::size_t i = 0 ; i < n ; ++i)
     {
-      const robot_model::JointModel* jm = robot_model_->getJointModel(joint_state->name[i]);
+      const robot_model::JointModel* jm = layout.joints_[i];
       if (!jm)
         continue;
-      // ignore fixed joints, multi-dof joints (they should not even be in the message)
-      if (jm->getVariableCount() != 1)
-        continue;
+      const int index = layout.variable_index_[i];
 
-      joint_time_[joint_state->name[i]] = joint_state->header.stamp;
+      joint_time_[index] = joint_state->header.stamp;
+      joint_received_[index] = 1;
 
-      if (robot_state_.getJointPositions(jm)[0] != joint_state->position[i])
+      if (robot_state_.getVariablePosition(index) != joint_state->position[i])
       {
         update = true;
         robot_state_.setJointPositions(jm, &(joint_state->position[i]));
@@ -394,15 +507,21 @@ void planning_scene_monitor::CurrentStateMonitor::jointStateCallback(const senso
       {
         update = true;
         last_tf_update_ = tm;
-        const std::vector<std::string> &vars = robot_model_->getRootJoint()->getVariableNames();
-        for (std::size_t j = 0; j < vars.size() ; ++j)
-          joint_time_[vars[j]] = tm;
+        const robot_model::JointModel *root = robot_model_->getRootJoint();
+        for (std::size_t j = 0; j < root->getVariableCount() ; ++j)
+        {
+          joint_time_[root->getFirstVariableIndex() + j] = tm;
+          joint_received_[root->getFirstVariableIndex() + j] = 1;
+        }
         Eigen::Affine3d eigen_transf;
         tf::transformTFToEigen(transf, eigen_transf);
         robot_state_.setJointPositions(robot_model_->getRootJoint(), eigen_transf);
       }
     }
+
+    recordStateHistory(joint_state->header.stamp);
   }
+  state_update_condition_.notify_all();
 
   // callbacks, if needed
   if (update)
@@ -151,6 +151,7 @@ planning_scene_monitor::PlanningSceneMonitor::~PlanningSceneMonitor()
   stopSceneMonitor();
   delete reconfigure_impl_;
   current_state_monitor_.reset();
+  snapshot_.reset();
   scene_const_.reset();
   scene_.reset();
   parent_scene_.reset();
@@ -224,6 +225,32 @@ void planning_scene_monitor::PlanningSceneMonitor::initialize(const planning_sce
       0.05);
   shape_transform_cache_lookup_wait_time_ = ros::Duration(temp_wait_time);
 
+  double state_history;
+  nh_.param(robot_description_ + "_planning/shape_transform_cache_state_history", state_history, 1.0);
+  shape_transform_state_history_ = ros::Duration(std::max(0.0, state_history));
+
+  frame_transform_count_ = 0;
+  frame_transform_lookups_ = 0;
+  frame_transform_lookups_avoided_ = 0;
+
+  use_snapshots_ = false;
+  publishing_diffs_ = false;
+  snapshot_diff_depth_ = 0;
+  snapshot_rebuild_ = false;
+  int max_diff_depth;
+  nh_.param(robot_description_ + "_planning/scene_snapshot_max_diff_depth", max_diff_depth, 8);
+  max_snapshot_diff_depth_ = max_diff_depth > 0 ? max_diff_depth : 0;
+  bool use_snapshots;
+  nh_.param(robot_description_ + "_planning/use_scene_snapshots", use_snapshots, false);
+  if (use_snapshots)
+    enableSceneSnapshots(true);
+
+  // receivers of the published scenes that are planning scene monitors themselves can decode octomap deltas
+  int octomap_keyframe_interval;
+  nh_.param(robot_description_ + "_planning/octomap_delta_keyframe_interval", octomap_keyframe_interval, 0);
+  if (octomap_keyframe_interval > 0)
+    octomap_delta_encoder_.reset(new occupancy_map_monitor::OccMapDeltaEncoder(octomap_keyframe_interval));
+
   state_update_pending_ = false;
   state_update_timer_ = nh_.createWallTimer(dt_state_update_,
                                             &PlanningSceneMonitor::stateUpdateTimerCallback,
@@ -249,6 +276,7 @@ void planning_scene_monitor::PlanningSceneMonitor::monitorDiffs(bool flag)
         parent_scene_ = scene_;
         scene_ = parent_scene_->diff();
         scene_const_ = scene_;
+        snapshot_rebuild_ = true;
         scene_->setAttachedBodyUpdateCallback(boost::bind(&PlanningSceneMonitor::currentStateAttachedBodyUpdateCallback, this, _1, _2));
         scene_->setCollisionObjectUpdateCallback(boost::bind(&PlanningSceneMonitor::currentWorldObjectUpdateCallback, this, _1, _2));
       }
@@ -266,6 +294,7 @@ void planning_scene_monitor::PlanningSceneMonitor::monitorDiffs(bool flag)
         {
           scene_->decoupleParent();
           parent_scene_.reset();
+          snapshot_rebuild_ = true;
           // remove the '+' added by .diff() at the end of the scene name
           if (!scene_->getName().empty())
           {
@@ -286,7 +315,13 @@ void planning_scene_monitor::PlanningSceneMonitor::stopPublishingPlanningScene()
     copy.swap(publish_planning_scene_);
     new_scene_update_condition_.notify_all();
     copy->join();
-    monitorDiffs(false);
+    {
+      boost::unique_lock<boost::shared_mutex> ulock(scene_update_mutex_);
+      publishing_diffs_ = false;
+    }
+    // snapshots are built from the diffs, so they are still needed
+    if (!use_snapshots_)
+      monitorDiffs(false);
     planning_scene_publisher_.shutdown();
     ROS_INFO("Stopped publishing maintained planning scene.");
   }
@@ -300,6 +335,10 @@ void planning_scene_monitor::PlanningSceneMonitor::startPublishingPlanningScene(
     planning_scene_publisher_ = nh_.advertise<moveit_msgs::PlanningScene>(planning_scene_topic, 100, false);
     ROS_INFO("Publishing maintained planning scene on '%s'", planning_scene_topic.c_str());
     monitorDiffs(true);
+    {
+      boost::unique_lock<boost::shared_mutex> ulock(scene_update_mutex_);
+      publishing_diffs_ = true;
+    }
     publish_planning_scene_.reset(new boost::thread(boost::bind(&PlanningSceneMonitor::scenePublishingThread, this)));
   }
 }
@@ -314,6 +353,7 @@ void planning_scene_monitor::PlanningSceneMonitor::scenePublishingThread()
     occupancy_map_monitor::OccMapTree::ReadLock lock;
     if (octomap_monitor_) lock = octomap_monitor_->getOcTreePtr()->reading();
     scene_->getPlanningSceneMsg(msg);
+    encodeOctomapDelta(*scene_, msg, true);
   }
   planning_scene_publisher_.publish(msg);
   ROS_DEBUG("Published the full planning scene: '%s'", msg.name.c_str());
@@ -322,6 +362,9 @@ void planning_scene_monitor::PlanningSceneMonitor::scenePublishingThread()
   {
     bool publish_msg = false;
     bool is_full = false;
+    planning_scene::PlanningScenePtr diff_scene;
+    planning_scene::PlanningScenePtr full_scene;
+    std::string full_scene_name;
     ros::Rate rate(publish_planning_scene_frequency_);
     {
       boost::unique_lock<boost::shared_mutex> ulock(scene_update_mutex_);
@@ -334,35 +377,45 @@ void planning_scene_monitor::PlanningSceneMonitor::scenePublishingThread()
         {
           if (new_scene_update_ == UPDATE_SCENE)
             is_full = true;
-          else
-          {
-            occupancy_map_monitor::OccMapTree::ReadLock lock;
-            if (octomap_monitor_) lock = octomap_monitor_->getOcTreePtr()->reading();
-            scene_->getPlanningSceneDiffMsg(msg);
-          }
-          boost::recursive_mutex::scoped_lock prevent_shape_cache_updates(shape_handles_lock_); // we don't want the transform cache to update while we are potentially changing attached bodies
-          scene_->setAttachedBodyUpdateCallback(robot_state::AttachedBodyCallback());
-          scene_->setCollisionObjectUpdateCallback(collision_detection::World::ObserverCallbackFn());
-          scene_->pushDiffs(parent_scene_);
-          scene_->clearDiffs();
-          scene_->setAttachedBodyUpdateCallback(boost::bind(&PlanningSceneMonitor::currentStateAttachedBodyUpdateCallback, this, _1, _2));
-          scene_->setCollisionObjectUpdateCallback(boost::bind(&PlanningSceneMonitor::currentWorldObjectUpdateCallback, this, _1, _2));
-          if (octomap_monitor_)
+          if (is_full)
           {
-            excludeAttachedBodiesFromOctree(); // in case updates have happened to the attached bodies, put them in
-            excludeWorldObjectsFromOctree(); // in case updates have happened to the attached bodies, put them in
+            // the parent is only modified by this thread, so it can be serialized after the scene lock is released
+            full_scene = parent_scene_;
+            full_scene_name = scene_->getName();
           }
-          if (is_full)
+          else
           {
-            occupancy_map_monitor::OccMapTree::ReadLock lock;
-            if (octomap_monitor_) lock = octomap_monitor_->getOcTreePtr()->reading();
-            scene_->getPlanningSceneMsg(msg);
+            // Copy the changes since the last publish into a scratch diff of the parent, so the diff message can be
+            // serialized after the scene lock is released. The maintained scene stays the same object, as users of
+            // getPlanningScene() keep referring to it; world objects are copy-on-write, so the copy is cheap.
+            diff_scene = parent_scene_->diff();
+            scene_->pushDiffs(diff_scene);
           }
+          // snapshots are built from the diffs of the scene, so bring the snapshot up to date before they are cleared
+          if (use_snapshots_)
+            buildSceneSnapshot();
+          foldSceneDiffs();
           publish_msg = true;
         }
         new_scene_update_ = UPDATE_NONE;
       }
     }
+    if (diff_scene || full_scene)
+    {
+      occupancy_map_monitor::OccMapTree::ReadLock lock;
+      if (octomap_monitor_) lock = octomap_monitor_->getOcTreePtr()->reading();
+      if (full_scene)
+      {
+        full_scene->getPlanningSceneMsg(msg);
+        msg.name = full_scene_name;
+        encodeOctomapDelta(*full_scene, msg, true);
+      }
+      else
+      {
+        diff_scene->getPlanningSceneDiffMsg(msg);
+        encodeOctomapDelta(*diff_scene, msg, false);
+      }
+    }
     if (publish_msg)
     {
       rate.reset();
@@ -416,6 +469,10 @@ bool planning_scene_monitor::PlanningSceneMonitor::updatesScene(const planning_s
 
 void planning_scene_monitor::PlanningSceneMonitor::triggerSceneUpdateEvent(SceneUpdateType update_type)
 {
+  // make the update visible to snapshot readers before anyone is notified
+  if (use_snapshots_)
+    updateSceneSnapshot();
+
   // do not modify update functions while we are calling them
   boost::recursive_mutex::scoped_lock lock(update_lock_);
 
@@ -473,6 +530,7 @@ void planning_scene_monitor::PlanningSceneMonitor::clearOctomap()
 {
   octomap_monitor_->getOcTreePtr()->lockWrite();
   octomap_monitor_->getOcTreePtr()->clear();
+  octomap_monitor_->getOcTreePtr()->markAllChanged();
   octomap_monitor_->getOcTreePtr()->unlockWrite();
 }
 
@@ -492,13 +550,25 @@ bool planning_scene_monitor::PlanningSceneMonitor::newPlanningSceneMessage(const
 
     last_update_time_ = ros::Time::now();
     old_scene_name = scene_->getName();
-    result = scene_->usePlanningSceneMsg(scene);
+    const octomap_msgs::Octomap &octomap = scene.world.octomap.octomap;
+    if (!octomap_monitor_ && !octomap.data.empty() &&
+        (occupancy_map_monitor::OccMapDeltaDecoder::isDelta(octomap) || octomap.id == "OcTree"))
+    {
+      // the octomap is decoded here rather than by the scene, so the deltas that follow it can be applied to it
+      moveit_msgs::PlanningScene scene_without_octomap(scene);
+      scene_without_octomap.world.octomap = moveit_msgs::OctomapWithPose();
+      result = scene_->usePlanningSceneMsg(scene_without_octomap);
+      processOctomapMsg(scene.world.octomap);
+    }
+    else
+      result = scene_->usePlanningSceneMsg(scene);
     if (octomap_monitor_)
     {
       if (!scene.is_diff && scene.world.octomap.octomap.data.empty())
       {
         octomap_monitor_->getOcTreePtr()->lockWrite();
         octomap_monitor_->getOcTreePtr()->clear();
+        octomap_monitor_->getOcTreePtr()->markAllChanged();
         octomap_monitor_->getOcTreePtr()->unlockWrite();
       }
     }
@@ -513,6 +583,7 @@ bool planning_scene_monitor::PlanningSceneMonitor::newPlanningSceneMessage(const
       parent_scene_ = scene_;
       scene_ = parent_scene_->diff();
       scene_const_ = scene_;
+      snapshot_rebuild_ = true;
       scene_->setAttachedBodyUpdateCallback(boost::bind(&PlanningSceneMonitor::currentStateAttachedBodyUpdateCallback, this, _1, _2));
       scene_->setCollisionObjectUpdateCallback(boost::bind(&PlanningSceneMonitor::currentWorldObjectUpdateCallback, this, _1, _2));
     }
@@ -523,6 +594,14 @@ bool planning_scene_monitor::PlanningSceneMonitor::newPlanningSceneMessage(const
     }
   }
 
+  // the message may have replaced the transforms computed from tf; make sure they are recomputed on the next update
+  if (!scene.is_diff || !scene.fixed_frame_transforms.empty())
+  {
+    boost::mutex::scoped_lock slock(frame_transform_cache_lock_);
+    frame_transform_cache_.clear();
+    frame_transform_count_ = 0;
+  }
+
   // if we have a diff, try to more accuratelly determine the update type
   if (scene.is_diff)
   {
@@ -565,6 +644,7 @@ void planning_scene_monitor::PlanningSceneMonitor::newPlanningSceneWorldCallback
         {
           octomap_monitor_->getOcTreePtr()->lockWrite();
           octomap_monitor_->getOcTreePtr()->clear();
+          octomap_monitor_->getOcTreePtr()->markAllChanged();
           octomap_monitor_->getOcTreePtr()->unlockWrite();
         }
       }
@@ -815,6 +895,128 @@ void planning_scene_monitor::PlanningSceneMonitor::currentWorldObjectUpdateCallb
     }
 }
 
+void planning_scene_monitor::PlanningSceneMonitor::enableSceneSnapshots(bool flag)
+{
+  if (flag == use_snapshots_)
+    return;
+  if (flag)
+  {
+    // snapshots are built from the changes recorded by the diff of the maintained scene
+    if (!parent_scene_)
+      monitorDiffs(true);
+    use_snapshots_ = true;
+    updateSceneSnapshot();
+    ROS_DEBUG("Maintaining snapshots of the planning scene");
+  }
+  else
+  {
+    use_snapshots_ = false;
+    // the diffs were only monitored for the snapshots if no planning scene is published
+    if (!publish_planning_scene_)
+      monitorDiffs(false);
+    boost::mutex::scoped_lock slock(snapshot_lock_);
+    snapshot_.reset();
+  }
+}
+
+planning_scene::PlanningSceneConstPtr planning_scene_monitor::PlanningSceneMonitor::getPlanningSceneSnapshot() const
+{
+  boost::mutex::scoped_lock slock(snapshot_lock_);
+  return snapshot_;
+}
+
+void planning_scene_monitor::PlanningSceneMonitor::updateSceneSnapshot()
+{
+  if (!scene_)
+    return;
+
+  // writers are excluded while the changes of the scene are copied
+  {
+    boost::shared_lock<boost::shared_mutex> slock(scene_update_mutex_);
+    if (publishing_diffs_ || !parent_scene_)
+    {
+      buildSceneSnapshot();
+      return;
+    }
+  }
+
+  // Nothing publishes the diffs and moves them into the parent scene, so that is done here once the snapshot reflects
+  // them; otherwise every snapshot would copy all the changes made since the diffs were first monitored.
+  boost::unique_lock<boost::shared_mutex> ulock(scene_update_mutex_);
+  buildSceneSnapshot();
+  if (!publishing_diffs_ && parent_scene_)
+    foldSceneDiffs();
+}
+
+void planning_scene_monitor::PlanningSceneMonitor::foldSceneDiffs()
+{
+  // we don't want the transform cache to update while we are potentially changing attached bodies
+  boost::recursive_mutex::scoped_lock prevent_shape_cache_updates(shape_handles_lock_);
+  scene_->setAttachedBodyUpdateCallback(robot_state::AttachedBodyCallback());
+  scene_->setCollisionObjectUpdateCallback(collision_detection::World::ObserverCallbackFn());
+  scene_->pushDiffs(parent_scene_);
+  scene_->clearDiffs();
+  scene_->setAttachedBodyUpdateCallback(boost::bind(&PlanningSceneMonitor::currentStateAttachedBodyUpdateCallback, this, _1, _2));
+  scene_->setCollisionObjectUpdateCallback(boost::bind(&PlanningSceneMonitor::currentWorldObjectUpdateCallback, this, _1, _2));
+  if (octomap_monitor_)
+  {
+    excludeAttachedBodiesFromOctree(); // in case updates have happened to the attached bodies, put them in
+    excludeWorldObjectsFromOctree(); // in case updates have happened to the attached bodies, put them in
+  }
+}
+
+void planning_scene_monitor::PlanningSceneMonitor::buildSceneSnapshot()
+{
+  // only one snapshot is built at a time, so diffs are always taken from the latest snapshot
+  boost::mutex::scoped_lock ulock(snapshot_update_lock_);
+  if (!use_snapshots_)
+    return;
+
+  occupancy_map_monitor::OccMapTree::ReadLock lock;
+  if (octomap_monitor_) lock = octomap_monitor_->getOcTreePtr()->reading();
+
+  planning_scene::PlanningSceneConstPtr previous = getPlanningSceneSnapshot();
+  planning_scene::PlanningScenePtr next;
+
+  if (previous && parent_scene_ && !snapshot_rebuild_)
+  {
+    // The diffs of the scene hold every change since they were last pushed to its parent, which the previous
+    // snapshot already reflects; pushing them again onto a diff of the previous snapshot is therefore enough.
+    // Only the changed world objects are copied, and they share their shapes with the maintained scene.
+    next = previous->diff();
+    scene_->pushDiffs(next);
+    if (++snapshot_diff_depth_ > max_snapshot_diff_depth_)
+    {
+      // do not keep the chain of previous snapshots alive; a diff already owns its world, so this is cheap
+      next->decoupleParent();
+      snapshot_diff_depth_ = 0;
+    }
+  }
+  else
+  {
+    // there is no record of the changes since the previous snapshot, so the scene is copied
+    next = planning_scene::PlanningScene::clone(scene_);
+    snapshot_diff_depth_ = 0;
+    snapshot_rebuild_ = false;
+  }
+  next->setName(scene_->getName());
+
+  boost::mutex::scoped_lock slock(snapshot_lock_);
+  snapshot_ = next;
+}
+
+void planning_scene_monitor::PlanningSceneMonitor::lockSnapshotRead()
+{
+  if (octomap_monitor_)
+    octomap_monitor_->getOcTreePtr()->lockRead();
+}
+
+void planning_scene_monitor::PlanningSceneMonitor::unlockSnapshotRead()
+{
+  if (octomap_monitor_)
+    octomap_monitor_->getOcTreePtr()->unlockRead();
+}
+
 void planning_scene_monitor::PlanningSceneMonitor::lockSceneRead()
 {
   scene_update_mutex_.lock_shared();
@@ -841,6 +1043,10 @@ void planning_scene_monitor::PlanningSceneMonitor::unlockSceneWrite()
   scene_update_mutex_.unlock();
   if (octomap_monitor_)
     octomap_monitor_->getOcTreePtr()->unlockWrite();
+
+  // the scene may have been modified in any way by the user that held the lock
+  if (use_snapshots_)
+    updateSceneSnapshot();
 }
 
 void planning_scene_monitor::PlanningSceneMonitor::startSceneMonitor(const std::string &scene_topic)
@@ -867,9 +1073,72 @@ void planning_scene_monitor::PlanningSceneMonitor::stopSceneMonitor()
 
 bool planning_scene_monitor::PlanningSceneMonitor::getShapeTransformCache(const std::string &target_frame, const ros::Time &target_time,
                                                                           occupancy_map_monitor::ShapeTransformCache &cache) const
+{
+  occupancy_map_monitor::ShapeTransformArray transforms;
+  if (!getShapeTransformArray(target_frame, target_time, transforms))
+    return false;
+  transforms.copyTo(cache);
+  return true;
+}
+
+bool planning_scene_monitor::PlanningSceneMonitor::getShapeTransformArray(const std::string &target_frame, const ros::Time &target_time,
+                                                                          occupancy_map_monitor::ShapeTransformArray &cache) const
 {
   if (!tf_)
     return false;
+  if (current_state_monitor_ && getShapeTransformArrayFromState(target_frame, target_time, cache))
+    return true;
+  return getShapeTransformArrayFromTF(target_frame, target_time, cache);
+}
+
+bool planning_scene_monitor::PlanningSceneMonitor::getShapeTransformArrayFromState(const std::string &target_frame, const ros::Time &target_time,
+                                                                                   occupancy_map_monitor::ShapeTransformArray &cache) const
+{
+  robot_state::RobotState state(getRobotModel());
+  if (!current_state_monitor_->getStateAtTime(target_time, state, shape_transform_cache_lookup_wait_time_))
+    return false;
+  state.updateLinkTransforms();
+
+  // the pose of the robot is the only transform we need from tf; the link poses follow from forward kinematics
+  const robot_model::LinkModel *root = getRobotModel()->getRootLink();
+  Eigen::Affine3d model_transform;
+  try
+  {
+    tf::StampedTransform tr;
+    tf_->waitForTransform(target_frame, root->getName(), target_time, shape_transform_cache_lookup_wait_time_);
+    tf_->lookupTransform(target_frame, root->getName(), target_time, tr);
+    tf::transformTFToEigen(tr, model_transform);
+  }
+  catch (tf::TransformException& ex)
+  {
+    ROS_ERROR_THROTTLE(1, "Transform error: %s", ex.what());
+    return false;
+  }
+  // from the model frame (which is also the planning frame) to the target frame
+  model_transform = model_transform * state.getGlobalLinkTransform(root).inverse();
+
+  boost::recursive_mutex::scoped_lock _(shape_handles_lock_);
+  for (LinkShapeHandles::const_iterator it = link_shape_handles_.begin() ; it != link_shape_handles_.end() ; ++it)
+  {
+    Eigen::Affine3d ttr = model_transform * state.getGlobalLinkTransform(it->first);
+    for (std::size_t j = 0 ; j < it->second.size() ; ++j)
+      cache.set(it->second[j].first, ttr * it->first->getCollisionOriginTransforms()[it->second[j].second]);
+  }
+  for (AttachedBodyShapeHandles::const_iterator it = attached_body_shape_handles_.begin() ; it != attached_body_shape_handles_.end() ; ++it)
+  {
+    Eigen::Affine3d transform = model_transform * state.getGlobalLinkTransform(it->first->getAttachedLink());
+    for (std::size_t k = 0 ; k < it->second.size() ; ++k)
+      cache.set(it->second[k].first, transform * it->first->getFixedTransforms()[it->second[k].second]);
+  }
+  for (CollisionBodyShapeHandles::const_iterator it = collision_body_shape_handles_.begin() ; it != collision_body_shape_handles_.end() ; ++it)
+    for (std::size_t k = 0 ; k < it->second.size() ; ++k)
+      cache.set(it->second[k].first, model_transform * (*it->second[k].second));
+  return true;
+}
+
+bool planning_scene_monitor::PlanningSceneMonitor::getShapeTransformArrayFromTF(const std::string &target_frame, const ros::Time &target_time,
+                                                                                occupancy_map_monitor::ShapeTransformArray &cache) const
+{
   try
   {
     boost::recursive_mutex::scoped_lock _(shape_handles_lock_);
@@ -882,7 +1151,7 @@ bool planning_scene_monitor::PlanningSceneMonitor::getShapeTransformCache(const
       Eigen::Affine3d ttr;
       tf::transformTFToEigen(tr, ttr);
       for (std::size_t j = 0 ; j < it->second.size() ; ++j)
-        cache[it->second[j].first] = ttr * it->first->getCollisionOriginTransforms()[it->second[j].second];
+        cache.set(it->second[j].first, ttr * it->first->getCollisionOriginTransforms()[it->second[j].second]);
     }
     for (AttachedBodyShapeHandles::const_iterator it = attached_body_shape_handles_.begin() ; it != attached_body_shape_handles_.end() ; ++it)
     {
@@ -892,7 +1161,7 @@ bool planning_scene_monitor::PlanningSceneMonitor::getShapeTransformCache(const
       Eigen::Affine3d transform;
       tf::transformTFToEigen(tr, transform);
       for (std::size_t k = 0 ; k < it->second.size() ; ++k)
-        cache[it->second[k].first] = transform * it->first->getFixedTransforms()[it->second[k].second];
+        cache.set(it->second[k].first, transform * it->first->getFixedTransforms()[it->second[k].second]);
     }
     {
       tf::StampedTransform tr;
@@ -902,7 +1171,7 @@ bool planning_scene_monitor::PlanningSceneMonitor::getShapeTransformCache(const
       tf::transformTFToEigen(tr, transform);
       for (CollisionBodyShapeHandles::const_iterator it = collision_body_shape_handles_.begin() ; it != collision_body_shape_handles_.end() ; ++it)
         for (std::size_t k = 0 ; k < it->second.size() ; ++k)
-          cache[it->second[k].first] = transform * (*it->second[k].second);
+          cache.set(it->second[k].first, transform * (*it->second[k].second));
     }
   }
   catch (tf::TransformException& ex)
@@ -913,6 +1182,14 @@ bool planning_scene_monitor::PlanningSceneMonitor::getShapeTransformCache(const
   return true;
 }
 
+void planning_scene_monitor::PlanningSceneMonitor::configureStateHistory()
+{
+  // the poses of the shapes excluded from the octomap are computed from past states of the robot
+  if (octomap_monitor_ && current_state_monitor_ &&
+      current_state_monitor_->getStateHistoryLength() < shape_transform_state_history_)
+    current_state_monitor_->setStateHistoryLength(shape_transform_state_history_);
+}
+
 void planning_scene_monitor::PlanningSceneMonitor::startWorldGeometryMonitor(const std::string &collision_objects_topic,
                                                                              const std::string &planning_scene_world_topic,
                                                                              const bool load_octomap_monitor)
@@ -954,9 +1231,10 @@ void planning_scene_monitor::PlanningSceneMonitor::startWorldGeometryMonitor(con
       excludeAttachedBodiesFromOctree();
       excludeWorldObjectsFromOctree();
 
-      octomap_monitor_->setTransformCacheCallback(boost::bind(&PlanningSceneMonitor::getShapeTransformCache, this, _1, _2, _3));
+      octomap_monitor_->setTransformArrayCallback(boost::bind(&PlanningSceneMonitor::getShapeTransformArray, this, _1, _2, _3));
       octomap_monitor_->setUpdateCallback(boost::bind(&PlanningSceneMonitor::octomapUpdateCallback, this));
     }
+    configureStateHistory();
     octomap_monitor_->startMonitor();
   }
 }
@@ -989,6 +1267,7 @@ void planning_scene_monitor::PlanningSceneMonitor::startStateMonitor(const std::
       current_state_monitor_.reset(new CurrentStateMonitor(getRobotModel(), tf_));
     current_state_monitor_->addUpdateCallback(boost::bind(&PlanningSceneMonitor::onStateUpdate, this, _1));
     current_state_monitor_->startStateMonitor(joint_states_topic);
+    configureStateHistory();
 
     {
       boost::mutex::scoped_lock lock(state_pending_mutex_);
@@ -1098,6 +1377,33 @@ void planning_scene_monitor::PlanningSceneMonitor::octomapUpdateCallback()
   triggerSceneUpdateEvent(UPDATE_GEOMETRY);
 }
 
+void planning_scene_monitor::PlanningSceneMonitor::encodeOctomapDelta(const planning_scene::PlanningScene &scene, moveit_msgs::PlanningScene &msg, bool keyframe)
+{
+  if (!octomap_delta_encoder_ || !octomap_monitor_ || msg.world.octomap.octomap.data.empty())
+    return;
+  if (keyframe)
+    octomap_delta_encoder_->forceKeyframe();
+
+  // deltas are taken from the monitored octree; an octomap the scene received from elsewhere is sent in full
+  collision_detection::World::ObjectConstPtr map = scene.getWorld()->getObject(planning_scene::PlanningScene::OCTOMAP_NS);
+  if (map && map->shapes_.size() == 1 && map->shapes_[0]->type == shapes::OCTREE &&
+      static_cast<const shapes::OcTree*>(map->shapes_[0].get())->octree == octomap_monitor_->getOcTreePtr())
+    octomap_delta_encoder_->encodeDelta(*octomap_monitor_->getOcTreePtr(), msg.world.octomap.octomap);
+  else
+    octomap_delta_encoder_->forceKeyframe();
+}
+
+bool planning_scene_monitor::PlanningSceneMonitor::processOctomapMsg(const moveit_msgs::OctomapWithPose &map)
+{
+  // the decoded tree is shared with the scene and its diffs and snapshots, so deltas are applied to a copy of it
+  if (!octomap_delta_decoder_.decode(map.octomap))
+    return false;
+  Eigen::Affine3d origin;
+  tf::poseMsgToEigen(map.origin, origin);
+  scene_->processOctomapPtr(octomap_delta_decoder_.getOcTree(), scene_->getTransforms().getTransform(map.header.frame_id) * origin);
+  return true;
+}
+
 void planning_scene_monitor::PlanningSceneMonitor::setStateUpdateFrequency(double hz)
 {
   bool update = false;
@@ -1165,53 +1471,90 @@ void planning_scene_monitor::PlanningSceneMonitor::setPlanningScenePublishingFre
   ROS_DEBUG("Maximum frquency for publishing a planning scene is now %lf Hz", publish_planning_scene_frequency_);
 }
 
-void planning_scene_monitor::PlanningSceneMonitor::getUpdatedFrameTransforms(std::vector<geometry_msgs::TransformStamped> &transforms)
+bool planning_scene_monitor::PlanningSceneMonitor::getUpdatedFrameTransforms(const std::vector<std::string> &frames,
+                                                                             std::vector<geometry_msgs::TransformStamped> &transforms)
 {
   const std::string &target = getRobotModel()->getModelFrame();
+  bool changed = false;
 
-  std::vector<std::string> all_frame_names;
-  tf_->getFrameStrings(all_frame_names);
-  for (std::size_t i = 0 ; i < all_frame_names.size() ; ++i)
+  boost::mutex::scoped_lock slock(frame_transform_cache_lock_);
+  for (std::size_t i = 0 ; i < frames.size() ; ++i)
   {
-    const std::string &frame_no_slash = (!all_frame_names[i].empty() && all_frame_names[i][0] == '/') ? all_frame_names[i].substr(1) : all_frame_names[i];
-    const std::string &frame_with_slash = (!all_frame_names[i].empty() && all_frame_names[i][0] != '/') ? '/' + all_frame_names[i] : all_frame_names[i];
-
-    if (frame_with_slash == target || getRobotModel()->hasLinkModel(frame_no_slash))
+    // "/frame" and "frame" are the same tf frame
+    const std::string &frame_no_slash = (!frames[i].empty() && frames[i][0] == '/') ? frames[i].substr(1) : frames[i];
+    std::map<std::string, CachedFrameTransform>::iterator it = frame_transform_cache_.find(frame_no_slash);
+    if (it == frame_transform_cache_.end())
+    {
+      it = frame_transform_cache_.insert(std::make_pair(frame_no_slash, CachedFrameTransform())).first;
+      const std::string frame_with_slash = '/' + frame_no_slash;
+      it->second.ignored_ = frame_with_slash == target || getRobotModel()->hasLinkModel(frame_no_slash);
+      it->second.transform_.header.frame_id = frame_with_slash;
+      it->second.transform_.child_frame_id = target;
+    }
+    CachedFrameTransform &cached = it->second;
+    if (cached.ignored_)
       continue;
 
     ros::Time stamp(0);
     std::string err_string;
-    if (tf_->getLatestCommonTime(target, all_frame_names[i], stamp, &err_string) != tf::NO_ERROR)
+    if (tf_->getLatestCommonTime(target, frames[i], stamp, &err_string) != tf::NO_ERROR)
     {
-      ROS_WARN_STREAM("No transform available between frame '" << all_frame_names[i] << "' and planning frame '" <<
+      ROS_WARN_STREAM("No transform available between frame '" << frames[i] << "' and planning frame '" <<
                       target << "' (" << err_string << ")");
       continue;
     }
 
+    // tf has no newer data for this frame, or the transform is static; the cached transform is still valid
+    if (cached.valid_ && stamp == cached.stamp_)
+    {
+      frame_transform_lookups_avoided_++;
+      transforms.push_back(cached.transform_);
+      continue;
+    }
+
     tf::StampedTransform t;
     try
     {
-      tf_->lookupTransform(target, all_frame_names[i], stamp, t);
+      frame_transform_lookups_++;
+      tf_->lookupTransform(target, frames[i], stamp, t);
     }
     catch (tf::TransformException& ex)
     {
-      ROS_WARN_STREAM("Unable to transform object from frame '" << all_frame_names[i] << "' to planning frame '" <<
+      ROS_WARN_STREAM("Unable to transform object from frame '" << frames[i] << "' to planning frame '" <<
                       target << "' (" << ex.what() << ")");
       continue;
     }
-    geometry_msgs::TransformStamped f;
-    f.header.frame_id = frame_with_slash;
-    f.child_frame_id = target;
-    f.transform.translation.x = t.getOrigin().x();
-    f.transform.translation.y = t.getOrigin().y();
-    f.transform.translation.z = t.getOrigin().z();
+    geometry_msgs::Transform &f = cached.transform_.transform;
     const tf::Quaternion &q = t.getRotation();
-    f.transform.rotation.x = q.x();
-    f.transform.rotation.y = q.y();
-    f.transform.rotation.z = q.z();
-    f.transform.rotation.w = q.w();
-    transforms.push_back(f);
+    // a new stamp does not mean the frame moved
+    if (!cached.valid_ ||
+        f.translation.x != t.getOrigin().x() || f.translation.y != t.getOrigin().y() || f.translation.z != t.getOrigin().z() ||
+        f.rotation.x != q.x() || f.rotation.y != q.y() || f.rotation.z != q.z() || f.rotation.w != q.w())
+    {
+      f.translation.x = t.getOrigin().x();
+      f.translation.y = t.getOrigin().y();
+      f.translation.z = t.getOrigin().z();
+      f.rotation.x = q.x();
+      f.rotation.y = q.y();
+      f.rotation.z = q.z();
+      f.rotation.w = q.w();
+      changed = true;
+    }
+    cached.stamp_ = stamp;
+    cached.valid_ = true;
+    transforms.push_back(cached.transform_);
+  }
+  return changed;
+}
+
+void planning_scene_monitor::PlanningSceneMonitor::setFrameTransforms(const std::vector<geometry_msgs::TransformStamped> &transforms)
+{
+  {
+    boost::unique_lock<boost::shared_mutex> ulock(scene_update_mutex_);
+    scene_->getTransformsNonConst().setTransforms(transforms);
+    last_update_time_ = ros::Time::now();
   }
+  triggerSceneUpdateEvent(UPDATE_TRANSFORMS);
 }
 
 void planning_scene_monitor::PlanningSceneMonitor::updateFrameTransforms()
@@ -1221,17 +1564,51 @@ void planning_scene_monitor::PlanningSceneMonitor::updateFrameTransforms()
 
   if (scene_)
   {
+    std::vector<std::string> all_frame_names;
+    tf_->getFrameStrings(all_frame_names);
+
     std::vector<geometry_msgs::TransformStamped> transforms;
-    getUpdatedFrameTransforms(transforms);
+    bool changed = getUpdatedFrameTransforms(all_frame_names, transforms);
     {
-      boost::unique_lock<boost::shared_mutex> ulock(scene_update_mutex_);
-      scene_->getTransformsNonConst().setTransforms(transforms);
-      last_update_time_ = ros::Time::now();
+      // frames that disappeared from tf or could not be looked up also count as a change
+      boost::mutex::scoped_lock slock(frame_transform_cache_lock_);
+      if (transforms.size() != frame_transform_count_)
+        changed = true;
+      frame_transform_count_ = transforms.size();
+    }
+    if (changed)
+      setFrameTransforms(transforms);
+  }
+}
+
+void planning_scene_monitor::PlanningSceneMonitor::updateSceneFrameTransforms()
+{
+  if (!tf_)
+    return;
+
+  if (scene_)
+  {
+    std::vector<std::string> frames;
+    {
+      boost::shared_lock<boost::shared_mutex> slock(scene_update_mutex_);
+      const robot_state::FixedTransformsMap &known = scene_->getTransforms().getAllTransforms();
+      for (robot_state::FixedTransformsMap::const_iterator it = known.begin() ; it != known.end() ; ++it)
+        frames.push_back(it->first);
     }
-    triggerSceneUpdateEvent(UPDATE_TRANSFORMS);
+
+    std::vector<geometry_msgs::TransformStamped> transforms;
+    if (getUpdatedFrameTransforms(frames, transforms))
+      setFrameTransforms(transforms);
   }
 }
 
+void planning_scene_monitor::PlanningSceneMonitor::getFrameTransformLookupCounts(std::size_t &performed, std::size_t &avoided) const
+{
+  boost::mutex::scoped_lock slock(frame_transform_cache_lock_);
+  performed = frame_transform_lookups_;
+  avoided = frame_transform_lookups_avoided_;
+}
+
 void planning_scene_monitor::PlanningSceneMonitor::publishDebugInformation(bool flag)
 {
   if (octomap_monitor_)
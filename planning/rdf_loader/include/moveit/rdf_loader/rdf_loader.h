@@ -51,7 +51,8 @@ class RDFLoader
 {
 public:
   /** @brief Default constructor
-   *  @param robot_description The string name corresponding to the ROS param where the URDF is loaded; the SRDF is assumed to be at the same param name + the "_semantic" suffix */
+   *  @param robot_description The string name corresponding to the ROS param where the URDF is loaded; the SRDF is assumed to be at the same param name + the "_semantic" suffix
+   *  If the "robot_description_cache_directory" ROS param is set, parsed URDFs are saved to and loaded from that directory (see RobotDescriptionCache) */
   RDFLoader(const std::string &robot_description = "robot_description");
 
    /** \brief Initialize the robot model from a string representation of the URDF and SRDF documents */
@@ -60,6 +61,13 @@ public:
   /** \brief Initialize the robot model from a parsed XML representation of the URDF and SRDF */
   RDFLoader(TiXmlDocument *urdf_doc, TiXmlDocument *srdf_doc);
 
+  /** @brief Read the URDF and SRDF documents of \e robot_description from the parameter server, the way the
+   *  robot_description constructor finds them: the URDF is at the resolved name of \e robot_description, returned in
+   *  \e param_name, and the SRDF at that name + "_semantic". Returns false if the URDF is not found; \e has_srdf is set
+   *  if the SRDF is found. */
+  static bool readDescriptionParams(const std::string &robot_description, std::string &param_name,
+                                    std::string &urdf_string, std::string &srdf_string, bool &has_srdf);
+
   /** @brief Get the resolved parameter name for the robot description */
   const std::string& getRobotDescription() const
   {
@@ -0,0 +1,84 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2011, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#ifndef MOVEIT_PLANNING_RDF_LOADER_ROBOT_DESCRIPTION_CACHE_
+#define MOVEIT_PLANNING_RDF_LOADER_ROBOT_DESCRIPTION_CACHE_
+
+#include <urdf_model/model.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
+
+namespace rdf_loader
+{
+
+/** @class RobotDescriptionCache
+ *  @brief A directory of binary files that hold parsed URDF models, so nodes loading the same robot description
+ *  can skip the XML parsing. A file is named after a hash of the URDF and SRDF strings it was built from
+ *  and is memory-mapped when read. Files written by a different version of the format are ignored. */
+class RobotDescriptionCache
+{
+public:
+
+  /** @brief Version of the file format; bump this whenever the layout of the files changes */
+  static const boost::uint32_t FORMAT_VERSION;
+
+  /** @brief Use the cache files in \e directory, which is created when the first file is saved */
+  RobotDescriptionCache(const std::string &directory);
+
+  const std::string& getDirectory() const
+  {
+    return directory_;
+  }
+
+  /** @brief Compute the key of the cache file for a robot description */
+  static boost::uint64_t computeKey(const std::string &urdf_string, const std::string &srdf_string);
+
+  /** @brief Get the name of the cache file for a robot description */
+  std::string getFilename(const std::string &urdf_string, const std::string &srdf_string) const;
+
+  /** @brief Load the URDF model parsed from \e urdf_string. Return NULL if there is no valid cache file for the description. */
+  boost::shared_ptr<urdf::ModelInterface> loadURDF(const std::string &urdf_string, const std::string &srdf_string) const;
+
+  /** @brief Save the URDF model parsed from \e urdf_string. The file is written under a temporary name and then renamed,
+      so concurrently starting nodes never read a partial file. */
+  bool saveURDF(const std::string &urdf_string, const std::string &srdf_string, const urdf::ModelInterface &urdf) const;
+
+private:
+
+  std::string directory_;
+};
+
+}
+#endif
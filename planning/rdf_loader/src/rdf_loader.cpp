@@ -35,8 +35,10 @@
 /* Author: Ioan Sucan */
 
 #include <moveit/rdf_loader/rdf_loader.h>
+#include <moveit/rdf_loader/robot_description_cache.h>
 #include <moveit/profiler/profiler.h>
 #include <ros/ros.h>
+#include <boost/scoped_ptr.hpp>
 
 rdf_loader::RDFLoader::RDFLoader(const std::string &robot_description)
 {
@@ -47,15 +49,35 @@ rdf_loader::RDFLoader::RDFLoader(const std::string &robot_description)
   ros::NodeHandle nh("~");
   if (nh.searchParam(robot_description, robot_description_))
   {
-    std::string content;
-    if (nh.getParam(robot_description_, content))
+    std::string content, scontent;
+    bool has_srdf;
+    if (readDescriptionParams(robot_description, robot_description_, content, scontent, has_srdf))
     {
-      urdf::Model *umodel = new urdf::Model();
-      urdf_.reset(umodel);
-      if (umodel->initString(content))
+      // a node that loaded the same description before may have saved the parsed URDF
+      boost::scoped_ptr<RobotDescriptionCache> cache;
+      std::string cache_directory_param, cache_directory;
+      if (has_srdf && nh.searchParam("robot_description_cache_directory", cache_directory_param) &&
+          nh.getParam(cache_directory_param, cache_directory) && !cache_directory.empty())
       {
-        std::string scontent;
-        if (nh.getParam(robot_description_ + "_semantic", scontent))
+        cache.reset(new RobotDescriptionCache(cache_directory));
+        urdf_ = cache->loadURDF(content, scontent);
+        if (urdf_)
+          ROS_DEBUG_NAMED("rdf", "Loaded parsed URDF from robot description cache in '%s'", cache_directory.c_str());
+      }
+
+      bool parsed = true;
+      if (!urdf_)
+      {
+        urdf::Model *umodel = new urdf::Model();
+        urdf_.reset(umodel);
+        parsed = umodel->initString(content);
+        if (parsed && cache)
+          cache->saveURDF(content, scontent, *urdf_);
+      }
+
+      if (parsed)
+      {
+        if (has_srdf)
         {
           srdf_.reset(new srdf::Model());
           if (!srdf_->initString(*urdf_, scontent))
@@ -79,6 +101,17 @@ rdf_loader::RDFLoader::RDFLoader(const std::string &robot_description)
   ROS_DEBUG_STREAM_NAMED("rdf",  "Loaded robot model in " << (ros::WallTime::now() - start).toSec() << " seconds");
 }
 
+bool rdf_loader::RDFLoader::readDescriptionParams(const std::string &robot_description, std::string &param_name,
+                                                  std::string &urdf_string, std::string &srdf_string, bool &has_srdf)
+{
+  ros::NodeHandle nh("~");
+  has_srdf = false;
+  if (!nh.searchParam(robot_description, param_name) || !nh.getParam(param_name, urdf_string))
+    return false;
+  has_srdf = nh.getParam(param_name + "_semantic", srdf_string);
+  return true;
+}
+
 rdf_loader::RDFLoader::RDFLoader(const std::string &urdf_string, const std::string &srdf_string)
 {
   moveit::tools::Profiler::ScopedStart prof_start;
@@ -0,0 +1,597 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2011, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include <moveit/rdf_loader/robot_description_cache.h>
+#include <urdf/model.h>
+#include <ros/console.h>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <unistd.h>
+
+namespace rdf_loader
+{
+
+const boost::uint32_t RobotDescriptionCache::FORMAT_VERSION = 1;
+
+namespace
+{
+const char FILE_MAGIC[8] = { 'M', 'V', 'R', 'D', 'E', 'S', 'C', '\0' };
+
+// the largest count of anything in a file that is accepted when reading it
+const boost::uint32_t MAX_COUNT = 1 << 24;
+
+template<typename T>
+void writeValue(std::ofstream &out, const T &value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void writeString(std::ofstream &out, const std::string &value)
+{
+  writeValue<boost::uint32_t>(out, value.size());
+  out.write(value.data(), value.size());
+}
+
+void writeVector(std::ofstream &out, const urdf::Vector3 &value)
+{
+  writeValue(out, value.x);
+  writeValue(out, value.y);
+  writeValue(out, value.z);
+}
+
+void writePose(std::ofstream &out, const urdf::Pose &value)
+{
+  writeVector(out, value.position);
+  writeValue(out, value.rotation.x);
+  writeValue(out, value.rotation.y);
+  writeValue(out, value.rotation.z);
+  writeValue(out, value.rotation.w);
+}
+
+void writeMaterial(std::ofstream &out, const urdf::Material &material)
+{
+  writeString(out, material.name);
+  writeString(out, material.texture_filename);
+  writeValue(out, material.color.r);
+  writeValue(out, material.color.g);
+  writeValue(out, material.color.b);
+  writeValue(out, material.color.a);
+}
+
+// optional members are preceded by a flag that tells whether they are set
+template<typename T>
+bool writeFlag(std::ofstream &out, const boost::shared_ptr<T> &value)
+{
+  writeValue<boost::uint8_t>(out, value ? 1 : 0);
+  return value.get() != NULL;
+}
+
+void writeGeometry(std::ofstream &out, const boost::shared_ptr<urdf::Geometry> &geometry)
+{
+  if (!writeFlag(out, geometry))
+    return;
+  writeValue<boost::uint8_t>(out, geometry->type);
+  switch (geometry->type)
+  {
+    case urdf::Geometry::SPHERE:
+      writeValue(out, static_cast<const urdf::Sphere&>(*geometry).radius);
+      break;
+    case urdf::Geometry::BOX:
+      writeVector(out, static_cast<const urdf::Box&>(*geometry).dim);
+      break;
+    case urdf::Geometry::CYLINDER:
+      writeValue(out, static_cast<const urdf::Cylinder&>(*geometry).radius);
+      writeValue(out, static_cast<const urdf::Cylinder&>(*geometry).length);
+      break;
+    case urdf::Geometry::MESH:
+      writeString(out, static_cast<const urdf::Mesh&>(*geometry).filename);
+      writeVector(out, static_cast<const urdf::Mesh&>(*geometry).scale);
+      break;
+  }
+}
+
+void writeLink(std::ofstream &out, const urdf::Link &link)
+{
+  writeString(out, link.name);
+  if (writeFlag(out, link.inertial))
+  {
+    writePose(out, link.inertial->origin);
+    writeValue(out, link.inertial->mass);
+    writeValue(out, link.inertial->ixx);
+    writeValue(out, link.inertial->ixy);
+    writeValue(out, link.inertial->ixz);
+    writeValue(out, link.inertial->iyy);
+    writeValue(out, link.inertial->iyz);
+    writeValue(out, link.inertial->izz);
+  }
+
+  writeValue<boost::uint32_t>(out, link.visual_array.size());
+  for (std::size_t i = 0 ; i < link.visual_array.size() ; ++i)
+  {
+    const urdf::Visual &visual = *link.visual_array[i];
+    writePose(out, visual.origin);
+    writeGeometry(out, visual.geometry);
+    writeString(out, visual.material_name);
+    if (writeFlag(out, visual.material))
+      writeMaterial(out, *visual.material);
+  }
+
+  writeValue<boost::uint32_t>(out, link.collision_array.size());
+  for (std::size_t i = 0 ; i < link.collision_array.size() ; ++i)
+  {
+    writePose(out, link.collision_array[i]->origin);
+    writeGeometry(out, link.collision_array[i]->geometry);
+  }
+}
+
+void writeJoint(std::ofstream &out, const urdf::Joint &joint)
+{
+  writeString(out, joint.name);
+  writeValue<boost::uint8_t>(out, joint.type);
+  writeVector(out, joint.axis);
+  writeString(out, joint.parent_link_name);
+  writeString(out, joint.child_link_name);
+  writePose(out, joint.parent_to_joint_origin_transform);
+  if (writeFlag(out, joint.dynamics))
+  {
+    writeValue(out, joint.dynamics->damping);
+    writeValue(out, joint.dynamics->friction);
+  }
+  if (writeFlag(out, joint.limits))
+  {
+    writeValue(out, joint.limits->lower);
+    writeValue(out, joint.limits->upper);
+    writeValue(out, joint.limits->effort);
+    writeValue(out, joint.limits->velocity);
+  }
+  if (writeFlag(out, joint.safety))
+  {
+    writeValue(out, joint.safety->soft_upper_limit);
+    writeValue(out, joint.safety->soft_lower_limit);
+    writeValue(out, joint.safety->k_position);
+    writeValue(out, joint.safety->k_velocity);
+  }
+  if (writeFlag(out, joint.calibration))
+  {
+    writeValue(out, joint.calibration->reference_position);
+    if (writeFlag(out, joint.calibration->rising))
+      writeValue(out, *joint.calibration->rising);
+    if (writeFlag(out, joint.calibration->falling))
+      writeValue(out, *joint.calibration->falling);
+  }
+  if (writeFlag(out, joint.mimic))
+  {
+    writeString(out, joint.mimic->joint_name);
+    writeValue(out, joint.mimic->multiplier);
+    writeValue(out, joint.mimic->offset);
+  }
+}
+
+/** \brief Sequential reads from a memory-mapped cache file. Once a read fails, all following reads fail as well. */
+class Reader
+{
+public:
+
+  Reader(const char *data, std::size_t size) : pos_(data), end_(data + size), ok_(true)
+  {
+  }
+
+  bool ok() const
+  {
+    return ok_;
+  }
+
+  bool atEnd() const
+  {
+    return pos_ == end_;
+  }
+
+  template<typename T>
+  bool read(T &value)
+  {
+    ok_ = ok_ && (std::size_t)(end_ - pos_) >= sizeof(T);
+    if (ok_)
+    {
+      std::memcpy(&value, pos_, sizeof(T));
+      pos_ += sizeof(T);
+    }
+    return ok_;
+  }
+
+  bool read(std::string &value)
+  {
+    boost::uint32_t size;
+    ok_ = read(size) && (std::size_t)(end_ - pos_) >= size;
+    if (ok_)
+    {
+      value.assign(pos_, size);
+      pos_ += size;
+    }
+    return ok_;
+  }
+
+  bool read(urdf::Vector3 &value)
+  {
+    return read(value.x) && read(value.y) && read(value.z);
+  }
+
+  bool read(urdf::Pose &value)
+  {
+    return read(value.position) && read(value.rotation.x) && read(value.rotation.y) && read(value.rotation.z) && read(value.rotation.w);
+  }
+
+  bool read(urdf::Material &value)
+  {
+    return read(value.name) && read(value.texture_filename) &&
+      read(value.color.r) && read(value.color.g) && read(value.color.b) && read(value.color.a);
+  }
+
+  bool readCount(boost::uint32_t &count)
+  {
+    ok_ = read(count) && count < MAX_COUNT;
+    return ok_;
+  }
+
+  /** \brief Read the flag of an optional member and allocate the member if it is set */
+  template<typename T>
+  bool readFlag(boost::shared_ptr<T> &value)
+  {
+    boost::uint8_t flag = 0;
+    if (read(flag) && flag)
+      value.reset(new T());
+    return ok_ && flag;
+  }
+
+  bool read(boost::shared_ptr<urdf::Geometry> &geometry)
+  {
+    boost::uint8_t flag = 0, type = 0;
+    if (!read(flag) || !flag || !read(type))
+      return ok_;
+    switch (type)
+    {
+      case urdf::Geometry::SPHERE:
+      {
+        urdf::Sphere *sphere = new urdf::Sphere();
+        geometry.reset(sphere);
+        return read(sphere->radius);
+      }
+      case urdf::Geometry::BOX:
+      {
+        urdf::Box *box = new urdf::Box();
+        geometry.reset(box);
+        return read(box->dim);
+      }
+      case urdf::Geometry::CYLINDER:
+      {
+        urdf::Cylinder *cylinder = new urdf::Cylinder();
+        geometry.reset(cylinder);
+        return read(cylinder->radius) && read(cylinder->length);
+      }
+      case urdf::Geometry::MESH:
+      {
+        urdf::Mesh *mesh = new urdf::Mesh();
+        geometry.reset(mesh);
+        return read(mesh->filename) && read(mesh->scale);
+      }
+    }
+    ok_ = false;
+    return ok_;
+  }
+
+  bool read(urdf::Link &link)
+  {
+    if (!read(link.name))
+      return false;
+    if (readFlag(link.inertial))
+    {
+      read(link.inertial->origin);
+      read(link.inertial->mass);
+      read(link.inertial->ixx);
+      read(link.inertial->ixy);
+      read(link.inertial->ixz);
+      read(link.inertial->iyy);
+      read(link.inertial->iyz);
+      read(link.inertial->izz);
+    }
+
+    boost::uint32_t count;
+    if (readCount(count))
+      for (boost::uint32_t i = 0 ; i < count && ok_ ; ++i)
+      {
+        boost::shared_ptr<urdf::Visual> visual(new urdf::Visual());
+        if (read(visual->origin) && read(visual->geometry) && read(visual->material_name) && readFlag(visual->material))
+          read(*visual->material);
+        link.visual_array.push_back(visual);
+      }
+    if (readCount(count))
+      for (boost::uint32_t i = 0 ; i < count && ok_ ; ++i)
+      {
+        boost::shared_ptr<urdf::Collision> collision(new urdf::Collision());
+        read(collision->origin);
+        read(collision->geometry);
+        link.collision_array.push_back(collision);
+      }
+
+    // as the URDF parser does, the first visual and collision elements are also the default ones
+    if (!link.visual_array.empty())
+      link.visual = link.visual_array.front();
+    if (!link.collision_array.empty())
+      link.collision = link.collision_array.front();
+    return ok_;
+  }
+
+  bool read(urdf::Joint &joint)
+  {
+    boost::uint8_t type;
+    if (!read(joint.name) || !read(type) || !read(joint.axis) || !read(joint.parent_link_name) ||
+        !read(joint.child_link_name) || !read(joint.parent_to_joint_origin_transform))
+      return false;
+    if (type > urdf::Joint::FIXED)
+    {
+      ok_ = false;
+      return ok_;
+    }
+    joint.type = static_cast<decltype(joint.type)>(type);
+    if (readFlag(joint.dynamics))
+    {
+      read(joint.dynamics->damping);
+      read(joint.dynamics->friction);
+    }
+    if (readFlag(joint.limits))
+    {
+      read(joint.limits->lower);
+      read(joint.limits->upper);
+      read(joint.limits->effort);
+      read(joint.limits->velocity);
+    }
+    if (readFlag(joint.safety))
+    {
+      read(joint.safety->soft_upper_limit);
+      read(joint.safety->soft_lower_limit);
+      read(joint.safety->k_position);
+      read(joint.safety->k_velocity);
+    }
+    if (readFlag(joint.calibration))
+    {
+      read(joint.calibration->reference_position);
+      if (readFlag(joint.calibration->rising))
+        read(*joint.calibration->rising);
+      if (readFlag(joint.calibration->falling))
+        read(*joint.calibration->falling);
+    }
+    if (readFlag(joint.mimic))
+    {
+      read(joint.mimic->joint_name);
+      read(joint.mimic->multiplier);
+      read(joint.mimic->offset);
+    }
+    return ok_;
+  }
+
+private:
+
+  const char *pos_;
+  const char *end_;
+  bool ok_;
+};
+
+// FNV-1a, which unlike boost::hash gives the same value in every process and on every platform
+void hashString(const std::string &value, boost::uint64_t &hash)
+{
+  for (std::size_t i = 0 ; i < value.size() ; ++i)
+  {
+    hash ^= (unsigned char)value[i];
+    hash *= 1099511628211ULL;
+  }
+}
+}
+
+RobotDescriptionCache::RobotDescriptionCache(const std::string &directory) : directory_(directory)
+{
+}
+
+boost::uint64_t RobotDescriptionCache::computeKey(const std::string &urdf_string, const std::string &srdf_string)
+{
+  boost::uint64_t hash = 14695981039346656037ULL;
+  hashString(urdf_string, hash);
+  // separate the two documents, so moving text from one to the other changes the key
+  hashString(std::string(1, '\0'), hash);
+  hashString(srdf_string, hash);
+  return hash;
+}
+
+std::string RobotDescriptionCache::getFilename(const std::string &urdf_string, const std::string &srdf_string) const
+{
+  std::stringstream ss;
+  ss << "robot_description_" << std::hex << std::setw(16) << std::setfill('0') << computeKey(urdf_string, srdf_string) << ".bin";
+  return (boost::filesystem::path(directory_) / ss.str()).string();
+}
+
+boost::shared_ptr<urdf::ModelInterface> RobotDescriptionCache::loadURDF(const std::string &urdf_string, const std::string &srdf_string) const
+{
+  boost::shared_ptr<urdf::ModelInterface> result;
+  const std::string filename = getFilename(urdf_string, srdf_string);
+
+  boost::system::error_code ec;
+  if (!boost::filesystem::exists(filename, ec))
+    return result;
+
+  boost::interprocess::mapped_region region;
+  try
+  {
+    boost::interprocess::file_mapping mapping(filename.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region(mapping, boost::interprocess::read_only).swap(region);
+  }
+  catch (boost::interprocess::interprocess_exception &ex)
+  {
+    ROS_WARN_NAMED("rdf", "Unable to map robot description cache file '%s': %s", filename.c_str(), ex.what());
+    return result;
+  }
+
+  Reader reader(static_cast<const char*>(region.get_address()), region.get_size());
+  char magic[sizeof(FILE_MAGIC)];
+  boost::uint32_t version = 0;
+  boost::uint64_t key = 0, urdf_size = 0, srdf_size = 0;
+  for (std::size_t i = 0 ; i < sizeof(magic) ; ++i)
+    reader.read(magic[i]);
+  reader.read(version);
+  reader.read(key);
+  reader.read(urdf_size);
+  reader.read(srdf_size);
+  if (!reader.ok() || !std::equal(magic, magic + sizeof(magic), FILE_MAGIC) || version != FORMAT_VERSION)
+  {
+    ROS_DEBUG_NAMED("rdf", "Ignoring robot description cache file '%s' of another format version", filename.c_str());
+    return result;
+  }
+  // the sizes guard against hash collisions
+  if (key != computeKey(urdf_string, srdf_string) || urdf_size != urdf_string.size() || srdf_size != srdf_string.size())
+  {
+    ROS_DEBUG_NAMED("rdf", "Robot description cache file '%s' was built from another robot description", filename.c_str());
+    return result;
+  }
+
+  urdf::Model *model = new urdf::Model();
+  boost::shared_ptr<urdf::ModelInterface> urdf(model);
+  boost::uint32_t count;
+  reader.read(model->name_);
+  if (reader.readCount(count))
+    for (boost::uint32_t i = 0 ; i < count && reader.ok() ; ++i)
+    {
+      boost::shared_ptr<urdf::Material> material(new urdf::Material());
+      if (reader.read(*material))
+        model->materials_[material->name] = material;
+    }
+  if (reader.readCount(count))
+    for (boost::uint32_t i = 0 ; i < count && reader.ok() ; ++i)
+    {
+      boost::shared_ptr<urdf::Link> link(new urdf::Link());
+      if (reader.read(*link))
+        model->links_[link->name] = link;
+    }
+  if (reader.readCount(count))
+    for (boost::uint32_t i = 0 ; i < count && reader.ok() ; ++i)
+    {
+      boost::shared_ptr<urdf::Joint> joint(new urdf::Joint());
+      if (reader.read(*joint))
+        model->joints_[joint->name] = joint;
+    }
+  if (!reader.ok() || !reader.atEnd())
+  {
+    ROS_WARN_NAMED("rdf", "Robot description cache file '%s' is truncated or corrupt", filename.c_str());
+    return result;
+  }
+
+  // connect the links and joints the same way the URDF parser does
+  try
+  {
+    std::map<std::string, std::string> parent_link_tree;
+    model->initTree(parent_link_tree);
+    model->initRoot(parent_link_tree);
+  }
+  catch (std::exception &ex)
+  {
+    ROS_WARN_NAMED("rdf", "Robot description cache file '%s' does not describe a tree: %s", filename.c_str(), ex.what());
+    return result;
+  }
+
+  result = urdf;
+  return result;
+}
+
+bool RobotDescriptionCache::saveURDF(const std::string &urdf_string, const std::string &srdf_string, const urdf::ModelInterface &urdf) const
+{
+  const std::string filename = getFilename(urdf_string, srdf_string);
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(directory_, ec);
+  if (ec)
+  {
+    ROS_WARN_NAMED("rdf", "Unable to create robot description cache directory '%s': %s", directory_.c_str(), ec.message().c_str());
+    return false;
+  }
+
+  std::stringstream tmp_name;
+  tmp_name << filename << "." << getpid() << ".tmp";
+  const std::string tmp_filename = tmp_name.str();
+  {
+    std::ofstream out(tmp_filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.good())
+    {
+      ROS_WARN_NAMED("rdf", "Unable to open '%s' for writing", tmp_filename.c_str());
+      return false;
+    }
+
+    out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    writeValue(out, FORMAT_VERSION);
+    writeValue(out, computeKey(urdf_string, srdf_string));
+    writeValue<boost::uint64_t>(out, urdf_string.size());
+    writeValue<boost::uint64_t>(out, srdf_string.size());
+    writeString(out, urdf.name_);
+
+    writeValue<boost::uint32_t>(out, urdf.materials_.size());
+    for (std::map<std::string, boost::shared_ptr<urdf::Material> >::const_iterator it = urdf.materials_.begin() ; it != urdf.materials_.end() ; ++it)
+      writeMaterial(out, *it->second);
+    writeValue<boost::uint32_t>(out, urdf.links_.size());
+    for (std::map<std::string, boost::shared_ptr<urdf::Link> >::const_iterator it = urdf.links_.begin() ; it != urdf.links_.end() ; ++it)
+      writeLink(out, *it->second);
+    writeValue<boost::uint32_t>(out, urdf.joints_.size());
+    for (std::map<std::string, boost::shared_ptr<urdf::Joint> >::const_iterator it = urdf.joints_.begin() ; it != urdf.joints_.end() ; ++it)
+      writeJoint(out, *it->second);
+
+    if (!out.good())
+    {
+      ROS_WARN_NAMED("rdf", "Error writing '%s'", tmp_filename.c_str());
+      out.close();
+      boost::filesystem::remove(tmp_filename, ec);
+      return false;
+    }
+  }
+
+  boost::filesystem::rename(tmp_filename, filename, ec);
+  if (ec)
+  {
+    ROS_WARN_NAMED("rdf", "Unable to rename '%s' to '%s': %s", tmp_filename.c_str(), filename.c_str(), ec.message().c_str());
+    boost::filesystem::remove(tmp_filename, ec);
+    return false;
+  }
+  ROS_DEBUG_NAMED("rdf", "Saved parsed robot description to '%s'", filename.c_str());
+  return true;
+}
+
+}
@@ -0,0 +1,205 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2011, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+
+#include <gtest/gtest.h>
+#include <moveit/rdf_loader/robot_description_cache.h>
+#include <urdf/model.h>
+#include <boost/filesystem.hpp>
+
+using namespace rdf_loader;
+
+namespace
+{
+
+const std::string URDF_STRING =
+  "<robot name=\"arm\">"
+  "  <material name=\"grey\"><color rgba=\"0.5 0.5 0.5 1\"/></material>"
+  "  <link name=\"base_link\">"
+  "    <inertial><origin xyz=\"0 0 0.1\"/><mass value=\"2.0\"/><inertia ixx=\"0.1\" ixy=\"0\" ixz=\"0\" iyy=\"0.2\" iyz=\"0\" izz=\"0.3\"/></inertial>"
+  "    <visual><geometry><box size=\"0.2 0.3 0.4\"/></geometry><material name=\"grey\"/></visual>"
+  "    <collision><geometry><box size=\"0.2 0.3 0.4\"/></geometry></collision>"
+  "  </link>"
+  "  <link name=\"upper_arm\">"
+  "    <collision><origin xyz=\"0 0 0.25\" rpy=\"0 1.5707963 0\"/><geometry><cylinder radius=\"0.05\" length=\"0.5\"/></geometry></collision>"
+  "    <collision><geometry><sphere radius=\"0.07\"/></geometry></collision>"
+  "  </link>"
+  "  <link name=\"gripper\">"
+  "    <visual><geometry><mesh filename=\"package://arm/gripper.stl\" scale=\"0.001 0.001 0.001\"/></geometry></visual>"
+  "  </link>"
+  "  <link name=\"finger\"/>"
+  "  <joint name=\"shoulder\" type=\"revolute\">"
+  "    <parent link=\"base_link\"/><child link=\"upper_arm\"/><origin xyz=\"0 0 0.2\"/><axis xyz=\"0 1 0\"/>"
+  "    <limit lower=\"-1.5\" upper=\"1.5\" effort=\"10\" velocity=\"2\"/><dynamics damping=\"0.5\" friction=\"0.1\"/>"
+  "    <safety_controller soft_lower_limit=\"-1.4\" soft_upper_limit=\"1.4\" k_position=\"20\" k_velocity=\"5\"/>"
+  "  </joint>"
+  "  <joint name=\"wrist\" type=\"continuous\">"
+  "    <parent link=\"upper_arm\"/><child link=\"gripper\"/><origin xyz=\"0 0 0.5\" rpy=\"0.1 0.2 0.3\"/><axis xyz=\"0 0 1\"/>"
+  "  </joint>"
+  "  <joint name=\"finger_joint\" type=\"prismatic\">"
+  "    <parent link=\"gripper\"/><child link=\"finger\"/><axis xyz=\"1 0 0\"/>"
+  "    <limit lower=\"0\" upper=\"0.04\" effort=\"1\" velocity=\"0.1\"/><mimic joint=\"wrist\" multiplier=\"0.01\" offset=\"0.002\"/>"
+  "  </joint>"
+  "</robot>";
+
+const std::string SRDF_STRING = "<robot name=\"arm\"><group name=\"arm\"><chain base_link=\"base_link\" tip_link=\"gripper\"/></group></robot>";
+
+class RobotDescriptionCacheTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    directory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    urdf_.reset(new urdf::Model());
+    ASSERT_TRUE(urdf_->initString(URDF_STRING));
+  }
+
+  virtual void TearDown()
+  {
+    boost::filesystem::remove_all(directory_);
+  }
+
+  boost::filesystem::path directory_;
+  boost::shared_ptr<urdf::Model> urdf_;
+};
+
+}
+
+TEST_F(RobotDescriptionCacheTest, Key)
+{
+  boost::uint64_t key = RobotDescriptionCache::computeKey(URDF_STRING, SRDF_STRING);
+  EXPECT_EQ(key, RobotDescriptionCache::computeKey(URDF_STRING, SRDF_STRING));
+  EXPECT_NE(key, RobotDescriptionCache::computeKey(URDF_STRING, SRDF_STRING + " "));
+  EXPECT_NE(RobotDescriptionCache::computeKey("ab", "c"), RobotDescriptionCache::computeKey("a", "bc"));
+
+  RobotDescriptionCache cache(directory_.string());
+  EXPECT_NE(cache.getFilename(URDF_STRING, SRDF_STRING), cache.getFilename(URDF_STRING + " ", SRDF_STRING));
+}
+
+TEST_F(RobotDescriptionCacheTest, SaveAndLoad)
+{
+  RobotDescriptionCache cache(directory_.string());
+  EXPECT_FALSE(cache.loadURDF(URDF_STRING, SRDF_STRING).get());
+  ASSERT_TRUE(cache.saveURDF(URDF_STRING, SRDF_STRING, *urdf_));
+  EXPECT_TRUE(boost::filesystem::exists(cache.getFilename(URDF_STRING, SRDF_STRING)));
+
+  // a different description does not use the file
+  EXPECT_FALSE(cache.loadURDF(URDF_STRING, SRDF_STRING + " ").get());
+
+  boost::shared_ptr<urdf::ModelInterface> loaded = cache.loadURDF(URDF_STRING, SRDF_STRING);
+  ASSERT_TRUE(loaded.get());
+  EXPECT_EQ("arm", loaded->getName());
+  EXPECT_EQ(urdf_->links_.size(), loaded->links_.size());
+  EXPECT_EQ(urdf_->joints_.size(), loaded->joints_.size());
+  ASSERT_TRUE(loaded->getRoot().get());
+  EXPECT_EQ("base_link", loaded->getRoot()->name);
+
+  // the tree is connected
+  boost::shared_ptr<const urdf::Link> finger = loaded->getLink("finger");
+  ASSERT_TRUE(finger.get());
+  ASSERT_TRUE(finger->getParent().get());
+  EXPECT_EQ("gripper", finger->getParent()->name);
+  ASSERT_TRUE(finger->parent_joint.get());
+  EXPECT_EQ("finger_joint", finger->parent_joint->name);
+
+  boost::shared_ptr<const urdf::Link> base = loaded->getLink("base_link");
+  ASSERT_TRUE(base && base->inertial && base->visual && base->collision);
+  EXPECT_DOUBLE_EQ(2.0, base->inertial->mass);
+  EXPECT_DOUBLE_EQ(0.3, base->inertial->izz);
+  EXPECT_DOUBLE_EQ(0.1, base->inertial->origin.position.z);
+  ASSERT_EQ(urdf::Geometry::BOX, base->collision->geometry->type);
+  EXPECT_DOUBLE_EQ(0.3, boost::static_pointer_cast<urdf::Box>(base->collision->geometry)->dim.y);
+  EXPECT_EQ("grey", base->visual->material_name);
+  ASSERT_TRUE(base->visual->material.get());
+  EXPECT_FLOAT_EQ(0.5, base->visual->material->color.r);
+
+  boost::shared_ptr<const urdf::Link> upper_arm = loaded->getLink("upper_arm");
+  ASSERT_TRUE(upper_arm.get());
+  ASSERT_EQ(2u, upper_arm->collision_array.size());
+  ASSERT_EQ(urdf::Geometry::CYLINDER, upper_arm->collision_array[0]->geometry->type);
+  EXPECT_DOUBLE_EQ(0.5, boost::static_pointer_cast<urdf::Cylinder>(upper_arm->collision_array[0]->geometry)->length);
+  EXPECT_DOUBLE_EQ(0.25, upper_arm->collision_array[0]->origin.position.z);
+  double x, y, z, w, ex, ey, ez, ew;
+  upper_arm->collision_array[0]->origin.rotation.getQuaternion(x, y, z, w);
+  urdf_->getLink("upper_arm")->collision_array[0]->origin.rotation.getQuaternion(ex, ey, ez, ew);
+  EXPECT_DOUBLE_EQ(ey, y);
+  EXPECT_DOUBLE_EQ(ew, w);
+  ASSERT_EQ(urdf::Geometry::SPHERE, upper_arm->collision_array[1]->geometry->type);
+
+  boost::shared_ptr<const urdf::Link> gripper = loaded->getLink("gripper");
+  ASSERT_TRUE(gripper && gripper->visual);
+  ASSERT_EQ(urdf::Geometry::MESH, gripper->visual->geometry->type);
+  EXPECT_EQ("package://arm/gripper.stl", boost::static_pointer_cast<urdf::Mesh>(gripper->visual->geometry)->filename);
+
+  boost::shared_ptr<const urdf::Joint> shoulder = loaded->getJoint("shoulder");
+  ASSERT_TRUE(shoulder && shoulder->limits && shoulder->dynamics && shoulder->safety);
+  EXPECT_EQ(urdf::Joint::REVOLUTE, shoulder->type);
+  EXPECT_DOUBLE_EQ(1.0, shoulder->axis.y);
+  EXPECT_DOUBLE_EQ(-1.5, shoulder->limits->lower);
+  EXPECT_DOUBLE_EQ(2.0, shoulder->limits->velocity);
+  EXPECT_DOUBLE_EQ(0.5, shoulder->dynamics->damping);
+  EXPECT_DOUBLE_EQ(20.0, shoulder->safety->k_position);
+  EXPECT_EQ(urdf::Joint::CONTINUOUS, loaded->getJoint("wrist")->type);
+
+  boost::shared_ptr<const urdf::Joint> finger_joint = loaded->getJoint("finger_joint");
+  ASSERT_TRUE(finger_joint && finger_joint->mimic);
+  EXPECT_EQ(urdf::Joint::PRISMATIC, finger_joint->type);
+  EXPECT_EQ("wrist", finger_joint->mimic->joint_name);
+  EXPECT_DOUBLE_EQ(0.002, finger_joint->mimic->offset);
+}
+
+TEST_F(RobotDescriptionCacheTest, Corrupt)
+{
+  RobotDescriptionCache cache(directory_.string());
+  ASSERT_TRUE(cache.saveURDF(URDF_STRING, SRDF_STRING, *urdf_));
+  const std::string filename = cache.getFilename(URDF_STRING, SRDF_STRING);
+
+  // a truncated file is rejected
+  boost::filesystem::resize_file(filename, boost::filesystem::file_size(filename) - 4);
+  EXPECT_FALSE(cache.loadURDF(URDF_STRING, SRDF_STRING).get());
+
+  // and replaced when the description is saved again
+  ASSERT_TRUE(cache.saveURDF(URDF_STRING, SRDF_STRING, *urdf_));
+  EXPECT_TRUE(cache.loadURDF(URDF_STRING, SRDF_STRING).get());
+
+  boost::filesystem::resize_file(filename, 0);
+  EXPECT_FALSE(cache.loadURDF(URDF_STRING, SRDF_STRING).get());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,171 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_REACHABILITY_MAP_REACHABILITY_MAP_
+#define MOVEIT_REACHABILITY_MAP_REACHABILITY_MAP_
+
+#include <Eigen/Geometry>
+#include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <string>
+#include <vector>
+
+namespace reachability_map
+{
+
+/** \brief A voxelized map of the poses a link of a group can reach, built from sampled joint configurations.
+
+    The workspace (expressed in a base frame of the group) is divided into cubic voxels. Each voxel records
+    the directions the approach axis of the link pointed to when the link was observed inside the voxel, binned
+    into DIRECTION_COUNT directions spread evenly on the sphere, and the largest manipulability observed there.
+    A pose is considered reachable if its voxel contains a direction within the orientation tolerance of the
+    approach axis of the pose. The map is an approximation: it can reject poses a solver would find with enough
+    samples, so it should be built with dilate() and a generous tolerance when used to filter IK queries. */
+class ReachabilityMap
+{
+public:
+
+  static const unsigned int DIRECTION_COUNT = 64;
+
+  ReachabilityMap();
+
+  /** \brief Create an empty map covering the box between \e min_corner and \e max_corner (in \e base_frame)
+      with voxels of size \e resolution. \e approach_axis is the axis of \e ik_link that is binned */
+  ReachabilityMap(const std::string &group_name, const std::string &base_frame, const std::string &ik_link,
+                  const Eigen::Vector3d &min_corner, const Eigen::Vector3d &max_corner, double resolution,
+                  const Eigen::Vector3d &approach_axis = Eigen::Vector3d::UnitX());
+
+  /** \brief Record that \e pose of the link (in the base frame) is reachable with the given manipulability.
+      Poses outside the bounds of the map are ignored. */
+  void addSample(const Eigen::Affine3d &pose, double manipulability);
+
+  /** \brief Grow the reachable set by one voxel in every direction, to fill the gaps left by sampling */
+  void dilate();
+
+  /** \brief Check if the link can reach \e pose (in the base frame) */
+  bool isReachable(const Eigen::Affine3d &pose) const;
+
+  /** \brief Check if the link can reach \e position (in the base frame) with any orientation */
+  bool isPositionReachable(const Eigen::Vector3d &position) const;
+
+  /** \brief Get the largest manipulability recorded for the voxel containing \e position; 0 if it is not reachable */
+  double getManipulability(const Eigen::Vector3d &position) const;
+
+  /** \brief Set the largest angle (radians) between the approach axis of a query and a recorded direction */
+  void setOrientationTolerance(double angle);
+
+  double getOrientationTolerance() const
+  {
+    return orientation_tolerance_;
+  }
+
+  /** \brief Write the map to a binary file. Only voxels that are reachable are stored */
+  bool saveToFile(const std::string &filename) const;
+
+  /** \brief Replace this map by the one stored in \e filename */
+  bool loadFromFile(const std::string &filename);
+
+  const std::string& getGroupName() const
+  {
+    return group_name_;
+  }
+
+  const std::string& getBaseFrame() const
+  {
+    return base_frame_;
+  }
+
+  const std::string& getIKLinkName() const
+  {
+    return ik_link_;
+  }
+
+  const Eigen::Vector3d& getApproachAxis() const
+  {
+    return approach_axis_;
+  }
+
+  double getResolution() const
+  {
+    return resolution_;
+  }
+
+  /** \brief The number of samples added to the map */
+  boost::uint64_t getSampleCount() const
+  {
+    return samples_;
+  }
+
+  std::size_t getVoxelCount() const
+  {
+    return directions_.size();
+  }
+
+  std::size_t getReachableVoxelCount() const;
+
+private:
+
+  void computeDirectionBins();
+  unsigned int getDirectionBin(const Eigen::Vector3d &direction) const;
+  bool getVoxelIndex(const Eigen::Vector3d &position, std::size_t &index) const;
+
+  std::string group_name_;
+  std::string base_frame_;
+  std::string ik_link_;
+  Eigen::Vector3d approach_axis_;
+
+  Eigen::Vector3d origin_;
+  double resolution_;
+  unsigned int size_[3];
+  boost::uint64_t samples_;
+
+  /** \brief For each voxel, the set of recorded direction bins */
+  std::vector<boost::uint64_t> directions_;
+
+  /** \brief For each voxel, the largest recorded manipulability */
+  std::vector<float> manipulability_;
+
+  double orientation_tolerance_;
+  std::vector<Eigen::Vector3d> bins_;
+
+  /** \brief For each direction bin, the bins within the orientation tolerance */
+  std::vector<boost::uint64_t> tolerance_masks_;
+};
+
+typedef boost::shared_ptr<ReachabilityMap> ReachabilityMapPtr;
+typedef boost::shared_ptr<const ReachabilityMap> ReachabilityMapConstPtr;
+
+}
+
+#endif
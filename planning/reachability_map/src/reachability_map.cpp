@@ -0,0 +1,325 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/reachability_map/reachability_map.h>
+#include <ros/console.h>
+#include <boost/math/constants/constants.hpp>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace reachability_map
+{
+
+const unsigned int ReachabilityMap::DIRECTION_COUNT;
+
+namespace
+{
+const char FILE_MAGIC[8] = { 'M', 'V', 'R', 'E', 'A', 'C', 'H', '1' };
+
+// roughly 1.5 times the angle between neighboring direction bins
+const double DEFAULT_ORIENTATION_TOLERANCE = 0.65;
+
+template<typename T>
+void writeValue(std::ofstream &out, const T &value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(std::ifstream &in, T &value)
+{
+  return in.read(reinterpret_cast<char*>(&value), sizeof(T)).good();
+}
+
+void writeString(std::ofstream &out, const std::string &value)
+{
+  writeValue<boost::uint32_t>(out, value.size());
+  out.write(value.data(), value.size());
+}
+
+bool readString(std::ifstream &in, std::string &value)
+{
+  boost::uint32_t size;
+  if (!readValue(in, size) || size > 4096)
+    return false;
+  value.resize(size);
+  return size == 0 || in.read(&value[0], size).good();
+}
+}
+
+ReachabilityMap::ReachabilityMap() :
+  approach_axis_(Eigen::Vector3d::UnitX()),
+  origin_(Eigen::Vector3d::Zero()),
+  resolution_(1.0),
+  samples_(0),
+  orientation_tolerance_(DEFAULT_ORIENTATION_TOLERANCE)
+{
+  size_[0] = size_[1] = size_[2] = 0;
+  computeDirectionBins();
+}
+
+ReachabilityMap::ReachabilityMap(const std::string &group_name, const std::string &base_frame, const std::string &ik_link,
+                                 const Eigen::Vector3d &min_corner, const Eigen::Vector3d &max_corner, double resolution,
+                                 const Eigen::Vector3d &approach_axis) :
+  group_name_(group_name),
+  base_frame_(base_frame),
+  ik_link_(ik_link),
+  approach_axis_(approach_axis.normalized()),
+  origin_(min_corner),
+  resolution_(resolution),
+  samples_(0),
+  orientation_tolerance_(DEFAULT_ORIENTATION_TOLERANCE)
+{
+  for (int i = 0 ; i < 3 ; ++i)
+    size_[i] = std::max(1, (int)ceil((max_corner[i] - min_corner[i]) / resolution_));
+  directions_.resize((std::size_t)size_[0] * size_[1] * size_[2], 0);
+  manipulability_.resize(directions_.size(), 0.0f);
+  computeDirectionBins();
+}
+
+void ReachabilityMap::computeDirectionBins()
+{
+  // a Fibonacci lattice gives nearly uniform directions
+  bins_.resize(DIRECTION_COUNT);
+  const double golden_angle = boost::math::constants::pi<double>() * (3.0 - sqrt(5.0));
+  for (unsigned int i = 0 ; i < DIRECTION_COUNT ; ++i)
+  {
+    double z = 1.0 - (2.0 * i + 1.0) / DIRECTION_COUNT;
+    double r = sqrt(std::max(0.0, 1.0 - z * z));
+    bins_[i] = Eigen::Vector3d(r * cos(golden_angle * i), r * sin(golden_angle * i), z);
+  }
+  setOrientationTolerance(orientation_tolerance_);
+}
+
+void ReachabilityMap::setOrientationTolerance(double angle)
+{
+  orientation_tolerance_ = angle;
+  const double min_dot = cos(angle);
+  tolerance_masks_.assign(DIRECTION_COUNT, 0);
+  for (unsigned int i = 0 ; i < DIRECTION_COUNT ; ++i)
+    for (unsigned int j = 0 ; j < DIRECTION_COUNT ; ++j)
+      if (i == j || bins_[i].dot(bins_[j]) >= min_dot)
+        tolerance_masks_[i] |= (boost::uint64_t)1 << j;
+}
+
+unsigned int ReachabilityMap::getDirectionBin(const Eigen::Vector3d &direction) const
+{
+  unsigned int best = 0;
+  double best_dot = -std::numeric_limits<double>::infinity();
+  for (unsigned int i = 0 ; i < DIRECTION_COUNT ; ++i)
+  {
+    double d = bins_[i].dot(direction);
+    if (d > best_dot)
+    {
+      best_dot = d;
+      best = i;
+    }
+  }
+  return best;
+}
+
+bool ReachabilityMap::getVoxelIndex(const Eigen::Vector3d &position, std::size_t &index) const
+{
+  if (directions_.empty())
+    return false;
+  int cell[3];
+  for (int i = 0 ; i < 3 ; ++i)
+  {
+    double c = floor((position[i] - origin_[i]) / resolution_);
+    if (!(c >= 0.0 && c < size_[i]))
+      return false;
+    cell[i] = (int)c;
+  }
+  index = ((std::size_t)cell[2] * size_[1] + cell[1]) * size_[0] + cell[0];
+  return true;
+}
+
+void ReachabilityMap::addSample(const Eigen::Affine3d &pose, double manipulability)
+{
+  std::size_t index;
+  if (!getVoxelIndex(pose.translation(), index))
+    return;
+  directions_[index] |= (boost::uint64_t)1 << getDirectionBin(pose.linear() * approach_axis_);
+  if (manipulability > manipulability_[index])
+    manipulability_[index] = manipulability;
+  samples_++;
+}
+
+void ReachabilityMap::dilate()
+{
+  std::vector<boost::uint64_t> directions = directions_;
+  std::vector<float> manipulability = manipulability_;
+  const int sx = size_[0], sy = size_[1], sz = size_[2];
+  for (int z = 0 ; z < sz ; ++z)
+    for (int y = 0 ; y < sy ; ++y)
+      for (int x = 0 ; x < sx ; ++x)
+      {
+        std::size_t index = ((std::size_t)z * sy + y) * sx + x;
+        if (!directions_[index])
+          continue;
+        for (int dz = std::max(z - 1, 0) ; dz <= std::min(z + 1, sz - 1) ; ++dz)
+          for (int dy = std::max(y - 1, 0) ; dy <= std::min(y + 1, sy - 1) ; ++dy)
+            for (int dx = std::max(x - 1, 0) ; dx <= std::min(x + 1, sx - 1) ; ++dx)
+            {
+              std::size_t n = ((std::size_t)dz * sy + dy) * sx + dx;
+              directions[n] |= directions_[index];
+              manipulability[n] = std::max(manipulability[n], manipulability_[index]);
+            }
+      }
+  directions_.swap(directions);
+  manipulability_.swap(manipulability);
+}
+
+bool ReachabilityMap::isReachable(const Eigen::Affine3d &pose) const
+{
+  std::size_t index;
+  if (!getVoxelIndex(pose.translation(), index))
+    return false;
+  return (directions_[index] & tolerance_masks_[getDirectionBin(pose.linear() * approach_axis_)]) != 0;
+}
+
+bool ReachabilityMap::isPositionReachable(const Eigen::Vector3d &position) const
+{
+  std::size_t index;
+  return getVoxelIndex(position, index) && directions_[index] != 0;
+}
+
+double ReachabilityMap::getManipulability(const Eigen::Vector3d &position) const
+{
+  std::size_t index;
+  return getVoxelIndex(position, index) ? manipulability_[index] : 0.0;
+}
+
+std::size_t ReachabilityMap::getReachableVoxelCount() const
+{
+  return directions_.size() - std::count(directions_.begin(), directions_.end(), (boost::uint64_t)0);
+}
+
+bool ReachabilityMap::saveToFile(const std::string &filename) const
+{
+  std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!out.good())
+  {
+    ROS_ERROR_NAMED("reachability_map", "Unable to open '%s' for writing", filename.c_str());
+    return false;
+  }
+
+  out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+  writeString(out, group_name_);
+  writeString(out, base_frame_);
+  writeString(out, ik_link_);
+  for (int i = 0 ; i < 3 ; ++i)
+    writeValue(out, approach_axis_[i]);
+  for (int i = 0 ; i < 3 ; ++i)
+    writeValue(out, origin_[i]);
+  writeValue(out, resolution_);
+  for (int i = 0 ; i < 3 ; ++i)
+    writeValue<boost::uint32_t>(out, size_[i]);
+  writeValue(out, samples_);
+
+  // a bit per voxel marks the reachable ones; only those have their directions and manipulability stored
+  std::vector<unsigned char> occupied((directions_.size() + 7) / 8, 0);
+  for (std::size_t i = 0 ; i < directions_.size() ; ++i)
+    if (directions_[i])
+      occupied[i / 8] |= 1 << (i % 8);
+  if (!occupied.empty())
+    out.write(reinterpret_cast<const char*>(&occupied[0]), occupied.size());
+  for (std::size_t i = 0 ; i < directions_.size() ; ++i)
+    if (directions_[i])
+    {
+      writeValue(out, directions_[i]);
+      writeValue(out, manipulability_[i]);
+    }
+
+  if (!out.good())
+  {
+    ROS_ERROR_NAMED("reachability_map", "Error writing '%s'", filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool ReachabilityMap::loadFromFile(const std::string &filename)
+{
+  std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!in.good())
+  {
+    ROS_ERROR_NAMED("reachability_map", "Unable to open '%s'", filename.c_str());
+    return false;
+  }
+
+  char magic[sizeof(FILE_MAGIC)];
+  if (!in.read(magic, sizeof(magic)).good() || !std::equal(magic, magic + sizeof(magic), FILE_MAGIC))
+  {
+    ROS_ERROR_NAMED("reachability_map", "'%s' is not a reachability map", filename.c_str());
+    return false;
+  }
+
+  ReachabilityMap map;
+  boost::uint32_t size[3];
+  bool ok = readString(in, map.group_name_) && readString(in, map.base_frame_) && readString(in, map.ik_link_);
+  for (int i = 0 ; i < 3 && ok ; ++i)
+    ok = readValue(in, map.approach_axis_[i]);
+  for (int i = 0 ; i < 3 && ok ; ++i)
+    ok = readValue(in, map.origin_[i]);
+  ok = ok && readValue(in, map.resolution_);
+  for (int i = 0 ; i < 3 && ok ; ++i)
+    ok = readValue(in, size[i]) && size[i] > 0 && size[i] < 1 << 16;
+  ok = ok && readValue(in, map.samples_) && map.resolution_ > 0.0;
+  if (ok)
+  {
+    for (int i = 0 ; i < 3 ; ++i)
+      map.size_[i] = size[i];
+    map.directions_.resize((std::size_t)size[0] * size[1] * size[2], 0);
+    map.manipulability_.resize(map.directions_.size(), 0.0f);
+    std::vector<unsigned char> occupied((map.directions_.size() + 7) / 8, 0);
+    ok = in.read(reinterpret_cast<char*>(&occupied[0]), occupied.size()).good();
+    for (std::size_t i = 0 ; i < map.directions_.size() && ok ; ++i)
+      if (occupied[i / 8] & (1 << (i % 8)))
+        ok = readValue(in, map.directions_[i]) && readValue(in, map.manipulability_[i]);
+  }
+  if (!ok)
+  {
+    ROS_ERROR_NAMED("reachability_map", "'%s' is truncated or corrupt", filename.c_str());
+    return false;
+  }
+
+  map.setOrientationTolerance(orientation_tolerance_);
+  std::swap(*this, map);
+  return true;
+}
+
+}
@@ -0,0 +1,143 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <moveit/reachability_map/reachability_map.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+using namespace reachability_map;
+
+namespace
+{
+
+Eigen::Affine3d makePose(double x, double y, double z, const Eigen::Vector3d &approach)
+{
+  // a frame whose x axis points along approach
+  Eigen::Affine3d pose(Eigen::Quaterniond::FromTwoVectors(Eigen::Vector3d::UnitX(), approach));
+  pose.translation() = Eigen::Vector3d(x, y, z);
+  return pose;
+}
+
+ReachabilityMap makeMap()
+{
+  ReachabilityMap map("arm", "base_link", "tool", Eigen::Vector3d(-1.0, -1.0, 0.0), Eigen::Vector3d(1.0, 1.0, 1.0), 0.1);
+  map.addSample(makePose(0.55, 0.05, 0.45, Eigen::Vector3d::UnitZ()), 0.2);
+  map.addSample(makePose(0.55, 0.05, 0.45, -Eigen::Vector3d::UnitZ()), 0.4);
+  map.addSample(makePose(-0.35, 0.05, 0.75, Eigen::Vector3d::UnitX()), 0.1);
+  return map;
+}
+
+}
+
+TEST(ReachabilityMap, Query)
+{
+  ReachabilityMap map = makeMap();
+  EXPECT_EQ(20u * 20u * 10u, map.getVoxelCount());
+  EXPECT_EQ(2u, map.getReachableVoxelCount());
+  EXPECT_EQ(3u, map.getSampleCount());
+
+  EXPECT_TRUE(map.isPositionReachable(Eigen::Vector3d(0.51, 0.01, 0.41)));
+  EXPECT_FALSE(map.isPositionReachable(Eigen::Vector3d(0.45, 0.01, 0.41)));
+  EXPECT_FALSE(map.isPositionReachable(Eigen::Vector3d(5.0, 0.0, 0.0)));
+  EXPECT_FLOAT_EQ(0.4, map.getManipulability(Eigen::Vector3d(0.51, 0.01, 0.41)));
+  EXPECT_DOUBLE_EQ(0.0, map.getManipulability(Eigen::Vector3d(0.0, 0.0, 0.0)));
+
+  // recorded directions, directions within the tolerance and directions outside of it
+  EXPECT_TRUE(map.isReachable(makePose(0.52, 0.02, 0.42, Eigen::Vector3d::UnitZ())));
+  EXPECT_TRUE(map.isReachable(makePose(0.52, 0.02, 0.42, -Eigen::Vector3d::UnitZ())));
+  EXPECT_TRUE(map.isReachable(makePose(0.52, 0.02, 0.42, Eigen::Vector3d(0.2, 0.0, 1.0).normalized())));
+  EXPECT_FALSE(map.isReachable(makePose(0.52, 0.02, 0.42, Eigen::Vector3d::UnitY())));
+  EXPECT_FALSE(map.isReachable(makePose(0.12, 0.02, 0.42, Eigen::Vector3d::UnitZ())));
+
+  // rolling about the approach axis does not matter
+  Eigen::Affine3d rolled = makePose(0.52, 0.02, 0.42, Eigen::Vector3d::UnitZ()) * Eigen::AngleAxisd(1.0, Eigen::Vector3d::UnitX());
+  EXPECT_TRUE(map.isReachable(rolled));
+
+  map.setOrientationTolerance(1.6);
+  EXPECT_TRUE(map.isReachable(makePose(0.52, 0.02, 0.42, Eigen::Vector3d::UnitY())));
+}
+
+TEST(ReachabilityMap, Dilate)
+{
+  ReachabilityMap map = makeMap();
+  map.dilate();
+  EXPECT_EQ(27u + 27u, map.getReachableVoxelCount());
+  EXPECT_TRUE(map.isReachable(makePose(0.45, 0.15, 0.35, Eigen::Vector3d::UnitZ())));
+  EXPECT_FLOAT_EQ(0.4, map.getManipulability(Eigen::Vector3d(0.45, 0.15, 0.35)));
+  EXPECT_FALSE(map.isPositionReachable(Eigen::Vector3d(0.35, 0.05, 0.45)));
+}
+
+TEST(ReachabilityMap, SaveAndLoad)
+{
+  ReachabilityMap map = makeMap();
+  const std::string filename = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+  ASSERT_TRUE(map.saveToFile(filename));
+
+  ReachabilityMap loaded;
+  ASSERT_TRUE(loaded.loadFromFile(filename));
+  EXPECT_EQ("arm", loaded.getGroupName());
+  EXPECT_EQ("base_link", loaded.getBaseFrame());
+  EXPECT_EQ("tool", loaded.getIKLinkName());
+  EXPECT_DOUBLE_EQ(0.1, loaded.getResolution());
+  EXPECT_EQ(map.getVoxelCount(), loaded.getVoxelCount());
+  EXPECT_EQ(map.getReachableVoxelCount(), loaded.getReachableVoxelCount());
+  EXPECT_EQ(map.getSampleCount(), loaded.getSampleCount());
+  EXPECT_TRUE(loaded.isReachable(makePose(0.52, 0.02, 0.42, -Eigen::Vector3d::UnitZ())));
+  EXPECT_TRUE(loaded.isReachable(makePose(-0.32, 0.02, 0.72, Eigen::Vector3d::UnitX())));
+  EXPECT_FALSE(loaded.isReachable(makePose(0.52, 0.02, 0.42, Eigen::Vector3d::UnitY())));
+  EXPECT_FLOAT_EQ(0.4, loaded.getManipulability(Eigen::Vector3d(0.51, 0.01, 0.41)));
+
+  // only the reachable voxels are stored
+  EXPECT_LT(boost::filesystem::file_size(filename), map.getVoxelCount() / 8 + 200);
+
+  // a truncated file is rejected and leaves the map unchanged
+  boost::filesystem::resize_file(filename, boost::filesystem::file_size(filename) - 4);
+  EXPECT_FALSE(loaded.loadFromFile(filename));
+  EXPECT_EQ("arm", loaded.getGroupName());
+  EXPECT_EQ(2u, loaded.getReachableVoxelCount());
+
+  {
+    std::ofstream out(filename.c_str());
+    out << "not a map";
+  }
+  EXPECT_FALSE(loaded.loadFromFile(filename));
+  boost::filesystem::remove(filename);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -38,6 +38,7 @@
 #include <moveit/profiler/profiler.h>
 #include <ros/ros.h>
 #include <typeinfo>
+#include <algorithm>
 
 robot_model_loader::RobotModelLoader::RobotModelLoader(const std::string &robot_description, bool load_kinematics_solvers)
 {
@@ -70,6 +71,46 @@ bool canSpecifyPosition(const robot_model::JointModel *jmodel, const unsigned in
     ok = true;
   return ok;
 }
+
+// find the limits of a variable in the joint_limits parameter; names of variables of multi-DOF joints contain a '/',
+// so their limits are in a nested namespace
+XmlRpc::XmlRpcValue* findVariableLimits(XmlRpc::XmlRpcValue &joint_limits, const std::string &variable)
+{
+  XmlRpc::XmlRpcValue *value = &joint_limits;
+  std::size_t start = 0;
+  while (start <= variable.size())
+  {
+    std::size_t end = std::min(variable.find('/', start), variable.size());
+    const std::string name = variable.substr(start, end - start);
+    if (value->getType() != XmlRpc::XmlRpcValue::TypeStruct || !value->hasMember(name))
+      return NULL;
+    value = &(*value)[name];
+    start = end + 1;
+  }
+  return value->getType() == XmlRpc::XmlRpcValue::TypeStruct ? value : NULL;
+}
+
+bool getLimitValue(XmlRpc::XmlRpcValue &limits, const std::string &name, double &value)
+{
+  if (!limits.hasMember(name))
+    return false;
+  XmlRpc::XmlRpcValue &v = limits[name];
+  if (v.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+    value = static_cast<double>(v);
+  else if (v.getType() == XmlRpc::XmlRpcValue::TypeInt)
+    value = static_cast<int>(v);
+  else
+    return false;
+  return true;
+}
+
+bool getLimitValue(XmlRpc::XmlRpcValue &limits, const std::string &name, bool &value)
+{
+  if (!limits.hasMember(name) || limits[name].getType() != XmlRpc::XmlRpcValue::TypeBoolean)
+    return false;
+  value = static_cast<bool>(limits[name]);
+  return true;
+}
 }
 
 void robot_model_loader::RobotModelLoader::configure(const Options &opt)
@@ -93,19 +134,26 @@ void robot_model_loader::RobotModelLoader::configure(const Options &opt)
   {
     moveit::tools::Profiler::ScopedBlock prof_block2("RobotModelLoader::configure joint limits");
 
-    // if there are additional joint limits specified in some .yaml file, read those in
+    // if there are additional joint limits specified in some .yaml file, read those in;
+    // all of them are fetched with one query, rather than one per joint and limit
     ros::NodeHandle nh("~");
+    XmlRpc::XmlRpcValue joint_limits;
+    if (!nh.getParam(rdf_loader_->getRobotDescription() + "_planning/joint_limits", joint_limits) ||
+        joint_limits.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+      joint_limits = XmlRpc::XmlRpcValue();
 
-    for (std::size_t i = 0; i < model_->getJointModels().size() ; ++i)
+    for (std::size_t i = 0; i < model_->getJointModels().size() && joint_limits.valid() ; ++i)
     {
       robot_model::JointModel *jmodel = model_->getJointModels()[i];
       std::vector<moveit_msgs::JointLimits> jlim = jmodel->getVariableBoundsMsg();
       for (std::size_t j = 0; j < jlim.size(); ++j)
       {
-        std::string prefix = rdf_loader_->getRobotDescription() + "_planning/joint_limits/" + jlim[j].joint_name + "/";
+        XmlRpc::XmlRpcValue *limits = findVariableLimits(joint_limits, jlim[j].joint_name);
+        if (!limits)
+          continue;
 
         double max_position;
-        if (nh.getParam(prefix + "max_position", max_position))
+        if (getLimitValue(*limits, "max_position", max_position))
         {
           if (canSpecifyPosition(jmodel, j))
           {
@@ -114,7 +162,7 @@ void robot_model_loader::RobotModelLoader::configure(const Options &opt)
           }
         }
         double min_position;
-        if (nh.getParam(prefix + "min_position", min_position))
+        if (getLimitValue(*limits, "min_position", min_position))
         {
           if (canSpecifyPosition(jmodel, j))
           {
@@ -123,23 +171,23 @@ void robot_model_loader::RobotModelLoader::configure(const Options &opt)
           }
         }
         double max_velocity;
-        if (nh.getParam(prefix + "max_velocity", max_velocity))
+        if (getLimitValue(*limits, "max_velocity", max_velocity))
         {
           jlim[j].has_velocity_limits = true;
           jlim[j].max_velocity = max_velocity;
         }
         bool has_vel_limits;
-        if (nh.getParam(prefix + "has_velocity_limits", has_vel_limits))
+        if (getLimitValue(*limits, "has_velocity_limits", has_vel_limits))
           jlim[j].has_velocity_limits = has_vel_limits;
 
         double max_acc;
-        if (nh.getParam(prefix + "max_acceleration", max_acc))
+        if (getLimitValue(*limits, "max_acceleration", max_acc))
         {
           jlim[j].has_acceleration_limits = true;
           jlim[j].max_acceleration = max_acc;
         }
         bool has_acc_limits;
-        if (nh.getParam(prefix + "has_acceleration_limits", has_acc_limits))
+        if (getLimitValue(*limits, "has_acceleration_limits", has_acc_limits))
           jlim[j].has_acceleration_limits = has_acc_limits;
       }
       jmodel->setVariableBounds(jlim);
@@ -179,7 +227,11 @@ void robot_model_loader::RobotModelLoader::loadKinematicsSolvers(const kinematic
 
       const robot_model::JointModelGroup *jmg = model_->getJointModelGroup(groups[i]);
 
+      moveit::tools::Profiler::ScopedBlock prof_block_group("RobotModelLoader::loadKinematicsSolvers " + groups[i]);
+      ros::WallTime start = ros::WallTime::now();
       kinematics::KinematicsBasePtr solver = kinematics_allocator(jmg);
+      ROS_DEBUG_STREAM_NAMED("robot_model_loader", "Allocated kinematics solver for group '" << groups[i] << "' in "
+                             << (ros::WallTime::now() - start).toSec() << " seconds");
       if(solver)
       {
         std::string error_msg;
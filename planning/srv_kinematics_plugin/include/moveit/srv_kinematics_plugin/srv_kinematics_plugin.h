@@ -47,6 +47,11 @@
 
 // System
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/future.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/asio/io_service.hpp>
 
 // ROS msgs
 #include <geometry_msgs/PoseStamped.h>
@@ -75,6 +80,19 @@ namespace srv_kinematics_plugin
      */
     SrvKinematicsPlugin();
 
+    virtual ~SrvKinematicsPlugin();
+
+    /**
+     * @brief The outcome of one asynchronous IK query
+     */
+    struct IKResult
+    {
+      std::vector<double> solution;
+      moveit_msgs::MoveItErrorCodes error_code;
+    };
+
+    typedef boost::shared_future<IKResult> IKResultFuture;
+
     virtual bool getPositionIK(const geometry_msgs::Pose &ik_pose,
                                const std::vector<double> &ik_seed_state,
                                std::vector<double> &solution,
@@ -149,6 +167,40 @@ namespace srv_kinematics_plugin
      */
     const std::vector<std::string>& getVariableNames() const;
 
+    /**
+     * @brief Send an IK query to the service without waiting for the answer. Queries are sent in the
+     * order they are submitted, with up to getPipelineDepth() calls in flight at a time, each on its own
+     * persistent connection. A call that throws is reported with the error code FAILURE. Safe to call from several threads.
+     * @param ik_poses One pose per tip frame
+     * @param ik_seed_state The seed sent to the service
+     */
+    IKResultFuture searchPositionIKAsync(const std::vector<geometry_msgs::Pose> &ik_poses,
+                                         const std::vector<double> &ik_seed_state) const;
+
+    /**
+     * @brief Solve a batch of IK queries through the pipeline and wait for all of them.
+     * @param ik_poses For each query, one pose per tip frame
+     * @param ik_seed_states For each query, the seed sent to the service
+     * @param solutions The solution of each query (empty if the query failed)
+     * @param error_codes The error code of each query
+     * @return True if every query was solved
+     */
+    bool searchPositionIKBatch(const std::vector<std::vector<geometry_msgs::Pose> > &ik_poses,
+                               const std::vector<std::vector<double> > &ik_seed_states,
+                               std::vector<std::vector<double> > &solutions,
+                               std::vector<moveit_msgs::MoveItErrorCodes> &error_codes) const;
+
+    /**
+     * @brief Set the number of service calls kept in flight by the asynchronous interface.
+     * Must not be called while asynchronous queries are pending.
+     */
+    void setPipelineDepth(unsigned int depth);
+
+    unsigned int getPipelineDepth() const
+    {
+      return pipeline_depth_;
+    }
+
   protected:
 
     virtual bool searchPositionIK(const geometry_msgs::Pose &ik_pose,
@@ -179,6 +231,21 @@ namespace srv_kinematics_plugin
 
     bool isRedundantJoint(unsigned int index) const;
 
+    /** @brief Build the service request for one query, call the service on \e client and extract the group state from the answer */
+    bool callIKService(ros::ServiceClient &client,
+                       const std::vector<geometry_msgs::Pose> &ik_poses,
+                       const std::vector<double> &ik_seed_state,
+                       std::vector<double> &solution,
+                       moveit_msgs::MoveItErrorCodes &error_code) const;
+
+    void runPipelinedQuery(const boost::shared_ptr<boost::promise<IKResult> > &result,
+                           const std::vector<geometry_msgs::Pose> &ik_poses,
+                           const std::vector<double> &ik_seed_state) const;
+
+    void startPipeline() const;
+
+    void stopPipeline();
+
     bool active_; /** Internal variable that indicates whether solvers are configured and ready */
 
     moveit_msgs::KinematicSolverInfo ik_group_info_; /** Stores information for the inverse kinematics solver */
@@ -188,12 +255,25 @@ namespace srv_kinematics_plugin
     robot_model::RobotModelPtr robot_model_;
     robot_model::JointModelGroup* joint_model_group_;
 
+    /** Default values of the variables outside the group; copied for every query, never modified */
     robot_state::RobotStatePtr robot_state_;
 
     int num_possible_redundant_joints_;
 
     boost::shared_ptr<ros::ServiceClient> ik_service_client_;
 
+    std::string ik_service_name_;
+
+    unsigned int pipeline_depth_;
+
+    /** Workers of the asynchronous interface, started on first use */
+    mutable boost::mutex pipeline_lock_;
+    mutable boost::scoped_ptr<boost::asio::io_service> pipeline_service_;
+    mutable boost::scoped_ptr<boost::asio::io_service::work> pipeline_work_;
+    mutable boost::thread_group pipeline_threads_;
+
+    /** The persistent connection of each pipeline worker */
+    mutable boost::thread_specific_ptr<ros::ServiceClient> pipeline_client_;
 
   };
 }
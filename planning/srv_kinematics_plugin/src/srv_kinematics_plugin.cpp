@@ -48,6 +48,8 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
+#include <algorithm>
+
 //register SRVKinematics as a KinematicsBase implementation
 CLASS_LOADER_REGISTER_CLASS(srv_kinematics_plugin::SrvKinematicsPlugin, kinematics::KinematicsBase)
 
@@ -55,9 +57,14 @@ namespace srv_kinematics_plugin
 {
 
 SrvKinematicsPlugin::SrvKinematicsPlugin()
- : active_(false)
+ : active_(false), pipeline_depth_(4)
 {}
 
+SrvKinematicsPlugin::~SrvKinematicsPlugin()
+{
+  stopPipeline();
+}
+
 bool SrvKinematicsPlugin::initialize(const std::string &robot_description,
   const std::string& group_name,
   const std::string& base_frame,
@@ -127,8 +134,12 @@ bool SrvKinematicsPlugin::initialize(const std::string &robot_description,
   // Choose what ROS service to send IK requests to
   ROS_DEBUG_STREAM_NAMED("srv","Looking for ROS service name on rosparm server at location: " <<
     private_handle.getNamespace() << "/" << group_name_ << "/kinematics_solver_service_name");
-  std::string ik_service_name;
-  private_handle.param(group_name_ + "/kinematics_solver_service_name", ik_service_name, std::string("solve_ik"));
+  private_handle.param(group_name_ + "/kinematics_solver_service_name", ik_service_name_, std::string("solve_ik"));
+
+  // Number of service calls the asynchronous interface keeps in flight
+  int pipeline_depth;
+  private_handle.param(group_name_ + "/kinematics_solver_service_pipeline_depth", pipeline_depth, 4);
+  setPipelineDepth(std::max(pipeline_depth, 1));
 
   // Setup the joint state groups that we need
   robot_state_.reset(new robot_state::RobotState(robot_model_));
@@ -137,7 +148,7 @@ bool SrvKinematicsPlugin::initialize(const std::string &robot_description,
   // Create the ROS service client
   ros::NodeHandle nonprivate_handle("");
   ik_service_client_ = boost::make_shared<ros::ServiceClient>(nonprivate_handle.serviceClient
-                       <moveit_msgs::GetPositionIK>(ik_service_name));
+                       <moveit_msgs::GetPositionIK>(ik_service_name_));
   if (!ik_service_client_->waitForExistence(ros::Duration(0.1))) // wait 0.1 seconds, blocking
     ROS_WARN_STREAM_NAMED("srv","Unable to connect to ROS service client with name: " << ik_service_client_->getService());
   else
@@ -313,6 +324,44 @@ bool SrvKinematicsPlugin::searchPositionIK(const std::vector<geometry_msgs::Pose
   const IKCallbackFn &solution_callback,
   moveit_msgs::MoveItErrorCodes &error_code,
   const kinematics::KinematicsQueryOptions &options) const
+{
+  if (!callIKService(*ik_service_client_, ik_poses, ik_seed_state, solution, error_code))
+    return false;
+
+  // Run the solution callback (i.e. collision checker) if available
+  if (!solution_callback.empty())
+  {
+    ROS_DEBUG_STREAM_NAMED("srv","Calling solution callback on IK solution");
+
+    // hack: should use all poses, not just the 0th
+    solution_callback(ik_poses[0], solution, error_code);
+
+    if(error_code.val != error_code.SUCCESS)
+    {
+      switch (error_code.val)
+      {
+        case moveit_msgs::MoveItErrorCodes::FAILURE:
+          ROS_ERROR_STREAM_NAMED("srv","IK solution callback failed with with error code: FAILURE");
+          break;
+        case moveit_msgs::MoveItErrorCodes::NO_IK_SOLUTION:
+          ROS_ERROR_STREAM_NAMED("srv","IK solution callback failed with with error code: NO IK SOLUTION");
+          break;
+        default:
+          ROS_ERROR_STREAM_NAMED("srv","IK solution callback failed with with error code: " << error_code.val);
+      }
+      return false;
+    }
+  }
+
+  ROS_DEBUG_STREAM_NAMED("srv","IK Solver Succeeded!");
+  return true;
+}
+
+bool SrvKinematicsPlugin::callIKService(ros::ServiceClient &client,
+  const std::vector<geometry_msgs::Pose> &ik_poses,
+  const std::vector<double> &ik_seed_state,
+  std::vector<double> &solution,
+  moveit_msgs::MoveItErrorCodes &error_code) const
 {
   // Check if active
   if(!active_)
@@ -344,9 +393,11 @@ bool SrvKinematicsPlugin::searchPositionIK(const std::vector<geometry_msgs::Pose
   ik_srv.request.ik_request.avoid_collisions = true;
   ik_srv.request.ik_request.group_name = getGroupName();
 
-  // Copy seed state into virtual robot state and convert into moveit_msg
-  robot_state_->setJointGroupPositions(joint_model_group_, ik_seed_state);
-  moveit::core::robotStateToRobotStateMsg(*robot_state_, ik_srv.request.ik_request.robot_state);
+  // Copy seed state into a private copy of the robot state, so concurrent queries do not interfere,
+  // and convert into moveit_msg
+  robot_state::RobotState state(*robot_state_);
+  state.setJointGroupPositions(joint_model_group_, ik_seed_state);
+  moveit::core::robotStateToRobotStateMsg(state, ik_srv.request.ik_request.robot_state);
 
   // Load the poses into the request in difference places depending if there is more than one or not
   geometry_msgs::PoseStamped ik_pose_st;
@@ -370,8 +421,8 @@ bool SrvKinematicsPlugin::searchPositionIK(const std::vector<geometry_msgs::Pose
     ik_srv.request.ik_request.ik_link_name = getTipFrames()[0];
   }
 
-  ROS_DEBUG_STREAM_NAMED("srv","Calling service: " << ik_service_client_->getService() );
-  if (ik_service_client_->call(ik_srv))
+  ROS_DEBUG_STREAM_NAMED("srv","Calling service: " << client.getService() );
+  if (client.call(ik_srv))
   {
     // Check error code
     error_code.val = ik_srv.response.error_code.val;
@@ -398,13 +449,13 @@ bool SrvKinematicsPlugin::searchPositionIK(const std::vector<geometry_msgs::Pose
   }
   else
   {
-    ROS_ERROR_STREAM("Service call failed to connect to service: " << ik_service_client_->getService() );
+    ROS_ERROR_STREAM("Service call failed to connect to service: " << client.getService() );
     error_code.val = error_code.FAILURE;
     return false;
   }
 
   // Convert the robot state message to our robot_state representation
-  if (!moveit::core::robotStateMsgToRobotState(ik_srv.response.solution, *robot_state_))
+  if (!moveit::core::robotStateMsgToRobotState(ik_srv.response.solution, state))
   {
     ROS_ERROR_STREAM_NAMED("srv","An error occured converting recieved robot state message into internal robot state.");
     error_code.val = error_code.FAILURE;
@@ -412,35 +463,110 @@ bool SrvKinematicsPlugin::searchPositionIK(const std::vector<geometry_msgs::Pose
   }
 
   // Get just the joints we are concerned about in our planning group
-  robot_state_->copyJointGroupPositions(joint_model_group_, solution);
+  state.copyJointGroupPositions(joint_model_group_, solution);
+  return true;
+}
 
-  // Run the solution callback (i.e. collision checker) if available
-  if (!solution_callback.empty())
-  {
-    ROS_DEBUG_STREAM_NAMED("srv","Calling solution callback on IK solution");
+void SrvKinematicsPlugin::setPipelineDepth(unsigned int depth)
+{
+  stopPipeline();
+  pipeline_depth_ = std::max(depth, 1u);
+}
 
-    // hack: should use all poses, not just the 0th
-    solution_callback(ik_poses[0], solution, error_code);
+void SrvKinematicsPlugin::startPipeline() const
+{
+  // called with pipeline_lock_ held
+  pipeline_service_.reset(new boost::asio::io_service());
+  pipeline_work_.reset(new boost::asio::io_service::work(*pipeline_service_));
+  for (unsigned int i = 0 ; i < pipeline_depth_ ; ++i)
+    pipeline_threads_.create_thread(boost::bind(&boost::asio::io_service::run, pipeline_service_.get()));
+}
 
-    if(error_code.val != error_code.SUCCESS)
+void SrvKinematicsPlugin::stopPipeline()
+{
+  boost::mutex::scoped_lock slock(pipeline_lock_);
+  pipeline_work_.reset();
+  pipeline_threads_.join_all();
+  pipeline_service_.reset();
+}
+
+void SrvKinematicsPlugin::runPipelinedQuery(const boost::shared_ptr<boost::promise<IKResult> > &result,
+  const std::vector<geometry_msgs::Pose> &ik_poses,
+  const std::vector<double> &ik_seed_state) const
+{
+  IKResult r;
+  try
+  {
+    // each worker keeps its own persistent connection, so the connection setup is paid once per worker;
+    // a connection that was dropped (e.g. the service restarted) is opened again
+    if (!pipeline_client_.get() || !pipeline_client_->isValid())
     {
-      switch (error_code.val)
-      {
-        case moveit_msgs::MoveItErrorCodes::FAILURE:
-          ROS_ERROR_STREAM_NAMED("srv","IK solution callback failed with with error code: FAILURE");
-          break;
-        case moveit_msgs::MoveItErrorCodes::NO_IK_SOLUTION:
-          ROS_ERROR_STREAM_NAMED("srv","IK solution callback failed with with error code: NO IK SOLUTION");
-          break;
-        default:
-          ROS_ERROR_STREAM_NAMED("srv","IK solution callback failed with with error code: " << error_code.val);
-      }
-      return false;
+      ros::NodeHandle nonprivate_handle("");
+      pipeline_client_.reset(new ros::ServiceClient(nonprivate_handle.serviceClient<moveit_msgs::GetPositionIK>(ik_service_name_, true)));
     }
+    callIKService(*pipeline_client_, ik_poses, ik_seed_state, r.solution, r.error_code);
+  }
+  catch (std::exception &ex)
+  {
+    ROS_ERROR_STREAM_NAMED("srv","Service call failed: " << ex.what());
+    r.solution.clear();
+    r.error_code.val = moveit_msgs::MoveItErrorCodes::FAILURE;
+  }
+  catch (...)
+  {
+    // whoever waits for the result gets the exception, rather than a broken promise
+    result->set_exception(boost::current_exception());
+    return;
   }
+  result->set_value(r);
+}
 
-  ROS_INFO_STREAM_NAMED("srv","IK Solver Succeeded!");
-  return true;
+SrvKinematicsPlugin::IKResultFuture SrvKinematicsPlugin::searchPositionIKAsync(const std::vector<geometry_msgs::Pose> &ik_poses,
+  const std::vector<double> &ik_seed_state) const
+{
+  boost::shared_ptr<boost::promise<IKResult> > result(new boost::promise<IKResult>());
+  IKResultFuture future(result->get_future());
+
+  boost::mutex::scoped_lock slock(pipeline_lock_);
+  if (!pipeline_service_)
+    startPipeline();
+  pipeline_service_->post(boost::bind(&SrvKinematicsPlugin::runPipelinedQuery, this, result, ik_poses, ik_seed_state));
+  return future;
+}
+
+bool SrvKinematicsPlugin::searchPositionIKBatch(const std::vector<std::vector<geometry_msgs::Pose> > &ik_poses,
+  const std::vector<std::vector<double> > &ik_seed_states,
+  std::vector<std::vector<double> > &solutions,
+  std::vector<moveit_msgs::MoveItErrorCodes> &error_codes) const
+{
+  if (ik_poses.size() != ik_seed_states.size())
+  {
+    ROS_ERROR_STREAM_NAMED("srv","Mismatched number of pose requests (" << ik_poses.size()
+      << ") and seed states (" << ik_seed_states.size() << ") in searchPositionIKBatch");
+    return false;
+  }
+
+  // submit everything first, so the pipeline stays full while we wait for the first answers
+  std::vector<IKResultFuture> futures;
+  futures.reserve(ik_poses.size());
+  for (std::size_t i = 0; i < ik_poses.size(); ++i)
+    futures.push_back(searchPositionIKAsync(ik_poses[i], ik_seed_states[i]));
+
+  solutions.resize(ik_poses.size());
+  error_codes.resize(ik_poses.size());
+  bool solved_all = true;
+  for (std::size_t i = 0; i < futures.size(); ++i)
+  {
+    const IKResult &r = futures[i].get();
+    solutions[i] = r.solution;
+    error_codes[i] = r.error_code;
+    if (r.error_code.val != moveit_msgs::MoveItErrorCodes::SUCCESS)
+    {
+      solutions[i].clear();
+      solved_all = false;
+    }
+  }
+  return solved_all;
 }
 
 bool SrvKinematicsPlugin::getPositionFK(const std::vector<std::string> &link_names,
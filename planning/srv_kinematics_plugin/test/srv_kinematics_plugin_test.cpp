@@ -0,0 +1,221 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2012, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <moveit/srv_kinematics_plugin/srv_kinematics_plugin.h>
+#include <boost/bind.hpp>
+
+// Runs against two instances of moveit_fake_ik_service, which answer every request with its seed state; the second
+// one reports every fourth request as unsolvable.
+
+using namespace srv_kinematics_plugin;
+
+namespace
+{
+
+const std::string URDF_STRING =
+  "<robot name=\"arm\">"
+  "  <link name=\"base_link\"/>"
+  "  <link name=\"upper_arm\"/>"
+  "  <link name=\"tip\"/>"
+  "  <joint name=\"shoulder\" type=\"revolute\">"
+  "    <parent link=\"base_link\"/><child link=\"upper_arm\"/><origin xyz=\"0 0 0.2\"/><axis xyz=\"0 1 0\"/>"
+  "    <limit lower=\"-3\" upper=\"3\" effort=\"10\" velocity=\"2\"/>"
+  "  </joint>"
+  "  <joint name=\"elbow\" type=\"revolute\">"
+  "    <parent link=\"upper_arm\"/><child link=\"tip\"/><origin xyz=\"0 0 0.5\"/><axis xyz=\"0 1 0\"/>"
+  "    <limit lower=\"-3\" upper=\"3\" effort=\"10\" velocity=\"2\"/>"
+  "  </joint>"
+  "</robot>";
+
+const std::string SRDF_STRING = "<robot name=\"arm\"><group name=\"arm\"><chain base_link=\"base_link\" tip_link=\"tip\"/></group></robot>";
+
+const unsigned int THREAD_COUNT = 4;
+const unsigned int QUERIES = 40;
+
+// a distinct seed for every query, so each answer can be matched to its query
+std::vector<double> makeSeed(unsigned int query)
+{
+  std::vector<double> seed(2);
+  seed[0] = -1.0 + 0.01 * query;
+  seed[1] = 1.0 - 0.02 * query;
+  return seed;
+}
+
+geometry_msgs::Pose makePose()
+{
+  geometry_msgs::Pose pose;
+  pose.position.z = 0.7;
+  pose.orientation.w = 1.0;
+  return pose;
+}
+
+// solve the queries of one thread one after the other, counting those answered with their own seed
+void solveQueries(const SrvKinematicsPlugin *solver, unsigned int thread, unsigned int *solved)
+{
+  for (unsigned int i = 0 ; i < QUERIES ; ++i)
+  {
+    const std::vector<double> seed = makeSeed(thread * QUERIES + i);
+    std::vector<double> solution;
+    moveit_msgs::MoveItErrorCodes error_code;
+    if (solver->searchPositionIK(makePose(), seed, 1.0, solution, error_code) && solution == seed &&
+        error_code.val == moveit_msgs::MoveItErrorCodes::SUCCESS)
+      (*solved)++;
+  }
+}
+
+// submit the queries of one thread without waiting for the answers
+void submitQueries(const SrvKinematicsPlugin *solver, unsigned int thread, SrvKinematicsPlugin::IKResultFuture *futures)
+{
+  for (unsigned int i = 0 ; i < QUERIES ; ++i)
+    futures[i] = solver->searchPositionIKAsync(std::vector<geometry_msgs::Pose>(1, makePose()), makeSeed(thread * QUERIES + i));
+}
+
+class SrvKinematicsPluginTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    ros::param::set("robot_description", URDF_STRING);
+    ros::param::set("robot_description_semantic", SRDF_STRING);
+    ros::param::set("~arm/kinematics_solver_service_name", "solve_ik");
+    ASSERT_TRUE(ros::service::waitForService("solve_ik", ros::Duration(30.0)));
+    ASSERT_TRUE(ros::service::waitForService("solve_ik_failing", ros::Duration(30.0)));
+    ASSERT_TRUE(solver_.initialize("robot_description", "arm", "base_link", "tip", 0.1));
+  }
+
+  SrvKinematicsPlugin solver_;
+};
+
+}
+
+TEST_F(SrvKinematicsPluginTest, ConcurrentSearch)
+{
+  std::vector<unsigned int> solved(THREAD_COUNT, 0);
+  boost::thread_group threads;
+  for (unsigned int t = 0 ; t < THREAD_COUNT ; ++t)
+    threads.create_thread(boost::bind(&solveQueries, &solver_, t, &solved[t]));
+  threads.join_all();
+  for (unsigned int t = 0 ; t < THREAD_COUNT ; ++t)
+    EXPECT_EQ(QUERIES, solved[t]);
+
+  // a seed of the wrong size is rejected without calling the service
+  std::vector<double> solution;
+  moveit_msgs::MoveItErrorCodes error_code;
+  EXPECT_FALSE(solver_.searchPositionIK(makePose(), std::vector<double>(3, 0.0), 1.0, solution, error_code));
+  EXPECT_EQ(moveit_msgs::MoveItErrorCodes::NO_IK_SOLUTION, error_code.val);
+}
+
+TEST_F(SrvKinematicsPluginTest, Async)
+{
+  solver_.setPipelineDepth(4);
+  EXPECT_EQ(4u, solver_.getPipelineDepth());
+
+  // queries submitted from several threads at once, answered in any order
+  std::vector<SrvKinematicsPlugin::IKResultFuture> futures(THREAD_COUNT * QUERIES);
+  boost::thread_group threads;
+  for (unsigned int t = 0 ; t < THREAD_COUNT ; ++t)
+    threads.create_thread(boost::bind(&submitQueries, &solver_, t, &futures[t * QUERIES]));
+  threads.join_all();
+
+  for (std::size_t i = 0 ; i < futures.size() ; ++i)
+  {
+    const SrvKinematicsPlugin::IKResult &result = futures[i].get();
+    EXPECT_EQ(moveit_msgs::MoveItErrorCodes::SUCCESS, result.error_code.val);
+    EXPECT_EQ(makeSeed(i), result.solution);
+  }
+
+  // the pipeline is restarted with the new depth
+  solver_.setPipelineDepth(1);
+  SrvKinematicsPlugin::IKResultFuture future = solver_.searchPositionIKAsync(std::vector<geometry_msgs::Pose>(1, makePose()), makeSeed(0));
+  const SrvKinematicsPlugin::IKResult &result = future.get();
+  EXPECT_EQ(moveit_msgs::MoveItErrorCodes::SUCCESS, result.error_code.val);
+  EXPECT_EQ(makeSeed(0), result.solution);
+}
+
+TEST_F(SrvKinematicsPluginTest, Batch)
+{
+  std::vector<std::vector<geometry_msgs::Pose> > poses(QUERIES, std::vector<geometry_msgs::Pose>(1, makePose()));
+  std::vector<std::vector<double> > seeds(QUERIES);
+  for (unsigned int i = 0 ; i < QUERIES ; ++i)
+    seeds[i] = makeSeed(i);
+  std::vector<std::vector<double> > solutions;
+  std::vector<moveit_msgs::MoveItErrorCodes> error_codes;
+
+  // batches solved while other threads search as well
+  std::vector<unsigned int> solved(THREAD_COUNT, 0);
+  boost::thread_group threads;
+  for (unsigned int t = 0 ; t < THREAD_COUNT ; ++t)
+    threads.create_thread(boost::bind(&solveQueries, &solver_, t, &solved[t]));
+  for (unsigned int k = 0 ; k < 3 ; ++k)
+  {
+    EXPECT_TRUE(solver_.searchPositionIKBatch(poses, seeds, solutions, error_codes));
+    ASSERT_EQ(seeds.size(), solutions.size());
+    ASSERT_EQ(seeds.size(), error_codes.size());
+    EXPECT_EQ(seeds, solutions);
+  }
+  threads.join_all();
+  for (unsigned int t = 0 ; t < THREAD_COUNT ; ++t)
+    EXPECT_EQ(QUERIES, solved[t]);
+
+  // the number of poses and seeds must match
+  EXPECT_FALSE(solver_.searchPositionIKBatch(poses, std::vector<std::vector<double> >(1, makeSeed(0)), solutions, error_codes));
+
+  // the queries the service does not solve are reported, with no solution
+  SrvKinematicsPlugin failing;
+  ros::param::set("~arm/kinematics_solver_service_name", "solve_ik_failing");
+  ASSERT_TRUE(failing.initialize("robot_description", "arm", "base_link", "tip", 0.1));
+  EXPECT_FALSE(failing.searchPositionIKBatch(poses, seeds, solutions, error_codes));
+  ASSERT_EQ(seeds.size(), error_codes.size());
+  unsigned int failed = 0;
+  for (unsigned int i = 0 ; i < QUERIES ; ++i)
+    if (error_codes[i].val == moveit_msgs::MoveItErrorCodes::SUCCESS)
+      EXPECT_EQ(seeds[i], solutions[i]);
+    else
+    {
+      EXPECT_EQ(moveit_msgs::MoveItErrorCodes::NO_IK_SOLUTION, error_codes[i].val);
+      EXPECT_TRUE(solutions[i].empty());
+      failed++;
+    }
+  EXPECT_EQ(QUERIES / 4, failed);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "srv_kinematics_plugin_test");
+  ros::NodeHandle nh;
+  return RUN_ALL_TESTS();
+}